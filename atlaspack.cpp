@@ -0,0 +1,259 @@
+#include "atlaspack.h"
+#include "mappedfile.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------
+
+struct SkylineSegment
+{
+    UINT x;
+    UINT y;
+    UINT width;
+};
+
+struct AtlasSkyline
+{
+    std::vector<SkylineSegment> segments;
+    UINT usedWidth;
+    UINT usedHeight;
+};
+
+static UINT AlignUp(UINT value, UINT alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Procura a posio mais baixa, e entre as mais baixas a mais  esquerda, para uma faixa width x height. Devolve
+// o segmento onde ela comea, ou UINT_MAX.
+static UINT FindSkylinePosition(const AtlasSkyline* skyline, UINT size, UINT width, UINT height, UINT* y)
+{
+    const std::vector<SkylineSegment>& segments = skyline->segments;
+    UINT bestIndex = UINT_MAX;
+    UINT bestY = UINT_MAX;
+
+    for (UINT i = 0; i < segments.size() && segments[i].x + width <= size; i++)
+    {
+        // A faixa apoia no segmento mais alto entre os que ela cobre.
+        UINT top = 0;
+        UINT covered = 0;
+        for (UINT j = i; covered < width; j++)
+        {
+            top = (std::max)(top, segments[j].y);
+            covered += segments[j].width;
+        }
+
+        if (top + height <= size && top < bestY)
+        {
+            bestY = top;
+            bestIndex = i;
+        }
+    }
+
+    *y = bestY;
+    return bestIndex;
+}
+
+static void InsertSkylineSegment(AtlasSkyline* skyline, UINT index, UINT width, UINT height, UINT y)
+{
+    std::vector<SkylineSegment>& segments = skyline->segments;
+    const UINT x = segments[index].x;
+    const UINT right = x + width;
+
+    // Os segmentos cobertos pela faixa somem; o ltimo pode ficar com a parte que sobra  direita.
+    UINT end = index;
+    while (end < segments.size() && segments[end].x + segments[end].width <= right)
+        end++;
+
+    if (end < segments.size() && segments[end].x < right)
+    {
+        segments[end].width -= right - segments[end].x;
+        segments[end].x = right;
+    }
+
+    segments.erase(segments.begin() + index, segments.begin() + end);
+    segments.insert(segments.begin() + index, { x, y + height, width });
+
+    // Vizinhos na mesma altura viram um segmento s.
+    if (index + 1 < segments.size() && segments[index + 1].y == segments[index].y)
+    {
+        segments[index].width += segments[index + 1].width;
+        segments.erase(segments.begin() + index + 1);
+    }
+
+    if (index > 0 && segments[index - 1].y == segments[index].y)
+    {
+        segments[index - 1].width += segments[index].width;
+        segments.erase(segments.begin() + index);
+    }
+
+    skyline->usedWidth = (std::max)(skyline->usedWidth, right);
+    skyline->usedHeight = (std::max)(skyline->usedHeight, y + height);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+HRESULT PackAtlases(const UINT* widths, const UINT* heights, UINT count, const AtlasSettings* settings, std::vector<AtlasRect>* rects, std::vector<AtlasInfo>* atlases)
+{
+    const UINT size = settings->size;
+    const UINT padding = settings->padding;
+    const UINT alignment = settings->alignment;
+
+    rects->assign(count, {});
+    atlases->clear();
+
+    // Da mais alta para a mais baixa, depois da mais larga; o ndice desempata para o resultado no depender da
+    // implementao do sort.
+    std::vector<UINT> order(count);
+    for (UINT i = 0; i < count; i++)
+    {
+        order[i] = i;
+        if (widths[i] == 0 || heights[i] == 0 || AlignUp(widths[i] + 2 * padding, alignment) > size || AlignUp(heights[i] + 2 * padding, alignment) > size)
+            return E_INVALIDARG;
+    }
+
+    std::sort(order.begin(), order.end(), [&](UINT a, UINT b)
+    {
+        if (heights[a] != heights[b])
+            return heights[a] > heights[b];
+
+        if (widths[a] != widths[b])
+            return widths[a] > widths[b];
+
+        return a < b;
+    });
+
+    std::vector<AtlasSkyline> skylines;
+
+    for (UINT i : order)
+    {
+        const UINT slotWidth = AlignUp(widths[i] + 2 * padding, alignment);
+        const UINT slotHeight = AlignUp(heights[i] + 2 * padding, alignment);
+
+        UINT atlas = 0;
+        UINT segment = UINT_MAX;
+        UINT y = 0;
+        for (; atlas < skylines.size(); atlas++)
+        {
+            segment = FindSkylinePosition(&skylines[atlas], size, slotWidth, slotHeight, &y);
+            if (segment != UINT_MAX)
+                break;
+        }
+
+        if (segment == UINT_MAX)
+        {
+            AtlasSkyline skyline;
+            skyline.segments.push_back({ 0, 0, size });
+            skyline.usedWidth = 0;
+            skyline.usedHeight = 0;
+            skylines.push_back(skyline);
+
+            atlas = static_cast<UINT>(skylines.size() - 1);
+            segment = 0;
+            y = 0;
+        }
+
+        AtlasRect* rect = &(*rects)[i];
+        rect->atlas = atlas;
+        rect->x = skylines[atlas].segments[segment].x + padding;
+        rect->y = y + padding;
+        rect->width = widths[i];
+        rect->height = heights[i];
+
+        InsertSkylineSegment(&skylines[atlas], segment, slotWidth, slotHeight, y);
+    }
+
+    for (const AtlasSkyline& skyline : skylines)
+    {
+        atlases->push_back({ skyline.usedWidth, skyline.usedHeight, 0, 0 });
+    }
+
+    for (UINT i = 0; i < count; i++)
+    {
+        AtlasInfo* atlas = &(*atlases)[(*rects)[i].atlas];
+        atlas->usedTexels += static_cast<UINT64>(widths[i]) * heights[i];
+        atlas->slotTexels += static_cast<UINT64>(AlignUp(widths[i] + 2 * padding, alignment)) * AlignUp(heights[i] + 2 * padding, alignment);
+    }
+
+    return S_OK;
+}
+
+UINT GetAtlasMipLevelCount(const AtlasSettings* settings, float filterRadius, UINT blockSize)
+{
+    // Texels junto  borda da faixa que j receberam algo da vizinha. O texel j do nvel seguinte, contado a
+    // partir da borda, l o anterior desde floor(2j + 1 - 2 * filterRadius).
+    UINT bleed = 0;
+    UINT levelCount = 1;
+
+    while (true)
+    {
+        bleed = static_cast<UINT>((std::max)(ceilf((bleed + 2.0f * filterRadius - 1.0f) * 0.5f), 0.0f));
+
+        if ((settings->alignment >> levelCount) < (std::max)(blockSize, 1u))
+            break;
+
+        if ((settings->padding >> levelCount) < (std::max)(bleed, 1u))
+            break;
+
+        levelCount++;
+    }
+
+    return levelCount;
+}
+
+void CopyToAtlas(const BYTE* pixels, UINT width, UINT height, const AtlasRect* rect, UINT padding, BYTE* atlas, UINT atlasRowPitch)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+
+    for (UINT y = 0; y < height + 2 * padding; y++)
+    {
+        // As linhas e colunas do padding repetem a borda mais prxima.
+        const UINT sourceY = static_cast<UINT>((std::min)((std::max)(static_cast<int>(y) - static_cast<int>(padding), 0), static_cast<int>(height) - 1));
+        const BYTE* source = pixels + sourceY * rowBytes;
+        BYTE* destination = atlas + static_cast<size_t>(rect->y - padding + y) * atlasRowPitch + static_cast<size_t>(rect->x - padding) * 4;
+
+        for (UINT x = 0; x < padding; x++)
+        {
+            memcpy(destination + x * 4, source, 4);
+            memcpy(destination + (padding + width + x) * 4, source + rowBytes - 4, 4);
+        }
+
+        memcpy(destination + padding * 4, source, rowBytes);
+    }
+}
+
+XMFLOAT4 GetAtlasUvTransform(const AtlasRect* rect, const AtlasInfo* atlas)
+{
+    const float width = static_cast<float>(atlas->width);
+    const float height = static_cast<float>(atlas->height);
+
+    return XMFLOAT4(rect->width / width, rect->height / height, rect->x / width, rect->y / height);
+}
+
+HRESULT SaveAtlasTable(const wchar_t* path, const AtlasRect* rects, UINT count, const AtlasInfo* atlases, UINT atlasCount)
+{
+    AtlasTableHeader header = { AtlasTableMagic, AtlasTableVersion, atlasCount, count };
+
+    std::vector<AtlasTableEntry> entries(count);
+    for (UINT i = 0; i < count; i++)
+    {
+        entries[i].atlas = rects[i].atlas;
+        entries[i].uvTransform = GetAtlasUvTransform(&rects[i], &atlases[rects[i].atlas]);
+    }
+
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    UINT64 position = 0;
+    const bool written =
+        WriteFileSection(file, &position, 0, &header, sizeof(header)) &&
+        WriteFileSection(file, &position, position, entries.data(), entries.size() * sizeof(AtlasTableEntry));
+
+    const HRESULT hr = written ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    CloseHandle(file);
+
+    return hr;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+// Empacotamento de texturas pequenas em atlas, feito pelo Cooker: menos descritores e menos trocas de estado. As
+// texturas so colocadas da mais alta para a mais baixa por um skyline bottom-left: o contorno de cima do que j
+// foi colocado  uma lista de segmentos, e cada textura vai para a posio mais baixa (depois a mais  esquerda)
+// em que cabe. Quando nenhum atlas aberto tem lugar, abre-se outro.
+//
+// Cada textura ocupa uma faixa com padding em volta, preenchido repetindo a borda. Cada nvel de mip l o anterior
+// num raio que depende do filtro (1 texel para a caixa, 6 para o Kaiser), ento o que vem da vizinha avana
+// alguns texels para dentro da faixa a cada nvel; GetAtlasMipLevelCount para antes que isso alcance a textura
+// ou que os blocos BC passem a cruzar as faixas.
+
+struct AtlasSettings
+{
+    UINT size;                  // Largura e altura mximas de cada atlas.
+    UINT padding;               // Texels repetidos em volta de cada textura.
+    UINT alignment;             // Posio e tamanho das faixas so mltiplos disto (potncia de 2, no mnimo 4 pelos blocos BC).
+};
+
+const AtlasSettings DefaultAtlasSettings = { 4096, 8, 8 };
+
+// Posio do contedo de uma textura, sem o padding.
+struct AtlasRect
+{
+    UINT atlas;
+    UINT x;
+    UINT y;
+    UINT width;
+    UINT height;
+};
+
+// Cada atlas  cortado na largura e na altura que foram usadas, mltiplas do alinhamento.
+struct AtlasInfo
+{
+    UINT width;
+    UINT height;
+    UINT64 usedTexels;          // Texels das texturas, sem o padding.
+    UINT64 slotTexels;          // Texels das faixas, com o padding e o alinhamento.
+};
+
+// Tabela gravada pelo Cooker ao lado dos atlas, com uma entrada por textura na ordem de entrada. As UVs da
+// textura original viram uv * (scaleU, scaleV) + (offsetU, offsetV) no atlas indicado.
+//
+//   AtlasTableHeader | AtlasTableEntry[entryCount]
+
+const UINT AtlasTableMagic = 0x534C5441;    // "ATLS"
+const UINT AtlasTableVersion = 1;
+
+struct AtlasTableHeader
+{
+    UINT magic;
+    UINT version;
+    UINT atlasCount;
+    UINT entryCount;
+};
+
+struct AtlasTableEntry
+{
+    UINT atlas;
+    XMFLOAT4 uvTransform;       // scaleU, scaleV, offsetU, offsetV.
+};
+
+// Devolve E_INVALIDARG se alguma textura, com o padding, no couber num atlas.
+HRESULT PackAtlases(const UINT* widths, const UINT* heights, UINT count, const AtlasSettings* settings, std::vector<AtlasRect>* rects, std::vector<AtlasInfo>* atlases);
+
+// Nveis de mip em que o padding ainda separa as texturas, gerados com um filtro de filterRadius texels do nvel
+// de destino para cada lado (GetMipFilterRadius) e comprimidos em blocos de blockSize texels: enquanto o padding
+// cobre o que vazou da vizinha (e tem pelo menos 1 texel, para a filtragem bilinear) e o alinhamento, no nvel,
+// ainda  mltiplo do bloco.
+UINT GetAtlasMipLevelCount(const AtlasSettings* settings, float filterRadius, UINT blockSize);
+
+// Copia uma textura RGBA8 para o atlas (RGBA8, atlasRowPitch bytes por linha) e preenche o padding em volta dela.
+void CopyToAtlas(const BYTE* pixels, UINT width, UINT height, const AtlasRect* rect, UINT padding, BYTE* atlas, UINT atlasRowPitch);
+
+XMFLOAT4 GetAtlasUvTransform(const AtlasRect* rect, const AtlasInfo* atlas);
+
+HRESULT SaveAtlasTable(const wchar_t* path, const AtlasRect* rects, UINT count, const AtlasInfo* atlases, UINT atlasCount);
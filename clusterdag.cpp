@@ -0,0 +1,568 @@
+#include "clusterdag.h"
+#include "meshsimplify.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT DagClusterBlocksPerJob = 256;
+
+// Cada grupo  simplificado para metade dos tringulos; grupos que no caem abaixo de DagMinReduction so adiados.
+const float DagSimplifyRatio = 0.5f;
+const float DagMinReduction = 0.85f;
+const float DagColorWeight = 0.1f;
+
+struct Sphere
+{
+    XMFLOAT3 center;
+    float radius;
+};
+
+struct DagGroupResult
+{
+    bool simplified;
+    float error;
+    Sphere bounds;
+
+    std::vector<UINT> indices;
+    std::vector<Meshlet> meshlets;
+};
+
+struct DagGroupContext
+{
+    const Vertex* vertices;
+    const UINT* sceneIndices;
+    UINT dagIndexBase;
+    const UINT* dagIndices;
+
+    const DagCluster* clusters;
+    const std::vector<UINT>* groups;
+    DagGroupResult* results;
+};
+
+static const UINT* GetClusterIndices(const DagGroupContext* context, const DagCluster* cluster)
+{
+    if (cluster->startIndex < context->dagIndexBase)
+        return context->sceneIndices + cluster->startIndex;
+
+    return context->dagIndices + (cluster->startIndex - context->dagIndexBase);
+}
+
+static Sphere MergeSpheres(const Sphere* spheres, UINT count)
+{
+    XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+    for (UINT i = 0; i < count; i++)
+    {
+        const XMVECTOR center = XMLoadFloat3(&spheres[i].center);
+        const XMVECTOR radius = XMVectorReplicate(spheres[i].radius);
+        minimum = XMVectorMin(minimum, XMVectorSubtract(center, radius));
+        maximum = XMVectorMax(maximum, XMVectorAdd(center, radius));
+    }
+
+    const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+
+    Sphere result;
+    XMStoreFloat3(&result.center, center);
+    result.radius = 0.0f;
+    for (UINT i = 0; i < count; i++)
+    {
+        const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&spheres[i].center), center)));
+        result.radius = (std::max)(result.radius, distance + spheres[i].radius);
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Agrupa clusters vizinhos (que compartilham arestas) de forma gulosa, preferindo o vizinho com mais arestas em comum.
+static void GroupClusters(const DagGroupContext* context, const std::vector<UINT>& current, std::vector<std::vector<UINT>>* groups)
+{
+    std::unordered_map<UINT64, UINT> edgeOwners;
+    std::unordered_map<UINT64, UINT> sharedEdges;
+
+    for (UINT slot = 0; slot < current.size(); slot++)
+    {
+        const DagCluster* cluster = &context->clusters[current[slot]];
+        const UINT* indices = GetClusterIndices(context, cluster);
+
+        for (UINT i = 0; i < cluster->triangleCount * 3; i += 3)
+        {
+            for (UINT e = 0; e < 3; e++)
+            {
+                const UINT a = indices[i + e];
+                const UINT b = indices[i + (e + 1) % 3];
+                const UINT64 edge = (static_cast<UINT64>((std::min)(a, b)) << 32) | (std::max)(a, b);
+
+                auto owner = edgeOwners.emplace(edge, slot);
+                if (!owner.second && owner.first->second != slot)
+                {
+                    const UINT s0 = (std::min)(owner.first->second, slot);
+                    const UINT s1 = (std::max)(owner.first->second, slot);
+                    sharedEdges[(static_cast<UINT64>(s0) << 32) | s1]++;
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<std::pair<UINT, UINT>>> neighbors(current.size());
+    for (const auto& shared : sharedEdges)
+    {
+        const UINT s0 = static_cast<UINT>(shared.first >> 32);
+        const UINT s1 = static_cast<UINT>(shared.first & 0xFFFFFFFF);
+        neighbors[s0].push_back({ s1, shared.second });
+        neighbors[s1].push_back({ s0, shared.second });
+    }
+
+    std::vector<BYTE> grouped(current.size(), 0);
+    for (UINT seed = 0; seed < current.size(); seed++)
+    {
+        if (grouped[seed])
+            continue;
+
+        std::vector<UINT> group(1, seed);
+        grouped[seed] = 1;
+
+        while (group.size() < ClusterGroupSize)
+        {
+            UINT best = UINT_MAX;
+            UINT bestWeight = 0;
+            for (UINT member : group)
+            {
+                for (const auto& neighbor : neighbors[member])
+                {
+                    if (!grouped[neighbor.first] && neighbor.second > bestWeight)
+                    {
+                        best = neighbor.first;
+                        bestWeight = neighbor.second;
+                    }
+                }
+            }
+
+            if (best == UINT_MAX)
+                break;
+
+            grouped[best] = 1;
+            group.push_back(best);
+        }
+
+        for (UINT& member : group)
+        {
+            member = current[member];
+        }
+        groups->push_back(group);
+    }
+}
+
+static void SimplifyGroupJob(void* context, UINT groupIndex)
+{
+    DagGroupContext* dag = reinterpret_cast<DagGroupContext*>(context);
+    const std::vector<UINT>& group = dag->groups[groupIndex];
+    DagGroupResult* result = &dag->results[groupIndex];
+
+    result->simplified = false;
+
+    // Compacta os vrtices do grupo: a simplificao e o agrupamento em meshlets so O(vrtices).
+    std::unordered_map<UINT, UINT> localIds;
+    std::vector<UINT> globalIds;
+    std::vector<Vertex> localVertices;
+    std::vector<UINT> localIndices;
+
+    float childError = 0.0f;
+    std::vector<Sphere> childBounds;
+
+    for (UINT clusterIndex : group)
+    {
+        const DagCluster* cluster = &dag->clusters[clusterIndex];
+        const UINT* indices = GetClusterIndices(dag, cluster);
+
+        for (UINT i = 0; i < cluster->triangleCount * 3; i++)
+        {
+            auto local = localIds.emplace(indices[i], static_cast<UINT>(globalIds.size()));
+            if (local.second)
+            {
+                globalIds.push_back(indices[i]);
+                localVertices.push_back(dag->vertices[indices[i]]);
+            }
+            localIndices.push_back(local.first->second);
+        }
+
+        childError = (std::max)(childError, cluster->lodError);
+        childBounds.push_back({ cluster->lodCenter, cluster->lodRadius });
+    }
+
+    const UINT vertexCount = static_cast<UINT>(localVertices.size());
+    const UINT indexCount = static_cast<UINT>(localIndices.size());
+
+    // A borda do grupo fica travada: os vizinhos de outros grupos continuam encaixando em qualquer corte.
+    SimplifyOptions options;
+    options.targetRatio = DagSimplifyRatio;
+    options.targetError = 1.0f;
+    options.colorWeight = DagColorWeight;
+    options.lockBorder = true;
+
+    std::vector<UINT> simplified(indexCount);
+    float relativeError = 0.0f;
+    const UINT count = SimplifyMesh(simplified.data(), localIndices.data(), indexCount, localVertices.data(), vertexCount, &options, &relativeError);
+
+    if (count == 0 || count > indexCount * DagMinReduction)
+        return;
+
+    XMVECTOR minimum = XMLoadFloat3(&localVertices[0].position);
+    XMVECTOR maximum = minimum;
+    for (UINT v = 1; v < vertexCount; v++)
+    {
+        minimum = XMVectorMin(minimum, XMLoadFloat3(&localVertices[v].position));
+        maximum = XMVectorMax(maximum, XMLoadFloat3(&localVertices[v].position));
+    }
+    XMFLOAT3 size;
+    XMStoreFloat3(&size, XMVectorSubtract(maximum, minimum));
+    const float extent = (std::max)((std::max)(size.x, size.y), size.z);
+
+    // Erro e limites do pai nunca menores que os dos filhos: o teste de corte fica monotnico.
+    result->simplified = true;
+    result->error = (std::max)(relativeError * extent, childError);
+    result->bounds = MergeSpheres(childBounds.data(), static_cast<UINT>(childBounds.size()));
+
+    BuildMeshlets(&result->meshlets, simplified.data(), count, 0, localVertices.data(), vertexCount);
+
+    result->indices.resize(count);
+    for (UINT i = 0; i < count; i++)
+    {
+        result->indices[i] = globalIds[simplified[i]];
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void BuildClusterDag(JobSystem* jobSystem, const Mesh* mesh, const Vertex* vertices, const Meshlet* meshlets, std::vector<UINT>* indices, std::vector<DagCluster>* clusters)
+{
+    std::vector<DagCluster> dag;
+    std::vector<UINT> dagIndices;
+    std::vector<UINT> current;
+
+    for (UINT i = 0; i < mesh->meshletCount; i++)
+    {
+        const Meshlet* meshlet = &meshlets[mesh->meshletOffset + i];
+        if (meshlet->triangleCount == 0)
+            continue;
+
+        DagCluster cluster;
+        cluster.startIndex = meshlet->startIndex;
+        cluster.triangleCount = meshlet->triangleCount;
+        cluster.level = 0;
+        cluster.center = meshlet->center;
+        cluster.radius = meshlet->radius;
+        cluster.coneAxis = meshlet->coneAxis;
+        cluster.coneCutoff = meshlet->coneCutoff;
+        cluster.lodCenter = meshlet->center;
+        cluster.lodRadius = meshlet->radius;
+        cluster.lodError = 0.0f;
+        cluster.parentCenter = meshlet->center;
+        cluster.parentRadius = meshlet->radius;
+        cluster.parentError = FLT_MAX;
+
+        current.push_back(static_cast<UINT>(dag.size()));
+        dag.push_back(cluster);
+    }
+
+    DagGroupContext context;
+    context.vertices = vertices + mesh->baseVertex;
+    context.dagIndexBase = static_cast<UINT>(indices->size());
+
+    for (UINT level = 1; current.size() > 1; level++)
+    {
+        context.sceneIndices = indices->data();
+        context.dagIndices = dagIndices.data();
+        context.clusters = dag.data();
+
+        std::vector<std::vector<UINT>> groups;
+        GroupClusters(&context, current, &groups);
+
+        std::vector<DagGroupResult> results(groups.size());
+        context.groups = groups.data();
+        context.results = results.data();
+
+        ParallelFor(jobSystem, static_cast<UINT>(groups.size()), SimplifyGroupJob, &context);
+
+        std::vector<UINT> next;
+        bool simplified = false;
+        for (UINT g = 0; g < groups.size(); g++)
+        {
+            const DagGroupResult* result = &results[g];
+
+            // Grupo que no simplifica (pequeno demais ou quase todo borda) passa adiante para ser reagrupado.
+            if (!result->simplified)
+            {
+                next.insert(next.end(), groups[g].begin(), groups[g].end());
+                continue;
+            }
+
+            simplified = true;
+            for (UINT child : groups[g])
+            {
+                dag[child].parentCenter = result->bounds.center;
+                dag[child].parentRadius = result->bounds.radius;
+                dag[child].parentError = result->error;
+            }
+
+            const UINT offset = context.dagIndexBase + static_cast<UINT>(dagIndices.size());
+            dagIndices.insert(dagIndices.end(), result->indices.begin(), result->indices.end());
+
+            for (const Meshlet& meshlet : result->meshlets)
+            {
+                DagCluster cluster;
+                cluster.startIndex = offset + meshlet.startIndex;
+                cluster.triangleCount = meshlet.triangleCount;
+                cluster.level = level;
+                cluster.center = meshlet.center;
+                cluster.radius = meshlet.radius;
+                cluster.coneAxis = meshlet.coneAxis;
+                cluster.coneCutoff = meshlet.coneCutoff;
+                cluster.lodCenter = result->bounds.center;
+                cluster.lodRadius = result->bounds.radius;
+                cluster.lodError = result->error;
+                cluster.parentCenter = result->bounds.center;
+                cluster.parentRadius = result->bounds.radius;
+                cluster.parentError = FLT_MAX;
+
+                next.push_back(static_cast<UINT>(dag.size()));
+                dag.push_back(cluster);
+            }
+        }
+
+        // Sem reduo, os clusters restantes ficam como razes (parentError continua FLT_MAX).
+        if (!simplified)
+            break;
+
+        current.swap(next);
+    }
+
+    indices->insert(indices->end(), dagIndices.begin(), dagIndices.end());
+    clusters->insert(clusters->end(), dag.begin(), dag.end());
+}
+
+void BuildSceneClusterDags(JobSystem* jobSystem, Mesh* meshes, UINT meshCount, const Vertex* vertices, const Meshlet* meshlets, std::vector<UINT>* indices, std::vector<DagCluster>* clusters, std::vector<DagClusterBounds4>* bounds)
+{
+    for (UINT m = 0; m < meshCount; m++)
+    {
+        Mesh* mesh = &meshes[m];
+        mesh->dagClusterOffset = static_cast<UINT>(clusters->size());
+        mesh->dagClusterCount = 0;
+
+        if (mesh->meshletCount == 0 || mesh->lods[0].indexCount / 3 < MinDagTriangleCount)
+            continue;
+
+        // Os grupos de cada nvel so simplificados em paralelo; as malhas, uma de cada vez.
+        BuildClusterDag(jobSystem, mesh, vertices, meshlets, indices, clusters);
+
+        DagCluster empty = {};
+        empty.radius = -1.0f;
+        empty.coneCutoff = 1.0f;
+        empty.lodError = FLT_MAX;
+        while ((clusters->size() - mesh->dagClusterOffset) % 4 != 0)
+            clusters->push_back(empty);
+
+        mesh->dagClusterCount = static_cast<UINT>(clusters->size()) - mesh->dagClusterOffset;
+
+        for (UINT i = mesh->dagClusterOffset; i < clusters->size(); i += 4)
+        {
+            const DagCluster* c = &(*clusters)[i];
+
+            DagClusterBounds4 block;
+            block.centerX = XMFLOAT4(c[0].center.x, c[1].center.x, c[2].center.x, c[3].center.x);
+            block.centerY = XMFLOAT4(c[0].center.y, c[1].center.y, c[2].center.y, c[3].center.y);
+            block.centerZ = XMFLOAT4(c[0].center.z, c[1].center.z, c[2].center.z, c[3].center.z);
+            block.radius = XMFLOAT4(c[0].radius, c[1].radius, c[2].radius, c[3].radius);
+            block.coneAxisX = XMFLOAT4(c[0].coneAxis.x, c[1].coneAxis.x, c[2].coneAxis.x, c[3].coneAxis.x);
+            block.coneAxisY = XMFLOAT4(c[0].coneAxis.y, c[1].coneAxis.y, c[2].coneAxis.y, c[3].coneAxis.y);
+            block.coneAxisZ = XMFLOAT4(c[0].coneAxis.z, c[1].coneAxis.z, c[2].coneAxis.z, c[3].coneAxis.z);
+            block.coneCutoff = XMFLOAT4(c[0].coneCutoff, c[1].coneCutoff, c[2].coneCutoff, c[3].coneCutoff);
+            block.lodCenterX = XMFLOAT4(c[0].lodCenter.x, c[1].lodCenter.x, c[2].lodCenter.x, c[3].lodCenter.x);
+            block.lodCenterY = XMFLOAT4(c[0].lodCenter.y, c[1].lodCenter.y, c[2].lodCenter.y, c[3].lodCenter.y);
+            block.lodCenterZ = XMFLOAT4(c[0].lodCenter.z, c[1].lodCenter.z, c[2].lodCenter.z, c[3].lodCenter.z);
+            block.lodRadius = XMFLOAT4(c[0].lodRadius, c[1].lodRadius, c[2].lodRadius, c[3].lodRadius);
+            block.lodError = XMFLOAT4(c[0].lodError, c[1].lodError, c[2].lodError, c[3].lodError);
+            block.parentCenterX = XMFLOAT4(c[0].parentCenter.x, c[1].parentCenter.x, c[2].parentCenter.x, c[3].parentCenter.x);
+            block.parentCenterY = XMFLOAT4(c[0].parentCenter.y, c[1].parentCenter.y, c[2].parentCenter.y, c[3].parentCenter.y);
+            block.parentCenterZ = XMFLOAT4(c[0].parentCenter.z, c[1].parentCenter.z, c[2].parentCenter.z, c[3].parentCenter.z);
+            block.parentRadius = XMFLOAT4(c[0].parentRadius, c[1].parentRadius, c[2].parentRadius, c[3].parentRadius);
+            block.parentError = XMFLOAT4(c[0].parentError, c[1].parentError, c[2].parentError, c[3].parentError);
+            bounds->push_back(block);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct DagCutJob
+{
+    UINT drawIndex;
+    UINT firstBlock;
+    UINT blockCount;
+};
+
+struct DagCutContext
+{
+    float errorPerDistance;
+    const LodView* lodView;
+    const Mesh* meshes;
+    const DagClusterBounds4* bounds;
+    const DagCluster* clusters;
+    const Model* models;
+    const DrawCommand* draws;
+
+    const DagCutJob* jobs;
+    std::vector<DrawCommand>* results;
+};
+
+// Distncia at a esfera, limitada pelo plano prximo.
+static XMVECTOR SphereDistance(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, GXMVECTOR radius, const XMFLOAT3& camera, float nearPlane)
+{
+    const XMVECTOR dx = XMVectorSubtract(x, XMVectorReplicate(camera.x));
+    const XMVECTOR dy = XMVectorSubtract(y, XMVectorReplicate(camera.y));
+    const XMVECTOR dz = XMVectorSubtract(z, XMVectorReplicate(camera.z));
+    const XMVECTOR distance = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+
+    return XMVectorMax(XMVectorSubtract(distance, radius), XMVectorReplicate(nearPlane));
+}
+
+static void SelectClusterCutJob(void* context, UINT jobIndex)
+{
+    DagCutContext* cut = reinterpret_cast<DagCutContext*>(context);
+    const DagCutJob* job = &cut->jobs[jobIndex];
+    const DrawCommand* draw = &cut->draws[job->drawIndex];
+    const Mesh* mesh = &cut->meshes[cut->models[draw->modelIndex].meshIndex];
+    std::vector<DrawCommand>* result = &cut->results[jobIndex];
+
+    // No espao do modelo a escala se cancela: erro e distncia crescem juntos.
+    XMFLOAT3 camera;
+    XMFLOAT4 planes[6];
+    GetModelSpaceView(cut->lodView, &cut->models[draw->modelIndex].world, &camera, planes);
+
+    const XMVECTOR errorPerDistance = XMVectorReplicate(cut->errorPerDistance);
+    const float nearPlane = cut->lodView->nearPlane;
+
+    const DagClusterBounds4* blocks = cut->bounds + mesh->dagClusterOffset / 4;
+    const DagCluster* clusters = cut->clusters + mesh->dagClusterOffset;
+
+    for (UINT b = job->firstBlock; b < job->firstBlock + job->blockCount; b++)
+    {
+        const DagClusterBounds4* block = &blocks[b];
+
+        const XMVECTOR lodDistance = SphereDistance(XMLoadFloat4(&block->lodCenterX), XMLoadFloat4(&block->lodCenterY), XMLoadFloat4(&block->lodCenterZ), XMLoadFloat4(&block->lodRadius), camera, nearPlane);
+        const XMVECTOR parentDistance = SphereDistance(XMLoadFloat4(&block->parentCenterX), XMLoadFloat4(&block->parentCenterY), XMLoadFloat4(&block->parentCenterZ), XMLoadFloat4(&block->parentRadius), camera, nearPlane);
+
+        // Desenha se o prprio erro cabe no limite e o do pai no cabe.
+        XMVECTOR selected = XMVectorAndCInt(
+            XMVectorGreaterOrEqual(XMVectorMultiply(lodDistance, errorPerDistance), XMLoadFloat4(&block->lodError)),
+            XMVectorGreaterOrEqual(XMVectorMultiply(parentDistance, errorPerDistance), XMLoadFloat4(&block->parentError)));
+
+        const XMVECTOR x = XMLoadFloat4(&block->centerX);
+        const XMVECTOR y = XMLoadFloat4(&block->centerY);
+        const XMVECTOR z = XMLoadFloat4(&block->centerZ);
+        const XMVECTOR r = XMLoadFloat4(&block->radius);
+        const XMVECTOR negativeRadius = XMVectorNegate(r);
+
+        selected = XMVectorAndInt(selected, XMVectorGreaterOrEqual(r, XMVectorZero()));
+        for (UINT p = 0; p < 6; p++)
+        {
+            XMVECTOR distance = XMVectorMultiplyAdd(XMVectorReplicate(planes[p].x), x, XMVectorReplicate(planes[p].w));
+            distance = XMVectorMultiplyAdd(XMVectorReplicate(planes[p].y), y, distance);
+            distance = XMVectorMultiplyAdd(XMVectorReplicate(planes[p].z), z, distance);
+            selected = XMVectorAndInt(selected, XMVectorGreater(distance, negativeRadius));
+        }
+
+        const XMVECTOR dx = XMVectorSubtract(x, XMVectorReplicate(camera.x));
+        const XMVECTOR dy = XMVectorSubtract(y, XMVectorReplicate(camera.y));
+        const XMVECTOR dz = XMVectorSubtract(z, XMVectorReplicate(camera.z));
+        const XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+
+        XMVECTOR coneDot = XMVectorMultiply(dx, XMLoadFloat4(&block->coneAxisX));
+        coneDot = XMVectorMultiplyAdd(dy, XMLoadFloat4(&block->coneAxisY), coneDot);
+        coneDot = XMVectorMultiplyAdd(dz, XMLoadFloat4(&block->coneAxisZ), coneDot);
+        selected = XMVectorAndCInt(selected, XMVectorGreaterOrEqual(coneDot, XMVectorMultiplyAdd(XMLoadFloat4(&block->coneCutoff), length, r)));
+
+        XMUINT4 mask;
+        XMStoreUInt4(&mask, selected);
+        const UINT lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+
+        for (UINT k = 0; k < 4; k++)
+        {
+            const DagCluster* cluster = &clusters[b * 4 + k];
+            if (!lanes[k] || cluster->triangleCount == 0)
+                continue;
+
+            if (!result->empty() && result->back().startIndex + result->back().indexCount == cluster->startIndex)
+            {
+                result->back().indexCount += cluster->triangleCount * 3;
+            }
+            else
+            {
+                result->push_back({ draw->modelIndex, cluster->triangleCount * 3, cluster->startIndex, draw->baseVertex });
+            }
+        }
+    }
+}
+
+void SelectClusterCuts(JobSystem* jobSystem, const LodSelectionSettings* settings, const LodView* lodView, const Mesh* meshes, const DagClusterBounds4* bounds, const DagCluster* clusters, const Model* models, std::vector<DrawCommand>* drawList)
+{
+    std::vector<DagCutJob> jobs;
+
+    for (UINT d = 0; d < drawList->size(); d++)
+    {
+        const Mesh* mesh = &meshes[models[(*drawList)[d].modelIndex].meshIndex];
+        if (mesh->dagClusterCount == 0)
+            continue;
+
+        const UINT blockCount = mesh->dagClusterCount / 4;
+        for (UINT first = 0; first < blockCount; first += DagClusterBlocksPerJob)
+        {
+            jobs.push_back({ d, first, (std::min)(DagClusterBlocksPerJob, blockCount - first) });
+        }
+    }
+
+    if (jobs.empty())
+        return;
+
+    std::vector<std::vector<DrawCommand>> results(jobs.size());
+
+    DagCutContext context;
+    context.errorPerDistance = settings->errorThresholdPixels * powf(2.0f, settings->lodBias) / lodView->projectionScale;
+    context.lodView = lodView;
+    context.meshes = meshes;
+    context.bounds = bounds;
+    context.clusters = clusters;
+    context.models = models;
+    context.draws = drawList->data();
+    context.jobs = jobs.data();
+    context.results = results.data();
+
+    ParallelFor(jobSystem, static_cast<UINT>(jobs.size()), SelectClusterCutJob, &context);
+
+    std::vector<DrawCommand> cutDraws;
+    cutDraws.reserve(drawList->size() + jobs.size());
+
+    UINT job = 0;
+    for (UINT d = 0; d < drawList->size(); d++)
+    {
+        if (job < jobs.size() && jobs[job].drawIndex == d)
+        {
+            for (; job < jobs.size() && jobs[job].drawIndex == d; job++)
+            {
+                cutDraws.insert(cutDraws.end(), results[job].begin(), results[job].end());
+            }
+        }
+        else
+        {
+            cutDraws.push_back((*drawList)[d]);
+        }
+    }
+
+    drawList->swap(cutDraws);
+}
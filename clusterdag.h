@@ -0,0 +1,56 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+#include "lodselect.h"
+#include "meshlet.h"
+
+#include <vector>
+
+// Nmero de clusters agrupados e simplificados juntos a cada nvel do DAG.
+const UINT ClusterGroupSize = 8;
+
+// Malhas com pelo menos este nmero de tringulos recebem um DAG de clusters alm da cadeia de LODs.
+const UINT MinDagTriangleCount = 65536;
+
+// N do DAG de clusters. O nvel 0 so os meshlets da malha original; cada nvel seguinte vem de grupos de
+// clusters vizinhos simplificados com a borda do grupo travada, e por isso os cortes no abrem rachaduras.
+// O cluster  desenhado quando o prprio erro projetado cabe no limite e o do grupo pai no cabe.
+struct DagCluster
+{
+    UINT startIndex;
+    UINT triangleCount;
+    UINT level;
+
+    XMFLOAT3 center;
+    float radius;
+    XMFLOAT3 coneAxis;
+    float coneCutoff;
+
+    XMFLOAT3 lodCenter;
+    float lodRadius;
+    float lodError;
+
+    // FLT_MAX para as razes.
+    XMFLOAT3 parentCenter;
+    float parentRadius;
+    float parentError;
+};
+
+struct DagClusterBounds4
+{
+    XMFLOAT4 centerX, centerY, centerZ, radius;
+    XMFLOAT4 coneAxisX, coneAxisY, coneAxisZ, coneCutoff;
+    XMFLOAT4 lodCenterX, lodCenterY, lodCenterZ, lodRadius, lodError;
+    XMFLOAT4 parentCenterX, parentCenterY, parentCenterZ, parentRadius, parentError;
+};
+
+// Constri o DAG a partir dos meshlets do nvel 0 da malha. Os ndices dos nveis simplificados so anexados a
+// indices (sobre os mesmos vrtices da malha) e os clusters a clusters.
+void BuildClusterDag(JobSystem* jobSystem, const Mesh* mesh, const Vertex* vertices, const Meshlet* meshlets, std::vector<UINT>* indices, std::vector<DagCluster>* clusters);
+
+void BuildSceneClusterDags(JobSystem* jobSystem, Mesh* meshes, UINT meshCount, const Vertex* vertices, const Meshlet* meshlets, std::vector<UINT>* indices, std::vector<DagCluster>* clusters, std::vector<DagClusterBounds4>* bounds);
+
+// Escolhe o corte do DAG de cada modelo visvel pelo erro projetado e substitui o seu comando de desenho pelas
+// faixas dos clusters escolhidos que passam no frustum e no cone.
+void SelectClusterCuts(JobSystem* jobSystem, const LodSelectionSettings* settings, const LodView* lodView, const Mesh* meshes, const DagClusterBounds4* bounds, const DagCluster* clusters, const Model* models, std::vector<DrawCommand>* drawList);
@@ -0,0 +1,460 @@
+#include "infinity.h"
+#include "atlaspack.h"
+#include "gltfimport.h"
+#include "jobs.h"
+#include "lodselect.h"
+#include "meshformat.h"
+#include "meshlet.h"
+#include "meshsimplify.h"
+#include "mipgen.h"
+#include "objimport.h"
+#include "pakfile.h"
+#include "texcompress.h"
+#include "textureformat.h"
+#include "tgaimport.h"
+
+#include <shellapi.h>
+#include <algorithm>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Ferramenta offline que converte .obj/.glb no formato .imesh: importa, gera as cadeias de LOD, agrupa o
+// nvel 0 em meshlets, reordena os vrtices pela ordem de uso e grava as sees prontas para a engine. Tambm
+// empacota arquivos j cozidos num .pak comprimido e comprime texturas .tga, com a cadeia de mips, em blocos BC
+// num .dds, sozinhas ou juntas em atlas.
+
+// -----------------------------------------------------------------------------------------------------
+
+struct ReorderVerticesContext
+{
+    const Mesh* meshes;
+    Vertex* vertices;
+    UINT* indices;
+};
+
+static void ReorderVerticesJob(void* context, UINT jobIndex)
+{
+    ReorderVerticesContext* ctx = reinterpret_cast<ReorderVerticesContext*>(context);
+    const Mesh* mesh = &ctx->meshes[jobIndex];
+    const UINT baseVertex = mesh->baseVertex;
+
+    // Numera os vrtices na ordem em que o nvel 0 (e depois os demais) os referencia: vrtices vizinhos no
+    // index buffer ficam vizinhos na memria.
+    std::vector<UINT> remap(mesh->vertexCount, UINT_MAX);
+    UINT nextVertex = 0;
+    for (UINT lod = 0; lod < mesh->lodCount; lod++)
+    {
+        const MeshLod* meshLod = &mesh->lods[lod];
+        for (UINT i = 0; i < meshLod->indexCount; i++)
+        {
+            UINT* index = &ctx->indices[meshLod->startIndex + i];
+            if (*index >= mesh->vertexCount)
+                continue;
+
+            if (remap[*index] == UINT_MAX)
+                remap[*index] = nextVertex++;
+
+            *index = remap[*index];
+        }
+    }
+
+    // Vrtices sem uso vo para o fim da faixa.
+    for (UINT v = 0; v < mesh->vertexCount; v++)
+    {
+        if (remap[v] == UINT_MAX)
+            remap[v] = nextVertex++;
+    }
+
+    std::vector<Vertex> reordered(mesh->vertexCount);
+    for (UINT v = 0; v < mesh->vertexCount; v++)
+    {
+        reordered[remap[v]] = ctx->vertices[baseVertex + v];
+    }
+
+    std::copy(reordered.begin(), reordered.end(), ctx->vertices + baseVertex);
+}
+
+static void CookScene(JobSystem* jobSystem, const wchar_t* inputPath, const wchar_t* outputPath)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    std::vector<Mesh> meshes;
+    std::vector<Model> models;
+
+    const size_t length = wcslen(inputPath);
+    if (length > 4 && _wcsicmp(inputPath + length - 4, L".glb") == 0)
+    {
+        ImportGltf(jobSystem, inputPath, &vertices, &indices, &meshes, &models);
+    }
+    else
+    {
+        ImportObj(jobSystem, inputPath, &vertices, &indices, &meshes);
+
+        for (UINT i = 0; i < meshes.size(); i++)
+        {
+            Model model = {};
+            model.meshIndex = i;
+            XMStoreFloat4x4(&model.world, XMMatrixIdentity());
+            models.push_back(model);
+        }
+    }
+
+    const UINT meshCount = static_cast<UINT>(meshes.size());
+    BuildLodChains(jobSystem, meshes.data(), meshCount, vertices.data(), &indices, &DefaultLodChainOptions);
+
+    // Os meshlets so refeitos na carga; aqui s interessa a ordem de ndices por cluster que eles deixam no nvel 0.
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds4> meshletBounds;
+    BuildSceneMeshlets(jobSystem, meshes.data(), meshCount, vertices.data(), &indices, &meshlets, &meshletBounds);
+
+    ReorderVerticesContext reorderContext = { meshes.data(), vertices.data(), indices.data() };
+    ParallelFor(jobSystem, meshCount, ReorderVerticesJob, &reorderContext);
+
+    for (Mesh& mesh : meshes)
+    {
+        ComputeMeshBounds(&mesh, vertices.data(), indices.data());
+    }
+
+    ThrowIfFailed(SaveBakedMesh(outputPath, vertices.data(), static_cast<UINT>(vertices.size()), indices.data(), static_cast<UINT>(indices.size()),
+        meshes.data(), meshCount, models.data(), static_cast<UINT>(models.size())));
+
+    printf("%u malhas, %u modelos, %zu vertices, %zu indices\n", meshCount, static_cast<UINT>(models.size()), vertices.size(), indices.size());
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct TextureFormatOption
+{
+    const wchar_t* name;
+    BlockFormat format;
+    DXGI_FORMAT linearFormat;
+    DXGI_FORMAT srgbFormat;
+};
+
+// O BC5 guarda dados (normais), no cor: no tem variante sRGB.
+static const TextureFormatOption TextureFormatOptions[] =
+{
+    { L"bc1", BlockFormatBC1, DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC1_UNORM_SRGB },
+    { L"bc3", BlockFormatBC3, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC3_UNORM_SRGB },
+    { L"bc5", BlockFormatBC5, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_UNORM },
+    { L"bc7", BlockFormatBC7, DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC7_UNORM_SRGB },
+};
+
+static const wchar_t* CompressionQualityNames[] = { L"rapido", L"normal", L"alto" };
+
+static const wchar_t* MipFilterNames[] = { L"caixa", L"kaiser" };
+
+static double GetElapsedSeconds(const LARGE_INTEGER* start)
+{
+    LARGE_INTEGER frequency, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&end);
+
+    return static_cast<double>(end.QuadPart - start->QuadPart) / frequency.QuadPart;
+}
+
+// Comprime os nveis em sequncia, no layout de SaveDds.
+static void CompressMipChain(JobSystem* jobSystem, const BYTE* pixels, const MipLevel* levels, UINT levelCount, BlockFormat format, CompressionQuality quality, std::vector<BYTE>* blocks)
+{
+    std::vector<size_t> blockOffsets(levelCount + 1, 0);
+    for (UINT i = 0; i < levelCount; i++)
+    {
+        blockOffsets[i + 1] = blockOffsets[i] + static_cast<size_t>((levels[i].width + 3) / 4) * ((levels[i].height + 3) / 4) * GetBlockBytes(format);
+    }
+
+    blocks->resize(blockOffsets[levelCount]);
+
+    for (UINT i = 0; i < levelCount; i++)
+    {
+        CompressTexture(jobSystem, pixels + levels[i].offset, levels[i].width, levels[i].height, levels[i].rowPitch, format, quality, blocks->data() + blockOffsets[i]);
+    }
+}
+
+static void CookTexture(JobSystem* jobSystem, const wchar_t* inputPath, const wchar_t* outputPath, const TextureFormatOption* option, CompressionQuality quality, const MipOptions* mipOptions)
+{
+    std::vector<BYTE> pixels;
+    UINT width, height;
+    ThrowIfFailed(ImportTga(inputPath, &pixels, &width, &height));
+
+    // O nvel 0 j est no lugar certo: a cadeia contgua comea nele.
+    MipLevel levels[32];
+    const UINT levelCount = GetMipLevelCount(width, height);
+    pixels.resize(static_cast<size_t>(GetMipChainLayout(width, height, levelCount, 1, 1, levels)));
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    GenerateMips(jobSystem, pixels.data(), levels, levelCount, mipOptions);
+
+    const double mipSeconds = GetElapsedSeconds(&start);
+
+    std::vector<BYTE> blocks;
+
+    QueryPerformanceCounter(&start);
+
+    CompressMipChain(jobSystem, pixels.data(), levels, levelCount, option->format, quality, &blocks);
+
+    const double compressSeconds = GetElapsedSeconds(&start);
+
+    // A qualidade  medida no nvel 0, contra a prpria decodificao dos blocos.
+    std::vector<BYTE> decoded(static_cast<size_t>(levels[0].rowPitch) * height);
+    DecompressTexture(blocks.data(), width, height, option->format, decoded.data(), levels[0].rowPitch);
+    const double psnr = ComputeTexturePsnr(pixels.data(), decoded.data(), width, height, levels[0].rowPitch, option->format);
+
+    const DXGI_FORMAT format = mipOptions->srgb ? option->srgbFormat : option->linearFormat;
+    ThrowIfFailed(SaveDds(outputPath, format, width, height, levelCount, blocks.data(), blocks.size()));
+
+    const double megapixels = width * static_cast<double>(height) / 1000000.0;
+    printf("%ux%u, %u mips em %.0f ms (%.1f megapixels/s)\n", width, height, levelCount, mipSeconds * 1000.0, megapixels / mipSeconds);
+    printf("compressao %.1f megapixels/s, PSNR %.2f dB\n", megapixels / compressSeconds, psnr);
+}
+
+// Tempo de GenerateMips em texturas sintticas de 8K e 16K, geradas na memria: o tempo no inclui a leitura do
+// .tga nem a compresso. Cada tamanho roda algumas vezes e vale a melhor.
+static void BenchmarkMips(JobSystem* jobSystem, const MipOptions* mipOptions)
+{
+    const UINT sizes[] = { 8192, 16384 };
+    const UINT runCount = 3;
+
+    for (UINT size : sizes)
+    {
+        MipLevel levels[32];
+        const UINT levelCount = GetMipLevelCount(size, size);
+        std::vector<BYTE> pixels(static_cast<size_t>(GetMipChainLayout(size, size, levelCount, 1, 1, levels)));
+
+        // Rudo xorshift: nenhum filtro tem atalho para regies uniformes.
+        UINT state = 1;
+        for (size_t i = 0; i < static_cast<size_t>(levels[0].rowPitch) * size; i += 4)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            memcpy(&pixels[i], &state, 4);
+        }
+
+        double bestSeconds = 0.0;
+        for (UINT run = 0; run < runCount; run++)
+        {
+            LARGE_INTEGER start;
+            QueryPerformanceCounter(&start);
+
+            GenerateMips(jobSystem, pixels.data(), levels, levelCount, mipOptions);
+
+            const double seconds = GetElapsedSeconds(&start);
+            bestSeconds = run == 0 ? seconds : (std::min)(bestSeconds, seconds);
+        }
+
+        const double megapixels = size * static_cast<double>(size) / 1000000.0;
+        printf("%ux%u, %u mips (%ls): melhor de %u em %.0f ms (%.1f megapixels/s)\n", size, size, levelCount, MipFilterNames[mipOptions->filter], runCount,
+            bestSeconds * 1000.0, megapixels / bestSeconds);
+    }
+}
+
+// Empacota as texturas em atlas saida0.dds, saida1.dds... e grava a tabela de UVs em saida.atlas. Os mips param
+// onde o padding deixa de separar as texturas com o filtro escolhido, ou os blocos BC de 4x4 passam a cruzar as
+// faixas.
+static void CookAtlas(JobSystem* jobSystem, const wchar_t* outputPath, const std::vector<const wchar_t*>* inputPaths, const TextureFormatOption* option, CompressionQuality quality, const MipOptions* mipOptions)
+{
+    const UINT textureCount = static_cast<UINT>(inputPaths->size());
+    std::vector<std::vector<BYTE>> images(textureCount);
+    std::vector<UINT> widths(textureCount);
+    std::vector<UINT> heights(textureCount);
+
+    for (UINT i = 0; i < textureCount; i++)
+    {
+        ThrowIfFailed(ImportTga((*inputPaths)[i], &images[i], &widths[i], &heights[i]));
+    }
+
+    const AtlasSettings settings = DefaultAtlasSettings;
+    std::vector<AtlasRect> rects;
+    std::vector<AtlasInfo> atlases;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    ThrowIfFailed(PackAtlases(widths.data(), heights.data(), textureCount, &settings, &rects, &atlases));
+
+    const double packSeconds = GetElapsedSeconds(&start);
+
+    UINT64 usedTexels = 0;
+    UINT64 slotTexels = 0;
+    UINT64 atlasTexels = 0;
+
+    for (UINT atlas = 0; atlas < atlases.size(); atlas++)
+    {
+        const AtlasInfo* info = &atlases[atlas];
+        const UINT levelCount = (std::min)(GetAtlasMipLevelCount(&settings, GetMipFilterRadius(mipOptions->filter), 4), GetMipLevelCount(info->width, info->height));
+
+        // O fundo fica transparente; s o padding em volta de cada textura entra nos mips dela.
+        MipLevel levels[32];
+        std::vector<BYTE> pixels(static_cast<size_t>(GetMipChainLayout(info->width, info->height, levelCount, 1, 1, levels)), 0);
+
+        for (UINT i = 0; i < textureCount; i++)
+        {
+            if (rects[i].atlas == atlas)
+                CopyToAtlas(images[i].data(), widths[i], heights[i], &rects[i], settings.padding, pixels.data(), levels[0].rowPitch);
+        }
+
+        GenerateMips(jobSystem, pixels.data(), levels, levelCount, mipOptions);
+
+        std::vector<BYTE> blocks;
+        CompressMipChain(jobSystem, pixels.data(), levels, levelCount, option->format, quality, &blocks);
+
+        const std::wstring path = std::wstring(outputPath) + std::to_wstring(atlas) + L".dds";
+        const DXGI_FORMAT format = mipOptions->srgb ? option->srgbFormat : option->linearFormat;
+        ThrowIfFailed(SaveDds(path.c_str(), format, info->width, info->height, levelCount, blocks.data(), blocks.size()));
+
+        usedTexels += info->usedTexels;
+        slotTexels += info->slotTexels;
+        atlasTexels += static_cast<UINT64>(info->width) * info->height;
+    }
+
+    const std::wstring tablePath = std::wstring(outputPath) + L".atlas";
+    ThrowIfFailed(SaveAtlasTable(tablePath.c_str(), rects.data(), textureCount, atlases.data(), static_cast<UINT>(atlases.size())));
+
+    // Cada textura deixa de ter descritor prprio: os materiais que s mudavam de textura passam a compartilhar o
+    // mesmo atlas.
+    printf("%u texturas em %u atlas, empacotadas em %.1f ms\n", textureCount, static_cast<UINT>(atlases.size()), packSeconds * 1000.0);
+    printf("ocupacao %.1f%% (%.1f%% com padding), descritores %u -> %u\n", 100.0 * usedTexels / atlasTexels, 100.0 * slotTexels / atlasTexels,
+        textureCount, static_cast<UINT>(atlases.size()));
+}
+
+// Qualidade, filtro e -srgb/-repetir, comuns a -texture e -atlas. Devolve false se a opo no for nenhuma delas.
+static bool ParseTextureOption(const wchar_t* arg, CompressionQuality* quality, MipOptions* mipOptions)
+{
+    if (wcscmp(arg, L"-srgb") == 0)
+    {
+        mipOptions->srgb = true;
+        return true;
+    }
+
+    if (wcscmp(arg, L"-repetir") == 0)
+    {
+        mipOptions->wrap = true;
+        return true;
+    }
+
+    for (UINT q = 0; q < _countof(CompressionQualityNames); q++)
+    {
+        if (wcscmp(arg, CompressionQualityNames[q]) == 0)
+        {
+            *quality = static_cast<CompressionQuality>(q);
+            return true;
+        }
+    }
+
+    for (UINT f = 0; f < _countof(MipFilterNames); f++)
+    {
+        if (wcscmp(arg, MipFilterNames[f]) == 0)
+        {
+            mipOptions->filter = static_cast<MipFilter>(f);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    // Cooker.exe entrada.(obj|glb) saida.imesh
+    // Cooker.exe -pak saida.pak arquivo...
+    // Cooker.exe -texture entrada.tga saida.dds (bc1|bc3|bc5|bc7) [rapido|normal|alto] [caixa|kaiser] [-srgb] [-repetir]
+    // Cooker.exe -atlas saida (bc1|bc3|bc5|bc7) [rapido|normal|alto] [caixa|kaiser] [-srgb] entrada.tga...
+    // Cooker.exe -mipbench [caixa|kaiser] [-srgb] [-repetir]
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    const bool pack = argv && argc >= 4 && wcscmp(argv[1], L"-pak") == 0;
+    const bool texture = argv && argc >= 5 && wcscmp(argv[1], L"-texture") == 0;
+    const bool atlas = argv && argc >= 5 && wcscmp(argv[1], L"-atlas") == 0;
+    const bool mipBench = argv && argc >= 2 && wcscmp(argv[1], L"-mipbench") == 0;
+
+    // -texture tem o formato em argv[4]; -atlas, em argv[3], seguido de opes e das texturas em qualquer ordem.
+    const TextureFormatOption* textureFormat = nullptr;
+    CompressionQuality quality = CompressionNormal;
+    MipOptions mipOptions = DefaultMipOptions;
+    std::vector<const wchar_t*> atlasInputs;
+    bool validOptions = true;
+    if (texture || atlas)
+    {
+        const int formatArg = texture ? 4 : 3;
+        for (const TextureFormatOption& option : TextureFormatOptions)
+        {
+            if (_wcsicmp(argv[formatArg], option.name) == 0)
+                textureFormat = &option;
+        }
+
+        for (int i = formatArg + 1; i < argc; i++)
+        {
+            if (ParseTextureOption(argv[i], &quality, &mipOptions))
+                continue;
+
+            if (atlas)
+                atlasInputs.push_back(argv[i]);
+            else
+                validOptions = false;
+        }
+
+        validOptions = validOptions && textureFormat && (texture || !atlasInputs.empty());
+    }
+    else if (mipBench)
+    {
+        for (int i = 2; i < argc; i++)
+            validOptions = validOptions && ParseTextureOption(argv[i], &quality, &mipOptions);
+    }
+
+    if (!argv || (!pack && !texture && !atlas && !mipBench && argc != 3) || !validOptions)
+    {
+        printf("uso: Cooker.exe entrada.(obj|glb) saida.imesh\n");
+        printf("     Cooker.exe -pak saida.pak arquivo...\n");
+        printf("     Cooker.exe -texture entrada.tga saida.dds (bc1|bc3|bc5|bc7) [rapido|normal|alto] [caixa|kaiser] [-srgb] [-repetir]\n");
+        printf("     Cooker.exe -atlas saida (bc1|bc3|bc5|bc7) [rapido|normal|alto] [caixa|kaiser] [-srgb] entrada.tga...\n");
+        printf("     Cooker.exe -mipbench [caixa|kaiser] [-srgb] [-repetir]\n");
+        LocalFree(argv);
+        return 1;
+    }
+
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem);
+
+    int result = 0;
+    try
+    {
+        if (pack)
+        {
+            ThrowIfFailed(SavePak(&jobSystem, argv[2], argv + 3, argc - 3));
+            printf("%d arquivos empacotados\n", argc - 3);
+        }
+        else if (texture)
+        {
+            CookTexture(&jobSystem, argv[2], argv[3], textureFormat, quality, &mipOptions);
+        }
+        else if (atlas)
+        {
+            CookAtlas(&jobSystem, argv[2], &atlasInputs, textureFormat, quality, &mipOptions);
+        }
+        else if (mipBench)
+        {
+            BenchmarkMips(&jobSystem, &mipOptions);
+        }
+        else
+        {
+            CookScene(&jobSystem, argv[1], argv[2]);
+        }
+    }
+    catch (const HrException& e)
+    {
+        printf("erro: %s\n", e.what());
+        result = 1;
+    }
+
+    DestroyJobSystem(&jobSystem);
+    LocalFree(argv);
+
+    return result;
+}
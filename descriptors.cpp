@@ -0,0 +1,117 @@
+#include "descriptors.h"
+
+// -----------------------------------------------------------------------------------------------------
+
+// Cabea da lista: contador de trocas nos 32 bits altos, ndice do primeiro livre nos baixos.
+static LONG64 MakeDescriptorListHead(LONG64 previous, UINT index)
+{
+    const UINT64 tag = (static_cast<UINT64>(previous) >> 32) + 1;
+    return static_cast<LONG64>((tag << 32) | index);
+}
+
+void InitDescriptorFreeList(DescriptorFreeList* list, UINT base, UINT capacity)
+{
+    list->base = base;
+    list->capacity = capacity;
+    list->links = new LONG[capacity];
+    list->allocatedCount = 0;
+
+    for (UINT i = 0; i < capacity; i++)
+    {
+        list->links[i] = static_cast<LONG>((i + 1 < capacity) ? i + 1 : DescriptorNull);
+    }
+
+    list->head = MakeDescriptorListHead(0, (capacity > 0) ? 0 : DescriptorNull);
+}
+
+void DestroyDescriptorFreeList(DescriptorFreeList* list)
+{
+    delete[] list->links;
+    list->links = nullptr;
+    list->capacity = 0;
+}
+
+UINT AllocateDescriptor(DescriptorFreeList* list)
+{
+    for (;;)
+    {
+        const LONG64 head = list->head;
+        const UINT index = static_cast<UINT>(head);
+        if (index == DescriptorNull)
+            return DescriptorNull;
+
+        // Se outra thread tirar este ndice antes, next pode estar velho, mas a troca falha pelo contador.
+        const UINT next = static_cast<UINT>(list->links[index]);
+        if (InterlockedCompareExchange64(&list->head, MakeDescriptorListHead(head, next), head) == head)
+        {
+            InterlockedIncrement(&list->allocatedCount);
+            return list->base + index;
+        }
+    }
+}
+
+void FreeDescriptor(DescriptorFreeList* list, UINT descriptor)
+{
+    const UINT index = descriptor - list->base;
+
+    for (;;)
+    {
+        const LONG64 head = list->head;
+        list->links[index] = static_cast<LONG>(static_cast<UINT>(head));
+
+        if (InterlockedCompareExchange64(&list->head, MakeDescriptorListHead(head, index), head) == head)
+        {
+            InterlockedDecrement(&list->allocatedCount);
+            return;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitDescriptorRing(DescriptorRing* ring, UINT base, UINT capacity)
+{
+    ring->base = base;
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->frames.clear();
+}
+
+UINT AllocateRingDescriptors(DescriptorRing* ring, UINT count)
+{
+    if (count == 0 || count > ring->capacity)
+        return DescriptorNull;
+
+    for (;;)
+    {
+        const LONG64 head = ring->head;
+
+        // Uma reserva no atravessa o fim do anel: o resto da volta fica sem uso.
+        UINT64 start = static_cast<UINT64>(head);
+        const UINT64 position = start % ring->capacity;
+        if (position + count > ring->capacity)
+            start += ring->capacity - position;
+
+        const UINT64 end = start + count;
+        if (end - static_cast<UINT64>(ring->tail) > ring->capacity)
+            return DescriptorNull;
+
+        if (InterlockedCompareExchange64(&ring->head, static_cast<LONG64>(end), head) == head)
+            return ring->base + static_cast<UINT>(start % ring->capacity);
+    }
+}
+
+void FinishDescriptorRingFrame(DescriptorRing* ring, UINT64 fenceValue)
+{
+    ring->frames.push_back({ fenceValue, static_cast<UINT64>(ring->head) });
+}
+
+void RetireDescriptorRingFrames(DescriptorRing* ring, UINT64 completedFenceValue)
+{
+    while (!ring->frames.empty() && ring->frames.front().fenceValue <= completedFenceValue)
+    {
+        InterlockedExchange64(&ring->tail, static_cast<LONG64>(ring->frames.front().end));
+        ring->frames.pop_front();
+    }
+}
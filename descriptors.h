@@ -0,0 +1,60 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <limits.h>
+#include <deque>
+
+// Alocao de ndices em heaps de descritores, sem nada do D3D12. Duas formas de regio:
+//
+//  - Lista livre: descritores persistentes (bindless, staging), um por vez.  uma pilha lock-free; o contador
+//    nos 32 bits altos da cabea evita ABA.
+//  - Anel: descritores de um quadro s, contguos. As threads reservam com compare-exchange na cabea e a thread
+//    principal devolve o trecho de cada quadro quando o fence dele passa.
+//
+// Alocar e liberar so O(1) e podem ser chamados de qualquer thread; Finish/Retire do anel s da principal.
+
+const UINT DescriptorNull = UINT_MAX;
+
+struct DescriptorFreeList
+{
+    UINT base;
+    UINT capacity;
+
+    volatile LONG* links;
+    volatile LONG64 head;
+    volatile LONG allocatedCount;
+};
+
+void InitDescriptorFreeList(DescriptorFreeList* list, UINT base, UINT capacity);
+void DestroyDescriptorFreeList(DescriptorFreeList* list);
+
+// Devolve DescriptorNull se a regio estiver cheia.
+UINT AllocateDescriptor(DescriptorFreeList* list);
+void FreeDescriptor(DescriptorFreeList* list, UINT descriptor);
+
+struct DescriptorRingFrame
+{
+    UINT64 fenceValue;
+    UINT64 end;
+};
+
+struct DescriptorRing
+{
+    UINT base;
+    UINT capacity;
+
+    // Posies contadas desde o incio; a real  o resto pela capacidade.
+    volatile LONG64 head;
+    volatile LONG64 tail;
+    std::deque<DescriptorRingFrame> frames;
+};
+
+void InitDescriptorRing(DescriptorRing* ring, UINT base, UINT capacity);
+
+// Reserva count descritores contguos. Devolve DescriptorNull se os quadros em voo ocuparem o anel.
+UINT AllocateRingDescriptors(DescriptorRing* ring, UINT count);
+
+// Fecha o quadro atual: tudo o que foi reservado at aqui volta quando o fence passar de fenceValue.
+void FinishDescriptorRingFrame(DescriptorRing* ring, UINT64 fenceValue);
+void RetireDescriptorRingFrames(DescriptorRing* ring, UINT64 completedFenceValue);
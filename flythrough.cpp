@@ -0,0 +1,53 @@
+#include "flythrough.h"
+#include "mappedfile.h"
+
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+HRESULT LoadFlythrough(const wchar_t* path, std::vector<FlythroughKey>* keys)
+{
+    MappedFile file;
+    HRESULT hr = OpenMappedFile(path, &file);
+    if (FAILED(hr))
+        return hr;
+
+    const FlythroughHeader* header = reinterpret_cast<const FlythroughHeader*>(file.data);
+    const bool valid =
+        file.size >= sizeof(FlythroughHeader) &&
+        header->magic == FlythroughMagic &&
+        header->version == FlythroughVersion &&
+        file.size - sizeof(FlythroughHeader) == static_cast<UINT64>(header->keyCount) * sizeof(FlythroughKey);
+
+    if (valid)
+    {
+        keys->resize(header->keyCount);
+        memcpy(keys->data(), file.data + sizeof(FlythroughHeader), keys->size() * sizeof(FlythroughKey));
+    }
+
+    CloseMappedFile(&file);
+
+    return valid ? S_OK : HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+}
+
+HRESULT SaveFlythrough(const wchar_t* path, const FlythroughKey* keys, UINT keyCount)
+{
+    FlythroughHeader header = {};
+    header.magic = FlythroughMagic;
+    header.version = FlythroughVersion;
+    header.keyCount = keyCount;
+
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    UINT64 position = 0;
+    const bool written =
+        WriteFileSection(file, &position, 0, &header, sizeof(header)) &&
+        WriteFileSection(file, &position, sizeof(header), keys, static_cast<UINT64>(keyCount) * sizeof(FlythroughKey));
+
+    const HRESULT hr = written ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    CloseHandle(file);
+
+    return hr;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+// Trajeto de cmera gravado quadro a quadro (.fly). A reproduo usa os intervalos da gravao, ento duas
+// execues veem a mesma sequncia de cmeras e as estatsticas do streaming podem ser comparadas entre ajustes.
+//
+//   FlythroughHeader | FlythroughKey[keyCount]
+
+const UINT FlythroughMagic = 0x594C4649;    // "IFLY"
+const UINT FlythroughVersion = 1;
+
+struct FlythroughHeader
+{
+    UINT magic;
+    UINT version;
+    UINT keyCount;
+    UINT reserved;
+};
+
+struct FlythroughKey
+{
+    float elapsedSeconds;
+    XMFLOAT3 position;
+    float pitch;
+    float yaw;
+    float roll;
+    float reserved;
+};
+
+HRESULT LoadFlythrough(const wchar_t* path, std::vector<FlythroughKey>* keys);
+HRESULT SaveFlythrough(const wchar_t* path, const FlythroughKey* keys, UINT keyCount);
@@ -0,0 +1,965 @@
+#include "gltfimport.h"
+#include "json.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <string>
+#include <limits.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT GlbMagic = 0x46546C67;       // "glTF"
+const UINT GlbChunkJson = 0x4E4F534A;   // "JSON"
+const UINT GlbChunkBin = 0x004E4942;    // "BIN\0"
+
+const UINT GltfModeTriangles = 4;
+
+enum GltfComponentType
+{
+    GltfComponentByte = 5120,
+    GltfComponentUnsignedByte = 5121,
+    GltfComponentShort = 5122,
+    GltfComponentUnsignedShort = 5123,
+    GltfComponentUnsignedInt = 5125,
+    GltfComponentFloat = 5126
+};
+
+struct GltfBufferView
+{
+    UINT buffer;
+    UINT64 byteOffset;
+    UINT64 byteLength;
+    UINT byteStride;
+};
+
+struct GltfAccessor
+{
+    INT bufferView;
+    UINT64 byteOffset;
+    UINT componentType;
+    UINT componentCount;
+    UINT count;
+    bool normalized;
+    bool sparse;
+};
+
+struct GltfPrimitive
+{
+    INT position;
+    INT color;
+    INT indices;
+    INT material;
+    UINT mode;
+
+    // Malha da engine gerada pela primitiva, ou UINT_MAX se ela foi descartada.
+    UINT meshIndex;
+};
+
+struct GltfNode
+{
+    INT mesh;
+    XMFLOAT4X4 local;
+    std::vector<UINT> children;
+};
+
+struct GltfDocument
+{
+    std::vector<GltfAccessor> accessors;
+    std::vector<GltfBufferView> bufferViews;
+    // true para o buffer sem uri, que  o chunk BIN do GLB.
+    std::vector<bool> glbBuffers;
+    std::vector<XMFLOAT4> materials;
+    std::vector<std::vector<GltfPrimitive>> meshes;
+    std::vector<GltfNode> nodes;
+    std::vector<std::vector<UINT>> scenes;
+    INT scene;
+};
+
+// Dados de um accessor direto no arquivo mapeado.
+struct GltfView
+{
+    const BYTE* data;
+    UINT count;
+    UINT stride;
+    UINT componentType;
+    UINT componentCount;
+    bool normalized;
+};
+
+struct GltfPrimitiveJob
+{
+    GltfView position;
+    GltfView color;
+    GltfView indices;
+    XMFLOAT4 baseColor;
+
+    UINT vertexOffset;
+    UINT indexOffset;
+    UINT indexCount;
+};
+
+struct GltfContext
+{
+    const GltfPrimitiveJob* jobs;
+    Vertex* vertices;
+    UINT* indices;
+    volatile LONG invalid;
+};
+
+// -----------------------------------------------------------------------------------------------------
+
+static bool BeginArray(JsonReader* reader, bool* valid)
+{
+    *valid &= (NextJsonToken(reader) == JsonTokenArrayBegin);
+    return *valid;
+}
+
+static bool BeginObject(JsonReader* reader, bool* valid)
+{
+    *valid &= (NextJsonToken(reader) == JsonTokenObjectBegin);
+    return *valid;
+}
+
+// Avana para a prxima chave do objeto atual; false no fim do objeto (ou em erro, que zera valid).
+static bool NextKey(JsonReader* reader, bool* valid)
+{
+    const JsonToken token = NextJsonToken(reader);
+    if (token == JsonTokenString && *valid)
+        return true;
+
+    *valid &= (token == JsonTokenObjectEnd);
+    return false;
+}
+
+// Avana para o prximo objeto de um array de objetos.
+static bool NextObject(JsonReader* reader, bool* valid)
+{
+    const JsonToken token = NextJsonToken(reader);
+    if (token == JsonTokenObjectBegin && *valid)
+        return true;
+
+    *valid &= (token == JsonTokenArrayEnd);
+    return false;
+}
+
+static void SkipValue(JsonReader* reader, bool* valid)
+{
+    *valid &= SkipJsonValue(reader, NextJsonToken(reader));
+}
+
+static UINT64 ReadUint64(JsonReader* reader, bool* valid)
+{
+    if (NextJsonToken(reader) != JsonTokenNumber || reader->number < 0.0 || reader->number > 9007199254740992.0)
+    {
+        *valid = false;
+        return 0;
+    }
+
+    return static_cast<UINT64>(reader->number);
+}
+
+static UINT ReadUint(JsonReader* reader, bool* valid)
+{
+    const UINT64 value = ReadUint64(reader, valid);
+    if (value >= UINT_MAX)
+    {
+        *valid = false;
+        return 0;
+    }
+
+    return static_cast<UINT>(value);
+}
+
+static bool ReadBool(JsonReader* reader, bool* valid)
+{
+    const JsonToken token = NextJsonToken(reader);
+    *valid &= (token == JsonTokenTrue || token == JsonTokenFalse);
+    return token == JsonTokenTrue;
+}
+
+static void ReadFloats(JsonReader* reader, float* values, UINT count, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    for (UINT i = 0; i < count; i++)
+    {
+        if (NextJsonToken(reader) != JsonTokenNumber)
+        {
+            *valid = false;
+            return;
+        }
+
+        values[i] = static_cast<float>(reader->number);
+    }
+
+    *valid &= (NextJsonToken(reader) == JsonTokenArrayEnd);
+}
+
+static void ReadUints(JsonReader* reader, std::vector<UINT>* values, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    for (;;)
+    {
+        const JsonToken token = NextJsonToken(reader);
+        if (token == JsonTokenArrayEnd)
+            return;
+
+        if (token != JsonTokenNumber || reader->number < 0.0 || reader->number >= UINT_MAX)
+        {
+            *valid = false;
+            return;
+        }
+
+        values->push_back(static_cast<UINT>(reader->number));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static void ParseAccessors(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        GltfAccessor accessor = { -1, 0, 0, 0, 0, false, false };
+
+        while (NextKey(reader, valid))
+        {
+            if (JsonStringEquals(reader, "bufferView"))
+            {
+                accessor.bufferView = static_cast<INT>(ReadUint(reader, valid));
+            }
+            else if (JsonStringEquals(reader, "byteOffset"))
+            {
+                accessor.byteOffset = ReadUint64(reader, valid);
+            }
+            else if (JsonStringEquals(reader, "componentType"))
+            {
+                accessor.componentType = ReadUint(reader, valid);
+            }
+            else if (JsonStringEquals(reader, "count"))
+            {
+                accessor.count = ReadUint(reader, valid);
+            }
+            else if (JsonStringEquals(reader, "normalized"))
+            {
+                accessor.normalized = ReadBool(reader, valid);
+            }
+            else if (JsonStringEquals(reader, "type"))
+            {
+                *valid &= (NextJsonToken(reader) == JsonTokenString);
+
+                static const struct { const char* name; UINT componentCount; } types[] =
+                {
+                    { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 }, { "MAT2", 4 }, { "MAT3", 9 }, { "MAT4", 16 }
+                };
+
+                for (UINT i = 0; i < _countof(types); i++)
+                {
+                    if (JsonStringEquals(reader, types[i].name))
+                        accessor.componentCount = types[i].componentCount;
+                }
+            }
+            else if (JsonStringEquals(reader, "sparse"))
+            {
+                accessor.sparse = true;
+                SkipValue(reader, valid);
+            }
+            else
+            {
+                SkipValue(reader, valid);
+            }
+        }
+
+        document->accessors.push_back(accessor);
+    }
+}
+
+static void ParseBufferViews(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        GltfBufferView bufferView = { 0, 0, 0, 0 };
+
+        while (NextKey(reader, valid))
+        {
+            if (JsonStringEquals(reader, "buffer"))
+                bufferView.buffer = ReadUint(reader, valid);
+            else if (JsonStringEquals(reader, "byteOffset"))
+                bufferView.byteOffset = ReadUint64(reader, valid);
+            else if (JsonStringEquals(reader, "byteLength"))
+                bufferView.byteLength = ReadUint64(reader, valid);
+            else if (JsonStringEquals(reader, "byteStride"))
+                bufferView.byteStride = ReadUint(reader, valid);
+            else
+                SkipValue(reader, valid);
+        }
+
+        document->bufferViews.push_back(bufferView);
+    }
+}
+
+static void ParseBuffers(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        bool glbBuffer = true;
+
+        while (NextKey(reader, valid))
+        {
+            if (JsonStringEquals(reader, "uri"))
+                glbBuffer = false;
+
+            SkipValue(reader, valid);
+        }
+
+        document->glbBuffers.push_back(glbBuffer);
+    }
+}
+
+static void ParseMaterials(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        XMFLOAT4 baseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        while (NextKey(reader, valid))
+        {
+            if (!JsonStringEquals(reader, "pbrMetallicRoughness"))
+            {
+                SkipValue(reader, valid);
+                continue;
+            }
+
+            if (!BeginObject(reader, valid))
+                break;
+
+            while (NextKey(reader, valid))
+            {
+                if (JsonStringEquals(reader, "baseColorFactor"))
+                    ReadFloats(reader, &baseColor.x, 4, valid);
+                else
+                    SkipValue(reader, valid);
+            }
+        }
+
+        document->materials.push_back(baseColor);
+    }
+}
+
+static void ParseMeshes(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        std::vector<GltfPrimitive> primitives;
+
+        while (NextKey(reader, valid))
+        {
+            if (!JsonStringEquals(reader, "primitives"))
+            {
+                SkipValue(reader, valid);
+                continue;
+            }
+
+            if (!BeginArray(reader, valid))
+                break;
+
+            while (NextObject(reader, valid))
+            {
+                GltfPrimitive primitive = { -1, -1, -1, -1, GltfModeTriangles, UINT_MAX };
+
+                while (NextKey(reader, valid))
+                {
+                    if (JsonStringEquals(reader, "attributes"))
+                    {
+                        if (!BeginObject(reader, valid))
+                            break;
+
+                        while (NextKey(reader, valid))
+                        {
+                            if (JsonStringEquals(reader, "POSITION"))
+                                primitive.position = static_cast<INT>(ReadUint(reader, valid));
+                            else if (JsonStringEquals(reader, "COLOR_0"))
+                                primitive.color = static_cast<INT>(ReadUint(reader, valid));
+                            else
+                                SkipValue(reader, valid);
+                        }
+                    }
+                    else if (JsonStringEquals(reader, "indices"))
+                    {
+                        primitive.indices = static_cast<INT>(ReadUint(reader, valid));
+                    }
+                    else if (JsonStringEquals(reader, "material"))
+                    {
+                        primitive.material = static_cast<INT>(ReadUint(reader, valid));
+                    }
+                    else if (JsonStringEquals(reader, "mode"))
+                    {
+                        primitive.mode = ReadUint(reader, valid);
+                    }
+                    else
+                    {
+                        SkipValue(reader, valid);
+                    }
+                }
+
+                primitives.push_back(primitive);
+            }
+        }
+
+        document->meshes.push_back(primitives);
+    }
+}
+
+static void ParseNodes(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        GltfNode node;
+        node.mesh = -1;
+
+        bool hasMatrix = false;
+        float matrix[16];
+        XMFLOAT3 translation = { 0.0f, 0.0f, 0.0f };
+        XMFLOAT4 rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+        XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
+
+        while (NextKey(reader, valid))
+        {
+            if (JsonStringEquals(reader, "mesh"))
+            {
+                node.mesh = static_cast<INT>(ReadUint(reader, valid));
+            }
+            else if (JsonStringEquals(reader, "children"))
+            {
+                ReadUints(reader, &node.children, valid);
+            }
+            else if (JsonStringEquals(reader, "matrix"))
+            {
+                hasMatrix = true;
+                ReadFloats(reader, matrix, 16, valid);
+            }
+            else if (JsonStringEquals(reader, "translation"))
+            {
+                ReadFloats(reader, &translation.x, 3, valid);
+            }
+            else if (JsonStringEquals(reader, "rotation"))
+            {
+                ReadFloats(reader, &rotation.x, 4, valid);
+            }
+            else if (JsonStringEquals(reader, "scale"))
+            {
+                ReadFloats(reader, &scale.x, 3, valid);
+            }
+            else
+            {
+                SkipValue(reader, valid);
+            }
+        }
+
+        // glTF guarda matrizes por coluna para vetor-coluna; lidas por linha, j ficam na conveno de vetor-linha.
+        XMFLOAT4X4 local;
+        if (hasMatrix)
+        {
+            memcpy(&local, matrix, sizeof(local));
+        }
+        else
+        {
+            const XMMATRIX scaleRotation = XMMatrixMultiply(XMMatrixScaling(scale.x, scale.y, scale.z), XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)));
+            XMStoreFloat4x4(&local, XMMatrixMultiply(scaleRotation, XMMatrixTranslation(translation.x, translation.y, translation.z)));
+        }
+
+        // Mo direita para mo esquerda: S * M * S com S = escala (1, 1, -1).
+        local._13 = -local._13;
+        local._23 = -local._23;
+        local._43 = -local._43;
+        local._31 = -local._31;
+        local._32 = -local._32;
+        local._34 = -local._34;
+        node.local = local;
+
+        document->nodes.push_back(node);
+    }
+}
+
+static void ParseScenes(JsonReader* reader, GltfDocument* document, bool* valid)
+{
+    if (!BeginArray(reader, valid))
+        return;
+
+    while (NextObject(reader, valid))
+    {
+        std::vector<UINT> nodes;
+
+        while (NextKey(reader, valid))
+        {
+            if (JsonStringEquals(reader, "nodes"))
+                ReadUints(reader, &nodes, valid);
+            else
+                SkipValue(reader, valid);
+        }
+
+        document->scenes.push_back(nodes);
+    }
+}
+
+static bool ParseDocument(const char* json, size_t size, GltfDocument* document)
+{
+    JsonReader reader;
+    InitJsonReader(&reader, json, size);
+
+    bool valid = true;
+    if (!BeginObject(&reader, &valid))
+        return false;
+
+    // S as sees usadas so lidas; as demais (texturas, animaes, extenses...) so puladas sem alocar nada.
+    while (NextKey(&reader, &valid))
+    {
+        if (JsonStringEquals(&reader, "accessors"))
+            ParseAccessors(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "bufferViews"))
+            ParseBufferViews(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "buffers"))
+            ParseBuffers(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "materials"))
+            ParseMaterials(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "meshes"))
+            ParseMeshes(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "nodes"))
+            ParseNodes(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "scenes"))
+            ParseScenes(&reader, document, &valid);
+        else if (JsonStringEquals(&reader, "scene"))
+            document->scene = static_cast<INT>(ReadUint(&reader, &valid));
+        else
+            SkipValue(&reader, &valid);
+    }
+
+    return valid;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static UINT GetComponentSize(UINT componentType)
+{
+    switch (componentType)
+    {
+    case GltfComponentByte:
+    case GltfComponentUnsignedByte:
+        return 1;
+    case GltfComponentShort:
+    case GltfComponentUnsignedShort:
+        return 2;
+    case GltfComponentUnsignedInt:
+    case GltfComponentFloat:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Valida o accessor contra o chunk BIN e devolve um ponteiro direto para os dados mapeados.
+static bool GetAccessorView(const GltfDocument* document, const BYTE* bin, UINT64 binSize, INT accessorIndex, GltfView* view)
+{
+    if (accessorIndex < 0 || static_cast<size_t>(accessorIndex) >= document->accessors.size())
+        return false;
+
+    const GltfAccessor* accessor = &document->accessors[accessorIndex];
+    if (accessor->sparse || accessor->bufferView < 0 || static_cast<size_t>(accessor->bufferView) >= document->bufferViews.size())
+        return false;
+
+    const GltfBufferView* bufferView = &document->bufferViews[accessor->bufferView];
+    if (bufferView->buffer >= document->glbBuffers.size() || !document->glbBuffers[bufferView->buffer])
+        return false;
+
+    if (bufferView->byteOffset > binSize || bufferView->byteLength > binSize - bufferView->byteOffset)
+        return false;
+
+    const UINT componentSize = GetComponentSize(accessor->componentType);
+    const UINT elementSize = componentSize * accessor->componentCount;
+    if (elementSize == 0)
+        return false;
+
+    const UINT stride = bufferView->byteStride ? bufferView->byteStride : elementSize;
+    if (accessor->count > 0)
+    {
+        const UINT64 lastByte = accessor->byteOffset + static_cast<UINT64>(stride) * (accessor->count - 1) + elementSize;
+        if (lastByte > bufferView->byteLength)
+            return false;
+    }
+
+    view->data = bin + bufferView->byteOffset + accessor->byteOffset;
+    view->count = accessor->count;
+    view->stride = stride;
+    view->componentType = accessor->componentType;
+    view->componentCount = accessor->componentCount;
+    view->normalized = accessor->normalized;
+
+    return true;
+}
+
+static inline float ReadComponent(const BYTE* data, UINT componentType, bool normalized)
+{
+    switch (componentType)
+    {
+    case GltfComponentFloat:
+    {
+        float value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    case GltfComponentUnsignedByte:
+        return normalized ? data[0] / 255.0f : data[0];
+    case GltfComponentByte:
+    {
+        const float value = static_cast<signed char>(data[0]);
+        return normalized ? (std::max)(value / 127.0f, -1.0f) : value;
+    }
+    case GltfComponentUnsignedShort:
+    {
+        UINT16 value;
+        memcpy(&value, data, sizeof(value));
+        return normalized ? value / 65535.0f : value;
+    }
+    case GltfComponentShort:
+    {
+        SHORT value;
+        memcpy(&value, data, sizeof(value));
+        return normalized ? (std::max)(value / 32767.0f, -1.0f) : value;
+    }
+    case GltfComponentUnsignedInt:
+    {
+        UINT value;
+        memcpy(&value, data, sizeof(value));
+        return static_cast<float>(value);
+    }
+    default:
+        return 0.0f;
+    }
+}
+
+static inline UINT ReadIndex(const BYTE* data, UINT componentType)
+{
+    switch (componentType)
+    {
+    case GltfComponentUnsignedByte:
+        return data[0];
+    case GltfComponentUnsignedShort:
+    {
+        UINT16 value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    default:
+    {
+        UINT value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    }
+}
+
+// Converte uma primitiva direto do arquivo mapeado para a faixa final dos vetores da cena.
+static void ConvertPrimitiveJob(void* context, UINT jobIndex)
+{
+    GltfContext* gltf = reinterpret_cast<GltfContext*>(context);
+    const GltfPrimitiveJob* job = &gltf->jobs[jobIndex];
+
+    const GltfView* position = &job->position;
+    const GltfView* color = &job->color;
+    const UINT positionSize = GetComponentSize(position->componentType);
+    const UINT colorSize = GetComponentSize(color->componentType);
+
+    Vertex* vertices = gltf->vertices + job->vertexOffset;
+    for (UINT v = 0; v < position->count; v++)
+    {
+        const BYTE* p = position->data + static_cast<size_t>(v) * position->stride;
+        if (position->componentType == GltfComponentFloat)
+        {
+            memcpy(&vertices[v].position, p, sizeof(XMFLOAT3));
+        }
+        else
+        {
+            vertices[v].position.x = ReadComponent(p, position->componentType, position->normalized);
+            vertices[v].position.y = ReadComponent(p + positionSize, position->componentType, position->normalized);
+            vertices[v].position.z = ReadComponent(p + 2 * positionSize, position->componentType, position->normalized);
+        }
+        vertices[v].position.z = -vertices[v].position.z;
+
+        XMFLOAT4 vertexColor = job->baseColor;
+        if (color->data)
+        {
+            const BYTE* c = color->data + static_cast<size_t>(v) * color->stride;
+            vertexColor.x *= ReadComponent(c, color->componentType, color->normalized);
+            vertexColor.y *= ReadComponent(c + colorSize, color->componentType, color->normalized);
+            vertexColor.z *= ReadComponent(c + 2 * colorSize, color->componentType, color->normalized);
+            if (color->componentCount == 4)
+                vertexColor.w *= ReadComponent(c + 3 * colorSize, color->componentType, color->normalized);
+        }
+        vertices[v].color = vertexColor;
+    }
+
+    // z invertido espelha a malha: a ordem dos tringulos  trocada para manter a face da frente.
+    UINT* indices = gltf->indices + job->indexOffset;
+    const GltfView* source = &job->indices;
+    for (UINT i = 0; i < job->indexCount; i += 3)
+    {
+        UINT triangle[3];
+        for (UINT k = 0; k < 3; k++)
+        {
+            triangle[k] = source->data ? ReadIndex(source->data + static_cast<size_t>(i + k) * source->stride, source->componentType) : i + k;
+        }
+
+        if (triangle[0] >= position->count || triangle[1] >= position->count || triangle[2] >= position->count)
+        {
+            InterlockedExchange(&gltf->invalid, 1);
+            return;
+        }
+
+        indices[i + 0] = triangle[0];
+        indices[i + 1] = triangle[2];
+        indices[i + 2] = triangle[1];
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static void AddNodeModels(const GltfDocument* document, UINT nodeIndex, FXMMATRIX parent, std::vector<BYTE>* visited, std::vector<Model>* models, bool* valid)
+{
+    if (nodeIndex >= document->nodes.size() || (*visited)[nodeIndex])
+    {
+        *valid = false;
+        return;
+    }
+
+    (*visited)[nodeIndex] = 1;
+
+    const GltfNode* node = &document->nodes[nodeIndex];
+    const XMMATRIX world = XMMatrixMultiply(XMLoadFloat4x4(&node->local), parent);
+
+    if (node->mesh >= 0 && static_cast<size_t>(node->mesh) < document->meshes.size())
+    {
+        for (const GltfPrimitive& primitive : document->meshes[node->mesh])
+        {
+            if (primitive.meshIndex == UINT_MAX)
+                continue;
+
+            Model model = {};
+            model.meshIndex = primitive.meshIndex;
+            XMStoreFloat4x4(&model.world, world);
+            models->push_back(model);
+        }
+    }
+
+    for (UINT child : node->children)
+    {
+        AddNodeModels(document, child, world, visited, models, valid);
+    }
+}
+
+void ImportGltf(JobSystem* jobSystem, const wchar_t* path, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes, std::vector<Model>* models)
+{
+    MappedFile file;
+    ThrowIfFailed(OpenMappedFile(path, &file));
+
+    const HRESULT invalidData = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    UINT header[5];
+    if (file.size < sizeof(header))
+    {
+        CloseMappedFile(&file);
+        ThrowIfFailed(invalidData);
+    }
+
+    memcpy(header, file.data, sizeof(header));
+    const UINT64 jsonSize = header[3];
+    if (header[0] != GlbMagic || header[1] != 2 || header[4] != GlbChunkJson || jsonSize > file.size - sizeof(header))
+    {
+        CloseMappedFile(&file);
+        ThrowIfFailed(invalidData);
+    }
+
+    const char* json = reinterpret_cast<const char*>(file.data + sizeof(header));
+
+    // O chunk BIN, se existir, vem logo depois do JSON (alinhado a 4 bytes).
+    const BYTE* bin = nullptr;
+    UINT64 binSize = 0;
+    const UINT64 binHeader = sizeof(header) + ((jsonSize + 3) & ~3ull);
+    if (binHeader + 8 <= file.size)
+    {
+        UINT chunk[2];
+        memcpy(chunk, file.data + binHeader, sizeof(chunk));
+        if (chunk[1] == GlbChunkBin && chunk[0] <= file.size - binHeader - 8)
+        {
+            bin = file.data + binHeader + 8;
+            binSize = chunk[0];
+        }
+    }
+
+    GltfDocument document;
+    document.scene = -1;
+    if (!ParseDocument(json, static_cast<size_t>(jsonSize), &document))
+    {
+        CloseMappedFile(&file);
+        ThrowIfFailed(invalidData);
+    }
+
+    // Em caso de erro os vetores da cena voltam ao tamanho original.
+    const size_t firstVertex = vertices->size();
+    const size_t firstIndex = indices->size();
+    const size_t firstMesh = meshes->size();
+    const size_t firstModel = models->size();
+
+    // Faixas de sada de cada primitiva: os jobs escrevem direto nos vetores da cena, sem cpias intermedirias.
+    std::vector<GltfPrimitiveJob> jobs;
+    UINT64 vertexCount = vertices->size();
+    UINT64 indexCount = indices->size();
+
+    for (std::vector<GltfPrimitive>& primitives : document.meshes)
+    {
+        for (GltfPrimitive& primitive : primitives)
+        {
+            GltfPrimitiveJob job = {};
+            if (primitive.mode != GltfModeTriangles || !GetAccessorView(&document, bin, binSize, primitive.position, &job.position))
+                continue;
+
+            if (job.position.componentCount != 3 || job.position.count == 0)
+                continue;
+
+            if (primitive.color >= 0 && (!GetAccessorView(&document, bin, binSize, primitive.color, &job.color) ||
+                job.color.count != job.position.count || job.color.componentCount < 3))
+            {
+                job.color.data = nullptr;
+            }
+
+            job.indexCount = job.position.count;
+            if (primitive.indices >= 0)
+            {
+                if (!GetAccessorView(&document, bin, binSize, primitive.indices, &job.indices) || job.indices.componentCount != 1 ||
+                    job.indices.componentType == GltfComponentFloat || job.indices.componentType == GltfComponentByte || job.indices.componentType == GltfComponentShort)
+                {
+                    continue;
+                }
+
+                job.indexCount = job.indices.count;
+            }
+
+            job.indexCount -= job.indexCount % 3;
+            if (job.indexCount == 0)
+                continue;
+
+            job.baseColor = (primitive.material >= 0 && static_cast<size_t>(primitive.material) < document.materials.size()) ?
+                document.materials[primitive.material] : XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+
+            job.vertexOffset = static_cast<UINT>(vertexCount);
+            job.indexOffset = static_cast<UINT>(indexCount);
+            vertexCount += job.position.count;
+            indexCount += job.indexCount;
+
+            if (vertexCount > MaxVertexCount || indexCount >= UINT_MAX)
+            {
+                CloseMappedFile(&file);
+                meshes->resize(firstMesh);
+                ThrowIfFailed(E_OUTOFMEMORY);
+            }
+
+            primitive.meshIndex = static_cast<UINT>(meshes->size());
+
+            Mesh mesh = {};
+            mesh.baseVertex = job.vertexOffset;
+            mesh.vertexCount = job.position.count;
+            mesh.lods[0] = { job.indexOffset, job.indexCount, 0.0f };
+            mesh.lodCount = 1;
+            meshes->push_back(mesh);
+
+            jobs.push_back(job);
+        }
+    }
+
+    vertices->resize(static_cast<size_t>(vertexCount));
+    indices->resize(static_cast<size_t>(indexCount));
+
+    GltfContext context;
+    context.jobs = jobs.data();
+    context.vertices = vertices->data();
+    context.indices = indices->data();
+    context.invalid = 0;
+
+    ParallelFor(jobSystem, static_cast<UINT>(jobs.size()), ConvertPrimitiveJob, &context);
+
+    CloseMappedFile(&file);
+
+    if (context.invalid)
+    {
+        vertices->resize(firstVertex);
+        indices->resize(firstIndex);
+        meshes->resize(firstMesh);
+        ThrowIfFailed(invalidData);
+    }
+
+    // Sem cena declarada, as razes so os ns que no so filhos de ningum.
+    std::vector<UINT> roots;
+    if (document.scene >= 0 && static_cast<size_t>(document.scene) < document.scenes.size())
+    {
+        roots = document.scenes[document.scene];
+    }
+    else if (!document.scenes.empty())
+    {
+        roots = document.scenes[0];
+    }
+    else
+    {
+        std::vector<BYTE> isChild(document.nodes.size(), 0);
+        for (const GltfNode& node : document.nodes)
+        {
+            for (UINT child : node.children)
+            {
+                if (child < isChild.size())
+                    isChild[child] = 1;
+            }
+        }
+
+        for (UINT n = 0; n < document.nodes.size(); n++)
+        {
+            if (!isChild[n])
+                roots.push_back(n);
+        }
+    }
+
+    bool valid = true;
+    std::vector<BYTE> visited(document.nodes.size(), 0);
+    for (UINT root : roots)
+    {
+        AddNodeModels(&document, root, XMMatrixIdentity(), &visited, models, &valid);
+    }
+
+    if (!valid)
+    {
+        vertices->resize(firstVertex);
+        indices->resize(firstIndex);
+        meshes->resize(firstMesh);
+        models->resize(firstModel);
+        ThrowIfFailed(invalidData);
+    }
+}
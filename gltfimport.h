@@ -0,0 +1,12 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+#include <vector>
+
+// Importa um arquivo glTF 2.0 binrio (GLB). Cada primitiva de tringulos vira uma malha anexada a meshes, com
+// os vrtices (POSITION e COLOR_0, multiplicada pelo baseColorFactor do material) anexados a vertices e os
+// ndices a indices. Cada n da cena com malha gera um modelo por primitiva, com a transformao acumulada da
+// hierarquia. Coordenadas so convertidas para o sistema de mo esquerda da engine (z invertido).
+void ImportGltf(JobSystem* jobSystem, const wchar_t* path, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes, std::vector<Model>* models);
@@ -1,20 +1,44 @@
-#include <Windows.h>
+#include "infinity.h"
+#include "jobs.h"
+#include "meshsimplify.h"
+#include "lodselect.h"
+#include "meshlet.h"
+#include "clusterdag.h"
+#include "objimport.h"
+#include "gltfimport.h"
+#include "meshformat.h"
+#include "streaming.h"
+#include "flythrough.h"
+#include "upload.h"
+#include "tlsf.h"
+#include "release.h"
+#include "descriptors.h"
+#include "materials.h"
+#include "textureformat.h"
+#include "shadowcache.h"
+#include "shadowcascades.h"
+#include "lightcluster.h"
+#include "lightbvh.h"
 
 #include <d3d12.h>
 #include <dxgi1_4.h>
 #include <d3dcompiler.h>
-#include <DirectXMath.h>
 #include "d3dx12.h"
 
 #include <wrl.h>
 #include <process.h>
-#include <stdexcept>
+#include <shellapi.h>
 #include <iostream>
+#include <algorithm>
+#include <random>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
 
 #define InterlockedGetValue(object) InterlockedCompareExchange(object, 0, 0)
 
 using Microsoft::WRL::ComPtr;
-using namespace DirectX;
 
 // -----------------------------------------------------------------------------------------------------
 
@@ -30,42 +54,9 @@ const int CommandListPre = 0;
 const int CommandListMid = 1;
 const int CommandListPost = 2;
 
-// -----------------------------------------------------------------------------------------------------
-
-inline std::string HrToString(HRESULT hr)
-{
-    char str[64] = {};
-    sprintf_s(str, "HRESULT: 0x%08X", static_cast<UINT>(hr));
-    return std::string(str);
-}
-
-class HrException : public std::runtime_error
-{
-public:
-    HrException(HRESULT hr) : std::runtime_error(HrToString(hr)), hr(hr) {}
-    HRESULT Error() const { return hr; }
-private:
-    const HRESULT hr;
-};
-
-inline void ThrowIfFailed(HRESULT hr)
-{
-    if (FAILED(hr))
-    {
-        throw HrException(hr);
-    }
-}
-
-// -----------------------------------------------------------------------------------------------------
-
-struct Vertex
-{
-    XMFLOAT3 position;
-    XMFLOAT4 color;
-};
-
-const UINT MaxVertexCount = 10000000;
-const UINT MaxModelCount = 10000;
+// Anel de staging da fila de cpia e alocadores reaproveitados entre os lotes.
+const UINT64 UploadStagingSize = 64 * 1024 * 1024;
+const UINT UploadAllocatorCount = 4;
 
 // -----------------------------------------------------------------------------------------------------
 
@@ -89,7 +80,6 @@ Vertex verticesList[] =
     { { 0.8f, -0.5f, 0.7f }, {0.0f, 0.0f, 1.0f, 1.0f} },
     { { -0.8f, -0.5f, 0.7f }, {1.0f, 0.0f, 0.0f, 1.0f} }
 };
-const UINT vertexBufferSize = sizeof(verticesList);
 
 UINT indicesList[] = { 
     // Cubo
@@ -116,6 +106,37 @@ struct SceneConstantBuffer
     XMFLOAT4 padding[4]; // Alinhamento 256-byte.
 };
 
+// Mesmo layout de ShadowConstantBuffer (shaders.hlsl).
+struct ShadowConstantBuffer
+{
+    XMFLOAT4X4 cascadeViewProjection[MaxShadowCascades];
+    float cascadeSplits[MaxShadowCascades];     // Profundidade de view onde cada cascata termina.
+    UINT cascadeCount;
+    UINT padding[59]; // Alinhamento 256-byte.
+};
+
+// Vis do shadow map, em unidades do formato D32 e por inclinao do tringulo.
+const INT ShadowDepthBias = 1000;
+const float ShadowSlopeScaledDepthBias = 2.0f;
+
+// Mesmo layout de LightConstantBuffer (shaders.hlsl). O pixel acha o seu cluster pela posio na tela e pela
+// profundidade de view, como em LightClusterGrid.
+struct LightConstantBuffer
+{
+    XMFLOAT3 cameraPosition;
+    float sliceScale;
+    XMFLOAT2 tileScale;                         // Tiles por pixel.
+    float sliceBias;
+    UINT tilesX;
+    UINT tilesY;
+    UINT slices;
+    UINT padding[54]; // Alinhamento 256-byte.
+};
+
+const UINT MaxLocalLightCount = 16384;        // Luzes visveis por quadro.
+const UINT MaxLightIndexCount = 1 << 20;
+const UINT DefaultSceneLightCount = 1024;
+
 // -----------------------------------------------------------------------------------------------------
 
 struct WindowInfo
@@ -153,6 +174,9 @@ struct Camera
     float fov;
     float moveSpeed;
 
+    // Deslocamento por segundo no ltimo quadro, usado para prever a trajetria.
+    XMFLOAT3 velocity;
+
     KeysPressed keysPressed;
 };
 
@@ -177,9 +201,341 @@ struct Timer
     UINT64 targetElapsedTicks;
 };
 
+// -----------------------------------------------------------------------------------------------------
+
+// Recursos posicionados em heaps grandes, subdivididos com TLSF. Cada pool junta um tipo de heap e uma classe de
+// recurso, j que heaps de tier 1 no misturam buffers, texturas e render targets. Recursos maiores que
+// GpuHeapSize ganham um heap do prprio tamanho.
+const UINT64 GpuHeapSize = 256 * 1024 * 1024;
+
+enum GpuMemoryCategory
+{
+    GpuMemoryGeometry,
+    GpuMemoryConstants,
+    GpuMemoryStaging,
+    GpuMemoryTargets,
+    GpuMemoryTextures,
+    GpuMemoryCategoryCount
+};
+
+const char* const GpuMemoryCategoryNames[GpuMemoryCategoryCount] = { "geometria", "constantes", "staging", "alvos", "texturas" };
+
+enum GpuResourceClass
+{
+    GpuResourceBuffer,
+    GpuResourceTexture,
+    GpuResourceTarget,
+    GpuResourceClassCount
+};
+
+// Heaps DEFAULT e UPLOAD.
+const UINT GpuHeapTypeCount = 2;
+
+struct GpuHeap
+{
+    ComPtr<ID3D12Heap> heap;
+    TlsfAllocator allocator;
+};
+
+struct GpuHeapPool
+{
+    D3D12_HEAP_TYPE type;
+    D3D12_HEAP_FLAGS flags;
+    UINT64 alignment;
+    std::vector<GpuHeap*> heaps;
+};
+
+struct GpuAllocation
+{
+    GpuHeapPool* pool;
+    GpuHeap* heap;
+    TlsfAllocation range;
+    GpuMemoryCategory category;
+};
+
+struct GpuMemory
+{
+    ID3D12Device* device;
+    ComPtr<IDXGIAdapter3> adapter;
+    GpuHeapPool pools[GpuHeapTypeCount * GpuResourceClassCount];
+
+    // Reservado em heaps por tipo e ocupado por categoria.
+    UINT64 heapBytes[GpuHeapTypeCount];
+    UINT64 categoryBytes[GpuMemoryCategoryCount];
+};
+
+void InitGpuMemory(GpuMemory* gpuMemory, ID3D12Device* device, IDXGIAdapter1* adapter)
+{
+    gpuMemory->device = device;
+    ThrowIfFailed(adapter->QueryInterface(IID_PPV_ARGS(&gpuMemory->adapter)));
+
+    const D3D12_HEAP_TYPE heapTypes[GpuHeapTypeCount] = { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_TYPE_UPLOAD };
+    const D3D12_HEAP_FLAGS classFlags[GpuResourceClassCount] =
+    {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+    };
+
+    for (UINT type = 0; type < GpuHeapTypeCount; type++)
+    {
+        for (UINT resourceClass = 0; resourceClass < GpuResourceClassCount; resourceClass++)
+        {
+            GpuHeapPool* pool = &gpuMemory->pools[type * GpuResourceClassCount + resourceClass];
+            pool->type = heapTypes[type];
+            pool->flags = classFlags[resourceClass];
+            pool->alignment = (resourceClass == GpuResourceTarget) ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        }
+
+        gpuMemory->heapBytes[type] = 0;
+    }
+
+    for (UINT i = 0; i < GpuMemoryCategoryCount; i++)
+    {
+        gpuMemory->categoryBytes[i] = 0;
+    }
+}
+
+HRESULT CreateGpuResource(GpuMemory* gpuMemory, D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC* desc, D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue, GpuMemoryCategory category, GpuAllocation* allocation, ID3D12Resource** resource)
+{
+    GpuResourceClass resourceClass = GpuResourceTexture;
+    if (desc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        resourceClass = GpuResourceBuffer;
+    else if (desc->Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+        resourceClass = GpuResourceTarget;
+
+    const UINT type = (heapType == D3D12_HEAP_TYPE_UPLOAD) ? 1 : 0;
+    GpuHeapPool* pool = &gpuMemory->pools[type * GpuResourceClassCount + resourceClass];
+
+    const D3D12_RESOURCE_ALLOCATION_INFO info = gpuMemory->device->GetResourceAllocationInfo(0, 1, desc);
+
+    GpuHeap* heap = nullptr;
+    TlsfAllocation range;
+    for (GpuHeap* candidate : pool->heaps)
+    {
+        if (AllocateTlsf(&candidate->allocator, info.SizeInBytes, info.Alignment, &range))
+        {
+            heap = candidate;
+            break;
+        }
+    }
+
+    if (!heap)
+    {
+        const UINT64 heapSize = (std::max)(GpuHeapSize, (info.SizeInBytes + pool->alignment - 1) / pool->alignment * pool->alignment);
+
+        ComPtr<ID3D12Heap> d3d12Heap;
+        HRESULT hr = gpuMemory->device->CreateHeap(&CD3DX12_HEAP_DESC(heapSize, pool->type, pool->alignment, pool->flags), IID_PPV_ARGS(&d3d12Heap));
+        if (FAILED(hr))
+            return hr;
+
+        heap = new GpuHeap;
+        heap->heap = d3d12Heap;
+        InitTlsfAllocator(&heap->allocator, heapSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+        AllocateTlsf(&heap->allocator, info.SizeInBytes, info.Alignment, &range);
+
+        pool->heaps.push_back(heap);
+        gpuMemory->heapBytes[type] += heapSize;
+    }
+
+    HRESULT hr = gpuMemory->device->CreatePlacedResource(heap->heap.Get(), range.offset, desc, initialState, clearValue, IID_PPV_ARGS(resource));
+    if (FAILED(hr))
+    {
+        FreeTlsf(&heap->allocator, &range);
+        return hr;
+    }
+
+    allocation->pool = pool;
+    allocation->heap = heap;
+    allocation->range = range;
+    allocation->category = category;
+
+    gpuMemory->categoryBytes[category] += heap->allocator.blocks[range.block].size;
+
+    return S_OK;
+}
+
+// O recurso j precisa ter sido liberado e a GPU no pode mais us-lo. Heaps que ficam vazios so devolvidos,
+// menos o ltimo de cada pool.
+void FreeGpuResource(GpuMemory* gpuMemory, GpuAllocation* allocation)
+{
+    GpuHeapPool* pool = allocation->pool;
+    GpuHeap* heap = allocation->heap;
+
+    gpuMemory->categoryBytes[allocation->category] -= heap->allocator.blocks[allocation->range.block].size;
+    FreeTlsf(&heap->allocator, &allocation->range);
+
+    if (heap->allocator.allocationCount == 0 && pool->heaps.size() > 1)
+    {
+        gpuMemory->heapBytes[(pool->type == D3D12_HEAP_TYPE_UPLOAD) ? 1 : 0] -= heap->allocator.size;
+        pool->heaps.erase(std::find(pool->heaps.begin(), pool->heaps.end(), heap));
+        delete heap;
+    }
+
+    allocation->pool = nullptr;
+    allocation->heap = nullptr;
+}
+
+void DestroyGpuMemory(GpuMemory* gpuMemory)
+{
+    for (GpuHeapPool& pool : gpuMemory->pools)
+    {
+        for (GpuHeap* heap : pool.heaps)
+        {
+            delete heap;
+        }
+        pool.heaps.clear();
+    }
+
+    gpuMemory->adapter = nullptr;
+}
+
+// Ocupao por categoria e heaps reservados contra o oramento que o sistema d ao processo.
+void PrintGpuMemory(const GpuMemory* gpuMemory)
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO local = {};
+    DXGI_QUERY_VIDEO_MEMORY_INFO nonLocal = {};
+    gpuMemory->adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &local);
+    gpuMemory->adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &nonLocal);
+
+    const double megabyte = 1024.0 * 1024.0;
+    printf("Memria:");
+    for (UINT i = 0; i < GpuMemoryCategoryCount; i++)
+    {
+        printf(" %s %.1f MB%s", GpuMemoryCategoryNames[i], gpuMemory->categoryBytes[i] / megabyte, (i + 1 < GpuMemoryCategoryCount) ? "," : "\n");
+    }
+
+    printf("Heaps: %.0f MB locais (oramento %.0f MB), %.0f MB de upload (oramento %.0f MB)\n",
+        gpuMemory->heapBytes[0] / megabyte, local.Budget / megabyte, gpuMemory->heapBytes[1] / megabyte, nonLocal.Budget / megabyte);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// O heap visvel aos shaders tem duas regies: descritores persistentes (bindless), um por vez de uma lista
+// livre, e o anel dos descritores de cada quadro. Views so criadas no heap de staging, que a GPU no v, e
+// copiadas para o heap visvel com CopyDescriptors. O anel cabe o pior caso dos quadros em voo, uma view por
+// modelo distinto em cada lista da cena e de cada cascata, mais uma reserva que pode sobrar no fim da volta.
+const UINT PersistentDescriptorCount = 32768;
+const UINT TransientDescriptorCount = MaxModelCount * ((NumContexts + MaxShadowCascades) * FrameCount + 1);
+const UINT StagingDescriptorCount = 65536;
+
+struct DescriptorManager
+{
+    ID3D12Device* device;
+    ComPtr<ID3D12DescriptorHeap> shaderVisibleHeap;
+    ComPtr<ID3D12DescriptorHeap> stagingHeap;
+    UINT descriptorSize;
+
+    DescriptorFreeList persistent;
+    DescriptorRing transient;
+    DescriptorFreeList staging;
+
+    // Cpias para a regio persistente, feitas juntas em FlushDescriptorCopies.
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> pendingSources;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> pendingDestinations;
+};
+
+void InitDescriptorManager(DescriptorManager* descriptors, ID3D12Device* device)
+{
+    descriptors->device = device;
+    descriptors->descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.NumDescriptors = PersistentDescriptorCount + TransientDescriptorCount;
+    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&descriptors->shaderVisibleHeap)));
+
+    heapDesc.NumDescriptors = StagingDescriptorCount;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&descriptors->stagingHeap)));
+
+    InitDescriptorFreeList(&descriptors->persistent, 0, PersistentDescriptorCount);
+    InitDescriptorRing(&descriptors->transient, PersistentDescriptorCount, TransientDescriptorCount);
+    InitDescriptorFreeList(&descriptors->staging, 0, StagingDescriptorCount);
+}
+
+void DestroyDescriptorManager(DescriptorManager* descriptors)
+{
+    DestroyDescriptorFreeList(&descriptors->persistent);
+    DestroyDescriptorFreeList(&descriptors->staging);
+
+    descriptors->shaderVisibleHeap = nullptr;
+    descriptors->stagingHeap = nullptr;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE GetStagingDescriptor(const DescriptorManager* descriptors, UINT index)
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(descriptors->stagingHeap->GetCPUDescriptorHandleForHeapStart(), index, descriptors->descriptorSize);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE GetShaderVisibleCpuDescriptor(const DescriptorManager* descriptors, UINT index)
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(descriptors->shaderVisibleHeap->GetCPUDescriptorHandleForHeapStart(), index, descriptors->descriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE GetShaderVisibleGpuDescriptor(const DescriptorManager* descriptors, UINT index)
+{
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(descriptors->shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart(), index, descriptors->descriptorSize);
+}
+
+// Reserva um descritor persistente e agenda a cpia da view de staging para ele. S da thread principal; a
+// cpia acontece no prximo FlushDescriptorCopies.
+HRESULT CreatePersistentDescriptor(DescriptorManager* descriptors, UINT stagingIndex, UINT* index)
+{
+    *index = AllocateDescriptor(&descriptors->persistent);
+    if (*index == DescriptorNull)
+        return E_OUTOFMEMORY;
+
+    descriptors->pendingSources.push_back(GetStagingDescriptor(descriptors, stagingIndex));
+    descriptors->pendingDestinations.push_back(GetShaderVisibleCpuDescriptor(descriptors, *index));
+
+    return S_OK;
+}
+
+void FlushDescriptorCopies(DescriptorManager* descriptors)
+{
+    if (descriptors->pendingDestinations.empty())
+        return;
+
+    // Faixas de um descritor dos dois lados: tamanhos nulos.
+    const UINT copyCount = static_cast<UINT>(descriptors->pendingDestinations.size());
+    descriptors->device->CopyDescriptors(copyCount, descriptors->pendingDestinations.data(), nullptr,
+        copyCount, descriptors->pendingSources.data(), nullptr, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    descriptors->pendingSources.clear();
+    descriptors->pendingDestinations.clear();
+}
+
+// Reserva count descritores contguos no anel e copia para eles as views de staging, na ordem. Pode ser chamado
+// das threads de gravao.
+HRESULT CopyTransientDescriptors(DescriptorManager* descriptors, const D3D12_CPU_DESCRIPTOR_HANDLE* sources, UINT count, UINT* first)
+{
+    *first = AllocateRingDescriptors(&descriptors->transient, count);
+    if (*first == DescriptorNull)
+        return E_OUTOFMEMORY;
+
+    const D3D12_CPU_DESCRIPTOR_HANDLE destination = GetShaderVisibleCpuDescriptor(descriptors, *first);
+    descriptors->device->CopyDescriptors(1, &destination, &count, count, sources, nullptr, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    return S_OK;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Views de uma lista de draws no anel: uma por modelo distinto, e a posio de cada draw entre elas.
+struct DrawDescriptors
+{
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> sources;
+    std::vector<UINT> drawSlots;
+    std::vector<UINT> modelSlots;           // MaxModelCount entradas, DescriptorNull fora da cpia.
+};
+
 struct FrameResource
 {
-    ID3D12CommandList* batchSubmit[NumContexts * 1 + CommandListCount];
+    // PRE, as cascatas, MID, as listas da cena e POST, na ordem de execuo.
+    ID3D12CommandList* batchSubmit[NumContexts + MaxShadowCascades + CommandListCount];
 
     ComPtr<ID3D12CommandAllocator> commandAllocators[CommandListCount];
     ComPtr<ID3D12GraphicsCommandList> commandLists[CommandListCount];
@@ -187,13 +543,63 @@ struct FrameResource
     ComPtr<ID3D12CommandAllocator> sceneCommandAllocators[NumContexts];
     ComPtr<ID3D12GraphicsCommandList> sceneCommandLists[NumContexts];
 
+    // Uma lista por cascata, gravadas em paralelo.
+    ComPtr<ID3D12CommandAllocator> shadowCommandAllocators[MaxShadowCascades];
+    ComPtr<ID3D12GraphicsCommandList> shadowCommandLists[MaxShadowCascades];
+
     UINT64 fenceValue;
 
 
     ComPtr<ID3D12PipelineState> pipelineState;
     ComPtr<ID3D12PipelineState> pipelineStateShadowMap;
     ComPtr<ID3D12Resource> sceneConstantBuffer;
+    GpuAllocation sceneConstantBufferAllocation;
     SceneConstantBuffer* sceneConstantBufferWO;
+
+    // Views dos modelos no heap de staging; as desenhadas vo para o anel a cada quadro.
+    std::vector<UINT> sceneConstantBufferViews;
+    DrawDescriptors drawDescriptors[NumContexts];
+    DrawDescriptors shadowDrawDescriptors[MaxShadowCascades];
+
+    ComPtr<ID3D12Resource> shadowConstantBuffer;
+    GpuAllocation shadowConstantBufferAllocation;
+    ShadowConstantBuffer* shadowConstantBufferWO;
+
+    // Luzes locais, a lista de cada cluster e os ndices das luzes, escritos a cada quadro.
+    ComPtr<ID3D12Resource> lightConstantBuffer;
+    GpuAllocation lightConstantBufferAllocation;
+    LightConstantBuffer* lightConstantBufferWO;
+    ComPtr<ID3D12Resource> lightBuffer;
+    GpuAllocation lightBufferAllocation;
+    LocalLight* lightBufferWO;
+    ComPtr<ID3D12Resource> lightClusterBuffer;
+    GpuAllocation lightClusterBufferAllocation;
+    XMUINT2* lightClusterBufferWO;
+    ComPtr<ID3D12Resource> lightIndexBuffer;
+    GpuAllocation lightIndexBufferAllocation;
+    UINT* lightIndexBufferWO;
+
+    // Cpia da tabela de materiais lida por este quadro, atualizada at materialVersion.
+    ComPtr<ID3D12Resource> materialBuffer;
+    GpuAllocation materialBufferAllocation;
+    GpuMaterial* materialBufferWO;
+    UINT64 materialVersion;
+};
+
+enum FlythroughMode
+{
+    FlythroughNone,
+    FlythroughRecord,
+    FlythroughReplay
+};
+
+// Textura lida de um DDS ou KTX2 (-texture). descriptor  o ndice do SRV na regio persistente do heap, o
+// mesmo que os materiais guardam.
+struct Texture
+{
+    ComPtr<ID3D12Resource> resource;
+    GpuAllocation allocation;
+    UINT descriptor;
 };
 
 struct D3D12Core
@@ -205,22 +611,28 @@ struct D3D12Core
     CD3DX12_RECT scissorRect;
     ComPtr<IDXGISwapChain3> swapChain;
     ComPtr<ID3D12Device> device;
+    GpuMemory gpuMemory;
     ComPtr<ID3D12Resource> renderTargets[FrameCount];
     ComPtr<ID3D12Resource> depthStencil;
+    GpuAllocation depthStencilAllocation;
     ComPtr<ID3D12CommandQueue> commandQueue;
     ComPtr<ID3D12RootSignature> rootSignature;
     ComPtr<ID3D12CommandSignature> commandSignature;
     ComPtr<ID3D12DescriptorHeap> rtvHeap;
     ComPtr<ID3D12DescriptorHeap> dsvHeap;
-    ComPtr<ID3D12DescriptorHeap> cbvSrvHeap;
+    DescriptorManager descriptors;
     ComPtr<ID3D12PipelineState> pipelineState;
+    ComPtr<ID3D12PipelineState> pipelineStateShadowMap;
 
 
     D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
     D3D12_INDEX_BUFFER_VIEW indexBufferView;
     ComPtr<ID3D12Resource> vertexBuffer;
     ComPtr<ID3D12Resource> indexBuffer;
+    GpuAllocation vertexBufferAllocation;
+    GpuAllocation indexBufferAllocation;
     UINT rtvDescriptorSize;
+    UINT dsvDescriptorSize;
     Timer timer;
     Camera camera;
 
@@ -236,6 +648,23 @@ struct D3D12Core
     ComPtr<ID3D12Fence> fence;
     UINT64 fenceValue;
 
+    // Recursos liberados no meio da execuo esperam aqui at a GPU passar do quadro em que foram usados.
+    ReleaseQueue releaseQueue;
+
+    // Vrtices e ndices chegam aos buffers pela fila de cpia. A fila direta espera uploadFenceValue no
+    // copyFence antes de desenhar cada quadro.
+    ComPtr<ID3D12CommandQueue> copyQueue;
+    ComPtr<ID3D12CommandAllocator> copyCommandAllocators[UploadAllocatorCount];
+    UINT64 copyAllocatorFenceValues[UploadAllocatorCount];
+    ComPtr<ID3D12GraphicsCommandList> copyCommandList;
+    ComPtr<ID3D12Fence> copyFence;
+    UINT64 copyFenceValue;
+    HANDLE copyFenceEvent;
+    ComPtr<ID3D12Resource> uploadStaging;
+    GpuAllocation uploadStagingAllocation;
+    UploadScheduler uploads;
+    UINT64 uploadFenceValue;
+
 
     
     static D3D12Core* app;
@@ -250,6 +679,65 @@ struct D3D12Core
         int threadIndex;
     };
     ThreadParameter threadParameters[NumContexts];
+
+    JobSystem jobSystem;
+    std::wstring scenePath;
+    std::vector<Vertex> sceneVertices;
+    std::vector<Mesh> meshes;
+    std::vector<Model> models;
+    std::vector<UINT> sceneIndices;
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds4> meshletBounds;
+    std::vector<DagCluster> dagClusters;
+    std::vector<DagClusterBounds4> dagClusterBounds;
+
+    LodSelectionSettings lodSettings;
+    std::vector<DrawCommand> drawList;
+
+    // Sombras da luz direcional: um shadow map por cascata, nas fatias de shadowMap. As DSVs ficam depois da
+    // do depth buffer; o SRV, na regio persistente do heap.
+    ShadowSettings shadowSettings;
+    XMFLOAT3 lightDirection;
+    ComPtr<ID3D12Resource> shadowMap;
+    GpuAllocation shadowMapAllocation;
+    UINT shadowMapDescriptor;
+    CD3DX12_VIEWPORT shadowViewport;
+    ShadowCascade shadowCascades[MaxShadowCascades];
+    std::vector<DrawCommand> shadowDrawLists[MaxShadowCascades];
+
+    // S os retngulos das cascatas que mudaram so redesenhados; as contagens somam os quadros at o prximo
+    // relatrio.
+    ShadowCache shadowCache;
+    UINT64 shadowDrawCount;
+    UINT64 shadowCasterCount;
+    UINT64 shadowDirtyTileCount;
+
+    // Luzes locais espalhadas pela cena (-lights), a BVH que acha as do frustum e a atribuio delas aos
+    // clusters. Os tempos somam os quadros at o prximo relatrio.
+    std::vector<LocalLight> lights;
+    UINT sceneLightCount;
+    LightBvh lightBvh;
+    std::vector<UINT> visibleLights;
+    LightClusterGrid lightClusters;
+    UINT64 lightBvhTicks;
+    UINT64 lightClusterTicks;
+
+    MaterialTable materials;
+    std::vector<MaterialRange> materialRanges;
+
+    std::vector<std::wstring> texturePaths;
+    std::vector<Texture> textures;
+
+    // Cenas em pacote (.pak) chegam por streaming depois do incio.
+    StreamingSystem streaming;
+    StreamingSettings streamingSettings;
+    bool streamingEnabled;
+
+    // Voo de cmera gravado ou reproduzido (-record / -replay).
+    FlythroughMode flythroughMode;
+    std::wstring flythroughPath;
+    std::vector<FlythroughKey> flythrough;
+    UINT flythroughFrame;
 };
 
 // -----------------------------------------------------------------------------------------------------
@@ -270,6 +758,7 @@ void InitCamera(Camera* camera)
     camera->roll = 0.0f;
     camera->fov = 60.0f;
     camera->moveSpeed = 2.0f;
+    camera->velocity = XMFLOAT3(0, 0, 0);
     camera->keysPressed = {};
     camera->mouseMoved = false;
     camera->rotationGain = 0.4f;
@@ -297,6 +786,7 @@ void InitFrameResource(D3D12Core* d3d12Core, UINT frameResourceIndex, FrameResou
 {
     frameResource->fenceValue = 0;
     frameResource->pipelineState = d3d12Core->pipelineState;
+    frameResource->pipelineStateShadowMap = d3d12Core->pipelineStateShadowMap;
 
     for (UINT i = 0; i < CommandListCount; i++)
     {
@@ -318,38 +808,129 @@ void InitFrameResource(D3D12Core* d3d12Core, UINT frameResourceIndex, FrameResou
         ThrowIfFailed(frameResource->sceneCommandLists[i]->Close());
     }
 
-    const UINT cbvSrvDescriptorSize = d3d12Core->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    CD3DX12_CPU_DESCRIPTOR_HANDLE cbvSrvCpuHandle(d3d12Core->cbvSrvHeap->GetCPUDescriptorHandleForHeapStart());
-    cbvSrvCpuHandle.Offset(0 + 0 + frameResourceIndex * MaxModelCount, cbvSrvDescriptorSize);
+    for (UINT i = 0; i < MaxShadowCascades; i++)
+    {
+        ThrowIfFailed(d3d12Core->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frameResource->shadowCommandAllocators[i])));
+        ThrowIfFailed(d3d12Core->device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, frameResource->shadowCommandAllocators[i].Get(), frameResource->pipelineStateShadowMap.Get(), IID_PPV_ARGS(&frameResource->shadowCommandLists[i])));
+        ThrowIfFailed(frameResource->shadowCommandLists[i]->Close());
+    }
 
-    ThrowIfFailed(d3d12Core->device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-        D3D12_HEAP_FLAG_NONE,
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
         &CD3DX12_RESOURCE_DESC::Buffer(sizeof(SceneConstantBuffer) * MaxModelCount),
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
-        IID_PPV_ARGS(&frameResource->sceneConstantBuffer)));
+        GpuMemoryConstants,
+        &frameResource->sceneConstantBufferAllocation,
+        &frameResource->sceneConstantBuffer));
 
     UINT64 cbOffset = 0;
+    frameResource->sceneConstantBufferViews.resize(MaxModelCount);
     for(UINT i = 0; i < MaxModelCount; i++)
     {
+        const UINT view = AllocateDescriptor(&d3d12Core->descriptors.staging);
+        if (view == DescriptorNull)
+            ThrowIfFailed(E_OUTOFMEMORY);
+
         D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
         cbvDesc.SizeInBytes = sizeof(SceneConstantBuffer);
         cbvDesc.BufferLocation = frameResource->sceneConstantBuffer->GetGPUVirtualAddress() + cbOffset;
         cbOffset += cbvDesc.SizeInBytes;
 
-        d3d12Core->device->CreateConstantBufferView(&cbvDesc, cbvSrvCpuHandle);
-        cbvSrvCpuHandle.Offset(cbvSrvDescriptorSize);
+        d3d12Core->device->CreateConstantBufferView(&cbvDesc, GetStagingDescriptor(&d3d12Core->descriptors, view));
+        frameResource->sceneConstantBufferViews[i] = view;
     }
 
     CD3DX12_RANGE readRange(0, 0);
     ThrowIfFailed(frameResource->sceneConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->sceneConstantBufferWO)));
 
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(GpuMaterial) * MaxMaterialCount),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryConstants,
+        &frameResource->materialBufferAllocation,
+        &frameResource->materialBuffer));
+
+    ThrowIfFailed(frameResource->materialBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->materialBufferWO)));
+    frameResource->materialVersion = 0;
+
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(ShadowConstantBuffer)),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryConstants,
+        &frameResource->shadowConstantBufferAllocation,
+        &frameResource->shadowConstantBuffer));
+
+    ThrowIfFailed(frameResource->shadowConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->shadowConstantBufferWO)));
+
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(LightConstantBuffer)),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryConstants,
+        &frameResource->lightConstantBufferAllocation,
+        &frameResource->lightConstantBuffer));
+
+    ThrowIfFailed(frameResource->lightConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->lightConstantBufferWO)));
+
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(LocalLight) * MaxLocalLightCount),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryConstants,
+        &frameResource->lightBufferAllocation,
+        &frameResource->lightBuffer));
+
+    ThrowIfFailed(frameResource->lightBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->lightBufferWO)));
+
+    const LightClusterSettings* clusterSettings = &d3d12Core->lightClusters.settings;
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(XMUINT2) * clusterSettings->tilesX * clusterSettings->tilesY * clusterSettings->slices),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryConstants,
+        &frameResource->lightClusterBufferAllocation,
+        &frameResource->lightClusterBuffer));
+
+    ThrowIfFailed(frameResource->lightClusterBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->lightClusterBufferWO)));
+
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT) * MaxLightIndexCount),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryConstants,
+        &frameResource->lightIndexBufferAllocation,
+        &frameResource->lightIndexBuffer));
 
-    const UINT batchSize = _countof(frameResource->sceneCommandLists) + 3;
+    ThrowIfFailed(frameResource->lightIndexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameResource->lightIndexBufferWO)));
+
+
+    const UINT batchSize = _countof(frameResource->batchSubmit);
     frameResource->batchSubmit[0] = frameResource->commandLists[CommandListPre].Get();
-    frameResource->batchSubmit[1] = frameResource->commandLists[CommandListMid].Get();
-    memcpy(frameResource->batchSubmit + 2, frameResource->sceneCommandLists, _countof(frameResource->sceneCommandLists) * sizeof(ID3D12CommandList*));
+    for (UINT i = 0; i < MaxShadowCascades; i++)
+    {
+        frameResource->batchSubmit[1 + i] = frameResource->shadowCommandLists[i].Get();
+    }
+    frameResource->batchSubmit[1 + MaxShadowCascades] = frameResource->commandLists[CommandListMid].Get();
+    for (UINT i = 0; i < NumContexts; i++)
+    {
+        frameResource->batchSubmit[2 + MaxShadowCascades + i] = frameResource->sceneCommandLists[i].Get();
+    }
     frameResource->batchSubmit[batchSize - 1] = frameResource->commandLists[CommandListPost].Get();
 }
 
@@ -364,16 +945,91 @@ void InitD3D12Core(UINT width, UINT height, std::wstring title, D3D12Core* d3d12
     d3d12Core->viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
     d3d12Core->scissorRect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
     d3d12Core->fenceValue = 0;
+    InitReleaseQueue(&d3d12Core->releaseQueue);
+    d3d12Core->copyFenceValue = 0;
+    d3d12Core->uploadFenceValue = 0;
     d3d12Core->frameCounter = 0;
     d3d12Core->rtvDescriptorSize = 0;
+    d3d12Core->dsvDescriptorSize = 0;
     d3d12Core->currentFrameResourceIndex = 0;
     d3d12Core->currentFrameResource = nullptr;
+    d3d12Core->lodSettings = DefaultLodSelectionSettings;
+    d3d12Core->shadowSettings = DefaultShadowSettings;
+    d3d12Core->lightDirection = XMFLOAT3(0.4f, -1.0f, 0.3f);
+    d3d12Core->shadowViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(d3d12Core->shadowSettings.resolution), static_cast<float>(d3d12Core->shadowSettings.resolution));
+    InitShadowCache(&d3d12Core->shadowCache, d3d12Core->shadowSettings.resolution, d3d12Core->shadowSettings.cascadeCount);
+    d3d12Core->shadowDrawCount = 0;
+    d3d12Core->shadowCasterCount = 0;
+    d3d12Core->shadowDirtyTileCount = 0;
+
+    d3d12Core->sceneLightCount = DefaultSceneLightCount;
+    InitLightBvh(&d3d12Core->lightBvh, &DefaultLightBvhSettings);
+    InitLightClusterGrid(&d3d12Core->lightClusters, &DefaultLightClusterSettings);
+    d3d12Core->lightBvhTicks = 0;
+    d3d12Core->lightClusterTicks = 0;
+
+    // O material 0  o padro, usado pelos modelos que no escolhem outro.
+    InitMaterialTable(&d3d12Core->materials, MaxMaterialCount);
+    CreateMaterial(&d3d12Core->materials, &DefaultMaterialDesc);
+    d3d12Core->streamingSettings = DefaultStreamingSettings;
+    d3d12Core->streamingEnabled = false;
+    d3d12Core->flythroughMode = FlythroughNone;
+    d3d12Core->flythroughFrame = 0;
     d3d12Core->app = d3d12Core;
 }
 
 // -----------------------------------------------------------------------------------------------------
 
-void DestroyFrameResource(FrameResource* frameResource)
+struct GpuResourceRelease
+{
+    GpuMemory* gpuMemory;
+    ID3D12Resource* resource;
+    GpuAllocation allocation;
+};
+
+void ReleaseGpuResourceNow(void* context, void* object)
+{
+    GpuResourceRelease* release = reinterpret_cast<GpuResourceRelease*>(object);
+
+    release->resource->Release();
+    if (release->allocation.heap)
+        FreeGpuResource(release->gpuMemory, &release->allocation);
+
+    delete release;
+}
+
+// Entrega o recurso e a faixa dele no heap  fila de liberao, marcados com o fence do quadro atual. A fila
+// direta espera as cpias de cada quadro antes de execut-lo, ento esse valor tambm cobre a fila de cpia.
+void ReleaseGpuResource(D3D12Core* d3d12Core, ComPtr<ID3D12Resource>* resource, GpuAllocation* allocation)
+{
+    if (!*resource)
+        return;
+
+    GpuResourceRelease* release = new GpuResourceRelease;
+    release->gpuMemory = &d3d12Core->gpuMemory;
+    release->resource = resource->Detach();
+    release->allocation = *allocation;
+
+    allocation->pool = nullptr;
+    allocation->heap = nullptr;
+
+    DeferRelease(&d3d12Core->releaseQueue, d3d12Core->fenceValue, ReleaseGpuResourceNow, nullptr, release);
+}
+
+void FreePersistentDescriptorNow(void* context, void* object)
+{
+    DescriptorManager* descriptors = reinterpret_cast<DescriptorManager*>(context);
+    FreeDescriptor(&descriptors->persistent, static_cast<UINT>(reinterpret_cast<UINT_PTR>(object)));
+}
+
+// Um descritor persistente pode estar em tabelas de quadros em voo: volta  lista quando eles terminarem.
+void ReleasePersistentDescriptor(D3D12Core* d3d12Core, UINT index)
+{
+    DeferRelease(&d3d12Core->releaseQueue, d3d12Core->fenceValue, FreePersistentDescriptorNow, &d3d12Core->descriptors,
+        reinterpret_cast<void*>(static_cast<UINT_PTR>(index)));
+}
+
+void DestroyFrameResource(D3D12Core* d3d12Core, FrameResource* frameResource)
 {
     for (int i = 0; i < CommandListCount; i++)
     {
@@ -386,6 +1042,27 @@ void DestroyFrameResource(FrameResource* frameResource)
         frameResource->sceneCommandLists[i] = nullptr;
         frameResource->sceneCommandAllocators[i] = nullptr;
     }
+
+    for (int i = 0; i < MaxShadowCascades; i++)
+    {
+        frameResource->shadowCommandLists[i] = nullptr;
+        frameResource->shadowCommandAllocators[i] = nullptr;
+    }
+
+    // O heap de staging s  lido pela CPU, nas cpias: as views podem voltar j.
+    for (UINT view : frameResource->sceneConstantBufferViews)
+    {
+        FreeDescriptor(&d3d12Core->descriptors.staging, view);
+    }
+    frameResource->sceneConstantBufferViews.clear();
+
+    ReleaseGpuResource(d3d12Core, &frameResource->sceneConstantBuffer, &frameResource->sceneConstantBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &frameResource->materialBuffer, &frameResource->materialBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &frameResource->shadowConstantBuffer, &frameResource->shadowConstantBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &frameResource->lightConstantBuffer, &frameResource->lightConstantBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &frameResource->lightBuffer, &frameResource->lightBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &frameResource->lightClusterBuffer, &frameResource->lightClusterBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &frameResource->lightIndexBuffer, &frameResource->lightIndexBufferAllocation);
 }
 
 // -----------------------------------------------------------------------------------------------------
@@ -515,6 +1192,8 @@ void UpdateCamera(Camera* camera, float elapsedSeconds)
     camera->position.y += y * moveInterval;
     camera->position.z += z * moveInterval;
 
+    camera->velocity = XMFLOAT3(x * camera->moveSpeed, y * camera->moveSpeed, z * camera->moveSpeed);
+
     if (camera->mouseMoved)
     {
         camera->mouseMoved = false;
@@ -563,80 +1242,493 @@ XMFLOAT3 GetLookDirection(float pitch_deg, float yaw_deg)
     XMFLOAT3 lookDirection;
     float pitch_rad, yaw_rad;
 
-    pitch_rad = XM_PI * pitch_deg / 180.0f;
-    yaw_rad = XM_PI * yaw_deg / 180.0f;
+    pitch_rad = XM_PI * pitch_deg / 180.0f;
+    yaw_rad = XM_PI * yaw_deg / 180.0f;
+
+    lookDirection.x = cosf(pitch_rad) * sinf(yaw_rad);
+    lookDirection.y = -sinf(pitch_rad);
+    lookDirection.z = cosf(pitch_rad) * cosf(yaw_rad);
+
+    return lookDirection;
+}
+
+XMFLOAT3 GetUpDirection(float pitch_deg, float yaw_deg, float roll_deg)
+{
+    XMFLOAT3 upDirection;
+    float pitch_rad, yaw_rad, roll_rad;
+
+    pitch_rad = XM_PI * pitch_deg / 180.0f;
+    yaw_rad = XM_PI * yaw_deg / 180.0f;
+    roll_rad = XM_PI * roll_deg / 180.0f;
+
+    upDirection.x = cosf(roll_rad) * sinf(pitch_rad) * sinf(yaw_rad) - sinf(roll_rad) * cosf(yaw_rad);
+    upDirection.y = cosf(roll_rad) * cosf(pitch_rad);
+    upDirection.z = sinf(roll_rad) * sinf(yaw_rad) + cosf(roll_rad) * sinf(pitch_rad) * cosf(yaw_rad);
+
+    return upDirection;
+}
+
+XMMATRIX GetViewMatrix(XMFLOAT3 position, float pitch_deg, float yaw_deg, float roll_deg)
+{
+    XMFLOAT3 lookDirection, upDirection;
+
+    lookDirection = GetLookDirection(pitch_deg, yaw_deg);
+    upDirection = GetUpDirection(pitch_deg, yaw_deg, roll_deg);
+
+    return XMMatrixLookToLH(XMLoadFloat3(&position), XMLoadFloat3(&lookDirection), XMLoadFloat3(&upDirection));
+}
+
+XMMATRIX GetPerspectiveProjectionMatrix(float fov_deg, float aspectRatio, float nearPlane = 1.0f, float farPlane = 1000.0f)
+{
+    return XMMatrixPerspectiveFovLH(fov_deg * XM_PI / 180.0f, aspectRatio, nearPlane, farPlane);
+}
+
+XMMATRIX GetOrthographicProjectionMatrix(float screenWidth, float screenHeight, float nearPlane = 0.0f, float farPlane = 1000.0f)
+{
+    return XMMatrixOrthographicLH(screenWidth, screenHeight, nearPlane, farPlane);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void WaitForCopies(void* context, UINT64 fenceValue)
+{
+    D3D12Core* d3d12Core = reinterpret_cast<D3D12Core*>(context);
+
+    if (d3d12Core->copyFence->GetCompletedValue() < fenceValue)
+    {
+        ThrowIfFailed(d3d12Core->copyFence->SetEventOnCompletion(fenceValue, d3d12Core->copyFenceEvent));
+        WaitForSingleObject(d3d12Core->copyFenceEvent, INFINITE);
+    }
+}
+
+UINT64 GetCompletedCopies(void* context)
+{
+    D3D12Core* d3d12Core = reinterpret_cast<D3D12Core*>(context);
+    return d3d12Core->copyFence->GetCompletedValue();
+}
+
+UINT64 SubmitCopies(void* context, const UploadCopy* copies, UINT copyCount)
+{
+    D3D12Core* d3d12Core = reinterpret_cast<D3D12Core*>(context);
+    const UINT64 fenceValue = ++d3d12Core->copyFenceValue;
+    const UINT allocatorIndex = fenceValue % UploadAllocatorCount;
+
+    // O alocador s volta a ser usado depois que a GPU termina o lote anterior dele.
+    WaitForCopies(d3d12Core, d3d12Core->copyAllocatorFenceValues[allocatorIndex]);
+
+    ID3D12CommandAllocator* allocator = d3d12Core->copyCommandAllocators[allocatorIndex].Get();
+    ID3D12GraphicsCommandList* commandList = d3d12Core->copyCommandList.Get();
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(commandList->Reset(allocator, nullptr));
+
+    for (UINT i = 0; i < copyCount; i++)
+    {
+        const UploadCopy* copy = &copies[i];
+        if (copy->source)
+        {
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+            footprint.Offset = copy->stagingOffset;
+            footprint.Footprint = { static_cast<DXGI_FORMAT>(copy->format), copy->width, copy->height, 1, copy->rowPitch };
+
+            const CD3DX12_TEXTURE_COPY_LOCATION destination(reinterpret_cast<ID3D12Resource*>(copy->destination), copy->subresource);
+            const CD3DX12_TEXTURE_COPY_LOCATION source(reinterpret_cast<ID3D12Resource*>(copy->source), footprint);
+            commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+            continue;
+        }
+
+        commandList->CopyBufferRegion(reinterpret_cast<ID3D12Resource*>(copy->destination), copy->destinationOffset,
+            d3d12Core->uploadStaging.Get(), copy->stagingOffset, copy->size);
+    }
+
+    ThrowIfFailed(commandList->Close());
+
+    ID3D12CommandList* ppCommandLists[] = { commandList };
+    d3d12Core->copyQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    ThrowIfFailed(d3d12Core->copyQueue->Signal(d3d12Core->copyFence.Get(), fenceValue));
+
+    d3d12Core->copyAllocatorFenceValues[allocatorIndex] = fenceValue;
+
+    return fenceValue;
+}
+
+void InitUploads(D3D12Core* d3d12Core)
+{
+    for (UINT i = 0; i < UploadAllocatorCount; i++)
+    {
+        ThrowIfFailed(d3d12Core->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&d3d12Core->copyCommandAllocators[i])));
+        d3d12Core->copyAllocatorFenceValues[i] = 0;
+    }
+
+    ThrowIfFailed(d3d12Core->device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, d3d12Core->copyCommandAllocators[0].Get(), nullptr, IID_PPV_ARGS(&d3d12Core->copyCommandList)));
+    ThrowIfFailed(d3d12Core->copyCommandList->Close());
+
+    ThrowIfFailed(d3d12Core->device->CreateFence(d3d12Core->copyFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&d3d12Core->copyFence)));
+
+    d3d12Core->copyFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (d3d12Core->copyFenceEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    ThrowIfFailed(CreateGpuResource(
+        &d3d12Core->gpuMemory,
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(UploadStagingSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        GpuMemoryStaging,
+        &d3d12Core->uploadStagingAllocation,
+        &d3d12Core->uploadStaging));
+
+    BYTE* staging;
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(d3d12Core->uploadStaging->Map(0, &readRange, reinterpret_cast<void**>(&staging)));
+
+    const UploadQueue queue = { d3d12Core, SubmitCopies, GetCompletedCopies, WaitForCopies };
+    InitUploadScheduler(&d3d12Core->uploads, &queue, staging, UploadStagingSize);
+}
+
+// Envia as malhas que o streaming publicou neste quadro.
+void QueueStreamedUploads(D3D12Core* d3d12Core)
+{
+    const StreamingSystem* streaming = &d3d12Core->streaming;
+
+    for (const StreamingRange& range : streaming->vertexUploads)
+    {
+        QueueUpload(&d3d12Core->uploads, d3d12Core->vertexBuffer.Get(), static_cast<UINT64>(range.offset) * sizeof(Vertex),
+            &d3d12Core->sceneVertices[range.offset], static_cast<UINT64>(range.count) * sizeof(Vertex));
+    }
+
+    for (const StreamingRange& range : streaming->indexUploads)
+    {
+        QueueUpload(&d3d12Core->uploads, d3d12Core->indexBuffer.Get(), static_cast<UINT64>(range.offset) * sizeof(UINT),
+            &d3d12Core->sceneIndices[range.offset], static_cast<UINT64>(range.count) * sizeof(UINT));
+    }
+}
+
+// Cada textura  lida direto num upload buffer prprio, j no layout de GetCopyableFootprints: os nveis saem do
+// arquivo mapeado (ou do descompressor Zstd) para a memria de upload sem buffers intermedirios. As cpias para
+// as texturas vo pela fila de cpia junto com os outros uploads, e a leitura da prxima textura se sobrepe a
+// elas. Os upload buffers so liberados quando todas terminam.
+void LoadTextures(D3D12Core* d3d12Core)
+{
+    if (d3d12Core->texturePaths.empty())
+        return;
+
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER loadStart;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&loadStart);
+
+    std::vector<ComPtr<ID3D12Resource>> uploadBuffers(d3d12Core->texturePaths.size());
+    std::vector<GpuAllocation> uploadAllocations(d3d12Core->texturePaths.size());
+    UINT64 fileBytes = 0;
+    UINT64 textureBytes = 0;
+
+    for (size_t i = 0; i < d3d12Core->texturePaths.size(); i++)
+    {
+        TextureFile file;
+        ThrowIfFailed(OpenTextureFile(d3d12Core->texturePaths[i].c_str(), &file));
+
+        // Texturas em COMMON so promovidas sozinhas para destino de cpia e depois para leitura nos shaders.
+        Texture texture = {};
+        const CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(file.format, file.width, file.height, 1, static_cast<UINT16>(file.levelCount));
+        ThrowIfFailed(CreateGpuResource(
+            &d3d12Core->gpuMemory,
+            D3D12_HEAP_TYPE_DEFAULT,
+            &textureDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            GpuMemoryTextures,
+            &texture.allocation,
+            &texture.resource));
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT layouts[MaxTextureLevels];
+        UINT rowCounts[MaxTextureLevels];
+        UINT64 uploadSize;
+        d3d12Core->device->GetCopyableFootprints(&textureDesc, 0, file.levelCount, 0, layouts, rowCounts, nullptr, &uploadSize);
+
+        ThrowIfFailed(CreateGpuResource(
+            &d3d12Core->gpuMemory,
+            D3D12_HEAP_TYPE_UPLOAD,
+            &CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            GpuMemoryStaging,
+            &uploadAllocations[i],
+            &uploadBuffers[i]));
+
+        TextureFootprint footprints[MaxTextureLevels];
+        for (UINT level = 0; level < file.levelCount; level++)
+        {
+            footprints[level] = { layouts[level].Offset, layouts[level].Footprint.RowPitch };
+        }
+
+        BYTE* upload;
+        CD3DX12_RANGE readRange(0, 0);
+        ThrowIfFailed(uploadBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&upload)));
+        const HRESULT hr = ReadTextureLevels(&d3d12Core->jobSystem, &file, upload, footprints);
+        uploadBuffers[i]->Unmap(0, nullptr);
+
+        fileBytes += file.file.size;
+        CloseTextureFile(&file);
+        ThrowIfFailed(hr);
+
+        for (UINT level = 0; level < textureDesc.MipLevels; level++)
+        {
+            UploadCopy copy = {};
+            copy.destination = texture.resource.Get();
+            copy.stagingOffset = layouts[level].Offset;
+            copy.size = static_cast<UINT64>(layouts[level].Footprint.RowPitch) * rowCounts[level];
+            copy.source = uploadBuffers[i].Get();
+            copy.subresource = level;
+            copy.format = layouts[level].Footprint.Format;
+            copy.width = layouts[level].Footprint.Width;
+            copy.height = layouts[level].Footprint.Height;
+            copy.rowPitch = layouts[level].Footprint.RowPitch;
+            QueueTextureUpload(&d3d12Core->uploads, &copy);
+
+            textureBytes += copy.size;
+        }
+
+        // Cada textura segue para a GPU assim que foi lida.
+        d3d12Core->uploadFenceValue = FlushUploads(&d3d12Core->uploads);
+
+        const UINT view = AllocateDescriptor(&d3d12Core->descriptors.staging);
+        if (view == DescriptorNull)
+            ThrowIfFailed(E_OUTOFMEMORY);
+
+        d3d12Core->device->CreateShaderResourceView(texture.resource.Get(), nullptr, GetStagingDescriptor(&d3d12Core->descriptors, view));
+        ThrowIfFailed(CreatePersistentDescriptor(&d3d12Core->descriptors, view, &texture.descriptor));
+
+        d3d12Core->textures.push_back(texture);
+    }
+
+    LARGE_INTEGER readEnd;
+    QueryPerformanceCounter(&readEnd);
+
+    WaitForUploads(&d3d12Core->uploads);
+    for (size_t i = 0; i < uploadBuffers.size(); i++)
+    {
+        ReleaseGpuResource(d3d12Core, &uploadBuffers[i], &uploadAllocations[i]);
+    }
+
+    LARGE_INTEGER loadEnd;
+    QueryPerformanceCounter(&loadEnd);
 
-    lookDirection.x = cosf(pitch_rad) * sinf(yaw_rad);
-    lookDirection.y = -sinf(pitch_rad);
-    lookDirection.z = cosf(pitch_rad) * cosf(yaw_rad);
+    // Leitura: arquivos at os upload buffers; total: at as cpias na GPU terminarem.
+    const double megabyte = 1024.0 * 1024.0;
+    const double readSeconds = static_cast<double>(readEnd.QuadPart - loadStart.QuadPart) / frequency.QuadPart;
+    const double loadSeconds = static_cast<double>(loadEnd.QuadPart - loadStart.QuadPart) / frequency.QuadPart;
 
-    return lookDirection;
+    printf("Texturas: %u, %.1f MB em disco, %.1f MB lidos em %.1f ms (%.0f MB/s), na GPU em %.1f ms\n", static_cast<UINT>(d3d12Core->textures.size()),
+        fileBytes / megabyte, textureBytes / megabyte, readSeconds * 1000.0, textureBytes / megabyte / (readSeconds > 0.0 ? readSeconds : 1.0), loadSeconds * 1000.0);
 }
 
-XMFLOAT3 GetUpDirection(float pitch_deg, float yaw_deg, float roll_deg)
+// -----------------------------------------------------------------------------------------------------
+
+void WriteConstantBuffers(FrameResource* frameResource, Camera* camera, D3D12_VIEWPORT* viewport, const Model* models, UINT modelCount)
 {
-    XMFLOAT3 upDirection;
-    float pitch_rad, yaw_rad, roll_rad;
+    if (modelCount == 0)
+        return;
 
-    pitch_rad = XM_PI * pitch_deg / 180.0f;
-    yaw_rad = XM_PI * yaw_deg / 180.0f;
-    roll_rad = XM_PI * roll_deg / 180.0f;
+    XMMATRIX view, projection;
+    SceneConstantBuffer* sceneConsts = new SceneConstantBuffer[modelCount];
 
-    upDirection.x = cosf(roll_rad) * sinf(pitch_rad) * sinf(yaw_rad) - sinf(roll_rad) * cosf(yaw_rad);
-    upDirection.y = cosf(roll_rad) * cosf(pitch_rad);
-    upDirection.z = sinf(roll_rad) * sinf(yaw_rad) + cosf(roll_rad) * sinf(pitch_rad) * cosf(yaw_rad);
+    view = GetViewMatrix(camera->position, camera->pitch, camera->yaw, camera->roll);
+    projection = GetPerspectiveProjectionMatrix(camera->fov, viewport->Width / viewport->Height);
+    //projection = GetOrthographicProjectionMatrix(viewport->Width, viewport->Height);
 
-    return upDirection;
+
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        sceneConsts[i].model = models[i].world;
+        XMStoreFloat4x4(&sceneConsts[i].view, view);
+        XMStoreFloat4x4(&sceneConsts[i].projection, projection);
+    }
+
+    memcpy(frameResource->sceneConstantBufferWO, sceneConsts, sizeof(SceneConstantBuffer) * modelCount);
+
+    delete[] sceneConsts;
 }
 
-XMMATRIX GetViewMatrix(XMFLOAT3 position, float pitch_deg, float yaw_deg, float roll_deg)
+// Leva para a cpia da tabela de materiais deste quadro s as faixas alteradas desde a ltima vez que ele foi
+// usado. As outras cpias ainda podem estar sendo lidas pela GPU e ficam para a vez delas.
+void WriteMaterials(D3D12Core* d3d12Core, FrameResource* frameResource)
 {
-    XMFLOAT3 lookDirection, upDirection;
+    MaterialTable* materials = &d3d12Core->materials;
+    frameResource->materialVersion = CollectMaterialChanges(materials, frameResource->materialVersion, &d3d12Core->materialRanges);
 
-    lookDirection = GetLookDirection(pitch_deg, yaw_deg);
-    upDirection = GetUpDirection(pitch_deg, yaw_deg, roll_deg);
+    for (const MaterialRange& range : d3d12Core->materialRanges)
+    {
+        memcpy(frameResource->materialBufferWO + range.first, &materials->materials[range.first], sizeof(GpuMaterial) * range.count);
+    }
 
-    return XMMatrixLookToLH(XMLoadFloat3(&position), XMLoadFloat3(&lookDirection), XMLoadFloat3(&upDirection));
+    UINT64 oldestVersion = frameResource->materialVersion;
+    for (UINT i = 0; i < FrameCount; i++)
+    {
+        oldestVersion = (std::min)(oldestVersion, d3d12Core->frameResources[i]->materialVersion);
+    }
+    TrimMaterialChanges(materials, oldestVersion);
 }
 
-XMMATRIX GetPerspectiveProjectionMatrix(float fov_deg, float aspectRatio, float nearPlane = 1.0f, float farPlane = 1000.0f)
+void UpdateDrawList(D3D12Core* d3d12Core)
 {
-    return XMMatrixPerspectiveFovLH(fov_deg * XM_PI / 180.0f, aspectRatio, nearPlane, farPlane);
+    Camera* camera = &d3d12Core->camera;
+    D3D12_VIEWPORT* viewport = &d3d12Core->viewport;
+
+    const float nearPlane = 1.0f;
+    XMMATRIX view = GetViewMatrix(camera->position, camera->pitch, camera->yaw, camera->roll);
+    XMMATRIX projection = GetPerspectiveProjectionMatrix(camera->fov, viewport->Width / viewport->Height, nearPlane);
+
+    LodView lodView;
+    BuildLodView(&lodView, camera->position, XMMatrixMultiply(view, projection), camera->fov, viewport->Height, nearPlane);
+
+    SelectLods(&d3d12Core->lodSettings, &lodView, d3d12Core->meshes.data(), d3d12Core->models.data(), static_cast<UINT>(d3d12Core->models.size()), &d3d12Core->drawList);
+    CullMeshlets(&d3d12Core->jobSystem, &lodView, d3d12Core->meshes.data(), d3d12Core->meshlets.data(), d3d12Core->meshletBounds.data(), d3d12Core->models.data(), &d3d12Core->drawList);
+    SelectClusterCuts(&d3d12Core->jobSystem, &d3d12Core->lodSettings, &lodView, d3d12Core->meshes.data(), d3d12Core->dagClusterBounds.data(), d3d12Core->dagClusters.data(), d3d12Core->models.data(), &d3d12Core->drawList);
+
+    if (d3d12Core->streamingEnabled)
+    {
+        UpdateStreaming(&d3d12Core->streaming, &lodView, camera->velocity, d3d12Core->meshes.data(), d3d12Core->models.data(),
+            static_cast<UINT>(d3d12Core->models.size()), &d3d12Core->drawList);
+        QueueStreamedUploads(d3d12Core);
+    }
+
+    d3d12Core->uploadFenceValue = FlushUploads(&d3d12Core->uploads);
 }
 
-XMMATRIX GetOrthographicProjectionMatrix(float screenWidth, float screenHeight, float nearPlane = 0.0f, float farPlane = 1000.0f)
+// Ajusta as cascatas  cmera deste quadro, escolhe os casters de cada uma e grava as matrizes no constant
+// buffer que o shadow pass e o pixel shader da cena leem.
+void UpdateShadows(D3D12Core* d3d12Core)
 {
-    return XMMatrixOrthographicLH(screenWidth, screenHeight, nearPlane, farPlane);
+    Camera* camera = &d3d12Core->camera;
+    D3D12_VIEWPORT* viewport = &d3d12Core->viewport;
+    const ShadowSettings* settings = &d3d12Core->shadowSettings;
+
+    const float nearPlane = 1.0f;
+    const float farPlane = 1000.0f;
+    XMMATRIX view = GetViewMatrix(camera->position, camera->pitch, camera->yaw, camera->roll);
+
+    BuildShadowCascades(settings, view, camera->fov, viewport->Width / viewport->Height, nearPlane, farPlane, d3d12Core->lightDirection, d3d12Core->shadowCascades);
+    CullShadowCasters(&d3d12Core->jobSystem, settings, d3d12Core->shadowCascades, d3d12Core->meshes.data(), d3d12Core->models.data(),
+        static_cast<UINT>(d3d12Core->models.size()), d3d12Core->shadowDrawLists);
+    UpdateShadowCache(&d3d12Core->shadowCache, d3d12Core->shadowCascades, d3d12Core->meshes.data(), d3d12Core->models.data(),
+        static_cast<UINT>(d3d12Core->models.size()), d3d12Core->shadowDrawLists);
+
+    d3d12Core->shadowDrawCount += d3d12Core->shadowCache.drawCount;
+    d3d12Core->shadowCasterCount += d3d12Core->shadowCache.casterCount;
+    d3d12Core->shadowDirtyTileCount += d3d12Core->shadowCache.dirtyTileCount;
+
+    ShadowConstantBuffer shadowConsts = {};
+    for (UINT i = 0; i < settings->cascadeCount; i++)
+    {
+        shadowConsts.cascadeViewProjection[i] = d3d12Core->shadowCascades[i].viewProjection;
+        shadowConsts.cascadeSplits[i] = d3d12Core->shadowCascades[i].splitFar;
+    }
+    shadowConsts.cascadeCount = settings->cascadeCount;
+
+    memcpy(d3d12Core->currentFrameResource->shadowConstantBufferWO, &shadowConsts, sizeof(shadowConsts));
 }
 
-void WriteConstantBuffers(FrameResource* frameResource, Camera* camera, D3D12_VIEWPORT* viewport)
+// Reajusta a BVH das luzes, pega as que alcanam o frustum deste quadro, distribui essas pelos clusters e copia
+// as luzes visveis, as listas e os ndices para os buffers do quadro. Se as luzes visveis ou os ndices no
+// couberem, os do fim ficam de fora.
+void UpdateLights(D3D12Core* d3d12Core)
 {
-    //if (frameResource->modelCount == 0)
-        //return;
+    Camera* camera = &d3d12Core->camera;
+    D3D12_VIEWPORT* viewport = &d3d12Core->viewport;
+    FrameResource* frameResource = d3d12Core->currentFrameResource;
+    LightClusterGrid* grid = &d3d12Core->lightClusters;
+    std::vector<UINT>& visibleLights = d3d12Core->visibleLights;
+
+    const float nearPlane = 1.0f;
+    const float farPlane = 1000.0f;
+    XMMATRIX view = GetViewMatrix(camera->position, camera->pitch, camera->yaw, camera->roll);
+    XMMATRIX projection = GetPerspectiveProjectionMatrix(camera->fov, viewport->Width / viewport->Height, nearPlane, farPlane);
+
+    LodView lodView;
+    BuildLodView(&lodView, camera->position, XMMatrixMultiply(view, projection), camera->fov, viewport->Height, nearPlane);
+
+    LARGE_INTEGER bvhStart;
+    LARGE_INTEGER bvhEnd;
+    QueryPerformanceCounter(&bvhStart);
+    UpdateLightBvh(&d3d12Core->jobSystem, &d3d12Core->lightBvh, d3d12Core->lights.data(), static_cast<UINT>(d3d12Core->lights.size()));
+    GatherLightBvh(&d3d12Core->lightBvh, d3d12Core->lights.data(), lodView.frustumPlanes, 6, &visibleLights);
+    QueryPerformanceCounter(&bvhEnd);
+    d3d12Core->lightBvhTicks += bvhEnd.QuadPart - bvhStart.QuadPart;
+
+    // Em ordem de ndice, o buffer do quadro fica na mesma ordem das luzes da cena.
+    std::sort(visibleLights.begin(), visibleLights.end());
+    const UINT visibleCount = (std::min)(static_cast<UINT>(visibleLights.size()), MaxLocalLightCount);
+
+    LARGE_INTEGER buildStart;
+    LARGE_INTEGER buildEnd;
+    QueryPerformanceCounter(&buildStart);
+    BuildLightClusters(&d3d12Core->jobSystem, grid, view, camera->fov, viewport->Width / viewport->Height, nearPlane, farPlane, d3d12Core->lights.data(),
+        visibleLights.data(), visibleCount);
+    QueryPerformanceCounter(&buildEnd);
+    d3d12Core->lightClusterTicks += buildEnd.QuadPart - buildStart.QuadPart;
+
+    for (UINT i = 0; i < visibleCount; i++)
+    {
+        frameResource->lightBufferWO[i] = d3d12Core->lights[visibleLights[i]];
+    }
 
-    XMMATRIX model, view, projection;
-    SceneConstantBuffer* sceneConsts = new SceneConstantBuffer[2];
+    const UINT indexCount = (std::min)(static_cast<UINT>(grid->lightIndices.size()), MaxLightIndexCount);
+    memcpy(frameResource->lightIndexBufferWO, grid->lightIndices.data(), sizeof(UINT) * indexCount);
 
-    view = GetViewMatrix(camera->position, camera->pitch, camera->yaw, camera->roll);
-    projection = GetPerspectiveProjectionMatrix(camera->fov, viewport->Width / viewport->Height);
-    //projection = GetOrthographicProjectionMatrix(viewport->Width, viewport->Height);
+    for (UINT i = 0; i < grid->clusters.size(); i++)
+    {
+        const XMUINT2 cluster = grid->clusters[i];
+        frameResource->lightClusterBufferWO[i] = XMUINT2(cluster.x, (std::min)(cluster.y, indexCount - (std::min)(cluster.x, indexCount)));
+    }
+
+    LightConstantBuffer lightConsts = {};
+    lightConsts.cameraPosition = camera->position;
+    lightConsts.sliceScale = grid->sliceScale;
+    lightConsts.sliceBias = grid->sliceBias;
+    lightConsts.tileScale = XMFLOAT2(grid->settings.tilesX / viewport->Width, grid->settings.tilesY / viewport->Height);
+    lightConsts.tilesX = grid->settings.tilesX;
+    lightConsts.tilesY = grid->settings.tilesY;
+    lightConsts.slices = grid->settings.slices;
+
+    memcpy(frameResource->lightConstantBufferWO, &lightConsts, sizeof(lightConsts));
+}
 
+// Aplica o prximo quadro do voo gravado. No fim imprime as estatsticas do streaming e fecha a janela.
+void ReplayFlythrough(D3D12Core* d3d12Core)
+{
+    Camera* camera = &d3d12Core->camera;
 
-    for (UINT i = 0; i < 2; i++)
+    if (d3d12Core->flythroughFrame >= d3d12Core->flythrough.size())
     {
-        XMStoreFloat4x4(&sceneConsts[i].view, view);
-        XMStoreFloat4x4(&sceneConsts[i].projection, projection);
-    }
+        if (d3d12Core->flythroughFrame++ == d3d12Core->flythrough.size())
+        {
+            const StreamingSystem* streaming = &d3d12Core->streaming;
+            const double hitRate = streaming->visibleMeshCount > 0 ? 1.0 - static_cast<double>(streaming->missingMeshCount) / streaming->visibleMeshCount : 1.0;
 
-    model = XMMatrixTranslation(-1.5f, 0.0f, 0.0f);
-    XMStoreFloat4x4(&sceneConsts[0].model, model);
+            printf("Voo: %u quadros, %.1f%% de acerto, %u quadros com malhas faltando, %.1f MB lidos, %u despejadas\n",
+                static_cast<UINT>(d3d12Core->flythrough.size()), hitRate * 100.0, streaming->stallFrameCount,
+                streaming->streamedBytes / (1024.0 * 1024.0), streaming->evictedMeshCount);
 
-    model = XMMatrixTranslation(1.5f, 0.0f, 0.0f); //XMMatrixRotationRollPitchYaw(0.0f * XM_PI / 180.0f, 0.0f * XM_PI / 180.0f, 0.0f) * XMMatrixTranslation(0.4f, 0.0f, 1.0f);
-    XMStoreFloat4x4(&sceneConsts[1].model, model);
+            PostMessage(d3d12Core->windowInfo.hwnd, WM_CLOSE, 0, 0);
+        }
 
-    memcpy(frameResource->sceneConstantBufferWO, sceneConsts, sizeof(SceneConstantBuffer) * 2);
+        camera->velocity = XMFLOAT3(0, 0, 0);
+        return;
+    }
 
-    delete[] sceneConsts;
+    const FlythroughKey* key = &d3d12Core->flythrough[d3d12Core->flythroughFrame++];
+
+    // A velocidade sai do prprio trajeto, como se a cmera tivesse sido movida pelo teclado.
+    const float seconds = key->elapsedSeconds > 0.0f ? key->elapsedSeconds : 1.0f;
+    XMStoreFloat3(&camera->velocity, XMVectorScale(XMVectorSubtract(XMLoadFloat3(&key->position), XMLoadFloat3(&camera->position)), 1.0f / seconds));
+
+    camera->position = key->position;
+    camera->pitch = key->pitch;
+    camera->yaw = key->yaw;
+    camera->roll = key->roll;
 }
 
 void OnKeyDown(Camera* camera, WPARAM key)
@@ -715,26 +1807,47 @@ void Bind(FrameResource* frameResource, ID3D12GraphicsCommandList* commandList,
     else {  }
 }
 
-void BindVertexBuffer(ID3D12GraphicsCommandList* commandList, ID3D12Resource* vertexBuffer, D3D12_VERTEX_BUFFER_VIEW vertexBufferView, BYTE* verticesList, UINT verticesListSize)
+// Copia para o anel as views dos modelos de drawList, uma vez por modelo, e deixa em drawSlots o descritor de cada
+// draw. Sem espao no anel devolve E_OUTOFMEMORY, e a lista no desenha nada neste quadro.
+HRESULT CopyDrawDescriptors(D3D12Core* d3d12Core, const std::vector<DrawCommand>& drawList, DrawDescriptors* drawDescriptors)
 {
-    UINT8* vertexDataBegin;
-    CD3DX12_RANGE readRange(0, 0);
-    ThrowIfFailed(vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&vertexDataBegin)));
-    memcpy(vertexDataBegin, verticesList, verticesListSize);
-    vertexBuffer->Unmap(0, nullptr);
+    FrameResource* frameResource = d3d12Core->currentFrameResource;
+    if (drawDescriptors->modelSlots.empty())
+        drawDescriptors->modelSlots.assign(MaxModelCount, DescriptorNull);
 
-    commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
-}
+    drawDescriptors->sources.clear();
+    drawDescriptors->drawSlots.resize(drawList.size());
+    for (size_t i = 0; i < drawList.size(); i++)
+    {
+        UINT& slot = drawDescriptors->modelSlots[drawList[i].modelIndex];
+        if (slot == DescriptorNull)
+        {
+            slot = static_cast<UINT>(drawDescriptors->sources.size());
+            drawDescriptors->sources.push_back(GetStagingDescriptor(&d3d12Core->descriptors, frameResource->sceneConstantBufferViews[drawList[i].modelIndex]));
+        }
 
-void BindIndexBuffer(ID3D12GraphicsCommandList* commandList, ID3D12Resource* indexBuffer, D3D12_INDEX_BUFFER_VIEW indexBufferView, BYTE* indicesList, UINT indexListSize)
-{
-    UINT8* indexDataBegin;
-    CD3DX12_RANGE readRange(0, 0);
-    ThrowIfFailed(indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&indexDataBegin)));
-    memcpy(indexDataBegin, indicesList, indexListSize);
-    indexBuffer->Unmap(0, nullptr);
+        drawDescriptors->drawSlots[i] = slot;
+    }
+
+    for (const DrawCommand& draw : drawList)
+    {
+        drawDescriptors->modelSlots[draw.modelIndex] = DescriptorNull;
+    }
+
+    if (drawDescriptors->sources.empty())
+        return S_OK;
+
+    UINT first = 0;
+    const HRESULT hr = CopyTransientDescriptors(&d3d12Core->descriptors, drawDescriptors->sources.data(), static_cast<UINT>(drawDescriptors->sources.size()), &first);
+    if (FAILED(hr))
+        return hr;
 
-    commandList->IASetIndexBuffer(&indexBufferView);
+    for (UINT& slot : drawDescriptors->drawSlots)
+    {
+        slot += first;
+    }
+
+    return S_OK;
 }
 
 void WorkerThread(D3D12Core* d3d12Core, int threadIndex)
@@ -756,28 +1869,42 @@ void WorkerThread(D3D12Core* d3d12Core, int threadIndex)
         
         SetCommonPipelineState(d3d12Core, sceneCommandList);
 
-        ID3D12DescriptorHeap* ppHeaps[] = { d3d12Core->cbvSrvHeap.Get() };
+        ID3D12DescriptorHeap* ppHeaps[] = { d3d12Core->descriptors.shaderVisibleHeap.Get() };
         sceneCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 
-        const UINT cbvSrvDescriptorSize = d3d12Core->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-        
+        // As views dos modelos desenhados vo para uma faixa do anel, numa cpia s.
+        FrameResource* frameResource = d3d12Core->currentFrameResource;
+        DrawDescriptors* drawDescriptors = &frameResource->drawDescriptors[threadIndex];
+        const UINT drawCount = SUCCEEDED(CopyDrawDescriptors(d3d12Core, d3d12Core->drawList, drawDescriptors)) ? static_cast<UINT>(d3d12Core->drawList.size()) : 0;
+
 
         CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(d3d12Core->rtvHeap->GetCPUDescriptorHandleForHeapStart(), d3d12Core->frameIndex, d3d12Core->rtvDescriptorSize);
         CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(d3d12Core->dsvHeap->GetCPUDescriptorHandleForHeapStart());
         Bind(d3d12Core->currentFrameResource, sceneCommandList, TRUE, &rtvHandle, &dsvHandle);
-        BindVertexBuffer(sceneCommandList, d3d12Core->vertexBuffer.Get(), d3d12Core->vertexBufferView, (BYTE*)verticesList, vertexBufferSize);
-        BindIndexBuffer(sceneCommandList, d3d12Core->indexBuffer.Get(), d3d12Core->indexBufferView, (BYTE*)indicesList, indexBufferSize);
+
+        sceneCommandList->IASetVertexBuffers(0, 1, &d3d12Core->vertexBufferView);
+        sceneCommandList->IASetIndexBuffer(&d3d12Core->indexBufferView);
         sceneCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+        // Materiais e texturas ficam fixos na lista inteira; cada draw s troca o ndice do material.
+        sceneCommandList->SetGraphicsRootShaderResourceView(2, frameResource->materialBuffer->GetGPUVirtualAddress());
+        sceneCommandList->SetGraphicsRootDescriptorTable(3, GetShaderVisibleGpuDescriptor(&d3d12Core->descriptors, d3d12Core->descriptors.persistent.base));
+        sceneCommandList->SetGraphicsRootConstantBufferView(4, frameResource->shadowConstantBuffer->GetGPUVirtualAddress());
+        sceneCommandList->SetGraphicsRootDescriptorTable(6, GetShaderVisibleGpuDescriptor(&d3d12Core->descriptors, d3d12Core->shadowMapDescriptor));
+        sceneCommandList->SetGraphicsRootConstantBufferView(7, frameResource->lightConstantBuffer->GetGPUVirtualAddress());
+        sceneCommandList->SetGraphicsRootShaderResourceView(8, frameResource->lightBuffer->GetGPUVirtualAddress());
+        sceneCommandList->SetGraphicsRootShaderResourceView(9, frameResource->lightClusterBuffer->GetGPUVirtualAddress());
+        sceneCommandList->SetGraphicsRootShaderResourceView(10, frameResource->lightIndexBuffer->GetGPUVirtualAddress());
+
         
         
-        CD3DX12_GPU_DESCRIPTOR_HANDLE cbvSrvGpuHandle(d3d12Core->cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), d3d12Core->currentFrameResourceIndex * MaxModelCount, cbvSrvDescriptorSize);
-        sceneCommandList->SetGraphicsRootDescriptorTable(0, cbvSrvGpuHandle);
-        sceneCommandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
-
-        cbvSrvGpuHandle.Offset(cbvSrvDescriptorSize);
-        sceneCommandList->SetGraphicsRootDescriptorTable(0, cbvSrvGpuHandle);
-        sceneCommandList->DrawIndexedInstanced(12, 1, 36, 8, 0);
+        for (UINT i = 0; i < drawCount; i++)
+        {
+            const DrawCommand& draw = d3d12Core->drawList[i];
+            sceneCommandList->SetGraphicsRootDescriptorTable(0, GetShaderVisibleGpuDescriptor(&d3d12Core->descriptors, drawDescriptors->drawSlots[i]));
+            sceneCommandList->SetGraphicsRoot32BitConstant(1, d3d12Core->models[draw.modelIndex].materialIndex, 0);
+            sceneCommandList->DrawIndexedInstanced(draw.indexCount, 1, draw.startIndex, draw.baseVertex, 0);
+        }
         
 
 
@@ -790,6 +1917,73 @@ void WorkerThread(D3D12Core* d3d12Core, int threadIndex)
 #endif
 }
 
+// Grava o shadow map de uma cascata na sua lista. Cada cascata  um job: as listas, os alocadores e as faixas de
+// descritores so separados, e o anel de descritores aceita reservas concorrentes. O resto do shadow map fica
+// como o quadro anterior deixou; s os retngulos sujos do cache so limpos e redesenhados, com scissor.
+void RecordShadowCascadeJob(void* context, UINT cascadeIndex)
+{
+    D3D12Core* d3d12Core = static_cast<D3D12Core*>(context);
+    FrameResource* frameResource = d3d12Core->currentFrameResource;
+    ID3D12GraphicsCommandList* commandList = frameResource->shadowCommandLists[cascadeIndex].Get();
+
+    // Listas de cascatas desligadas vo vazias.
+    if (cascadeIndex >= d3d12Core->shadowSettings.cascadeCount)
+    {
+        ThrowIfFailed(commandList->Close());
+        return;
+    }
+
+    const ShadowCacheCascade* cacheCascade = &d3d12Core->shadowCache.cascades[cascadeIndex];
+    const std::vector<DrawCommand>& drawList = cacheCascade->draws;
+
+    // Sem espao no anel a cascata fica como est e  redesenhada inteira no prximo quadro.
+    DrawDescriptors* drawDescriptors = &frameResource->shadowDrawDescriptors[cascadeIndex];
+    if (FAILED(CopyDrawDescriptors(d3d12Core, drawList, drawDescriptors)))
+    {
+        d3d12Core->shadowCache.cascades[cascadeIndex].valid = false;
+        ThrowIfFailed(commandList->Close());
+        return;
+    }
+
+    commandList->SetGraphicsRootSignature(d3d12Core->rootSignature.Get());
+
+    ID3D12DescriptorHeap* ppHeaps[] = { d3d12Core->descriptors.shaderVisibleHeap.Get() };
+    commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+
+    commandList->RSSetViewports(1, &d3d12Core->shadowViewport);
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(d3d12Core->dsvHeap->GetCPUDescriptorHandleForHeapStart(), 1 + cascadeIndex, d3d12Core->dsvDescriptorSize);
+    commandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+
+    commandList->IASetVertexBuffers(0, 1, &d3d12Core->vertexBufferView);
+    commandList->IASetIndexBuffer(&d3d12Core->indexBufferView);
+    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    commandList->SetGraphicsRootConstantBufferView(4, frameResource->shadowConstantBuffer->GetGPUVirtualAddress());
+    commandList->SetGraphicsRoot32BitConstant(5, cascadeIndex, 0);
+
+    for (const ShadowCacheRect& rect : cacheCascade->rects)
+    {
+        const CD3DX12_RECT scissorRect(rect.left, rect.top, rect.right, rect.bottom);
+        commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 1, &scissorRect);
+        commandList->RSSetScissorRects(1, &scissorRect);
+
+        for (UINT i = rect.firstDraw; i < rect.firstDraw + rect.drawCount; i++)
+        {
+            const DrawCommand& draw = drawList[i];
+            commandList->SetGraphicsRootDescriptorTable(0, GetShaderVisibleGpuDescriptor(&d3d12Core->descriptors, drawDescriptors->drawSlots[i]));
+            commandList->DrawIndexedInstanced(draw.indexCount, 1, draw.startIndex, draw.baseVertex, 0);
+        }
+    }
+
+    ThrowIfFailed(commandList->Close());
+}
+
+void RecordShadowPass(D3D12Core* d3d12Core)
+{
+    ParallelFor(&d3d12Core->jobSystem, MaxShadowCascades, RecordShadowCascadeJob, d3d12Core);
+}
+
 // -----------------------------------------------------------------------------------------------------
 
 void LoadPipeline(D3D12Core* d3d12Core)
@@ -822,6 +2016,8 @@ void LoadPipeline(D3D12Core* d3d12Core)
         IID_PPV_ARGS(&d3d12Core->device)
     ));
 
+    InitGpuMemory(&d3d12Core->gpuMemory, d3d12Core->device.Get(), hardwareAdapter.Get());
+
 
     D3D12_COMMAND_QUEUE_DESC queueDesc = {};
     queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -829,6 +2025,9 @@ void LoadPipeline(D3D12Core* d3d12Core)
 
     ThrowIfFailed(d3d12Core->device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&d3d12Core->commandQueue)));
 
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    ThrowIfFailed(d3d12Core->device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&d3d12Core->copyQueue)));
+
 
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.BufferCount = FrameCount;
@@ -868,19 +2067,189 @@ void LoadPipeline(D3D12Core* d3d12Core)
 
 
         D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
-        dsvHeapDesc.NumDescriptors = 1 + FrameCount * 1;
+        dsvHeapDesc.NumDescriptors = 1 + MaxShadowCascades;
         dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
         dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         ThrowIfFailed(d3d12Core->device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&d3d12Core->dsvHeap)));
 
-        D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-        UINT cbvCount = MaxModelCount * FrameCount;
-        cbvHeapDesc.NumDescriptors = cbvCount;
-        cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        ThrowIfFailed(d3d12Core->device->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&d3d12Core->cbvSrvHeap)));
+        InitDescriptorManager(&d3d12Core->descriptors, d3d12Core->device.Get());
 
         d3d12Core->rtvDescriptorSize = d3d12Core->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+        d3d12Core->dsvDescriptorSize = d3d12Core->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Espalha sceneLightCount luzes pela caixa dos modelos, sempre com a mesma semente: um tero spots apontados para
+// baixo, o resto pontuais. O alcance acompanha o espaamento mdio entre as luzes.
+void CreateSceneLights(D3D12Core* d3d12Core)
+{
+    d3d12Core->lights.clear();
+    if (d3d12Core->sceneLightCount == 0 || d3d12Core->models.empty())
+        return;
+
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+    for (const Model& model : d3d12Core->models)
+    {
+        const Mesh* mesh = &d3d12Core->meshes[model.meshIndex];
+        const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&mesh->boundsCenter), XMLoadFloat4x4(&model.world));
+        boundsMin = XMVectorMin(boundsMin, center);
+        boundsMax = XMVectorMax(boundsMax, center);
+    }
+
+    XMFLOAT3 minimum;
+    XMFLOAT3 extent;
+    XMStoreFloat3(&minimum, boundsMin);
+    XMStoreFloat3(&extent, XMVectorMax(XMVectorSubtract(boundsMax, boundsMin), XMVectorReplicate(1.0f)));
+
+    const UINT lightCount = d3d12Core->sceneLightCount;
+    const float spacing = cbrtf(extent.x * extent.y * extent.z / lightCount);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    d3d12Core->lights.resize(lightCount);
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        LocalLight* light = &d3d12Core->lights[i];
+        light->position = XMFLOAT3(minimum.x + unit(random) * extent.x, minimum.y + unit(random) * extent.y, minimum.z + unit(random) * extent.z);
+        light->range = spacing * (1.0f + unit(random));
+        light->color = XMFLOAT3(0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random));
+
+        if (i % 3 == 0)
+        {
+            const float angle = (30.0f + 30.0f * unit(random)) * XM_PI / 180.0f;
+            XMStoreFloat3(&light->direction, XMVector3Normalize(XMVectorSet(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f, 0.0f)));
+            light->spotCosOuter = cosf(angle);
+            light->spotCosInner = cosf(0.8f * angle);
+        }
+        else
+        {
+            light->direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+            light->spotCosOuter = -1.0f;
+            light->spotCosInner = -1.0f;
+        }
+    }
+}
+
+void LoadMeshes(D3D12Core* d3d12Core)
+{
+    d3d12Core->sceneVertices.assign(verticesList, verticesList + _countof(verticesList));
+    d3d12Core->sceneIndices.assign(indicesList, indicesList + _countof(indicesList));
+
+    Mesh cube = {};
+    cube.baseVertex = 0;
+    cube.vertexCount = 8;
+    cube.lods[0] = { 0, 36, 0.0f };
+    cube.lodCount = 1;
+    d3d12Core->meshes.push_back(cube);
+
+    Mesh pyramid = {};
+    pyramid.baseVertex = 8;
+    pyramid.vertexCount = 4;
+    pyramid.lods[0] = { 36, 12, 0.0f };
+    pyramid.lodCount = 1;
+    d3d12Core->meshes.push_back(pyramid);
+
+    // Cena passada na linha de comando: as malhas importadas ficam depois das de exemplo.
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER loadStart;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&loadStart);
+
+    const size_t firstSceneVertex = d3d12Core->sceneVertices.size();
+    const size_t firstSceneIndex = d3d12Core->sceneIndices.size();
+
+    std::vector<Model> importedModels;
+    const std::wstring& scenePath = d3d12Core->scenePath;
+    if (scenePath.size() > 4 && _wcsicmp(scenePath.c_str() + scenePath.size() - 4, L".pak") == 0)
+    {
+        // Pacote: s as tabelas das malhas so lidas aqui; vrtices e ndices chegam por streaming.
+        ThrowIfFailed(OpenStreaming(&d3d12Core->streaming, &d3d12Core->jobSystem, scenePath.c_str(), &d3d12Core->meshes, &importedModels));
+        d3d12Core->streamingEnabled = true;
+    }
+    else if (scenePath.size() > 6 && _wcsicmp(scenePath.c_str() + scenePath.size() - 6, L".imesh") == 0)
+    {
+        // Malha cozida pelo Cooker: LODs e limites j vm prontos.
+        LoadBakedMesh(scenePath.c_str(), &d3d12Core->sceneVertices, &d3d12Core->sceneIndices, &d3d12Core->meshes, &importedModels);
+    }
+    else if (scenePath.size() > 4 && _wcsicmp(scenePath.c_str() + scenePath.size() - 4, L".glb") == 0)
+    {
+        ImportGltf(&d3d12Core->jobSystem, scenePath.c_str(), &d3d12Core->sceneVertices, &d3d12Core->sceneIndices, &d3d12Core->meshes, &importedModels);
+    }
+    else if (!scenePath.empty())
+    {
+        const UINT firstImportedMesh = static_cast<UINT>(d3d12Core->meshes.size());
+        ImportObj(&d3d12Core->jobSystem, scenePath.c_str(), &d3d12Core->sceneVertices, &d3d12Core->sceneIndices, &d3d12Core->meshes);
+
+        // OBJ no tem hierarquia: um modelo na origem por malha.
+        for (UINT i = firstImportedMesh; i < d3d12Core->meshes.size(); i++)
+        {
+            Model model = {};
+            model.meshIndex = i;
+            XMStoreFloat4x4(&model.world, XMMatrixIdentity());
+            importedModels.push_back(model);
+        }
+    }
+
+    LARGE_INTEGER loadEnd;
+    QueryPerformanceCounter(&loadEnd);
+
+    const double sceneBytes = static_cast<double>((d3d12Core->sceneVertices.size() - firstSceneVertex) * sizeof(Vertex) + (d3d12Core->sceneIndices.size() - firstSceneIndex) * sizeof(UINT));
+
+    const Vertex* vertices = d3d12Core->sceneVertices.data();
+
+    // Cadeia de LODs gerada na importao; os novos nveis so anexados ao final do index buffer.
+    BuildLodChains(&d3d12Core->jobSystem, d3d12Core->meshes.data(), static_cast<UINT>(d3d12Core->meshes.size()), vertices, &d3d12Core->sceneIndices, &DefaultLodChainOptions);
+    BuildSceneMeshlets(&d3d12Core->jobSystem, d3d12Core->meshes.data(), static_cast<UINT>(d3d12Core->meshes.size()), vertices, &d3d12Core->sceneIndices, &d3d12Core->meshlets, &d3d12Core->meshletBounds);
+    BuildSceneClusterDags(&d3d12Core->jobSystem, d3d12Core->meshes.data(), static_cast<UINT>(d3d12Core->meshes.size()), vertices, d3d12Core->meshlets.data(), &d3d12Core->sceneIndices, &d3d12Core->dagClusters, &d3d12Core->dagClusterBounds);
+
+    for (Mesh& mesh : d3d12Core->meshes)
+    {
+        if (!mesh.pending)
+            ComputeMeshBounds(&mesh, vertices, d3d12Core->sceneIndices.data());
+    }
+
+    Model model = {};
+    model.meshIndex = 0;
+    XMStoreFloat4x4(&model.world, XMMatrixTranslation(-1.5f, 0.0f, 0.0f));
+    d3d12Core->models.push_back(model);
+
+    model.meshIndex = 1;
+    XMStoreFloat4x4(&model.world, XMMatrixTranslation(1.5f, 0.0f, 0.0f));
+    d3d12Core->models.push_back(model);
+
+    for (UINT i = 0; i < importedModels.size() && d3d12Core->models.size() < MaxModelCount; i++)
+    {
+        d3d12Core->models.push_back(importedModels[i]);
+    }
+
+    CreateSceneLights(d3d12Core);
+
+    // Os pools de streaming ocupam o que sobra dos buffers de upload, at o oramento.
+    if (d3d12Core->streamingEnabled)
+    {
+        const UINT vertexCapacity = MaxVertexCount - static_cast<UINT>(d3d12Core->sceneVertices.size());
+        const UINT indexCapacity = sizeof(Vertex) * MaxVertexCount / sizeof(UINT) - static_cast<UINT>(d3d12Core->sceneIndices.size());
+
+        StartStreaming(&d3d12Core->streaming, &d3d12Core->streamingSettings, &d3d12Core->sceneVertices, &d3d12Core->sceneIndices,
+            vertexCapacity, indexCapacity, FrameCount);
+    }
+
+    // Tempo de leitura da cena (bytes entregues aos buffers de upload) e o total at a cena estar pronta para o
+    // primeiro quadro, incluindo LODs, meshlets e DAGs gerados aqui.
+    if (!scenePath.empty())
+    {
+        LARGE_INTEGER sceneReady;
+        QueryPerformanceCounter(&sceneReady);
+
+        const double loadSeconds = static_cast<double>(loadEnd.QuadPart - loadStart.QuadPart) / frequency.QuadPart;
+        const double readySeconds = static_cast<double>(sceneReady.QuadPart - loadStart.QuadPart) / frequency.QuadPart;
+
+        printf("Cena: %.1f MB em %.1f ms (%.0f MB/s), pronta em %.1f ms\n", sceneBytes / (1024.0 * 1024.0), loadSeconds * 1000.0,
+            sceneBytes / (1024.0 * 1024.0) / (loadSeconds > 0.0 ? loadSeconds : 1.0), readySeconds * 1000.0);
     }
 }
 
@@ -898,14 +2267,36 @@ void LoadAssets(D3D12Core* d3d12Core)
 
     
     {
-        CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
+        // Texturas: tabela sem limite (t0, space1) sobre a regio persistente do heap. Os descritores mudam
+        // enquanto a tabela est ligada, por isso DESCRIPTORS_VOLATILE. Exige resource binding tier 2.
+        CD3DX12_DESCRIPTOR_RANGE1 ranges[3];
         ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 1, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
        
-        CD3DX12_ROOT_PARAMETER1 rootParameters[1];
+        // Constante de root b1 com o ndice do material e o buffer de materiais em t0.
+        // Sombras: cascatas em b2, ndice da cascata do shadow pass em b3 e o shadow map em t1.
+        // Luzes locais: constantes dos clusters em b4; luzes, listas dos clusters e ndices em t2, t3 e t4.
+        CD3DX12_ROOT_PARAMETER1 rootParameters[11];
         rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_ALL);
+        rootParameters[1].InitAsConstants(1, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[2].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[3].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[4].InitAsConstantBufferView(2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_ALL);
+        rootParameters[5].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[6].InitAsDescriptorTable(1, &ranges[2], D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[7].InitAsConstantBufferView(4, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[8].InitAsShaderResourceView(2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[9].InitAsShaderResourceView(3, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[10].InitAsShaderResourceView(4, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_PIXEL);
+
+        // Comparao com filtro linear: PCF 2x2 do hardware. Fora do shadow map, tudo  iluminado.
+        const CD3DX12_STATIC_SAMPLER_DESC shadowSampler(0, D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT,
+            D3D12_TEXTURE_ADDRESS_MODE_BORDER, D3D12_TEXTURE_ADDRESS_MODE_BORDER, D3D12_TEXTURE_ADDRESS_MODE_BORDER,
+            0.0f, 1, D3D12_COMPARISON_FUNC_LESS_EQUAL, D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE, 0.0f, D3D12_FLOAT32_MAX, D3D12_SHADER_VISIBILITY_PIXEL);
 
         CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-        rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+        rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 1, &shadowSampler, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
         ComPtr<ID3DBlob> signature;
         ComPtr<ID3DBlob> error;
@@ -924,8 +2315,8 @@ void LoadAssets(D3D12Core* d3d12Core)
         UINT compileFlags = D3DCOMPILE_OPTIMIZATION_LEVEL3;
 #endif
 
-        ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-        ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
+        ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, nullptr));
+        ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, nullptr));
 
         const D3D12_INPUT_ELEMENT_DESC StandardVertexDescription[] =
         {
@@ -956,6 +2347,21 @@ void LoadAssets(D3D12Core* d3d12Core)
         psoDesc.SampleDesc.Count = 1;
 
         ThrowIfFailed(d3d12Core->device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&d3d12Core->pipelineState)));
+
+        // Shadow map: s profundidade, com vis e sem depth clip, para os casters antes do near da cascata
+        // ficarem presos em 0 em vez de sumir.
+        ComPtr<ID3DBlob> shadowVertexShader;
+        ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "VSShadow", "vs_5_1", compileFlags, 0, &shadowVertexShader, nullptr));
+
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(shadowVertexShader.Get());
+        psoDesc.PS = {};
+        psoDesc.RasterizerState.DepthBias = ShadowDepthBias;
+        psoDesc.RasterizerState.SlopeScaledDepthBias = ShadowSlopeScaledDepthBias;
+        psoDesc.RasterizerState.DepthClipEnable = FALSE;
+        psoDesc.NumRenderTargets = 0;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+
+        ThrowIfFailed(d3d12Core->device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&d3d12Core->pipelineStateShadowMap)));
     }
 
     
@@ -995,28 +2401,84 @@ void LoadAssets(D3D12Core* d3d12Core)
         clearValue.DepthStencil.Depth = 1.0f;
         clearValue.DepthStencil.Stencil = 0;
 
-        ThrowIfFailed(d3d12Core->device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-            D3D12_HEAP_FLAG_NONE,
+        ThrowIfFailed(CreateGpuResource(
+            &d3d12Core->gpuMemory,
+            D3D12_HEAP_TYPE_DEFAULT,
             &shadowTextureDesc,
             D3D12_RESOURCE_STATE_DEPTH_WRITE,
             &clearValue,
-            IID_PPV_ARGS(&d3d12Core->depthStencil)));
+            GpuMemoryTargets,
+            &d3d12Core->depthStencilAllocation,
+            &d3d12Core->depthStencil));
 
         
         d3d12Core->device->CreateDepthStencilView(d3d12Core->depthStencil.Get(), nullptr, d3d12Core->dsvHeap->GetCPUDescriptorHandleForHeapStart());
     }
 
-    // Cria o vertex buffer.
+    // Shadow map em cascata: uma fatia por cascata, escrita como D32 e lida como R32. Fica em leitura fora do
+    // shadow pass.
+    {
+        const UINT cascadeCount = d3d12Core->shadowSettings.cascadeCount;
+        const UINT resolution = d3d12Core->shadowSettings.resolution;
+        const CD3DX12_RESOURCE_DESC shadowMapDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_TYPELESS, resolution, resolution,
+            static_cast<UINT16>(cascadeCount), 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+        D3D12_CLEAR_VALUE clearValue = {};
+        clearValue.Format = DXGI_FORMAT_D32_FLOAT;
+        clearValue.DepthStencil.Depth = 1.0f;
+
+        ThrowIfFailed(CreateGpuResource(
+            &d3d12Core->gpuMemory,
+            D3D12_HEAP_TYPE_DEFAULT,
+            &shadowMapDesc,
+            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+            &clearValue,
+            GpuMemoryTargets,
+            &d3d12Core->shadowMapAllocation,
+            &d3d12Core->shadowMap));
+
+        for (UINT i = 0; i < cascadeCount; i++)
+        {
+            D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+            dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+            dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+            dsvDesc.Texture2DArray.FirstArraySlice = i;
+            dsvDesc.Texture2DArray.ArraySize = 1;
+
+            CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(d3d12Core->dsvHeap->GetCPUDescriptorHandleForHeapStart(), 1 + i, d3d12Core->dsvDescriptorSize);
+            d3d12Core->device->CreateDepthStencilView(d3d12Core->shadowMap.Get(), &dsvDesc, dsvHandle);
+        }
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Texture2DArray.MipLevels = 1;
+        srvDesc.Texture2DArray.ArraySize = cascadeCount;
+
+        const UINT view = AllocateDescriptor(&d3d12Core->descriptors.staging);
+        if (view == DescriptorNull)
+            ThrowIfFailed(E_OUTOFMEMORY);
+
+        d3d12Core->device->CreateShaderResourceView(d3d12Core->shadowMap.Get(), &srvDesc, GetStagingDescriptor(&d3d12Core->descriptors, view));
+        ThrowIfFailed(CreatePersistentDescriptor(&d3d12Core->descriptors, view, &d3d12Core->shadowMapDescriptor));
+    }
+
+    InitUploads(d3d12Core);
+
+    // Cria o vertex buffer. Vrtices e ndices ficam na memria da GPU e chegam pela fila de cpia; buffers em
+    // COMMON so promovidos sozinhos para cpia numa fila e leitura na outra.
     {
         
-        ThrowIfFailed(d3d12Core->device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
+        ThrowIfFailed(CreateGpuResource(
+            &d3d12Core->gpuMemory,
+            D3D12_HEAP_TYPE_DEFAULT,
             &CD3DX12_RESOURCE_DESC::Buffer(sizeof(Vertex) * MaxVertexCount),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
+            D3D12_RESOURCE_STATE_COMMON,
             nullptr,
-            IID_PPV_ARGS(&d3d12Core->vertexBuffer)));
+            GpuMemoryGeometry,
+            &d3d12Core->vertexBufferAllocation,
+            &d3d12Core->vertexBuffer));
 
         d3d12Core->vertexBufferView.BufferLocation = d3d12Core->vertexBuffer->GetGPUVirtualAddress();
         d3d12Core->vertexBufferView.StrideInBytes = sizeof(Vertex);
@@ -1027,13 +2489,15 @@ void LoadAssets(D3D12Core* d3d12Core)
     // Cria o index buffer.
     {
 
-        ThrowIfFailed(d3d12Core->device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
+        ThrowIfFailed(CreateGpuResource(
+            &d3d12Core->gpuMemory,
+            D3D12_HEAP_TYPE_DEFAULT,
             &CD3DX12_RESOURCE_DESC::Buffer(sizeof(Vertex) * MaxVertexCount),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
+            D3D12_RESOURCE_STATE_COMMON,
             nullptr,
-            IID_PPV_ARGS(&d3d12Core->indexBuffer)));
+            GpuMemoryGeometry,
+            &d3d12Core->indexBufferAllocation,
+            &d3d12Core->indexBuffer));
 
         d3d12Core->indexBufferView.BufferLocation = d3d12Core->indexBuffer->GetGPUVirtualAddress();
         d3d12Core->indexBufferView.Format = DXGI_FORMAT_R32_UINT;
@@ -1041,6 +2505,20 @@ void LoadAssets(D3D12Core* d3d12Core)
     }
 
     
+    LoadMeshes(d3d12Core);
+
+    // A parte esttica da cena vai uma vez s; os pools do streaming seguem conforme as malhas chegam.
+    {
+        const UINT64 vertexCount = d3d12Core->streamingEnabled ? d3d12Core->streaming.vertexPool.base : d3d12Core->sceneVertices.size();
+        const UINT64 indexCount = d3d12Core->streamingEnabled ? d3d12Core->streaming.indexPool.base : d3d12Core->sceneIndices.size();
+
+        QueueUpload(&d3d12Core->uploads, d3d12Core->vertexBuffer.Get(), 0, d3d12Core->sceneVertices.data(), vertexCount * sizeof(Vertex));
+        QueueUpload(&d3d12Core->uploads, d3d12Core->indexBuffer.Get(), 0, d3d12Core->sceneIndices.data(), indexCount * sizeof(UINT));
+        d3d12Core->uploadFenceValue = FlushUploads(&d3d12Core->uploads);
+    }
+
+    LoadTextures(d3d12Core);
+
     ThrowIfFailed(commandList->Close());
     ID3D12CommandList* ppCommandLists[] = { commandList.Get() };
     d3d12Core->commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
@@ -1137,6 +2615,12 @@ void ResetFrameResource(FrameResource* frameResource)
         ThrowIfFailed(frameResource->sceneCommandAllocators[i]->Reset());
         ThrowIfFailed(frameResource->sceneCommandLists[i]->Reset(frameResource->sceneCommandAllocators[i].Get(), frameResource->pipelineState.Get()));
     }
+
+    for (int i = 0; i < MaxShadowCascades; i++)
+    {
+        ThrowIfFailed(frameResource->shadowCommandAllocators[i]->Reset());
+        ThrowIfFailed(frameResource->shadowCommandLists[i]->Reset(frameResource->shadowCommandAllocators[i].Get(), frameResource->pipelineStateShadowMap.Get()));
+    }
 }
 
 // -----------------------------------------------------------------------------------------------------
@@ -1153,11 +2637,16 @@ void BeginFrame(D3D12Core* d3d12Core)
     d3d12Core->currentFrameResource->commandLists[CommandListPre]->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
     d3d12Core->currentFrameResource->commandLists[CommandListPre]->ClearDepthStencilView(d3d12Core->dsvHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
+    // As cascatas no so limpas aqui: cada lista limpa s os retngulos que redesenha.
+    d3d12Core->currentFrameResource->commandLists[CommandListPre]->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(d3d12Core->shadowMap.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+
     ThrowIfFailed(d3d12Core->currentFrameResource->commandLists[CommandListPre]->Close());
 }
 
 void MidFrame(D3D12Core* d3d12Core)
 {
+    d3d12Core->currentFrameResource->commandLists[CommandListMid]->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(d3d12Core->shadowMap.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
     ThrowIfFailed(d3d12Core->currentFrameResource->commandLists[CommandListMid]->Close());
 }
 
@@ -1172,9 +2661,16 @@ void EndFrame(D3D12Core* d3d12Core)
 
 void OnInit(D3D12Core* d3d12Core)
 {
+    InitJobSystem(&d3d12Core->jobSystem);
+
+    if (d3d12Core->flythroughMode == FlythroughReplay)
+        ThrowIfFailed(LoadFlythrough(d3d12Core->flythroughPath.c_str(), &d3d12Core->flythrough));
+
     LoadPipeline(d3d12Core);
     LoadAssets(d3d12Core);
     LoadContexts(d3d12Core);
+
+    PrintGpuMemory(&d3d12Core->gpuMemory);
 }
 
 void OnUpdate(D3D12Core* d3d12Core)
@@ -1186,6 +2682,33 @@ void OnUpdate(D3D12Core* d3d12Core)
     if (d3d12Core->frameCounter == 100)
     {
         std::cout << "FPS: " << d3d12Core->timer.framesPerSecond << std::endl;
+
+        if (d3d12Core->streamingEnabled)
+        {
+            const StreamingSystem* streaming = &d3d12Core->streaming;
+            printf("Streaming: %u de %u malhas residentes, %.1f MB lidos, %u despejadas, %u quadros com malhas faltando\n", streaming->residentMeshCount,
+                static_cast<UINT>(streaming->streamedMeshes.size()), streaming->streamedBytes / (1024.0 * 1024.0), streaming->evictedMeshCount,
+                streaming->stallFrameCount);
+        }
+
+        printf("Sombras: %llu de %llu draws (%.1f%%), %.1f tiles redesenhados por quadro\n", d3d12Core->shadowDrawCount, d3d12Core->shadowCasterCount,
+            d3d12Core->shadowCasterCount ? 100.0 * d3d12Core->shadowDrawCount / d3d12Core->shadowCasterCount : 0.0,
+            static_cast<double>(d3d12Core->shadowDirtyTileCount) / d3d12Core->frameCounter);
+        d3d12Core->shadowDrawCount = 0;
+        d3d12Core->shadowCasterCount = 0;
+        d3d12Core->shadowDirtyTileCount = 0;
+
+        const LightClusterGrid* grid = &d3d12Core->lightClusters;
+        const LightBvh* lightBvh = &d3d12Core->lightBvh;
+        printf("Luzes: %u, %u visveis em %u clusters, %u ndices (%u descartados), BVH em %.3f ms (%u montagens) e clusters em %.3f ms por quadro\n",
+            static_cast<UINT>(d3d12Core->lights.size()), static_cast<UINT>(d3d12Core->visibleLights.size()), static_cast<UINT>(grid->clusters.size()),
+            static_cast<UINT>(grid->lightIndices.size()), grid->overflowCount,
+            1000.0 * d3d12Core->lightBvhTicks / d3d12Core->timer.qpcFrequency.QuadPart / d3d12Core->frameCounter, lightBvh->buildCount,
+            1000.0 * d3d12Core->lightClusterTicks / d3d12Core->timer.qpcFrequency.QuadPart / d3d12Core->frameCounter);
+        d3d12Core->lightBvh.buildCount = 0;
+        d3d12Core->lightBvh.refitCount = 0;
+        d3d12Core->lightBvhTicks = 0;
+        d3d12Core->lightClusterTicks = 0;
         d3d12Core->frameCounter = 0;
     }
 
@@ -1211,13 +2734,41 @@ void OnUpdate(D3D12Core* d3d12Core)
         CloseHandle(eventHandle);
     }
 
-    UpdateCamera(&d3d12Core->camera, TicksToSeconds(&d3d12Core->timer, d3d12Core->timer.elapsedTicks));
-    WriteConstantBuffers(d3d12Core->currentFrameResource, &d3d12Core->camera, &d3d12Core->viewport);
+    const UINT64 completedFence = d3d12Core->fence->GetCompletedValue();
+    ProcessReleases(&d3d12Core->releaseQueue, completedFence);
+    RetireDescriptorRingFrames(&d3d12Core->descriptors.transient, completedFence);
+
+    const float elapsedSeconds = static_cast<float>(TicksToSeconds(&d3d12Core->timer, d3d12Core->timer.elapsedTicks));
+    if (d3d12Core->flythroughMode == FlythroughReplay)
+    {
+        ReplayFlythrough(d3d12Core);
+    }
+    else
+    {
+        UpdateCamera(&d3d12Core->camera, elapsedSeconds);
+    }
+
+    if (d3d12Core->flythroughMode == FlythroughRecord)
+    {
+        const Camera* camera = &d3d12Core->camera;
+        d3d12Core->flythrough.push_back({ elapsedSeconds, camera->position, camera->pitch, camera->yaw, camera->roll, 0.0f });
+    }
+
+    WriteConstantBuffers(d3d12Core->currentFrameResource, &d3d12Core->camera, &d3d12Core->viewport, d3d12Core->models.data(), static_cast<UINT>(d3d12Core->models.size()));
+    WriteMaterials(d3d12Core, d3d12Core->currentFrameResource);
+    UpdateDrawList(d3d12Core);
+    UpdateShadows(d3d12Core);
+    UpdateLights(d3d12Core);
+    FlushDescriptorCopies(&d3d12Core->descriptors);
 }
 
 void OnRender(D3D12Core* d3d12Core)
 {
+    // Nenhuma lista do quadro executa antes das cpias de que ele depende.
+    ThrowIfFailed(d3d12Core->commandQueue->Wait(d3d12Core->copyFence.Get(), d3d12Core->uploadFenceValue));
+
     BeginFrame(d3d12Core);
+    RecordShadowPass(d3d12Core);
 
 #if SINGLETHREADED
     for (int i = 0; i < NumContexts; i++)
@@ -1240,12 +2791,14 @@ void OnRender(D3D12Core* d3d12Core)
     WaitForMultipleObjects(NumContexts, d3d12Core->workerFinishShadowPass, TRUE, INFINITE);
 
     
-    d3d12Core->commandQueue->ExecuteCommandLists(2, d3d12Core->currentFrameResource->batchSubmit); // Submit PRE, MID and shadows.
+    // PRE, as cascatas e MID saem enquanto as threads ainda gravam a cena.
+    const UINT shadowBatchSize = MaxShadowCascades + 2;
+    d3d12Core->commandQueue->ExecuteCommandLists(shadowBatchSize, d3d12Core->currentFrameResource->batchSubmit);
 
     WaitForMultipleObjects(NumContexts, d3d12Core->workerFinishedRenderFrame, TRUE, INFINITE);
 
     
-    d3d12Core->commandQueue->ExecuteCommandLists(_countof(d3d12Core->currentFrameResource->batchSubmit) - 2, d3d12Core->currentFrameResource->batchSubmit + 2);
+    d3d12Core->commandQueue->ExecuteCommandLists(_countof(d3d12Core->currentFrameResource->batchSubmit) - shadowBatchSize, d3d12Core->currentFrameResource->batchSubmit + shadowBatchSize);
 
 #endif
 
@@ -1255,6 +2808,7 @@ void OnRender(D3D12Core* d3d12Core)
 
 
     d3d12Core->currentFrameResource->fenceValue = d3d12Core->fenceValue;
+    FinishDescriptorRingFrame(&d3d12Core->descriptors.transient, d3d12Core->fenceValue);
     ThrowIfFailed(d3d12Core->commandQueue->Signal(d3d12Core->fence.Get(), d3d12Core->fenceValue));
     d3d12Core->fenceValue++;
 }
@@ -1278,6 +2832,9 @@ void OnDestroy(D3D12Core* d3d12Core)
         CloseHandle(d3d12Core->fenceEvent);
     }
 
+    WaitForUploads(&d3d12Core->uploads);
+    CloseHandle(d3d12Core->copyFenceEvent);
+
 #if !SINGLETHREADED
 
     for (int i = 0; i < NumContexts; i++)
@@ -1291,9 +2848,33 @@ void OnDestroy(D3D12Core* d3d12Core)
 
     for (int i = 0; i < _countof(d3d12Core->frameResources); i++)
     {
-        DestroyFrameResource(d3d12Core->frameResources[i]);
+        DestroyFrameResource(d3d12Core, d3d12Core->frameResources[i]);
         delete d3d12Core->frameResources[i];
     }
+
+    if (d3d12Core->streamingEnabled)
+        DestroyStreaming(&d3d12Core->streaming);
+
+    ReleaseGpuResource(d3d12Core, &d3d12Core->uploadStaging, &d3d12Core->uploadStagingAllocation);
+    ReleaseGpuResource(d3d12Core, &d3d12Core->vertexBuffer, &d3d12Core->vertexBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &d3d12Core->indexBuffer, &d3d12Core->indexBufferAllocation);
+    ReleaseGpuResource(d3d12Core, &d3d12Core->depthStencil, &d3d12Core->depthStencilAllocation);
+    ReleaseGpuResource(d3d12Core, &d3d12Core->shadowMap, &d3d12Core->shadowMapAllocation);
+
+    for (Texture& texture : d3d12Core->textures)
+    {
+        ReleaseGpuResource(d3d12Core, &texture.resource, &texture.allocation);
+    }
+
+    // A GPU j parou: o que ainda estiver na fila sai agora.
+    FlushReleases(&d3d12Core->releaseQueue);
+    DestroyDescriptorManager(&d3d12Core->descriptors);
+    DestroyGpuMemory(&d3d12Core->gpuMemory);
+
+    if (d3d12Core->flythroughMode == FlythroughRecord)
+        ThrowIfFailed(SaveFlythrough(d3d12Core->flythroughPath.c_str(), d3d12Core->flythrough.data(), static_cast<UINT>(d3d12Core->flythrough.size())));
+
+    DestroyJobSystem(&d3d12Core->jobSystem);
 }
 
 // -----------------------------------------------------------------------------------------------------
@@ -1424,6 +3005,43 @@ int main()
 {
     D3D12Core d3d12Core;
     InitD3D12Core(1280, 720, L"Infinity Engine [DX12]", &d3d12Core);
+
+    // Infinity.exe [cena.obj | cena.glb | cena.imesh | cena.pak] [-record voo.fly | -replay voo.fly] [-prefetch segundos] [-budget MB] [-texture arquivo.dds | arquivo.ktx2]... [-lights N]
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    for (int i = 1; argv && i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (hasValue && (wcscmp(argv[i], L"-record") == 0 || wcscmp(argv[i], L"-replay") == 0))
+        {
+            d3d12Core.flythroughMode = (wcscmp(argv[i], L"-replay") == 0) ? FlythroughReplay : FlythroughRecord;
+            d3d12Core.flythroughPath = argv[++i];
+        }
+        else if (hasValue && wcscmp(argv[i], L"-prefetch") == 0)
+        {
+            d3d12Core.streamingSettings.prefetchSeconds = static_cast<float>(_wtof(argv[++i]));
+        }
+        else if (hasValue && wcscmp(argv[i], L"-budget") == 0)
+        {
+            // O oramento em MB  dividido supondo quatro ndices por vrtice.
+            const UINT64 bytes = static_cast<UINT64>(_wtoi(argv[++i])) * 1024 * 1024;
+            d3d12Core.streamingSettings.vertexBudget = static_cast<UINT>(bytes / (sizeof(Vertex) + 4 * sizeof(UINT)));
+            d3d12Core.streamingSettings.indexBudget = 4 * d3d12Core.streamingSettings.vertexBudget;
+        }
+        else if (hasValue && wcscmp(argv[i], L"-texture") == 0)
+        {
+            d3d12Core.texturePaths.push_back(argv[++i]);
+        }
+        else if (hasValue && wcscmp(argv[i], L"-lights") == 0)
+        {
+            d3d12Core.sceneLightCount = static_cast<UINT>(_wtoi(argv[++i]));
+        }
+        else
+        {
+            d3d12Core.scenePath = argv[i];
+        }
+    }
+    LocalFree(argv);
     //D3D12Multithreading sample(1280, 720, L"D3D12 Multithreading Sample");
     //return Win32Application::Run(&sample, hInstance, nCmdShow);
     return RunWin32App(&d3d12Core, 0, 1);;
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <DirectXMath.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <stdexcept>
+#include <string>
+
+using namespace DirectX;
+
+// -----------------------------------------------------------------------------------------------------
+
+inline std::string HrToString(HRESULT hr)
+{
+    char str[64] = {};
+    sprintf_s(str, "HRESULT: 0x%08X", static_cast<UINT>(hr));
+    return std::string(str);
+}
+
+class HrException : public std::runtime_error
+{
+public:
+    HrException(HRESULT hr) : std::runtime_error(HrToString(hr)), hr(hr) {}
+    HRESULT Error() const { return hr; }
+private:
+    const HRESULT hr;
+};
+
+inline void ThrowIfFailed(HRESULT hr)
+{
+    if (FAILED(hr))
+    {
+        throw HrException(hr);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// ndice do bit 1 mais alto e do mais baixo. value no pode ser 0.
+inline UINT FindLastSet(UINT64 value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline UINT FindFirstSet(UINT64 value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct Vertex
+{
+    XMFLOAT3 position;
+    XMFLOAT4 color;
+};
+
+const UINT MaxVertexCount = 10000000;
+const UINT MaxModelCount = 10000;
+
+const UINT MaxLodCount = 8;
+
+// Faixa de ndices de um nvel de detalhe. O erro  a distncia geomtrica mxima (em unidades do modelo)
+// entre este nvel e a malha original.
+struct MeshLod
+{
+    UINT startIndex;
+    UINT indexCount;
+    float error;
+};
+
+// Malha desenhada com DrawIndexedInstanced(lods[i].indexCount, 1, lods[i].startIndex, baseVertex, 0).
+// lods[0]  sempre a malha completa.
+struct Mesh
+{
+    UINT baseVertex;
+    UINT vertexCount;
+
+    MeshLod lods[MaxLodCount];
+    UINT lodCount;
+
+    // Esfera envolvente no espao do modelo.
+    XMFLOAT3 boundsCenter;
+    float boundsRadius;
+
+    // Clusters do nvel 0 (meshletCount == 0 para malhas pequenas).
+    UINT meshletOffset;
+    UINT meshletCount;
+
+    // DAG de clusters (dagClusterCount == 0 quando a malha no  grande o bastante).
+    UINT dagClusterOffset;
+    UINT dagClusterCount;
+
+    // Malha registrada pelo streaming cujos vrtices e ndices ainda no esto nos buffers da cena.
+    bool pending;
+};
+
+// Instncia de uma malha na cena. O ndice do modelo  tambm o ndice do seu constant buffer.
+struct Model
+{
+    UINT meshIndex;
+    XMFLOAT4X4 world;
+
+    UINT currentLod;
+
+    // ndice na tabela de materiais (0  o material padro).
+    UINT materialIndex;
+};
+
+// Luz pontual ou spot, em espao de mundo. Tambm  o layout de LocalLight em shaders.hlsl. A intensidade vai na
+// cor e cai a zero no alcance; luzes pontuais tm spotCosOuter = -1 (o cone abre a esfera inteira).
+struct LocalLight
+{
+    XMFLOAT3 position;
+    float range;
+    XMFLOAT3 direction;
+    float spotCosOuter;
+    XMFLOAT3 color;
+    float spotCosInner;
+};
@@ -0,0 +1,141 @@
+#include "jobs.h"
+
+#include <process.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Valor de nextJob fora de um lote: workers acordados atrasados no pegam nenhum ndice.
+const LONG IdleJobIndex = 0x40000000;
+
+static thread_local bool insideJob = false;
+
+static void RunJobs(JobSystem* jobSystem)
+{
+    insideJob = true;
+
+    for (;;)
+    {
+        const LONG jobIndex = InterlockedIncrement(&jobSystem->nextJob) - 1;
+        if (jobIndex >= static_cast<LONG>(jobSystem->jobCount))
+            break;
+
+        jobSystem->func(jobSystem->context, static_cast<UINT>(jobIndex));
+
+        if (InterlockedDecrement(&jobSystem->pendingJobs) == 0)
+        {
+            SetEvent(jobSystem->workFinished);
+        }
+    }
+
+    insideJob = false;
+}
+
+static unsigned int WINAPI JobThread(LPVOID lpParameter)
+{
+    JobSystem* jobSystem = reinterpret_cast<JobSystem*>(lpParameter);
+
+    for (;;)
+    {
+        WaitForSingleObject(jobSystem->workAvailable, INFINITE);
+
+        if (InterlockedCompareExchange(&jobSystem->quit, 0, 0))
+            break;
+
+        RunJobs(jobSystem);
+    }
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitJobSystem(JobSystem* jobSystem, UINT threadCount)
+{
+    if (threadCount == 0)
+    {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        threadCount = systemInfo.dwNumberOfProcessors > 1 ? systemInfo.dwNumberOfProcessors - 1 : 1;
+    }
+
+    jobSystem->threadCount = threadCount < MaxWorkerThreadCount ? threadCount : MaxWorkerThreadCount;
+    jobSystem->func = nullptr;
+    jobSystem->context = nullptr;
+    jobSystem->jobCount = 0;
+    jobSystem->nextJob = IdleJobIndex;
+    jobSystem->pendingJobs = 0;
+    jobSystem->quit = 0;
+
+    InitializeCriticalSection(&jobSystem->dispatchLock);
+
+    jobSystem->workAvailable = CreateSemaphore(nullptr, 0, MaxWorkerThreadCount * 64, nullptr);
+    jobSystem->workFinished = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (jobSystem->workAvailable == nullptr || jobSystem->workFinished == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    for (UINT i = 0; i < jobSystem->threadCount; i++)
+    {
+        jobSystem->threadHandles[i] = reinterpret_cast<HANDLE>(_beginthreadex(
+            nullptr,
+            0,
+            JobThread,
+            reinterpret_cast<LPVOID>(jobSystem),
+            0,
+            nullptr));
+    }
+}
+
+void DestroyJobSystem(JobSystem* jobSystem)
+{
+    InterlockedExchange(&jobSystem->quit, 1);
+    ReleaseSemaphore(jobSystem->workAvailable, jobSystem->threadCount, nullptr);
+
+    WaitForMultipleObjects(jobSystem->threadCount, jobSystem->threadHandles, TRUE, INFINITE);
+
+    for (UINT i = 0; i < jobSystem->threadCount; i++)
+    {
+        CloseHandle(jobSystem->threadHandles[i]);
+    }
+
+    CloseHandle(jobSystem->workAvailable);
+    CloseHandle(jobSystem->workFinished);
+    DeleteCriticalSection(&jobSystem->dispatchLock);
+}
+
+void ParallelFor(JobSystem* jobSystem, UINT jobCount, LPJOBFUNC func, void* context)
+{
+    if (jobCount == 0)
+        return;
+
+    if (insideJob || jobCount == 1 || jobSystem->threadCount == 0)
+    {
+        for (UINT i = 0; i < jobCount; i++)
+        {
+            func(context, i);
+        }
+        return;
+    }
+
+    EnterCriticalSection(&jobSystem->dispatchLock);
+
+    jobSystem->func = func;
+    jobSystem->context = context;
+    jobSystem->jobCount = jobCount;
+    jobSystem->pendingJobs = static_cast<LONG>(jobCount);
+    ResetEvent(jobSystem->workFinished);
+
+    // Publica o lote por ltimo: a troca  uma barreira completa.
+    InterlockedExchange(&jobSystem->nextJob, 0);
+
+    const UINT wakeCount = jobCount - 1 < jobSystem->threadCount ? jobCount - 1 : jobSystem->threadCount;
+    ReleaseSemaphore(jobSystem->workAvailable, wakeCount, nullptr);
+
+    RunJobs(jobSystem);
+    WaitForSingleObject(jobSystem->workFinished, INFINITE);
+
+    InterlockedExchange(&jobSystem->nextJob, IdleJobIndex);
+
+    LeaveCriticalSection(&jobSystem->dispatchLock);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "infinity.h"
+
+const UINT MaxWorkerThreadCount = 32;
+
+typedef void(*LPJOBFUNC) (void* context, UINT jobIndex);
+
+// Pool de threads persistente usado pelas etapas de CPU (importao, LOD, culling...). A thread que chama
+// ParallelFor tambm executa jobs. Chamadas aninhadas (de dentro de um job) rodam de forma serial.
+struct JobSystem
+{
+    HANDLE threadHandles[MaxWorkerThreadCount];
+    UINT threadCount;
+
+    HANDLE workAvailable;
+    HANDLE workFinished;
+    CRITICAL_SECTION dispatchLock;
+
+    LPJOBFUNC func;
+    void* context;
+    UINT jobCount;
+    volatile LONG nextJob;
+    volatile LONG pendingJobs;
+    volatile LONG quit;
+};
+
+void InitJobSystem(JobSystem* jobSystem, UINT threadCount = 0);
+void DestroyJobSystem(JobSystem* jobSystem);
+
+void ParallelFor(JobSystem* jobSystem, UINT jobCount, LPJOBFUNC func, void* context);
@@ -0,0 +1,226 @@
+#include "json.h"
+#include "textparse.h"
+
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Limite de aninhamento: protege a pilha de quem percorre o documento recursivamente.
+const UINT MaxJsonDepth = 256;
+
+void InitJsonReader(JsonReader* reader, const char* data, size_t size)
+{
+    reader->p = data;
+    reader->end = data + size;
+    reader->stringBegin = nullptr;
+    reader->stringEnd = nullptr;
+    reader->stringEscaped = false;
+    reader->number = 0.0;
+    reader->depth = 0;
+}
+
+static inline bool IsJsonSpace(char c)
+{
+    // ':' e ',' so tratados como espao: a estrutura vem da ordem dos tokens.
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ':' || c == ',';
+}
+
+static bool MatchLiteral(JsonReader* reader, const char* literal, size_t length)
+{
+    if (static_cast<size_t>(reader->end - reader->p) < length || memcmp(reader->p, literal, length) != 0)
+        return false;
+
+    reader->p += length;
+    return true;
+}
+
+JsonToken NextJsonToken(JsonReader* reader)
+{
+    const char* p = reader->p;
+    const char* end = reader->end;
+
+    while (p < end && IsJsonSpace(*p))
+        p++;
+
+    reader->p = p;
+    if (p == end)
+        return JsonTokenEnd;
+
+    switch (*p)
+    {
+    case '{':
+    case '[':
+        if (++reader->depth > MaxJsonDepth)
+            return JsonTokenError;
+
+        reader->p++;
+        return (*p == '{') ? JsonTokenObjectBegin : JsonTokenArrayBegin;
+
+    case '}':
+    case ']':
+        if (reader->depth == 0)
+            return JsonTokenError;
+
+        reader->depth--;
+        reader->p++;
+        return (*p == '}') ? JsonTokenObjectEnd : JsonTokenArrayEnd;
+
+    case '"':
+    {
+        p++;
+        reader->stringBegin = p;
+        reader->stringEscaped = false;
+
+        for (;;)
+        {
+            // As aspas de fechamento so localizadas com memchr; escapes so raros.
+            const char* quote = reinterpret_cast<const char*>(memchr(p, '"', end - p));
+            if (!quote)
+                return JsonTokenError;
+
+            const char* backslash = quote;
+            while (backslash > reader->stringBegin && backslash[-1] == '\\')
+                backslash--;
+
+            if ((quote - backslash) % 2 == 0)
+            {
+                reader->stringEscaped |= (memchr(reader->stringBegin, '\\', quote - reader->stringBegin) != nullptr);
+                reader->stringEnd = quote;
+                reader->p = quote + 1;
+                return JsonTokenString;
+            }
+
+            p = quote + 1;
+        }
+    }
+
+    case 't':
+        return MatchLiteral(reader, "true", 4) ? JsonTokenTrue : JsonTokenError;
+
+    case 'f':
+        return MatchLiteral(reader, "false", 5) ? JsonTokenFalse : JsonTokenError;
+
+    case 'n':
+        return MatchLiteral(reader, "null", 4) ? JsonTokenNull : JsonTokenError;
+
+    default:
+    {
+        const char* next = ParseDouble(p, end, &reader->number);
+        if (next == p)
+            return JsonTokenError;
+
+        reader->p = next;
+        return JsonTokenNumber;
+    }
+    }
+}
+
+bool SkipJsonValue(JsonReader* reader, JsonToken token)
+{
+    if (token != JsonTokenObjectBegin && token != JsonTokenArrayBegin)
+        return token != JsonTokenError && token != JsonTokenEnd && token != JsonTokenObjectEnd && token != JsonTokenArrayEnd;
+
+    const UINT depth = reader->depth - 1;
+    while (reader->depth > depth)
+    {
+        const JsonToken next = NextJsonToken(reader);
+        if (next == JsonTokenError || next == JsonTokenEnd)
+            return false;
+    }
+
+    return true;
+}
+
+bool JsonStringEquals(const JsonReader* reader, const char* literal)
+{
+    const size_t length = strlen(literal);
+    return static_cast<size_t>(reader->stringEnd - reader->stringBegin) == length && memcmp(reader->stringBegin, literal, length) == 0;
+}
+
+static UINT ParseHex4(const char* p)
+{
+    UINT value = 0;
+    for (UINT i = 0; i < 4; i++)
+    {
+        const char c = p[i];
+        const UINT digit = IsDigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0;
+        value = value * 16 + digit;
+    }
+
+    return value;
+}
+
+void GetJsonString(const JsonReader* reader, std::string* value)
+{
+    if (!reader->stringEscaped)
+    {
+        value->assign(reader->stringBegin, reader->stringEnd);
+        return;
+    }
+
+    value->clear();
+    for (const char* p = reader->stringBegin; p < reader->stringEnd; p++)
+    {
+        if (*p != '\\' || p + 1 == reader->stringEnd)
+        {
+            value->push_back(*p);
+            continue;
+        }
+
+        p++;
+        switch (*p)
+        {
+        case 'b': value->push_back('\b'); break;
+        case 'f': value->push_back('\f'); break;
+        case 'n': value->push_back('\n'); break;
+        case 'r': value->push_back('\r'); break;
+        case 't': value->push_back('\t'); break;
+        case 'u':
+        {
+            if (reader->stringEnd - p < 5)
+                return;
+
+            UINT codePoint = ParseHex4(p + 1);
+            p += 4;
+
+            // Par substituto UTF-16.
+            if (codePoint >= 0xD800 && codePoint < 0xDC00 && reader->stringEnd - p >= 7 && p[1] == '\\' && p[2] == 'u')
+            {
+                const UINT low = ParseHex4(p + 3);
+                if (low >= 0xDC00 && low < 0xE000)
+                {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+            }
+
+            if (codePoint < 0x80)
+            {
+                value->push_back(static_cast<char>(codePoint));
+            }
+            else if (codePoint < 0x800)
+            {
+                value->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+                value->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            else if (codePoint < 0x10000)
+            {
+                value->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+                value->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                value->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            else
+            {
+                value->push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+                value->push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+                value->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                value->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            break;
+        }
+        default:
+            value->push_back(*p);
+            break;
+        }
+    }
+}
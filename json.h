@@ -0,0 +1,49 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <string>
+
+enum JsonToken
+{
+    JsonTokenError,
+    JsonTokenEnd,
+    JsonTokenObjectBegin,
+    JsonTokenObjectEnd,
+    JsonTokenArrayBegin,
+    JsonTokenArrayEnd,
+    JsonTokenString,
+    JsonTokenNumber,
+    JsonTokenTrue,
+    JsonTokenFalse,
+    JsonTokenNull
+};
+
+// Leitor de JSON em fluxo (sem rvore): quem chama puxa um token por vez e pula o que no interessa com
+// SkipJsonValue. Dentro de objetos, cada chave chega como um JsonTokenString seguido do valor; ':' e ',' so
+// consumidos pelo leitor. Strings apontam para o prprio buffer.
+struct JsonReader
+{
+    const char* p;
+    const char* end;
+
+    const char* stringBegin;
+    const char* stringEnd;
+    bool stringEscaped;
+    double number;
+
+    UINT depth;
+};
+
+void InitJsonReader(JsonReader* reader, const char* data, size_t size);
+
+JsonToken NextJsonToken(JsonReader* reader);
+
+// Pula o valor que comea em token (objetos e arrays inteiros). Devolve false em JSON malformado.
+bool SkipJsonValue(JsonReader* reader, JsonToken token);
+
+// Compara a ltima string lida (sem decodificar escapes) com um literal ASCII.
+bool JsonStringEquals(const JsonReader* reader, const char* literal);
+
+// Decodifica a ltima string lida para UTF-8.
+void GetJsonString(const JsonReader* reader, std::string* value);
@@ -0,0 +1,630 @@
+#include "lightbvh.h"
+
+#include <string.h>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// Os cdigos de Morton tm 10 bits por eixo e so ordenados em 3 passadas de 10 bits.
+const UINT LightBvhRadixBits = 10;
+const UINT LightBvhRadixSize = 1 << LightBvhRadixBits;
+const UINT LightBvhRadixPasses = 3;
+
+// Cada nvel corta num bit dos 30 do cdigo, ou ao meio quando os cdigos so iguais: a profundidade, e com
+// ela as pilhas, nunca passa disso.
+const UINT LightBvhMaxDepth = 64;
+
+// -----------------------------------------------------------------------------------------------------
+
+struct LightBvhContext
+{
+    LightBvh* bvh;
+    const LocalLight* lights;
+    UINT lightCount;
+    UINT chunkCount;
+    bool refitAll;              // Reajusta tambm as subrvores cujas luzes no mudaram.
+
+    // Caixa das posies, para os cdigos de Morton.
+    XMFLOAT3 boundsMin;
+    XMFLOAT3 boundsScale;
+
+    // Passada atual da ordenao.
+    const UINT* sourceCodes;
+    const UINT* sourceOrder;
+    UINT* destinationCodes;
+    UINT* destinationOrder;
+    UINT shift;
+};
+
+static void GetChunkRange(const LightBvhContext* ctx, UINT chunk, UINT count, UINT* first, UINT* last)
+{
+    *first = (std::min)(chunk * ctx->bvh->settings.chunkSize, count);
+    *last = (std::min)(*first + ctx->bvh->settings.chunkSize, count);
+}
+
+// Espalha os 10 bits baixos de value de trs em trs.
+static UINT ExpandBits(UINT value)
+{
+    value = (value * 0x00010001u) & 0xff0000ffu;
+    value = (value * 0x00000101u) & 0x0f00f00fu;
+    value = (value * 0x00000011u) & 0xc30c30c3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+// ltima folha da metade esquerda da faixa: a busca binria acha a ltima que ainda tem o bit mais alto em que
+// os cdigos da faixa diferem igual ao da primeira. Com os cdigos iguais, o meio.
+static UINT FindSplit(const UINT* codes, UINT first, UINT last)
+{
+    const UINT firstCode = codes[first];
+    const UINT difference = firstCode ^ codes[last];
+    if (difference == 0)
+        return (first + last) / 2;
+
+    const UINT bit = FindLastSet(difference);
+    UINT split = first;
+    for (UINT step = last - first; step > 1;)
+    {
+        step = (step + 1) / 2;
+        const UINT candidate = split + step;
+        if (candidate < last && ((firstCode ^ codes[candidate]) >> bit) == 0)
+            split = candidate;
+    }
+    return split;
+}
+
+// Filhos do n interno node, que cobre de first a last, em pr-ordem: a subrvore da esquerda tem split - first
+// ns internos, ento a da direita comea logo depois dela.
+static void SplitNode(LightBvh* bvh, UINT node, UINT first, UINT last, LightBvhTask* left, LightBvhTask* right)
+{
+    const UINT split = FindSplit(bvh->codes.data(), first, last);
+
+    left->node = split == first ? (LightBvhLeafFlag | first) : node + 1;
+    left->firstLight = first;
+    left->lastLight = split;
+
+    right->node = split + 1 == last ? (LightBvhLeafFlag | last) : node + 1 + (split - first);
+    right->firstLight = split + 1;
+    right->lastLight = last;
+
+    bvh->nodes[node].left = left->node;
+    bvh->nodes[node].right = right->node;
+
+    for (const LightBvhTask* child : { left, right })
+    {
+        if (child->node & LightBvhLeafFlag)
+            bvh->leafParents[child->firstLight] = node;
+        else
+            bvh->nodeParents[child->node] = node;
+    }
+}
+
+static void MakeLeaf(const LocalLight* light, LightBvhNode* leaf)
+{
+    const XMVECTOR position = XMLoadFloat3(&light->position);
+    const XMVECTOR range = XMVectorReplicate(light->range);
+    XMStoreFloat3(&leaf->boundsMin, XMVectorSubtract(position, range));
+    XMStoreFloat3(&leaf->boundsMax, XMVectorAdd(position, range));
+
+    leaf->center = light->position;
+    leaf->power = 0.2126f * light->color.x + 0.7152f * light->color.y + 0.0722f * light->color.z;
+    leaf->radius = 0.0f;
+
+    if (light->spotCosOuter > -1.0f)
+    {
+        XMStoreFloat3(&leaf->axis, XMVector3Normalize(XMLoadFloat3(&light->direction)));
+        leaf->spreadAngle = 0.0f;
+        leaf->emissionAngle = acosf((std::min)(light->spotCosOuter, 1.0f));
+    }
+    else
+    {
+        leaf->axis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+        leaf->spreadAngle = XM_PI;
+        leaf->emissionAngle = 0.0f;
+    }
+}
+
+// Menor cone que contm os dois: gira o eixo do mais aberto em direo ao outro.
+static void MergeCones(const LightBvhNode* a, const LightBvhNode* b, LightBvhNode* node)
+{
+    if (a->spreadAngle < b->spreadAngle)
+        std::swap(a, b);
+
+    node->axis = a->axis;
+    node->spreadAngle = XM_PI;
+    if (a->spreadAngle >= XM_PI)
+        return;
+
+    const XMVECTOR axisA = XMLoadFloat3(&a->axis);
+    const XMVECTOR axisB = XMLoadFloat3(&b->axis);
+    const float angle = acosf((std::max)((std::min)(XMVectorGetX(XMVector3Dot(axisA, axisB)), 1.0f), -1.0f));
+
+    if ((std::min)(angle + b->spreadAngle, XM_PI) <= a->spreadAngle)
+    {
+        node->spreadAngle = a->spreadAngle;
+        return;
+    }
+
+    const float spread = 0.5f * (a->spreadAngle + angle + b->spreadAngle);
+    if (spread >= XM_PI)
+        return;
+
+    // Eixos opostos: qualquer perpendicular serve.
+    XMVECTOR rotationAxis = XMVector3Cross(axisA, axisB);
+    if (XMVectorGetX(XMVector3LengthSq(rotationAxis)) < 1e-12f)
+        rotationAxis = XMVector3Cross(axisA, fabsf(a->axis.x) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+    const float rotation = spread - a->spreadAngle;
+    const XMVECTOR towardB = XMVector3Cross(XMVector3Normalize(rotationAxis), axisA);
+    XMStoreFloat3(&node->axis, XMVector3Normalize(XMVectorAdd(XMVectorScale(axisA, cosf(rotation)), XMVectorScale(towardB, sinf(rotation)))));
+    node->spreadAngle = spread;
+}
+
+static void MergeNodes(const LightBvhNode* a, const LightBvhNode* b, LightBvhNode* node)
+{
+    XMStoreFloat3(&node->boundsMin, XMVectorMin(XMLoadFloat3(&a->boundsMin), XMLoadFloat3(&b->boundsMin)));
+    XMStoreFloat3(&node->boundsMax, XMVectorMax(XMLoadFloat3(&a->boundsMax), XMLoadFloat3(&b->boundsMax)));
+
+    // Sem potncia nenhuma, o centro fica no meio.
+    node->power = a->power + b->power;
+    const float weight = node->power > 0.0f ? a->power / node->power : 0.5f;
+
+    const XMVECTOR centerA = XMLoadFloat3(&a->center);
+    const XMVECTOR centerB = XMLoadFloat3(&b->center);
+    const XMVECTOR center = XMVectorLerp(centerB, centerA, weight);
+    XMStoreFloat3(&node->center, center);
+
+    node->radius = (std::max)(
+        XMVectorGetX(XMVector3Length(XMVectorSubtract(centerA, center))) + a->radius,
+        XMVectorGetX(XMVector3Length(XMVectorSubtract(centerB, center))) + b->radius);
+
+    MergeCones(a, b, node);
+    node->emissionAngle = (std::max)(a->emissionAngle, b->emissionAngle);
+}
+
+static const LightBvhNode* GetNode(const LightBvh* bvh, UINT node)
+{
+    return (node & LightBvhLeafFlag) ? &bvh->leaves[node & ~LightBvhLeafFlag] : &bvh->nodes[node];
+}
+
+// Estimativa do quanto as luzes do n iluminam o ponto: a potncia sobre a distncia ao quadrado, com a mesma
+// atenuao 1 / (d^2 + 1) do shader, zerada fora da caixa de alcance ou quando nenhum cone do n aponta para o
+// ponto. Dentro do raio das posies a distncia no diminui mais.
+static float GetImportance(const LightBvhNode* node, XMVECTOR position)
+{
+    if (!XMVector3GreaterOrEqual(position, XMLoadFloat3(&node->boundsMin)) || !XMVector3LessOrEqual(position, XMLoadFloat3(&node->boundsMax)))
+        return 0.0f;
+
+    const XMVECTOR offset = XMVectorSubtract(position, XMLoadFloat3(&node->center));
+    const float distanceSquared = XMVectorGetX(XMVector3LengthSq(offset));
+
+    if (node->spreadAngle < XM_PI && distanceSquared > node->radius * node->radius)
+    {
+        // ngulo do ponto com o eixo, menos a abertura dos eixos e o ngulo que as posies ocupam vistas do ponto.
+        const float distance = sqrtf(distanceSquared);
+        const float cosAngle = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&node->axis))) / distance;
+        const float angle = acosf((std::max)((std::min)(cosAngle, 1.0f), -1.0f));
+        const float boundsAngle = asinf(node->radius / distance);
+
+        if (angle - node->spreadAngle - boundsAngle >= node->emissionAngle)
+            return 0.0f;
+    }
+
+    return node->power / ((std::max)(distanceSquared, node->radius * node->radius) + 1.0f);
+}
+
+static void BoundsJob(void* context, UINT chunk)
+{
+    const LightBvhContext* ctx = static_cast<const LightBvhContext*>(context);
+    UINT first;
+    UINT last;
+    GetChunkRange(ctx, chunk, ctx->lightCount, &first, &last);
+
+    XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+    for (UINT i = first; i < last; i++)
+    {
+        const XMVECTOR position = XMLoadFloat3(&ctx->lights[i].position);
+        minimum = XMVectorMin(minimum, position);
+        maximum = XMVectorMax(maximum, position);
+    }
+
+    XMStoreFloat4(&ctx->bvh->chunkBounds[chunk * 2], minimum);
+    XMStoreFloat4(&ctx->bvh->chunkBounds[chunk * 2 + 1], maximum);
+}
+
+static void CodeJob(void* context, UINT chunk)
+{
+    const LightBvhContext* ctx = static_cast<const LightBvhContext*>(context);
+    LightBvh* bvh = ctx->bvh;
+    UINT first;
+    UINT last;
+    GetChunkRange(ctx, chunk, ctx->lightCount, &first, &last);
+
+    const XMVECTOR boundsMin = XMLoadFloat3(&ctx->boundsMin);
+    const XMVECTOR boundsScale = XMLoadFloat3(&ctx->boundsScale);
+    const XMVECTOR cellMax = XMVectorReplicate(1023.0f);
+
+    for (UINT i = first; i < last; i++)
+    {
+        XMFLOAT3 cell;
+        XMStoreFloat3(&cell, XMVectorClamp(XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&ctx->lights[i].position), boundsMin), boundsScale), XMVectorZero(), cellMax));
+
+        bvh->codes[i] = (ExpandBits(static_cast<UINT>(cell.x)) << 2) | (ExpandBits(static_cast<UINT>(cell.y)) << 1) | ExpandBits(static_cast<UINT>(cell.z));
+        bvh->order[i] = i;
+    }
+}
+
+static void RadixCountJob(void* context, UINT chunk)
+{
+    const LightBvhContext* ctx = static_cast<const LightBvhContext*>(context);
+    UINT first;
+    UINT last;
+    GetChunkRange(ctx, chunk, ctx->lightCount, &first, &last);
+
+    UINT* histogram = &ctx->bvh->histograms[chunk * LightBvhRadixSize];
+    memset(histogram, 0, sizeof(UINT) * LightBvhRadixSize);
+
+    for (UINT i = first; i < last; i++)
+    {
+        histogram[(ctx->sourceCodes[i] >> ctx->shift) & (LightBvhRadixSize - 1)]++;
+    }
+}
+
+// O histograma do chunk j tem, depois da soma de prefixos, a posio da primeira chave de cada dgito.
+static void RadixScatterJob(void* context, UINT chunk)
+{
+    const LightBvhContext* ctx = static_cast<const LightBvhContext*>(context);
+    UINT first;
+    UINT last;
+    GetChunkRange(ctx, chunk, ctx->lightCount, &first, &last);
+
+    UINT* offsets = &ctx->bvh->histograms[chunk * LightBvhRadixSize];
+    for (UINT i = first; i < last; i++)
+    {
+        const UINT code = ctx->sourceCodes[i];
+        const UINT position = offsets[(code >> ctx->shift) & (LightBvhRadixSize - 1)]++;
+        ctx->destinationCodes[position] = code;
+        ctx->destinationOrder[position] = ctx->sourceOrder[i];
+    }
+}
+
+static float GetNodeCost(const LightBvhNode* node)
+{
+    const float sizeX = node->boundsMax.x - node->boundsMin.x;
+    const float sizeY = node->boundsMax.y - node->boundsMin.y;
+    const float sizeZ = node->boundsMax.z - node->boundsMin.z;
+    return node->power * (sizeX * sizeY + sizeY * sizeZ + sizeZ * sizeX);
+}
+
+static void BuildTaskJob(void* context, UINT taskIndex)
+{
+    const LightBvhContext* ctx = static_cast<const LightBvhContext*>(context);
+    LightBvh* bvh = ctx->bvh;
+
+    // A montagem termina com um reajuste completo: todos os ns da subrvore comeam marcados.
+    const LightBvhTask* root = &bvh->tasks[taskIndex];
+    if (!(root->node & LightBvhLeafFlag))
+        memset(&bvh->changedNodes[root->node], 1, root->lastLight - root->firstLight);
+
+    LightBvhTask stack[LightBvhMaxDepth + 1];
+    UINT stackSize = 0;
+    stack[stackSize++] = bvh->tasks[taskIndex];
+
+    while (stackSize > 0)
+    {
+        const LightBvhTask task = stack[--stackSize];
+        if (task.node & LightBvhLeafFlag)
+            continue;
+
+        SplitNode(bvh, task.node, task.firstLight, task.lastLight, &stack[stackSize], &stack[stackSize + 1]);
+        stackSize += 2;
+    }
+}
+
+// Na pr-ordem os filhos vm depois do pai: percorrer os ns da subrvore de trs para frente junta sempre filhos
+// j prontos. Fora a primeira vez, s so refeitos os ns acima das luzes que mudaram desde o quadro anterior,
+// marcados subindo pelos pais, e o custo da subrvore anda pela diferena deles.
+static void RefitTaskJob(void* context, UINT taskIndex)
+{
+    const LightBvhContext* ctx = static_cast<const LightBvhContext*>(context);
+    LightBvh* bvh = ctx->bvh;
+    const LightBvhTask* task = &bvh->tasks[taskIndex];
+
+    bool changed = false;
+    for (UINT i = task->firstLight; i <= task->lastLight; i++)
+    {
+        const LocalLight* light = &ctx->lights[bvh->order[i]];
+        if (!ctx->refitAll && memcmp(light, &bvh->previousLights[i], sizeof(LocalLight)) == 0)
+            continue;
+
+        bvh->previousLights[i] = *light;
+        MakeLeaf(light, &bvh->leaves[i]);
+        changed = true;
+
+        for (UINT parent = bvh->leafParents[i]; parent != LightBvhNullNode && parent >= task->node && !bvh->changedNodes[parent]; parent = bvh->nodeParents[parent])
+            bvh->changedNodes[parent] = 1;
+    }
+
+    if (!changed || (task->node & LightBvhLeafFlag))
+        return;
+
+    float cost = ctx->refitAll ? 0.0f : bvh->taskCosts[taskIndex];
+    for (UINT i = task->node + task->lastLight - task->firstLight; i-- > task->node;)
+    {
+        if (!bvh->changedNodes[i])
+            continue;
+
+        LightBvhNode* node = &bvh->nodes[i];
+        if (!ctx->refitAll)
+            cost -= GetNodeCost(node);
+
+        MergeNodes(GetNode(bvh, node->left), GetNode(bvh, node->right), node);
+        cost += GetNodeCost(node);
+        bvh->changedNodes[i] = 0;
+    }
+    bvh->taskCosts[taskIndex] = cost;
+}
+
+static void RefitLightBvh(JobSystem* jobSystem, LightBvhContext* context)
+{
+    LightBvh* bvh = context->bvh;
+    ParallelFor(jobSystem, static_cast<UINT>(bvh->tasks.size()), RefitTaskJob, context);
+    context->refitAll = false;
+
+    bvh->cost = 0.0f;
+    for (float taskCost : bvh->taskCosts)
+    {
+        bvh->cost += taskCost;
+    }
+
+    for (size_t i = bvh->topNodes.size(); i-- > 0;)
+    {
+        LightBvhNode* node = &bvh->nodes[bvh->topNodes[i]];
+        MergeNodes(GetNode(bvh, node->left), GetNode(bvh, node->right), node);
+        bvh->cost += GetNodeCost(node);
+    }
+    bvh->refitCount++;
+}
+
+static void BuildLightBvh(JobSystem* jobSystem, LightBvhContext* context)
+{
+    LightBvh* bvh = context->bvh;
+    const UINT lightCount = context->lightCount;
+    const UINT chunkCount = context->chunkCount;
+
+    // Caixa das posies, por chunk e depois somada.
+    ParallelFor(jobSystem, chunkCount, BoundsJob, context);
+
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+    for (UINT chunk = 0; chunk < chunkCount; chunk++)
+    {
+        boundsMin = XMVectorMin(boundsMin, XMLoadFloat4(&bvh->chunkBounds[chunk * 2]));
+        boundsMax = XMVectorMax(boundsMax, XMLoadFloat4(&bvh->chunkBounds[chunk * 2 + 1]));
+    }
+
+    const XMVECTOR extent = XMVectorMax(XMVectorSubtract(boundsMax, boundsMin), XMVectorReplicate(1e-6f));
+    XMStoreFloat3(&context->boundsMin, boundsMin);
+    XMStoreFloat3(&context->boundsScale, XMVectorDivide(XMVectorReplicate(1024.0f), extent));
+
+    ParallelFor(jobSystem, chunkCount, CodeJob, context);
+
+    // Radix sort estvel, com a posio de cada dgito em cada chunk vinda da soma de prefixos por dgito e, dentro
+    // do dgito, por chunk.
+    for (UINT pass = 0; pass < LightBvhRadixPasses; pass++)
+    {
+        context->sourceCodes = bvh->codes.data();
+        context->sourceOrder = bvh->order.data();
+        context->destinationCodes = bvh->sortCodes.data();
+        context->destinationOrder = bvh->sortOrder.data();
+        context->shift = pass * LightBvhRadixBits;
+
+        ParallelFor(jobSystem, chunkCount, RadixCountJob, context);
+
+        UINT offset = 0;
+        for (UINT digit = 0; digit < LightBvhRadixSize; digit++)
+        {
+            for (UINT chunk = 0; chunk < chunkCount; chunk++)
+            {
+                UINT* count = &bvh->histograms[chunk * LightBvhRadixSize + digit];
+                const UINT digitCount = *count;
+                *count = offset;
+                offset += digitCount;
+            }
+        }
+
+        ParallelFor(jobSystem, chunkCount, RadixScatterJob, context);
+
+        bvh->codes.swap(bvh->sortCodes);
+        bvh->order.swap(bvh->sortOrder);
+    }
+
+    // O topo, at as faixas caberem num job, sai aqui; o resto, nos jobs.
+    bvh->root = lightCount > 1 ? 0 : LightBvhLeafFlag;
+    if (lightCount > 1)
+        bvh->nodeParents[0] = LightBvhNullNode;
+    else
+        bvh->leafParents[0] = LightBvhNullNode;
+
+    bvh->tasks.clear();
+    bvh->topNodes.clear();
+
+    LightBvhTask stack[LightBvhMaxDepth + 1];
+    UINT stackSize = 0;
+    stack[stackSize++] = { bvh->root, 0, lightCount - 1 };
+
+    while (stackSize > 0)
+    {
+        const LightBvhTask task = stack[--stackSize];
+        if (task.lastLight - task.firstLight < bvh->settings.chunkSize)
+        {
+            bvh->tasks.push_back(task);
+            continue;
+        }
+
+        bvh->topNodes.push_back(task.node);
+        SplitNode(bvh, task.node, task.firstLight, task.lastLight, &stack[stackSize + 1], &stack[stackSize]);
+        stackSize += 2;
+    }
+
+    bvh->taskCosts.assign(bvh->tasks.size(), 0.0f);
+    ParallelFor(jobSystem, static_cast<UINT>(bvh->tasks.size()), BuildTaskJob, context);
+
+    context->refitAll = true;
+    RefitLightBvh(jobSystem, context);
+    bvh->buildCost = bvh->cost;
+    bvh->buildCount++;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitLightBvh(LightBvh* bvh, const LightBvhSettings* settings)
+{
+    bvh->settings = *settings;
+    bvh->settings.chunkSize = (std::max)(settings->chunkSize, 1u);
+    bvh->lightCount = 0;
+    bvh->root = LightBvhNullNode;
+    bvh->buildCost = 0.0f;
+    bvh->cost = 0.0f;
+    bvh->buildCount = 0;
+    bvh->refitCount = 0;
+}
+
+void UpdateLightBvh(JobSystem* jobSystem, LightBvh* bvh, const LocalLight* lights, UINT lightCount)
+{
+    // Os ndices das folhas usam 31 bits.
+    lightCount = (std::min)(lightCount, LightBvhLeafFlag - 1);
+
+    LightBvhContext context;
+    context.bvh = bvh;
+    context.lights = lights;
+    context.lightCount = lightCount;
+    context.chunkCount = (lightCount + bvh->settings.chunkSize - 1) / bvh->settings.chunkSize;
+    context.refitAll = false;
+
+    if (lightCount == 0)
+    {
+        bvh->lightCount = 0;
+        bvh->root = LightBvhNullNode;
+        bvh->cost = 0.0f;
+        return;
+    }
+
+    if (lightCount == bvh->lightCount)
+    {
+        RefitLightBvh(jobSystem, &context);
+        if (bvh->cost <= bvh->buildCost * bvh->settings.rebuildThreshold)
+            return;
+    }
+
+    // S cresce: com a mesma contagem de luzes nada  alocado.
+    bvh->lightCount = lightCount;
+    bvh->nodes.resize(lightCount - 1);
+    bvh->leaves.resize(lightCount);
+    bvh->previousLights.resize(lightCount);
+    bvh->nodeParents.resize(lightCount - 1);
+    bvh->leafParents.resize(lightCount);
+    bvh->changedNodes.resize(lightCount - 1, 0);
+    bvh->order.resize(lightCount);
+    bvh->codes.resize(lightCount);
+    bvh->sortCodes.resize(lightCount);
+    bvh->sortOrder.resize(lightCount);
+    bvh->histograms.resize(context.chunkCount * LightBvhRadixSize);
+    bvh->chunkBounds.resize(context.chunkCount * 2);
+
+    BuildLightBvh(jobSystem, &context);
+}
+
+void GatherLightBvh(const LightBvh* bvh, const LocalLight* lights, const XMFLOAT4* planes, UINT planeCount, std::vector<UINT>* lightIndices)
+{
+    lightIndices->clear();
+    if (bvh->root == LightBvhNullNode)
+        return;
+
+    UINT stack[LightBvhMaxDepth + 1];
+    UINT stackSize = 0;
+    stack[stackSize++] = bvh->root;
+
+    while (stackSize > 0)
+    {
+        const UINT nodeIndex = stack[--stackSize];
+
+        if (nodeIndex & LightBvhLeafFlag)
+        {
+            // Nas folhas, a esfera exata.
+            const UINT light = bvh->order[nodeIndex & ~LightBvhLeafFlag];
+            const XMVECTOR position = XMLoadFloat3(&lights[light].position);
+
+            bool inside = true;
+            for (UINT p = 0; p < planeCount && inside; p++)
+                inside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), position)) >= -lights[light].range;
+
+            if (inside)
+                lightIndices->push_back(light);
+            continue;
+        }
+
+        // A caixa fica de fora se o canto mais  frente de algum plano est atrs dele.
+        const LightBvhNode* node = &bvh->nodes[nodeIndex];
+        const XMVECTOR minimum = XMLoadFloat3(&node->boundsMin);
+        const XMVECTOR maximum = XMLoadFloat3(&node->boundsMax);
+
+        bool inside = true;
+        for (UINT p = 0; p < planeCount && inside; p++)
+        {
+            const XMVECTOR plane = XMLoadFloat4(&planes[p]);
+            const XMVECTOR corner = XMVectorSelect(minimum, maximum, XMVectorGreater(plane, XMVectorZero()));
+            inside = XMVectorGetX(XMPlaneDotCoord(plane, corner)) >= 0.0f;
+        }
+
+        if (inside)
+        {
+            stack[stackSize++] = node->right;
+            stack[stackSize++] = node->left;
+        }
+    }
+}
+
+UINT SampleLightBvh(const LightBvh* bvh, XMFLOAT3 position, float u, float* probability)
+{
+    *probability = 0.0f;
+    if (bvh->root == LightBvhNullNode)
+        return LightBvhNullNode;
+
+    const XMVECTOR point = XMLoadFloat3(&position);
+    if (GetImportance(GetNode(bvh, bvh->root), point) <= 0.0f)
+        return LightBvhNullNode;
+
+    float pathProbability = 1.0f;
+    UINT nodeIndex = bvh->root;
+
+    while (!(nodeIndex & LightBvhLeafFlag))
+    {
+        const LightBvhNode* node = &bvh->nodes[nodeIndex];
+        const float leftImportance = GetImportance(GetNode(bvh, node->left), point);
+        const float rightImportance = GetImportance(GetNode(bvh, node->right), point);
+        const float total = leftImportance + rightImportance;
+        if (total <= 0.0f)
+            return LightBvhNullNode;
+
+        // u  reaproveitado: a parte dele dentro do filho escolhido volta a cobrir [0, 1).
+        const float leftProbability = leftImportance / total;
+        if (u < leftProbability)
+        {
+            u /= leftProbability;
+            pathProbability *= leftProbability;
+            nodeIndex = node->left;
+        }
+        else
+        {
+            u = (u - leftProbability) / (1.0f - leftProbability);
+            pathProbability *= 1.0f - leftProbability;
+            nodeIndex = node->right;
+        }
+        u = (std::min)(u, 0.99999994f);
+    }
+
+    *probability = pathProbability;
+    return bvh->order[nodeIndex & ~LightBvhLeafFlag];
+}
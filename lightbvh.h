@@ -0,0 +1,97 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+#include <vector>
+
+// BVH sobre as luzes locais, para cenas com dezenas de milhares delas. As luzes so ordenadas pelo cdigo de
+// Morton das posies e cada n corta a sua faixa no primeiro bit em que os cdigos diferem; as luzes so as
+// folhas, uma por folha. Os ns ficam em pr-ordem, ento cada subrvore ocupa uma faixa contnua: o topo 
+// cortado em subrvores de at chunkSize luzes, e cada uma  montada e reajustada por um job, de trs para frente.
+//
+// Todo quadro os ns so reajustados de baixo para cima com as luzes do quadro, pulando as subrvores em que
+// nenhuma luz mudou. Cada n guarda a caixa das
+// esferas de alcance (fora dela nenhuma luz do n ilumina), a potncia somada, o centro das posies ponderado
+// pela potncia e um cone de orientao (Conty Estevez e Kulla 2018). Quando o reajuste deixa a rvore pior que
+// rebuildThreshold vezes a da ltima montagem, ela  montada de novo.
+
+const UINT LightBvhLeafFlag = 0x80000000;
+const UINT LightBvhNullNode = 0xffffffff;
+
+struct LightBvhSettings
+{
+    float rebuildThreshold;     // Custo (soma das reas das caixas) relativo ao da montagem que fora remontar.
+    UINT chunkSize;             // Luzes por job.
+};
+
+const LightBvhSettings DefaultLightBvhSettings = { 1.5f, 2048 };
+
+struct LightBvhNode
+{
+    XMFLOAT3 boundsMin;
+    UINT left;                  // Filhos: n interno, ou LightBvhLeafFlag | posio da luz em order.
+    XMFLOAT3 boundsMax;
+    UINT right;
+    XMFLOAT3 center;
+    float power;
+    XMFLOAT3 axis;
+    float spreadAngle;          // Abertura dos eixos das luzes em torno de axis; pi quando h luzes pontuais.
+    float emissionAngle;        // Maior meia abertura dos spots em torno dos prprios eixos.
+    float radius;               // Raio das posies em torno de center.
+};
+
+// Subrvore com as folhas de firstLight a lastLight; node  a raiz (uma folha, se as duas coincidem).
+struct LightBvhTask
+{
+    UINT node;
+    UINT firstLight;
+    UINT lastLight;
+};
+
+struct LightBvh
+{
+    LightBvhSettings settings;
+    UINT lightCount;
+    UINT root;
+
+    std::vector<LightBvhNode> nodes;        // lightCount - 1 ns internos, em pr-ordem.
+    std::vector<LightBvhNode> leaves;       // Uma folha por luz, na ordem de order.
+    std::vector<LocalLight> previousLights; // As luzes do ltimo reajuste, na ordem de order.
+    std::vector<UINT> nodeParents;
+    std::vector<UINT> leafParents;
+    std::vector<BYTE> changedNodes;         // Ns a refazer no reajuste em andamento.
+    std::vector<UINT> order;                // ndice da luz de cada folha.
+
+    std::vector<LightBvhTask> tasks;        // As subrvores dos jobs.
+    std::vector<UINT> topNodes;             // Os ns acima delas, em pr-ordem.
+
+    // Memria de trabalho, mantida entre quadros.
+    std::vector<UINT> codes;
+    std::vector<UINT> sortCodes;
+    std::vector<UINT> sortOrder;
+    std::vector<UINT> histograms;
+    std::vector<XMFLOAT4> chunkBounds;
+    std::vector<float> taskCosts;
+
+    float buildCost;
+    float cost;
+
+    // Estatsticas, acumuladas at o chamador zerar.
+    UINT buildCount;
+    UINT refitCount;
+};
+
+void InitLightBvh(LightBvh* bvh, const LightBvhSettings* settings);
+
+// Reajusta a rvore s luzes deste quadro, ou monta de novo se a contagem mudou ou a rvore degradou.
+void UpdateLightBvh(JobSystem* jobSystem, LightBvh* bvh, const LocalLight* lights, UINT lightCount);
+
+// ndices das luzes cuja esfera de alcance toca o volume convexo dos planos (normais para dentro, como os de
+// LodView). Serve para o frustum da cmera, para um cluster ou para uma caixa.
+void GatherLightBvh(const LightBvh* bvh, const LocalLight* lights, const XMFLOAT4* planes, UINT planeCount, std::vector<UINT>* lightIndices);
+
+// Sorteia uma luz com probabilidade proporcional  importncia estimada no ponto, descendo a rvore: em cada n
+// o filho  escolhido pela importncia dele. u est em [0, 1). Devolve LightBvhNullNode se nenhuma luz alcana
+// o ponto.
+UINT SampleLightBvh(const LightBvh* bvh, XMFLOAT3 position, float u, float* probability);
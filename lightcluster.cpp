@@ -0,0 +1,412 @@
+#include "lightcluster.h"
+
+#include <string.h>
+#include <algorithm>
+#include <math.h>
+
+const UINT LightClusterLightsPerJob = 256;
+
+// -----------------------------------------------------------------------------------------------------
+
+struct LightClusterContext
+{
+    LightClusterGrid* grid;
+
+    const LocalLight* lights;
+    const UINT* visibleLights;
+    UINT visibleCount;
+    XMMATRIX view;
+
+    // Inclinao das bordas do frustum (tan do meio fov, em x j com o aspecto), a normal dos planos laterais e as
+    // profundidades das fatias.
+    float tanX;
+    float tanY;
+    float normalX;
+    float normalY;
+    float nearPlane;
+    float farPlane;
+    const float* sliceDepths;
+};
+
+// Limites de view de uma linha ou coluna de tiles numa fatia, preenchidos at mltiplo de 4 com tiles que
+// nenhuma esfera toca.
+struct LightClusterBounds
+{
+    XMFLOAT4 minimum[MaxLightClusterTiles / 4];
+    XMFLOAT4 maximum[MaxLightClusterTiles / 4];
+};
+
+static void GetTileBounds(UINT tileCount, float tangent, float sign, float nearDepth, float farDepth, LightClusterBounds* bounds)
+{
+    float* minimum = &bounds->minimum[0].x;
+    float* maximum = &bounds->maximum[0].x;
+
+    for (UINT i = 0; i < MaxLightClusterTiles; i++)
+    {
+        if (i >= tileCount)
+        {
+            minimum[i] = 1e30f;
+            maximum[i] = -1e30f;
+            continue;
+        }
+
+        // Em y o tile 0  o de cima: sign = -1 inverte as bordas.
+        const float a = sign * (-1.0f + 2.0f * i / tileCount) * tangent;
+        const float b = sign * (-1.0f + 2.0f * (i + 1) / tileCount) * tangent;
+        const float low = (std::min)(a, b);
+        const float high = (std::max)(a, b);
+
+        minimum[i] = (std::min)(low * nearDepth, low * farDepth);
+        maximum[i] = (std::max)(high * nearDepth, high * farDepth);
+    }
+}
+
+// Luzes em espao de view, e a faixa de fatias que cada uma cruza. Quem fica fora de um dos lados do frustum no
+// toca pixel nenhum e no entra em fatia nenhuma.
+static void TransformLightsJob(void* context, UINT job)
+{
+    const LightClusterContext* ctx = static_cast<const LightClusterContext*>(context);
+    LightClusterGrid* grid = ctx->grid;
+    const UINT sliceCount = grid->settings.slices;
+    const float* sliceDepths = ctx->sliceDepths;
+
+    const UINT first = job * LightClusterLightsPerJob;
+    const UINT last = (std::min)(first + LightClusterLightsPerJob, ctx->visibleCount);
+    for (UINT i = first; i < last; i++)
+    {
+        const LocalLight* light = &ctx->lights[ctx->visibleLights[i]];
+        XMFLOAT3 position;
+        XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&light->position), ctx->view));
+
+        const float range = light->range;
+        const bool outside = (fabsf(position.x) - ctx->tanX * position.z) * ctx->normalX > range ||
+            (fabsf(position.y) - ctx->tanY * position.z) * ctx->normalY > range || position.z + range <= ctx->nearPlane || position.z - range >= ctx->farPlane;
+
+        // Fatia k entra se z + r > z_k e z - r < z_(k+1).
+        UINT firstSlice = 0;
+        UINT lastSlice = 0;
+        if (!outside)
+        {
+            firstSlice = static_cast<UINT>(std::upper_bound(sliceDepths, sliceDepths + sliceCount + 1, position.z - range) - sliceDepths);
+            firstSlice = firstSlice ? firstSlice - 1 : 0;
+            lastSlice = static_cast<UINT>(std::lower_bound(sliceDepths, sliceDepths + sliceCount, position.z + range) - sliceDepths);
+        }
+
+        grid->lightSlices[i] = XMUINT2(firstSlice, lastSlice);
+        if (firstSlice >= lastSlice)
+            continue;
+
+        XMFLOAT3 direction;
+        XMStoreFloat3(&direction, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light->direction), ctx->view)));
+
+        grid->viewX[i] = position.x;
+        grid->viewY[i] = position.y;
+        grid->viewZ[i] = position.z;
+        grid->radius[i] = range;
+        grid->directionX[i] = direction.x;
+        grid->directionY[i] = direction.y;
+        grid->directionZ[i] = direction.z;
+        grid->cosOuter[i] = light->spotCosOuter;
+        grid->sinOuter[i] = sqrtf((std::max)(1.0f - light->spotCosOuter * light->spotCosOuter, 0.0f));
+    }
+}
+
+// Quantos dos limites ficam abaixo (ou acima) de value. Os limites so montonos, ento a contagem  a ponta de
+// uma faixa, sem os desvios difceis de prever de uma busca binria.
+static UINT CountBelow(const float* bounds, UINT count, float value)
+{
+    UINT result = 0;
+    for (UINT i = 0; i < count; i++)
+    {
+        result += bounds[i] < value;
+    }
+
+    return result;
+}
+
+static UINT CountNotAbove(const float* bounds, UINT count, float value)
+{
+    UINT result = 0;
+    for (UINT i = 0; i < count; i++)
+    {
+        result += bounds[i] <= value;
+    }
+
+    return result;
+}
+
+static void AssignSliceJob(void* context, UINT slice)
+{
+    const LightClusterContext* ctx = static_cast<const LightClusterContext*>(context);
+    LightClusterGrid* grid = ctx->grid;
+    const LightClusterSettings* settings = &grid->settings;
+
+    const UINT tilesX = settings->tilesX;
+    const UINT tilesY = settings->tilesY;
+    const UINT maxLights = settings->maxLightsPerCluster;
+    const UINT firstCluster = slice * tilesX * tilesY;
+    UINT* counts = &grid->clusterCounts[firstCluster];
+    UINT* indices = &grid->clusterIndices[static_cast<size_t>(firstCluster) * maxLights];
+    memset(counts, 0, sizeof(UINT) * tilesX * tilesY);
+
+    const float nearDepth = ctx->sliceDepths[slice];
+    const float farDepth = ctx->sliceDepths[slice + 1];
+
+    LightClusterBounds boundsX;
+    LightClusterBounds boundsY;
+    GetTileBounds(tilesX, ctx->tanX, 1.0f, nearDepth, farDepth, &boundsX);
+    GetTileBounds(tilesY, ctx->tanY, -1.0f, nearDepth, farDepth, &boundsY);
+
+    const float* minimumX = &boundsX.minimum[0].x;
+    const float* maximumX = &boundsX.maximum[0].x;
+    const float* minimumY = &boundsY.minimum[0].x;
+    const float* maximumY = &boundsY.maximum[0].x;
+
+    // Meia diagonal da caixa de cada cluster, para o teste de cone contra a esfera do cluster.
+    const float centerZ = 0.5f * (nearDepth + farDepth);
+    const float halfZ = 0.5f * (farDepth - nearDepth);
+
+    const XMVECTOR zero = XMVectorZero();
+
+    for (UINT i = grid->sliceLightOffsets[slice]; i < grid->sliceLightOffsets[slice + 1]; i++)
+    {
+        const UINT light = grid->sliceLights[i];
+        const float lightX = grid->viewX[light];
+        const float lightY = grid->viewY[light];
+        const float lightZ = grid->viewZ[light];
+        const float range = grid->radius[light];
+        const bool spot = grid->cosOuter[light] > -1.0f;
+
+        // Faixa de tiles cujas caixas tocam a caixa da esfera. Os limites crescem com x e decrescem com y.
+        const UINT left = CountBelow(maximumX, tilesX, lightX - range);
+        const UINT right = CountNotAbove(minimumX, tilesX, lightX + range);
+        if (left >= right)
+            continue;
+
+        const UINT top = tilesY - CountNotAbove(minimumY, tilesY, lightY + range);
+        const UINT bottom = tilesY - CountBelow(maximumY, tilesY, lightY - range);
+        if (top >= bottom)
+            continue;
+
+        const float dz = (std::max)((std::max)(nearDepth - lightZ, lightZ - farDepth), 0.0f);
+        const XMVECTOR lightVectorX = XMVectorReplicate(lightX);
+        const XMVECTOR rangeSquared = XMVectorReplicate(range * range);
+
+        const XMVECTOR directionX = XMVectorReplicate(grid->directionX[light]);
+        const XMVECTOR cosAngle = XMVectorReplicate(grid->cosOuter[light]);
+        const XMVECTOR sinAngle = XMVectorReplicate(grid->sinOuter[light]);
+        const XMVECTOR rangeVector = XMVectorReplicate(range);
+
+        for (UINT y = top; y < bottom; y++)
+        {
+            // O que sobra do raio em x nesta linha d a faixa exata de tiles que a esfera toca.
+            const float dy = (std::max)((std::max)(minimumY[y] - lightY, lightY - maximumY[y]), 0.0f);
+            const float remaining = range * range - (dy * dy + dz * dz);
+            if (remaining < 0.0f)
+                continue;
+
+            const float reachX = sqrtf(remaining);
+            const UINT rowLeft = left + CountBelow(maximumX + left, right - left, lightX - reachX);
+            const UINT rowRight = left + CountNotAbove(minimumX + left, right - left, lightX + reachX);
+
+            UINT* rowCounts = &counts[y * tilesX];
+            UINT* rowIndices = &indices[static_cast<size_t>(y) * tilesX * maxLights];
+            if (!spot)
+            {
+                for (UINT x = rowLeft; x < rowRight; x++)
+                {
+                    if (rowCounts[x] < maxLights)
+                        rowIndices[static_cast<size_t>(x) * maxLights + rowCounts[x]] = light;
+                    rowCounts[x]++;
+                }
+
+                continue;
+            }
+
+            const XMVECTOR baseDistance = XMVectorReplicate(dy * dy + dz * dz);
+
+            const float centerY = 0.5f * (minimumY[y] + maximumY[y]);
+            const float halfY = 0.5f * (maximumY[y] - minimumY[y]);
+            const float offsetY = centerY - lightY;
+            const float offsetZ = centerZ - lightZ;
+            const XMVECTOR rowOffset = XMVectorReplicate(offsetY * grid->directionY[light] + offsetZ * grid->directionZ[light]);
+            const XMVECTOR rowLengthSquared = XMVectorReplicate(offsetY * offsetY + offsetZ * offsetZ);
+            const XMVECTOR rowHalfSquared = XMVectorReplicate(halfY * halfY + halfZ * halfZ);
+
+            for (UINT x = rowLeft & ~3u; x < rowRight; x += 4)
+            {
+                // Esfera contra a caixa: distncia do centro da luz ao ponto mais prximo da caixa.
+                const XMVECTOR minimum = XMLoadFloat4(&boundsX.minimum[x / 4]);
+                const XMVECTOR maximum = XMLoadFloat4(&boundsX.maximum[x / 4]);
+                const XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(minimum, lightVectorX), XMVectorSubtract(lightVectorX, maximum)), zero);
+                XMVECTOR inside = XMVectorLessOrEqual(XMVectorMultiplyAdd(dx, dx, baseDistance), rangeSquared);
+
+                // Cone contra a esfera do cluster: distncia da esfera  borda do cone, e a esfera no pode
+                // ficar atrs da luz nem alm do alcance no eixo.
+                const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+                const XMVECTOR half = XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f);
+                const XMVECTOR clusterRadius = XMVectorSqrt(XMVectorMultiplyAdd(half, half, rowHalfSquared));
+
+                const XMVECTOR offsetX = XMVectorSubtract(center, lightVectorX);
+                const XMVECTOR lengthSquared = XMVectorMultiplyAdd(offsetX, offsetX, rowLengthSquared);
+                const XMVECTOR axial = XMVectorMultiplyAdd(offsetX, directionX, rowOffset);
+                const XMVECTOR radial = XMVectorSqrt(XMVectorMax(XMVectorSubtract(lengthSquared, XMVectorMultiply(axial, axial)), zero));
+                const XMVECTOR coneDistance = XMVectorSubtract(XMVectorMultiply(cosAngle, radial), XMVectorMultiply(axial, sinAngle));
+
+                inside = XMVectorAndInt(inside, XMVectorLessOrEqual(coneDistance, clusterRadius));
+                inside = XMVectorAndInt(inside, XMVectorLessOrEqual(axial, XMVectorAdd(clusterRadius, rangeVector)));
+                inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(axial, XMVectorNegate(clusterRadius)));
+
+                XMUINT4 mask;
+                XMStoreUInt4(&mask, inside);
+                const UINT lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+
+                for (UINT k = 0; k < 4; k++)
+                {
+                    if (!lanes[k])
+                        continue;
+
+                    const UINT tile = x + k;
+                    if (rowCounts[tile] < maxLights)
+                        rowIndices[static_cast<size_t>(tile) * maxLights + rowCounts[tile]] = light;
+                    rowCounts[tile]++;
+                }
+            }
+        }
+    }
+}
+
+// Copia as listas da fatia para a posio final, j calculada em sliceOffsets.
+static void CompactSliceJob(void* context, UINT slice)
+{
+    LightClusterGrid* grid = static_cast<LightClusterContext*>(context)->grid;
+    const UINT clustersPerSlice = grid->settings.tilesX * grid->settings.tilesY;
+    const UINT maxLights = grid->settings.maxLightsPerCluster;
+
+    UINT offset = grid->sliceOffsets[slice];
+    for (UINT cluster = slice * clustersPerSlice; cluster < (slice + 1) * clustersPerSlice; cluster++)
+    {
+        const UINT count = (std::min)(grid->clusterCounts[cluster], maxLights);
+        grid->clusters[cluster] = XMUINT2(offset, count);
+
+        memcpy(&grid->lightIndices[offset], &grid->clusterIndices[static_cast<size_t>(cluster) * maxLights], sizeof(UINT) * count);
+        offset += count;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitLightClusterGrid(LightClusterGrid* grid, const LightClusterSettings* settings)
+{
+    grid->settings = *settings;
+    grid->settings.tilesX = (std::min)(settings->tilesX, MaxLightClusterTiles);
+    grid->settings.tilesY = (std::min)(settings->tilesY, MaxLightClusterTiles);
+    grid->settings.slices = (std::min)(settings->slices, MaxLightClusterSlices);
+
+    const UINT clusterCount = grid->settings.tilesX * grid->settings.tilesY * grid->settings.slices;
+    grid->clusters.assign(clusterCount, XMUINT2(0, 0));
+    grid->clusterCounts.assign(clusterCount, 0);
+    grid->clusterIndices.assign(static_cast<size_t>(clusterCount) * grid->settings.maxLightsPerCluster, 0);
+    grid->sliceOffsets.assign(grid->settings.slices + 1, 0);
+    grid->lightIndices.clear();
+
+    grid->sliceScale = 0.0f;
+    grid->sliceBias = 0.0f;
+    grid->overflowCount = 0;
+}
+
+void BuildLightClusters(JobSystem* jobSystem, LightClusterGrid* grid, FXMMATRIX view, float fov_deg, float aspectRatio, float nearPlane, float farPlane,
+    const LocalLight* lights, const UINT* visibleLights, UINT visibleCount)
+{
+    const LightClusterSettings* settings = &grid->settings;
+
+    // Fatias em progresso geomtrica: z_k = near * (far / near)^(k / slices).
+    const float logRatio = logf(farPlane / nearPlane);
+    grid->sliceScale = settings->slices / logRatio;
+    grid->sliceBias = -settings->slices * logf(nearPlane) / logRatio;
+
+    float sliceDepths[MaxLightClusterSlices + 1];
+    const UINT sliceCount = settings->slices;
+    for (UINT k = 0; k <= sliceCount; k++)
+    {
+        sliceDepths[k] = nearPlane * expf(logRatio * k / sliceCount);
+    }
+
+    const float tanY = tanf(0.5f * fov_deg * XM_PI / 180.0f);
+    const float tanX = tanY * aspectRatio;
+
+    LightClusterContext context;
+    context.grid = grid;
+    context.lights = lights;
+    context.visibleLights = visibleLights;
+    context.visibleCount = visibleCount;
+    context.view = view;
+    context.tanX = tanX;
+    context.tanY = tanY;
+    context.normalX = 1.0f / sqrtf(1.0f + tanX * tanX);
+    context.normalY = 1.0f / sqrtf(1.0f + tanY * tanY);
+    context.nearPlane = nearPlane;
+    context.farPlane = farPlane;
+    context.sliceDepths = sliceDepths;
+
+    grid->viewX.resize(visibleCount);
+    grid->viewY.resize(visibleCount);
+    grid->viewZ.resize(visibleCount);
+    grid->radius.resize(visibleCount);
+    grid->directionX.resize(visibleCount);
+    grid->directionY.resize(visibleCount);
+    grid->directionZ.resize(visibleCount);
+    grid->cosOuter.resize(visibleCount);
+    grid->sinOuter.resize(visibleCount);
+    grid->lightSlices.resize(visibleCount);
+
+    ParallelFor(jobSystem, (visibleCount + LightClusterLightsPerJob - 1) / LightClusterLightsPerJob, TransformLightsJob, &context);
+
+    // Luzes de cada fatia, na ordem de visibleLights.
+    grid->sliceLightOffsets.assign(sliceCount + 1, 0);
+    for (UINT i = 0; i < visibleCount; i++)
+    {
+        for (UINT k = grid->lightSlices[i].x; k < grid->lightSlices[i].y; k++)
+        {
+            grid->sliceLightOffsets[k + 1]++;
+        }
+    }
+
+    for (UINT k = 0; k < sliceCount; k++)
+    {
+        grid->sliceLightOffsets[k + 1] += grid->sliceLightOffsets[k];
+    }
+
+    grid->sliceLights.resize(grid->sliceLightOffsets[sliceCount]);
+    UINT sliceCursors[MaxLightClusterSlices];
+    memcpy(sliceCursors, grid->sliceLightOffsets.data(), sizeof(UINT) * sliceCount);
+
+    for (UINT i = 0; i < visibleCount; i++)
+    {
+        for (UINT k = grid->lightSlices[i].x; k < grid->lightSlices[i].y; k++)
+        {
+            grid->sliceLights[sliceCursors[k]++] = i;
+        }
+    }
+
+    ParallelFor(jobSystem, sliceCount, AssignSliceJob, &context);
+
+    // Posio de cada fatia na lista compacta; o que passou de maxLightsPerCluster fica de fora.
+    const UINT clustersPerSlice = settings->tilesX * settings->tilesY;
+    UINT total = 0;
+    grid->overflowCount = 0;
+    for (UINT k = 0; k < sliceCount; k++)
+    {
+        grid->sliceOffsets[k] = total;
+        for (UINT cluster = k * clustersPerSlice; cluster < (k + 1) * clustersPerSlice; cluster++)
+        {
+            const UINT count = grid->clusterCounts[cluster];
+            total += (std::min)(count, settings->maxLightsPerCluster);
+            grid->overflowCount += count - (std::min)(count, settings->maxLightsPerCluster);
+        }
+    }
+    grid->sliceOffsets[sliceCount] = total;
+
+    grid->lightIndices.resize(total);
+    ParallelFor(jobSystem, sliceCount, CompactSliceJob, &context);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+#include <vector>
+
+// Atribuio de luzes locais a clusters, na CPU. O frustum da cmera  dividido em tilesX x tilesY tiles na tela
+// e em slices fatias de profundidade, em progresso geomtrica do near ao far. Cada cluster recebe a lista das
+// luzes que o tocam, e o pixel shader s percorre a lista do seu cluster.
+//
+// As luzes vo para o espao de view uma vez, em SoA, e j separadas pelas fatias que cruzam. Cada fatia  um job:
+// acha a faixa de tiles de cada uma das suas luzes pelos limites dos clusters e testa 4 clusters de uma linha por
+// vez, esfera contra a caixa do cluster e, nos spots, cone contra a esfera do cluster. As listas saem compactas,
+// fatia aps fatia, por ndice de luz crescente.
+
+const UINT MaxLightClusterTiles = 64;       // Tiles por eixo.
+const UINT MaxLightClusterSlices = 64;
+
+struct LightClusterSettings
+{
+    UINT tilesX;
+    UINT tilesY;
+    UINT slices;
+    UINT maxLightsPerCluster;               // O que passar disso  descartado (e contado em overflowCount).
+};
+
+const LightClusterSettings DefaultLightClusterSettings = { 16, 9, 24, 256 };
+
+struct LightClusterGrid
+{
+    LightClusterSettings settings;
+
+    // Fatia de um pixel a uma profundidade de view z: floor(log(z) * sliceScale + sliceBias).
+    float sliceScale;
+    float sliceBias;
+
+    // Incio e tamanho da lista de cada cluster em lightIndices, com ndice (slice * tilesY + y) * tilesX + x. A
+    // linha 0 dos tiles  a de cima da tela.
+    std::vector<XMUINT2> clusters;
+    std::vector<UINT> lightIndices;
+
+    UINT overflowCount;
+
+    // Memria de trabalho, mantida entre quadros: as luzes em espao de view (SoA), as luzes de cada fatia e as
+    // listas de cada fatia antes da compactao.
+    std::vector<float> viewX;
+    std::vector<float> viewY;
+    std::vector<float> viewZ;
+    std::vector<float> radius;
+    std::vector<float> directionX;
+    std::vector<float> directionY;
+    std::vector<float> directionZ;
+    std::vector<float> cosOuter;
+    std::vector<float> sinOuter;
+    std::vector<XMUINT2> lightSlices;       // Primeira fatia e uma depois da ltima de cada luz.
+
+    std::vector<UINT> sliceLights;
+    std::vector<UINT> sliceLightOffsets;    // Incio das luzes de cada fatia em sliceLights, slices + 1 entradas.
+
+    std::vector<UINT> clusterIndices;       // maxLightsPerCluster entradas por cluster.
+    std::vector<UINT> clusterCounts;
+    std::vector<UINT> sliceOffsets;
+};
+
+void InitLightClusterGrid(LightClusterGrid* grid, const LightClusterSettings* settings);
+
+// view, fov, aspectRatio e os planos so os de GetViewMatrix e GetPerspectiveProjectionMatrix. S entram as luzes
+// de visibleLights (ndices em lights), e as listas dos clusters guardam posies em visibleLights.
+void BuildLightClusters(JobSystem* jobSystem, LightClusterGrid* grid, FXMMATRIX view, float fov_deg, float aspectRatio, float nearPlane, float farPlane,
+    const LocalLight* lights, const UINT* visibleLights, UINT visibleCount);
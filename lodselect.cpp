@@ -0,0 +1,197 @@
+#include "lodselect.h"
+
+#include <algorithm>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+void ComputeMeshBounds(Mesh* mesh, const Vertex* vertices, const UINT* indices)
+{
+    const MeshLod* lod = &mesh->lods[0];
+    vertices += mesh->baseVertex;
+    indices += lod->startIndex;
+
+    if (lod->indexCount == 0)
+    {
+        mesh->boundsCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        mesh->boundsRadius = 0.0f;
+        return;
+    }
+
+    XMVECTOR minimum = XMLoadFloat3(&vertices[indices[0]].position);
+    XMVECTOR maximum = minimum;
+    for (UINT i = 1; i < lod->indexCount; i++)
+    {
+        const XMVECTOR p = XMLoadFloat3(&vertices[indices[i]].position);
+        minimum = XMVectorMin(minimum, p);
+        maximum = XMVectorMax(maximum, p);
+    }
+
+    const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+
+    float radius = 0.0f;
+    for (UINT i = 0; i < lod->indexCount; i++)
+    {
+        const XMVECTOR p = XMLoadFloat3(&vertices[indices[i]].position);
+        radius = (std::max)(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center))));
+    }
+
+    XMStoreFloat3(&mesh->boundsCenter, center);
+    mesh->boundsRadius = radius;
+}
+
+void BuildLodView(LodView* lodView, XMFLOAT3 cameraPosition, FXMMATRIX viewProjection, float fov_deg, float viewportHeight, float nearPlane)
+{
+    lodView->cameraPosition = cameraPosition;
+    lodView->nearPlane = nearPlane;
+    lodView->projectionScale = viewportHeight / (2.0f * tanf(0.5f * fov_deg * XM_PI / 180.0f));
+
+    XMFLOAT4X4 m;
+    XMStoreFloat4x4(&m, viewProjection);
+
+    // Planos extrados das colunas da matriz (conveno de vetor-linha, z de 0 a 1).
+    const XMFLOAT4 column[4] =
+    {
+        { m._11, m._21, m._31, m._41 },
+        { m._12, m._22, m._32, m._42 },
+        { m._13, m._23, m._33, m._43 },
+        { m._14, m._24, m._34, m._44 }
+    };
+
+    lodView->frustumPlanes[0] = XMFLOAT4(column[3].x + column[0].x, column[3].y + column[0].y, column[3].z + column[0].z, column[3].w + column[0].w);
+    lodView->frustumPlanes[1] = XMFLOAT4(column[3].x - column[0].x, column[3].y - column[0].y, column[3].z - column[0].z, column[3].w - column[0].w);
+    lodView->frustumPlanes[2] = XMFLOAT4(column[3].x + column[1].x, column[3].y + column[1].y, column[3].z + column[1].z, column[3].w + column[1].w);
+    lodView->frustumPlanes[3] = XMFLOAT4(column[3].x - column[1].x, column[3].y - column[1].y, column[3].z - column[1].z, column[3].w - column[1].w);
+    lodView->frustumPlanes[4] = column[2];
+    lodView->frustumPlanes[5] = XMFLOAT4(column[3].x - column[2].x, column[3].y - column[2].y, column[3].z - column[2].z, column[3].w - column[2].w);
+
+    for (UINT i = 0; i < 6; i++)
+    {
+        XMStoreFloat4(&lodView->frustumPlanes[i], XMPlaneNormalize(XMLoadFloat4(&lodView->frustumPlanes[i])));
+    }
+}
+
+void GetModelSpaceView(const LodView* lodView, const XMFLOAT4X4* world, XMFLOAT3* cameraPosition, XMFLOAT4 frustumPlanes[6])
+{
+    const XMMATRIX worldMatrix = XMLoadFloat4x4(world);
+    const XMMATRIX worldTranspose = XMMatrixTranspose(worldMatrix);
+    const XMMATRIX inverseWorld = XMMatrixInverse(nullptr, worldMatrix);
+
+    XMStoreFloat3(cameraPosition, XMVector3TransformCoord(XMLoadFloat3(&lodView->cameraPosition), inverseWorld));
+
+    for (UINT p = 0; p < 6; p++)
+    {
+        XMStoreFloat4(&frustumPlanes[p], XMPlaneNormalize(XMVector4Transform(XMLoadFloat4(&lodView->frustumPlanes[p]), worldTranspose)));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static UINT ChooseLod(const Mesh* mesh, UINT currentLod, float allowedError, float hysteresis)
+{
+    UINT target = 0;
+    while (target + 1 < mesh->lodCount && mesh->lods[target + 1].error <= allowedError)
+        target++;
+
+    if (currentLod >= mesh->lodCount)
+        return target;
+
+    if (target > currentLod)
+    {
+        // S engrossa se o nvel mais grosso couber com folga.
+        const float coarserLimit = allowedError * (1.0f - hysteresis);
+        target = currentLod;
+        while (target + 1 < mesh->lodCount && mesh->lods[target + 1].error <= coarserLimit)
+            target++;
+    }
+    else if (target < currentLod)
+    {
+        // S refina quando o nvel atual passa do limite com folga.
+        if (mesh->lods[currentLod].error <= allowedError * (1.0f + hysteresis))
+            target = currentLod;
+    }
+
+    return target;
+}
+
+void SelectLods(const LodSelectionSettings* settings, const LodView* lodView, const Mesh* meshes, Model* models, UINT modelCount, std::vector<DrawCommand>* drawList)
+{
+    drawList->clear();
+
+    // Esferas em espao de mundo em formato SoA, com preenchimento at mltiplo de 4.
+    const UINT paddedCount = (modelCount + 3) & ~3u;
+    std::vector<float> centerX(paddedCount, 0.0f), centerY(paddedCount, 0.0f), centerZ(paddedCount, 0.0f), radius(paddedCount, -1.0f);
+    std::vector<float> scale(paddedCount, 1.0f), allowedError(paddedCount);
+    std::vector<UINT> visible(paddedCount);
+
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        const Mesh* mesh = &meshes[models[i].meshIndex];
+        const XMMATRIX world = XMLoadFloat4x4(&models[i].world);
+
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&mesh->boundsCenter), world));
+
+        scale[i] = (std::max)((std::max)(
+            XMVectorGetX(XMVector3Length(world.r[0])),
+            XMVectorGetX(XMVector3Length(world.r[1]))),
+            XMVectorGetX(XMVector3Length(world.r[2])));
+
+        centerX[i] = center.x;
+        centerY[i] = center.y;
+        centerZ[i] = center.z;
+        radius[i] = mesh->pending ? -1.0f : mesh->boundsRadius * scale[i];
+    }
+
+    const float threshold = settings->errorThresholdPixels * powf(2.0f, settings->lodBias);
+    const XMVECTOR errorPerDistance = XMVectorReplicate(threshold / lodView->projectionScale);
+    const XMVECTOR nearPlane = XMVectorReplicate(lodView->nearPlane);
+    const XMVECTOR cameraX = XMVectorReplicate(lodView->cameraPosition.x);
+    const XMVECTOR cameraY = XMVectorReplicate(lodView->cameraPosition.y);
+    const XMVECTOR cameraZ = XMVectorReplicate(lodView->cameraPosition.z);
+
+    for (UINT i = 0; i < paddedCount; i += 4)
+    {
+        const XMVECTOR x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerX[i]));
+        const XMVECTOR y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerY[i]));
+        const XMVECTOR z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerZ[i]));
+        const XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&radius[i]));
+        const XMVECTOR negativeRadius = XMVectorNegate(r);
+
+        XMVECTOR inside = XMVectorGreaterOrEqual(r, XMVectorZero());
+        for (UINT p = 0; p < 6; p++)
+        {
+            const XMFLOAT4& plane = lodView->frustumPlanes[p];
+            XMVECTOR distance = XMVectorMultiplyAdd(XMVectorReplicate(plane.x), x, XMVectorReplicate(plane.w));
+            distance = XMVectorMultiplyAdd(XMVectorReplicate(plane.y), y, distance);
+            distance = XMVectorMultiplyAdd(XMVectorReplicate(plane.z), z, distance);
+            inside = XMVectorAndInt(inside, XMVectorGreater(distance, negativeRadius));
+        }
+
+        const XMVECTOR dx = XMVectorSubtract(x, cameraX);
+        const XMVECTOR dy = XMVectorSubtract(y, cameraY);
+        const XMVECTOR dz = XMVectorSubtract(z, cameraZ);
+        const XMVECTOR distance = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+
+        // Erro geomtrico que projeta em at threshold pixels no ponto mais prximo da esfera, levado para o
+        // espao do modelo, em que esto os erros dos LODs.
+        const XMVECTOR closest = XMVectorMax(XMVectorSubtract(distance, r), nearPlane);
+        const XMVECTOR s = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&scale[i]));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&allowedError[i]), XMVectorDivide(XMVectorMultiply(closest, errorPerDistance), s));
+        XMStoreUInt4(reinterpret_cast<XMUINT4*>(&visible[i]), inside);
+    }
+
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        if (!visible[i])
+            continue;
+
+        Model* model = &models[i];
+        const Mesh* mesh = &meshes[model->meshIndex];
+
+        model->currentLod = ChooseLod(mesh, model->currentLod, allowedError[i], settings->hysteresis);
+
+        const MeshLod* lod = &mesh->lods[model->currentLod];
+        drawList->push_back({ i, lod->indexCount, lod->startIndex, mesh->baseVertex });
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+struct LodSelectionSettings
+{
+    float errorThresholdPixels;     // Erro projetado mximo aceito, em pixels.
+    float hysteresis;               // Margem relativa para trocar de LOD (evita alternncia na fronteira).
+    float lodBias;                  // Vis global: cada unidade dobra o erro aceito (positivo = LODs mais grossos).
+};
+
+const LodSelectionSettings DefaultLodSelectionSettings = { 1.0f, 0.25f, 0.0f };
+
+struct LodView
+{
+    XMFLOAT3 cameraPosition;
+    float nearPlane;
+
+    // Pixels por unidade de mundo a uma distncia de 1: altura do viewport / (2 * tan(fov / 2)).
+    float projectionScale;
+
+    XMFLOAT4 frustumPlanes[6];
+};
+
+struct DrawCommand
+{
+    UINT modelIndex;
+    UINT indexCount;
+    UINT startIndex;
+    UINT baseVertex;
+};
+
+void ComputeMeshBounds(Mesh* mesh, const Vertex* vertices, const UINT* indices);
+
+void BuildLodView(LodView* lodView, XMFLOAT3 cameraPosition, FXMMATRIX viewProjection, float fov_deg, float viewportHeight, float nearPlane);
+
+// Leva a cmera e os planos do frustum para o espao do modelo (assume escala uniforme).
+void GetModelSpaceView(const LodView* lodView, const XMFLOAT4X4* world, XMFLOAT3* cameraPosition, XMFLOAT4 frustumPlanes[6]);
+
+// Calcula em SIMD (4 modelos por vez) a visibilidade e o erro projetado de cada modelo, escolhe o LOD com
+// histerese e preenche drawList com a faixa de ndices escolhida. Modelos fora do frustum, ou de malhas que o
+// streaming ainda no carregou, no so emitidos.
+void SelectLods(const LodSelectionSettings* settings, const LodView* lodView, const Mesh* meshes, Model* models, UINT modelCount, std::vector<DrawCommand>* drawList);
@@ -0,0 +1,207 @@
+#include "lz4.h"
+
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT Lz4MinMatch = 4;
+const UINT Lz4MaxOffset = 65535;
+
+// O formato exige que os ltimos 5 bytes sejam literais e que o ltimo match comece 12 bytes antes do fim.
+const UINT Lz4LastLiterals = 5;
+const UINT Lz4MatchFindLimit = 12;
+
+const UINT Lz4HashBits = 14;
+
+static inline UINT Read32(const BYTE* p)
+{
+    UINT value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline UINT HashLz4(UINT sequence)
+{
+    return (sequence * 2654435761u) >> (32 - Lz4HashBits);
+}
+
+static inline BYTE* WriteLz4Length(BYTE* p, UINT length)
+{
+    for (; length >= 255; length -= 255)
+        *p++ = 255;
+
+    *p++ = static_cast<BYTE>(length);
+    return p;
+}
+
+static BYTE* WriteLz4Sequence(BYTE* p, BYTE* end, const BYTE* literals, UINT literalLength, UINT offset, UINT matchLength)
+{
+    const UINT maxSize = 1 + (literalLength / 255 + 1) + literalLength + 2 + (matchLength / 255 + 1);
+    if (static_cast<UINT>(end - p) < maxSize)
+        return nullptr;
+
+    BYTE* token = p++;
+    *token = static_cast<BYTE>(((literalLength < 15) ? literalLength : 15) << 4);
+    if (literalLength >= 15)
+        p = WriteLz4Length(p, literalLength - 15);
+
+    memcpy(p, literals, literalLength);
+    p += literalLength;
+
+    // Sequncia final: s literais.
+    if (matchLength == 0)
+        return p;
+
+    *p++ = static_cast<BYTE>(offset);
+    *p++ = static_cast<BYTE>(offset >> 8);
+
+    matchLength -= Lz4MinMatch;
+    *token |= static_cast<BYTE>((matchLength < 15) ? matchLength : 15);
+    if (matchLength >= 15)
+        p = WriteLz4Length(p, matchLength - 15);
+
+    return p;
+}
+
+UINT CompressLz4(BYTE* destination, UINT capacity, const BYTE* source, UINT size)
+{
+    BYTE* p = destination;
+    BYTE* end = destination + capacity;
+    UINT anchor = 0;
+
+    if (size > Lz4MatchFindLimit)
+    {
+        // Guarda a ltima posio de cada hash de 4 bytes; colises so descartadas na comparao.
+        UINT hashTable[1 << Lz4HashBits];
+        memset(hashTable, 0, sizeof(hashTable));
+
+        const UINT matchFindLimit = size - Lz4MatchFindLimit;
+        const UINT matchEndLimit = size - Lz4LastLiterals;
+
+        UINT position = 1;
+        while (position < matchFindLimit)
+        {
+            const UINT sequence = Read32(source + position);
+            const UINT hash = HashLz4(sequence);
+            UINT candidate = hashTable[hash];
+            hashTable[hash] = position;
+
+            if (candidate >= position || position - candidate > Lz4MaxOffset || Read32(source + candidate) != sequence)
+            {
+                // Acelerao: quanto mais longe do ltimo match, maior o passo.
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+
+            while (position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1])
+            {
+                position--;
+                candidate--;
+            }
+
+            UINT matchLength = Lz4MinMatch;
+            while (position + matchLength + 4 <= matchEndLimit && Read32(source + position + matchLength) == Read32(source + candidate + matchLength))
+                matchLength += 4;
+
+            while (position + matchLength < matchEndLimit && source[position + matchLength] == source[candidate + matchLength])
+                matchLength++;
+
+            p = WriteLz4Sequence(p, end, source + anchor, position - anchor, position - candidate, matchLength);
+            if (!p)
+                return 0;
+
+            position += matchLength;
+            anchor = position;
+
+            if (position < matchFindLimit)
+                hashTable[HashLz4(Read32(source + position - 2))] = position - 2;
+        }
+    }
+
+    p = WriteLz4Sequence(p, end, source + anchor, size - anchor, 0, 0);
+    return p ? static_cast<UINT>(p - destination) : 0;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static inline bool ReadLz4Length(const BYTE** p, const BYTE* end, UINT* length)
+{
+    BYTE value;
+    do
+    {
+        if (*p == end)
+            return false;
+
+        value = *(*p)++;
+        *length += value;
+    } while (value == 255);
+
+    return true;
+}
+
+bool DecompressLz4(BYTE* destination, UINT size, const BYTE* source, UINT sourceSize)
+{
+    const BYTE* p = source;
+    const BYTE* end = source + sourceSize;
+    BYTE* out = destination;
+    BYTE* outEnd = destination + size;
+
+    for (;;)
+    {
+        if (p == end)
+            return false;
+
+        const UINT token = *p++;
+
+        UINT literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLz4Length(&p, end, &literalLength))
+            return false;
+
+        if (literalLength > static_cast<UINT>(end - p) || literalLength > static_cast<UINT>(outEnd - out))
+            return false;
+
+        // Cpia em blocos de 16 bytes quando h folga nos dois buffers para passar do fim da sequncia.
+        if (literalLength <= 16 && end - p >= 16 && outEnd - out >= 16)
+            memcpy(out, p, 16);
+        else
+            memcpy(out, p, literalLength);
+
+        out += literalLength;
+        p += literalLength;
+
+        if (p == end)
+            return out == outEnd;
+
+        if (end - p < 2)
+            return false;
+
+        const UINT offset = p[0] | (p[1] << 8);
+        p += 2;
+
+        if (offset == 0 || offset > static_cast<UINT>(out - destination))
+            return false;
+
+        UINT matchLength = token & 15;
+        if (matchLength == 15 && !ReadLz4Length(&p, end, &matchLength))
+            return false;
+
+        matchLength += Lz4MinMatch;
+        if (matchLength > static_cast<UINT>(outEnd - out))
+            return false;
+
+        // Com distncia de pelo menos 8 bytes cada cpia de 8 bytes l s o que j foi escrito.
+        const BYTE* match = out - offset;
+        if (offset >= 8 && static_cast<UINT>(outEnd - out) >= matchLength + 8)
+        {
+            BYTE* matchEnd = out + matchLength;
+            for (; out < matchEnd; out += 8, match += 8)
+                memcpy(out, match, 8);
+
+            out = matchEnd;
+            continue;
+        }
+
+        for (; matchLength > 0; matchLength--)
+            *out++ = *match++;
+    }
+}
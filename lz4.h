@@ -0,0 +1,18 @@
+#pragma once
+
+#include "infinity.h"
+
+// Compresso no formato de bloco LZ4 (sem o cabealho de frame). A descompresso s copia literais e
+// repeties, bem mais rpido que ler do disco os bytes que a compresso economiza.
+
+// Tamanho mximo da sada de CompressLz4 para uma entrada de size bytes.
+inline UINT GetLz4CompressBound(UINT size)
+{
+    return size + size / 255 + 16;
+}
+
+// Devolve o tamanho comprimido, ou 0 se no couber em capacity.
+UINT CompressLz4(BYTE* destination, UINT capacity, const BYTE* source, UINT size);
+
+// Descomprime exatamente size bytes. Devolve false se o bloco estiver corrompido.
+bool DecompressLz4(BYTE* destination, UINT size, const BYTE* source, UINT sourceSize);
@@ -0,0 +1,102 @@
+#include "mappedfile.h"
+
+// -----------------------------------------------------------------------------------------------------
+
+HRESULT OpenMappedFile(const wchar_t* path, MappedFile* mappedFile)
+{
+    mappedFile->file = INVALID_HANDLE_VALUE;
+    mappedFile->mapping = nullptr;
+    mappedFile->data = nullptr;
+    mappedFile->size = 0;
+
+    // Leitura sequencial: o cache do sistema faz read-ahead agressivo enquanto os jobs consomem o arquivo.
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        CloseHandle(file);
+        return hr;
+    }
+
+    mappedFile->file = file;
+
+    // No  possvel mapear um arquivo vazio.
+    if (size.QuadPart == 0)
+        return S_OK;
+
+    HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        CloseMappedFile(mappedFile);
+        return hr;
+    }
+
+    mappedFile->mapping = mapping;
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        CloseMappedFile(mappedFile);
+        return hr;
+    }
+
+    mappedFile->data = reinterpret_cast<const BYTE*>(data);
+    mappedFile->size = static_cast<UINT64>(size.QuadPart);
+
+    return S_OK;
+}
+
+void CloseMappedFile(MappedFile* mappedFile)
+{
+    if (mappedFile->data)
+        UnmapViewOfFile(mappedFile->data);
+
+    if (mappedFile->mapping)
+        CloseHandle(mappedFile->mapping);
+
+    if (mappedFile->file != INVALID_HANDLE_VALUE)
+        CloseHandle(mappedFile->file);
+
+    mappedFile->file = INVALID_HANDLE_VALUE;
+    mappedFile->mapping = nullptr;
+    mappedFile->data = nullptr;
+    mappedFile->size = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+bool WriteFileSection(HANDLE file, UINT64* position, UINT64 offset, const void* data, UINT64 size)
+{
+    static const BYTE padding[4096] = {};
+
+    DWORD written = 0;
+    while (*position < offset)
+    {
+        const DWORD chunk = static_cast<DWORD>((offset - *position < sizeof(padding)) ? offset - *position : sizeof(padding));
+        if (!WriteFile(file, padding, chunk, &written, nullptr) || written != chunk)
+            return false;
+
+        *position += chunk;
+    }
+
+    // WriteFile escreve no mximo 4 GB por chamada.
+    const BYTE* bytes = reinterpret_cast<const BYTE*>(data);
+    while (size > 0)
+    {
+        const DWORD chunk = static_cast<DWORD>((size < 0x40000000ull) ? size : 0x40000000ull);
+        if (!WriteFile(file, bytes, chunk, &written, nullptr) || written != chunk)
+            return false;
+
+        bytes += chunk;
+        size -= chunk;
+        *position += chunk;
+    }
+
+    return true;
+}
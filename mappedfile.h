@@ -0,0 +1,19 @@
+#pragma once
+
+#include "infinity.h"
+
+// Arquivo inteiro mapeado em memria, somente leitura. As pginas so carregadas sob demanda pelo sistema.
+struct MappedFile
+{
+    HANDLE file;
+    HANDLE mapping;
+    const BYTE* data;
+    UINT64 size;
+};
+
+HRESULT OpenMappedFile(const wchar_t* path, MappedFile* mappedFile);
+void CloseMappedFile(MappedFile* mappedFile);
+
+// Escreve data em offset, preenchendo com zeros desde position (a posio atual do arquivo, atualizada no fim).
+// Usado pelo Cooker para gravar sees alinhadas em sequncia.
+bool WriteFileSection(HANDLE file, UINT64* position, UINT64 offset, const void* data, UINT64 size);
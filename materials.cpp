@@ -0,0 +1,126 @@
+#include "materials.h"
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------
+
+static UINT PackUnorm(float value, UINT bits)
+{
+    const float scale = static_cast<float>((1u << bits) - 1);
+    const float clamped = (std::min)((std::max)(value, 0.0f), 1.0f);
+    return static_cast<UINT>(clamped * scale + 0.5f);
+}
+
+static UINT PackTextureIndex(UINT index)
+{
+    return (index < MaterialNoTexture) ? index : MaterialNoTexture;
+}
+
+static void RecordMaterialChange(MaterialTable* table, UINT slot)
+{
+    table->version++;
+    table->changes.push_back({ table->version, slot });
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void PackMaterial(const MaterialDesc* desc, GpuMaterial* material)
+{
+    material->baseColor = PackUnorm(desc->baseColor.x, 8) | (PackUnorm(desc->baseColor.y, 8) << 8) |
+        (PackUnorm(desc->baseColor.z, 8) << 16) | (PackUnorm(desc->baseColor.w, 8) << 24);
+    material->emissive = PackUnorm(desc->emissive.x, 8) | (PackUnorm(desc->emissive.y, 8) << 8) |
+        (PackUnorm(desc->emissive.z, 8) << 16) | (PackUnorm(desc->alphaCutoff, 8) << 24);
+    material->emissiveStrength = desc->emissiveStrength;
+    material->metallicRoughness = PackUnorm(desc->metallic, 16) | (PackUnorm(desc->roughness, 16) << 16);
+    material->flags = desc->flags;
+
+    for (UINT i = 0; i < MaterialTextureCount / 2; i++)
+    {
+        material->textures[i] = PackTextureIndex(desc->textures[i * 2]) | (PackTextureIndex(desc->textures[i * 2 + 1]) << 16);
+    }
+
+    material->reserved = 0;
+}
+
+void InitMaterialTable(MaterialTable* table, UINT capacity)
+{
+    table->capacity = capacity;
+    table->materials.clear();
+    table->materials.reserve(capacity);
+    table->freeSlots.clear();
+    table->materialCount = 0;
+
+    table->version = 0;
+    table->changes.clear();
+}
+
+UINT CreateMaterial(MaterialTable* table, const MaterialDesc* desc)
+{
+    UINT index;
+    if (!table->freeSlots.empty())
+    {
+        index = table->freeSlots.back();
+        table->freeSlots.pop_back();
+    }
+    else if (table->materials.size() < table->capacity)
+    {
+        index = static_cast<UINT>(table->materials.size());
+        table->materials.push_back({});
+    }
+    else
+    {
+        return MaterialNull;
+    }
+
+    table->materialCount++;
+    UpdateMaterial(table, index, desc);
+
+    return index;
+}
+
+void UpdateMaterial(MaterialTable* table, UINT index, const MaterialDesc* desc)
+{
+    PackMaterial(desc, &table->materials[index]);
+    RecordMaterialChange(table, index);
+}
+
+void DestroyMaterial(MaterialTable* table, UINT index)
+{
+    table->freeSlots.push_back(index);
+    table->materialCount--;
+}
+
+UINT64 CollectMaterialChanges(const MaterialTable* table, UINT64 sinceVersion, std::vector<MaterialRange>* ranges)
+{
+    ranges->clear();
+
+    const auto first = std::upper_bound(table->changes.begin(), table->changes.end(), sinceVersion,
+        [](UINT64 version, const MaterialChange& change) { return version < change.version; });
+
+    std::vector<UINT> slots;
+    for (auto change = first; change != table->changes.end(); ++change)
+    {
+        slots.push_back(change->slot);
+    }
+
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+    for (UINT slot : slots)
+    {
+        if (!ranges->empty() && ranges->back().first + ranges->back().count == slot)
+            ranges->back().count++;
+        else
+            ranges->push_back({ slot, 1 });
+    }
+
+    return table->version;
+}
+
+void TrimMaterialChanges(MaterialTable* table, UINT64 oldestVersion)
+{
+    const auto last = std::upper_bound(table->changes.begin(), table->changes.end(), oldestVersion,
+        [](UINT64 version, const MaterialChange& change) { return version < change.version; });
+
+    table->changes.erase(table->changes.begin(), last);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <limits.h>
+#include <vector>
+
+// Tabela de materiais para desenho bindless. Cada material  uma struct compacta de 32 bytes num structured
+// buffer; o draw passa s o ndice do material numa constante de root. As texturas so ndices no heap de
+// descritores (a regio persistente), lidas de uma tabela de SRVs nica, ento trocar de material no troca
+// nenhuma tabela de descritores.
+//
+// A tabela guarda a imagem do buffer na CPU e um registro de alteraes por verso: cada cpia do buffer na
+// GPU (uma por quadro em voo) reescreve s as faixas alteradas desde a verso que ela j tem.
+
+const UINT MaxMaterialCount = 4096;
+
+const UINT MaterialNull = UINT_MAX;
+
+// No GpuMaterial os ndices de textura tm 16 bits; este valor indica que o material no tem a textura.
+const UINT MaterialNoTexture = 0xFFFF;
+
+enum MaterialTexture
+{
+    MaterialBaseColorTexture,
+    MaterialNormalTexture,
+    MaterialMetallicRoughnessTexture,
+    MaterialEmissiveTexture,
+    MaterialTextureCount
+};
+
+enum MaterialFlags
+{
+    MaterialAlphaTest = 1 << 0,
+    MaterialDoubleSided = 1 << 1
+};
+
+struct MaterialDesc
+{
+    XMFLOAT4 baseColor;
+    XMFLOAT3 emissive;
+    float emissiveStrength;
+    float metallic;
+    float roughness;
+    float alphaCutoff;
+    UINT flags;
+
+    // ndices de descritor das texturas, ou MaterialNoTexture.
+    UINT textures[MaterialTextureCount];
+};
+
+const MaterialDesc DefaultMaterialDesc =
+{
+    { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f, 0.0f, 1.0f, 0.5f, 0,
+    { MaterialNoTexture, MaterialNoTexture, MaterialNoTexture, MaterialNoTexture }
+};
+
+// Mesmo layout da struct Material em shaders.hlsl.
+struct GpuMaterial
+{
+    UINT baseColor;             // RGBA8 UNORM.
+    UINT emissive;              // RGB8 UNORM, alpha cutoff no byte alto.
+    float emissiveStrength;
+    UINT metallicRoughness;     // Metallic nos 16 bits baixos e roughness nos altos, UNORM16.
+    UINT flags;
+    UINT textures[2];           // Dois ndices de 16 bits por palavra, na ordem de MaterialTexture.
+    UINT reserved;
+};
+
+struct MaterialChange
+{
+    UINT64 version;
+    UINT slot;
+};
+
+struct MaterialRange
+{
+    UINT first;
+    UINT count;
+};
+
+struct MaterialTable
+{
+    UINT capacity;
+    std::vector<GpuMaterial> materials;
+    std::vector<UINT> freeSlots;
+    UINT materialCount;
+
+    // Alteraes em ordem de verso. As mais antigas que todas as cpias j tm so descartadas.
+    UINT64 version;
+    std::vector<MaterialChange> changes;
+};
+
+void PackMaterial(const MaterialDesc* desc, GpuMaterial* material);
+
+void InitMaterialTable(MaterialTable* table, UINT capacity);
+
+// Devolve MaterialNull se a tabela estiver cheia. Um slot destrudo pode ser reaproveitado logo: os quadros em
+// voo leem as prprias cpias do buffer.
+UINT CreateMaterial(MaterialTable* table, const MaterialDesc* desc);
+void UpdateMaterial(MaterialTable* table, UINT index, const MaterialDesc* desc);
+void DestroyMaterial(MaterialTable* table, UINT index);
+
+// Preenche ranges com as faixas de slots alterados depois de sinceVersion e devolve a verso atual.
+UINT64 CollectMaterialChanges(const MaterialTable* table, UINT64 sinceVersion, std::vector<MaterialRange>* ranges);
+
+// Descarta as alteraes que todas as cpias j tm (verso at oldestVersion).
+void TrimMaterialChanges(MaterialTable* table, UINT64 oldestVersion);
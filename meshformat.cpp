@@ -0,0 +1,193 @@
+#include "meshformat.h"
+#include "mappedfile.h"
+
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+static UINT64 AlignOffset(UINT64 offset)
+{
+    return (offset + BakedMeshAlignment - 1) & ~static_cast<UINT64>(BakedMeshAlignment - 1);
+}
+
+static bool IsSectionValid(const BakedMeshHeader* header, UINT64 offset, UINT64 count, UINT64 elementSize)
+{
+    return offset % BakedMeshAlignment == 0 && offset <= header->fileSize && count * elementSize <= header->fileSize - offset;
+}
+
+HRESULT ReadBakedMeshTables(LPREADFUNC read, void* context, UINT64 fileSize, BakedMeshHeader* header, std::vector<BakedMesh>* meshes, std::vector<BakedModel>* models)
+{
+    // S a estrutura  validada; o contedo das sees vem do Cooker e  copiado como est.
+    if (fileSize < sizeof(*header) || !read(context, 0, sizeof(*header), header))
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    const bool valid =
+        header->magic == BakedMeshMagic &&
+        header->version == BakedMeshVersion &&
+        header->fileSize == fileSize &&
+        IsSectionValid(header, header->vertexOffset, header->vertexCount, sizeof(Vertex)) &&
+        IsSectionValid(header, header->indexOffset, header->indexCount, sizeof(UINT)) &&
+        IsSectionValid(header, header->meshOffset, header->meshCount, sizeof(BakedMesh)) &&
+        IsSectionValid(header, header->modelOffset, header->modelCount, sizeof(BakedModel));
+
+    if (!valid)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    meshes->resize(header->meshCount);
+    models->resize(header->modelCount);
+    if (!read(context, header->meshOffset, meshes->size() * sizeof(BakedMesh), meshes->data()) ||
+        !read(context, header->modelOffset, models->size() * sizeof(BakedModel), models->data()))
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    for (const BakedMesh& baked : *meshes)
+    {
+        bool meshValid = baked.lodCount >= 1 && baked.lodCount <= MaxLodCount &&
+            baked.baseVertex <= header->vertexCount && baked.vertexCount <= header->vertexCount - baked.baseVertex;
+
+        for (UINT lod = 0; meshValid && lod < baked.lodCount; lod++)
+        {
+            meshValid = baked.lods[lod].startIndex <= header->indexCount && baked.lods[lod].indexCount <= header->indexCount - baked.lods[lod].startIndex;
+        }
+
+        if (!meshValid)
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    return S_OK;
+}
+
+HRESULT ReadBakedMesh(LPREADFUNC read, void* context, UINT64 fileSize, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes, std::vector<Model>* models)
+{
+    BakedMeshHeader header;
+    std::vector<BakedMesh> bakedMeshes;
+    std::vector<BakedModel> bakedModels;
+
+    HRESULT hr = ReadBakedMeshTables(read, context, fileSize, &header, &bakedMeshes, &bakedModels);
+    if (FAILED(hr))
+        return hr;
+
+    if (vertices->size() + header.vertexCount > MaxVertexCount)
+        return E_OUTOFMEMORY;
+
+    const UINT vertexBase = static_cast<UINT>(vertices->size());
+    const UINT indexBase = static_cast<UINT>(indices->size());
+    const UINT meshBase = static_cast<UINT>(meshes->size());
+
+    // Vrtices e ndices j esto no layout da engine: so lidos direto para os vetores da cena.
+    vertices->resize(vertexBase + static_cast<size_t>(header.vertexCount));
+    indices->resize(indexBase + static_cast<size_t>(header.indexCount));
+
+    if (!read(context, header.vertexOffset, static_cast<UINT64>(header.vertexCount) * sizeof(Vertex), vertices->data() + vertexBase) ||
+        !read(context, header.indexOffset, static_cast<UINT64>(header.indexCount) * sizeof(UINT), indices->data() + indexBase))
+    {
+        vertices->resize(vertexBase);
+        indices->resize(indexBase);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    for (const BakedMesh& baked : bakedMeshes)
+    {
+        Mesh mesh = {};
+        mesh.baseVertex = vertexBase + baked.baseVertex;
+        mesh.vertexCount = baked.vertexCount;
+        mesh.lodCount = baked.lodCount;
+        for (UINT lod = 0; lod < baked.lodCount; lod++)
+        {
+            mesh.lods[lod] = baked.lods[lod];
+            mesh.lods[lod].startIndex += indexBase;
+        }
+        mesh.boundsCenter = baked.boundsCenter;
+        mesh.boundsRadius = baked.boundsRadius;
+        meshes->push_back(mesh);
+    }
+
+    for (const BakedModel& baked : bakedModels)
+    {
+        if (baked.meshIndex >= header.meshCount)
+            continue;
+
+        Model model = {};
+        model.meshIndex = meshBase + baked.meshIndex;
+        model.world = baked.world;
+        models->push_back(model);
+    }
+
+    return S_OK;
+}
+
+static bool ReadMappedFile(void* context, UINT64 offset, UINT64 size, void* destination)
+{
+    const MappedFile* file = reinterpret_cast<const MappedFile*>(context);
+    memcpy(destination, file->data + offset, static_cast<size_t>(size));
+    return true;
+}
+
+void LoadBakedMesh(const wchar_t* path, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes, std::vector<Model>* models)
+{
+    MappedFile file;
+    ThrowIfFailed(OpenMappedFile(path, &file));
+
+    const HRESULT hr = ReadBakedMesh(ReadMappedFile, &file, file.size, vertices, indices, meshes, models);
+    CloseMappedFile(&file);
+
+    ThrowIfFailed(hr);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+HRESULT SaveBakedMesh(const wchar_t* path, const Vertex* vertices, UINT vertexCount, const UINT* indices, UINT indexCount, const Mesh* meshes, UINT meshCount, const Model* models, UINT modelCount)
+{
+    std::vector<BakedMesh> bakedMeshes(meshCount);
+    for (UINT m = 0; m < meshCount; m++)
+    {
+        BakedMesh* baked = &bakedMeshes[m];
+        memset(baked, 0, sizeof(*baked));
+        baked->baseVertex = meshes[m].baseVertex;
+        baked->vertexCount = meshes[m].vertexCount;
+        baked->lodCount = meshes[m].lodCount;
+        memcpy(baked->lods, meshes[m].lods, sizeof(baked->lods));
+        baked->boundsCenter = meshes[m].boundsCenter;
+        baked->boundsRadius = meshes[m].boundsRadius;
+    }
+
+    std::vector<BakedModel> bakedModels(modelCount);
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        memset(&bakedModels[i], 0, sizeof(BakedModel));
+        bakedModels[i].meshIndex = models[i].meshIndex;
+        bakedModels[i].world = models[i].world;
+    }
+
+    BakedMeshHeader header = {};
+    header.magic = BakedMeshMagic;
+    header.version = BakedMeshVersion;
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.meshCount = meshCount;
+    header.modelCount = modelCount;
+    header.vertexOffset = AlignOffset(sizeof(header));
+    header.indexOffset = AlignOffset(header.vertexOffset + static_cast<UINT64>(vertexCount) * sizeof(Vertex));
+    header.meshOffset = AlignOffset(header.indexOffset + static_cast<UINT64>(indexCount) * sizeof(UINT));
+    header.modelOffset = AlignOffset(header.meshOffset + static_cast<UINT64>(meshCount) * sizeof(BakedMesh));
+    header.fileSize = AlignOffset(header.modelOffset + static_cast<UINT64>(modelCount) * sizeof(BakedModel));
+
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    UINT64 position = 0;
+    const bool written =
+        WriteFileSection(file, &position, 0, &header, sizeof(header)) &&
+        WriteFileSection(file, &position, header.vertexOffset, vertices, static_cast<UINT64>(vertexCount) * sizeof(Vertex)) &&
+        WriteFileSection(file, &position, header.indexOffset, indices, static_cast<UINT64>(indexCount) * sizeof(UINT)) &&
+        WriteFileSection(file, &position, header.meshOffset, bakedMeshes.data(), static_cast<UINT64>(meshCount) * sizeof(BakedMesh)) &&
+        WriteFileSection(file, &position, header.modelOffset, bakedModels.data(), static_cast<UINT64>(modelCount) * sizeof(BakedModel)) &&
+        WriteFileSection(file, &position, header.fileSize, nullptr, 0);
+
+    const HRESULT hr = written ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    CloseHandle(file);
+
+    return hr;
+}
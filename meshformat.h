@@ -0,0 +1,71 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+// Formato binrio de malhas cozidas (.imesh), gerado pelo Cooker. As sees j esto no layout da engine e
+// alinhadas a BakedMeshAlignment bytes: o arquivo  mapeado e copiado para os buffers da cena sem nenhuma leitura
+// de texto nem converso.
+//
+//   BakedMeshHeader | Vertex[vertexCount] | UINT[indexCount] | BakedMesh[meshCount] | BakedModel[modelCount]
+
+const UINT BakedMeshMagic = 0x48534D49;     // "IMSH"
+const UINT BakedMeshVersion = 1;
+const UINT BakedMeshAlignment = 64;
+
+struct BakedMeshHeader
+{
+    UINT magic;
+    UINT version;
+
+    UINT vertexCount;
+    UINT indexCount;
+    UINT meshCount;
+    UINT modelCount;
+
+    UINT64 vertexOffset;
+    UINT64 indexOffset;
+    UINT64 meshOffset;
+    UINT64 modelOffset;
+    UINT64 fileSize;
+};
+
+// baseVertex e startIndex so relativos s sees do prprio arquivo.
+struct BakedMesh
+{
+    UINT baseVertex;
+    UINT vertexCount;
+    UINT lodCount;
+    UINT reserved;
+
+    MeshLod lods[MaxLodCount];
+
+    XMFLOAT3 boundsCenter;
+    float boundsRadius;
+};
+
+struct BakedModel
+{
+    UINT meshIndex;
+    UINT reserved[3];
+
+    XMFLOAT4X4 world;
+};
+
+static_assert(sizeof(BakedMeshHeader) == BakedMeshAlignment, "BakedMeshHeader deve ocupar uma linha de cache");
+static_assert(sizeof(BakedMesh) % 16 == 0, "BakedMesh deve manter o alinhamento de 16 bytes");
+
+// L size bytes a partir de offset do arquivo cozido. Devolve false se os dados no puderem ser lidos.
+typedef bool(*LPREADFUNC) (void* context, UINT64 offset, UINT64 size, void* destination);
+
+// L e valida o cabealho e as tabelas de malhas e modelos, sem tocar nas sees de vrtices e ndices.
+HRESULT ReadBakedMeshTables(LPREADFUNC read, void* context, UINT64 fileSize, BakedMeshHeader* header, std::vector<BakedMesh>* meshes, std::vector<BakedModel>* models);
+
+// Anexa o contedo do arquivo aos vetores da cena (com baseVertex, startIndex e meshIndex deslocados). As sees
+// de vrtices e ndices so lidas direto para os vetores; read permite ler de um pacote comprimido.
+HRESULT ReadBakedMesh(LPREADFUNC read, void* context, UINT64 fileSize, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes, std::vector<Model>* models);
+
+void LoadBakedMesh(const wchar_t* path, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes, std::vector<Model>* models);
+
+HRESULT SaveBakedMesh(const wchar_t* path, const Vertex* vertices, UINT vertexCount, const UINT* indices, UINT indexCount, const Mesh* meshes, UINT meshCount, const Model* models, UINT modelCount);
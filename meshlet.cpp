@@ -0,0 +1,420 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Blocos de MeshletBounds4 testados por job de culling.
+const UINT MeshletBlocksPerJob = 256;
+
+static void ComputeMeshletBounds(Meshlet* meshlet, const UINT* indices, const UINT* meshletVertices, UINT meshletVertexCount, const Vertex* vertices)
+{
+    XMVECTOR minimum = XMLoadFloat3(&vertices[meshletVertices[0]].position);
+    XMVECTOR maximum = minimum;
+    for (UINT i = 1; i < meshletVertexCount; i++)
+    {
+        const XMVECTOR p = XMLoadFloat3(&vertices[meshletVertices[i]].position);
+        minimum = XMVectorMin(minimum, p);
+        maximum = XMVectorMax(maximum, p);
+    }
+
+    const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+
+    float radius = 0.0f;
+    for (UINT i = 0; i < meshletVertexCount; i++)
+    {
+        const XMVECTOR p = XMLoadFloat3(&vertices[meshletVertices[i]].position);
+        radius = (std::max)(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center))));
+    }
+
+    XMStoreFloat3(&meshlet->center, center);
+    meshlet->radius = radius;
+
+    // Normais das faces apontam para fora (tringulos em sentido horrio so a face da frente).
+    XMVECTOR normals[MaxMeshletTriangles];
+    UINT normalCount = 0;
+    XMVECTOR axis = XMVectorZero();
+
+    for (UINT t = 0; t < meshlet->triangleCount; t++)
+    {
+        const XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].position);
+        const XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].position);
+        const XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].position);
+        const XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+
+        if (XMVectorGetX(XMVector3Length(normal)) <= 1e-12f)
+            continue;
+
+        normals[normalCount] = XMVector3Normalize(normal);
+        axis = XMVectorAdd(axis, normals[normalCount]);
+        normalCount++;
+    }
+
+    meshlet->coneAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    meshlet->coneCutoff = 1.0f;
+
+    if (normalCount == 0 || XMVectorGetX(XMVector3Length(axis)) <= 1e-6f)
+        return;
+
+    axis = XMVector3Normalize(axis);
+
+    float minimumDot = 1.0f;
+    for (UINT i = 0; i < normalCount; i++)
+    {
+        minimumDot = (std::min)(minimumDot, XMVectorGetX(XMVector3Dot(axis, normals[i])));
+    }
+
+    // Cones abertos demais (perto de 90 graus) nunca seriam descartados; ficam desligados (cutoff = 1).
+    XMStoreFloat3(&meshlet->coneAxis, axis);
+    meshlet->coneCutoff = minimumDot <= 0.1f ? 1.0f : sqrtf(1.0f - minimumDot * minimumDot);
+}
+
+void BuildMeshlets(std::vector<Meshlet>* meshlets, UINT* indices, UINT indexCount, UINT startIndex, const Vertex* vertices, UINT vertexCount)
+{
+    const UINT triangleCount = indexCount / 3;
+
+    std::vector<UINT> offsets(vertexCount + 1, 0);
+    std::vector<UINT> adjacency(triangleCount * 3);
+    for (UINT i = 0; i < triangleCount * 3; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for (UINT v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    {
+        std::vector<UINT> cursor(offsets.begin(), offsets.end() - 1);
+        for (UINT i = 0; i < triangleCount * 3; i++)
+        {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<UINT> output;
+    output.reserve(triangleCount * 3);
+
+    std::vector<BYTE> emitted(triangleCount, 0);
+    std::vector<UINT> vertexMeshlet(vertexCount, UINT_MAX);
+    std::vector<UINT> candidateMeshlet(triangleCount, UINT_MAX);
+    std::vector<UINT> candidates;
+    UINT meshletVertices[MaxMeshletVertices];
+
+    UINT emittedCount = 0;
+    UINT nextSeed = 0;
+
+    while (emittedCount < triangleCount)
+    {
+        const UINT meshletId = static_cast<UINT>(meshlets->size());
+        const UINT meshletStart = static_cast<UINT>(output.size());
+        UINT meshletVertexCount = 0;
+        UINT meshletTriangleCount = 0;
+
+        candidates.clear();
+
+        for (;;)
+        {
+            if (candidates.empty())
+            {
+                while (nextSeed < triangleCount && emitted[nextSeed])
+                    nextSeed++;
+                if (nextSeed == triangleCount)
+                    break;
+                candidates.push_back(nextSeed);
+            }
+
+            // Escolhe o tringulo vizinho que acrescenta menos vrtices novos ao cluster.
+            UINT best = UINT_MAX;
+            UINT bestNewVertices = 4;
+            for (size_t c = 0; c < candidates.size();)
+            {
+                const UINT triangle = candidates[c];
+                if (emitted[triangle])
+                {
+                    candidates[c] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                const UINT* t = &indices[triangle * 3];
+                UINT newVertices = 0;
+                for (UINT k = 0; k < 3; k++)
+                {
+                    if (vertexMeshlet[t[k]] != meshletId)
+                        newVertices++;
+                }
+
+                if (meshletVertexCount + newVertices <= MaxMeshletVertices && newVertices < bestNewVertices)
+                {
+                    best = triangle;
+                    bestNewVertices = newVertices;
+                    if (newVertices == 0)
+                        break;
+                }
+                c++;
+            }
+
+            if (best == UINT_MAX)
+                break;
+
+            const UINT* t = &indices[best * 3];
+            for (UINT k = 0; k < 3; k++)
+            {
+                if (vertexMeshlet[t[k]] != meshletId)
+                {
+                    vertexMeshlet[t[k]] = meshletId;
+                    meshletVertices[meshletVertexCount++] = t[k];
+                }
+
+                output.push_back(t[k]);
+
+                for (UINT a = offsets[t[k]]; a < offsets[t[k] + 1]; a++)
+                {
+                    const UINT neighbor = adjacency[a];
+                    if (!emitted[neighbor] && candidateMeshlet[neighbor] != meshletId)
+                    {
+                        candidateMeshlet[neighbor] = meshletId;
+                        candidates.push_back(neighbor);
+                    }
+                }
+            }
+
+            emitted[best] = 1;
+            emittedCount++;
+
+            if (++meshletTriangleCount == MaxMeshletTriangles)
+                break;
+        }
+
+        Meshlet meshlet = {};
+        meshlet.startIndex = startIndex + meshletStart;
+        meshlet.triangleCount = meshletTriangleCount;
+        meshlet.vertexCount = meshletVertexCount;
+        ComputeMeshletBounds(&meshlet, &output[meshletStart], meshletVertices, meshletVertexCount, vertices);
+
+        meshlets->push_back(meshlet);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct SceneMeshletContext
+{
+    Mesh* meshes;
+    const Vertex* vertices;
+    UINT* indices;
+    std::vector<Meshlet>* meshMeshlets;
+};
+
+static void BuildMeshletsJob(void* context, UINT meshIndex)
+{
+    SceneMeshletContext* scene = reinterpret_cast<SceneMeshletContext*>(context);
+    const Mesh* mesh = &scene->meshes[meshIndex];
+    const MeshLod* lod = &mesh->lods[0];
+
+    if (mesh->pending || lod->indexCount / 3 < MinClusteredTriangleCount)
+        return;
+
+    std::vector<Meshlet>* meshlets = &scene->meshMeshlets[meshIndex];
+    BuildMeshlets(meshlets, scene->indices + lod->startIndex, lod->indexCount, lod->startIndex, scene->vertices + mesh->baseVertex, mesh->vertexCount);
+
+    Meshlet empty = {};
+    empty.radius = -1.0f;
+    empty.coneCutoff = 1.0f;
+    while (meshlets->size() % 4 != 0)
+        meshlets->push_back(empty);
+}
+
+void BuildSceneMeshlets(JobSystem* jobSystem, Mesh* meshes, UINT meshCount, const Vertex* vertices, std::vector<UINT>* indices, std::vector<Meshlet>* meshlets, std::vector<MeshletBounds4>* bounds)
+{
+    std::vector<std::vector<Meshlet>> meshMeshlets(meshCount);
+
+    SceneMeshletContext context;
+    context.meshes = meshes;
+    context.vertices = vertices;
+    context.indices = indices->data();
+    context.meshMeshlets = meshMeshlets.data();
+
+    ParallelFor(jobSystem, meshCount, BuildMeshletsJob, &context);
+
+    for (UINT m = 0; m < meshCount; m++)
+    {
+        meshes[m].meshletOffset = static_cast<UINT>(meshlets->size());
+        meshes[m].meshletCount = static_cast<UINT>(meshMeshlets[m].size());
+
+        for (size_t i = 0; i < meshMeshlets[m].size(); i += 4)
+        {
+            const Meshlet* m4 = &meshMeshlets[m][i];
+
+            MeshletBounds4 block;
+            block.centerX = XMFLOAT4(m4[0].center.x, m4[1].center.x, m4[2].center.x, m4[3].center.x);
+            block.centerY = XMFLOAT4(m4[0].center.y, m4[1].center.y, m4[2].center.y, m4[3].center.y);
+            block.centerZ = XMFLOAT4(m4[0].center.z, m4[1].center.z, m4[2].center.z, m4[3].center.z);
+            block.radius = XMFLOAT4(m4[0].radius, m4[1].radius, m4[2].radius, m4[3].radius);
+            block.coneAxisX = XMFLOAT4(m4[0].coneAxis.x, m4[1].coneAxis.x, m4[2].coneAxis.x, m4[3].coneAxis.x);
+            block.coneAxisY = XMFLOAT4(m4[0].coneAxis.y, m4[1].coneAxis.y, m4[2].coneAxis.y, m4[3].coneAxis.y);
+            block.coneAxisZ = XMFLOAT4(m4[0].coneAxis.z, m4[1].coneAxis.z, m4[2].coneAxis.z, m4[3].coneAxis.z);
+            block.coneCutoff = XMFLOAT4(m4[0].coneCutoff, m4[1].coneCutoff, m4[2].coneCutoff, m4[3].coneCutoff);
+            bounds->push_back(block);
+        }
+
+        meshlets->insert(meshlets->end(), meshMeshlets[m].begin(), meshMeshlets[m].end());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct MeshletCullJob
+{
+    UINT drawIndex;
+    UINT firstBlock;
+    UINT blockCount;
+};
+
+struct MeshletCullContext
+{
+    const LodView* lodView;
+    const Mesh* meshes;
+    const Meshlet* meshlets;
+    const MeshletBounds4* bounds;
+    const Model* models;
+    const DrawCommand* draws;
+
+    const MeshletCullJob* jobs;
+    std::vector<DrawCommand>* results;
+};
+
+static void CullMeshletsJob(void* context, UINT jobIndex)
+{
+    MeshletCullContext* cull = reinterpret_cast<MeshletCullContext*>(context);
+    const MeshletCullJob* job = &cull->jobs[jobIndex];
+    const DrawCommand* draw = &cull->draws[job->drawIndex];
+    const Mesh* mesh = &cull->meshes[cull->models[draw->modelIndex].meshIndex];
+    std::vector<DrawCommand>* result = &cull->results[jobIndex];
+
+    XMFLOAT3 camera;
+    XMFLOAT4 planes[6];
+    GetModelSpaceView(cull->lodView, &cull->models[draw->modelIndex].world, &camera, planes);
+
+    const XMVECTOR cameraX = XMVectorReplicate(camera.x);
+    const XMVECTOR cameraY = XMVectorReplicate(camera.y);
+    const XMVECTOR cameraZ = XMVectorReplicate(camera.z);
+
+    const MeshletBounds4* blocks = cull->bounds + mesh->meshletOffset / 4;
+    const Meshlet* meshlets = cull->meshlets + mesh->meshletOffset;
+
+    for (UINT b = job->firstBlock; b < job->firstBlock + job->blockCount; b++)
+    {
+        const MeshletBounds4* block = &blocks[b];
+        const XMVECTOR x = XMLoadFloat4(&block->centerX);
+        const XMVECTOR y = XMLoadFloat4(&block->centerY);
+        const XMVECTOR z = XMLoadFloat4(&block->centerZ);
+        const XMVECTOR r = XMLoadFloat4(&block->radius);
+        const XMVECTOR negativeRadius = XMVectorNegate(r);
+
+        XMVECTOR visible = XMVectorGreaterOrEqual(r, XMVectorZero());
+        for (UINT p = 0; p < 6; p++)
+        {
+            XMVECTOR distance = XMVectorMultiplyAdd(XMVectorReplicate(planes[p].x), x, XMVectorReplicate(planes[p].w));
+            distance = XMVectorMultiplyAdd(XMVectorReplicate(planes[p].y), y, distance);
+            distance = XMVectorMultiplyAdd(XMVectorReplicate(planes[p].z), z, distance);
+            visible = XMVectorAndInt(visible, XMVectorGreater(distance, negativeRadius));
+        }
+
+        const XMVECTOR dx = XMVectorSubtract(x, cameraX);
+        const XMVECTOR dy = XMVectorSubtract(y, cameraY);
+        const XMVECTOR dz = XMVectorSubtract(z, cameraZ);
+        const XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+
+        XMVECTOR coneDot = XMVectorMultiply(dx, XMLoadFloat4(&block->coneAxisX));
+        coneDot = XMVectorMultiplyAdd(dy, XMLoadFloat4(&block->coneAxisY), coneDot);
+        coneDot = XMVectorMultiplyAdd(dz, XMLoadFloat4(&block->coneAxisZ), coneDot);
+
+        const XMVECTOR backfacing = XMVectorGreaterOrEqual(coneDot, XMVectorMultiplyAdd(XMLoadFloat4(&block->coneCutoff), length, r));
+        visible = XMVectorAndCInt(visible, backfacing);
+
+        XMUINT4 mask;
+        XMStoreUInt4(&mask, visible);
+        const UINT lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+
+        for (UINT k = 0; k < 4; k++)
+        {
+            const Meshlet* meshlet = &meshlets[b * 4 + k];
+            if (!lanes[k] || meshlet->triangleCount == 0)
+                continue;
+
+            if (!result->empty() && result->back().startIndex + result->back().indexCount == meshlet->startIndex)
+            {
+                result->back().indexCount += meshlet->triangleCount * 3;
+            }
+            else
+            {
+                result->push_back({ draw->modelIndex, meshlet->triangleCount * 3, meshlet->startIndex, draw->baseVertex });
+            }
+        }
+    }
+}
+
+void CullMeshlets(JobSystem* jobSystem, const LodView* lodView, const Mesh* meshes, const Meshlet* meshlets, const MeshletBounds4* bounds, const Model* models, std::vector<DrawCommand>* drawList)
+{
+    std::vector<MeshletCullJob> jobs;
+
+    for (UINT d = 0; d < drawList->size(); d++)
+    {
+        const DrawCommand* draw = &(*drawList)[d];
+        const Mesh* mesh = &meshes[models[draw->modelIndex].meshIndex];
+
+        // S o nvel 0  clusterizado; LODs mais grossos j so baratos o bastante. Malhas com DAG de clusters
+        // so desenhadas pelo corte do DAG.
+        if (mesh->meshletCount == 0 || mesh->dagClusterCount != 0 || draw->startIndex != mesh->lods[0].startIndex)
+            continue;
+
+        const UINT blockCount = mesh->meshletCount / 4;
+        for (UINT first = 0; first < blockCount; first += MeshletBlocksPerJob)
+        {
+            jobs.push_back({ d, first, (std::min)(MeshletBlocksPerJob, blockCount - first) });
+        }
+    }
+
+    if (jobs.empty())
+        return;
+
+    std::vector<std::vector<DrawCommand>> results(jobs.size());
+
+    MeshletCullContext context;
+    context.lodView = lodView;
+    context.meshes = meshes;
+    context.meshlets = meshlets;
+    context.bounds = bounds;
+    context.models = models;
+    context.draws = drawList->data();
+    context.jobs = jobs.data();
+    context.results = results.data();
+
+    ParallelFor(jobSystem, static_cast<UINT>(jobs.size()), CullMeshletsJob, &context);
+
+    std::vector<DrawCommand> culled;
+    culled.reserve(drawList->size() + jobs.size());
+
+    UINT job = 0;
+    for (UINT d = 0; d < drawList->size(); d++)
+    {
+        if (job < jobs.size() && jobs[job].drawIndex == d)
+        {
+            for (; job < jobs.size() && jobs[job].drawIndex == d; job++)
+            {
+                culled.insert(culled.end(), results[job].begin(), results[job].end());
+            }
+        }
+        else
+        {
+            culled.push_back((*drawList)[d]);
+        }
+    }
+
+    drawList->swap(culled);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+#include "lodselect.h"
+
+#include <vector>
+
+const UINT MaxMeshletVertices = 64;
+const UINT MaxMeshletTriangles = 124;
+
+// Malhas com menos tringulos que isto so desenhadas inteiras, sem culling por cluster.
+const UINT MinClusteredTriangleCount = MaxMeshletTriangles * 4;
+
+// Cluster de tringulos contguos no index buffer da cena. Os limites ficam no espao do modelo.
+struct Meshlet
+{
+    UINT startIndex;
+    UINT triangleCount;
+    UINT vertexCount;
+
+    XMFLOAT3 center;
+    float radius;
+
+    // Cone de normais: o cluster est de costas quando dot(center - camera, coneAxis) >= coneCutoff * |center - camera| + radius.
+    XMFLOAT3 coneAxis;
+    float coneCutoff;
+};
+
+// Limites de 4 meshlets consecutivos em formato SoA, para o teste em SIMD.
+struct MeshletBounds4
+{
+    XMFLOAT4 centerX;
+    XMFLOAT4 centerY;
+    XMFLOAT4 centerZ;
+    XMFLOAT4 radius;
+    XMFLOAT4 coneAxisX;
+    XMFLOAT4 coneAxisY;
+    XMFLOAT4 coneAxisZ;
+    XMFLOAT4 coneCutoff;
+};
+
+// Reordena os ndices da malha para que cada cluster seja uma faixa contgua e anexa os meshlets em meshlets.
+// startIndex  a posio de indices no index buffer da cena.
+void BuildMeshlets(std::vector<Meshlet>* meshlets, UINT* indices, UINT indexCount, UINT startIndex, const Vertex* vertices, UINT vertexCount);
+
+// Gera os clusters do nvel 0 de cada malha grande, em paralelo entre as malhas. Cada malha recebe um nmero
+// de meshlets mltiplo de 4 (completado com meshlets vazios) para alinhar com bounds.
+void BuildSceneMeshlets(JobSystem* jobSystem, Mesh* meshes, UINT meshCount, const Vertex* vertices, std::vector<UINT>* indices, std::vector<Meshlet>* meshlets, std::vector<MeshletBounds4>* bounds);
+
+// Substitui os comandos de desenho de malhas clusterizadas (no nvel 0) pelas faixas de ndices dos meshlets
+// que passam nos testes de frustum e de cone. Faixas adjacentes so fundidas.
+void CullMeshlets(JobSystem* jobSystem, const LodView* lodView, const Mesh* meshes, const Meshlet* meshlets, const MeshletBounds4* bounds, const Model* models, std::vector<DrawCommand>* drawList);
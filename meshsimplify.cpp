@@ -0,0 +1,631 @@
+#include "meshsimplify.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Soma de weight * (n . p + d)^2 sobre um conjunto de planos.
+struct QuadricForm
+{
+    float a00, a11, a22, a01, a02, a12;
+    float b0, b1, b2;
+    float c;
+};
+
+struct Quadric
+{
+    // Planos das faces e das bordas. weight  a soma dos pesos (reas), e geometry / weight  a distncia
+    // quadrtica mdia at esses planos.
+    QuadricForm geometry;
+    float weight;
+
+    // Termo de cor: para cada canal k, w * (g_k . p + d_k - cor_k)^2. A parte que no depende da cor fica em
+    // color; aqui ficam apenas os termos cruzados com a cor.
+    QuadricForm color;
+    float w;
+    float g[4][3];
+    float gd[4];
+};
+
+enum VertexKind
+{
+    VertexKindFree,
+    VertexKindBorder,
+    VertexKindLocked
+};
+
+struct Collapse
+{
+    UINT from;
+    UINT to;
+    float error;
+    float distance;         // Parte geomtrica de error: distncia quadrtica mdia.
+};
+
+struct PositionKey
+{
+    UINT x, y, z;
+
+    bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct PositionKeyHash
+{
+    size_t operator()(const PositionKey& key) const { return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u); }
+};
+
+const float BorderPlaneWeight = 10.0f;
+const float MinFlipCosine = 0.25f;
+
+// -----------------------------------------------------------------------------------------------------
+
+static void AddPlane(QuadricForm* q, float nx, float ny, float nz, float d, float weight)
+{
+    q->a00 += weight * nx * nx;
+    q->a11 += weight * ny * ny;
+    q->a22 += weight * nz * nz;
+    q->a01 += weight * nx * ny;
+    q->a02 += weight * nx * nz;
+    q->a12 += weight * ny * nz;
+    q->b0 += weight * nx * d;
+    q->b1 += weight * ny * d;
+    q->b2 += weight * nz * d;
+    q->c += weight * d * d;
+}
+
+static void AddQuadric(Quadric* q, const Quadric* other)
+{
+    const float* src = reinterpret_cast<const float*>(other);
+    float* dst = reinterpret_cast<float*>(q);
+
+    for (UINT i = 0; i < sizeof(Quadric) / sizeof(float); i++)
+    {
+        dst[i] += src[i];
+    }
+}
+
+static void AddColorGradient(Quadric* q, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, const XMFLOAT4& c0, const XMFLOAT4& c1, const XMFLOAT4& c2, float weight)
+{
+    const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+    const float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+
+    const float d11 = e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2];
+    const float d12 = e1[0] * e2[0] + e1[1] * e2[1] + e1[2] * e2[2];
+    const float d22 = e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2];
+    const float det = d11 * d22 - d12 * d12;
+
+    if (det <= 1e-12f)
+        return;
+
+    const float w = 0.5f * sqrtf(det) * weight;
+    const float a0[4] = { c0.x, c0.y, c0.z, c0.w };
+    const float a1[4] = { c1.x, c1.y, c1.z, c1.w };
+    const float a2[4] = { c2.x, c2.y, c2.z, c2.w };
+
+    for (UINT k = 0; k < 4; k++)
+    {
+        // Gradiente do canal no plano do tringulo: g . e1 = da1, g . e2 = da2.
+        const float da1 = a1[k] - a0[k];
+        const float da2 = a2[k] - a0[k];
+        const float alpha = (d22 * da1 - d12 * da2) / det;
+        const float beta = (d11 * da2 - d12 * da1) / det;
+
+        const float g[3] = { alpha * e1[0] + beta * e2[0], alpha * e1[1] + beta * e2[1], alpha * e1[2] + beta * e2[2] };
+        const float d = a0[k] - (g[0] * p0.x + g[1] * p0.y + g[2] * p0.z);
+
+        AddPlane(&q->color, g[0], g[1], g[2], d, w);
+
+        q->g[k][0] += w * g[0];
+        q->g[k][1] += w * g[1];
+        q->g[k][2] += w * g[2];
+        q->gd[k] += w * d;
+    }
+
+    q->w += w;
+}
+
+static float EvaluateForm(const QuadricForm* q, const XMFLOAT3& p)
+{
+    const float x = p.x, y = p.y, z = p.z;
+
+    return q->a00 * x * x + q->a11 * y * y + q->a22 * z * z
+        + 2.0f * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z)
+        + 2.0f * (q->b0 * x + q->b1 * y + q->b2 * z)
+        + q->c;
+}
+
+static float EvaluateColor(const Quadric* q, const XMFLOAT3& p, const XMFLOAT4& color)
+{
+    float error = EvaluateForm(&q->color, p);
+
+    const float a[4] = { color.x, color.y, color.z, color.w };
+    for (UINT k = 0; k < 4; k++)
+    {
+        const float gp = q->g[k][0] * p.x + q->g[k][1] * p.y + q->g[k][2] * p.z;
+        error += q->w * a[k] * a[k] - 2.0f * a[k] * (gp + q->gd[k]);
+    }
+
+    return error;
+}
+
+// Erro de levar os vrtices de q0 e q1 para p, dividido pela rea somada das faces deles: a parte geomtrica
+// (em distance)  uma distncia ao quadrado e no cresce com o nmero de faces fundidas.
+static float EvaluateCollapse(const Quadric* q0, const Quadric* q1, const XMFLOAT3& p, const XMFLOAT4& color, float* distance)
+{
+    const float weight = q0->weight + q1->weight;
+    if (weight <= 0.0f)
+    {
+        *distance = 0.0f;
+        return 0.0f;
+    }
+
+    const float geometry = (std::max)(EvaluateForm(&q0->geometry, p) + EvaluateForm(&q1->geometry, p), 0.0f) / weight;
+    const float colorError = (std::max)(EvaluateColor(q0, p, color) + EvaluateColor(q1, p, color), 0.0f) / weight;
+
+    *distance = geometry;
+    return geometry + colorError;
+}
+
+static XMFLOAT3 TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+{
+    const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+    const float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+
+    return XMFLOAT3(e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]);
+}
+
+static float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct Adjacency
+{
+    std::vector<UINT> offsets;
+    std::vector<UINT> triangles;
+};
+
+static void BuildAdjacency(Adjacency* adjacency, const UINT* indices, UINT indexCount, UINT vertexCount)
+{
+    adjacency->offsets.assign(vertexCount + 1, 0);
+    adjacency->triangles.resize(indexCount);
+
+    for (UINT i = 0; i < indexCount; i++)
+    {
+        adjacency->offsets[indices[i] + 1]++;
+    }
+
+    for (UINT v = 0; v < vertexCount; v++)
+    {
+        adjacency->offsets[v + 1] += adjacency->offsets[v];
+    }
+
+    std::vector<UINT> cursor(adjacency->offsets.begin(), adjacency->offsets.end() - 1);
+    for (UINT i = 0; i < indexCount; i++)
+    {
+        adjacency->triangles[cursor[indices[i]]++] = i / 3;
+    }
+}
+
+static bool IsBorderEdge(const Adjacency* adjacency, const UINT* indices, const UINT* canonical, UINT a, UINT b)
+{
+    UINT count = 0;
+
+    for (UINT i = adjacency->offsets[a]; i < adjacency->offsets[a + 1]; i++)
+    {
+        const UINT* triangle = &indices[adjacency->triangles[i] * 3];
+
+        if (canonical[triangle[0]] == canonical[b] || canonical[triangle[1]] == canonical[b] || canonical[triangle[2]] == canonical[b])
+            count++;
+    }
+
+    return count == 1;
+}
+
+static bool CanCollapse(const Adjacency* adjacency, const UINT* indices, const UINT* canonical, const BYTE* kinds, UINT from, UINT to)
+{
+    if (kinds[from] == VertexKindFree)
+        return true;
+
+    // Vrtices de borda s deslizam ao longo da prpria borda, para no abrir buracos na silhueta.
+    if (kinds[from] == VertexKindBorder)
+        return kinds[to] != VertexKindFree && IsBorderEdge(adjacency, indices, canonical, from, to);
+
+    return false;
+}
+
+static bool FlipsTriangle(const Adjacency* adjacency, const UINT* indices, const XMFLOAT3* positions, UINT from, UINT to)
+{
+    for (UINT i = adjacency->offsets[from]; i < adjacency->offsets[from + 1]; i++)
+    {
+        const UINT* triangle = &indices[adjacency->triangles[i] * 3];
+
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+
+        XMFLOAT3 p[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+        const XMFLOAT3 before = TriangleNormal(p[0], p[1], p[2]);
+
+        for (UINT k = 0; k < 3; k++)
+        {
+            if (triangle[k] == from)
+                p[k] = positions[to];
+        }
+
+        const XMFLOAT3 after = TriangleNormal(p[0], p[1], p[2]);
+
+        const float lengths = sqrtf(Dot(before, before) * Dot(after, after));
+        if (Dot(before, after) <= MinFlipCosine * lengths)
+            return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+UINT SimplifyMesh(UINT* destination, const UINT* indices, UINT indexCount, const Vertex* vertices, UINT vertexCount, const SimplifyOptions* options, float* resultError)
+{
+    if (resultError)
+        *resultError = 0.0f;
+
+    std::vector<UINT> result(indices, indices + indexCount);
+    if (indexCount < 3 || vertexCount == 0)
+    {
+        std::copy(result.begin(), result.end(), destination);
+        return indexCount;
+    }
+
+    // Posies normalizadas pela maior dimenso: o erro fica independente da escala do modelo.
+    XMFLOAT3 minimum = vertices[indices[0]].position;
+    XMFLOAT3 maximum = minimum;
+    for (UINT i = 0; i < indexCount; i++)
+    {
+        const XMFLOAT3& p = vertices[indices[i]].position;
+        minimum = XMFLOAT3((std::min)(minimum.x, p.x), (std::min)(minimum.y, p.y), (std::min)(minimum.z, p.z));
+        maximum = XMFLOAT3((std::max)(maximum.x, p.x), (std::max)(maximum.y, p.y), (std::max)(maximum.z, p.z));
+    }
+
+    // Divide em vez de multiplicar pelo inverso: uma cpia escalada por um fator exato d as mesmas posies,
+    // as mesmas decises e um erro final proporcional  escala.
+    const float extent = (std::max)((std::max)(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z);
+    const float divisor = extent > 0.0f ? extent : 1.0f;
+
+    std::vector<XMFLOAT3> positions(vertexCount);
+    for (UINT v = 0; v < vertexCount; v++)
+    {
+        const XMFLOAT3& p = vertices[v].position;
+        positions[v] = XMFLOAT3((p.x - minimum.x) / divisor, (p.y - minimum.y) / divisor, (p.z - minimum.z) / divisor);
+    }
+
+    // Vrtices com a mesma posio (costuras de cor) compartilham um ndice cannico; a topologia 
+    // analisada sobre esses ndices.
+    std::vector<UINT> canonical(vertexCount);
+    std::vector<UINT> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<PositionKey, UINT, PositionKeyHash> positionMap;
+        positionMap.reserve(vertexCount);
+
+        for (UINT v = 0; v < vertexCount; v++)
+        {
+            PositionKey key;
+            memcpy(&key.x, &vertices[v].position.x, sizeof(float));
+            memcpy(&key.y, &vertices[v].position.y, sizeof(float));
+            memcpy(&key.z, &vertices[v].position.z, sizeof(float));
+
+            canonical[v] = positionMap.emplace(key, v).first->second;
+            wedgeCount[canonical[v]]++;
+        }
+    }
+
+    std::vector<BYTE> kinds(vertexCount, VertexKindFree);
+    std::vector<Quadric> quadrics(vertexCount);
+    memset(quadrics.data(), 0, sizeof(Quadric) * vertexCount);
+    {
+        std::unordered_map<UINT64, UINT> edgeCounts;
+        edgeCounts.reserve(indexCount);
+
+        for (UINT i = 0; i < indexCount; i += 3)
+        {
+            for (UINT e = 0; e < 3; e++)
+            {
+                const UINT a = canonical[indices[i + e]];
+                const UINT b = canonical[indices[i + (e + 1) % 3]];
+                const UINT64 key = (static_cast<UINT64>((std::min)(a, b)) << 32) | (std::max)(a, b);
+                edgeCounts[key]++;
+            }
+        }
+
+        for (UINT i = 0; i < indexCount; i += 3)
+        {
+            const UINT i0 = indices[i + 0], i1 = indices[i + 1], i2 = indices[i + 2];
+            const XMFLOAT3 normal = TriangleNormal(positions[i0], positions[i1], positions[i2]);
+            const float length = sqrtf(Dot(normal, normal));
+
+            if (length > 0.0f)
+            {
+                const XMFLOAT3 n(normal.x / length, normal.y / length, normal.z / length);
+                const float d = -Dot(n, positions[i0]);
+                const float area = 0.5f * length;
+
+                for (UINT k = 0; k < 3; k++)
+                {
+                    Quadric* q = &quadrics[indices[i + k]];
+                    AddPlane(&q->geometry, n.x, n.y, n.z, d, area);
+                    q->weight += area;
+                    AddColorGradient(q, positions[i0], positions[i1], positions[i2], vertices[i0].color, vertices[i1].color, vertices[i2].color, options->colorWeight);
+                }
+
+                for (UINT e = 0; e < 3; e++)
+                {
+                    const UINT a = indices[i + e];
+                    const UINT b = indices[i + (e + 1) % 3];
+                    const UINT ca = canonical[a], cb = canonical[b];
+                    const UINT count = edgeCounts[(static_cast<UINT64>((std::min)(ca, cb)) << 32) | (std::max)(ca, cb)];
+
+                    if (count == 1)
+                    {
+                        // Plano perpendicular  face contendo a aresta de borda: segura a silhueta aberta.
+                        const XMFLOAT3 edge(positions[b].x - positions[a].x, positions[b].y - positions[a].y, positions[b].z - positions[a].z);
+                        XMFLOAT3 bn(edge.y * n.z - edge.z * n.y, edge.z * n.x - edge.x * n.z, edge.x * n.y - edge.y * n.x);
+                        const float bnLength = sqrtf(Dot(bn, bn));
+
+                        if (bnLength > 0.0f)
+                        {
+                            bn = XMFLOAT3(bn.x / bnLength, bn.y / bnLength, bn.z / bnLength);
+                            const float weight = Dot(edge, edge) * BorderPlaneWeight;
+                            AddPlane(&quadrics[a].geometry, bn.x, bn.y, bn.z, -Dot(bn, positions[a]), weight);
+                            AddPlane(&quadrics[b].geometry, bn.x, bn.y, bn.z, -Dot(bn, positions[a]), weight);
+                            quadrics[a].weight += weight;
+                            quadrics[b].weight += weight;
+                        }
+
+                        kinds[a] = kinds[a] == VertexKindLocked ? VertexKindLocked : VertexKindBorder;
+                        kinds[b] = kinds[b] == VertexKindLocked ? VertexKindLocked : VertexKindBorder;
+                    }
+                    else if (count > 2)
+                    {
+                        kinds[a] = VertexKindLocked;
+                        kinds[b] = VertexKindLocked;
+                    }
+                }
+            }
+        }
+
+        for (UINT v = 0; v < vertexCount; v++)
+        {
+            if (wedgeCount[canonical[v]] > 1 || (options->lockBorder && kinds[v] == VertexKindBorder))
+                kinds[v] = VertexKindLocked;
+        }
+    }
+
+    UINT targetIndexCount = static_cast<UINT>(indexCount * options->targetRatio) / 3 * 3;
+    targetIndexCount = (std::max)(targetIndexCount, 3u);
+
+    // O limite vale para a parte geomtrica: a cor s decide a ordem dos colapsos.
+    const float errorLimit = options->targetError * options->targetError;
+    float maxError = 0.0f;
+
+    Adjacency adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<UINT> remap(vertexCount);
+    std::vector<BYTE> touched(vertexCount);
+
+    UINT resultCount = indexCount;
+    while (resultCount > targetIndexCount)
+    {
+        BuildAdjacency(&adjacency, result.data(), resultCount, vertexCount);
+
+        collapses.clear();
+        for (UINT i = 0; i < resultCount; i += 3)
+        {
+            for (UINT e = 0; e < 3; e++)
+            {
+                const UINT a = result[i + e];
+                const UINT b = result[i + (e + 1) % 3];
+
+                if (canonical[a] == canonical[b])
+                    continue;
+
+                Collapse collapse = { a, b, FLT_MAX, FLT_MAX };
+
+                if (CanCollapse(&adjacency, result.data(), canonical.data(), kinds.data(), a, b))
+                    collapse.error = EvaluateCollapse(&quadrics[a], &quadrics[b], positions[b], vertices[b].color, &collapse.distance);
+
+                if (CanCollapse(&adjacency, result.data(), canonical.data(), kinds.data(), b, a))
+                {
+                    float distance = 0.0f;
+                    const float error = EvaluateCollapse(&quadrics[a], &quadrics[b], positions[a], vertices[a].color, &distance);
+                    if (error < collapse.error)
+                        collapse = { b, a, error, distance };
+                }
+
+                if (collapse.distance <= errorLimit)
+                    collapses.push_back(collapse);
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        for (UINT v = 0; v < vertexCount; v++)
+        {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+
+        const UINT trianglesToRemove = (resultCount - targetIndexCount) / 3;
+        UINT removedTriangles = 0;
+        UINT collapseCount = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (removedTriangles >= trianglesToRemove)
+                break;
+
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            if (FlipsTriangle(&adjacency, result.data(), positions.data(), collapse.from, collapse.to))
+                continue;
+
+            for (UINT i = adjacency.offsets[collapse.from]; i < adjacency.offsets[collapse.from + 1]; i++)
+            {
+                const UINT* triangle = &result[adjacency.triangles[i] * 3];
+
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    removedTriangles++;
+
+                touched[triangle[0]] = 1;
+                touched[triangle[1]] = 1;
+                touched[triangle[2]] = 1;
+            }
+
+            remap[collapse.from] = collapse.to;
+            AddQuadric(&quadrics[collapse.to], &quadrics[collapse.from]);
+            maxError = (std::max)(maxError, collapse.distance);
+            collapseCount++;
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        UINT writeCount = 0;
+        for (UINT i = 0; i < resultCount; i += 3)
+        {
+            const UINT i0 = remap[result[i + 0]];
+            const UINT i1 = remap[result[i + 1]];
+            const UINT i2 = remap[result[i + 2]];
+
+            if (i0 == i1 || i1 == i2 || i0 == i2)
+                continue;
+
+            result[writeCount + 0] = i0;
+            result[writeCount + 1] = i1;
+            result[writeCount + 2] = i2;
+            writeCount += 3;
+        }
+        resultCount = writeCount;
+    }
+
+    std::copy(result.begin(), result.begin() + resultCount, destination);
+
+    if (resultError)
+        *resultError = sqrtf(maxError);
+
+    return resultCount;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct LodChainContext
+{
+    Mesh* meshes;
+    const Vertex* vertices;
+    const UINT* indices;
+    const LodChainOptions* options;
+    std::vector<UINT>* lodIndices;
+};
+
+static float GetMeshExtent(const UINT* indices, UINT indexCount, const Vertex* vertices)
+{
+    if (indexCount == 0)
+        return 0.0f;
+
+    XMFLOAT3 minimum = vertices[indices[0]].position;
+    XMFLOAT3 maximum = minimum;
+    for (UINT i = 0; i < indexCount; i++)
+    {
+        const XMFLOAT3& p = vertices[indices[i]].position;
+        minimum = XMFLOAT3((std::min)(minimum.x, p.x), (std::min)(minimum.y, p.y), (std::min)(minimum.z, p.z));
+        maximum = XMFLOAT3((std::max)(maximum.x, p.x), (std::max)(maximum.y, p.y), (std::max)(maximum.z, p.z));
+    }
+
+    return (std::max)((std::max)(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z);
+}
+
+static void BuildLodChainJob(void* context, UINT meshIndex)
+{
+    LodChainContext* chain = reinterpret_cast<LodChainContext*>(context);
+    Mesh* mesh = &chain->meshes[meshIndex];
+    const LodChainOptions* options = chain->options;
+    std::vector<UINT>* output = &chain->lodIndices[meshIndex];
+
+    if (mesh->lodCount > 1 || mesh->pending)
+        return;
+
+    const Vertex* vertices = chain->vertices + mesh->baseVertex;
+    const UINT* source = chain->indices + mesh->lods[0].startIndex;
+    const UINT sourceCount = mesh->lods[0].indexCount;
+    const float extent = GetMeshExtent(source, sourceCount, vertices);
+
+    mesh->lods[0].error = 0.0f;
+    mesh->lodCount = 1;
+
+    const UINT maxLodCount = (std::min)(options->maxLodCount, MaxLodCount);
+    std::vector<UINT> previous(source, source + sourceCount);
+    std::vector<UINT> simplified(sourceCount);
+    float accumulatedError = 0.0f;
+
+    // Cada nvel parte do anterior; o erro acumulado  um limite superior da distncia at a malha original.
+    while (mesh->lodCount < maxLodCount && previous.size() > 3)
+    {
+        SimplifyOptions simplifyOptions;
+        simplifyOptions.targetRatio = options->ratioPerLevel;
+        simplifyOptions.targetError = options->maxError - accumulatedError;
+        simplifyOptions.colorWeight = options->colorWeight;
+        simplifyOptions.lockBorder = options->lockBorder;
+
+        if (simplifyOptions.targetError <= 0.0f)
+            break;
+
+        float levelError = 0.0f;
+        const UINT count = SimplifyMesh(simplified.data(), previous.data(), static_cast<UINT>(previous.size()), vertices, mesh->vertexCount, &simplifyOptions, &levelError);
+
+        if (count == 0 || count > previous.size() * 9 / 10)
+            break;
+
+        accumulatedError += levelError;
+
+        MeshLod* lod = &mesh->lods[mesh->lodCount++];
+        lod->startIndex = static_cast<UINT>(output->size());
+        lod->indexCount = count;
+        lod->error = accumulatedError * extent;
+
+        output->insert(output->end(), simplified.begin(), simplified.begin() + count);
+        previous.assign(simplified.begin(), simplified.begin() + count);
+    }
+}
+
+void BuildLodChains(JobSystem* jobSystem, Mesh* meshes, UINT meshCount, const Vertex* vertices, std::vector<UINT>* indices, const LodChainOptions* options)
+{
+    std::vector<std::vector<UINT>> lodIndices(meshCount);
+
+    LodChainContext context;
+    context.meshes = meshes;
+    context.vertices = vertices;
+    context.indices = indices->data();
+    context.options = options;
+    context.lodIndices = lodIndices.data();
+
+    ParallelFor(jobSystem, meshCount, BuildLodChainJob, &context);
+
+    for (UINT m = 0; m < meshCount; m++)
+    {
+        if (lodIndices[m].empty())
+            continue;
+
+        const UINT offset = static_cast<UINT>(indices->size());
+        indices->insert(indices->end(), lodIndices[m].begin(), lodIndices[m].end());
+
+        for (UINT lod = 1; lod < meshes[m].lodCount; lod++)
+        {
+            meshes[m].lods[lod].startIndex += offset;
+        }
+    }
+}
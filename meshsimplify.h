@@ -0,0 +1,38 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+#include <vector>
+
+struct SimplifyOptions
+{
+    float targetRatio;      // Frao dos ndices que deve restar (0..1).
+    float targetError;      // Erro mximo, relativo  maior dimenso da malha.
+    float colorWeight;      // Peso do erro de cor em relao ao erro geomtrico.
+    bool lockBorder;        // Vrtices de borda nunca so movidos.
+};
+
+struct LodChainOptions
+{
+    float ratioPerLevel;    // Frao de ndices mantida de um nvel para o prximo.
+    float maxError;         // Erro relativo mximo aceito para o ltimo nvel.
+    UINT maxLodCount;
+    float colorWeight;
+    bool lockBorder;
+};
+
+const SimplifyOptions DefaultSimplifyOptions = { 0.5f, 0.01f, 0.1f, false };
+const LodChainOptions DefaultLodChainOptions = { 0.5f, 0.05f, MaxLodCount, 0.1f, false };
+
+// Simplificao por mtrica de erro qudrico (Garland-Heckbert) com termo de cor. Os vrtices no so
+// alterados: o resultado  uma nova lista de ndices sobre os mesmos vrtices, portanto compatvel com o
+// vertex buffer e com o baseVertex da malha original. Retorna o nmero de ndices escritos em destination
+// (que deve comportar indexCount ndices). resultError recebe a maior distncia (mdia quadrtica, ponderada
+// pela rea, at os planos das faces fundidas) entre o resultado e indices, relativa  maior dimenso da malha.
+UINT SimplifyMesh(UINT* destination, const UINT* indices, UINT indexCount, const Vertex* vertices, UINT vertexCount, const SimplifyOptions* options, float* resultError);
+
+// Gera a cadeia de LODs de cada malha a partir de lods[0], em paralelo entre as malhas. Os ndices dos novos
+// nveis so anexados ao final de indices e as faixas so gravadas em meshes[i].lods. Malhas que j tm mais de
+// um nvel (vindas de um arquivo cozido) so mantidas.
+void BuildLodChains(JobSystem* jobSystem, Mesh* meshes, UINT meshCount, const Vertex* vertices, std::vector<UINT>* indices, const LodChainOptions* options);
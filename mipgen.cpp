@@ -0,0 +1,344 @@
+#include "mipgen.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Linhas do nvel de destino por job.
+const UINT MipBandRows = 32;
+
+// Sinc com janela de Kaiser, com KaiserWidth pixels do nvel de destino de suporte para cada lado.
+const float KaiserWidth = 3.0f;
+const float KaiserAlpha = 4.0f;
+
+// Entradas da tabela que leva um valor linear de 0 a 1 para sRGB em 8 bits. Mesmo perto do zero, onde a curva 
+// mais ngreme, o passo da tabela fica abaixo de 1/4 de um cdigo sRGB.
+const UINT LinearToSrgbTableSize = 16384;
+
+// Filtro 1D j amostrado: tapCount pixels de origem por pixel de destino, com a borda resolvida e os pesos
+// normalizados. Pixels com menos taps so completados com peso 0.
+struct MipFilterTaps
+{
+    UINT tapCount;
+    std::vector<UINT> sources;
+    std::vector<float> weights;
+};
+
+struct GenerateMipsContext
+{
+    const BYTE* source;
+    const MipLevel* sourceLevel;
+    BYTE* destination;
+    const MipLevel* destinationLevel;
+    const MipOptions* options;
+    const MipFilterTaps* horizontal;
+    const MipFilterTaps* vertical;
+    const float* toLinear;
+    const BYTE* linearToSrgb;
+};
+
+static float BesselI0(float x)
+{
+    // Srie de potncias; com x at KaiserAlpha, 20 termos sobram.
+    const float quarterSquared = x * x * 0.25f;
+    float term = 1.0f;
+    float sum = 1.0f;
+    for (UINT k = 1; k < 20; k++)
+    {
+        term *= quarterSquared / static_cast<float>(k * k);
+        sum += term;
+    }
+
+    return sum;
+}
+
+static float EvaluateKaiser(float t)
+{
+    if (fabsf(t) >= KaiserWidth)
+        return 0.0f;
+
+    const float sinc = (t == 0.0f) ? 1.0f : sinf(XM_PI * t) / (XM_PI * t);
+    const float ratio = t / KaiserWidth;
+
+    return sinc * BesselI0(KaiserAlpha * sqrtf(1.0f - ratio * ratio)) / BesselI0(KaiserAlpha);
+}
+
+static float SrgbToLinear(float value)
+{
+    return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float value)
+{
+    return (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static UINT ResolveBorder(int index, UINT size, bool wrap)
+{
+    if (wrap)
+    {
+        const int remainder = index % static_cast<int>(size);
+        return (remainder < 0) ? remainder + size : remainder;
+    }
+
+    return static_cast<UINT>((std::min)((std::max)(index, 0), static_cast<int>(size) - 1));
+}
+
+// O pixel de destino x cobre [x, x + 1) * scale na origem. A caixa pesa cada pixel de origem pela rea coberta;
+// o Kaiser  amostrado no centro de cada pixel de origem, com o suporte esticado por scale.
+static void BuildFilterTaps(UINT sourceSize, UINT destinationSize, const MipOptions* options, MipFilterTaps* taps)
+{
+    const bool box = options->filter == MipFilterBox;
+    const float scale = static_cast<float>(sourceSize) / destinationSize;
+    const float radius = GetMipFilterRadius(options->filter) * scale;
+
+    taps->tapCount = 0;
+    for (UINT x = 0; x < destinationSize; x++)
+    {
+        const float center = (x + 0.5f) * scale;
+        const int first = static_cast<int>(floorf(center - radius));
+        const int last = static_cast<int>(ceilf(center + radius)) - 1;
+        taps->tapCount = (std::max)(taps->tapCount, static_cast<UINT>(last - first + 1));
+    }
+
+    taps->sources.assign(static_cast<size_t>(destinationSize) * taps->tapCount, 0);
+    taps->weights.assign(static_cast<size_t>(destinationSize) * taps->tapCount, 0.0f);
+
+    for (UINT x = 0; x < destinationSize; x++)
+    {
+        const float center = (x + 0.5f) * scale;
+        const int first = static_cast<int>(floorf(center - radius));
+        const int last = static_cast<int>(ceilf(center + radius)) - 1;
+
+        UINT* sources = &taps->sources[static_cast<size_t>(x) * taps->tapCount];
+        float* weights = &taps->weights[static_cast<size_t>(x) * taps->tapCount];
+
+        float total = 0.0f;
+        for (UINT k = 0; k < taps->tapCount; k++)
+        {
+            const int source = first + static_cast<int>(k);
+            if (source > last)
+            {
+                sources[k] = sources[0];
+                continue;
+            }
+
+            float weight;
+            if (box)
+            {
+                const float coverage = (std::min)(source + 1.0f, center + radius) - (std::max)(static_cast<float>(source), center - radius);
+                weight = (std::max)(coverage, 0.0f);
+            }
+            else
+            {
+                weight = EvaluateKaiser((source + 0.5f - center) / scale);
+            }
+
+            sources[k] = ResolveBorder(source, sourceSize, options->wrap);
+            weights[k] = weight;
+            total += weight;
+        }
+
+        for (UINT k = 0; k < taps->tapCount; k++)
+        {
+            weights[k] /= total;
+        }
+    }
+}
+
+static void LoadLinearRow(const GenerateMipsContext* ctx, const BYTE* row, XMVECTOR* pixels)
+{
+    const float* toLinear = ctx->toLinear;
+    const bool premultiply = ctx->options->premultiplyAlpha;
+
+    for (UINT x = 0; x < ctx->sourceLevel->width; x++, row += 4)
+    {
+        XMVECTOR pixel = XMVectorSet(toLinear[row[0]], toLinear[row[1]], toLinear[row[2]], row[3] * (1.0f / 255.0f));
+        if (premultiply)
+            pixel = XMVectorSelect(pixel, XMVectorMultiply(pixel, XMVectorSplatW(pixel)), g_XMSelect1110);
+
+        pixels[x] = pixel;
+    }
+}
+
+static void FilterRow(const MipFilterTaps* taps, const XMVECTOR* sourcePixels, UINT width, XMVECTOR* output)
+{
+    const UINT tapCount = taps->tapCount;
+    const UINT* sources = taps->sources.data();
+    const float* weights = taps->weights.data();
+
+    for (UINT x = 0; x < width; x++, sources += tapCount, weights += tapCount)
+    {
+        XMVECTOR sum = XMVectorZero();
+        for (UINT k = 0; k < tapCount; k++)
+        {
+            sum = XMVectorMultiplyAdd(sourcePixels[sources[k]], XMVectorReplicate(weights[k]), sum);
+        }
+
+        output[x] = sum;
+    }
+}
+
+static void StoreEncodedPixel(const GenerateMipsContext* ctx, FXMVECTOR value, BYTE* output)
+{
+    // O Kaiser tem lobos negativos, ento a soma pode sair de [0, 1].
+    XMVECTOR pixel = XMVectorSaturate(value);
+
+    if (ctx->options->premultiplyAlpha)
+    {
+        // Pixels totalmente transparentes ficam com cor zero.
+        const XMVECTOR alpha = XMVectorSplatW(pixel);
+        const XMVECTOR color = XMVectorSaturate(XMVectorDivide(pixel, alpha));
+        const XMVECTOR visible = XMVectorGreater(alpha, XMVectorZero());
+        pixel = XMVectorSelect(pixel, XMVectorAndInt(color, visible), g_XMSelect1110);
+    }
+
+    XMFLOAT4A values;
+    if (ctx->linearToSrgb)
+    {
+        XMStoreFloat4A(&values, XMVectorMultiplyAdd(pixel, XMVectorReplicate(LinearToSrgbTableSize - 1.0f), g_XMOneHalf));
+        output[0] = ctx->linearToSrgb[static_cast<UINT>(values.x)];
+        output[1] = ctx->linearToSrgb[static_cast<UINT>(values.y)];
+        output[2] = ctx->linearToSrgb[static_cast<UINT>(values.z)];
+        output[3] = static_cast<BYTE>(XMVectorGetW(pixel) * 255.0f + 0.5f);
+        return;
+    }
+
+    XMStoreFloat4A(&values, XMVectorMultiplyAdd(pixel, XMVectorReplicate(255.0f), g_XMOneHalf));
+    output[0] = static_cast<BYTE>(values.x);
+    output[1] = static_cast<BYTE>(values.y);
+    output[2] = static_cast<BYTE>(values.z);
+    output[3] = static_cast<BYTE>(values.w);
+}
+
+// Filtra na horizontal s as linhas de origem que a faixa usa, uma vez cada, e depois combina essas linhas na
+// vertical para cada linha de destino.
+static void GenerateMipBandJob(void* context, UINT jobIndex)
+{
+    const GenerateMipsContext* ctx = reinterpret_cast<const GenerateMipsContext*>(context);
+    const MipLevel* sourceLevel = ctx->sourceLevel;
+    const MipLevel* destinationLevel = ctx->destinationLevel;
+    const MipFilterTaps* vertical = ctx->vertical;
+    const UINT tapCount = vertical->tapCount;
+    const UINT width = destinationLevel->width;
+
+    const UINT firstRow = jobIndex * MipBandRows;
+    const UINT endRow = (std::min)(firstRow + MipBandRows, destinationLevel->height);
+
+    std::vector<UINT> sourceRows(vertical->sources.begin() + static_cast<size_t>(firstRow) * tapCount, vertical->sources.begin() + static_cast<size_t>(endRow) * tapCount);
+    std::sort(sourceRows.begin(), sourceRows.end());
+    sourceRows.erase(std::unique(sourceRows.begin(), sourceRows.end()), sourceRows.end());
+
+    std::vector<XMVECTOR> sourcePixels(sourceLevel->width);
+    std::vector<XMVECTOR> filteredRows(sourceRows.size() * width);
+
+    for (size_t i = 0; i < sourceRows.size(); i++)
+    {
+        const BYTE* row = ctx->source + sourceLevel->offset + static_cast<size_t>(sourceRows[i]) * sourceLevel->rowPitch;
+        LoadLinearRow(ctx, row, sourcePixels.data());
+        FilterRow(ctx->horizontal, sourcePixels.data(), width, filteredRows.data() + i * width);
+    }
+
+    std::vector<const XMVECTOR*> rows(tapCount);
+    std::vector<XMVECTOR> weights(tapCount);
+
+    for (UINT y = firstRow; y < endRow; y++)
+    {
+        for (UINT k = 0; k < tapCount; k++)
+        {
+            const size_t index = static_cast<size_t>(y) * tapCount + k;
+            const size_t slot = std::lower_bound(sourceRows.begin(), sourceRows.end(), vertical->sources[index]) - sourceRows.begin();
+            rows[k] = filteredRows.data() + slot * width;
+            weights[k] = XMVectorReplicate(vertical->weights[index]);
+        }
+
+        BYTE* output = ctx->destination + destinationLevel->offset + static_cast<size_t>(y) * destinationLevel->rowPitch;
+        for (UINT x = 0; x < width; x++, output += 4)
+        {
+            XMVECTOR sum = XMVectorZero();
+            for (UINT k = 0; k < tapCount; k++)
+            {
+                sum = XMVectorMultiplyAdd(rows[k][x], weights[k], sum);
+            }
+
+            StoreEncodedPixel(ctx, sum, output);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+UINT GetMipLevelCount(UINT width, UINT height)
+{
+    UINT size = (std::max)(width, height);
+    UINT levelCount = 1;
+    while (size > 1)
+    {
+        size >>= 1;
+        levelCount++;
+    }
+
+    return levelCount;
+}
+
+float GetMipFilterRadius(MipFilter filter)
+{
+    return filter == MipFilterBox ? 0.5f : KaiserWidth;
+}
+
+UINT64 GetMipChainLayout(UINT width, UINT height, UINT levelCount, UINT rowAlignment, UINT levelAlignment, MipLevel* levels)
+{
+    UINT64 offset = 0;
+    UINT64 end = 0;
+    for (UINT i = 0; i < levelCount; i++)
+    {
+        MipLevel* level = &levels[i];
+        level->offset = (offset + levelAlignment - 1) & ~static_cast<UINT64>(levelAlignment - 1);
+        level->width = (std::max)(1u, width >> i);
+        level->height = (std::max)(1u, height >> i);
+        level->rowPitch = (level->width * 4 + rowAlignment - 1) & ~(rowAlignment - 1);
+
+        // Como em GetCopyableFootprints, a ltima linha no conta o preenchimento do pitch.
+        end = level->offset + static_cast<UINT64>(level->rowPitch) * (level->height - 1) + level->width * 4;
+        offset = level->offset + static_cast<UINT64>(level->rowPitch) * level->height;
+    }
+
+    return end;
+}
+
+void GenerateMips(JobSystem* jobSystem, BYTE* data, const MipLevel* levels, UINT levelCount, const MipOptions* options)
+{
+    float toLinear[256];
+    for (UINT i = 0; i < 256; i++)
+    {
+        toLinear[i] = options->srgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+    }
+
+    std::vector<BYTE> linearToSrgb;
+    if (options->srgb)
+    {
+        linearToSrgb.resize(LinearToSrgbTableSize);
+        for (UINT i = 0; i < LinearToSrgbTableSize; i++)
+        {
+            linearToSrgb[i] = static_cast<BYTE>(LinearToSrgb(i / (LinearToSrgbTableSize - 1.0f)) * 255.0f + 0.5f);
+        }
+    }
+
+    for (UINT level = 1; level < levelCount; level++)
+    {
+        MipFilterTaps horizontal, vertical;
+        BuildFilterTaps(levels[level - 1].width, levels[level].width, options, &horizontal);
+        BuildFilterTaps(levels[level - 1].height, levels[level].height, options, &vertical);
+
+        GenerateMipsContext context =
+        {
+            data, &levels[level - 1], data, &levels[level], options, &horizontal, &vertical,
+            toLinear, options->srgb ? linearToSrgb.data() : nullptr
+        };
+
+        ParallelFor(jobSystem, (levels[level].height + MipBandRows - 1) / MipBandRows, GenerateMipBandJob, &context);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+// Gerao de mips RGBA8 na CPU. Cada nvel sai do anterior por um filtro separvel (horizontal e depois
+// vertical) em espao linear, com os pixels como XMVECTOR RGBA. O nvel  dividido em faixas de linhas, uma por
+// job, e os nveis so processados em sequncia.
+//
+// Os nveis so escritos onde MipLevel manda: com rowAlignment = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT e
+// levelAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, GetMipChainLayout reproduz os footprints de
+// GetCopyableFootprints para RGBA8, e a cadeia pode ser gerada direto num upload buffer mapeado. Com 1 e 1 os
+// nveis ficam contguos, como no DDS.
+
+enum MipFilter
+{
+    MipFilterBox,
+    MipFilterKaiser
+};
+
+struct MipOptions
+{
+    MipFilter filter;
+    bool srgb;              // RGB em sRGB: decodificado para linear antes do filtro e codificado de volta.
+    bool premultiplyAlpha;  // Cor ponderada pelo alfa durante o filtro; a sada volta a ter alfa no multiplicado.
+    bool wrap;              // As bordas continuam no lado oposto (texturas que ladrilham) em vez de repetir a ltima linha.
+};
+
+const MipOptions DefaultMipOptions = { MipFilterKaiser, false, true, false };
+
+struct MipLevel
+{
+    UINT64 offset;
+    UINT width;
+    UINT height;
+    UINT rowPitch;
+};
+
+// Nveis da cadeia completa, at 1x1.
+UINT GetMipLevelCount(UINT width, UINT height);
+
+// Suporte do filtro para cada lado, em pixels do nvel de destino.
+float GetMipFilterRadius(MipFilter filter);
+
+// Preenche levels[0..levelCount) e devolve o tamanho total da cadeia. Os alinhamentos precisam ser potncias de 2.
+UINT64 GetMipChainLayout(UINT width, UINT height, UINT levelCount, UINT rowAlignment, UINT levelAlignment, MipLevel* levels);
+
+// data j traz o nvel 0 em levels[0]; os demais so sobrescritos. Cada nvel tem metade do tamanho do anterior
+// (arredondado para baixo, no mnimo 1).
+void GenerateMips(JobSystem* jobSystem, BYTE* data, const MipLevel* levels, UINT levelCount, const MipOptions* options);
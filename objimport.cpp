@@ -0,0 +1,487 @@
+#include "objimport.h"
+#include "mappedfile.h"
+#include "textparse.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <limits.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Cada job processa um pedao do arquivo, cortado no fim de linha seguinte.
+const UINT64 ObjChunkSize = 4 * 1024 * 1024;
+
+const XMFLOAT4 ObjDefaultColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+// Troca de objeto (o) ou de material (usemtl) a partir de um tringulo do pedao.
+struct ObjRun
+{
+    UINT firstTriangle;
+    bool isMaterial;
+    std::string name;
+};
+
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    UINT positionBase;
+    UINT positionCount;
+
+    std::vector<XMFLOAT3> positions;
+    // w < 0 quando a linha no tem cor; o vrtice usa a cor do material.
+    std::vector<XMFLOAT4> colors;
+    std::vector<UINT> triangles;
+    std::vector<ObjRun> runs;
+    std::string materialLibrary;
+
+    UINT triangleBase;
+    bool invalid;
+};
+
+struct ObjMeshRange
+{
+    UINT firstTriangle;
+    UINT triangleCount;
+    XMFLOAT4 color;
+
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+};
+
+struct ObjContext
+{
+    ObjChunk* chunks;
+    UINT chunkCount;
+    UINT positionCount;
+
+    ObjMeshRange* meshes;
+};
+
+// -----------------------------------------------------------------------------------------------------
+
+static inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while (p < end && IsBlank(*p))
+        p++;
+
+    return p;
+}
+
+static inline const char* NextLine(const char* p, const char* end)
+{
+    const char* newline = reinterpret_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+static inline const char* ParseName(const char* p, const char* end, std::string* name)
+{
+    p = SkipBlanks(p, end);
+
+    const char* nameEnd = p;
+    while (nameEnd < end && *nameEnd != '\n')
+        nameEnd++;
+    while (nameEnd > p && IsBlank(nameEnd[-1]))
+        nameEnd--;
+
+    name->assign(p, nameEnd);
+    return nameEnd;
+}
+
+static inline bool IsKeyword(const char* p, const char* end, const char* keyword, size_t length)
+{
+    return static_cast<size_t>(end - p) > length && memcmp(p, keyword, length) == 0 && IsBlank(p[length]);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Primeira passada: conta as posies de cada pedao, para resolver ndices negativos (relativos) j na leitura.
+static void CountPositionsJob(void* context, UINT chunkIndex)
+{
+    ObjContext* obj = reinterpret_cast<ObjContext*>(context);
+    ObjChunk* chunk = &obj->chunks[chunkIndex];
+
+    UINT count = 0;
+    for (const char* p = chunk->begin; p < chunk->end; p = NextLine(p, chunk->end))
+    {
+        p = SkipBlanks(p, chunk->end);
+        if (chunk->end - p > 1 && p[0] == 'v' && IsBlank(p[1]))
+            count++;
+    }
+
+    chunk->positionCount = count;
+}
+
+static void ParseChunkJob(void* context, UINT chunkIndex)
+{
+    ObjContext* obj = reinterpret_cast<ObjContext*>(context);
+    ObjChunk* chunk = &obj->chunks[chunkIndex];
+    const char* end = chunk->end;
+
+    chunk->positions.reserve(chunk->positionCount);
+    chunk->colors.reserve(chunk->positionCount);
+
+    std::vector<UINT> polygon;
+
+    for (const char* p = chunk->begin; p < end; p = NextLine(p, end))
+    {
+        p = SkipBlanks(p, end);
+        if (p == end)
+            break;
+
+        if (p[0] == 'v' && end - p > 1 && IsBlank(p[1]))
+        {
+            float values[7] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+            UINT valueCount = 0;
+
+            p += 2;
+            while (valueCount < _countof(values))
+            {
+                p = SkipBlanks(p, end);
+                const char* next = ParseFloat(p, end, &values[valueCount]);
+                if (next == p)
+                    break;
+
+                p = next;
+                valueCount++;
+            }
+
+            if (valueCount < 3)
+            {
+                chunk->invalid = true;
+                return;
+            }
+
+            chunk->positions.push_back(XMFLOAT3(values[0], values[1], values[2]));
+
+            // "v x y z r g b" (extenso comum em scans); "v x y z w" tem peso e no cor.
+            if (valueCount >= 6)
+                chunk->colors.push_back(XMFLOAT4(values[3], values[4], values[5], 1.0f));
+            else
+                chunk->colors.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, -1.0f));
+        }
+        else if (p[0] == 'f' && end - p > 1 && IsBlank(p[1]))
+        {
+            const UINT currentPosition = chunk->positionBase + static_cast<UINT>(chunk->positions.size());
+
+            polygon.clear();
+            p += 2;
+            for (;;)
+            {
+                p = SkipBlanks(p, end);
+
+                INT64 index;
+                const char* next = ParseInt(p, end, &index);
+                if (next == p)
+                    break;
+
+                // ndices de textura e normal (v/t, v//n, v/t/n) so pulados.
+                p = next;
+                while (p < end && (*p == '/' || *p == '-' || IsDigit(*p)))
+                    p++;
+
+                const INT64 position = (index < 0) ? static_cast<INT64>(currentPosition) + index : index - 1;
+                if (index == 0 || position < 0 || position >= obj->positionCount)
+                {
+                    chunk->invalid = true;
+                    return;
+                }
+
+                polygon.push_back(static_cast<UINT>(position));
+            }
+
+            // Polgonos convexos triangulados em leque.
+            for (UINT i = 2; i < polygon.size(); i++)
+            {
+                chunk->triangles.push_back(polygon[0]);
+                chunk->triangles.push_back(polygon[i - 1]);
+                chunk->triangles.push_back(polygon[i]);
+            }
+        }
+        else if (IsKeyword(p, end, "o", 1) || IsKeyword(p, end, "usemtl", 6))
+        {
+            ObjRun run;
+            run.firstTriangle = static_cast<UINT>(chunk->triangles.size() / 3);
+            run.isMaterial = (p[0] == 'u');
+            ParseName(p + (run.isMaterial ? 6 : 1), end, &run.name);
+            chunk->runs.push_back(run);
+        }
+        else if (IsKeyword(p, end, "mtllib", 6))
+        {
+            if (chunk->materialLibrary.empty())
+                ParseName(p + 6, end, &chunk->materialLibrary);
+        }
+    }
+}
+
+// Deduplica os vrtices de uma malha: cada posio usada vira um nico vrtice (a cor  a mesma na malha toda).
+static void BuildMeshJob(void* context, UINT meshIndex)
+{
+    ObjContext* obj = reinterpret_cast<ObjContext*>(context);
+    ObjMeshRange* mesh = &obj->meshes[meshIndex];
+
+    // Tabela de endereamento aberto, posio -> vrtice local, com no mximo 50% de ocupao.
+    const UINT maxVertexCount = (std::min)(mesh->triangleCount * 3, obj->positionCount);
+    size_t tableSize = 16;
+    while (tableSize < static_cast<size_t>(maxVertexCount) * 2)
+        tableSize *= 2;
+
+    std::vector<UINT> keys(tableSize, UINT_MAX);
+    std::vector<UINT> values(tableSize);
+    const size_t mask = tableSize - 1;
+
+    mesh->indices.resize(static_cast<size_t>(mesh->triangleCount) * 3);
+
+    UINT written = 0;
+    UINT triangle = mesh->firstTriangle;
+    const UINT lastTriangle = mesh->firstTriangle + mesh->triangleCount;
+
+    for (UINT c = 0; c < obj->chunkCount && triangle < lastTriangle; c++)
+    {
+        const ObjChunk* chunk = &obj->chunks[c];
+        const UINT chunkTriangleCount = static_cast<UINT>(chunk->triangles.size() / 3);
+        if (triangle >= chunk->triangleBase + chunkTriangleCount)
+            continue;
+
+        const UINT first = triangle - chunk->triangleBase;
+        const UINT last = (std::min)(lastTriangle - chunk->triangleBase, chunkTriangleCount);
+
+        for (UINT i = first * 3; i < last * 3; i++)
+        {
+            const UINT position = chunk->triangles[i];
+
+            // ndices de OBJ so densos e quase sequenciais: a identidade espalha bem e mantm a localidade.
+            size_t slot = position & mask;
+            while (keys[slot] != UINT_MAX && keys[slot] != position)
+                slot = (slot + 1) & mask;
+
+            if (keys[slot] == UINT_MAX)
+            {
+                // Posies podem estar em qualquer pedao anterior ou posterior do arquivo.
+                UINT owner = 0;
+                UINT low = 0, high = obj->chunkCount;
+                while (low < high)
+                {
+                    const UINT middle = (low + high) / 2;
+                    if (obj->chunks[middle].positionBase <= position)
+                    {
+                        owner = middle;
+                        low = middle + 1;
+                    }
+                    else
+                    {
+                        high = middle;
+                    }
+                }
+
+                const ObjChunk* positionChunk = &obj->chunks[owner];
+                const UINT local = position - positionChunk->positionBase;
+
+                Vertex vertex;
+                vertex.position = positionChunk->positions[local];
+                vertex.color = (positionChunk->colors[local].w < 0.0f) ? mesh->color : positionChunk->colors[local];
+
+                keys[slot] = position;
+                values[slot] = static_cast<UINT>(mesh->vertices.size());
+                mesh->vertices.push_back(vertex);
+            }
+
+            mesh->indices[written++] = values[slot];
+        }
+
+        triangle = chunk->triangleBase + last;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static void LoadMaterials(const std::wstring& path, std::unordered_map<std::string, XMFLOAT4>* materials)
+{
+    MappedFile file;
+    if (FAILED(OpenMappedFile(path.c_str(), &file)))
+        return;
+
+    const char* p = reinterpret_cast<const char*>(file.data);
+    const char* end = p + file.size;
+
+    XMFLOAT4* current = nullptr;
+    for (; p < end; p = NextLine(p, end))
+    {
+        p = SkipBlanks(p, end);
+
+        if (IsKeyword(p, end, "newmtl", 6))
+        {
+            std::string name;
+            ParseName(p + 6, end, &name);
+            current = &(*materials)[name];
+            *current = ObjDefaultColor;
+        }
+        else if (current && IsKeyword(p, end, "Kd", 2))
+        {
+            p = SkipBlanks(p + 3, end);
+            p = SkipBlanks(ParseFloat(p, end, &current->x), end);
+            p = SkipBlanks(ParseFloat(p, end, &current->y), end);
+            ParseFloat(p, end, &current->z);
+        }
+        else if (current && IsKeyword(p, end, "d", 1))
+        {
+            ParseFloat(SkipBlanks(p + 2, end), end, &current->w);
+        }
+    }
+
+    CloseMappedFile(&file);
+}
+
+void ImportObj(JobSystem* jobSystem, const wchar_t* path, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes)
+{
+    MappedFile file;
+    ThrowIfFailed(OpenMappedFile(path, &file));
+
+    const char* data = reinterpret_cast<const char*>(file.data);
+    const char* dataEnd = data + file.size;
+
+    // Pedaos cortados no incio de linha.
+    std::vector<ObjChunk> chunks;
+    for (const char* p = data; p < dataEnd;)
+    {
+        const char* chunkEnd = (static_cast<UINT64>(dataEnd - p) > ObjChunkSize) ? NextLine(p + ObjChunkSize, dataEnd) : dataEnd;
+
+        ObjChunk chunk;
+        chunk.begin = p;
+        chunk.end = chunkEnd;
+        chunk.positionBase = 0;
+        chunk.positionCount = 0;
+        chunk.triangleBase = 0;
+        chunk.invalid = false;
+        chunks.push_back(chunk);
+
+        p = chunkEnd;
+    }
+
+    ObjContext context;
+    context.chunks = chunks.data();
+    context.chunkCount = static_cast<UINT>(chunks.size());
+    context.meshes = nullptr;
+
+    ParallelFor(jobSystem, context.chunkCount, CountPositionsJob, &context);
+
+    UINT64 positionCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = static_cast<UINT>(positionCount);
+        positionCount += chunk.positionCount;
+    }
+
+    if (positionCount >= UINT_MAX)
+    {
+        CloseMappedFile(&file);
+        ThrowIfFailed(E_OUTOFMEMORY);
+    }
+
+    context.positionCount = static_cast<UINT>(positionCount);
+    ParallelFor(jobSystem, context.chunkCount, ParseChunkJob, &context);
+
+    // As linhas j foram copiadas para os pedaos; nomes e materiais vivem em std::string.
+    CloseMappedFile(&file);
+
+    UINT64 triangleCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        if (chunk.invalid)
+            ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+
+        chunk.triangleBase = static_cast<UINT>(triangleCount);
+        triangleCount += chunk.triangles.size() / 3;
+    }
+
+    if (triangleCount * 3 >= UINT_MAX)
+        ThrowIfFailed(E_OUTOFMEMORY);
+
+    std::unordered_map<std::string, XMFLOAT4> materials;
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (chunk.materialLibrary.empty())
+            continue;
+
+        // mtllib  relativo ao diretrio do OBJ.
+        std::wstring materialPath(path);
+        const size_t slash = materialPath.find_last_of(L"\\/");
+        materialPath.resize(slash == std::wstring::npos ? 0 : slash + 1);
+        const int nameLength = static_cast<int>(chunk.materialLibrary.size());
+        std::wstring name(MultiByteToWideChar(CP_UTF8, 0, chunk.materialLibrary.c_str(), nameLength, nullptr, 0), L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, chunk.materialLibrary.c_str(), nameLength, &name[0], static_cast<int>(name.size()));
+        materialPath.append(name);
+
+        LoadMaterials(materialPath, &materials);
+        break;
+    }
+
+    // Cada pedao continua o objeto e o material em que o anterior terminou.
+    std::vector<ObjMeshRange> ranges;
+    std::string object;
+    std::string material;
+
+    auto beginRange = [&](UINT firstTriangle)
+    {
+        if (!ranges.empty() && ranges.back().firstTriangle == firstTriangle)
+            ranges.pop_back();
+
+        auto color = materials.find(material);
+
+        ObjMeshRange range;
+        range.firstTriangle = firstTriangle;
+        range.triangleCount = 0;
+        range.color = (color != materials.end()) ? color->second : ObjDefaultColor;
+        ranges.push_back(range);
+    };
+
+    beginRange(0);
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const ObjRun& run : chunk.runs)
+        {
+            std::string* current = run.isMaterial ? &material : &object;
+            if (*current == run.name)
+                continue;
+
+            *current = run.name;
+            beginRange(chunk.triangleBase + run.firstTriangle);
+        }
+    }
+
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        const UINT nextTriangle = (i + 1 < ranges.size()) ? ranges[i + 1].firstTriangle : static_cast<UINT>(triangleCount);
+        ranges[i].triangleCount = nextTriangle - ranges[i].firstTriangle;
+    }
+
+    context.meshes = ranges.data();
+    ParallelFor(jobSystem, static_cast<UINT>(ranges.size()), BuildMeshJob, &context);
+
+    for (const ObjMeshRange& range : ranges)
+    {
+        if (range.triangleCount == 0)
+            continue;
+
+        if (vertices->size() + range.vertices.size() > MaxVertexCount)
+            ThrowIfFailed(E_OUTOFMEMORY);
+
+        Mesh mesh = {};
+        mesh.baseVertex = static_cast<UINT>(vertices->size());
+        mesh.vertexCount = static_cast<UINT>(range.vertices.size());
+        mesh.lods[0] = { static_cast<UINT>(indices->size()), static_cast<UINT>(range.indices.size()), 0.0f };
+        mesh.lodCount = 1;
+        meshes->push_back(mesh);
+
+        vertices->insert(vertices->end(), range.vertices.begin(), range.vertices.end());
+        indices->insert(indices->end(), range.indices.begin(), range.indices.end());
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+#include <vector>
+
+// Importa um arquivo Wavefront OBJ (e o MTL referenciado por mtllib). Cada sequncia de faces com o mesmo
+// objeto (o) e material (usemtl) vira uma malha anexada a meshes, com os vrtices deduplicados anexados a
+// vertices e os ndices (relativos a baseVertex) anexados a indices. A cor do vrtice vem das cores estendidas
+// de "v x y z r g b" ou do Kd/d do material. Normais e coordenadas de textura so ignoradas.
+void ImportObj(JobSystem* jobSystem, const wchar_t* path, std::vector<Vertex>* vertices, std::vector<UINT>* indices, std::vector<Mesh>* meshes);
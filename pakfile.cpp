@@ -0,0 +1,329 @@
+#include "pakfile.h"
+#include "lz4.h"
+#include "zstd.h"
+
+#include <string.h>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------
+
+static bool IsTableValid(UINT64 fileSize, UINT64 offset, UINT64 count, UINT64 elementSize)
+{
+    return offset % 8 == 0 && offset <= fileSize && count * elementSize <= fileSize - offset;
+}
+
+HRESULT OpenPak(const wchar_t* path, Pak* pak)
+{
+    pak->header = nullptr;
+    pak->entries = nullptr;
+    pak->blocks = nullptr;
+
+    HRESULT hr = OpenMappedFile(path, &pak->file);
+    if (FAILED(hr))
+        return hr;
+
+    const UINT64 fileSize = pak->file.size;
+    const PakHeader* header = reinterpret_cast<const PakHeader*>(pak->file.data);
+
+    bool valid =
+        fileSize >= sizeof(PakHeader) &&
+        header->magic == PakMagic &&
+        header->version == PakVersion &&
+        header->blockSize > 0 && header->blockSize <= 16 * 1024 * 1024 &&
+        header->fileSize == fileSize &&
+        IsTableValid(fileSize, header->entryOffset, header->entryCount, sizeof(PakEntry)) &&
+        IsTableValid(fileSize, header->blockOffset, header->blockCount, sizeof(PakBlock));
+
+    const PakEntry* entries = valid ? reinterpret_cast<const PakEntry*>(pak->file.data + header->entryOffset) : nullptr;
+    const PakBlock* blocks = valid ? reinterpret_cast<const PakBlock*>(pak->file.data + header->blockOffset) : nullptr;
+
+    for (UINT i = 0; valid && i < header->entryCount; i++)
+    {
+        const PakEntry* entry = &entries[i];
+        valid = memchr(entry->name, 0, MaxPakNameLength) != nullptr &&
+            entry->firstBlock <= header->blockCount && entry->blockCount <= header->blockCount - entry->firstBlock &&
+            entry->blockCount == (entry->size + header->blockSize - 1) / header->blockSize;
+
+        for (UINT b = 0; valid && b < entry->blockCount; b++)
+        {
+            const PakBlock* block = &blocks[entry->firstBlock + b];
+            const UINT64 blockBegin = static_cast<UINT64>(b) * header->blockSize;
+            const UINT64 blockSize = (entry->size - blockBegin < header->blockSize) ? entry->size - blockBegin : header->blockSize;
+
+            valid = block->offset <= fileSize && block->compressedSize <= fileSize - block->offset &&
+                ((block->codec == PakCodecNone && block->compressedSize == blockSize) || block->codec == PakCodecLz4 || block->codec == PakCodecZstd);
+        }
+    }
+
+    if (!valid)
+    {
+        CloseMappedFile(&pak->file);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    pak->header = header;
+    pak->entries = entries;
+    pak->blocks = blocks;
+
+    return S_OK;
+}
+
+void ClosePak(Pak* pak)
+{
+    CloseMappedFile(&pak->file);
+
+    pak->header = nullptr;
+    pak->entries = nullptr;
+    pak->blocks = nullptr;
+}
+
+const PakEntry* FindPakEntry(const Pak* pak, const char* name)
+{
+    for (UINT i = 0; i < pak->header->entryCount; i++)
+    {
+        if (strcmp(pak->entries[i].name, name) == 0)
+            return &pak->entries[i];
+    }
+
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct ReadPakContext
+{
+    const Pak* pak;
+    const PakEntry* entry;
+    UINT64 offset;
+    UINT64 size;
+    BYTE* destination;
+    UINT firstBlock;
+
+    volatile LONG failedBlockCount;
+};
+
+bool DecompressPakBlock(const PakBlock* block, const BYTE* source, BYTE* destination, UINT size)
+{
+    switch (block->codec)
+    {
+    case PakCodecNone:
+        memcpy(destination, source, size);
+        return true;
+
+    case PakCodecZstd:
+        return DecompressZstd(destination, size, source, block->compressedSize);
+
+    default:
+        return DecompressLz4(destination, size, source, block->compressedSize);
+    }
+}
+
+static void ReadPakBlockJob(void* context, UINT jobIndex)
+{
+    ReadPakContext* ctx = reinterpret_cast<ReadPakContext*>(context);
+    const UINT blockSize = ctx->pak->header->blockSize;
+    const UINT blockIndex = ctx->firstBlock + jobIndex;
+    const PakBlock* block = &ctx->pak->blocks[ctx->entry->firstBlock + blockIndex];
+
+    const UINT64 blockBegin = static_cast<UINT64>(blockIndex) * blockSize;
+    const UINT blockLength = static_cast<UINT>((ctx->entry->size - blockBegin < blockSize) ? ctx->entry->size - blockBegin : blockSize);
+
+    // Interseo do bloco com a faixa pedida.
+    const UINT64 begin = (blockBegin > ctx->offset) ? blockBegin : ctx->offset;
+    const UINT64 end = (blockBegin + blockLength < ctx->offset + ctx->size) ? blockBegin + blockLength : ctx->offset + ctx->size;
+    BYTE* destination = ctx->destination + (begin - ctx->offset);
+
+    bool decompressed;
+    if (begin == blockBegin && end == blockBegin + blockLength)
+    {
+        decompressed = DecompressPakBlock(block, ctx->pak->file.data + block->offset, destination, blockLength);
+    }
+    else
+    {
+        // S os blocos das pontas da faixa passam por um buffer temporrio.
+        std::vector<BYTE> scratch(blockLength);
+        decompressed = DecompressPakBlock(block, ctx->pak->file.data + block->offset, scratch.data(), blockLength);
+        if (decompressed)
+            memcpy(destination, scratch.data() + (begin - blockBegin), static_cast<size_t>(end - begin));
+    }
+
+    if (!decompressed)
+        InterlockedIncrement(&ctx->failedBlockCount);
+}
+
+bool ReadPakEntry(JobSystem* jobSystem, const Pak* pak, const PakEntry* entry, UINT64 offset, UINT64 size, void* destination)
+{
+    if (offset > entry->size || size > entry->size - offset)
+        return false;
+
+    if (size == 0)
+        return true;
+
+    const UINT blockSize = pak->header->blockSize;
+
+    ReadPakContext context;
+    context.pak = pak;
+    context.entry = entry;
+    context.offset = offset;
+    context.size = size;
+    context.destination = reinterpret_cast<BYTE*>(destination);
+    context.firstBlock = static_cast<UINT>(offset / blockSize);
+    context.failedBlockCount = 0;
+
+    const UINT lastBlock = static_cast<UINT>((offset + size - 1) / blockSize);
+    ParallelFor(jobSystem, lastBlock - context.firstBlock + 1, ReadPakBlockJob, &context);
+
+    return context.failedBlockCount == 0;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct CompressPakContext
+{
+    const BYTE* data;
+    UINT64 size;
+
+    std::vector<BYTE>* outputs;
+    UINT* codecs;
+};
+
+static void CompressPakBlockJob(void* context, UINT jobIndex)
+{
+    CompressPakContext* ctx = reinterpret_cast<CompressPakContext*>(context);
+    const UINT64 blockBegin = static_cast<UINT64>(jobIndex) * PakBlockSize;
+    const UINT blockLength = static_cast<UINT>((ctx->size - blockBegin < PakBlockSize) ? ctx->size - blockBegin : PakBlockSize);
+    const BYTE* source = ctx->data + blockBegin;
+
+    std::vector<BYTE>* output = &ctx->outputs[jobIndex];
+    output->resize(GetLz4CompressBound(blockLength));
+
+    std::vector<BYTE> zstdOutput(static_cast<size_t>(GetZstdCompressBound(blockLength)));
+
+    const UINT lz4Size = CompressLz4(output->data(), static_cast<UINT>(output->size()), source, blockLength);
+    const UINT zstdSize = static_cast<UINT>(CompressZstd(zstdOutput.data(), zstdOutput.size(), source, blockLength));
+
+    // Blocos que quase no comprimem so guardados como esto: a cpia  mais barata que a descompresso. O Zstd
+    // descomprime umas quatro vezes mais devagar que o LZ4 e s entra quando economiza um oitavo do que sobraria.
+    UINT codec = PakCodecNone;
+    UINT size = blockLength;
+    if (lz4Size != 0 && lz4Size <= blockLength - blockLength / 16)
+    {
+        codec = PakCodecLz4;
+        size = lz4Size;
+    }
+
+    if (zstdSize != 0 && zstdSize <= size - size / 8)
+    {
+        output->swap(zstdOutput);
+        codec = PakCodecZstd;
+        size = zstdSize;
+    }
+
+    if (codec == PakCodecNone)
+        output->assign(source, source + blockLength);
+    else
+        output->resize(size);
+
+    ctx->codecs[jobIndex] = codec;
+}
+
+static UINT64 AlignPakOffset(UINT64 offset, UINT64 alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static HRESULT AddPakEntry(JobSystem* jobSystem, HANDLE file, UINT64* position, const wchar_t* path, std::vector<PakEntry>* entries, std::vector<PakBlock>* blocks)
+{
+    PakEntry entry = {};
+
+    const wchar_t* name = path;
+    for (const wchar_t* c = path; *c; c++)
+    {
+        if (*c == L'\\' || *c == L'/')
+            name = c + 1;
+    }
+
+    if (WideCharToMultiByte(CP_UTF8, 0, name, -1, entry.name, MaxPakNameLength, nullptr, nullptr) == 0)
+        return E_INVALIDARG;
+
+    MappedFile source;
+    HRESULT hr = OpenMappedFile(path, &source);
+    if (FAILED(hr))
+        return hr;
+
+    entry.size = source.size;
+    entry.firstBlock = static_cast<UINT>(blocks->size());
+    entry.blockCount = static_cast<UINT>((source.size + PakBlockSize - 1) / PakBlockSize);
+
+    std::vector<std::vector<BYTE>> outputs(entry.blockCount);
+    std::vector<UINT> codecs(entry.blockCount);
+
+    CompressPakContext context = { source.data, source.size, outputs.data(), codecs.data() };
+    ParallelFor(jobSystem, entry.blockCount, CompressPakBlockJob, &context);
+
+    CloseMappedFile(&source);
+
+    for (UINT b = 0; b < entry.blockCount; b++)
+    {
+        PakBlock block;
+        block.offset = AlignPakOffset(*position, PakAlignment);
+        block.compressedSize = static_cast<UINT>(outputs[b].size());
+        block.codec = codecs[b];
+
+        if (!WriteFileSection(file, position, block.offset, outputs[b].data(), outputs[b].size()))
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        blocks->push_back(block);
+    }
+
+    entries->push_back(entry);
+
+    return S_OK;
+}
+
+HRESULT SavePak(JobSystem* jobSystem, const wchar_t* path, const wchar_t* const* files, UINT fileCount)
+{
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    // Os arquivos so comprimidos um de cada vez e os ndices vo no fim. O cabealho comea zerado e  regravado
+    // no final, quando os offsets so conhecidos.
+    std::vector<PakEntry> entries;
+    std::vector<PakBlock> blocks;
+    PakHeader header = {};
+    UINT64 position = 0;
+
+    HRESULT hr = WriteFileSection(file, &position, 0, &header, sizeof(header)) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    for (UINT i = 0; i < fileCount && SUCCEEDED(hr); i++)
+    {
+        hr = AddPakEntry(jobSystem, file, &position, files[i], &entries, &blocks);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        header.magic = PakMagic;
+        header.version = PakVersion;
+        header.entryCount = static_cast<UINT>(entries.size());
+        header.blockCount = static_cast<UINT>(blocks.size());
+        header.blockSize = PakBlockSize;
+        header.entryOffset = AlignPakOffset(position, 64);
+        header.blockOffset = header.entryOffset + entries.size() * sizeof(PakEntry);
+        header.fileSize = header.blockOffset + blocks.size() * sizeof(PakBlock);
+
+        UINT64 headerPosition = 0;
+        LARGE_INTEGER start = {};
+        const bool written =
+            WriteFileSection(file, &position, header.entryOffset, entries.data(), entries.size() * sizeof(PakEntry)) &&
+            WriteFileSection(file, &position, header.blockOffset, blocks.data(), blocks.size() * sizeof(PakBlock)) &&
+            SetFilePointerEx(file, start, nullptr, FILE_BEGIN) &&
+            WriteFileSection(file, &headerPosition, 0, &header, sizeof(header));
+
+        if (!written)
+            hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    CloseHandle(file);
+
+    return hr;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+#include "mappedfile.h"
+
+// Pacote de assets (.pak) gerado pelo Cooker. Cada asset  dividido em blocos de PakBlockSize bytes comprimidos
+// de forma independente (LZ4, Zstd quando fica bem menor, ou sem compresso quando no compensa), o que permite
+// descomprimir os blocos em paralelo e ler qualquer faixa do asset sem passar pelo incio.
+//
+//   PakHeader | blocos (cada um alinhado a PakAlignment) | PakEntry[entryCount] | PakBlock[blockCount]
+
+const UINT PakMagic = 0x4B415049;           // "IPAK"
+const UINT PakVersion = 1;
+const UINT PakBlockSize = 256 * 1024;
+
+// Blocos comeam em fronteira de setor: podem ser lidos sem o cache do sistema.
+const UINT PakAlignment = 4096;
+
+const UINT MaxPakNameLength = 48;
+
+enum PakCodec
+{
+    PakCodecNone,
+    PakCodecLz4,
+    PakCodecZstd
+};
+
+struct PakHeader
+{
+    UINT magic;
+    UINT version;
+    UINT entryCount;
+    UINT blockCount;
+    UINT blockSize;
+    UINT reserved[3];
+
+    UINT64 entryOffset;
+    UINT64 blockOffset;
+    UINT64 fileSize;
+    UINT64 reserved2;
+};
+
+// Nome em UTF-8, terminado em zero.
+struct PakEntry
+{
+    char name[MaxPakNameLength];
+    UINT64 size;
+    UINT firstBlock;
+    UINT blockCount;
+};
+
+// O tamanho descomprimido  blockSize, exceto no ltimo bloco de cada asset.
+struct PakBlock
+{
+    UINT64 offset;
+    UINT compressedSize;
+    UINT codec;
+};
+
+static_assert(sizeof(PakHeader) == 64, "PakHeader deve ocupar uma linha de cache");
+static_assert(sizeof(PakEntry) == 64, "PakEntry deve ocupar uma linha de cache");
+
+struct Pak
+{
+    MappedFile file;
+
+    const PakHeader* header;
+    const PakEntry* entries;
+    const PakBlock* blocks;
+};
+
+// Valida o ndice inteiro na abertura; as leituras seguintes s verificam o contedo dos blocos.
+HRESULT OpenPak(const wchar_t* path, Pak* pak);
+void ClosePak(Pak* pak);
+
+const PakEntry* FindPakEntry(const Pak* pak, const char* name);
+
+// Descomprime a faixa [offset, offset + size) do asset em destination, um job por bloco. Blocos inteiros so
+// descomprimidos direto no destino. Devolve false se algum bloco estiver corrompido.
+bool ReadPakEntry(JobSystem* jobSystem, const Pak* pak, const PakEntry* entry, UINT64 offset, UINT64 size, void* destination);
+
+// Descomprime um bloco j lido (source aponta para os compressedSize bytes do bloco) com size bytes descomprimidos.
+bool DecompressPakBlock(const PakBlock* block, const BYTE* source, BYTE* destination, UINT size);
+
+// Empacota os arquivos, cada um com o nome do arquivo sem o diretrio. Os blocos so comprimidos em paralelo.
+HRESULT SavePak(JobSystem* jobSystem, const wchar_t* path, const wchar_t* const* files, UINT fileCount);
@@ -0,0 +1,45 @@
+#include "release.h"
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitReleaseQueue(ReleaseQueue* queue)
+{
+    queue->pending.clear();
+    queue->releasedCount = 0;
+}
+
+void DeferRelease(ReleaseQueue* queue, UINT64 fenceValue, LPRELEASEFUNC release, void* context, void* object)
+{
+    queue->pending.push_back({ fenceValue, release, context, object });
+}
+
+UINT ProcessReleases(ReleaseQueue* queue, UINT64 completedFenceValue)
+{
+    UINT releasedCount = 0;
+
+    while (!queue->pending.empty() && queue->pending.front().fenceValue <= completedFenceValue)
+    {
+        // A entrada sai da fila antes da chamada, que pode adiar outras liberaes.
+        const DeferredRelease entry = queue->pending.front();
+        queue->pending.pop_front();
+
+        entry.release(entry.context, entry.object);
+        releasedCount++;
+    }
+
+    queue->releasedCount += releasedCount;
+
+    return releasedCount;
+}
+
+void FlushReleases(ReleaseQueue* queue)
+{
+    while (!queue->pending.empty())
+    {
+        const DeferredRelease entry = queue->pending.front();
+        queue->pending.pop_front();
+
+        entry.release(entry.context, entry.object);
+        queue->releasedCount++;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <deque>
+
+// Liberao adiada de objetos que a GPU ainda pode estar usando. Cada objeto entra na fila com o valor do fence
+// que a fila da GPU sinaliza depois do ltimo uso dele; ProcessReleases libera de uma vez todos os que o fence j
+// passou. Nada espera a GPU: o que ainda no terminou fica para a prxima chamada.
+//
+// Os valores s crescem, ento a fila fica em ordem e basta olhar o comeo. Um valor fora de ordem s atrasa a
+// liberao, nunca adianta.
+
+typedef void(*LPRELEASEFUNC) (void* context, void* object);
+
+struct DeferredRelease
+{
+    UINT64 fenceValue;
+    LPRELEASEFUNC release;
+    void* context;
+    void* object;
+};
+
+struct ReleaseQueue
+{
+    std::deque<DeferredRelease> pending;
+    UINT64 releasedCount;
+};
+
+void InitReleaseQueue(ReleaseQueue* queue);
+
+void DeferRelease(ReleaseQueue* queue, UINT64 fenceValue, LPRELEASEFUNC release, void* context, void* object);
+
+// Libera os objetos cujo fence j foi alcanado e devolve quantos foram.
+UINT ProcessReleases(ReleaseQueue* queue, UINT64 completedFenceValue);
+
+// Libera tudo. S pode ser chamada com a GPU parada.
+void FlushReleases(ReleaseQueue* queue);
@@ -5,10 +5,91 @@ cbuffer SceneConstantBuffer : register(b0)
     float4x4 projection;
 };
 
+// Mesmo layout de GpuMaterial (materials.h).
+struct Material
+{
+    uint baseColor;
+    uint emissive;
+    float emissiveStrength;
+    uint metallicRoughness;
+    uint flags;
+    uint2 textures;
+    uint reserved;
+};
+
+static const uint MaterialAlphaTest = 1;
+static const uint MaterialNoTexture = 0xFFFF;
+
+cbuffer DrawConstants : register(b1)
+{
+    uint materialIndex;
+};
+
+StructuredBuffer<Material> materials : register(t0);
+
+// Mesmo layout de ShadowConstantBuffer (infinity.cpp).
+static const uint MaxShadowCascades = 4;
+static const float ShadowDarkness = 0.4f;
+
+cbuffer ShadowConstantBuffer : register(b2)
+{
+    float4x4 cascadeViewProjection[MaxShadowCascades];
+    float4 cascadeSplits;
+    uint cascadeCount;
+};
+
+// Cascata desenhada pelo shadow pass.
+cbuffer ShadowCascadeConstants : register(b3)
+{
+    uint cascadeIndex;
+};
+
+Texture2DArray<float> shadowMap : register(t1);
+SamplerComparisonState shadowSampler : register(s0);
+
+// Mesmo layout de LightConstantBuffer (infinity.cpp) e de LocalLight (infinity.h).
+cbuffer LightConstantBuffer : register(b4)
+{
+    float3 cameraPosition;
+    float sliceScale;
+    float2 tileScale;
+    float sliceBias;
+    uint tilesX;
+    uint tilesY;
+    uint slices;
+};
+
+struct LocalLight
+{
+    float3 position;
+    float range;
+    float3 direction;
+    float spotCosOuter;
+    float3 color;
+    float spotCosInner;
+};
+
+static const float SpecularStrength = 0.5f;
+
+StructuredBuffer<LocalLight> lights : register(t2);
+StructuredBuffer<uint2> lightClusters : register(t3);       // Incio e tamanho da lista em lightIndices.
+StructuredBuffer<uint> lightIndices : register(t4);
+
+// Texturas de todos os materiais, indexadas por Material.textures. Amostradas quando os vrtices tiverem
+// coordenadas de textura.
+Texture2D materialTextures[] : register(t0, space1);
+
+float4 UnpackUnorm4(uint value)
+{
+    return float4(value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24) / 255.0f;
+}
+
 struct PSInput
 {
     float4 position : SV_POSITION;
     float4 color : COLOR;
+    float3 worldPosition : TEXCOORD0;
+    float viewDepth : TEXCOORD1;
 };
 
 PSInput VSMain(float3 position : POSITION, float4 color : COLOR)
@@ -18,7 +99,11 @@ PSInput VSMain(float3 position : POSITION, float4 color : COLOR)
     float4 newPosition = float4(position, 1.0f);
 
     newPosition = mul(model, newPosition);
+    result.worldPosition = newPosition.xyz;
+
     newPosition = mul(view, newPosition);
+    result.viewDepth = newPosition.z;
+
     newPosition = mul(projection, newPosition);
 
     result.position = newPosition;
@@ -28,7 +113,86 @@ PSInput VSMain(float3 position : POSITION, float4 color : COLOR)
     return result;
 }
 
+float4 VSShadow(float3 position : POSITION) : SV_POSITION
+{
+    return mul(cascadeViewProjection[cascadeIndex], mul(model, float4(position, 1.0f)));
+}
+
+// 1 iluminado, 0 na sombra. Usa a primeira cascata que cobre a profundidade do pixel; alm da ltima, no h
+// sombra.
+float SampleShadow(float3 worldPosition, float viewDepth)
+{
+    for (uint i = 0; i < cascadeCount; i++)
+    {
+        if (viewDepth < cascadeSplits[i])
+        {
+            float4 shadowPosition = mul(cascadeViewProjection[i], float4(worldPosition, 1.0f));
+            float2 uv = shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+            return shadowMap.SampleCmpLevelZero(shadowSampler, float3(uv, i), shadowPosition.z);
+        }
+    }
+
+    return 1.0f;
+}
+
+// Modelo de Phong com as luzes do cluster do pixel. Os vrtices ainda no tm normais: a normal  a da face,
+// pelas derivadas da posio, virada para a cmera.
+void ShadeLocalLights(float3 worldPosition, float viewDepth, float2 pixel, float shininess, out float3 diffuse, out float3 specular)
+{
+    diffuse = 0.0f;
+    specular = 0.0f;
+
+    float3 normal = normalize(cross(ddx(worldPosition), ddy(worldPosition)));
+    float3 toCamera = normalize(cameraPosition - worldPosition);
+    if (dot(normal, toCamera) < 0.0f)
+        normal = -normal;
+
+    uint2 tile = min(uint2(pixel * tileScale), uint2(tilesX - 1, tilesY - 1));
+    uint slice = uint(clamp(floor(log(viewDepth) * sliceScale + sliceBias), 0.0f, slices - 1.0f));
+    uint2 cluster = lightClusters[(slice * tilesY + tile.y) * tilesX + tile.x];
+
+    for (uint i = 0; i < cluster.y; i++)
+    {
+        LocalLight light = lights[lightIndices[cluster.x + i]];
+
+        float3 toLight = light.position - worldPosition;
+        float distance = length(toLight);
+        toLight /= max(distance, 1e-4f);
+
+        // Cai suavemente at zero no alcance; nos spots, tambm entre o cone interno e o externo.
+        float falloff = saturate(1.0f - pow(distance / light.range, 4.0f));
+        float attenuation = falloff * falloff / (distance * distance + 1.0f);
+        if (light.spotCosOuter > -1.0f)
+            attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, dot(-toLight, light.direction));
+
+        float lambert = saturate(dot(normal, toLight));
+        float3 reflected = reflect(-toLight, normal);
+
+        diffuse += light.color * (lambert * attenuation);
+        specular += light.color * (pow(saturate(dot(reflected, toCamera)), shininess) * attenuation * (lambert > 0.0f ? SpecularStrength : 0.0f));
+    }
+}
+
 float4 PSMain(PSInput input) : SV_TARGET
 {
-    return input.color; //input.color;
+    Material material = materials[materialIndex];
+
+    float4 color = input.color * UnpackUnorm4(material.baseColor);
+
+    float4 emissive = UnpackUnorm4(material.emissive);
+    if ((material.flags & MaterialAlphaTest) != 0)
+        clip(color.a - emissive.a);
+
+    // Brilho especular pela roughness do material: 1 quase fosco, 0 espelhado.
+    float roughness = (material.metallicRoughness >> 16) / 65535.0f;
+    float shininess = exp2(10.0f * (1.0f - roughness)) + 1.0f;
+
+    float3 diffuse;
+    float3 specular;
+    ShadeLocalLights(input.worldPosition, input.viewDepth, input.position.xy, shininess, diffuse, specular);
+
+    color.rgb *= lerp(ShadowDarkness, 1.0f, SampleShadow(input.worldPosition, input.viewDepth)) + diffuse;
+    color.rgb += specular + emissive.rgb * material.emissiveStrength;
+
+    return color;
 }
\ No newline at end of file
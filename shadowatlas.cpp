@@ -0,0 +1,394 @@
+#include "shadowatlas.h"
+
+#include <algorithm>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+enum ShadowAtlasNodeState : BYTE
+{
+    NodeStateUnavailable,       // Dentro de um n livre ou usado.
+    NodeStateFree,
+    NodeStateUsed,
+    NodeStateSplit,
+};
+
+const UINT ShadowAtlasNullLevel = UINT_MAX;
+
+static UINT GetNodeLevel(const ShadowAtlas* atlas, UINT node)
+{
+    UINT level = 0;
+    while (level + 1 < atlas->levelCount && node >= atlas->levelOffsets[level + 1])
+        level++;
+
+    return level;
+}
+
+static void AddFreeNode(ShadowAtlas* atlas, UINT level, UINT node)
+{
+    atlas->nodeStates[node] = NodeStateFree;
+    atlas->freePositions[node] = static_cast<UINT>(atlas->freeLists[level].size());
+    atlas->freeLists[level].push_back(node);
+}
+
+static void RemoveFreeNode(ShadowAtlas* atlas, UINT level, UINT node)
+{
+    std::vector<UINT>& freeList = atlas->freeLists[level];
+    const UINT position = atlas->freePositions[node];
+    const UINT last = freeList.back();
+
+    freeList[position] = last;
+    atlas->freePositions[last] = position;
+    freeList.pop_back();
+}
+
+// N livre do nvel, dividindo um n maior se a lista do nvel est vazia.
+static UINT AllocateNode(ShadowAtlas* atlas, UINT level)
+{
+    if (!atlas->freeLists[level].empty())
+    {
+        const UINT node = atlas->freeLists[level].back();
+        RemoveFreeNode(atlas, level, node);
+        atlas->nodeStates[node] = NodeStateUsed;
+        return node;
+    }
+
+    if (level == 0)
+        return ShadowAtlasNullNode;
+
+    const UINT parent = AllocateNode(atlas, level - 1);
+    if (parent == ShadowAtlasNullNode)
+        return ShadowAtlasNullNode;
+
+    atlas->nodeStates[parent] = NodeStateSplit;
+
+    const UINT parentWidth = 1u << (level - 1);
+    const UINT parentIndex = parent - atlas->levelOffsets[level - 1];
+    const UINT x = 2 * (parentIndex % parentWidth);
+    const UINT y = 2 * (parentIndex / parentWidth);
+    const UINT first = atlas->levelOffsets[level] + y * (1u << level) + x;
+
+    AddFreeNode(atlas, level, first + 1);
+    AddFreeNode(atlas, level, first + (1u << level));
+    AddFreeNode(atlas, level, first + (1u << level) + 1);
+
+    atlas->nodeStates[first] = NodeStateUsed;
+    return first;
+}
+
+// Devolve o n  lista do nvel e sobe juntando os quatro irmos enquanto todos esto livres.
+static void FreeNode(ShadowAtlas* atlas, UINT node)
+{
+    UINT level = GetNodeLevel(atlas, node);
+    AddFreeNode(atlas, level, node);
+
+    while (level > 0)
+    {
+        const UINT width = 1u << level;
+        const UINT index = node - atlas->levelOffsets[level];
+        const UINT x = index % width & ~1u;
+        const UINT y = index / width & ~1u;
+        const UINT first = atlas->levelOffsets[level] + y * width + x;
+        const UINT siblings[4] = { first, first + 1, first + width, first + width + 1 };
+
+        for (UINT sibling : siblings)
+        {
+            if (atlas->nodeStates[sibling] != NodeStateFree)
+                return;
+        }
+
+        for (UINT sibling : siblings)
+        {
+            RemoveFreeNode(atlas, level, sibling);
+            atlas->nodeStates[sibling] = NodeStateUnavailable;
+        }
+
+        node = atlas->levelOffsets[level - 1] + (y / 2) * (width / 2) + x / 2;
+        level--;
+        AddFreeNode(atlas, level, node);
+    }
+}
+
+static void ResetShadowAtlasNodes(ShadowAtlas* atlas)
+{
+    std::fill(atlas->nodeStates.begin(), atlas->nodeStates.end(), static_cast<BYTE>(NodeStateUnavailable));
+    for (UINT level = 0; level < atlas->levelCount; level++)
+    {
+        atlas->freeLists[level].clear();
+    }
+
+    AddFreeNode(atlas, 0, 0);
+}
+
+static void FreeSlot(ShadowAtlas* atlas, ShadowAtlasSlot* slot)
+{
+    for (UINT face = 0; face < slot->faceCount; face++)
+    {
+        FreeNode(atlas, slot->nodes[face]);
+    }
+
+    slot->tileSize = 0;
+    slot->faceCount = 0;
+}
+
+// Todas as faces no mesmo nvel; se alguma no cabe, as que couberam so devolvidas.
+static bool AllocateSlot(ShadowAtlas* atlas, ShadowAtlasSlot* slot, UINT level, UINT faceCount)
+{
+    for (UINT face = 0; face < faceCount; face++)
+    {
+        slot->nodes[face] = AllocateNode(atlas, level);
+        if (slot->nodes[face] == ShadowAtlasNullNode)
+        {
+            for (UINT k = 0; k < face; k++)
+                FreeNode(atlas, slot->nodes[k]);
+
+            return false;
+        }
+    }
+
+    slot->tileSize = atlas->settings.size >> level;
+    slot->faceCount = faceCount;
+    slot->changed = true;
+    return true;
+}
+
+static UINT64 GetRequestedTexels(const ShadowAtlas* atlas, const ShadowAtlasLight* lights, UINT lightCount, UINT bias)
+{
+    UINT64 texels = 0;
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        if (atlas->levels[i] == ShadowAtlasNullLevel)
+            continue;
+
+        const UINT64 tileSize = atlas->settings.size >> (std::min)(atlas->levels[i] + bias, atlas->levelCount - 1);
+        texels += lights[i].faceCount * tileSize * tileSize;
+    }
+
+    return texels;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitShadowAtlas(ShadowAtlas* atlas, const ShadowAtlasSettings* settings)
+{
+    atlas->settings = *settings;
+
+    atlas->levelCount = 1;
+    while ((settings->size >> atlas->levelCount) >= settings->minTileSize && atlas->levelCount < MaxShadowAtlasLevels)
+        atlas->levelCount++;
+
+    atlas->minLevel = 0;
+    while ((settings->size >> atlas->minLevel) > settings->maxTileSize && atlas->minLevel + 1 < atlas->levelCount)
+        atlas->minLevel++;
+
+    // (4^n - 1) / 3 ns acima do nvel n.
+    UINT nodeCount = 0;
+    for (UINT level = 0; level < atlas->levelCount; level++)
+    {
+        atlas->levelOffsets[level] = nodeCount;
+        nodeCount += 1u << (2 * level);
+        atlas->freeLists[level].reserve(static_cast<size_t>(1) << (2 * level));
+    }
+
+    atlas->nodeStates.assign(nodeCount, NodeStateUnavailable);
+    atlas->freePositions.assign(nodeCount, 0);
+    ResetShadowAtlasNodes(atlas);
+
+    atlas->slots.clear();
+    atlas->bias = 0;
+    atlas->usedTexels = 0;
+    atlas->shadowedCount = 0;
+    atlas->changedCount = 0;
+    atlas->droppedCount = 0;
+    atlas->repacked = false;
+}
+
+float GetShadowAtlasScreenSize(const LodView* lodView, float viewportHeight, XMFLOAT3 position, float range)
+{
+    const XMVECTOR center = XMLoadFloat3(&position);
+    for (UINT i = 0; i < 6; i++)
+    {
+        if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&lodView->frustumPlanes[i]), center)) < -range)
+            return 0.0f;
+    }
+
+    const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&lodView->cameraPosition))));
+    if (distance <= range)
+        return viewportHeight;
+
+    return (std::min)(2.0f * range * lodView->projectionScale / distance, viewportHeight);
+}
+
+void UpdateShadowAtlas(ShadowAtlas* atlas, const ShadowAtlasLight* lights, UINT lightCount)
+{
+    const ShadowAtlasSettings* settings = &atlas->settings;
+    const UINT lastLevel = atlas->levelCount - 1;
+
+    // Luzes que sumiram devolvem os tiles; as novas comeam sem.
+    for (UINT i = lightCount; i < atlas->slots.size(); i++)
+    {
+        FreeSlot(atlas, &atlas->slots[i]);
+    }
+
+    const size_t previousCount = atlas->slots.size();
+    atlas->slots.resize(lightCount);
+    for (size_t i = previousCount; i < lightCount; i++)
+    {
+        atlas->slots[i].tileSize = 0;
+        atlas->slots[i].level = ShadowAtlasNullLevel;
+        atlas->slots[i].faceCount = 0;
+    }
+
+    atlas->levels.resize(lightCount);
+    atlas->priorities.resize(lightCount);
+    atlas->order.clear();
+
+    // Nvel pedido por cada luz, com histerese em volta do nvel do quadro anterior.
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        const ShadowAtlasLight* light = &lights[i];
+        ShadowAtlasSlot* slot = &atlas->slots[i];
+        slot->changed = false;
+
+        const float wanted = light->screenSize * light->importance * settings->texelsPerPixel;
+        atlas->priorities[i] = light->screenSize * light->importance;
+
+        if (light->faceCount == 0 || wanted <= 0.0f)
+        {
+            atlas->levels[i] = ShadowAtlasNullLevel;
+            continue;
+        }
+
+        const float clamped = (std::min)((std::max)(wanted, static_cast<float>(settings->minTileSize)), static_cast<float>(settings->maxTileSize));
+        const float level = log2f(settings->size / clamped);
+
+        if (slot->level != ShadowAtlasNullLevel && fabsf(level - slot->level) <= 0.5f + settings->hysteresis)
+            atlas->levels[i] = slot->level;
+        else
+            atlas->levels[i] = (std::min)((std::max)(static_cast<UINT>(level + 0.5f), atlas->minLevel), lastLevel);
+
+        atlas->order.push_back(i);
+    }
+
+    // Vis: o mesmo nmero de nveis a menos para todas as luzes, at caber no oramento. S diminui quando o
+    // nvel de cima cabe com folga.
+    const UINT64 budgetTexels = static_cast<UINT64>(settings->budget * settings->size * settings->size);
+    UINT bias = (std::min)(atlas->bias, lastLevel);
+    while (bias > 0 && GetRequestedTexels(atlas, lights, lightCount, bias - 1) <= budgetTexels * (1.0f - settings->hysteresis))
+        bias--;
+
+    while (bias < lastLevel && GetRequestedTexels(atlas, lights, lightCount, bias) > budgetTexels)
+        bias++;
+
+    atlas->bias = bias;
+
+    // Das mais prioritrias para as menos; as que passam do oramento no tamanho mnimo ficam sem sombra.
+    std::sort(atlas->order.begin(), atlas->order.end(), [atlas](UINT a, UINT b)
+    {
+        if (atlas->priorities[a] != atlas->priorities[b])
+            return atlas->priorities[a] > atlas->priorities[b];
+
+        return a < b;
+    });
+
+    UINT64 requestedTexels = 0;
+    atlas->droppedCount = 0;
+    for (UINT i : atlas->order)
+    {
+        atlas->slots[i].level = atlas->levels[i];
+
+        const UINT finalLevel = (std::min)(atlas->levels[i] + bias, lastLevel);
+        const UINT64 tileSize = settings->size >> finalLevel;
+        const UINT64 texels = lights[i].faceCount * tileSize * tileSize;
+
+        if (requestedTexels + texels > budgetTexels)
+        {
+            atlas->levels[i] = ShadowAtlasNullLevel;
+            atlas->droppedCount++;
+            continue;
+        }
+
+        requestedTexels += texels;
+        atlas->levels[i] = finalLevel;
+    }
+
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        ShadowAtlasSlot* slot = &atlas->slots[i];
+        if (atlas->levels[i] == ShadowAtlasNullLevel)
+            slot->level = ShadowAtlasNullLevel;
+
+        if (slot->tileSize == 0)
+            continue;
+
+        if (atlas->levels[i] == ShadowAtlasNullLevel || slot->tileSize != settings->size >> atlas->levels[i] || slot->faceCount != lights[i].faceCount)
+            FreeSlot(atlas, slot);
+    }
+
+    // Maiores primeiro, depois por prioridade. Se a fragmentao impede algum tile, tudo  realocado do zero:
+    // quadrados potncia de 2 em ordem decrescente sempre cabem numa quadtree com rea suficiente.
+    std::sort(atlas->order.begin(), atlas->order.end(), [atlas](UINT a, UINT b)
+    {
+        if (atlas->levels[a] != atlas->levels[b])
+            return atlas->levels[a] < atlas->levels[b];
+
+        if (atlas->priorities[a] != atlas->priorities[b])
+            return atlas->priorities[a] > atlas->priorities[b];
+
+        return a < b;
+    });
+
+    atlas->repacked = false;
+    for (UINT pass = 0; pass < 2; pass++)
+    {
+        bool fragmented = false;
+        for (UINT i : atlas->order)
+        {
+            ShadowAtlasSlot* slot = &atlas->slots[i];
+            if (atlas->levels[i] == ShadowAtlasNullLevel || slot->tileSize != 0)
+                continue;
+
+            if (!AllocateSlot(atlas, slot, atlas->levels[i], lights[i].faceCount))
+            {
+                fragmented = true;
+                break;
+            }
+        }
+
+        if (!fragmented)
+            break;
+
+        for (ShadowAtlasSlot& slot : atlas->slots)
+        {
+            slot.tileSize = 0;
+            slot.faceCount = 0;
+        }
+
+        ResetShadowAtlasNodes(atlas);
+        atlas->repacked = true;
+    }
+
+    atlas->usedTexels = 0;
+    atlas->shadowedCount = 0;
+    atlas->changedCount = 0;
+    for (const ShadowAtlasSlot& slot : atlas->slots)
+    {
+        if (slot.tileSize == 0)
+            continue;
+
+        atlas->usedTexels += static_cast<UINT64>(slot.faceCount) * slot.tileSize * slot.tileSize;
+        atlas->shadowedCount++;
+        atlas->changedCount += slot.changed ? 1 : 0;
+    }
+}
+
+void GetShadowAtlasTile(const ShadowAtlas* atlas, UINT node, UINT* x, UINT* y, UINT* size)
+{
+    const UINT level = GetNodeLevel(atlas, node);
+    const UINT width = 1u << level;
+    const UINT index = node - atlas->levelOffsets[level];
+
+    *size = atlas->settings.size >> level;
+    *x = (index % width) * *size;
+    *y = (index / width) * *size;
+}
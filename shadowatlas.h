@@ -0,0 +1,90 @@
+#pragma once
+
+#include "infinity.h"
+#include "lodselect.h"
+
+#include <limits.h>
+#include <vector>
+
+// Atlas de shadow maps das luzes locais: uma textura de profundidade s, dividida por uma quadtree de buddies.
+// Cada n  um quadrado de tamanho potncia de 2; alocar um tile tira um n livre do nvel dele ou divide um n
+// maior em quatro, e liberar junta os quatro irmos de volta quando todos esto livres. Spots usam um tile e
+// luzes pontuais seis (as faces do cubo), todos do mesmo tamanho.
+//
+// O tamanho de cada luz vem da cobertura na tela vezes a importncia, com histerese entre os nveis. Se a soma
+// no cabe no oramento, todas as luzes descem o mesmo nmero de nveis (o vis, que s volta a subir com
+// folga); sem espao nem no tamanho mnimo, as menos prioritrias ficam sem sombra. Uma luz mantm o tile
+// enquanto o nvel dela no muda, e o shadow map dela s precisa ser redesenhado quando changed  true.
+
+const UINT MaxShadowAtlasLevels = 12;
+const UINT MaxShadowAtlasFaces = 6;
+
+const UINT ShadowAtlasNullNode = UINT_MAX;
+
+struct ShadowAtlasSettings
+{
+    UINT size;                  // Largura e altura do atlas, potncia de 2.
+    UINT minTileSize;
+    UINT maxTileSize;
+    float texelsPerPixel;       // Texels do shadow map por pixel do dimetro da luz na tela.
+    float hysteresis;           // Margem, em nveis, para trocar o tamanho de uma luz.
+    float budget;               // Frao da rea do atlas que as luzes podem pedir.
+};
+
+const ShadowAtlasSettings DefaultShadowAtlasSettings = { 8192, 64, 2048, 1.0f, 0.25f, 0.9f };
+
+// Pedido de uma luz neste quadro. O ndice da luz identifica o pedido entre quadros.
+struct ShadowAtlasLight
+{
+    UINT faceCount;             // 1 para spots, 6 para luzes pontuais, 0 para luzes sem sombra.
+    float screenSize;           // Dimetro da esfera da luz na tela, em pixels (0 fora do frustum).
+    float importance;           // Peso da luz, de 0 a 1; tambm decide quem fica sem sombra.
+};
+
+struct ShadowAtlasSlot
+{
+    UINT tileSize;              // 0 quando a luz est sem sombra.
+    UINT level;                 // Nvel pedido, antes do vis; base da histerese.
+    UINT faceCount;
+    UINT nodes[MaxShadowAtlasFaces];
+    bool changed;               // O tile  novo neste quadro: o shadow map precisa ser redesenhado.
+};
+
+struct ShadowAtlas
+{
+    ShadowAtlasSettings settings;
+    UINT levelCount;            // Do atlas inteiro (nvel 0) at o tile mnimo.
+    UINT minLevel;              // Nvel do tile mximo.
+    UINT levelOffsets[MaxShadowAtlasLevels];
+
+    std::vector<BYTE> nodeStates;
+    std::vector<UINT> freeLists[MaxShadowAtlasLevels];
+    std::vector<UINT> freePositions;    // Posio de cada n livre na sua lista.
+
+    std::vector<ShadowAtlasSlot> slots;
+    UINT bias;
+
+    // Memria de trabalho de UpdateShadowAtlas, mantida entre quadros.
+    std::vector<UINT> levels;
+    std::vector<float> priorities;
+    std::vector<UINT> order;
+
+    // Estatsticas do ltimo UpdateShadowAtlas.
+    UINT64 usedTexels;
+    UINT shadowedCount;
+    UINT changedCount;
+    UINT droppedCount;          // Luzes que pediram sombra e ficaram sem.
+    bool repacked;              // A fragmentao forou realocar todas as luzes.
+};
+
+void InitShadowAtlas(ShadowAtlas* atlas, const ShadowAtlasSettings* settings);
+
+// Dimetro na tela da esfera de alcance da luz, para ShadowAtlasLight::screenSize. Luzes cuja esfera fica fora
+// do frustum no iluminam nada visvel e ficam com 0; com a cmera dentro da esfera, a tela inteira.
+float GetShadowAtlasScreenSize(const LodView* lodView, float viewportHeight, XMFLOAT3 position, float range);
+
+// lights tem uma entrada por luz, na mesma ordem todos os quadros. Devolve os tiles em atlas->slots.
+void UpdateShadowAtlas(ShadowAtlas* atlas, const ShadowAtlasLight* lights, UINT lightCount);
+
+// Posio de um tile no atlas, em texels.
+void GetShadowAtlasTile(const ShadowAtlas* atlas, UINT node, UINT* x, UINT* y, UINT* size);
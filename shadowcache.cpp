@@ -0,0 +1,280 @@
+#include "shadowcache.h"
+
+#include <string.h>
+#include <algorithm>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Tiles cobertos por uma faixa de tiles, inclusiva.
+struct ShadowTileRange
+{
+    UINT left;
+    UINT top;
+    UINT right;
+    UINT bottom;
+};
+
+// Tiles sob a esfera do modelo na cascata, com um texel de folga pelo filtro e pelo vis. Devolve false se a
+// esfera fica fora da cascata.
+static bool GetCasterTiles(const ShadowCascade* cascade, UINT resolution, const Mesh* mesh, const XMFLOAT4X4* world, ShadowTileRange* range)
+{
+    const XMMATRIX worldMatrix = XMLoadFloat4x4(world);
+    const float scale = (std::max)((std::max)(
+        XMVectorGetX(XMVector3Length(worldMatrix.r[0])),
+        XMVectorGetX(XMVector3Length(worldMatrix.r[1]))),
+        XMVectorGetX(XMVector3Length(worldMatrix.r[2])));
+
+    const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&mesh->boundsCenter), worldMatrix);
+    XMFLOAT3 light;
+    XMStoreFloat3(&light, XMVector3TransformCoord(center, XMLoadFloat4x4(&cascade->viewProjection)));
+
+    const float u = (light.x * 0.5f + 0.5f) * resolution;
+    const float v = (0.5f - light.y * 0.5f) * resolution;
+    const float r = mesh->boundsRadius * scale / cascade->texelSize + 1.0f;
+    const float size = static_cast<float>(resolution);
+
+    if (u + r < 0.0f || v + r < 0.0f || u - r >= size || v - r >= size)
+        return false;
+
+    const float tileSize = size / ShadowCacheTiles;
+    range->left = static_cast<UINT>((std::max)(u - r, 0.0f) / tileSize);
+    range->top = static_cast<UINT>((std::max)(v - r, 0.0f) / tileSize);
+    range->right = (std::min)(static_cast<UINT>((std::min)(u + r, size) / tileSize), ShadowCacheTiles - 1);
+    range->bottom = (std::min)(static_cast<UINT>((std::min)(v + r, size) / tileSize), ShadowCacheTiles - 1);
+
+    return true;
+}
+
+static bool IsTileDirty(const ShadowCacheCascade* cascade, UINT x, UINT y)
+{
+    const UINT tile = y * ShadowCacheTiles + x;
+    return (cascade->dirtyTiles[tile / 64] >> (tile % 64)) & 1;
+}
+
+static void ClearTileDirty(ShadowCacheCascade* cascade, UINT x, UINT y)
+{
+    const UINT tile = y * ShadowCacheTiles + x;
+    cascade->dirtyTiles[tile / 64] &= ~(1ull << (tile % 64));
+}
+
+static void MarkCasterTiles(ShadowCacheCascade* cacheCascade, const ShadowCascade* cascade, UINT resolution, const Mesh* mesh, const XMFLOAT4X4* world)
+{
+    ShadowTileRange range;
+    if (!GetCasterTiles(cascade, resolution, mesh, world, &range))
+        return;
+
+    for (UINT y = range.top; y <= range.bottom; y++)
+    {
+        for (UINT x = range.left; x <= range.right; x++)
+        {
+            const UINT tile = y * ShadowCacheTiles + x;
+            cacheCascade->dirtyTiles[tile / 64] |= 1ull << (tile % 64);
+        }
+    }
+}
+
+static bool IsSameDraw(const DrawCommand* a, const DrawCommand* b)
+{
+    return a->indexCount == b->indexCount && a->startIndex == b->startIndex && a->baseVertex == b->baseVertex;
+}
+
+// Compara a lista de casters do quadro anterior com a deste, as duas por modelIndex crescente, e suja os tiles
+// dos casters que mudaram.
+static void MarkChangedCasters(ShadowCache* cache, ShadowCacheCascade* cacheCascade, const ShadowCascade* cascade, const Mesh* meshes, const Model* models,
+    const std::vector<DrawCommand>* casters)
+{
+    const std::vector<DrawCommand>& previous = cacheCascade->casters;
+    UINT p = 0;
+    UINT c = 0;
+
+    while (p < previous.size() || c < casters->size())
+    {
+        const UINT previousModel = p < previous.size() ? previous[p].modelIndex : UINT_MAX;
+        const UINT currentModel = c < casters->size() ? (*casters)[c].modelIndex : UINT_MAX;
+        const UINT modelIndex = (std::min)(previousModel, currentModel);
+        const Mesh* mesh = &meshes[models[modelIndex].meshIndex];
+        const XMFLOAT4X4* previousWorld = &cache->previousWorlds[modelIndex];
+
+        if (previousModel == currentModel)
+        {
+            if (!IsSameDraw(&previous[p], &(*casters)[c]) || memcmp(previousWorld, &models[modelIndex].world, sizeof(XMFLOAT4X4)) != 0)
+            {
+                MarkCasterTiles(cacheCascade, cascade, cache->resolution, mesh, previousWorld);
+                MarkCasterTiles(cacheCascade, cascade, cache->resolution, mesh, &models[modelIndex].world);
+            }
+            p++;
+            c++;
+        }
+        else if (previousModel < currentModel)
+        {
+            MarkCasterTiles(cacheCascade, cascade, cache->resolution, mesh, previousWorld);
+            p++;
+        }
+        else
+        {
+            MarkCasterTiles(cacheCascade, cascade, cache->resolution, mesh, &models[modelIndex].world);
+            c++;
+        }
+    }
+}
+
+// Junta os tiles sujos em retngulos: cada sequncia de tiles numa linha desce enquanto a linha de baixo tem a
+// mesma sequncia suja.
+static void BuildDirtyRects(ShadowCacheCascade* cacheCascade, UINT resolution)
+{
+    const UINT tileSize = resolution / ShadowCacheTiles;
+
+    for (UINT y = 0; y < ShadowCacheTiles; y++)
+    {
+        UINT x = 0;
+        while (x < ShadowCacheTiles)
+        {
+            if (!IsTileDirty(cacheCascade, x, y))
+            {
+                x++;
+                continue;
+            }
+
+            UINT right = x;
+            while (right + 1 < ShadowCacheTiles && IsTileDirty(cacheCascade, right + 1, y))
+                right++;
+
+            UINT bottom = y;
+            for (; bottom + 1 < ShadowCacheTiles; bottom++)
+            {
+                bool full = true;
+                for (UINT k = x; k <= right && full; k++)
+                    full = IsTileDirty(cacheCascade, k, bottom + 1);
+
+                if (!full)
+                    break;
+            }
+
+            for (UINT row = y; row <= bottom; row++)
+            {
+                for (UINT k = x; k <= right; k++)
+                    ClearTileDirty(cacheCascade, k, row);
+            }
+
+            // O ltimo tile vai at a borda, caso a resoluo no seja mltipla do nmero de tiles.
+            const UINT rectRight = right + 1 == ShadowCacheTiles ? resolution : (right + 1) * tileSize;
+            const UINT rectBottom = bottom + 1 == ShadowCacheTiles ? resolution : (bottom + 1) * tileSize;
+            cacheCascade->rects.push_back({ x * tileSize, y * tileSize, rectRight, rectBottom, 0, 0 });
+
+            x = right + 1;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitShadowCache(ShadowCache* cache, UINT resolution, UINT cascadeCount)
+{
+    cache->resolution = resolution;
+    cache->cascadeCount = (std::min)(cascadeCount, MaxShadowCascades);
+    cache->previousWorlds.clear();
+    cache->drawCount = 0;
+    cache->casterCount = 0;
+    cache->dirtyTileCount = 0;
+
+    for (UINT c = 0; c < MaxShadowCascades; c++)
+    {
+        ShadowCacheCascade* cascade = &cache->cascades[c];
+        XMStoreFloat4x4(&cascade->viewProjection, XMMatrixIdentity());
+        cascade->valid = false;
+        memset(cascade->dirtyTiles, 0, sizeof(cascade->dirtyTiles));
+        cascade->casters.clear();
+        cascade->rects.clear();
+        cascade->draws.clear();
+    }
+}
+
+void InvalidateShadowCache(ShadowCache* cache)
+{
+    for (UINT c = 0; c < MaxShadowCascades; c++)
+    {
+        cache->cascades[c].valid = false;
+    }
+}
+
+void UpdateShadowCache(ShadowCache* cache, const ShadowCascade* cascades, const Mesh* meshes, const Model* models, UINT modelCount,
+    const std::vector<DrawCommand>* casterLists)
+{
+    if (cache->previousWorlds.size() != modelCount)
+        InvalidateShadowCache(cache);
+
+    cache->drawCount = 0;
+    cache->casterCount = 0;
+    cache->dirtyTileCount = 0;
+
+    for (UINT c = 0; c < cache->cascadeCount; c++)
+    {
+        ShadowCacheCascade* cacheCascade = &cache->cascades[c];
+        const ShadowCascade* cascade = &cascades[c];
+        const std::vector<DrawCommand>& casters = casterLists[c];
+
+        cacheCascade->rects.clear();
+        cacheCascade->draws.clear();
+        cache->casterCount += static_cast<UINT>(casters.size());
+
+        // Cascata nova ou que andou: tudo  redesenhado, num retngulo s, sem olhar os casters.
+        if (!cacheCascade->valid || memcmp(&cacheCascade->viewProjection, &cascade->viewProjection, sizeof(XMFLOAT4X4)) != 0)
+        {
+            cacheCascade->rects.push_back({ 0, 0, cache->resolution, cache->resolution, 0, static_cast<UINT>(casters.size()) });
+            cacheCascade->draws = casters;
+            cache->dirtyTileCount += ShadowCacheTiles * ShadowCacheTiles;
+        }
+        else
+        {
+            MarkChangedCasters(cache, cacheCascade, cascade, meshes, models, &casters);
+
+            for (UINT64 bits : cacheCascade->dirtyTiles)
+            {
+                for (; bits; bits &= bits - 1)
+                    cache->dirtyTileCount++;
+            }
+
+            BuildDirtyRects(cacheCascade, cache->resolution);
+
+            // Os casters que tocam cada retngulo, testados pelos tiles sob a esfera.
+            std::vector<ShadowTileRange> casterTiles(casters.size());
+            std::vector<bool> casterVisible(casters.size());
+            for (UINT i = 0; i < casters.size(); i++)
+            {
+                const Model* model = &models[casters[i].modelIndex];
+                casterVisible[i] = GetCasterTiles(cascade, cache->resolution, &meshes[model->meshIndex], &model->world, &casterTiles[i]);
+            }
+
+            const UINT tileSize = cache->resolution / ShadowCacheTiles;
+            for (ShadowCacheRect& rect : cacheCascade->rects)
+            {
+                const UINT left = rect.left / tileSize;
+                const UINT top = rect.top / tileSize;
+                const UINT right = (rect.right - 1) / tileSize;
+                const UINT bottom = (rect.bottom - 1) / tileSize;
+
+                rect.firstDraw = static_cast<UINT>(cacheCascade->draws.size());
+                for (UINT i = 0; i < casters.size(); i++)
+                {
+                    const ShadowTileRange& tiles = casterTiles[i];
+                    if (casterVisible[i] && tiles.left <= right && tiles.right >= left && tiles.top <= bottom && tiles.bottom >= top)
+                        cacheCascade->draws.push_back(casters[i]);
+                }
+                rect.drawCount = static_cast<UINT>(cacheCascade->draws.size()) - rect.firstDraw;
+            }
+        }
+
+        memset(cacheCascade->dirtyTiles, 0, sizeof(cacheCascade->dirtyTiles));
+        cacheCascade->viewProjection = cascade->viewProjection;
+        cacheCascade->valid = true;
+        cacheCascade->casters = casters;
+        cache->drawCount += static_cast<UINT>(cacheCascade->draws.size());
+    }
+
+    cache->previousWorlds.resize(modelCount);
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        cache->previousWorlds[i] = models[i].world;
+    }
+}
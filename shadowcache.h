@@ -0,0 +1,65 @@
+#pragma once
+
+#include "infinity.h"
+#include "lodselect.h"
+#include "shadowcascades.h"
+
+#include <vector>
+
+// Cache das cascatas de sombra entre quadros. O shadow map no  limpo a cada quadro: enquanto a matriz de uma
+// cascata no muda (a luz  fixa e a cascata s anda em passos de snapTexels), s os tiles por onde passou algum
+// caster que mudou so limpos e redesenhados.
+//
+// Um caster muda quando entra ou sai da lista da cascata, troca de LOD ou de posio na geometria (streaming), ou
+// quando a matriz de mundo dele muda. Os tiles sob a esfera dele, antes e depois, ficam sujos. Os tiles sujos so
+// juntados em retngulos, e cada retngulo  limpo e redesenhado com os casters que o tocam, com scissor.
+
+const UINT ShadowCacheTiles = 16;           // Tiles por eixo de cada cascata.
+
+// Retngulo a redesenhar, em texels, e a faixa de draws dele.
+struct ShadowCacheRect
+{
+    UINT left;
+    UINT top;
+    UINT right;
+    UINT bottom;
+    UINT firstDraw;
+    UINT drawCount;
+};
+
+struct ShadowCacheCascade
+{
+    XMFLOAT4X4 viewProjection;
+    bool valid;                             // Falso at o primeiro desenho: a cascata toda  redesenhada.
+    UINT64 dirtyTiles[ShadowCacheTiles * ShadowCacheTiles / 64];
+
+    std::vector<DrawCommand> casters;       // Lista de casters do quadro anterior, por modelIndex crescente.
+
+    // O que desenhar neste quadro.
+    std::vector<ShadowCacheRect> rects;
+    std::vector<DrawCommand> draws;
+};
+
+struct ShadowCache
+{
+    UINT resolution;
+    UINT cascadeCount;
+    ShadowCacheCascade cascades[MaxShadowCascades];
+
+    std::vector<XMFLOAT4X4> previousWorlds;
+
+    // Estatsticas do ltimo UpdateShadowCache.
+    UINT drawCount;                         // Draws gravados, somando os retngulos.
+    UINT casterCount;                       // Draws sem o cache: os casters de todas as cascatas.
+    UINT dirtyTileCount;
+};
+
+void InitShadowCache(ShadowCache* cache, UINT resolution, UINT cascadeCount);
+
+// Fora o redesenho de todas as cascatas no prximo quadro (o contedo do shadow map foi perdido).
+void InvalidateShadowCache(ShadowCache* cache);
+
+// casterLists vem de CullShadowCasters, um por cascata, por modelIndex crescente. Preenche rects e draws de cada
+// cascata e guarda o estado deste quadro para o prximo. Se o nmero de modelos mudar, tudo  redesenhado.
+void UpdateShadowCache(ShadowCache* cache, const ShadowCascade* cascades, const Mesh* meshes, const Model* models, UINT modelCount,
+    const std::vector<DrawCommand>* casterLists);
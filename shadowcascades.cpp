@@ -0,0 +1,210 @@
+#include "shadowcascades.h"
+
+#include <algorithm>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+void ComputeCascadeSplits(float nearPlane, float farPlane, UINT cascadeCount, float lambda, float* splits)
+{
+    for (UINT i = 0; i <= cascadeCount; i++)
+    {
+        const float t = static_cast<float>(i) / cascadeCount;
+        const float logarithmic = nearPlane * powf(farPlane / nearPlane, t);
+        const float uniform = nearPlane + (farPlane - nearPlane) * t;
+        splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+    }
+
+    splits[0] = nearPlane;
+    splits[cascadeCount] = farPlane;
+}
+
+void BuildShadowCascades(const ShadowSettings* settings, FXMMATRIX view, float fov_deg, float aspectRatio, float nearPlane, float farPlane,
+    XMFLOAT3 lightDirection, ShadowCascade* cascades)
+{
+    const UINT cascadeCount = (std::min)(settings->cascadeCount, MaxShadowCascades);
+
+    float splits[MaxShadowCascades + 1];
+    ComputeCascadeSplits(nearPlane, (std::min)(farPlane, settings->shadowDistance), cascadeCount, settings->splitLambda, splits);
+
+    // Distncia ao quadrado do eixo da cmera at um canto da fatia, por unidade de profundidade ao quadrado.
+    const float tanHalfFov = tanf(0.5f * fov_deg * XM_PI / 180.0f);
+    const float cornerSquared = tanHalfFov * tanHalfFov * (1.0f + aspectRatio * aspectRatio);
+
+    const XMMATRIX inverseView = XMMatrixInverse(nullptr, view);
+    const XMVECTOR cameraPosition = inverseView.r[3];
+    const XMVECTOR cameraForward = XMVector3Normalize(inverseView.r[2]);
+
+    // A rotao da luz  fixa; s a translao acompanha a cmera, em passos de snapTexels texels.
+    const XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+    const XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+    const XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), direction, up);
+
+    for (UINT c = 0; c < cascadeCount; c++)
+    {
+        const float n = splits[c];
+        const float f = splits[c + 1];
+
+        // Esfera com centro no eixo,  mesma distncia dos cantos near e far da fatia. Em fatias largas o centro
+        // passaria do far: fica no far, e os cantos do far decidem o raio.
+        float center = 0.5f * (n + f) * (1.0f + cornerSquared);
+        float radiusSquared = (center - n) * (center - n) + n * n * cornerSquared;
+        if (center > f)
+        {
+            center = f;
+            radiusSquared = f * f * cornerSquared;
+        }
+
+        // Um passo de folga de cada lado: o arredondamento do centro no tira a esfera da cascata. A profundidade
+        // tambm anda em passos, para a matriz inteira ficar igual enquanto o centro no troca de passo.
+        const float texelSize = 2.0f * sqrtf(radiusSquared) / (settings->resolution - 2 * settings->snapTexels);
+        const float radius = 0.5f * settings->resolution * texelSize;
+        const float step = settings->snapTexels * texelSize;
+
+        XMFLOAT3 lightCenter;
+        XMStoreFloat3(&lightCenter, XMVector3TransformCoord(XMVectorMultiplyAdd(cameraForward, XMVectorReplicate(center), cameraPosition), lightView));
+        lightCenter.x = floorf(lightCenter.x / step) * step;
+        lightCenter.y = floorf(lightCenter.y / step) * step;
+        lightCenter.z = floorf(lightCenter.z / step) * step;
+
+        const XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+            lightCenter.x - radius, lightCenter.x + radius,
+            lightCenter.y - radius, lightCenter.y + radius,
+            lightCenter.z - radius, lightCenter.z + radius);
+
+        ShadowCascade* cascade = &cascades[c];
+        XMStoreFloat4x4(&cascade->viewProjection, XMMatrixMultiply(lightView, projection));
+        cascade->splitNear = n;
+        cascade->splitFar = f;
+        cascade->radius = radius;
+        cascade->texelSize = texelSize;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct ShadowCullContext
+{
+    const ShadowSettings* settings;
+    const ShadowCascade* cascades;
+    const Mesh* meshes;
+    const Model* models;
+    UINT paddedCount;
+
+    // Esferas em espao de mundo (SoA, preenchidas at mltiplo de 4) e a escala de cada modelo.
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* radius;
+    const float* scale;
+
+    std::vector<DrawCommand>* drawLists;
+};
+
+static void CullShadowCascadeJob(void* context, UINT cascadeIndex)
+{
+    const ShadowCullContext* ctx = static_cast<const ShadowCullContext*>(context);
+    const ShadowCascade* cascade = &ctx->cascades[cascadeIndex];
+    std::vector<DrawCommand>* drawList = &ctx->drawLists[cascadeIndex];
+    drawList->clear();
+
+    const XMFLOAT4X4& m = cascade->viewProjection;
+
+    // A matriz  afim: a esfera continua uma esfera, com raio 1 / radius em x e y e 1 / (2 * radius) em z.
+    const XMVECTOR radiusScaleXY = XMVectorReplicate(1.0f / cascade->radius);
+    const XMVECTOR radiusScaleZ = XMVectorReplicate(0.5f / cascade->radius);
+    const XMVECTOR minRadius = XMVectorReplicate(0.5f * ctx->settings->minCasterTexels * cascade->texelSize);
+    const XMVECTOR one = XMVectorReplicate(1.0f);
+    const float allowedError = ctx->settings->lodErrorTexels * cascade->texelSize;
+
+    for (UINT i = 0; i < ctx->paddedCount; i += 4)
+    {
+        const XMVECTOR x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&ctx->centerX[i]));
+        const XMVECTOR y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&ctx->centerY[i]));
+        const XMVECTOR z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&ctx->centerZ[i]));
+        const XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&ctx->radius[i]));
+
+        XMVECTOR lightX = XMVectorMultiplyAdd(XMVectorReplicate(m._11), x, XMVectorReplicate(m._41));
+        lightX = XMVectorMultiplyAdd(XMVectorReplicate(m._21), y, lightX);
+        lightX = XMVectorMultiplyAdd(XMVectorReplicate(m._31), z, lightX);
+
+        XMVECTOR lightY = XMVectorMultiplyAdd(XMVectorReplicate(m._12), x, XMVectorReplicate(m._42));
+        lightY = XMVectorMultiplyAdd(XMVectorReplicate(m._22), y, lightY);
+        lightY = XMVectorMultiplyAdd(XMVectorReplicate(m._32), z, lightY);
+
+        XMVECTOR lightZ = XMVectorMultiplyAdd(XMVectorReplicate(m._13), x, XMVectorReplicate(m._43));
+        lightZ = XMVectorMultiplyAdd(XMVectorReplicate(m._23), y, lightZ);
+        lightZ = XMVectorMultiplyAdd(XMVectorReplicate(m._33), z, lightZ);
+
+        // Sem teste do near: o que est entre a luz e a cascata ainda projeta sombra nela.
+        const XMVECTOR limitXY = XMVectorMultiplyAdd(r, radiusScaleXY, one);
+        XMVECTOR inside = XMVectorGreaterOrEqual(r, minRadius);
+        inside = XMVectorAndInt(inside, XMVectorLessOrEqual(XMVectorAbs(lightX), limitXY));
+        inside = XMVectorAndInt(inside, XMVectorLessOrEqual(XMVectorAbs(lightY), limitXY));
+        inside = XMVectorAndInt(inside, XMVectorLessOrEqual(lightZ, XMVectorMultiplyAdd(r, radiusScaleZ, one)));
+
+        XMUINT4 mask;
+        XMStoreUInt4(&mask, inside);
+        const UINT lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+
+        for (UINT k = 0; k < 4; k++)
+        {
+            if (!lanes[k])
+                continue;
+
+            const UINT modelIndex = i + k;
+            const Mesh* mesh = &ctx->meshes[ctx->models[modelIndex].meshIndex];
+
+            // O LOD mais grosso cujo erro, no espao do modelo, ainda fica abaixo do texel.
+            const float modelError = allowedError / ctx->scale[modelIndex];
+            UINT lod = 0;
+            while (lod + 1 < mesh->lodCount && mesh->lods[lod + 1].error <= modelError)
+                lod++;
+
+            drawList->push_back({ modelIndex, mesh->lods[lod].indexCount, mesh->lods[lod].startIndex, mesh->baseVertex });
+        }
+    }
+}
+
+void CullShadowCasters(JobSystem* jobSystem, const ShadowSettings* settings, const ShadowCascade* cascades, const Mesh* meshes, const Model* models, UINT modelCount,
+    std::vector<DrawCommand>* drawLists)
+{
+    // Preenchimento com raio negativo: nunca passa no teste de tamanho.
+    const UINT paddedCount = (modelCount + 3) & ~3u;
+    std::vector<float> centerX(paddedCount, 0.0f), centerY(paddedCount, 0.0f), centerZ(paddedCount, 0.0f), radius(paddedCount, -1.0f);
+    std::vector<float> scale(paddedCount, 1.0f);
+
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        const Mesh* mesh = &meshes[models[i].meshIndex];
+        const XMMATRIX world = XMLoadFloat4x4(&models[i].world);
+
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&mesh->boundsCenter), world));
+
+        scale[i] = (std::max)((std::max)(
+            XMVectorGetX(XMVector3Length(world.r[0])),
+            XMVectorGetX(XMVector3Length(world.r[1]))),
+            XMVectorGetX(XMVector3Length(world.r[2])));
+
+        centerX[i] = center.x;
+        centerY[i] = center.y;
+        centerZ[i] = center.z;
+        radius[i] = (mesh->pending || mesh->lods[0].indexCount == 0) ? -1.0f : mesh->boundsRadius * scale[i];
+    }
+
+    ShadowCullContext context;
+    context.settings = settings;
+    context.cascades = cascades;
+    context.meshes = meshes;
+    context.models = models;
+    context.paddedCount = paddedCount;
+    context.centerX = centerX.data();
+    context.centerY = centerY.data();
+    context.centerZ = centerZ.data();
+    context.radius = radius.data();
+    context.scale = scale.data();
+    context.drawLists = drawLists;
+
+    ParallelFor(jobSystem, (std::min)(settings->cascadeCount, MaxShadowCascades), CullShadowCascadeJob, &context);
+}
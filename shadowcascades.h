@@ -0,0 +1,61 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+#include "lodselect.h"
+
+#include <vector>
+
+// Sombras em cascata de uma luz direcional. O trecho do frustum da cmera at shadowDistance  dividido em
+// cascatas (cada uma com o seu shadow map, numa textura array), com fatias mais curtas perto da cmera.
+//
+// Cada cascata cobre a esfera envolvente da sua fatia. O raio s depende das distncias de diviso e do fov, e a
+// posio  arredondada em passos de snapTexels texels no espao da luz: girar ou mover a cmera no faz as
+// bordas das sombras tremerem, e entre um passo e outro a matriz da cascata no muda. O plano near da cascata
+// no corta nada: o shadow map  desenhado sem depth clip, e casters entre a luz e a cascata ficam com
+// profundidade 0 (pancaking).
+
+const UINT MaxShadowCascades = 4;
+
+struct ShadowSettings
+{
+    UINT cascadeCount;
+    UINT resolution;            // Texels por eixo de cada cascata.
+    float splitLambda;          // 0 divide em fatias iguais, 1 em progresso geomtrica.
+    float shadowDistance;       // Alm disso (ou do far da cmera), nada recebe sombra.
+    float minCasterTexels;      // Casters com dimetro menor que isso, em texels da cascata, no so desenhados nela.
+    float lodErrorTexels;       // Erro de LOD aceito nos casters, em texels da cascata.
+
+    // Passo da posio da cascata, em texels. Passos maiores deixam a cascata parada por mais tempo (o cache de
+    // sombras  reaproveitado)  custa de uma borda de snapTexels texels de cada lado.
+    UINT snapTexels;
+};
+
+const ShadowSettings DefaultShadowSettings = { 4, 2048, 0.75f, 200.0f, 1.0f, 1.0f, 32 };
+
+struct ShadowCascade
+{
+    // Do mundo para [-1, 1] x [-1, 1] x [0, 1], conveno de vetor-linha.
+    XMFLOAT4X4 viewProjection;
+
+    // Fatia do frustum da cmera, em profundidade de view.
+    float splitNear;
+    float splitFar;
+
+    float radius;               // Meia largura da cascata; a profundidade vai de -radius a +radius em volta do centro.
+    float texelSize;            // Unidades de mundo por texel.
+};
+
+// splits recebe cascadeCount + 1 distncias, de nearPlane a farPlane: a mistura, por lambda, da diviso uniforme
+// com a logartmica.
+void ComputeCascadeSplits(float nearPlane, float farPlane, UINT cascadeCount, float lambda, float* splits);
+
+// view e fov descrevem a cmera (perspectiva LH); lightDirection  a direo em que a luz viaja.
+void BuildShadowCascades(const ShadowSettings* settings, FXMMATRIX view, float fov_deg, float aspectRatio, float nearPlane, float farPlane,
+    XMFLOAT3 lightDirection, ShadowCascade* cascades);
+
+// Preenche drawLists[c] (um por cascata) com os modelos que podem projetar sombra na cascata c. As esferas dos
+// modelos vo para SoA uma vez; cada cascata  um job que testa 4 modelos por vez contra a caixa da luz e
+// escolhe o LOD pelo tamanho do texel, sem depender da cmera. Malhas pendentes do streaming ficam de fora.
+void CullShadowCasters(JobSystem* jobSystem, const ShadowSettings* settings, const ShadowCascade* cascades, const Mesh* meshes, const Model* models, UINT modelCount,
+    std::vector<DrawCommand>* drawLists);
@@ -0,0 +1,729 @@
+#include "streaming.h"
+#include "meshformat.h"
+
+#include <process.h>
+#include <malloc.h>
+#include <string.h>
+#include <float.h>
+#include <limits.h>
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------
+
+const ULONG_PTR StreamingKeyRead = 1;       // leitura sobreposta concluda
+const ULONG_PTR StreamingKeyMapped = 2;     // bloco a descomprimir do arquivo mapeado
+const ULONG_PTR StreamingKeyQuit = 3;
+
+// Um bloco do pacote e a faixa [begin, end) do asset que sai dele para destination.
+struct StreamingRead
+{
+    // Primeiro membro: o pacote de concluso aponta para a leitura.
+    OVERLAPPED overlapped;
+
+    StreamingRequest* request;
+    const PakBlock* block;
+    UINT64 blockBegin;
+    UINT blockLength;
+
+    UINT64 begin;
+    UINT64 end;
+    BYTE* destination;
+    BYTE* buffer;
+};
+
+struct StreamingRequest
+{
+    UINT streamedIndex;
+    std::vector<StreamingRead> reads;
+
+    volatile LONG remainingReadCount;
+    volatile LONG failedReadCount;
+};
+
+struct StreamingCandidate
+{
+    StreamingPriority priority;
+    float priorityKey;
+    UINT streamedIndex;
+};
+
+static bool IsLessUrgent(StreamingPriority a, float aKey, StreamingPriority b, float bKey)
+{
+    return a > b || (a == b && aKey > bKey);
+}
+
+// Ordem invertida: std::make_heap deixa a malha mais urgente no topo.
+static bool IsLessUrgentCandidate(const StreamingCandidate& a, const StreamingCandidate& b)
+{
+    return IsLessUrgent(a.priority, a.priorityKey, b.priority, b.priorityKey);
+}
+
+static bool IsSphereInFrustum(const XMFLOAT4 frustumPlanes[6], FXMVECTOR center, float radius)
+{
+    for (UINT p = 0; p < 6; p++)
+    {
+        if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&frustumPlanes[p]), center)) < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static void InitStreamingPool(StreamingPool* pool, UINT base, UINT size)
+{
+    pool->base = base;
+    pool->size = size;
+    pool->freeRanges.clear();
+
+    if (size > 0)
+        pool->freeRanges.push_back({ 0, size });
+}
+
+static bool AllocateStreamingRange(StreamingPool* pool, UINT count, UINT* offset)
+{
+    if (count == 0)
+    {
+        *offset = pool->base;
+        return true;
+    }
+
+    for (size_t i = 0; i < pool->freeRanges.size(); i++)
+    {
+        StreamingRange* range = &pool->freeRanges[i];
+        if (range->count < count)
+            continue;
+
+        *offset = pool->base + range->offset;
+        range->offset += count;
+        range->count -= count;
+
+        if (range->count == 0)
+            pool->freeRanges.erase(pool->freeRanges.begin() + i);
+
+        return true;
+    }
+
+    return false;
+}
+
+static void FreeStreamingRange(StreamingPool* pool, UINT offset, UINT count)
+{
+    if (count == 0)
+        return;
+
+    StreamingRange range = { offset - pool->base, count };
+
+    std::vector<StreamingRange>& ranges = pool->freeRanges;
+    size_t i = std::lower_bound(ranges.begin(), ranges.end(), range,
+        [](const StreamingRange& a, const StreamingRange& b) { return a.offset < b.offset; }) - ranges.begin();
+
+    if (i > 0 && ranges[i - 1].offset + ranges[i - 1].count == range.offset)
+    {
+        range.offset = ranges[i - 1].offset;
+        range.count += ranges[i - 1].count;
+        ranges.erase(ranges.begin() + --i);
+    }
+
+    if (i < ranges.size() && range.offset + range.count == ranges[i].offset)
+    {
+        range.count += ranges[i].count;
+        ranges.erase(ranges.begin() + i);
+    }
+
+    ranges.insert(ranges.begin() + i, range);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static bool DecompressStreamingRead(const StreamingRead* read, const BYTE* source, std::vector<BYTE>* scratch)
+{
+    if (read->begin == read->blockBegin && read->end == read->blockBegin + read->blockLength)
+        return DecompressPakBlock(read->block, source, read->destination, read->blockLength);
+
+    // Blocos das pontas da faixa passam pelo buffer da thread.
+    scratch->resize(read->blockLength);
+    if (!DecompressPakBlock(read->block, source, scratch->data(), read->blockLength))
+        return false;
+
+    memcpy(read->destination, scratch->data() + (read->begin - read->blockBegin), static_cast<size_t>(read->end - read->begin));
+    return true;
+}
+
+// Depois da ltima leitura de um pedido ele passa para a thread principal, que  a nica a liber-lo.
+static void FinishStreamingRead(StreamingSystem* streaming, StreamingRead* read, bool succeeded)
+{
+    StreamingRequest* request = read->request;
+
+    if (read->buffer)
+    {
+        _aligned_free(read->buffer);
+        read->buffer = nullptr;
+    }
+
+    if (!succeeded)
+        InterlockedIncrement(&request->failedReadCount);
+
+    if (InterlockedDecrement(&request->remainingReadCount) == 0)
+    {
+        EnterCriticalSection(&streaming->completedLock);
+        streaming->completedRequests.push_back(request);
+        LeaveCriticalSection(&streaming->completedLock);
+    }
+
+    InterlockedDecrement(&streaming->pendingReadCount);
+}
+
+static unsigned int WINAPI StreamingThread(LPVOID lpParameter)
+{
+    StreamingSystem* streaming = reinterpret_cast<StreamingSystem*>(lpParameter);
+    std::vector<BYTE> scratch;
+
+    for (;;)
+    {
+        DWORD bytesTransferred = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        const BOOL completed = GetQueuedCompletionStatus(streaming->completionPort, &bytesTransferred, &key, &overlapped, INFINITE);
+
+        if (key == StreamingKeyQuit || overlapped == nullptr)
+            break;
+
+        StreamingRead* read = reinterpret_cast<StreamingRead*>(overlapped);
+
+        bool succeeded;
+        if (key == StreamingKeyMapped)
+            succeeded = DecompressStreamingRead(read, streaming->pak.file.data + read->block->offset, &scratch);
+        else
+            succeeded = completed && bytesTransferred >= read->block->compressedSize && DecompressStreamingRead(read, read->buffer, &scratch);
+
+        FinishStreamingRead(streaming, read, succeeded);
+    }
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static void AddStreamingReads(const StreamingSystem* streaming, StreamingRequest* request, const PakEntry* entry, UINT64 offset, UINT64 size, BYTE* destination)
+{
+    if (size == 0)
+        return;
+
+    const UINT blockSize = streaming->pak.header->blockSize;
+    const UINT firstBlock = static_cast<UINT>(offset / blockSize);
+    const UINT lastBlock = static_cast<UINT>((offset + size - 1) / blockSize);
+
+    for (UINT b = firstBlock; b <= lastBlock; b++)
+    {
+        StreamingRead read = {};
+        read.request = request;
+        read.block = &streaming->pak.blocks[entry->firstBlock + b];
+        read.blockBegin = static_cast<UINT64>(b) * blockSize;
+        read.blockLength = static_cast<UINT>((entry->size - read.blockBegin < blockSize) ? entry->size - read.blockBegin : blockSize);
+        read.begin = (std::max)(read.blockBegin, offset);
+        read.end = (std::min)(read.blockBegin + read.blockLength, offset + size);
+        read.destination = destination + (read.begin - offset);
+        request->reads.push_back(read);
+    }
+}
+
+static void IssueStreamingRead(StreamingSystem* streaming, StreamingRead* read)
+{
+    const PakBlock* block = read->block;
+
+    // Sem o cache do sistema, offset, tamanho e buffer precisam estar alinhados a setor.
+    if (streaming->file != INVALID_HANDLE_VALUE && block->offset % PakAlignment == 0)
+    {
+        const DWORD length = (block->compressedSize + PakAlignment - 1) & ~(PakAlignment - 1);
+        read->buffer = reinterpret_cast<BYTE*>(_aligned_malloc(length, PakAlignment));
+        read->overlapped.Offset = static_cast<DWORD>(block->offset);
+        read->overlapped.OffsetHigh = static_cast<DWORD>(block->offset >> 32);
+
+        if (read->buffer && (ReadFile(streaming->file, read->buffer, length, nullptr, &read->overlapped) || GetLastError() == ERROR_IO_PENDING))
+            return;
+
+        FinishStreamingRead(streaming, read, false);
+        return;
+    }
+
+    if (!PostQueuedCompletionStatus(streaming->completionPort, 0, StreamingKeyMapped, &read->overlapped))
+        FinishStreamingRead(streaming, read, false);
+}
+
+static void RequestStreamedMesh(StreamingSystem* streaming, UINT streamedIndex, const Mesh* mesh)
+{
+    StreamedMesh* streamed = &streaming->streamedMeshes[streamedIndex];
+
+    StreamingRequest* request = new StreamingRequest();
+    request->streamedIndex = streamedIndex;
+    request->failedReadCount = 0;
+
+    AddStreamingReads(streaming, request, streamed->entry, streamed->vertexSource, static_cast<UINT64>(mesh->vertexCount) * sizeof(Vertex),
+        reinterpret_cast<BYTE*>(streaming->vertices + streamed->vertexOffset));
+
+    // Os LODs vm de faixas separadas do arquivo e ficam em sequncia no pool.
+    UINT indexOffset = streamed->indexOffset;
+    for (UINT lod = 0; lod < mesh->lodCount; lod++)
+    {
+        const MeshLod* source = &streamed->sourceLods[lod];
+        AddStreamingReads(streaming, request, streamed->entry, streamed->indexSource + static_cast<UINT64>(source->startIndex) * sizeof(UINT),
+            static_cast<UINT64>(source->indexCount) * sizeof(UINT), reinterpret_cast<BYTE*>(streaming->indices + indexOffset));
+        indexOffset += source->indexCount;
+    }
+
+    streamed->state = StreamingStateLoading;
+    streaming->activeRequestCount++;
+
+    if (request->reads.empty())
+    {
+        EnterCriticalSection(&streaming->completedLock);
+        streaming->completedRequests.push_back(request);
+        LeaveCriticalSection(&streaming->completedLock);
+        return;
+    }
+
+    // O contador cobre todas as leituras antes da primeira ser emitida: o pedido s se completa no fim.
+    const UINT readCount = static_cast<UINT>(request->reads.size());
+    request->remainingReadCount = static_cast<LONG>(readCount);
+    InterlockedExchangeAdd(&streaming->pendingReadCount, static_cast<LONG>(readCount));
+
+    for (UINT i = 0; i < readCount; i++)
+    {
+        IssueStreamingRead(streaming, &request->reads[i]);
+    }
+}
+
+static void PublishStreamedMesh(StreamingSystem* streaming, StreamingRequest* request, Mesh* meshes)
+{
+    StreamedMesh* streamed = &streaming->streamedMeshes[request->streamedIndex];
+    Mesh* mesh = &meshes[streaming->firstMeshIndex + request->streamedIndex];
+
+    streaming->activeRequestCount--;
+
+    if (request->failedReadCount != 0)
+    {
+        // Blocos corrompidos no so pedidos de novo.
+        FreeStreamingRange(&streaming->vertexPool, streamed->vertexOffset, mesh->vertexCount);
+        FreeStreamingRange(&streaming->indexPool, streamed->indexOffset, streamed->indexCount);
+        streamed->state = StreamingStateFailed;
+    }
+    else
+    {
+        mesh->baseVertex = streamed->vertexOffset;
+
+        UINT startIndex = streamed->indexOffset;
+        for (UINT lod = 0; lod < mesh->lodCount; lod++)
+        {
+            mesh->lods[lod].startIndex = startIndex;
+            startIndex += mesh->lods[lod].indexCount;
+        }
+
+        mesh->pending = false;
+
+        streaming->vertexUploads.push_back({ streamed->vertexOffset, mesh->vertexCount });
+        streaming->indexUploads.push_back({ streamed->indexOffset, streamed->indexCount });
+
+        streamed->state = StreamingStateResident;
+        streamed->lastUsedFrame = streaming->frame;
+
+        streaming->residentMeshCount++;
+        streaming->streamedBytes += static_cast<UINT64>(mesh->vertexCount) * sizeof(Vertex) + static_cast<UINT64>(streamed->indexCount) * sizeof(UINT);
+    }
+
+    delete request;
+}
+
+static void EvictStreamedMesh(StreamingSystem* streaming, UINT streamedIndex, Mesh* meshes)
+{
+    StreamedMesh* streamed = &streaming->streamedMeshes[streamedIndex];
+    Mesh* mesh = &meshes[streaming->firstMeshIndex + streamedIndex];
+
+    FreeStreamingRange(&streaming->vertexPool, streamed->vertexOffset, mesh->vertexCount);
+    FreeStreamingRange(&streaming->indexPool, streamed->indexOffset, streamed->indexCount);
+
+    mesh->pending = true;
+    streamed->state = StreamingStateMissing;
+
+    streaming->residentMeshCount--;
+    streaming->evictedMeshCount++;
+}
+
+// Reserva espao nos pools, despejando as malhas residentes usadas h mais tempo. S so despejadas malhas fora
+// dos quadros que a GPU ainda pode estar desenhando e menos urgentes que a pedida, para que duas malhas no
+// fiquem se expulsando. Devolve false se no houver mais o que despejar.
+static bool AllocateStreamedMesh(StreamingSystem* streaming, UINT streamedIndex, Mesh* meshes)
+{
+    StreamedMesh* streamed = &streaming->streamedMeshes[streamedIndex];
+    const UINT vertexCount = meshes[streaming->firstMeshIndex + streamedIndex].vertexCount;
+
+    for (;;)
+    {
+        if (AllocateStreamingRange(&streaming->vertexPool, vertexCount, &streamed->vertexOffset))
+        {
+            if (AllocateStreamingRange(&streaming->indexPool, streamed->indexCount, &streamed->indexOffset))
+                return true;
+
+            FreeStreamingRange(&streaming->vertexPool, streamed->vertexOffset, vertexCount);
+        }
+
+        UINT victim = UINT_MAX;
+        for (UINT i = 0; i < streaming->streamedMeshes.size(); i++)
+        {
+            const StreamedMesh* candidate = &streaming->streamedMeshes[i];
+            if (candidate->state != StreamingStateResident ||
+                candidate->lastUsedFrame + streaming->framesInFlight >= streaming->frame ||
+                !IsLessUrgent(candidate->priority, candidate->priorityKey, streamed->priority, streamed->priorityKey))
+            {
+                continue;
+            }
+
+            const StreamedMesh* best = (victim != UINT_MAX) ? &streaming->streamedMeshes[victim] : nullptr;
+            if (!best || candidate->lastUsedFrame < best->lastUsedFrame ||
+                (candidate->lastUsedFrame == best->lastUsedFrame && IsLessUrgent(candidate->priority, candidate->priorityKey, best->priority, best->priorityKey)))
+            {
+                victim = i;
+            }
+        }
+
+        if (victim == UINT_MAX)
+            return false;
+
+        EvictStreamedMesh(streaming, victim, meshes);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct StreamingTableReader
+{
+    JobSystem* jobSystem;
+    const Pak* pak;
+    const PakEntry* entry;
+};
+
+static bool ReadStreamingTable(void* context, UINT64 offset, UINT64 size, void* destination)
+{
+    const StreamingTableReader* reader = reinterpret_cast<const StreamingTableReader*>(context);
+    return ReadPakEntry(reader->jobSystem, reader->pak, reader->entry, offset, size, destination);
+}
+
+HRESULT OpenStreaming(StreamingSystem* streaming, JobSystem* jobSystem, const wchar_t* path, std::vector<Mesh>* meshes, std::vector<Model>* models)
+{
+    streaming->file = INVALID_HANDLE_VALUE;
+    streaming->completionPort = nullptr;
+    streaming->firstMeshIndex = static_cast<UINT>(meshes->size());
+    streaming->streamedMeshes.clear();
+    streaming->residentMeshCount = 0;
+    streaming->evictedMeshCount = 0;
+    streaming->streamedBytes = 0;
+    streaming->visibleMeshCount = 0;
+    streaming->missingMeshCount = 0;
+    streaming->stallFrameCount = 0;
+
+    HRESULT hr = OpenPak(path, &streaming->pak);
+    if (FAILED(hr))
+        return hr;
+
+    const Pak* pak = &streaming->pak;
+    for (UINT i = 0; i < pak->header->entryCount && SUCCEEDED(hr); i++)
+    {
+        const PakEntry* entry = &pak->entries[i];
+        const size_t length = strlen(entry->name);
+        if (length <= 6 || _stricmp(entry->name + length - 6, ".imesh") != 0)
+            continue;
+
+        BakedMeshHeader header;
+        std::vector<BakedMesh> bakedMeshes;
+        std::vector<BakedModel> bakedModels;
+
+        StreamingTableReader reader = { jobSystem, pak, entry };
+        hr = ReadBakedMeshTables(ReadStreamingTable, &reader, entry->size, &header, &bakedMeshes, &bakedModels);
+
+        const UINT meshBase = static_cast<UINT>(meshes->size());
+        for (UINT m = 0; m < bakedMeshes.size() && SUCCEEDED(hr); m++)
+        {
+            const BakedMesh& baked = bakedMeshes[m];
+
+            Mesh mesh = {};
+            mesh.vertexCount = baked.vertexCount;
+            mesh.lodCount = baked.lodCount;
+            mesh.boundsCenter = baked.boundsCenter;
+            mesh.boundsRadius = baked.boundsRadius;
+            mesh.pending = true;
+
+            StreamedMesh streamed = {};
+            streamed.entry = entry;
+            streamed.vertexSource = header.vertexOffset + static_cast<UINT64>(baked.baseVertex) * sizeof(Vertex);
+            streamed.indexSource = header.indexOffset;
+            streamed.state = StreamingStateMissing;
+
+            // O Cooker grava cada LOD numa faixa prpria da seo de ndices.
+            UINT64 indexCount = 0;
+            for (UINT lod = 0; lod < baked.lodCount; lod++)
+            {
+                mesh.lods[lod].indexCount = baked.lods[lod].indexCount;
+                mesh.lods[lod].error = baked.lods[lod].error;
+                streamed.sourceLods[lod] = baked.lods[lod];
+                indexCount += baked.lods[lod].indexCount;
+            }
+
+            if (indexCount > header.indexCount)
+            {
+                hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                break;
+            }
+
+            streamed.indexCount = static_cast<UINT>(indexCount);
+
+            meshes->push_back(mesh);
+            streaming->streamedMeshes.push_back(streamed);
+        }
+
+        for (UINT m = 0; m < bakedModels.size() && SUCCEEDED(hr); m++)
+        {
+            if (bakedModels[m].meshIndex >= bakedMeshes.size())
+                continue;
+
+            Model model = {};
+            model.meshIndex = meshBase + bakedModels[m].meshIndex;
+            model.world = bakedModels[m].world;
+            models->push_back(model);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        ClosePak(&streaming->pak);
+        return hr;
+    }
+
+    // Segunda abertura do pacote para leituras sobrepostas sem o cache do sistema; os blocos j esto alinhados
+    // a PakAlignment. Se falhar, as threads de streaming descomprimem do arquivo mapeado.
+    streaming->file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, nullptr);
+
+    return S_OK;
+}
+
+void StartStreaming(StreamingSystem* streaming, const StreamingSettings* settings, std::vector<Vertex>* vertices, std::vector<UINT>* indices, UINT vertexCapacity, UINT indexCapacity, UINT framesInFlight)
+{
+    const UINT vertexPoolSize = (std::min)(settings->vertexBudget, vertexCapacity);
+    const UINT indexPoolSize = (std::min)(settings->indexBudget, indexCapacity);
+
+    InitStreamingPool(&streaming->vertexPool, static_cast<UINT>(vertices->size()), vertexPoolSize);
+    InitStreamingPool(&streaming->indexPool, static_cast<UINT>(indices->size()), indexPoolSize);
+
+    vertices->resize(vertices->size() + vertexPoolSize);
+    indices->resize(indices->size() + indexPoolSize);
+
+    streaming->vertices = vertices->data();
+    streaming->indices = indices->data();
+
+    streaming->activeRequestCount = 0;
+    streaming->pendingReadCount = 0;
+    streaming->settings = *settings;
+    streaming->framesInFlight = framesInFlight;
+    streaming->frame = 0;
+
+    InitializeCriticalSection(&streaming->completedLock);
+
+    streaming->completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, StreamingThreadCount);
+    if (streaming->completionPort == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    if (streaming->file != INVALID_HANDLE_VALUE && CreateIoCompletionPort(streaming->file, streaming->completionPort, StreamingKeyRead, 0) == nullptr)
+    {
+        CloseHandle(streaming->file);
+        streaming->file = INVALID_HANDLE_VALUE;
+    }
+
+    for (UINT i = 0; i < StreamingThreadCount; i++)
+    {
+        streaming->threadHandles[i] = reinterpret_cast<HANDLE>(_beginthreadex(
+            nullptr,
+            0,
+            StreamingThread,
+            reinterpret_cast<LPVOID>(streaming),
+            0,
+            nullptr));
+    }
+}
+
+void UpdateStreaming(StreamingSystem* streaming, const LodView* lodView, XMFLOAT3 cameraVelocity, Mesh* meshes, const Model* models, UINT modelCount, const std::vector<DrawCommand>* drawList)
+{
+    streaming->frame++;
+    streaming->vertexUploads.clear();
+    streaming->indexUploads.clear();
+
+    const UINT firstMeshIndex = streaming->firstMeshIndex;
+    const UINT streamedCount = static_cast<UINT>(streaming->streamedMeshes.size());
+
+    for (const DrawCommand& draw : *drawList)
+    {
+        const UINT streamedIndex = models[draw.modelIndex].meshIndex - firstMeshIndex;
+        if (streamedIndex < streamedCount)
+            streaming->streamedMeshes[streamedIndex].lastUsedFrame = streaming->frame;
+    }
+
+    for (StreamedMesh& streamed : streaming->streamedMeshes)
+    {
+        streamed.priority = StreamingPriorityDistant;
+        streamed.priorityKey = FLT_MAX;
+    }
+
+    // A trajetria  extrapolada em linha reta e o frustum atual  deslocado para cada ponto. A esfera cresce
+    // meio passo para que os frustums amostrados cubram o volume varrido entre eles.
+    const XMVECTOR camera = XMLoadFloat3(&lodView->cameraPosition);
+    const XMVECTOR velocity = XMLoadFloat3(&cameraVelocity);
+    const float speed = XMVectorGetX(XMVector3Length(velocity));
+    const UINT prefetchSteps = (streaming->settings.prefetchSeconds > 0.0f && speed > 0.0f) ? streaming->settings.prefetchSteps : 0;
+    const float stepSeconds = (prefetchSteps > 0) ? streaming->settings.prefetchSeconds / prefetchSteps : 0.0f;
+    const float sweepRadius = 0.5f * speed * stepSeconds;
+
+    for (UINT i = 0; i < modelCount; i++)
+    {
+        const UINT streamedIndex = models[i].meshIndex - firstMeshIndex;
+        if (streamedIndex >= streamedCount)
+            continue;
+
+        const Mesh* mesh = &meshes[models[i].meshIndex];
+        const XMMATRIX world = XMLoadFloat4x4(&models[i].world);
+        const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&mesh->boundsCenter), world);
+
+        const float scale = (std::max)((std::max)(
+            XMVectorGetX(XMVector3Length(world.r[0])),
+            XMVectorGetX(XMVector3Length(world.r[1]))),
+            XMVectorGetX(XMVector3Length(world.r[2])));
+        const float radius = mesh->boundsRadius * scale;
+
+        StreamingPriority priority = StreamingPriorityDistant;
+        float priorityKey = (std::max)(XMVectorGetX(XMVector3Length(XMVectorSubtract(center, camera))) - radius, 0.0f);
+
+        if (IsSphereInFrustum(lodView->frustumPlanes, center, radius))
+        {
+            priority = StreamingPriorityVisible;
+        }
+        else
+        {
+            for (UINT step = 1; step <= prefetchSteps; step++)
+            {
+                const float seconds = step * stepSeconds;
+                if (IsSphereInFrustum(lodView->frustumPlanes, XMVectorSubtract(center, XMVectorScale(velocity, seconds)), radius + sweepRadius))
+                {
+                    priority = StreamingPriorityPredicted;
+                    priorityKey = seconds;
+                    break;
+                }
+            }
+        }
+
+        StreamedMesh* streamed = &streaming->streamedMeshes[streamedIndex];
+        if (IsLessUrgent(streamed->priority, streamed->priorityKey, priority, priorityKey))
+        {
+            streamed->priority = priority;
+            streamed->priorityKey = priorityKey;
+        }
+    }
+
+    // Estatsticas do que este quadro desenhou, antes de publicar as malhas que acabaram de chegar.
+    UINT missingCount = 0;
+    for (const StreamedMesh& streamed : streaming->streamedMeshes)
+    {
+        if (streamed.priority != StreamingPriorityVisible)
+            continue;
+
+        streaming->visibleMeshCount++;
+        if (streamed.state != StreamingStateResident)
+            missingCount++;
+    }
+
+    streaming->missingMeshCount += missingCount;
+    if (missingCount > 0)
+        streaming->stallFrameCount++;
+
+    // Malhas que terminaram de chegar entram na drawList a partir do prximo quadro.
+    std::vector<StreamingRequest*> completed;
+    EnterCriticalSection(&streaming->completedLock);
+    completed.swap(streaming->completedRequests);
+    LeaveCriticalSection(&streaming->completedLock);
+
+    for (StreamingRequest* request : completed)
+    {
+        PublishStreamedMesh(streaming, request, meshes);
+    }
+
+    if (streaming->activeRequestCount < MaxStreamingRequests)
+    {
+        std::vector<StreamingCandidate> queue;
+        for (UINT i = 0; i < streamedCount; i++)
+        {
+            const StreamedMesh* streamed = &streaming->streamedMeshes[i];
+            if (streamed->state == StreamingStateMissing && streamed->priorityKey < FLT_MAX)
+                queue.push_back({ streamed->priority, streamed->priorityKey, i });
+        }
+
+        std::make_heap(queue.begin(), queue.end(), IsLessUrgentCandidate);
+
+        while (!queue.empty() && streaming->activeRequestCount < MaxStreamingRequests)
+        {
+            std::pop_heap(queue.begin(), queue.end(), IsLessUrgentCandidate);
+            const UINT streamedIndex = queue.back().streamedIndex;
+            queue.pop_back();
+
+            const Mesh* mesh = &meshes[firstMeshIndex + streamedIndex];
+            StreamedMesh* streamed = &streaming->streamedMeshes[streamedIndex];
+
+            // Malhas maiores que os pools nunca vo caber.
+            if (mesh->vertexCount > streaming->vertexPool.size || streamed->indexCount > streaming->indexPool.size)
+            {
+                streamed->state = StreamingStateFailed;
+                continue;
+            }
+
+            if (!AllocateStreamedMesh(streaming, streamedIndex, meshes))
+                break;
+
+            RequestStreamedMesh(streaming, streamedIndex, mesh);
+        }
+    }
+}
+
+void DestroyStreaming(StreamingSystem* streaming)
+{
+    // Leituras em andamento so canceladas; as threads ainda recebem as concluses antes de sair.
+    if (streaming->file != INVALID_HANDLE_VALUE)
+        CancelIoEx(streaming->file, nullptr);
+
+    while (InterlockedCompareExchange(&streaming->pendingReadCount, 0, 0) > 0)
+    {
+        Sleep(1);
+    }
+
+    for (UINT i = 0; i < StreamingThreadCount; i++)
+    {
+        PostQueuedCompletionStatus(streaming->completionPort, 0, StreamingKeyQuit, nullptr);
+    }
+
+    WaitForMultipleObjects(StreamingThreadCount, streaming->threadHandles, TRUE, INFINITE);
+
+    for (UINT i = 0; i < StreamingThreadCount; i++)
+    {
+        CloseHandle(streaming->threadHandles[i]);
+    }
+
+    for (StreamingRequest* request : streaming->completedRequests)
+    {
+        delete request;
+    }
+    streaming->completedRequests.clear();
+
+    CloseHandle(streaming->completionPort);
+    if (streaming->file != INVALID_HANDLE_VALUE)
+        CloseHandle(streaming->file);
+
+    ClosePak(&streaming->pak);
+    DeleteCriticalSection(&streaming->completedLock);
+}
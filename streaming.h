@@ -0,0 +1,138 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+#include "lodselect.h"
+#include "pakfile.h"
+
+#include <vector>
+
+// Streaming das malhas de um pacote (.pak). Na abertura s as tabelas de cada .imesh so lidas: as malhas entram
+// na cena como pendentes e os vrtices e ndices chegam depois, em pools reservados no fim dos vetores da cena.
+// As leituras so sobrepostas (IOCP, sem o cache do sistema) e a descompresso roda em threads prprias, ento o
+// quadro nunca espera pelo disco. Se o pacote no puder ser aberto assim, as mesmas threads descomprimem os blocos
+// direto do arquivo mapeado.
+
+const UINT StreamingThreadCount = 2;
+
+// Malhas sendo lidas ao mesmo tempo.
+const UINT MaxStreamingRequests = 8;
+
+struct StreamingSettings
+{
+    float prefetchSeconds;          // Quanto  frente a trajetria da cmera  extrapolada (0 desliga a previso).
+    UINT prefetchSteps;             // Frustums testados ao longo da trajetria prevista.
+    UINT vertexBudget;              // Tamanho mximo dos pools, em vrtices e ndices.
+    UINT indexBudget;
+};
+
+const StreamingSettings DefaultStreamingSettings = { 2.0f, 8, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+
+enum StreamingState
+{
+    StreamingStateMissing,
+    StreamingStateLoading,
+    StreamingStateResident,
+    StreamingStateFailed
+};
+
+// Classes de prioridade, da mais urgente para a menos.
+enum StreamingPriority
+{
+    StreamingPriorityVisible,       // No frustum atual: por distncia.
+    StreamingPriorityPredicted,     // Num dos frustums previstos: pelo tempo at entrar.
+    StreamingPriorityDistant        // Fora dos dois: por distncia.
+};
+
+struct StreamingRange
+{
+    UINT offset;
+    UINT count;
+};
+
+// Faixa de um vetor da cena. Os livres ficam ordenados por offset: alocao first fit e fuso com os vizinhos
+// na liberao.
+struct StreamingPool
+{
+    UINT base;
+    UINT size;
+    std::vector<StreamingRange> freeRanges;
+};
+
+struct StreamedMesh
+{
+    const PakEntry* entry;
+
+    // Offsets dentro do asset: primeiro vrtice da malha e incio da seo de ndices.
+    UINT64 vertexSource;
+    UINT64 indexSource;
+    MeshLod sourceLods[MaxLodCount];
+
+    // Posio nos vetores da cena enquanto carregada. Os LODs ficam em sequncia a partir de indexOffset.
+    StreamingState state;
+    UINT vertexOffset;
+    UINT indexOffset;
+    UINT indexCount;
+
+    UINT64 lastUsedFrame;
+    StreamingPriority priority;
+    float priorityKey;
+};
+
+struct StreamingRequest;
+
+struct StreamingSystem
+{
+    Pak pak;
+    HANDLE file;
+    HANDLE completionPort;
+    HANDLE threadHandles[StreamingThreadCount];
+
+    Vertex* vertices;
+    UINT* indices;
+    StreamingPool vertexPool;
+    StreamingPool indexPool;
+
+    // As malhas do pacote ocupam meshes[firstMeshIndex, firstMeshIndex + streamedMeshes.size()).
+    UINT firstMeshIndex;
+    std::vector<StreamedMesh> streamedMeshes;
+
+    CRITICAL_SECTION completedLock;
+    std::vector<StreamingRequest*> completedRequests;
+    UINT activeRequestCount;
+    volatile LONG pendingReadCount;
+
+    StreamingSettings settings;
+    UINT framesInFlight;
+    UINT64 frame;
+
+    // Faixas dos vetores da cena publicadas no ltimo UpdateStreaming, que precisam ser enviadas para a GPU.
+    std::vector<StreamingRange> vertexUploads;
+    std::vector<StreamingRange> indexUploads;
+
+    UINT residentMeshCount;
+    UINT evictedMeshCount;
+    UINT64 streamedBytes;
+
+    // Acerto: malhas no frustum que j estavam carregadas. Quadros com alguma malha visvel faltando contam como
+    // travamento (o quadro no espera, mas a malha some da tela).
+    UINT64 visibleMeshCount;
+    UINT64 missingMeshCount;
+    UINT stallFrameCount;
+};
+
+// Abre o pacote e anexa as malhas (pendentes) e os modelos de cada .imesh aos vetores da cena.
+HRESULT OpenStreaming(StreamingSystem* streaming, JobSystem* jobSystem, const wchar_t* path, std::vector<Mesh>* meshes, std::vector<Model>* models);
+
+// Reserva os pools no fim dos vetores da cena, que no podem mais mudar de tamanho, e inicia as threads. Os pools
+// tm o tamanho pedido ou o do oramento em settings, o que for menor. Malhas s so despejadas depois de
+// framesInFlight quadros sem serem desenhadas.
+void StartStreaming(StreamingSystem* streaming, const StreamingSettings* settings, std::vector<Vertex>* vertices, std::vector<UINT>* indices, UINT vertexCapacity, UINT indexCapacity, UINT framesInFlight);
+
+// Chamada uma vez por quadro, depois de montada a drawList. Publica as malhas que chegaram, marca as desenhadas e
+// pede as que faltam por ordem de prioridade: as do frustum atual, depois as que entram no frustum ao longo da
+// trajetria extrapolada de cameraVelocity, depois as demais por distncia. Quando os pools enchem, despeja as
+// menos usadas. Nunca espera por leituras. As faixas publicadas ficam em vertexUploads e indexUploads.
+void UpdateStreaming(StreamingSystem* streaming, const LodView* lodView, XMFLOAT3 cameraVelocity, Mesh* meshes, const Model* models, UINT modelCount, const std::vector<DrawCommand>* drawList);
+
+void DestroyStreaming(StreamingSystem* streaming);
@@ -0,0 +1,300 @@
+#pragma once
+
+// Subconjunto do DirectXMath usado pelos mdulos testados, com a mesma interface, para compilar os testes fora
+// do Windows (tests/CMakeLists.txt). No Windows os testes usam o DirectXMath do SDK.
+
+#include <math.h>
+#include <stdint.h>
+
+namespace DirectX
+{
+
+const float XM_PI = 3.141592654f;
+
+// Quatro floats num registro, com as operaes por componente das extenses de vetor do GCC e do Clang. As
+// comparaes devolvem mscaras de 32 bits, como no SDK.
+typedef float XMVECTOR __attribute__((vector_size(16)));
+typedef int32_t XMVECTORI __attribute__((vector_size(16)));
+typedef const XMVECTOR FXMVECTOR;
+
+// Conveno de vetor-linha, como no SDK: r[3]  a translao.
+struct XMMATRIX
+{
+    XMVECTOR r[4];
+};
+
+typedef const XMMATRIX& FXMMATRIX;
+typedef const XMMATRIX& CXMMATRIX;
+
+struct XMFLOAT3
+{
+    float x, y, z;
+
+    XMFLOAT3() = default;
+    constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+struct XMFLOAT4
+{
+    float x, y, z, w;
+
+    XMFLOAT4() = default;
+    constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+};
+
+struct XMUINT2
+{
+    uint32_t x, y;
+
+    XMUINT2() = default;
+    constexpr XMUINT2(uint32_t x, uint32_t y) : x(x), y(y) {}
+};
+
+struct XMUINT4
+{
+    uint32_t x, y, z, w;
+};
+
+struct XMFLOAT4X4
+{
+    union
+    {
+        struct
+        {
+            float _11, _12, _13, _14;
+            float _21, _22, _23, _24;
+            float _31, _32, _33, _34;
+            float _41, _42, _43, _44;
+        };
+        float m[4][4];
+    };
+};
+
+// -----------------------------------------------------------------------------------------------------
+
+inline XMVECTOR XMVectorSet(float x, float y, float z, float w) { return XMVECTOR{ x, y, z, w }; }
+inline XMVECTOR XMVectorReplicate(float value) { return XMVECTOR{ value, value, value, value }; }
+inline XMVECTOR XMVectorZero() { return XMVECTOR{ 0.0f, 0.0f, 0.0f, 0.0f }; }
+inline float XMVectorGetX(FXMVECTOR v) { return v[0]; }
+inline float XMVectorGetY(FXMVECTOR v) { return v[1]; }
+inline float XMVectorGetZ(FXMVECTOR v) { return v[2]; }
+
+inline XMVECTOR XMLoadFloat3(const XMFLOAT3* source) { return XMVECTOR{ source->x, source->y, source->z, 0.0f }; }
+inline XMVECTOR XMLoadFloat4(const XMFLOAT4* source) { return XMVECTOR{ source->x, source->y, source->z, source->w }; }
+inline void XMStoreFloat3(XMFLOAT3* destination, FXMVECTOR v) { *destination = XMFLOAT3(v[0], v[1], v[2]); }
+inline void XMStoreFloat4(XMFLOAT4* destination, FXMVECTOR v) { *destination = XMFLOAT4(v[0], v[1], v[2], v[3]); }
+
+inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b) { return a + b; }
+inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b) { return a - b; }
+inline XMVECTOR XMVectorMultiply(FXMVECTOR a, FXMVECTOR b) { return a * b; }
+inline XMVECTOR XMVectorDivide(FXMVECTOR a, FXMVECTOR b) { return a / b; }
+inline XMVECTOR XMVectorScale(FXMVECTOR v, float scale) { return v * scale; }
+inline XMVECTOR XMVectorLerp(FXMVECTOR a, FXMVECTOR b, float t) { return a + (b - a) * t; }
+
+inline XMVECTOR XMVectorMin(FXMVECTOR a, FXMVECTOR b) { return a < b ? a : b; }
+inline XMVECTOR XMVectorMax(FXMVECTOR a, FXMVECTOR b) { return a > b ? a : b; }
+inline XMVECTOR XMVectorClamp(FXMVECTOR v, FXMVECTOR low, FXMVECTOR high) { return XMVectorMin(XMVectorMax(v, low), high); }
+
+inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c) { return a * b + c; }
+inline XMVECTOR XMVectorNegate(FXMVECTOR v) { return -v; }
+inline XMVECTOR XMVectorAbs(FXMVECTOR v) { return reinterpret_cast<XMVECTOR>(reinterpret_cast<XMVECTORI>(v) & 0x7fffffff); }
+inline XMVECTOR XMVectorSqrt(FXMVECTOR v) { return XMVECTOR{ sqrtf(v[0]), sqrtf(v[1]), sqrtf(v[2]), sqrtf(v[3]) }; }
+
+inline XMVECTOR XMVectorGreater(FXMVECTOR a, FXMVECTOR b) { return reinterpret_cast<XMVECTOR>(a > b); }
+inline XMVECTOR XMVectorGreaterOrEqual(FXMVECTOR a, FXMVECTOR b) { return reinterpret_cast<XMVECTOR>(a >= b); }
+inline XMVECTOR XMVectorLess(FXMVECTOR a, FXMVECTOR b) { return reinterpret_cast<XMVECTOR>(a < b); }
+inline XMVECTOR XMVectorLessOrEqual(FXMVECTOR a, FXMVECTOR b) { return reinterpret_cast<XMVECTOR>(a <= b); }
+
+inline XMVECTOR XMVectorAndInt(FXMVECTOR a, FXMVECTOR b)
+{
+    return reinterpret_cast<XMVECTOR>(reinterpret_cast<XMVECTORI>(a) & reinterpret_cast<XMVECTORI>(b));
+}
+
+// Os bits de a onde b  0.
+inline XMVECTOR XMVectorAndCInt(FXMVECTOR a, FXMVECTOR b)
+{
+    return reinterpret_cast<XMVECTOR>(reinterpret_cast<XMVECTORI>(a) & ~reinterpret_cast<XMVECTORI>(b));
+}
+
+inline void XMStoreUInt4(XMUINT4* destination, FXMVECTOR v)
+{
+    const XMVECTORI bits = reinterpret_cast<XMVECTORI>(v);
+    *destination = { static_cast<uint32_t>(bits[0]), static_cast<uint32_t>(bits[1]), static_cast<uint32_t>(bits[2]), static_cast<uint32_t>(bits[3]) };
+}
+
+// Os bits de b onde control  1, os de a no resto.
+inline XMVECTOR XMVectorSelect(FXMVECTOR a, FXMVECTOR b, FXMVECTOR control)
+{
+    const XMVECTORI mask = reinterpret_cast<XMVECTORI>(control);
+    return reinterpret_cast<XMVECTOR>((reinterpret_cast<XMVECTORI>(a) & ~mask) | (reinterpret_cast<XMVECTORI>(b) & mask));
+}
+
+inline XMVECTOR XMVector3Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a[0] * b[0] + a[1] * b[1] + a[2] * b[2]); }
+inline XMVECTOR XMVector3LengthSq(FXMVECTOR v) { return XMVector3Dot(v, v); }
+inline XMVECTOR XMVector3Length(FXMVECTOR v) { return XMVectorReplicate(sqrtf(XMVectorGetX(XMVector3Dot(v, v)))); }
+
+inline XMVECTOR XMVector3Cross(FXMVECTOR a, FXMVECTOR b)
+{
+    return XMVECTOR{ a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0], 0.0f };
+}
+
+// Como no SDK, o vetor nulo continua nulo.
+inline XMVECTOR XMVector3Normalize(FXMVECTOR v)
+{
+    const float length = XMVectorGetX(XMVector3Length(v));
+    return length > 0.0f ? v / length : XMVectorZero();
+}
+
+inline bool XMVector3LessOrEqual(FXMVECTOR a, FXMVECTOR b) { return a[0] <= b[0] && a[1] <= b[1] && a[2] <= b[2]; }
+inline bool XMVector3GreaterOrEqual(FXMVECTOR a, FXMVECTOR b) { return a[0] >= b[0] && a[1] >= b[1] && a[2] >= b[2]; }
+
+inline XMVECTOR XMPlaneDotCoord(FXMVECTOR plane, FXMVECTOR v) { return XMVectorReplicate(XMVectorGetX(XMVector3Dot(plane, v)) + plane[3]); }
+
+// Divide o plano pelo comprimento da normal.
+inline XMVECTOR XMPlaneNormalize(FXMVECTOR plane)
+{
+    const float length = XMVectorGetX(XMVector3Length(plane));
+    return length > 0.0f ? plane / length : XMVectorZero();
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+inline XMMATRIX XMMatrixIdentity()
+{
+    return XMMATRIX{ { XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) } };
+}
+
+inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* source)
+{
+    XMMATRIX matrix;
+    for (int i = 0; i < 4; i++)
+        matrix.r[i] = XMVectorSet(source->m[i][0], source->m[i][1], source->m[i][2], source->m[i][3]);
+    return matrix;
+}
+
+inline void XMStoreFloat4x4(XMFLOAT4X4* destination, FXMMATRIX matrix)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+            destination->m[i][j] = matrix.r[i][j];
+    }
+}
+
+// (x, y, z, 1) vezes a matriz.
+inline XMVECTOR XMVector3Transform(FXMVECTOR v, FXMMATRIX matrix)
+{
+    return matrix.r[0] * v[0] + matrix.r[1] * v[1] + matrix.r[2] * v[2] + matrix.r[3];
+}
+
+inline XMVECTOR XMVector3TransformNormal(FXMVECTOR v, FXMMATRIX matrix)
+{
+    return matrix.r[0] * v[0] + matrix.r[1] * v[1] + matrix.r[2] * v[2];
+}
+
+inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX matrix)
+{
+    return matrix.r[0] * v[0] + matrix.r[1] * v[1] + matrix.r[2] * v[2] + matrix.r[3] * v[3];
+}
+
+inline XMVECTOR XMVector3TransformCoord(FXMVECTOR v, FXMMATRIX matrix)
+{
+    const XMVECTOR result = XMVector3Transform(v, matrix);
+    return result / result[3];
+}
+
+inline XMMATRIX XMMatrixTranspose(FXMMATRIX matrix)
+{
+    XMMATRIX result;
+    for (int i = 0; i < 4; i++)
+        result.r[i] = XMVectorSet(matrix.r[0][i], matrix.r[1][i], matrix.r[2][i], matrix.r[3][i]);
+    return result;
+}
+
+// a e depois b: cada linha de a vezes b.
+inline XMMATRIX XMMatrixMultiply(FXMMATRIX a, CXMMATRIX b)
+{
+    XMMATRIX result;
+    for (int i = 0; i < 4; i++)
+        result.r[i] = b.r[0] * a.r[i][0] + b.r[1] * a.r[i][1] + b.r[2] * a.r[i][2] + b.r[3] * a.r[i][3];
+    return result;
+}
+
+// Pelos cofatores. Como no SDK, uma matriz singular d infinitos ou NaN, e determinant recebe 0.
+inline XMMATRIX XMMatrixInverse(XMVECTOR* determinant, FXMMATRIX matrix)
+{
+    float m[16];
+    for (int i = 0; i < 16; i++)
+        m[i] = matrix.r[i / 4][i % 4];
+
+    float inverse[16];
+    inverse[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inverse[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inverse[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inverse[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inverse[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inverse[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inverse[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inverse[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inverse[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inverse[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inverse[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inverse[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inverse[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inverse[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inverse[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inverse[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    const float value = m[0] * inverse[0] + m[1] * inverse[4] + m[2] * inverse[8] + m[3] * inverse[12];
+    if (determinant)
+        *determinant = XMVectorReplicate(value);
+
+    XMMATRIX result;
+    for (int i = 0; i < 4; i++)
+        result.r[i] = XMVectorSet(inverse[i * 4], inverse[i * 4 + 1], inverse[i * 4 + 2], inverse[i * 4 + 3]) / value;
+    return result;
+}
+
+// Caixa [left, right] x [bottom, top] x [nearZ, farZ] para [-1, 1] x [-1, 1] x [0, 1], mo esquerda.
+inline XMMATRIX XMMatrixOrthographicOffCenterLH(float left, float right, float bottom, float top, float nearZ, float farZ)
+{
+    const float width = 1.0f / (right - left);
+    const float height = 1.0f / (top - bottom);
+    const float range = 1.0f / (farZ - nearZ);
+
+    return XMMATRIX{ {
+        XMVectorSet(2.0f * width, 0.0f, 0.0f, 0.0f),
+        XMVectorSet(0.0f, 2.0f * height, 0.0f, 0.0f),
+        XMVectorSet(0.0f, 0.0f, range, 0.0f),
+        XMVectorSet(-(left + right) * width, -(top + bottom) * height, -range * nearZ, 1.0f) } };
+}
+
+// Perspectiva com fov vertical em radianos, z de nearZ a farZ para [0, 1], mo esquerda.
+inline XMMATRIX XMMatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+{
+    const float height = 1.0f / tanf(0.5f * fovAngleY);
+    const float range = farZ / (farZ - nearZ);
+
+    return XMMATRIX{ {
+        XMVectorSet(height / aspectRatio, 0.0f, 0.0f, 0.0f),
+        XMVectorSet(0.0f, height, 0.0f, 0.0f),
+        XMVectorSet(0.0f, 0.0f, range, 1.0f),
+        XMVectorSet(0.0f, 0.0f, -range * nearZ, 0.0f) } };
+}
+
+// Cmera em eye olhando na direo eyeDirection, mo esquerda.
+inline XMMATRIX XMMatrixLookToLH(FXMVECTOR eye, FXMVECTOR eyeDirection, FXMVECTOR up)
+{
+    const XMVECTOR r2 = XMVector3Normalize(eyeDirection);
+    const XMVECTOR r0 = XMVector3Normalize(XMVector3Cross(up, r2));
+    const XMVECTOR r1 = XMVector3Cross(r2, r0);
+    const XMVECTOR negativeEye = -eye;
+
+    return XMMATRIX{ {
+        XMVectorSet(r0[0], r1[0], r2[0], 0.0f),
+        XMVectorSet(r0[1], r1[1], r2[1], 0.0f),
+        XMVectorSet(r0[2], r1[2], r2[2], 0.0f),
+        XMVectorSet(XMVectorGetX(XMVector3Dot(r0, negativeEye)), XMVectorGetX(XMVector3Dot(r1, negativeEye)), XMVectorGetX(XMVector3Dot(r2, negativeEye)), 1.0f) } };
+}
+
+}
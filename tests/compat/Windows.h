@@ -0,0 +1,424 @@
+#pragma once
+
+// Subconjunto do Win32 usado pelos mdulos testados, sobre POSIX. S entra no include path dos testes fora do
+// Windows (tests/CMakeLists.txt); no Windows os testes usam o SDK.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint16_t USHORT;
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int64_t LONG64;
+typedef int64_t LONGLONG;
+typedef uint32_t DWORD;
+typedef int32_t BOOL;
+typedef size_t SIZE_T;
+typedef void* HANDLE;
+typedef void* LPVOID;
+typedef int32_t HRESULT;
+
+#define TRUE 1
+#define FALSE 0
+#define WINAPI
+#define INFINITE 0xffffffff
+
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define HRESULT_FROM_WIN32(error) ((error) == 0 ? S_OK : (HRESULT)(((error) & 0x0000FFFF) | 0x80070000))
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+
+union LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+};
+
+// -----------------------------------------------------------------------------------------------------
+
+template <size_t size>
+inline int sprintf_s(char (&buffer)[size], const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    const int result = vsnprintf(buffer, size, format, arguments);
+    va_end(arguments);
+    return result;
+}
+
+// Contador em nanossegundos.
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+    frequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    counter->QuadPart = static_cast<LONGLONG>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    return TRUE;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Sincronizao do pool de jobs (jobs.cpp). Cada HANDLE  um CompatObject: semforo, evento ou thread, ou, mais
+// abaixo, arquivo e mapeamento; s o que jobs.cpp usa (espera infinita, WaitForMultipleObjects s em threads).
+
+struct CRITICAL_SECTION
+{
+    pthread_mutex_t mutex;
+};
+
+struct SYSTEM_INFO
+{
+    DWORD dwNumberOfProcessors;
+};
+
+enum CompatObjectType
+{
+    CompatSemaphore,
+    CompatEvent,
+    CompatThread,
+    CompatFile,
+    CompatFileMapping,
+};
+
+struct CompatObject
+{
+    CompatObjectType type;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    LONG count;                 // Semforo: a contagem; evento: 1 se sinalizado.
+    BOOL manualReset;
+    pthread_t thread;
+    int descriptor;             // Arquivo e mapeamento (que s empresta o do arquivo).
+};
+
+inline void InitializeCriticalSection(CRITICAL_SECTION* section) { pthread_mutex_init(&section->mutex, nullptr); }
+inline void DeleteCriticalSection(CRITICAL_SECTION* section) { pthread_mutex_destroy(&section->mutex); }
+inline void EnterCriticalSection(CRITICAL_SECTION* section) { pthread_mutex_lock(&section->mutex); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* section) { pthread_mutex_unlock(&section->mutex); }
+
+inline LONG InterlockedIncrement(volatile LONG* value) { return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedDecrement(volatile LONG* value) { return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchange(volatile LONG* target, LONG value) { return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST); }
+
+inline LONG InterlockedCompareExchange(volatile LONG* destination, LONG exchange, LONG comparand)
+{
+    __atomic_compare_exchange_n(destination, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+// O errno da ltima chamada que falhou.
+inline DWORD GetLastError() { return static_cast<DWORD>(errno); }
+
+inline void GetSystemInfo(SYSTEM_INFO* systemInfo)
+{
+    const long processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+    systemInfo->dwNumberOfProcessors = processorCount > 0 ? static_cast<DWORD>(processorCount) : 1;
+}
+
+inline CompatObject* CreateCompatObject(CompatObjectType type, LONG count, BOOL manualReset)
+{
+    CompatObject* object = new CompatObject;
+    object->type = type;
+    pthread_mutex_init(&object->mutex, nullptr);
+    pthread_cond_init(&object->condition, nullptr);
+    object->count = count;
+    object->manualReset = manualReset;
+    object->descriptor = -1;
+    return object;
+}
+
+inline HANDLE CreateSemaphore(void*, LONG initialCount, LONG, const char*)
+{
+    return CreateCompatObject(CompatSemaphore, initialCount, FALSE);
+}
+
+inline HANDLE CreateEvent(void*, BOOL manualReset, BOOL initialState, const char*)
+{
+    return CreateCompatObject(CompatEvent, initialState ? 1 : 0, manualReset);
+}
+
+inline BOOL ReleaseSemaphore(HANDLE semaphore, LONG releaseCount, LONG*)
+{
+    CompatObject* object = reinterpret_cast<CompatObject*>(semaphore);
+    pthread_mutex_lock(&object->mutex);
+    object->count += releaseCount;
+    pthread_cond_broadcast(&object->condition);
+    pthread_mutex_unlock(&object->mutex);
+    return TRUE;
+}
+
+inline BOOL SetEvent(HANDLE event)
+{
+    CompatObject* object = reinterpret_cast<CompatObject*>(event);
+    pthread_mutex_lock(&object->mutex);
+    object->count = 1;
+    pthread_cond_broadcast(&object->condition);
+    pthread_mutex_unlock(&object->mutex);
+    return TRUE;
+}
+
+inline BOOL ResetEvent(HANDLE event)
+{
+    CompatObject* object = reinterpret_cast<CompatObject*>(event);
+    pthread_mutex_lock(&object->mutex);
+    object->count = 0;
+    pthread_mutex_unlock(&object->mutex);
+    return TRUE;
+}
+
+// S espera infinita. Uma thread  esperada com join, uma vez.
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD)
+{
+    CompatObject* object = reinterpret_cast<CompatObject*>(handle);
+    if (object->type == CompatThread)
+    {
+        if (object->count == 0)
+        {
+            pthread_join(object->thread, nullptr);
+            object->count = 1;
+        }
+        return 0;
+    }
+
+    pthread_mutex_lock(&object->mutex);
+    while (object->count == 0)
+    {
+        pthread_cond_wait(&object->condition, &object->mutex);
+    }
+
+    if (object->type == CompatSemaphore || !object->manualReset)
+        object->count--;
+
+    pthread_mutex_unlock(&object->mutex);
+    return 0;
+}
+
+inline DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL, DWORD milliseconds)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        WaitForSingleObject(handles[i], milliseconds);
+    }
+    return 0;
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+    CompatObject* object = reinterpret_cast<CompatObject*>(handle);
+    if (object->type == CompatThread && object->count == 0)
+        pthread_detach(object->thread);
+    if (object->type == CompatFile)
+        close(object->descriptor);
+
+    pthread_mutex_destroy(&object->mutex);
+    pthread_cond_destroy(&object->condition);
+    delete object;
+    return TRUE;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Arquivos e mapeamentos somente leitura (mappedfile.cpp). Os caminhos passam para multibyte pelo locale do
+// processo, ento os testes usam caminhos ASCII.
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x00000001
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define PAGE_READONLY 0x02
+#define FILE_MAP_READ 0x0004
+
+#define ERROR_INVALID_DATA 13L
+#define CP_UTF8 65001
+
+inline HANDLE CreateFile(const wchar_t* path, DWORD access, DWORD, void*, DWORD creation, DWORD flags, HANDLE)
+{
+    char name[PATH_MAX];
+    if (wcstombs(name, path, sizeof(name)) >= sizeof(name))
+    {
+        errno = ENAMETOOLONG;
+        return INVALID_HANDLE_VALUE;
+    }
+
+    const int mode = (access & GENERIC_WRITE) ? ((access & GENERIC_READ) ? O_RDWR : O_WRONLY) : O_RDONLY;
+    const int descriptor = open(name, mode | (creation == CREATE_ALWAYS ? O_CREAT | O_TRUNC : 0), 0644);
+    if (descriptor < 0)
+        return INVALID_HANDLE_VALUE;
+
+    if (flags & FILE_FLAG_SEQUENTIAL_SCAN)
+        posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    CompatObject* object = CreateCompatObject(CompatFile, 0, FALSE);
+    object->descriptor = descriptor;
+    return object;
+}
+
+inline BOOL DeleteFile(const wchar_t* path)
+{
+    char name[PATH_MAX];
+    if (wcstombs(name, path, sizeof(name)) >= sizeof(name))
+        return FALSE;
+
+    return unlink(name) == 0;
+}
+
+inline BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+    struct stat status;
+    if (fstat(reinterpret_cast<CompatObject*>(file)->descriptor, &status) != 0)
+        return FALSE;
+
+    size->QuadPart = status.st_size;
+    return TRUE;
+}
+
+inline BOOL WriteFile(HANDLE file, const void* data, DWORD size, DWORD* written, void*)
+{
+    const BYTE* bytes = reinterpret_cast<const BYTE*>(data);
+    *written = 0;
+    while (*written < size)
+    {
+        const ssize_t result = write(reinterpret_cast<CompatObject*>(file)->descriptor, bytes + *written, size - *written);
+        if (result < 0)
+            return FALSE;
+
+        *written += static_cast<DWORD>(result);
+    }
+
+    return TRUE;
+}
+
+// S o arquivo inteiro, somente leitura.
+inline HANDLE CreateFileMapping(HANDLE file, void*, DWORD, DWORD, DWORD, const wchar_t*)
+{
+    CompatObject* object = CreateCompatObject(CompatFileMapping, 0, FALSE);
+    object->descriptor = reinterpret_cast<CompatObject*>(file)->descriptor;
+    return object;
+}
+
+// munmap precisa do tamanho, que UnmapViewOfFile no recebe: as vistas abertas ficam numa lista.
+struct CompatView
+{
+    const void* address;
+    size_t size;
+};
+
+inline std::vector<CompatView>* GetCompatViews(pthread_mutex_t** mutex)
+{
+    static pthread_mutex_t viewMutex = PTHREAD_MUTEX_INITIALIZER;
+    static std::vector<CompatView> views;
+    *mutex = &viewMutex;
+    return &views;
+}
+
+inline void* MapViewOfFile(HANDLE mapping, DWORD, DWORD, DWORD, SIZE_T)
+{
+    const int descriptor = reinterpret_cast<CompatObject*>(mapping)->descriptor;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+        return nullptr;
+
+    const size_t size = static_cast<size_t>(status.st_size);
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (address == MAP_FAILED)
+        return nullptr;
+
+    pthread_mutex_t* mutex;
+    std::vector<CompatView>* views = GetCompatViews(&mutex);
+    pthread_mutex_lock(mutex);
+    views->push_back({ address, size });
+    pthread_mutex_unlock(mutex);
+
+    return address;
+}
+
+inline BOOL UnmapViewOfFile(const void* address)
+{
+    pthread_mutex_t* mutex;
+    std::vector<CompatView>* views = GetCompatViews(&mutex);
+    pthread_mutex_lock(mutex);
+
+    BOOL result = FALSE;
+    for (size_t i = 0; i < views->size(); i++)
+    {
+        if ((*views)[i].address == address)
+        {
+            result = munmap(const_cast<void*>(address), (*views)[i].size) == 0;
+            (*views)[i] = views->back();
+            views->pop_back();
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(mutex);
+    return result;
+}
+
+// S UTF-8, sem validao: o tamanho de cada sequncia vem do primeiro byte.
+inline int MultiByteToWideChar(UINT, DWORD, const char* source, int sourceLength, wchar_t* destination, int destinationLength)
+{
+    const BYTE* p = reinterpret_cast<const BYTE*>(source);
+    const BYTE* end = p + sourceLength;
+
+    int count = 0;
+    while (p < end)
+    {
+        const int length = (*p < 0x80) ? 1 : (*p < 0xE0) ? 2 : (*p < 0xF0) ? 3 : 4;
+        UINT code = (length == 1) ? *p : *p & (0x7F >> length);
+        for (int i = 1; i < length && p + i < end; i++)
+            code = (code << 6) | (p[i] & 0x3F);
+
+        if (destination)
+        {
+            if (count == destinationLength)
+                return 0;
+            destination[count] = static_cast<wchar_t>(code);
+        }
+
+        count++;
+        p += length;
+    }
+
+    return count;
+}
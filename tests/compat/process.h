@@ -0,0 +1,31 @@
+#pragma once
+
+// _beginthreadex sobre pthreads, para jobs.cpp. O HANDLE devolvido  um CompatObject (Windows.h).
+
+#include <Windows.h>
+
+struct CompatThreadStart
+{
+    unsigned int (WINAPI* startAddress)(void*);
+    void* argument;
+};
+
+inline void* RunCompatThread(void* parameter)
+{
+    CompatThreadStart start = *reinterpret_cast<CompatThreadStart*>(parameter);
+    delete reinterpret_cast<CompatThreadStart*>(parameter);
+    start.startAddress(start.argument);
+    return nullptr;
+}
+
+inline uintptr_t _beginthreadex(void*, unsigned int, unsigned int (WINAPI* startAddress)(void*), void* argument, unsigned int, unsigned int*)
+{
+    CompatObject* object = CreateCompatObject(CompatThread, 0, FALSE);
+    CompatThreadStart* start = new CompatThreadStart{ startAddress, argument };
+    if (pthread_create(&object->thread, nullptr, RunCompatThread, start) != 0)
+    {
+        delete start;
+        object->count = 1;
+    }
+    return reinterpret_cast<uintptr_t>(object);
+}
@@ -0,0 +1,157 @@
+#include "testing.h"
+#include "lightbvh.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Tempos da BVH de luzes com o pool de jobs: montagem, reajuste com nenhuma, 1% e todas as luzes se movendo,
+// coleta contra o lao sobre todas as luzes e sorteio contra a soma das importncias de todas.
+//
+//   lightbvhbench [luzes] [frao de spots] [threads]
+
+int main(int argc, char** argv)
+{
+    const UINT lightCount = argc > 1 ? static_cast<UINT>(atoi(argv[1])) : 50000;
+    const float spotShare = argc > 2 ? static_cast<float>(atof(argv[2])) : 0.33f;
+    const UINT threadCount = argc > 3 ? static_cast<UINT>(atoi(argv[3])) : 0;
+
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem, threadCount);
+
+    UINT64 random = 3;
+    std::vector<LocalLight> lights(lightCount);
+    for (LocalLight& light : lights)
+    {
+        light.position = XMFLOAT3(400.0f * (2.0f * RandomFloat(&random) - 1.0f), 30.0f * RandomFloat(&random), 400.0f * (2.0f * RandomFloat(&random) - 1.0f));
+        light.range = 2.0f + 6.0f * RandomFloat(&random);
+        light.color = XMFLOAT3(RandomFloat(&random), RandomFloat(&random), RandomFloat(&random));
+
+        if (RandomFloat(&random) < spotShare)
+        {
+            const XMVECTOR direction = XMVectorSet(2.0f * RandomFloat(&random) - 1.0f, -1.0f - RandomFloat(&random), 2.0f * RandomFloat(&random) - 1.0f, 0.0f);
+            XMStoreFloat3(&light.direction, XMVector3Normalize(direction));
+            const float angle = 0.3f + 0.7f * RandomFloat(&random);
+            light.spotCosOuter = cosf(angle);
+            light.spotCosInner = cosf(angle * 0.8f);
+        }
+        else
+        {
+            light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+            light.spotCosOuter = -1.0f;
+            light.spotCosInner = -1.0f;
+        }
+    }
+
+    LightBvh bvh;
+    InitLightBvh(&bvh, &DefaultLightBvhSettings);
+    UpdateLightBvh(&jobSystem, &bvh, lights.data(), lightCount);
+
+    // Zerar lightCount fora a montagem no prximo UpdateLightBvh, com a memria j alocada.
+    double buildTime = 1e9;
+    for (UINT i = 0; i < 10; i++)
+    {
+        bvh.lightCount = 0;
+
+        LARGE_INTEGER start;
+        QueryPerformanceCounter(&start);
+        UpdateLightBvh(&jobSystem, &bvh, lights.data(), lightCount);
+        buildTime = (std::min)(buildTime, GetElapsedSeconds(&start));
+    }
+
+    const float movingShares[3] = { 0.0f, 0.01f, 1.0f };
+    double refitTimes[3];
+    const UINT buildCount = bvh.buildCount;
+
+    for (UINT m = 0; m < 3; m++)
+    {
+        refitTimes[m] = 0.0;
+        for (UINT frame = 0; frame < 20; frame++)
+        {
+            for (LocalLight& light : lights)
+            {
+                if (RandomFloat(&random) < movingShares[m])
+                    light.position.y += 0.01f;
+            }
+
+            LARGE_INTEGER start;
+            QueryPerformanceCounter(&start);
+            UpdateLightBvh(&jobSystem, &bvh, lights.data(), lightCount);
+            refitTimes[m] += GetElapsedSeconds(&start) / 20;
+        }
+    }
+
+    std::vector<UINT> gathered;
+    gathered.reserve(lightCount);
+    double gatherTime = 0.0, flatGatherTime = 0.0, sampleTime = 0.0, flatSampleTime = 0.0;
+    size_t gatheredCount = 0;
+    const UINT queryCount = 50;
+    const UINT samplesPerQuery = 100;
+
+    for (UINT query = 0; query < queryCount; query++)
+    {
+        const XMFLOAT3 center(200.0f * (2.0f * RandomFloat(&random) - 1.0f), 15.0f, 200.0f * (2.0f * RandomFloat(&random) - 1.0f));
+        const XMFLOAT4 planes[6] =
+        {
+            XMFLOAT4(1.0f, 0.0f, 0.0f, -(center.x - 60.0f)),
+            XMFLOAT4(-1.0f, 0.0f, 0.0f, center.x + 60.0f),
+            XMFLOAT4(0.0f, 1.0f, 0.0f, -(center.y - 60.0f)),
+            XMFLOAT4(0.0f, -1.0f, 0.0f, center.y + 60.0f),
+            XMFLOAT4(0.0f, 0.0f, 1.0f, -(center.z - 60.0f)),
+            XMFLOAT4(0.0f, 0.0f, -1.0f, center.z + 60.0f),
+        };
+
+        LARGE_INTEGER start;
+        QueryPerformanceCounter(&start);
+        GatherLightBvh(&bvh, lights.data(), planes, 6, &gathered);
+        gatherTime += GetElapsedSeconds(&start) / queryCount;
+        gatheredCount += gathered.size();
+
+        QueryPerformanceCounter(&start);
+        gathered.clear();
+        for (UINT i = 0; i < lightCount; i++)
+        {
+            const XMVECTOR position = XMLoadFloat3(&lights[i].position);
+
+            bool inside = true;
+            for (UINT p = 0; p < 6 && inside; p++)
+                inside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), position)) >= -lights[i].range;
+
+            if (inside)
+                gathered.push_back(i);
+        }
+        flatGatherTime += GetElapsedSeconds(&start) / queryCount;
+
+        QueryPerformanceCounter(&start);
+        for (UINT s = 0; s < samplesPerQuery; s++)
+        {
+            float probability;
+            SampleLightBvh(&bvh, center, RandomFloat(&random), &probability);
+        }
+        sampleTime += GetElapsedSeconds(&start) / (queryCount * samplesPerQuery);
+
+        // O sorteio sem a rvore: a potncia de cada luz sobre a distncia, somada, antes de escolher.
+        QueryPerformanceCounter(&start);
+        const XMVECTOR point = XMLoadFloat3(&center);
+        float total = 0.0f;
+        for (UINT i = 0; i < lightCount; i++)
+        {
+            const float distanceSquared = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(point, XMLoadFloat3(&lights[i].position))));
+            total += (lights[i].color.x + lights[i].color.y + lights[i].color.z) / (distanceSquared + 1.0f);
+        }
+        volatile float sink = total;
+        (void)sink;
+        flatSampleTime += GetElapsedSeconds(&start) / queryCount;
+    }
+
+    printf("%u luzes, %u threads\n", lightCount, jobSystem.threadCount);
+    printf("montagem %.3f ms\n", buildTime * 1e3);
+    printf("reajuste: paradas %.3f ms, 1%% movendo %.3f ms, todas movendo %.3f ms (%u remontagens)\n",
+        refitTimes[0] * 1e3, refitTimes[1] * 1e3, refitTimes[2] * 1e3, bvh.buildCount - buildCount);
+    printf("coleta %.3f ms (todas as luzes %.3f ms), %zu luzes\n", gatherTime * 1e3, flatGatherTime * 1e3, gatheredCount / queryCount);
+    printf("sorteio %.3f us (soma sobre todas as luzes %.3f ms)\n", sampleTime * 1e6, flatSampleTime * 1e3);
+
+    DestroyJobSystem(&jobSystem);
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include "testing.h"
+#include "lightbvh.h"
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <vector>
+
+// Alocaes do processo inteiro, para verificar que os quadros com a mesma contagem de luzes no alocam.
+static std::atomic<UINT64> allocationCount(0);
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    void* memory = malloc(size ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Luzes espalhadas num terreno de 800 x 30 x 800, um tero spots apontando para baixo e algumas na mesma posio
+// de outra (cdigos de Morton iguais).
+static void MakeLights(UINT lightCount, UINT64* random, std::vector<LocalLight>* lights)
+{
+    lights->resize(lightCount);
+
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        LocalLight& light = (*lights)[i];
+        light.position = XMFLOAT3(400.0f * (2.0f * RandomFloat(random) - 1.0f), 30.0f * RandomFloat(random), 400.0f * (2.0f * RandomFloat(random) - 1.0f));
+        if (i % 7 == 0)
+            light.position = (*lights)[i / 2].position;
+
+        light.range = 2.0f + 6.0f * RandomFloat(random);
+        light.color = XMFLOAT3(RandomFloat(random), RandomFloat(random), RandomFloat(random));
+
+        if (i % 3 == 0)
+        {
+            const XMVECTOR direction = XMVectorSet(2.0f * RandomFloat(random) - 1.0f, -1.0f - RandomFloat(random), 2.0f * RandomFloat(random) - 1.0f, 0.0f);
+            XMStoreFloat3(&light.direction, XMVector3Normalize(direction));
+            const float angle = 0.3f + 0.7f * RandomFloat(random);
+            light.spotCosOuter = cosf(angle);
+            light.spotCosInner = cosf(angle * 0.8f);
+        }
+        else
+        {
+            light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+            light.spotCosOuter = -1.0f;
+            light.spotCosInner = -1.0f;
+        }
+    }
+}
+
+// Move parte das luzes, como num quadro: todas, uma em 50 ou nenhuma, conforme frame % 3.
+static void MoveLights(UINT frame, std::vector<LocalLight>* lights)
+{
+    if (frame % 3 == 2)
+        return;
+
+    for (UINT i = 0; i < lights->size(); i++)
+    {
+        if (frame % 3 == 1 && i % 50 != 0)
+            continue;
+
+        LocalLight& light = (*lights)[i];
+        light.position.x += 0.3f * sinf(i * 0.1f + frame * 0.2f);
+        light.position.z += 0.3f * cosf(i * 0.13f + frame * 0.2f);
+        if (i % 11 == 0)
+            light.range *= 1.01f;
+    }
+}
+
+static const LightBvhNode* GetNode(const LightBvh* bvh, UINT node)
+{
+    return (node & LightBvhLeafFlag) ? &bvh->leaves[node & ~LightBvhLeafFlag] : &bvh->nodes[node];
+}
+
+static float GetAngle(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return acosf((std::max)(-1.0f, (std::min)(1.0f, a.x * b.x + a.y * b.y + a.z * b.z)));
+}
+
+static void CheckLightBvhNode(const LightBvh* bvh, UINT nodeIndex, UINT depth, std::vector<UINT>* leafCounts)
+{
+    CHECK(depth <= 64);
+
+    if (nodeIndex & LightBvhLeafFlag)
+    {
+        (*leafCounts)[nodeIndex & ~LightBvhLeafFlag]++;
+        return;
+    }
+
+    const LightBvhNode* node = &bvh->nodes[nodeIndex];
+    for (const UINT childIndex : { node->left, node->right })
+    {
+        // Pr-ordem: os filhos internos vm depois do pai.
+        if (childIndex & LightBvhLeafFlag)
+        {
+            CHECK(bvh->leafParents[childIndex & ~LightBvhLeafFlag] == nodeIndex);
+        }
+        else
+        {
+            CHECK(childIndex > nodeIndex);
+            CHECK(bvh->nodeParents[childIndex] == nodeIndex);
+        }
+
+        // Caixa, esfera das posies e cones do filho dentro dos do pai.
+        const LightBvhNode* child = GetNode(bvh, childIndex);
+        CHECK(XMVector3GreaterOrEqual(XMLoadFloat3(&child->boundsMin), XMLoadFloat3(&node->boundsMin)));
+        CHECK(XMVector3LessOrEqual(XMLoadFloat3(&child->boundsMax), XMLoadFloat3(&node->boundsMax)));
+
+        const XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&child->center), XMLoadFloat3(&node->center));
+        CHECK(XMVectorGetX(XMVector3Length(offset)) + child->radius <= node->radius * 1.0001f + 1e-3f);
+
+        if (node->spreadAngle < XM_PI)
+            CHECK(child->spreadAngle < XM_PI && GetAngle(node->axis, child->axis) + child->spreadAngle <= node->spreadAngle + 1e-3f);
+        CHECK(child->emissionAngle <= node->emissionAngle);
+    }
+
+    CheckLightBvhNode(bvh, node->left, depth + 1, leafCounts);
+    CheckLightBvhNode(bvh, node->right, depth + 1, leafCounts);
+}
+
+// A rvore cobre cada luz uma vez, e cada n contm os filhos.
+static void CheckLightBvh(const LightBvh* bvh, UINT lightCount)
+{
+    CHECK(bvh->lightCount == lightCount);
+    CHECK(bvh->root != LightBvhNullNode);
+
+    std::vector<UINT> leafCounts(lightCount, 0);
+    CheckLightBvhNode(bvh, bvh->root, 0, &leafCounts);
+
+    std::vector<UINT> lightCounts(lightCount, 0);
+    for (UINT leaf = 0; leaf < lightCount; leaf++)
+    {
+        CHECK(leafCounts[leaf] == 1);
+        lightCounts[bvh->order[leaf]]++;
+    }
+
+    for (UINT light = 0; light < lightCount; light++)
+    {
+        CHECK(lightCounts[light] == 1);
+    }
+}
+
+// Uma caixa de 120 metros em torno de center, com a face +z trocada por um plano inclinado.
+static void MakeGatherPlanes(XMFLOAT3 center, XMFLOAT4* planes)
+{
+    planes[0] = XMFLOAT4(1.0f, 0.0f, 0.0f, -(center.x - 60.0f));
+    planes[1] = XMFLOAT4(-1.0f, 0.0f, 0.0f, center.x + 60.0f);
+    planes[2] = XMFLOAT4(0.0f, 1.0f, 0.0f, -(center.y - 60.0f));
+    planes[3] = XMFLOAT4(0.0f, -1.0f, 0.0f, center.y + 60.0f);
+    planes[4] = XMFLOAT4(0.0f, 0.0f, 1.0f, -(center.z - 60.0f));
+
+    const XMVECTOR normal = XMVector3Normalize(XMVectorSet(0.3f, 0.2f, 1.0f, 0.0f));
+    XMFLOAT3 n;
+    XMStoreFloat3(&n, normal);
+    planes[5] = XMFLOAT4(n.x, n.y, n.z, -(n.x * center.x + n.y * center.y + n.z * center.z));
+}
+
+// Coleta contra fora bruta: as luzes cuja esfera no est inteira atrs de nenhum plano.
+static void CheckGather(const std::vector<LocalLight>& lights, const XMFLOAT4* planes, std::vector<UINT> gathered)
+{
+    std::vector<UINT> expected;
+    for (UINT i = 0; i < lights.size(); i++)
+    {
+        const XMVECTOR position = XMLoadFloat3(&lights[i].position);
+
+        bool inside = true;
+        for (UINT p = 0; p < 6 && inside; p++)
+            inside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), position)) >= -lights[i].range;
+
+        if (inside)
+            expected.push_back(i);
+    }
+
+    std::sort(gathered.begin(), gathered.end());
+    CHECK(gathered == expected);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Montagens de 1 a 50.000 luzes, inclusive as contagens pequenas e as posies repetidas.
+static void TestBuild(JobSystem* jobSystem)
+{
+    UINT64 random = 1;
+
+    for (const UINT lightCount : { 1u, 2u, 3u, 1000u, 50000u })
+    {
+        std::vector<LocalLight> lights;
+        MakeLights(lightCount, &random, &lights);
+
+        LightBvh bvh;
+        InitLightBvh(&bvh, &DefaultLightBvhSettings);
+        UpdateLightBvh(jobSystem, &bvh, lights.data(), lightCount);
+
+        CHECK(bvh.buildCount == 1);
+        CheckLightBvh(&bvh, lightCount);
+    }
+
+    // Sem luzes, nada a coletar nem a sortear.
+    LightBvh bvh;
+    InitLightBvh(&bvh, &DefaultLightBvhSettings);
+    UpdateLightBvh(jobSystem, &bvh, nullptr, 0);
+
+    std::vector<UINT> gathered(1, 0);
+    XMFLOAT4 planes[6];
+    MakeGatherPlanes(XMFLOAT3(0.0f, 0.0f, 0.0f), planes);
+    GatherLightBvh(&bvh, nullptr, planes, 6, &gathered);
+    CHECK(gathered.empty());
+
+    float probability;
+    CHECK(SampleLightBvh(&bvh, XMFLOAT3(0.0f, 0.0f, 0.0f), 0.5f, &probability) == LightBvhNullNode);
+    CHECK(probability == 0.0f);
+}
+
+// Quadros com luzes se movendo: a rvore reajustada continua vlida, a coleta bate com a fora bruta, e nem o
+// reajuste nem a coleta alocam. Embaralhar as posies degrada a rvore e fora uma montagem, tambm sem alocar.
+static void TestRefitAndGather(JobSystem* jobSystem)
+{
+    const UINT lightCount = 20000;
+    const UINT frameCount = 30;
+
+    UINT64 random = 2;
+    std::vector<LocalLight> lights;
+    MakeLights(lightCount, &random, &lights);
+
+    LightBvh bvh;
+    InitLightBvh(&bvh, &DefaultLightBvhSettings);
+    UpdateLightBvh(jobSystem, &bvh, lights.data(), lightCount);
+
+    std::vector<UINT> gathered;
+    gathered.reserve(lightCount);
+
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        MoveLights(frame, &lights);
+
+        UINT64 allocationsBefore = allocationCount;
+        UpdateLightBvh(jobSystem, &bvh, lights.data(), lightCount);
+        CHECK(allocationCount == allocationsBefore);
+
+        if (frame < 4 || frame == frameCount - 1)
+            CheckLightBvh(&bvh, lightCount);
+
+        XMFLOAT4 planes[6];
+        MakeGatherPlanes(XMFLOAT3(200.0f * (2.0f * RandomFloat(&random) - 1.0f), 15.0f, 200.0f * (2.0f * RandomFloat(&random) - 1.0f)), planes);
+
+        allocationsBefore = allocationCount;
+        GatherLightBvh(&bvh, lights.data(), planes, 6, &gathered);
+        CHECK(allocationCount == allocationsBefore);
+
+        CheckGather(lights, planes, gathered);
+    }
+
+    CHECK(bvh.refitCount >= frameCount);
+
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        std::swap(lights[i].position, lights[NextRandom(&random) % lightCount].position);
+    }
+
+    const UINT buildCount = bvh.buildCount;
+    const UINT64 allocationsBefore = allocationCount;
+    UpdateLightBvh(jobSystem, &bvh, lights.data(), lightCount);
+    CHECK(allocationCount == allocationsBefore);
+    CHECK(bvh.buildCount == buildCount + 1);
+    CheckLightBvh(&bvh, lightCount);
+}
+
+// Com u estratificado em [0, 1), a frequncia de cada luz converge para a probabilidade que o sorteio devolve, e
+// as probabilidades somam 1. Longe de todas as luzes no h o que sortear.
+static void TestSampleFrequencies(JobSystem* jobSystem)
+{
+    const UINT lightCount = 64;
+    const UINT sampleCount = 2000000;
+
+    UINT64 random = 3;
+    std::vector<LocalLight> lights(lightCount);
+    for (LocalLight& light : lights)
+    {
+        light.position = XMFLOAT3(10.0f * (2.0f * RandomFloat(&random) - 1.0f), 0.0f, 10.0f * (2.0f * RandomFloat(&random) - 1.0f));
+        light.range = 30.0f;
+        light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+        light.spotCosOuter = -1.0f;
+        light.spotCosInner = -1.0f;
+        light.color = XMFLOAT3(RandomFloat(&random), 1.0f, 1.0f);
+    }
+
+    LightBvh bvh;
+    InitLightBvh(&bvh, &DefaultLightBvhSettings);
+    UpdateLightBvh(jobSystem, &bvh, lights.data(), lightCount);
+
+    std::vector<double> frequencies(lightCount, 0.0);
+    std::vector<float> probabilities(lightCount, 0.0f);
+
+    for (UINT i = 0; i < sampleCount; i++)
+    {
+        float probability;
+        const UINT light = SampleLightBvh(&bvh, XMFLOAT3(1.0f, 1.0f, 1.0f), (i + 0.5f) / sampleCount, &probability);
+        CHECK(light < lightCount);
+        if (light >= lightCount)
+            continue;
+
+        CHECK(probability > 0.0f && probability <= 1.0001f);
+        CHECK(probabilities[light] == 0.0f || probabilities[light] == probability);
+
+        frequencies[light] += 1.0 / sampleCount;
+        probabilities[light] = probability;
+    }
+
+    double probabilitySum = 0.0;
+    double maxError = 0.0;
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        probabilitySum += probabilities[i];
+        maxError = (std::max)(maxError, fabs(frequencies[i] - probabilities[i]));
+    }
+
+    CHECK(fabs(probabilitySum - 1.0) < 1e-3);
+    CHECK(maxError < 1e-3);
+
+    float probability;
+    CHECK(SampleLightBvh(&bvh, XMFLOAT3(500.0f, 0.0f, 0.0f), 0.5f, &probability) == LightBvhNullNode);
+    CHECK(probability == 0.0f);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    // Com mais threads que ncleos, para exercitar os jobs mesmo numa mquina de um ncleo s.
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem, 3);
+
+    TestBuild(&jobSystem);
+    TestRefitAndGather(&jobSystem);
+    TestSampleFrequencies(&jobSystem);
+
+    DestroyJobSystem(&jobSystem);
+
+    return TestFailures();
+}
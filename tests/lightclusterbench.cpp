@@ -0,0 +1,118 @@
+#include "testing.h"
+#include "lightcluster.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Tempo de BuildLightClusters com 4.096 luzes visveis e a grade padro, com o pool de jobs e sem threads, numa
+// cmera andando pela cena. A meta  0,5 ms com o pool; as listas das duas montagens tm que ser iguais.
+//
+//   lightclusterbench [threads]
+
+const UINT BenchLightCount = 4096;
+const UINT BenchFrameCount = 60;
+const UINT BenchWarmupFrames = 5;
+const double BenchTargetSeconds = 0.5e-3;
+
+struct BenchTiming
+{
+    double totalSeconds;
+    double bestSeconds;
+};
+
+static void BuildFrame(JobSystem* jobSystem, LightClusterGrid* grid, UINT frame, const std::vector<LocalLight>& lights, const std::vector<UINT>& visibleLights,
+    BenchTiming* timing)
+{
+    const XMVECTOR position = XMVectorSet(20.0f * sinf(frame * 0.05f), 3.0f, -20.0f + frame * 0.5f, 0.0f);
+    const XMVECTOR direction = XMVectorSet(sinf(frame * 0.03f), -0.1f, 1.0f, 0.0f);
+    const XMMATRIX view = XMMatrixLookToLH(position, direction, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    BuildLightClusters(jobSystem, grid, view, 60.0f, 16.0f / 9.0f, 1.0f, 1000.0f, lights.data(), visibleLights.data(), BenchLightCount);
+    const double seconds = GetElapsedSeconds(&start);
+
+    if (frame >= BenchWarmupFrames)
+    {
+        timing->totalSeconds += seconds;
+        timing->bestSeconds = (std::min)(timing->bestSeconds, seconds);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const UINT threadCount = argc > 1 ? static_cast<UINT>(atoi(argv[1])) : 0;
+
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem, threadCount);
+
+    // Sem threads, ParallelFor roda os jobs em srie na thread que chama.
+    JobSystem serialJobSystem = {};
+    serialJobSystem.threadCount = 0;
+
+    // Luzes num terreno de 300 x 10 x 300  frente da cmera, um tero spots apontando para baixo.
+    UINT64 random = 5;
+    std::vector<LocalLight> lights(BenchLightCount);
+    std::vector<UINT> visibleLights(BenchLightCount);
+    for (UINT i = 0; i < BenchLightCount; i++)
+    {
+        LocalLight& light = lights[i];
+        light.position = XMFLOAT3(150.0f * (2.0f * RandomFloat(&random) - 1.0f), 10.0f * RandomFloat(&random), 150.0f * (2.0f * RandomFloat(&random) - 1.0f) + 100.0f);
+        light.range = 2.0f + 8.0f * RandomFloat(&random);
+        light.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+
+        if (i % 3 == 0)
+        {
+            const XMVECTOR direction = XMVectorSet(2.0f * RandomFloat(&random) - 1.0f, -1.0f - RandomFloat(&random), 2.0f * RandomFloat(&random) - 1.0f, 0.0f);
+            XMStoreFloat3(&light.direction, XMVector3Normalize(direction));
+            const float angle = 0.2f + 0.8f * RandomFloat(&random);
+            light.spotCosOuter = cosf(angle);
+            light.spotCosInner = cosf(angle * 0.8f);
+        }
+        else
+        {
+            light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+            light.spotCosOuter = -1.0f;
+            light.spotCosInner = -1.0f;
+        }
+
+        visibleLights[i] = i;
+    }
+
+    LightClusterGrid grid;
+    LightClusterGrid serialGrid;
+    InitLightClusterGrid(&grid, &DefaultLightClusterSettings);
+    InitLightClusterGrid(&serialGrid, &DefaultLightClusterSettings);
+
+    BenchTiming timing = { 0.0, 1e9 };
+    BenchTiming serialTiming = { 0.0, 1e9 };
+    UINT mismatchCount = 0;
+
+    for (UINT frame = 0; frame < BenchFrameCount; frame++)
+    {
+        BuildFrame(&serialJobSystem, &serialGrid, frame, lights, visibleLights, &serialTiming);
+        BuildFrame(&jobSystem, &grid, frame, lights, visibleLights, &timing);
+
+        if (grid.lightIndices != serialGrid.lightIndices || grid.overflowCount != serialGrid.overflowCount ||
+            memcmp(grid.clusters.data(), serialGrid.clusters.data(), grid.clusters.size() * sizeof(XMUINT2)) != 0)
+        {
+            mismatchCount++;
+        }
+    }
+
+    const UINT measuredFrames = BenchFrameCount - BenchWarmupFrames;
+    const double average = timing.totalSeconds / measuredFrames;
+
+    printf("%u luzes, %u clusters, %zu indices, %u descartadas\n", BenchLightCount,
+        DefaultLightClusterSettings.tilesX * DefaultLightClusterSettings.tilesY * DefaultLightClusterSettings.slices, grid.lightIndices.size(), grid.overflowCount);
+    printf("serie: media %.3f ms, melhor %.3f ms\n", serialTiming.totalSeconds / measuredFrames * 1e3, serialTiming.bestSeconds * 1e3);
+    printf("%u threads + a que chama: media %.3f ms, melhor %.3f ms\n", jobSystem.threadCount, average * 1e3, timing.bestSeconds * 1e3);
+    printf("meta de %.1f ms: %s\n", BenchTargetSeconds * 1e3, average <= BenchTargetSeconds ? "atingida" : "NAO atingida");
+    printf("listas diferentes da serie em %u quadros\n", mismatchCount);
+
+    DestroyJobSystem(&jobSystem);
+    return mismatchCount ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+#include "testing.h"
+#include "materials.h"
+
+#include <stddef.h>
+#include <vector>
+
+// Layout do GpuMaterial: o mesmo da struct Material em shaders.hlsl.
+static void TestPacking()
+{
+    CHECK(sizeof(GpuMaterial) == 32);
+    CHECK(offsetof(GpuMaterial, emissiveStrength) == 8);
+    CHECK(offsetof(GpuMaterial, flags) == 16);
+    CHECK(offsetof(GpuMaterial, textures) == 20);
+    CHECK(offsetof(GpuMaterial, reserved) == 28);
+
+    MaterialDesc desc = DefaultMaterialDesc;
+    desc.baseColor = XMFLOAT4(1.0f, 0.5f, 0.0f, 0.25f);
+    desc.emissive = XMFLOAT3(0.0f, 1.0f, 2.0f);     // Acima de 1 satura.
+    desc.emissiveStrength = 3.5f;
+    desc.metallic = 1.0f;
+    desc.roughness = 0.5f;
+    desc.alphaCutoff = 0.5f;
+    desc.flags = MaterialAlphaTest | MaterialDoubleSided;
+    desc.textures[MaterialBaseColorTexture] = 7;
+    desc.textures[MaterialNormalTexture] = 0x1234;
+    desc.textures[MaterialMetallicRoughnessTexture] = MaterialNoTexture;
+    desc.textures[MaterialEmissiveTexture] = 0x10000;   // No cabe em 16 bits: vira "sem textura".
+
+    GpuMaterial material;
+    material.reserved = 0xDEADBEEF;
+    PackMaterial(&desc, &material);
+
+    CHECK(material.baseColor == 0x400080FF);
+    CHECK(material.emissive == 0x80FFFF00);
+    CHECK(material.emissiveStrength == 3.5f);
+    CHECK(material.metallicRoughness == 0x8000FFFF);
+    CHECK(material.flags == (MaterialAlphaTest | MaterialDoubleSided));
+    CHECK(material.textures[0] == 0x12340007);
+    CHECK(material.textures[1] == 0xFFFFFFFF);
+    CHECK(material.reserved == 0);
+
+    // Valores negativos saturam em zero.
+    desc.baseColor = XMFLOAT4(-1.0f, 0.0f, 0.0f, 0.0f);
+    desc.metallic = -0.5f;
+    PackMaterial(&desc, &material);
+    CHECK(material.baseColor == 0 && (material.metallicRoughness & 0xFFFF) == 0);
+}
+
+// Um slot destrudo volta no prximo CreateMaterial, e a contagem acompanha.
+static void TestReuse()
+{
+    MaterialTable table;
+    InitMaterialTable(&table, 16);
+
+    MaterialDesc desc = DefaultMaterialDesc;
+    UINT indices[4];
+    for (UINT i = 0; i < 4; i++)
+    {
+        desc.flags = i;
+        indices[i] = CreateMaterial(&table, &desc);
+        CHECK(indices[i] == i);
+    }
+
+    CHECK(table.materialCount == 4);
+
+    DestroyMaterial(&table, indices[1]);
+    DestroyMaterial(&table, indices[2]);
+    CHECK(table.materialCount == 2);
+
+    // Os slots livres voltam antes de a tabela crescer; o contedo  o do material novo.
+    desc.flags = MaterialDoubleSided;
+    const UINT a = CreateMaterial(&table, &desc);
+    const UINT b = CreateMaterial(&table, &desc);
+    CHECK((a == 1 && b == 2) || (a == 2 && b == 1));
+    CHECK(table.materials[a].flags == MaterialDoubleSided && table.materials[b].flags == MaterialDoubleSided);
+    CHECK(table.materials.size() == 4);
+
+    CHECK(CreateMaterial(&table, &desc) == 4);
+    CHECK(table.materialCount == 5);
+}
+
+// Com a tabela cheia, CreateMaterial devolve MaterialNull sem mexer em nada; liberado um slot, volta a funcionar.
+static void TestFull()
+{
+    MaterialTable table;
+    InitMaterialTable(&table, MaxMaterialCount);
+
+    for (UINT i = 0; i < MaxMaterialCount; i++)
+    {
+        CHECK(CreateMaterial(&table, &DefaultMaterialDesc) == i);
+    }
+
+    const UINT64 version = table.version;
+    CHECK(CreateMaterial(&table, &DefaultMaterialDesc) == MaterialNull);
+    CHECK(table.materialCount == MaxMaterialCount && table.materials.size() == MaxMaterialCount);
+    CHECK(table.version == version);
+
+    DestroyMaterial(&table, 100);
+    CHECK(CreateMaterial(&table, &DefaultMaterialDesc) == 100);
+    CHECK(CreateMaterial(&table, &DefaultMaterialDesc) == MaterialNull);
+}
+
+// Cada cpia do buffer recebe s as faixas alteradas desde a verso que tem.
+static void TestChanges()
+{
+    MaterialTable table;
+    InitMaterialTable(&table, 64);
+
+    for (UINT i = 0; i < 10; i++)
+    {
+        CreateMaterial(&table, &DefaultMaterialDesc);
+    }
+
+    std::vector<MaterialRange> ranges;
+    const UINT64 created = CollectMaterialChanges(&table, 0, &ranges);
+    CHECK(created == 10);
+    CHECK(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].count == 10);
+
+    UpdateMaterial(&table, 3, &DefaultMaterialDesc);
+    UpdateMaterial(&table, 4, &DefaultMaterialDesc);
+    UpdateMaterial(&table, 8, &DefaultMaterialDesc);
+    UpdateMaterial(&table, 3, &DefaultMaterialDesc);
+
+    CHECK(CollectMaterialChanges(&table, created, &ranges) == created + 4);
+    CHECK(ranges.size() == 2);
+    CHECK(ranges[0].first == 3 && ranges[0].count == 2);
+    CHECK(ranges[1].first == 8 && ranges[1].count == 1);
+
+    // Uma cpia em dia no recebe nada.
+    CHECK(CollectMaterialChanges(&table, table.version, &ranges) == table.version && ranges.empty());
+
+    TrimMaterialChanges(&table, created + 2);
+    CHECK(table.changes.size() == 2);
+    CollectMaterialChanges(&table, created + 2, &ranges);
+    CHECK(ranges.size() == 2 && ranges[0].first == 3 && ranges[1].first == 8);
+}
+
+int main()
+{
+    TestPacking();
+    TestReuse();
+    TestFull();
+    TestChanges();
+
+    return TestFailures();
+}
@@ -0,0 +1,209 @@
+#include "testing.h"
+#include "meshlet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Vazo de BuildSceneMeshlets e de CullMeshlets em malhas de milhes de tringulos: esferas em grade de latitude
+// e longitude, uma instncia por malha, com a cmera dando a volta na fileira de modelos. O culling roda com o
+// pool de jobs e sem threads, e as duas listas tm que ser iguais.
+//
+//   meshletbench [milhes de tringulos] [malhas] [threads]
+
+const UINT BenchFrameCount = 40;
+const UINT BenchWarmupFrames = 4;
+const float BenchSphereRadius = 10.0f;
+
+struct BenchTiming
+{
+    double totalSeconds;
+    double bestSeconds;
+};
+
+// Esfera com rings faixas de latitude e 2 * rings de longitude, tringulos em sentido horrio vistos de fora.
+static void AppendSphere(Mesh* mesh, UINT rings, std::vector<Vertex>* vertices, std::vector<UINT>* indices)
+{
+    const UINT segments = rings * 2;
+
+    *mesh = {};
+    mesh->baseVertex = static_cast<UINT>(vertices->size());
+    mesh->vertexCount = (rings + 1) * (segments + 1);
+
+    for (UINT r = 0; r <= rings; r++)
+    {
+        const float theta = XM_PI * r / rings;
+        for (UINT s = 0; s <= segments; s++)
+        {
+            const float phi = 2.0f * XM_PI * s / segments;
+
+            Vertex vertex;
+            vertex.position = XMFLOAT3(BenchSphereRadius * sinf(theta) * cosf(phi), BenchSphereRadius * cosf(theta), BenchSphereRadius * sinf(theta) * sinf(phi));
+            vertex.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+            vertices->push_back(vertex);
+        }
+    }
+
+    mesh->lods[0].startIndex = static_cast<UINT>(indices->size());
+    mesh->lodCount = 1;
+
+    for (UINT r = 0; r < rings; r++)
+    {
+        for (UINT s = 0; s < segments; s++)
+        {
+            const UINT a = r * (segments + 1) + s;
+            const UINT b = a + 1;
+            const UINT c = a + segments + 1;
+            const UINT d = c + 1;
+
+            const UINT quad[6] = { a, b, c, b, d, c };
+            indices->insert(indices->end(), quad, quad + 6);
+        }
+    }
+
+    mesh->lods[0].indexCount = static_cast<UINT>(indices->size()) - mesh->lods[0].startIndex;
+    mesh->boundsRadius = BenchSphereRadius;
+}
+
+static void CullFrame(JobSystem* jobSystem, UINT frame, UINT modelCount, const std::vector<Mesh>& meshes, const std::vector<Meshlet>& meshlets,
+    const std::vector<MeshletBounds4>& bounds, const std::vector<Model>& models, std::vector<DrawCommand>* drawList, BenchTiming* timing)
+{
+    // Volta em torno do meio da fileira, perto o bastante para s parte dos modelos caber no frustum.
+    const float angle = frame * 2.0f * XM_PI / BenchFrameCount;
+    const float middle = 1.5f * BenchSphereRadius * (modelCount - 1);
+    const XMVECTOR target = XMVectorSet(middle, 0.0f, 0.0f, 0.0f);
+    const XMVECTOR position = XMVectorAdd(target, XMVectorSet(40.0f * cosf(angle), 8.0f, 40.0f * sinf(angle), 0.0f));
+
+    const XMMATRIX view = XMMatrixLookToLH(position, XMVectorSubtract(target, position), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const XMMATRIX projection = XMMatrixPerspectiveFovLH(60.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+    XMFLOAT3 camera;
+    XMStoreFloat3(&camera, position);
+
+    LodView lodView;
+    BuildLodView(&lodView, camera, XMMatrixMultiply(view, projection), 60.0f, 1080.0f, 0.1f);
+
+    drawList->clear();
+    for (UINT m = 0; m < modelCount; m++)
+    {
+        const Mesh* mesh = &meshes[models[m].meshIndex];
+        drawList->push_back({ m, mesh->lods[0].indexCount, mesh->lods[0].startIndex, mesh->baseVertex });
+    }
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    CullMeshlets(jobSystem, &lodView, meshes.data(), meshlets.data(), bounds.data(), models.data(), drawList);
+    const double seconds = GetElapsedSeconds(&start);
+
+    if (frame >= BenchWarmupFrames)
+    {
+        timing->totalSeconds += seconds;
+        timing->bestSeconds = (std::min)(timing->bestSeconds, seconds);
+    }
+}
+
+static UINT64 CountIndices(const std::vector<DrawCommand>& drawList)
+{
+    UINT64 count = 0;
+    for (const DrawCommand& draw : drawList)
+        count += draw.indexCount;
+    return count;
+}
+
+int main(int argc, char** argv)
+{
+    const double millionTriangles = argc > 1 ? atof(argv[1]) : 4.0;
+    const UINT meshCount = argc > 2 ? (std::max)(atoi(argv[2]), 1) : 4;
+    const UINT threadCount = argc > 3 ? static_cast<UINT>(atoi(argv[3])) : 0;
+
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem, threadCount);
+
+    JobSystem serialJobSystem = {};
+    serialJobSystem.threadCount = 0;
+
+    // 4 * rings tringulos por esfera.
+    const UINT rings = (std::max)(static_cast<UINT>(sqrt(millionTriangles * 1e6 / meshCount / 4.0)), 8u);
+
+    std::vector<Mesh> meshes(meshCount);
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    for (UINT m = 0; m < meshCount; m++)
+    {
+        AppendSphere(&meshes[m], rings, &vertices, &indices);
+    }
+
+    const UINT64 triangleCount = indices.size() / 3;
+    const std::vector<UINT> sourceIndices = indices;
+
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds4> bounds;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    BuildSceneMeshlets(&jobSystem, meshes.data(), meshCount, vertices.data(), &indices, &meshlets, &bounds);
+    const double buildSeconds = GetElapsedSeconds(&start);
+
+    // Os meshlets cobrem todos os tringulos, e os ndices s mudaram de ordem.
+    UINT64 meshletTriangles = 0;
+    UINT64 meshletVertices = 0;
+    UINT usedMeshlets = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        meshletTriangles += meshlet.triangleCount;
+        meshletVertices += meshlet.vertexCount;
+        usedMeshlets += meshlet.triangleCount ? 1 : 0;
+    }
+
+    std::vector<UINT> sortedSource = sourceIndices;
+    std::vector<UINT> sortedIndices = indices;
+    std::sort(sortedSource.begin(), sortedSource.end());
+    std::sort(sortedIndices.begin(), sortedIndices.end());
+    const bool buildValid = meshletTriangles == triangleCount && sortedSource == sortedIndices;
+
+    std::vector<Model> models(meshCount);
+    for (UINT m = 0; m < meshCount; m++)
+    {
+        models[m] = {};
+        models[m].meshIndex = m;
+        XMStoreFloat4x4(&models[m].world, XMMatrixIdentity());
+        models[m].world._41 = 3.0f * BenchSphereRadius * m;
+    }
+
+    BenchTiming timing = { 0.0, 1e9 };
+    BenchTiming serialTiming = { 0.0, 1e9 };
+    std::vector<DrawCommand> drawList;
+    std::vector<DrawCommand> serialDrawList;
+    UINT64 keptIndices = 0;
+    UINT mismatchCount = 0;
+
+    for (UINT frame = 0; frame < BenchFrameCount; frame++)
+    {
+        CullFrame(&serialJobSystem, frame, meshCount, meshes, meshlets, bounds, models, &serialDrawList, &serialTiming);
+        CullFrame(&jobSystem, frame, meshCount, meshes, meshlets, bounds, models, &drawList, &timing);
+
+        keptIndices += CountIndices(drawList);
+
+        if (drawList.size() != serialDrawList.size() || memcmp(drawList.data(), serialDrawList.data(), drawList.size() * sizeof(DrawCommand)) != 0)
+            mismatchCount++;
+    }
+
+    const UINT measuredFrames = BenchFrameCount - BenchWarmupFrames;
+    const double average = timing.totalSeconds / measuredFrames;
+    const double serialAverage = serialTiming.totalSeconds / measuredFrames;
+
+    printf("%u malhas, %.2f milhoes de triangulos, %u meshlets (%.1f triangulos e %.1f vertices em media)\n", meshCount, triangleCount / 1e6, usedMeshlets,
+        static_cast<double>(meshletTriangles) / usedMeshlets, static_cast<double>(meshletVertices) / usedMeshlets);
+    printf("montagem: %.3f s, %.2f milhoes de triangulos/s%s\n", buildSeconds, triangleCount / buildSeconds / 1e6, buildValid ? "" : " (INVALIDA)");
+    printf("culling em serie: media %.3f ms, melhor %.3f ms, %.1f milhoes de meshlets/s\n", serialAverage * 1e3, serialTiming.bestSeconds * 1e3,
+        meshlets.size() / serialAverage / 1e6);
+    printf("culling com %u threads + a que chama: media %.3f ms, melhor %.3f ms, %.1f milhoes de meshlets/s\n", jobSystem.threadCount, average * 1e3,
+        timing.bestSeconds * 1e3, meshlets.size() / average / 1e6);
+    printf("triangulos desenhados: %.1f%% em media\n", 100.0 * keptIndices / (3.0 * triangleCount * BenchFrameCount));
+    printf("listas diferentes da serie em %u quadros\n", mismatchCount);
+
+    DestroyJobSystem(&jobSystem);
+    return (mismatchCount || !buildValid) ? 1 : 0;
+}
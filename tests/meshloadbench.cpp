@@ -0,0 +1,223 @@
+#include "testing.h"
+#include "mappedfile.h"
+#include "meshformat.h"
+#include "meshsimplify.h"
+#include "lodselect.h"
+#include "objimport.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Carga da mesma malha a partir do OBJ e do arquivo cozido (.imesh). Do OBJ, a carga  o que a engine faz na
+// partida: ImportObj, a cadeia de LODs e os limites; do .imesh, LoadBakedMesh, com LODs e limites j prontos. O
+// tempo s de ImportObj tambm  medido, para separar a leitura do texto do trabalho que o cozimento evita. O
+// .imesh  cozido como no Cooker (sem a reordenao por meshlets) e as duas cargas tm que dar a mesma cena. Os
+// arquivos so escritos no diretrio atual e apagados no fim.
+//
+//   meshloadbench [MB do OBJ] [threads]
+
+const UINT BenchRunCount = 3;
+
+const wchar_t* const BenchObjPath = L"meshloadbench.obj";
+const wchar_t* const BenchMeshPath = L"meshloadbench.imesh";
+
+struct BenchScene
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    std::vector<Mesh> meshes;
+    std::vector<Model> models;
+};
+
+struct BenchTiming
+{
+    double totalSeconds;
+    double bestSeconds;
+};
+
+static void AddTiming(BenchTiming* timing, double seconds)
+{
+    timing->totalSeconds += seconds;
+    timing->bestSeconds = (std::min)(timing->bestSeconds, seconds);
+}
+
+// Terreno de width x height vrtices, dois tringulos por quadrado, numa malha s.
+static UINT64 WriteTerrain(UINT width, UINT height)
+{
+    HANDLE file = CreateFile(BenchObjPath, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+    std::vector<char> buffer(4 * 1024 * 1024);
+    size_t used = 0;
+    UINT64 size = 0;
+
+    auto flush = [&]()
+    {
+        DWORD written = 0;
+        if (!WriteFile(file, buffer.data(), static_cast<DWORD>(used), &written, nullptr) || written != used)
+            ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+        size += used;
+        used = 0;
+    };
+
+    for (UINT y = 0; y < height; y++)
+    {
+        for (UINT x = 0; x < width; x++)
+        {
+            if (buffer.size() - used < 128)
+                flush();
+
+            const float px = x * 0.05f;
+            const float pz = y * 0.05f;
+            const float py = 2.0f * sinf(px * 0.31f) * cosf(pz * 0.17f) + 0.3f * sinf(px * 2.3f + pz * 1.9f);
+            used += snprintf(buffer.data() + used, buffer.size() - used, "v %.5f %.5f %.5f\n", px, py, pz);
+        }
+    }
+
+    for (UINT y = 1; y < height; y++)
+    {
+        for (UINT x = 1; x < width; x++)
+        {
+            if (buffer.size() - used < 128)
+                flush();
+
+            const UINT a = (y - 1) * width + x;
+            const UINT c = a + width;
+            used += snprintf(buffer.data() + used, buffer.size() - used, "f %u %u %u\nf %u %u %u\n", a, a + 1, c, a + 1, c + 1, c);
+        }
+    }
+
+    flush();
+    CloseHandle(file);
+
+    return size;
+}
+
+// O caminho de um OBJ na partida da engine: um modelo na origem por malha, LODs e limites.
+static void LoadSource(JobSystem* jobSystem, BenchScene* scene)
+{
+    ImportObj(jobSystem, BenchObjPath, &scene->vertices, &scene->indices, &scene->meshes);
+
+    for (UINT i = 0; i < scene->meshes.size(); i++)
+    {
+        Model model = {};
+        model.meshIndex = i;
+        XMStoreFloat4x4(&model.world, XMMatrixIdentity());
+        scene->models.push_back(model);
+    }
+
+    BuildLodChains(jobSystem, scene->meshes.data(), static_cast<UINT>(scene->meshes.size()), scene->vertices.data(), &scene->indices, &DefaultLodChainOptions);
+
+    for (Mesh& mesh : scene->meshes)
+    {
+        ComputeMeshBounds(&mesh, scene->vertices.data(), scene->indices.data());
+    }
+}
+
+// A engine chama BuildLodChains nas duas cargas; nas malhas cozidas ela no faz nada.
+static void LoadCooked(JobSystem* jobSystem, BenchScene* scene)
+{
+    LoadBakedMesh(BenchMeshPath, &scene->vertices, &scene->indices, &scene->meshes, &scene->models);
+    BuildLodChains(jobSystem, scene->meshes.data(), static_cast<UINT>(scene->meshes.size()), scene->vertices.data(), &scene->indices, &DefaultLodChainOptions);
+}
+
+static bool ScenesMatch(const BenchScene& a, const BenchScene& b)
+{
+    if (a.vertices.size() != b.vertices.size() || a.indices.size() != b.indices.size() || a.meshes.size() != b.meshes.size() || a.models.size() != b.models.size())
+        return false;
+
+    if (memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) != 0 || a.indices != b.indices)
+        return false;
+
+    for (size_t m = 0; m < a.meshes.size(); m++)
+    {
+        const Mesh& meshA = a.meshes[m];
+        const Mesh& meshB = b.meshes[m];
+        if (meshA.baseVertex != meshB.baseVertex || meshA.vertexCount != meshB.vertexCount || meshA.lodCount != meshB.lodCount ||
+            memcmp(meshA.lods, meshB.lods, meshA.lodCount * sizeof(MeshLod)) != 0 || meshA.boundsRadius != meshB.boundsRadius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const double megabytes = argc > 1 ? atof(argv[1]) : 64.0;
+    const UINT threadCount = argc > 2 ? static_cast<UINT>(atoi(argv[2])) : 0;
+
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem, threadCount);
+
+    // Uns 90 bytes por vrtice: a linha v e duas linhas f.
+    const UINT width = 1024;
+    const UINT height = (std::max)(static_cast<UINT>(megabytes * 1024 * 1024 / 90 / width), 2u);
+    const UINT64 sourceSize = WriteTerrain(width, height);
+
+    // Cozimento como no Cooker.
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    BenchScene cooked;
+    LoadSource(&jobSystem, &cooked);
+    ThrowIfFailed(SaveBakedMesh(BenchMeshPath, cooked.vertices.data(), static_cast<UINT>(cooked.vertices.size()), cooked.indices.data(),
+        static_cast<UINT>(cooked.indices.size()), cooked.meshes.data(), static_cast<UINT>(cooked.meshes.size()), cooked.models.data(), static_cast<UINT>(cooked.models.size())));
+    const double cookSeconds = GetElapsedSeconds(&start);
+
+    BenchTiming sourceTiming = { 0.0, 1e9 };
+    BenchTiming cookedTiming = { 0.0, 1e9 };
+    BenchTiming importTiming = { 0.0, 1e9 };
+    UINT mismatchCount = 0;
+
+    for (UINT run = 0; run < BenchRunCount; run++)
+    {
+        BenchScene source;
+        QueryPerformanceCounter(&start);
+        LoadSource(&jobSystem, &source);
+        AddTiming(&sourceTiming, GetElapsedSeconds(&start));
+
+        BenchScene baked;
+        QueryPerformanceCounter(&start);
+        LoadCooked(&jobSystem, &baked);
+        AddTiming(&cookedTiming, GetElapsedSeconds(&start));
+
+        if (!ScenesMatch(source, cooked) || !ScenesMatch(baked, cooked))
+            mismatchCount++;
+
+        BenchScene imported;
+        QueryPerformanceCounter(&start);
+        ImportObj(&jobSystem, BenchObjPath, &imported.vertices, &imported.indices, &imported.meshes);
+        AddTiming(&importTiming, GetElapsedSeconds(&start));
+    }
+
+    MappedFile cookedFile;
+    ThrowIfFailed(OpenMappedFile(BenchMeshPath, &cookedFile));
+    const UINT64 cookedSize = cookedFile.size;
+    CloseMappedFile(&cookedFile);
+
+    DeleteFile(BenchObjPath);
+    DeleteFile(BenchMeshPath);
+
+    const double sourceAverage = sourceTiming.totalSeconds / BenchRunCount;
+    const double cookedAverage = cookedTiming.totalSeconds / BenchRunCount;
+    const double importAverage = importTiming.totalSeconds / BenchRunCount;
+
+    printf("OBJ de %.1f MB, .imesh de %.1f MB: %zu vertices, %zu indices com os LODs, %u niveis\n", sourceSize / (1024.0 * 1024.0), cookedSize / (1024.0 * 1024.0),
+        cooked.vertices.size(), cooked.indices.size(), cooked.meshes.empty() ? 0 : cooked.meshes[0].lodCount);
+    printf("cozimento: %.3f s\n", cookSeconds);
+    printf("do OBJ: media %.3f s, melhor %.3f s\n", sourceAverage, sourceTiming.bestSeconds);
+    printf("so ImportObj: media %.3f s, melhor %.3f s\n", importAverage, importTiming.bestSeconds);
+    printf("do .imesh: media %.3f s, melhor %.3f s\n", cookedAverage, cookedTiming.bestSeconds);
+    printf("%u threads + a que chama: .imesh %.0fx mais rapido que a carga do OBJ, %.0fx que so ImportObj\n", jobSystem.threadCount,
+        sourceAverage / cookedAverage, importAverage / cookedAverage);
+    printf("cenas diferentes da cozida em %u cargas\n", mismatchCount);
+
+    DestroyJobSystem(&jobSystem);
+    return mismatchCount ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+#include "testing.h"
+#include "objimport.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Vazo de ImportObj num OBJ grande gerado, como o de um scan: grade de altura com cor por vrtice ("v x y z r g
+// b"), dois tringulos por vrtice e alguns objetos e materiais. O arquivo  escrito no diretrio atual, lido
+// algumas vezes j no cache do sistema e apagado no fim. A meta  bem mais de 1 GB/s numa estao Linux.
+//
+//   objparsebench [MB] [threads]
+
+const UINT BenchRunCount = 5;
+const UINT BenchObjectCount = 4;
+const double BenchTargetBytesPerSecond = 1e9;
+
+const wchar_t* const BenchObjPath = L"objparsebench.obj";
+const wchar_t* const BenchMtlPath = L"objparsebench.mtl";
+
+// Junta as linhas num buffer e escreve em blocos.
+struct BenchWriter
+{
+    HANDLE file;
+    std::vector<char> buffer;
+    size_t used;
+    UINT64 size;
+};
+
+static void Flush(BenchWriter* writer)
+{
+    DWORD written = 0;
+    if (!WriteFile(writer->file, writer->buffer.data(), static_cast<DWORD>(writer->used), &written, nullptr) || written != writer->used)
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+    writer->size += writer->used;
+    writer->used = 0;
+}
+
+template <typename... Arguments>
+static void Print(BenchWriter* writer, const char* format, Arguments... arguments)
+{
+    if (writer->buffer.size() - writer->used < 256)
+        Flush(writer);
+
+    writer->used += snprintf(writer->buffer.data() + writer->used, writer->buffer.size() - writer->used, format, arguments...);
+}
+
+static HANDLE CreateBenchFile(const wchar_t* path)
+{
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+    return file;
+}
+
+// Grade de width x height vrtices; as linhas de faces de cada objeto vm logo depois das suas posies.
+static UINT64 WriteScan(UINT width, UINT height)
+{
+    HANDLE mtl = CreateBenchFile(BenchMtlPath);
+    BenchWriter writer = { mtl, std::vector<char>(4096), 0, 0 };
+    for (UINT o = 0; o < BenchObjectCount; o++)
+    {
+        Print(&writer, "newmtl scan%u\nKd %.3f %.3f %.3f\nd 1.0\n\n", o, 0.5f + 0.1f * o, 0.5f, 0.5f);
+    }
+    Flush(&writer);
+    CloseHandle(mtl);
+
+    writer.file = CreateBenchFile(BenchObjPath);
+    writer.buffer.resize(4 * 1024 * 1024);
+    writer.size = 0;
+
+    Print(&writer, "# objparsebench\nmtllib objparsebench.mtl\n");
+
+    const UINT rowsPerObject = (height + BenchObjectCount - 1) / BenchObjectCount;
+    for (UINT o = 0; o < BenchObjectCount; o++)
+    {
+        const UINT firstRow = o * rowsPerObject;
+        const UINT lastRow = (std::min)(firstRow + rowsPerObject, height);
+
+        Print(&writer, "o scan%u\nusemtl scan%u\n", o, o);
+
+        for (UINT y = firstRow; y < lastRow; y++)
+        {
+            for (UINT x = 0; x < width; x++)
+            {
+                const float px = x * 0.01f;
+                const float pz = y * 0.01f;
+                const float py = 0.5f * sinf(px * 0.7f) * cosf(pz * 1.3f);
+                const float shade = 0.5f + py;
+                Print(&writer, "v %.6f %.6f %.6f %.4f %.4f %.4f\n", px, py, pz, shade, shade * 0.8f, 1.0f - shade);
+            }
+        }
+
+        // Faces das linhas deste objeto, ligando  linha anterior (que pode ser do objeto anterior).
+        for (UINT y = (std::max)(firstRow, 1u); y < lastRow; y++)
+        {
+            for (UINT x = 1; x < width; x++)
+            {
+                const UINT a = (y - 1) * width + x;
+                const UINT b = a + 1;
+                const UINT c = a + width;
+                const UINT d = c + 1;
+                Print(&writer, "f %u %u %u\nf %u %u %u\n", a, b, c, b, d, c);
+            }
+        }
+    }
+
+    Flush(&writer);
+    CloseHandle(writer.file);
+
+    return writer.size;
+}
+
+int main(int argc, char** argv)
+{
+    const double megabytes = argc > 1 ? atof(argv[1]) : 512.0;
+    const UINT threadCount = argc > 2 ? static_cast<UINT>(atoi(argv[2])) : 0;
+
+    JobSystem jobSystem;
+    InitJobSystem(&jobSystem, threadCount);
+
+    // Uns 110 bytes por vrtice: a linha v e duas linhas f.
+    const UINT width = 2048;
+    const UINT height = (std::max)(static_cast<UINT>(megabytes * 1024 * 1024 / 110 / width), 2u);
+    const UINT64 triangleCount = 2ull * (width - 1) * (height - 1);
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    const UINT64 fileSize = WriteScan(width, height);
+    const double writeSeconds = GetElapsedSeconds(&start);
+
+    double totalSeconds = 0.0;
+    double bestSeconds = 1e9;
+    UINT64 vertexCount = 0;
+    UINT64 indexCount = 0;
+    size_t meshCount = 0;
+    bool colorsValid = true;
+
+    for (UINT run = 0; run < BenchRunCount; run++)
+    {
+        std::vector<Vertex> vertices;
+        std::vector<UINT> indices;
+        std::vector<Mesh> meshes;
+
+        QueryPerformanceCounter(&start);
+        ImportObj(&jobSystem, BenchObjPath, &vertices, &indices, &meshes);
+        const double seconds = GetElapsedSeconds(&start);
+
+        totalSeconds += seconds;
+        bestSeconds = (std::min)(bestSeconds, seconds);
+
+        vertexCount = vertices.size();
+        indexCount = indices.size();
+        meshCount = meshes.size();
+
+        // A cor vem das linhas v, no do Kd do material.
+        colorsValid = colorsValid && !vertices.empty() && vertices[0].color.w == 1.0f && fabsf(vertices[0].color.x - 0.5f) < 1e-3f;
+    }
+
+    DeleteFile(BenchObjPath);
+    DeleteFile(BenchMtlPath);
+
+    const double average = totalSeconds / BenchRunCount;
+    // Cada objeto repete a linha da grade que liga as suas faces s do anterior.
+    const UINT64 expectedVertexCount = static_cast<UINT64>(width) * (height + BenchObjectCount - 1);
+    const bool valid = vertexCount == expectedVertexCount && indexCount == triangleCount * 3 && meshCount == BenchObjectCount && colorsValid;
+
+    printf("%.1f MB gerados em %.2f s: %u x %u vertices, %llu triangulos, %u objetos\n", fileSize / (1024.0 * 1024.0), writeSeconds, width, height,
+        static_cast<unsigned long long>(triangleCount), BenchObjectCount);
+    printf("importados: %zu malhas, %llu vertices, %llu indices%s\n", meshCount, static_cast<unsigned long long>(vertexCount),
+        static_cast<unsigned long long>(indexCount), valid ? "" : " (INVALIDO)");
+    printf("%u threads + a que chama: media %.3f s (%.2f GB/s), melhor %.3f s (%.2f GB/s)\n", jobSystem.threadCount, average, fileSize / average / 1e9,
+        bestSeconds, fileSize / bestSeconds / 1e9);
+    printf("meta de %.1f GB/s: %s\n", BenchTargetBytesPerSecond / 1e9, fileSize / average >= BenchTargetBytesPerSecond ? "atingida" : "NAO atingida");
+
+    DestroyJobSystem(&jobSystem);
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+#include "testing.h"
+#include "release.h"
+
+#include <algorithm>
+#include <vector>
+
+// Fence simulado: a CPU sinaliza um valor por quadro e a GPU completa com atraso, s vezes vrios de uma vez.
+struct SimulatedFence
+{
+    UINT64 nextValue;
+    UINT64 completedValue;
+};
+
+// Objeto de GPU simulado: lastUse  o fence do ltimo quadro que o usou.
+struct SimulatedObject
+{
+    UINT64 lastUse;
+    UINT releaseCount;
+};
+
+struct ReleaseLog
+{
+    const SimulatedFence* fence;
+    std::vector<SimulatedObject*> released;
+    UINT earlyCount;            // Liberados antes de a GPU terminar com eles.
+};
+
+static void ReleaseObject(void* context, void* object)
+{
+    ReleaseLog* log = reinterpret_cast<ReleaseLog*>(context);
+    SimulatedObject* simulated = reinterpret_cast<SimulatedObject*>(object);
+
+    if (log->fence && simulated->lastUse > log->fence->completedValue)
+        log->earlyCount++;
+
+    simulated->releaseCount++;
+    log->released.push_back(simulated);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Quadros com a GPU de 0 a 3 quadros atrs: nada  liberado antes do fence, e tudo o que o fence passou 
+// liberado na primeira chamada depois disso.
+static void TestFrameLoop()
+{
+    const UINT frameCount = 20000;
+
+    SimulatedFence fence = { 1, 0 };
+    ReleaseLog log = { &fence, {}, 0 };
+    ReleaseQueue queue;
+    InitReleaseQueue(&queue);
+
+    UINT64 random = 1;
+    std::vector<SimulatedObject> objects(frameCount * 4);
+    UINT objectCount = 0;
+
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        const UINT64 lag = NextRandom(&random) % 4;
+        if (fence.nextValue > lag + 1)
+            fence.completedValue = (std::max)(fence.completedValue, fence.nextValue - 1 - lag);
+
+        const size_t releasedBefore = log.released.size();
+        const UINT releasedCount = ProcessReleases(&queue, fence.completedValue);
+        CHECK(releasedCount == log.released.size() - releasedBefore);
+
+        for (const DeferredRelease& entry : queue.pending)
+        {
+            CHECK(entry.fenceValue > fence.completedValue);
+        }
+
+        const UINT newCount = NextRandom(&random) % 5;
+        for (UINT i = 0; i < newCount; i++)
+        {
+            SimulatedObject* object = &objects[objectCount++];
+            *object = { fence.nextValue, 0 };
+            DeferRelease(&queue, fence.nextValue, ReleaseObject, &log, object);
+        }
+
+        fence.nextValue++;
+    }
+
+    CHECK(log.earlyCount == 0);
+    CHECK(queue.releasedCount == log.released.size());
+    CHECK(queue.releasedCount + queue.pending.size() == objectCount);
+}
+
+// Valores fora de ordem (de outra fila, por exemplo) s atrasam a liberao: o 3 atrs do 5 espera o 5.
+static void TestOutOfOrderValues()
+{
+    SimulatedFence fence = { 0, 0 };
+    ReleaseLog log = { &fence, {}, 0 };
+    ReleaseQueue queue;
+    InitReleaseQueue(&queue);
+
+    SimulatedObject objects[4] = { { 5, 0 }, { 3, 0 }, { 7, 0 }, { 6, 0 } };
+    for (SimulatedObject& object : objects)
+    {
+        DeferRelease(&queue, object.lastUse, ReleaseObject, &log, &object);
+    }
+
+    fence.completedValue = 4;
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 0);
+    CHECK(objects[1].releaseCount == 0);
+
+    fence.completedValue = 6;
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 2);
+    CHECK(log.released.size() == 2 && log.released[0] == &objects[0] && log.released[1] == &objects[1]);
+
+    // O 6 est atrs do 7.
+    CHECK(objects[3].releaseCount == 0);
+
+    fence.completedValue = 10;
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 2);
+    CHECK(queue.pending.empty());
+
+    CHECK(log.earlyCount == 0);
+    for (const SimulatedObject& object : objects)
+    {
+        CHECK(object.releaseCount == 1);
+    }
+}
+
+// A GPU completa vrios quadros de uma vez, ou nenhum: uma chamada libera tudo at o valor completado, e
+// chamadas repetidas com o mesmo valor no liberam de novo.
+static void TestBatchedCompletion()
+{
+    SimulatedFence fence = { 0, 0 };
+    ReleaseLog log = { &fence, {}, 0 };
+    ReleaseQueue queue;
+    InitReleaseQueue(&queue);
+
+    std::vector<SimulatedObject> objects(30);
+    for (UINT i = 0; i < 30; i++)
+    {
+        objects[i] = { 1 + i / 3, 0 };
+        DeferRelease(&queue, objects[i].lastUse, ReleaseObject, &log, &objects[i]);
+    }
+
+    CHECK(ProcessReleases(&queue, 0) == 0);
+
+    fence.completedValue = 4;
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 12);
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 0);
+
+    fence.completedValue = 10;
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 18);
+    CHECK(queue.releasedCount == 30);
+
+    for (UINT i = 0; i < 30; i++)
+    {
+        CHECK(log.released[i] == &objects[i]);
+        CHECK(objects[i].releaseCount == 1);
+    }
+}
+
+// Liberao que adia outra (um recurso que segura outro): a nova entrada entra na fila durante a chamada e sai
+// na mesma chamada, se o fence dela j passou.
+struct ChainedRelease
+{
+    ReleaseQueue* queue;
+    ReleaseLog* log;
+    SimulatedObject* child;
+};
+
+static void ReleaseParent(void* context, void* object)
+{
+    ChainedRelease* chain = reinterpret_cast<ChainedRelease*>(context);
+
+    ReleaseObject(chain->log, object);
+    DeferRelease(chain->queue, chain->child->lastUse, ReleaseObject, chain->log, chain->child);
+}
+
+static void TestReleaseFromCallback()
+{
+    SimulatedFence fence = { 0, 0 };
+    ReleaseLog log = { &fence, {}, 0 };
+    ReleaseQueue queue;
+    InitReleaseQueue(&queue);
+
+    SimulatedObject parent = { 2, 0 };
+    SimulatedObject child = { 2, 0 };
+    ChainedRelease chain = { &queue, &log, &child };
+
+    DeferRelease(&queue, parent.lastUse, ReleaseParent, &chain, &parent);
+
+    fence.completedValue = 2;
+    CHECK(ProcessReleases(&queue, fence.completedValue) == 2);
+    CHECK(parent.releaseCount == 1 && child.releaseCount == 1);
+    CHECK(queue.pending.empty());
+}
+
+// No desligamento a GPU est parada: FlushReleases libera tudo, inclusive o que o fence ainda no alcanou, e
+// cada objeto uma vez s.
+static void TestFlushOnShutdown()
+{
+    ReleaseLog log = { nullptr, {}, 0 };
+    ReleaseQueue queue;
+    InitReleaseQueue(&queue);
+
+    std::vector<SimulatedObject> objects(100);
+    for (UINT i = 0; i < 100; i++)
+    {
+        objects[i] = { 1 + (i * 7) % 13, 0 };
+        DeferRelease(&queue, objects[i].lastUse, ReleaseObject, &log, &objects[i]);
+    }
+
+    const UINT processedCount = ProcessReleases(&queue, 1);
+    FlushReleases(&queue);
+
+    CHECK(queue.pending.empty());
+    CHECK(queue.releasedCount == 100);
+    CHECK(log.released.size() == 100);
+    CHECK(processedCount < 100);
+
+    for (const SimulatedObject& object : objects)
+    {
+        CHECK(object.releaseCount == 1);
+    }
+
+    // Uma fila vazia pode ser esvaziada de novo.
+    FlushReleases(&queue);
+    CHECK(queue.releasedCount == 100);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    TestFrameLoop();
+    TestOutOfOrderValues();
+    TestBatchedCompletion();
+    TestReleaseFromCallback();
+    TestFlushOnShutdown();
+
+    return TestFailures();
+}
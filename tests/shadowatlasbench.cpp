@@ -0,0 +1,118 @@
+#include "testing.h"
+#include "shadowatlas.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Tempo de UpdateShadowAtlas com 1.000 luzes (dois teros spots, um tero pontuais) no atlas padro, numa
+// sequncia de quadros em que o tamanho na tela de cada luz oscila e algumas saem e voltam ao frustum: a
+// alocao inicial, os quadros comuns e a realocao de tudo, que UpdateShadowAtlas faz quando a fragmentao
+// impede algum tile. Como a fragmentao  rara, a realocao tambm  medida  parte, a cada 10 quadros, num
+// segundo atlas reiniciado com os pedidos do quadro.
+//
+//   shadowatlasbench [luzes] [quadros]
+
+struct BenchLight
+{
+    float baseSize;
+    float speed;
+    float phase;
+};
+
+int main(int argc, char** argv)
+{
+    const UINT lightCount = argc > 1 ? static_cast<UINT>(atoi(argv[1])) : 1000;
+    const UINT frameCount = argc > 2 ? static_cast<UINT>(atoi(argv[2])) : 600;
+
+    UINT64 random = 7;
+    std::vector<BenchLight> benchLights(lightCount);
+    std::vector<ShadowAtlasLight> lights(lightCount);
+    for (UINT i = 0; i < lightCount; i++)
+    {
+        // Tamanhos de 16 a 1024 pixels, distribudos em log: muitas luzes pequenas, poucas grandes.
+        benchLights[i].baseSize = 16.0f * powf(64.0f, RandomFloat(&random));
+        benchLights[i].speed = 0.01f + 0.05f * RandomFloat(&random);
+        benchLights[i].phase = 6.2831853f * RandomFloat(&random);
+
+        lights[i].faceCount = i % 3 == 0 ? 6 : 1;
+        lights[i].importance = 0.2f + 0.8f * RandomFloat(&random);
+        lights[i].screenSize = benchLights[i].baseSize;
+    }
+
+    ShadowAtlas atlas;
+    ShadowAtlas repackAtlas;
+    InitShadowAtlas(&atlas, &DefaultShadowAtlasSettings);
+    InitShadowAtlas(&repackAtlas, &DefaultShadowAtlasSettings);
+    UpdateShadowAtlas(&repackAtlas, lights.data(), lightCount);
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    UpdateShadowAtlas(&atlas, lights.data(), lightCount);
+    const double initialSeconds = GetElapsedSeconds(&start);
+    const UINT initialShadowed = atlas.shadowedCount;
+
+    double frameSeconds = 0.0, worstFrameSeconds = 0.0, repackSeconds = 0.0, forcedRepackSeconds = 0.0, worstForcedRepackSeconds = 0.0;
+    UINT repackCount = 0, forcedRepackCount = 0;
+    UINT64 changedSum = 0, droppedSum = 0, shadowedSum = 0;
+    double usedSum = 0.0;
+    const double atlasTexels = static_cast<double>(atlas.settings.size) * atlas.settings.size;
+
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        for (UINT i = 0; i < lightCount; i++)
+        {
+            const BenchLight& light = benchLights[i];
+            const float wave = sinf(frame * light.speed + light.phase);
+
+            // Um pouco menos de um dcimo do tempo, a luz est fora do frustum.
+            const bool visible = sinf(frame * light.speed * 0.37f + light.phase * 3.0f) > -0.95f;
+            lights[i].screenSize = visible ? light.baseSize * (1.0f + 0.8f * wave) : 0.0f;
+        }
+
+        QueryPerformanceCounter(&start);
+        UpdateShadowAtlas(&atlas, lights.data(), lightCount);
+        const double seconds = GetElapsedSeconds(&start);
+
+        if (atlas.repacked)
+        {
+            repackSeconds += seconds;
+            repackCount++;
+        }
+        else
+        {
+            frameSeconds += seconds;
+        }
+
+        worstFrameSeconds = (std::max)(worstFrameSeconds, seconds);
+        changedSum += atlas.changedCount;
+        droppedSum += atlas.droppedCount;
+        shadowedSum += atlas.shadowedCount;
+        usedSum += atlas.usedTexels / atlasTexels;
+
+        // InitShadowAtlas reaproveita a memria do atlas: s a realocao entra no tempo.
+        if (frame % 10 == 0)
+        {
+            QueryPerformanceCounter(&start);
+            InitShadowAtlas(&repackAtlas, &DefaultShadowAtlasSettings);
+            UpdateShadowAtlas(&repackAtlas, lights.data(), lightCount);
+            const double forcedSeconds = GetElapsedSeconds(&start);
+
+            forcedRepackSeconds += forcedSeconds;
+            worstForcedRepackSeconds = (std::max)(worstForcedRepackSeconds, forcedSeconds);
+            forcedRepackCount++;
+        }
+    }
+
+    const UINT normalCount = frameCount - repackCount;
+    printf("%u luzes, atlas %u, tiles de %u a %u\n", lightCount, atlas.settings.size, atlas.settings.minTileSize, atlas.settings.maxTileSize);
+    printf("alocacao inicial %.3f ms, %u luzes com sombra\n", initialSeconds * 1e3, initialShadowed);
+    printf("%u quadros: %.3f ms por quadro, pior %.3f ms\n", frameCount, normalCount ? frameSeconds / normalCount * 1e3 : 0.0, worstFrameSeconds * 1e3);
+    printf("realocacoes por fragmentacao em %u quadros, %.3f ms cada\n", repackCount, repackCount ? repackSeconds / repackCount * 1e3 : 0.0);
+    printf("realocacao completa forcada: %.3f ms, pior %.3f ms\n", forcedRepackSeconds / forcedRepackCount * 1e3, worstForcedRepackSeconds * 1e3);
+    printf("por quadro: %.1f com sombra, %.1f redesenhadas, %.1f sem sombra, %.1f%% do atlas usado\n", static_cast<double>(shadowedSum) / frameCount,
+        static_cast<double>(changedSum) / frameCount, static_cast<double>(droppedSum) / frameCount, 100.0 * usedSum / frameCount);
+
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include "testing.h"
+#include "shadowcache.h"
+
+#include <vector>
+
+// Cascata de 200 x 200 metros olhando para baixo, sem depender de BuildShadowCascades: x vai para u e z para v.
+// Os modelos so esferas de 1 metro, que com 1024 texels ocupam um tile s quando esto no centro dele.
+const float CascadeSize = 200.0f;
+
+static void MakeCascade(UINT resolution, float offsetX, ShadowCascade* cascade)
+{
+    XMFLOAT4X4& m = cascade->viewProjection;
+    m = {};
+    m._11 = 2.0f / CascadeSize;
+    m._32 = 2.0f / CascadeSize;
+    m._23 = -0.001f;
+    m._41 = -offsetX * 2.0f / CascadeSize;
+    m._43 = 0.5f;
+    m._44 = 1.0f;
+
+    cascade->splitNear = 0.0f;
+    cascade->splitFar = 100.0f;
+    cascade->radius = CascadeSize * 0.5f;
+    cascade->texelSize = CascadeSize / resolution;
+}
+
+static void MakeMesh(Mesh* mesh)
+{
+    *mesh = {};
+    mesh->lods[0] = { 0, 300, 0.0f };
+    mesh->lods[1] = { 300, 90, 0.1f };
+    mesh->lodCount = 2;
+    mesh->boundsCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    mesh->boundsRadius = 1.0f;
+}
+
+// Pe o modelo no centro do tile (x, y) da cascata. O ltimo tile vai at a borda quando a resoluo no 
+// mltipla do nmero de tiles.
+static void PlaceModel(Model* model, UINT resolution, float offsetX, UINT x, UINT y)
+{
+    const UINT tileSize = resolution / ShadowCacheTiles;
+    const float u = x + 1 == ShadowCacheTiles ? (x * tileSize + resolution) * 0.5f : (x + 0.5f) * tileSize;
+    const float v = y + 1 == ShadowCacheTiles ? (y * tileSize + resolution) * 0.5f : (y + 0.5f) * tileSize;
+
+    *model = {};
+    XMStoreFloat4x4(&model->world, XMMatrixIdentity());
+    model->world._41 = (u / resolution - 0.5f) * CascadeSize + offsetX;
+    model->world._43 = (0.5f - v / resolution) * CascadeSize;
+}
+
+static DrawCommand MakeDraw(const Mesh* mesh, UINT modelIndex, UINT lod)
+{
+    return { modelIndex, mesh->lods[lod].indexCount, mesh->lods[lod].startIndex, mesh->baseVertex };
+}
+
+static void UpdateCache(ShadowCache* cache, const ShadowCascade* cascade, const Mesh* mesh, const std::vector<Model>& models,
+    const std::vector<DrawCommand>& casters)
+{
+    UpdateShadowCache(cache, cascade, mesh, models.data(), static_cast<UINT>(models.size()), &casters);
+}
+
+static UINT GetTile(UINT x, UINT y)
+{
+    return y * ShadowCacheTiles + x;
+}
+
+// Tiles redesenhados, por ndice crescente. Cada tile aparece em um retngulo no mximo.
+static std::vector<UINT> GetRedrawnTiles(const ShadowCache* cache)
+{
+    const ShadowCacheCascade* cascade = &cache->cascades[0];
+    const UINT tileSize = cache->resolution / ShadowCacheTiles;
+
+    std::vector<UINT> coverage(ShadowCacheTiles * ShadowCacheTiles, 0);
+    for (const ShadowCacheRect& rect : cascade->rects)
+    {
+        CHECK(rect.left < rect.right && rect.top < rect.bottom);
+        CHECK(rect.right <= cache->resolution && rect.bottom <= cache->resolution);
+        CHECK(rect.firstDraw + rect.drawCount <= cascade->draws.size());
+
+        for (UINT y = rect.top / tileSize; y < (std::min)(rect.bottom / tileSize, ShadowCacheTiles); y++)
+        {
+            for (UINT x = rect.left / tileSize; x < (std::min)(rect.right / tileSize, ShadowCacheTiles); x++)
+                coverage[GetTile(x, y)]++;
+        }
+    }
+
+    std::vector<UINT> tiles;
+    for (UINT tile = 0; tile < coverage.size(); tile++)
+    {
+        CHECK(coverage[tile] <= 1);
+        if (coverage[tile])
+            tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+static bool IsFullRedraw(const ShadowCache* cache, UINT casterCount)
+{
+    const ShadowCacheCascade* cascade = &cache->cascades[0];
+    return cascade->rects.size() == 1 && cascade->rects[0].left == 0 && cascade->rects[0].top == 0 &&
+        cascade->rects[0].right == cache->resolution && cascade->rects[0].bottom == cache->resolution &&
+        cascade->rects[0].drawCount == casterCount && cascade->draws.size() == casterCount &&
+        cache->dirtyTileCount == ShadowCacheTiles * ShadowCacheTiles;
+}
+
+static bool IsIdle(const ShadowCache* cache)
+{
+    return cache->cascades[0].rects.empty() && cache->cascades[0].draws.empty() && cache->dirtyTileCount == 0 && cache->drawCount == 0;
+}
+
+// Os modelos desenhados no retngulo, na ordem.
+static std::vector<UINT> GetRectModels(const ShadowCache* cache, UINT rectIndex)
+{
+    const ShadowCacheCascade* cascade = &cache->cascades[0];
+    const ShadowCacheRect& rect = cascade->rects[rectIndex];
+
+    std::vector<UINT> models;
+    for (UINT i = rect.firstDraw; i < rect.firstDraw + rect.drawCount; i++)
+        models.push_back(cascade->draws[i].modelIndex);
+    return models;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Cada diferena da lista de casters suja s os tiles do caster: o que entra, o que sai, o que anda (antes e
+// depois) e o que troca de LOD. Os casters parados que tocam um retngulo sujo so redesenhados nele.
+static void TestCasterDiffs()
+{
+    const UINT resolution = 1024;
+
+    ShadowCascade cascade;
+    MakeCascade(resolution, 0.0f, &cascade);
+    Mesh mesh;
+    MakeMesh(&mesh);
+
+    std::vector<Model> models(6);
+    PlaceModel(&models[0], resolution, 0.0f, 1, 1);
+    PlaceModel(&models[1], resolution, 0.0f, 5, 3);
+    PlaceModel(&models[2], resolution, 0.0f, 9, 9);
+    PlaceModel(&models[3], resolution, 0.0f, 14, 2);
+    PlaceModel(&models[4], resolution, 0.0f, 7, 7);
+    PlaceModel(&models[5], resolution, 0.0f, 10, 9);
+
+    std::vector<DrawCommand> casters = { MakeDraw(&mesh, 0, 0), MakeDraw(&mesh, 1, 0), MakeDraw(&mesh, 2, 0), MakeDraw(&mesh, 5, 0) };
+
+    ShadowCache cache;
+    InitShadowCache(&cache, resolution, 1);
+
+    // O primeiro quadro desenha tudo; o seguinte, sem mudanas, nada.
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsFullRedraw(&cache, 4));
+    CHECK(cache.casterCount == 4);
+
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsIdle(&cache));
+    CHECK(cache.casterCount == 4);
+
+    // Entra o 3.
+    casters.insert(casters.begin() + 3, MakeDraw(&mesh, 3, 0));
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(GetRedrawnTiles(&cache) == std::vector<UINT>({ GetTile(14, 2) }));
+    CHECK(cache.dirtyTileCount == 1);
+    CHECK(GetRectModels(&cache, 0) == std::vector<UINT>({ 3 }));
+
+    // Sai o 1: o tile  limpo e fica vazio.
+    casters.erase(casters.begin() + 1);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(GetRedrawnTiles(&cache) == std::vector<UINT>({ GetTile(5, 3) }));
+    CHECK(GetRectModels(&cache, 0).empty());
+
+    // O 2 anda para o tile do 5: os dois tiles, num retngulo s, com o 2 e o 5.
+    PlaceModel(&models[2], resolution, 0.0f, 10, 9);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(GetRedrawnTiles(&cache) == std::vector<UINT>({ GetTile(9, 9), GetTile(10, 9) }));
+    CHECK(cache.cascades[0].rects.size() == 1);
+    CHECK(GetRectModels(&cache, 0) == std::vector<UINT>({ 2, 5 }));
+
+    // O 0 troca de LOD e  redesenhado com o draw novo.
+    casters[0] = MakeDraw(&mesh, 0, 1);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(GetRedrawnTiles(&cache) == std::vector<UINT>({ GetTile(1, 1) }));
+    CHECK(cache.cascades[0].draws.size() == 1 && cache.cascades[0].draws[0].indexCount == mesh.lods[1].indexCount);
+
+    // A geometria do 0 muda de lugar no buffer (streaming) com o mesmo LOD.
+    mesh.lods[1].startIndex += 3;
+    casters[0] = MakeDraw(&mesh, 0, 1);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(GetRedrawnTiles(&cache) == std::vector<UINT>({ GetTile(1, 1) }));
+
+    // O 4 no projeta sombra nesta cascata: andar no suja nada.
+    PlaceModel(&models[4], resolution, 0.0f, 3, 12);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsIdle(&cache));
+}
+
+// Mudar a matriz da cascata, invalidar o cache ou mudar o nmero de modelos redesenha a cascata inteira.
+static void TestFullInvalidation()
+{
+    const UINT resolution = 1024;
+
+    ShadowCascade cascade;
+    MakeCascade(resolution, 0.0f, &cascade);
+    Mesh mesh;
+    MakeMesh(&mesh);
+
+    std::vector<Model> models(3);
+    std::vector<DrawCommand> casters;
+    for (UINT i = 0; i < 3; i++)
+    {
+        PlaceModel(&models[i], resolution, 0.0f, 4 * i, 2 * i);
+        casters.push_back(MakeDraw(&mesh, i, 0));
+    }
+
+    ShadowCache cache;
+    InitShadowCache(&cache, resolution, 1);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsIdle(&cache));
+
+    // A cascata anda um tile: nada mais na cascata mudou, mas tudo  redesenhado, uma vez.
+    MakeCascade(resolution, CascadeSize / ShadowCacheTiles, &cascade);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsFullRedraw(&cache, 3));
+
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsIdle(&cache));
+
+    // O contedo do shadow map foi perdido.
+    InvalidateShadowCache(&cache);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsFullRedraw(&cache, 3));
+
+    // Um modelo a mais na cena, fora da cascata.
+    models.push_back(models[0]);
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsFullRedraw(&cache, 3));
+
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(IsIdle(&cache));
+}
+
+// Os tiles sujos viram retngulos de cima para baixo: cada sequncia numa linha desce enquanto a linha de baixo
+// tem a mesma sequncia suja, e o que sobra vira outro retngulo.
+static void TestDirtyRectMerging()
+{
+    const UINT resolution = 1024;
+    const UINT tileSize = resolution / ShadowCacheTiles;
+
+    ShadowCascade cascade;
+    MakeCascade(resolution, 0.0f, &cascade);
+    Mesh mesh;
+    MakeMesh(&mesh);
+
+    // Um bloco de 3 x 2, um tile isolado, um L, uma escada e o canto.
+    const UINT tiles[][2] =
+    {
+        { 12, 1 },
+        { 2, 5 }, { 3, 5 }, { 4, 5 }, { 2, 6 }, { 3, 6 }, { 4, 6 },
+        { 0, 10 }, { 1, 10 }, { 0, 11 },
+        { 7, 12 }, { 8, 12 }, { 8, 13 },
+        { 15, 15 },
+    };
+    const UINT tileCount = _countof(tiles);
+
+    std::vector<Model> models(tileCount);
+    std::vector<DrawCommand> casters;
+    for (UINT i = 0; i < tileCount; i++)
+    {
+        PlaceModel(&models[i], resolution, 0.0f, tiles[i][0], tiles[i][1]);
+        casters.push_back(MakeDraw(&mesh, i, 0));
+    }
+
+    ShadowCache cache;
+    InitShadowCache(&cache, resolution, 1);
+    UpdateCache(&cache, &cascade, &mesh, models, std::vector<DrawCommand>());
+    UpdateCache(&cache, &cascade, &mesh, models, casters);
+    CHECK(cache.dirtyTileCount == tileCount);
+
+    // Em tiles: esquerda, topo, direita e base, inclusivos, e os casters de cada um.
+    const UINT expected[][4] =
+    {
+        { 12, 1, 12, 1 },
+        { 2, 5, 4, 6 },
+        { 0, 10, 1, 10 },
+        { 0, 11, 0, 11 },
+        { 7, 12, 8, 12 },
+        { 8, 13, 8, 13 },
+        { 15, 15, 15, 15 },
+    };
+    const UINT expectedDraws[] = { 1, 6, 2, 1, 2, 1, 1 };
+
+    const std::vector<ShadowCacheRect>& rects = cache.cascades[0].rects;
+    CHECK(rects.size() == _countof(expected));
+    for (UINT i = 0; i < rects.size() && i < _countof(expected); i++)
+    {
+        CHECK(rects[i].left == expected[i][0] * tileSize && rects[i].top == expected[i][1] * tileSize);
+        CHECK(rects[i].right == (expected[i][2] + 1) * tileSize && rects[i].bottom == (expected[i][3] + 1) * tileSize);
+        CHECK(rects[i].drawCount == expectedDraws[i]);
+    }
+    CHECK(cache.drawCount == tileCount);
+
+    // Com uma resoluo que no  mltipla de 16, o ltimo tile vai at a borda.
+    const UINT oddResolution = 1000;
+    MakeCascade(oddResolution, 0.0f, &cascade);
+    std::vector<Model> corner(1);
+    PlaceModel(&corner[0], oddResolution, 0.0f, 15, 15);
+
+    InitShadowCache(&cache, oddResolution, 1);
+    UpdateCache(&cache, &cascade, &mesh, corner, std::vector<DrawCommand>());
+    UpdateCache(&cache, &cascade, &mesh, corner, { MakeDraw(&mesh, 0, 0) });
+
+    const UINT oddTileSize = oddResolution / ShadowCacheTiles;
+    CHECK(cache.cascades[0].rects.size() == 1);
+    if (!cache.cascades[0].rects.empty())
+    {
+        const ShadowCacheRect& rect = cache.cascades[0].rects[0];
+        CHECK(rect.left == 15 * oddTileSize && rect.top == 15 * oddTileSize);
+        CHECK(rect.right == oddResolution && rect.bottom == oddResolution && rect.drawCount == 1);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    TestCasterDiffs();
+    TestFullInvalidation();
+    TestDirtyRectMerging();
+
+    return TestFailures();
+}
@@ -0,0 +1,275 @@
+#include "testing.h"
+#include "shadowcascades.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Cmera com fov de 60 graus, 16:9, near 1 e far 1000; as cascatas vo at shadowDistance (200). A luz vem de
+// cima, inclinada.
+const float CameraFov = 60.0f;
+const float CameraAspect = 16.0f / 9.0f;
+const float CameraNear = 1.0f;
+const float CameraFar = 1000.0f;
+const XMFLOAT3 LightDirection = XMFLOAT3(0.3f, -1.0f, 0.2f);
+
+static XMMATRIX MakeView(float x, float z, float yaw)
+{
+    return XMMatrixLookToLH(XMVectorSet(x, 5.0f, z, 0.0f), XMVectorSet(sinf(yaw), -0.2f, cosf(yaw), 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+static void BuildCascades(FXMMATRIX view, ShadowCascade* cascades)
+{
+    BuildShadowCascades(&DefaultShadowSettings, view, CameraFov, CameraAspect, CameraNear, CameraFar, LightDirection, cascades);
+}
+
+// Ponto de mundo nas coordenadas da cascata: [-1, 1] em x e y e [0, 1] em z dentro dela.
+static XMFLOAT3 ToCascade(const ShadowCascade* cascade, FXMVECTOR position)
+{
+    XMFLOAT3 result;
+    XMStoreFloat3(&result, XMVector3TransformCoord(position, XMLoadFloat4x4(&cascade->viewProjection)));
+    return result;
+}
+
+static XMVECTOR FromCascade(const ShadowCascade* cascade, float x, float y, float z)
+{
+    const XMMATRIX inverse = XMMatrixInverse(nullptr, XMLoadFloat4x4(&cascade->viewProjection));
+    return XMVector3TransformCoord(XMVectorSet(x, y, z, 0.0f), inverse);
+}
+
+static void TestSplits()
+{
+    float splits[MaxShadowCascades + 1];
+
+    // lambda 0: fatias iguais.
+    ComputeCascadeSplits(1.0f, 201.0f, 4, 0.0f, splits);
+    for (UINT i = 0; i <= 4; i++)
+        CHECK(fabsf(splits[i] - (1.0f + 50.0f * i)) < 1e-3f);
+
+    // lambda 1: a razo entre duas divises seguidas  sempre a mesma.
+    ComputeCascadeSplits(1.0f, 256.0f, 4, 1.0f, splits);
+    for (UINT i = 0; i <= 4; i++)
+        CHECK(fabsf(splits[i] - powf(4.0f, static_cast<float>(i))) < 1e-3f * splits[i]);
+
+    // No meio, crescente, com as pontas exatas e cada diviso entre a uniforme e a logartmica.
+    ComputeCascadeSplits(CameraNear, 200.0f, 4, 0.75f, splits);
+    CHECK(splits[0] == CameraNear && splits[4] == 200.0f);
+    for (UINT i = 0; i < 4; i++)
+        CHECK(splits[i] < splits[i + 1]);
+    for (UINT i = 1; i < 4; i++)
+    {
+        const float logarithmic = CameraNear * powf(200.0f / CameraNear, i / 4.0f);
+        const float uniform = CameraNear + (200.0f - CameraNear) * i / 4.0f;
+        CHECK(splits[i] > logarithmic && splits[i] < uniform);
+    }
+
+    // As cascatas usam as mesmas divises, cortadas em shadowDistance.
+    ShadowCascade cascades[MaxShadowCascades];
+    BuildCascades(MakeView(0.0f, 0.0f, 0.0f), cascades);
+    for (UINT c = 0; c < DefaultShadowSettings.cascadeCount; c++)
+    {
+        CHECK(cascades[c].splitNear == splits[c]);
+        CHECK(cascades[c].splitFar == splits[c + 1]);
+    }
+}
+
+// Os oito cantos de cada fatia do frustum da cmera caem dentro da cascata.
+static void TestCoverage()
+{
+    const float tanY = tanf(0.5f * CameraFov * XM_PI / 180.0f);
+    const float tanX = tanY * CameraAspect;
+
+    for (UINT frame = 0; frame < 16; frame++)
+    {
+        const XMMATRIX view = MakeView(3.7f * frame, -2.1f * frame, 0.4f * frame);
+        const XMMATRIX inverseView = XMMatrixInverse(nullptr, view);
+
+        ShadowCascade cascades[MaxShadowCascades];
+        BuildCascades(view, cascades);
+
+        for (UINT c = 0; c < DefaultShadowSettings.cascadeCount; c++)
+        {
+            for (UINT corner = 0; corner < 8; corner++)
+            {
+                const float depth = (corner & 4) ? cascades[c].splitFar : cascades[c].splitNear;
+                const float x = (corner & 1) ? depth * tanX : -depth * tanX;
+                const float y = (corner & 2) ? depth * tanY : -depth * tanY;
+
+                const XMFLOAT3 p = ToCascade(&cascades[c], XMVector3TransformCoord(XMVectorSet(x, y, depth, 0.0f), inverseView));
+                CHECK(fabsf(p.x) <= 1.0f && fabsf(p.y) <= 1.0f);
+                CHECK(p.z >= 0.0f && p.z <= 1.0f);
+            }
+        }
+    }
+}
+
+// Girar a cmera no lugar no muda o tamanho das cascatas, e andar com ela s move a grade de texels em passos
+// inteiros de snapTexels: as bordas das sombras no tremem.
+static void TestStableBounds()
+{
+    const ShadowSettings* settings = &DefaultShadowSettings;
+    const UINT cascadeCount = settings->cascadeCount;
+
+    ShadowCascade reference[MaxShadowCascades];
+    BuildCascades(MakeView(0.0f, 0.0f, 0.0f), reference);
+    for (UINT frame = 1; frame < 32; frame++)
+    {
+        ShadowCascade cascades[MaxShadowCascades];
+        BuildCascades(MakeView(0.0f, 0.0f, 0.2f * frame), cascades);
+        for (UINT c = 0; c < cascadeCount; c++)
+        {
+            CHECK(cascades[c].radius == reference[c].radius);
+            CHECK(cascades[c].texelSize == reference[c].texelSize);
+        }
+    }
+
+    // Cada cascata tem resolution texels de largura, com um passo de folga de cada lado.
+    for (UINT c = 0; c < cascadeCount; c++)
+    {
+        CHECK(fabsf(2.0f * reference[c].radius - settings->resolution * reference[c].texelSize) < 1e-3f * reference[c].radius);
+        if (c > 0)
+            CHECK(reference[c].texelSize > reference[c - 1].texelSize);
+    }
+
+    UINT changeCount[MaxShadowCascades] = {};
+    ShadowCascade previous[MaxShadowCascades];
+    BuildCascades(MakeView(0.0f, 0.0f, 0.3f), previous);
+
+    const UINT frameCount = 400;
+    for (UINT frame = 1; frame < frameCount; frame++)
+    {
+        ShadowCascade cascades[MaxShadowCascades];
+        BuildCascades(MakeView(0.013f * frame, 0.007f * frame, 0.3f), cascades);
+
+        for (UINT c = 0; c < cascadeCount; c++)
+        {
+            if (memcmp(&cascades[c].viewProjection, &previous[c].viewProjection, sizeof(XMFLOAT4X4)) == 0)
+                continue;
+
+            changeCount[c]++;
+
+            // A origem do mundo anda um nmero inteiro de passos, em x e em y.
+            const XMFLOAT3 before = ToCascade(&previous[c], XMVectorZero());
+            const XMFLOAT3 after = ToCascade(&cascades[c], XMVectorZero());
+            const float halfResolution = 0.5f * settings->resolution;
+            const float stepsX = (after.x - before.x) * halfResolution / settings->snapTexels;
+            const float stepsY = (after.y - before.y) * halfResolution / settings->snapTexels;
+            CHECK(fabsf(stepsX - roundf(stepsX)) < 0.01f);
+            CHECK(fabsf(stepsY - roundf(stepsY)) < 0.01f);
+        }
+
+        memcpy(previous, cascades, sizeof(previous));
+    }
+
+    // A cmera anda menos de um passo por quadro: a maioria dos quadros reaproveita a matriz, e as cascatas
+    // maiores trocam menos.
+    for (UINT c = 0; c < cascadeCount; c++)
+    {
+        CHECK(changeCount[c] > 0 && changeCount[c] < frameCount / 4);
+        if (c > 0)
+            CHECK(changeCount[c] <= changeCount[c - 1]);
+    }
+}
+
+static void PlaceModel(Model* model, UINT meshIndex, FXMVECTOR position, float scale)
+{
+    *model = {};
+    model->meshIndex = meshIndex;
+    XMStoreFloat4x4(&model->world, XMMatrixIdentity());
+    model->world._11 = model->world._22 = model->world._33 = scale;
+    model->world._41 = XMVectorGetX(position);
+    model->world._42 = XMVectorGetY(position);
+    model->world._43 = XMVectorGetZ(position);
+}
+
+static bool Contains(const std::vector<DrawCommand>& drawList, UINT modelIndex, DrawCommand* draw = nullptr)
+{
+    for (const DrawCommand& d : drawList)
+    {
+        if (d.modelIndex == modelIndex)
+        {
+            if (draw)
+                *draw = d;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void TestCulling()
+{
+    ShadowCascade cascades[MaxShadowCascades];
+    BuildCascades(MakeView(10.0f, -5.0f, 0.7f), cascades);
+    const ShadowCascade* cascade = &cascades[0];
+    const float texel = cascade->texelSize;
+
+    // Malha 0: esfera de raio 1 com LODs de erro 0, meio texel da cascata 0 e 100. Malha 1: a mesma, pendente.
+    Mesh meshes[2] = {};
+    for (Mesh& mesh : meshes)
+    {
+        mesh.lods[0] = { 0, 3000, 0.0f };
+        mesh.lods[1] = { 3000, 900, 0.5f * texel };
+        mesh.lods[2] = { 3900, 90, 100.0f };
+        mesh.lodCount = 3;
+        mesh.boundsRadius = 1.0f;
+    }
+    meshes[1].pending = true;
+
+    const XMVECTOR center = FromCascade(cascade, 0.0f, 0.0f, 0.5f);
+    const XMVECTOR edgeX = XMVectorSubtract(FromCascade(cascade, 1.0f, 0.0f, 0.5f), center);
+    const XMVECTOR towardLight = XMVectorScale(XMVector3Normalize(XMLoadFloat3(&LightDirection)), -1.0f);
+
+    enum { Center, Beside, Pancaked, Behind, Tiny, Pending, Edge, ModelCount };
+    std::vector<Model> models(ModelCount);
+    PlaceModel(&models[Center], 0, center, 1.0f);
+    PlaceModel(&models[Beside], 0, XMVectorMultiplyAdd(edgeX, XMVectorReplicate(1.5f), center), 1.0f);
+    PlaceModel(&models[Pancaked], 0, XMVectorMultiplyAdd(towardLight, XMVectorReplicate(1000.0f), center), 1.0f);
+    PlaceModel(&models[Behind], 0, XMVectorMultiplyAdd(towardLight, XMVectorReplicate(-1000.0f), center), 1.0f);
+    PlaceModel(&models[Tiny], 0, center, 0.25f * texel);
+    PlaceModel(&models[Pending], 1, center, 1.0f);
+
+    // Fora da caixa, mas com a esfera ainda tocando a borda.
+    PlaceModel(&models[Edge], 0, XMVectorMultiplyAdd(edgeX, XMVectorReplicate(1.0f + 0.5f / cascade->radius), center), 1.0f);
+
+    // Sem threads, ParallelFor roda as cascatas em srie.
+    JobSystem jobSystem = {};
+    jobSystem.threadCount = 0;
+
+    std::vector<DrawCommand> drawLists[MaxShadowCascades];
+    CullShadowCasters(&jobSystem, &DefaultShadowSettings, cascades, meshes, models.data(), ModelCount, drawLists);
+
+    DrawCommand draw;
+    CHECK(Contains(drawLists[0], Center, &draw));
+    CHECK(draw.indexCount == 900 && draw.startIndex == 3000);
+    CHECK(!Contains(drawLists[0], Beside));
+    CHECK(Contains(drawLists[0], Pancaked));
+    CHECK(!Contains(drawLists[0], Behind));
+    CHECK(!Contains(drawLists[0], Tiny));
+    CHECK(!Contains(drawLists[0], Pending));
+    CHECK(Contains(drawLists[0], Edge));
+
+    // Nas cascatas de texel maior o mesmo modelo vai num LOD igual ou mais grosso, e o pendente nunca entra.
+    for (UINT c = 1; c < DefaultShadowSettings.cascadeCount; c++)
+    {
+        CHECK(!Contains(drawLists[c], Pending));
+        if (Contains(drawLists[c], Center, &draw))
+            CHECK(draw.startIndex >= 3000);
+    }
+
+    // As listas saem por modelIndex crescente, como o cache de sombras espera.
+    for (UINT c = 0; c < DefaultShadowSettings.cascadeCount; c++)
+    {
+        for (size_t i = 1; i < drawLists[c].size(); i++)
+            CHECK(drawLists[c][i - 1].modelIndex < drawLists[c][i].modelIndex);
+    }
+}
+
+int main()
+{
+    TestSplits();
+    TestCoverage();
+    TestStableBounds();
+    TestCulling();
+
+    return TestFailures();
+}
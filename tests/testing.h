@@ -0,0 +1,51 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <stdio.h>
+
+// Verificaes dos testes. Cada falha  impressa com arquivo e linha e o teste continua; main devolve
+// TestFailures() como cdigo de sada, que o ctest l.
+
+static UINT testFailureCount = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("%s(%d): falhou: %s\n", __FILE__, __LINE__, #condition); \
+            testFailureCount++; \
+        } \
+    } while (false)
+
+inline int TestFailures()
+{
+    printf(testFailureCount ? "%u falhas\n" : "ok\n", testFailureCount);
+    return testFailureCount ? 1 : 0;
+}
+
+// Gerador xorshift: as sequncias dos testes e dos benchmarks so as mesmas em toda execuo.
+inline UINT64 NextRandom(UINT64* state)
+{
+    UINT64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Em [0, 1).
+inline float RandomFloat(UINT64* state)
+{
+    return (NextRandom(state) >> 40) * (1.0f / 16777216.0f);
+}
+
+inline double GetElapsedSeconds(const LARGE_INTEGER* start)
+{
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<double>(now.QuadPart - start->QuadPart) / frequency.QuadPart;
+}
@@ -0,0 +1,73 @@
+#include "testing.h"
+#include "tlsf.h"
+
+#include <algorithm>
+#include <vector>
+
+// Fragmentao do TLSF num heap de 1 GB sob troca contnua de recursos: 90% de buffers e texturas pequenas (64 KB
+// a 1 MB) e 10% grandes (1 a 32 MB), com o heap mantido perto de 70% de ocupao. A fragmentao 
+// 1 - maior bloco livre / bytes livres, medida depois do aquecimento.
+
+const UINT64 Granularity = 65536;
+const UINT64 HeapSize = 1ull << 30;
+const UINT64 TargetBytes = 700ull << 20;
+const UINT StepCount = 2000000;
+const UINT WarmupSteps = 100000;
+const UINT SampleInterval = 10000;
+
+int main()
+{
+    TlsfAllocator allocator;
+    InitTlsfAllocator(&allocator, HeapSize, Granularity);
+
+    UINT64 random = 1;
+    std::vector<TlsfAllocation> live;
+    UINT failureCount = 0;
+    UINT sampleCount = 0;
+    double worstFragmentation = 0.0;
+    double fragmentationSum = 0.0;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    for (UINT step = 0; step < StepCount; step++)
+    {
+        const bool allocate = allocator.allocatedBytes < TargetBytes || NextRandom(&random) % 2;
+
+        if (allocate)
+        {
+            const UINT64 size = (NextRandom(&random) % 10 == 0) ? (1 + NextRandom(&random) % 32) << 20 : (1 + NextRandom(&random) % 16) * Granularity;
+
+            TlsfAllocation allocation;
+            if (AllocateTlsf(&allocator, size, Granularity, &allocation))
+                live.push_back(allocation);
+            else
+                failureCount++;
+        }
+        else if (!live.empty())
+        {
+            const size_t i = NextRandom(&random) % live.size();
+            FreeTlsf(&allocator, &live[i]);
+            live[i] = live.back();
+            live.pop_back();
+        }
+
+        if (step >= WarmupSteps && step % SampleInterval == 0)
+        {
+            const UINT64 freeBytes = allocator.size - allocator.allocatedBytes;
+            const double fragmentation = 1.0 - static_cast<double>(GetTlsfLargestFreeBlock(&allocator)) / freeBytes;
+
+            worstFragmentation = (std::max)(worstFragmentation, fragmentation);
+            fragmentationSum += fragmentation;
+            sampleCount++;
+        }
+    }
+
+    const double seconds = GetElapsedSeconds(&start);
+
+    printf("%u operacoes em %.0f ms (%.0f ns por operacao), %u falhas\n", StepCount, seconds * 1000.0, seconds * 1e9 / StepCount, failureCount);
+    printf("fragmentacao media %.2f, pior %.2f; %zu alocacoes vivas, %.0f MB alocados\n", fragmentationSum / sampleCount, worstFragmentation,
+        live.size(), allocator.allocatedBytes / 1048576.0);
+
+    return 0;
+}
@@ -0,0 +1,278 @@
+#include "testing.h"
+#include "tlsf.h"
+
+#include <vector>
+
+const UINT64 Granularity = 65536;
+
+// -----------------------------------------------------------------------------------------------------
+
+// Percorre a faixa pelos vizinhos fsicos e as listas livres, e confere com as alocaes vivas: a faixa  coberta
+// sem buracos, no h dois livres seguidos, os bytes alocados batem, cada bloco livre est em exatamente uma
+// lista e os bitmaps marcam as listas no vazias.
+static void CheckTlsf(const TlsfAllocator* allocator, const std::vector<TlsfAllocation>* live)
+{
+    std::vector<BYTE> unused(allocator->blocks.size(), 0);
+    for (UINT index : allocator->unusedBlocks)
+    {
+        unused[index] = 1;
+    }
+
+    UINT first = TlsfNullBlock;
+    for (UINT i = 0; i < allocator->blocks.size(); i++)
+    {
+        if (!unused[i] && allocator->blocks[i].previousPhysical == TlsfNullBlock)
+        {
+            CHECK(first == TlsfNullBlock);
+            first = i;
+        }
+    }
+
+    UINT64 offset = 0;
+    UINT64 allocatedBytes = 0;
+    UINT freeBlockCount = 0;
+    bool previousFree = false;
+
+    for (UINT index = first; index != TlsfNullBlock; index = allocator->blocks[index].nextPhysical)
+    {
+        const TlsfBlock* block = &allocator->blocks[index];
+
+        CHECK(block->offset == offset);
+        CHECK(block->size > 0 && block->size % Granularity == 0);
+        CHECK(!(block->free && previousFree));
+
+        if (block->free)
+            freeBlockCount++;
+        else
+            allocatedBytes += block->size;
+
+        previousFree = block->free;
+        offset += block->size;
+    }
+
+    CHECK(offset == allocator->size);
+    CHECK(allocatedBytes == allocator->allocatedBytes);
+    CHECK(live->size() == allocator->allocationCount);
+
+    UINT listedBlockCount = 0;
+    for (UINT i = 0; i < TlsfFirstLevelCount; i++)
+    {
+        CHECK(((allocator->firstLevelBitmap >> i) & 1) == (allocator->secondLevelBitmaps[i] != 0));
+
+        for (UINT j = 0; j < TlsfSecondLevelCount; j++)
+        {
+            const UINT head = allocator->freeLists[i][j];
+            CHECK(((allocator->secondLevelBitmaps[i] >> j) & 1) == (head != TlsfNullBlock));
+
+            UINT previous = TlsfNullBlock;
+            for (UINT index = head; index != TlsfNullBlock; index = allocator->blocks[index].nextFree)
+            {
+                CHECK(allocator->blocks[index].free);
+                CHECK(allocator->blocks[index].previousFree == previous);
+                previous = index;
+                listedBlockCount++;
+            }
+        }
+    }
+
+    CHECK(listedBlockCount == freeBlockCount);
+
+    for (const TlsfAllocation& allocation : *live)
+    {
+        CHECK(!allocator->blocks[allocation.block].free);
+        CHECK(allocator->blocks[allocation.block].offset == allocation.offset);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Alocaes e liberaes aleatrias, com tamanhos de 0 a 64 MB e alinhamentos de 64 KB a 4 MB.
+static void TestRandomChurn()
+{
+    TlsfAllocator allocator;
+    InitTlsfAllocator(&allocator, 1ull << 30, Granularity);
+
+    UINT64 random = 1;
+    std::vector<TlsfAllocation> live;
+    UINT successCount = 0;
+    UINT failureCount = 0;
+
+    for (UINT step = 0; step < 100000; step++)
+    {
+        if (live.empty() || NextRandom(&random) % 100 < 55)
+        {
+            const UINT64 size = (NextRandom(&random) % 3 == 0) ? NextRandom(&random) % (64 << 20) : NextRandom(&random) % (1 << 20);
+            const UINT64 alignment = 1ull << (16 + NextRandom(&random) % 7);
+
+            TlsfAllocation allocation;
+            if (AllocateTlsf(&allocator, size, alignment, &allocation))
+            {
+                CHECK(allocation.offset % alignment == 0);
+                CHECK(allocator.blocks[allocation.block].size >= size);
+                CHECK(allocation.offset + allocator.blocks[allocation.block].size <= allocator.size);
+                live.push_back(allocation);
+                successCount++;
+            }
+            else
+            {
+                failureCount++;
+            }
+        }
+        else
+        {
+            const size_t i = NextRandom(&random) % live.size();
+            FreeTlsf(&allocator, &live[i]);
+            live[i] = live.back();
+            live.pop_back();
+        }
+
+        if (step % 1000 == 0)
+            CheckTlsf(&allocator, &live);
+    }
+
+    CHECK(successCount > 0 && failureCount > 0);
+
+    for (const TlsfAllocation& allocation : live)
+    {
+        FreeTlsf(&allocator, &allocation);
+    }
+    live.clear();
+
+    CheckTlsf(&allocator, &live);
+    CHECK(allocator.allocatedBytes == 0);
+    CHECK(GetTlsfLargestFreeBlock(&allocator) == allocator.size);
+}
+
+// Blocos do mesmo tamanho enchem a faixa inteira; o seguinte falha.
+static void TestExhaustion()
+{
+    const UINT blockCount = 100;
+
+    TlsfAllocator allocator;
+    InitTlsfAllocator(&allocator, blockCount * 3 * Granularity + Granularity / 2, Granularity);
+    CHECK(allocator.size == blockCount * 3 * Granularity);
+
+    std::vector<TlsfAllocation> live(blockCount);
+    for (UINT i = 0; i < blockCount; i++)
+    {
+        CHECK(AllocateTlsf(&allocator, 3 * Granularity - 1, 1, &live[i]));
+    }
+
+    TlsfAllocation extra;
+    CHECK(!AllocateTlsf(&allocator, 1, 1, &extra));
+    CHECK(GetTlsfLargestFreeBlock(&allocator) == 0);
+    CheckTlsf(&allocator, &live);
+
+    // Liberar blocos alternados no junta nada: o maior livre continua do tamanho de um bloco.
+    std::vector<TlsfAllocation> kept;
+    for (UINT i = 0; i < blockCount; i++)
+    {
+        if (i % 2)
+            FreeTlsf(&allocator, &live[i]);
+        else
+            kept.push_back(live[i]);
+    }
+
+    CheckTlsf(&allocator, &kept);
+    CHECK(GetTlsfLargestFreeBlock(&allocator) == 3 * Granularity);
+    CHECK(!AllocateTlsf(&allocator, 4 * Granularity, 1, &extra));
+}
+
+// A liberao junta o bloco aos dois vizinhos livres, em qualquer ordem.
+static void TestCoalescing()
+{
+    const UINT orders[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+
+    for (UINT o = 0; o < 6; o++)
+    {
+        TlsfAllocator allocator;
+        InitTlsfAllocator(&allocator, 64 * Granularity, Granularity);
+
+        std::vector<TlsfAllocation> live(4);
+        for (UINT i = 0; i < 4; i++)
+        {
+            CHECK(AllocateTlsf(&allocator, (i + 1) * Granularity, Granularity, &live[i]));
+        }
+
+        // O ltimo fica alocado e separa os trs primeiros do resto da faixa.
+        std::vector<TlsfAllocation> kept(1, live[3]);
+        for (UINT k = 0; k < 3; k++)
+        {
+            FreeTlsf(&allocator, &live[orders[o][k]]);
+        }
+
+        CheckTlsf(&allocator, &kept);
+        CHECK(allocator.blocks.size() - allocator.unusedBlocks.size() == 3);
+
+        TlsfAllocation merged;
+        CHECK(AllocateTlsf(&allocator, 6 * Granularity, Granularity, &merged));
+        CHECK(merged.offset == 0);
+    }
+}
+
+// O comeo desperdiado pelo alinhamento volta para as listas e  usado pelo pedido seguinte.
+static void TestAlignmentPadding()
+{
+    TlsfAllocator allocator;
+    InitTlsfAllocator(&allocator, 256 * Granularity, Granularity);
+
+    std::vector<TlsfAllocation> live(2);
+    CHECK(AllocateTlsf(&allocator, Granularity, Granularity, &live[0]));
+    CHECK(AllocateTlsf(&allocator, Granularity, 16 * Granularity, &live[1]));
+    CHECK(live[0].offset == 0);
+    CHECK(live[1].offset == 16 * Granularity);
+    CheckTlsf(&allocator, &live);
+
+    live.resize(3);
+    CHECK(AllocateTlsf(&allocator, 15 * Granularity, Granularity, &live[2]));
+    CHECK(live[2].offset == Granularity);
+    CheckTlsf(&allocator, &live);
+}
+
+// Tamanhos nas fronteiras das classes (o segundo nvel e as potncias de 2) so atendidos por blocos grandes o
+// bastante.
+static void TestSizeClasses()
+{
+    TlsfAllocator allocator;
+    InitTlsfAllocator(&allocator, 1ull << 36, Granularity);
+
+    std::vector<TlsfAllocation> live;
+    for (UINT log2 = 0; log2 < 16; log2++)
+    {
+        for (INT delta = -1; delta <= 1; delta++)
+        {
+            const UINT64 units = (1ull << log2) + delta;
+            if (units == 0)
+                continue;
+
+            TlsfAllocation allocation;
+            CHECK(AllocateTlsf(&allocator, units * Granularity, Granularity, &allocation));
+            CHECK(allocator.blocks[allocation.block].size == units * Granularity);
+            live.push_back(allocation);
+        }
+    }
+
+    CheckTlsf(&allocator, &live);
+
+    for (const TlsfAllocation& allocation : live)
+    {
+        FreeTlsf(&allocator, &allocation);
+    }
+    live.clear();
+
+    CheckTlsf(&allocator, &live);
+    CHECK(GetTlsfLargestFreeBlock(&allocator) == allocator.size);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    TestRandomChurn();
+    TestExhaustion();
+    TestCoalescing();
+    TestAlignmentPadding();
+    TestSizeClasses();
+
+    return TestFailures();
+}
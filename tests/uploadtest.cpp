@@ -0,0 +1,297 @@
+#include "testing.h"
+#include "upload.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// Fila de cpia simulada. Os destinos so vetores de bytes; a "GPU" s executa um lote quando o fence dele 
+// alcanado (pelo teste ou pela espera do agendador), lendo o anel nesse momento: se o agendador reescrever a
+// staging de um lote em voo, o destino sai errado.
+struct FakeBatch
+{
+    UINT64 fenceValue;
+    std::vector<UploadCopy> copies;
+};
+
+struct FakeQueue
+{
+    const BYTE* staging;
+    UINT64 stagingSize;
+    std::vector<FakeBatch> pending;
+    std::vector<UploadCopy> textureCopies;
+    UINT64 submittedValue;
+    UINT64 completedValue;
+    UINT64 maxCopySize;         // Maior cpia do anel j enviada.
+    UINT waitCount;
+    bool instant;               // Cada lote termina assim que  enviado.
+};
+
+static void ExecuteBatches(FakeQueue* queue, UINT64 fenceValue)
+{
+    size_t executed = 0;
+    for (; executed < queue->pending.size() && queue->pending[executed].fenceValue <= fenceValue; executed++)
+    {
+        for (const UploadCopy& copy : queue->pending[executed].copies)
+        {
+            if (copy.source)
+            {
+                queue->textureCopies.push_back(copy);
+                continue;
+            }
+
+            std::vector<BYTE>* destination = static_cast<std::vector<BYTE>*>(copy.destination);
+            CHECK(copy.destinationOffset + copy.size <= destination->size());
+            memcpy(destination->data() + copy.destinationOffset, queue->staging + copy.stagingOffset, static_cast<size_t>(copy.size));
+        }
+    }
+
+    queue->pending.erase(queue->pending.begin(), queue->pending.begin() + executed);
+    queue->completedValue = (std::max)(queue->completedValue, fenceValue);
+}
+
+static UINT64 FakeSubmit(void* context, const UploadCopy* copies, UINT copyCount)
+{
+    FakeQueue* queue = static_cast<FakeQueue*>(context);
+    CHECK(copyCount > 0);
+
+    for (UINT i = 0; i < copyCount; i++)
+    {
+        if (copies[i].source)
+            continue;
+
+        CHECK(copies[i].stagingOffset + copies[i].size <= queue->stagingSize);
+        queue->maxCopySize = (std::max)(queue->maxCopySize, copies[i].size);
+    }
+
+    queue->pending.push_back({ ++queue->submittedValue, std::vector<UploadCopy>(copies, copies + copyCount) });
+
+    if (queue->instant)
+        ExecuteBatches(queue, queue->submittedValue);
+
+    return queue->submittedValue;
+}
+
+static UINT64 FakeGetCompletedValue(void* context)
+{
+    return static_cast<FakeQueue*>(context)->completedValue;
+}
+
+static void FakeWait(void* context, UINT64 fenceValue)
+{
+    FakeQueue* queue = static_cast<FakeQueue*>(context);
+    CHECK(fenceValue <= queue->submittedValue);
+    queue->waitCount++;
+    ExecuteBatches(queue, fenceValue);
+}
+
+struct UploadFixture
+{
+    FakeQueue fake;
+    std::vector<BYTE> staging;
+    UploadScheduler scheduler;
+};
+
+static void InitFixture(UploadFixture* fixture, UINT64 stagingSize, bool instant)
+{
+    fixture->staging.assign(static_cast<size_t>(stagingSize), 0);
+
+    fixture->fake = {};
+    fixture->fake.staging = fixture->staging.data();
+    fixture->fake.stagingSize = stagingSize;
+    fixture->fake.instant = instant;
+
+    UploadQueue queue = { &fixture->fake, FakeSubmit, FakeGetCompletedValue, FakeWait };
+    InitUploadScheduler(&fixture->scheduler, &queue, fixture->staging.data(), stagingSize);
+}
+
+static std::vector<BYTE> MakeData(size_t size, UINT64 seed)
+{
+    std::vector<BYTE> data(size);
+    UINT64 random = seed;
+    for (BYTE& b : data)
+        b = static_cast<BYTE>(NextRandom(&random) >> 32);
+    return data;
+}
+
+// Pedidos vizinhos no destino e no anel viram uma cpia; os outros no.
+static void TestMerge()
+{
+    UploadFixture fixture;
+    InitFixture(&fixture, 4096, false);
+    UploadScheduler* scheduler = &fixture.scheduler;
+
+    std::vector<BYTE> a(1024, 0), b(1024, 0);
+    const std::vector<BYTE> data = MakeData(1024, 1);
+
+    QueueUpload(scheduler, &a, 0, data.data(), 100);
+    QueueUpload(scheduler, &a, 100, data.data() + 100, 100);
+    QueueUpload(scheduler, &a, 200, data.data() + 200, 56);
+    CHECK(scheduler->copies.size() == 1 && scheduler->copies[0].size == 256);
+
+    // Buraco no destino, outro destino e um pedido que volta no mesmo destino.
+    QueueUpload(scheduler, &a, 300, data.data() + 300, 10);
+    QueueUpload(scheduler, &b, 310, data.data() + 310, 10);
+    QueueUpload(scheduler, &a, 310, data.data() + 310, 10);
+    CHECK(scheduler->copies.size() == 4);
+
+    const UINT64 fenceValue = FlushUploads(scheduler);
+    CHECK(fenceValue == 1);
+    CHECK(scheduler->submittedBatchCount == 1 && scheduler->submittedCopyCount == 4);
+    CHECK(scheduler->uploadedBytes == 286);
+
+    // Nada executou ainda; depois da espera os dois destinos esto certos.
+    CHECK(a[0] == 0);
+    WaitForUploads(scheduler);
+    CHECK(memcmp(a.data(), data.data(), 256) == 0);
+    CHECK(memcmp(a.data() + 300, data.data() + 300, 20) == 0);
+    CHECK(memcmp(b.data() + 310, data.data() + 310, 10) == 0);
+    CHECK(a[256] == 0 && b[0] == 0);
+
+    // Sem pedidos novos, FlushUploads devolve o mesmo fence sem enviar nada.
+    CHECK(FlushUploads(scheduler) == fenceValue && scheduler->submittedBatchCount == 1);
+    CHECK(scheduler->stallCount == 0);
+}
+
+// O anel d a volta: nenhuma cpia atravessa o fim, e com a GPU atrasada os dados em voo no so sobrescritos.
+static void TestRingWrap()
+{
+    UploadFixture fixture;
+    InitFixture(&fixture, 1000, false);
+    UploadScheduler* scheduler = &fixture.scheduler;
+
+    const UINT requestCount = 40;
+    std::vector<BYTE> destination(requestCount * 300, 0);
+    const std::vector<BYTE> data = MakeData(destination.size(), 2);
+
+    UINT wrapCount = 0;
+    UINT64 lastStagingOffset = 0;
+    for (UINT i = 0; i < requestCount; i++)
+    {
+        // Destinos alternados entre o comeo e o fim do buffer, para no juntar os pedidos.
+        const UINT64 offset = (i % 2) ? (requestCount - 1 - i / 2) * 300 : (i / 2) * 300;
+        QueueUpload(scheduler, &destination, offset, data.data() + offset, 300);
+
+        const UploadCopy& copy = scheduler->copies.back();
+        if (copy.stagingOffset < lastStagingOffset)
+            wrapCount++;
+        lastStagingOffset = copy.stagingOffset + copy.size;
+
+        // A GPU s termina um lote a cada quatro pedidos.
+        if (i % 4 == 3 && !fixture.fake.pending.empty())
+            ExecuteBatches(&fixture.fake, fixture.fake.pending.front().fenceValue);
+    }
+
+    WaitForUploads(scheduler);
+    CHECK(wrapCount > 0);
+    CHECK(destination == data);
+    CHECK(scheduler->uploadedBytes == destination.size());
+    CHECK(scheduler->head - scheduler->tail == 0);
+}
+
+// Um pedido maior que o anel  dividido em pedaos de at meio anel, e a CPU espera a cada volta.
+static void TestLargeUpload()
+{
+    UploadFixture fixture;
+    InitFixture(&fixture, 1024, false);
+    UploadScheduler* scheduler = &fixture.scheduler;
+
+    std::vector<BYTE> destination(10000, 0);
+    const std::vector<BYTE> data = MakeData(destination.size(), 3);
+
+    QueueUpload(scheduler, &destination, 0, data.data(), data.size());
+    const UINT64 fenceValue = FlushUploads(scheduler);
+
+    // Pedaos de 512 bytes, cada um o seu lote: 20 lotes, o ltimo com 272 bytes.
+    CHECK(fenceValue == 20 && scheduler->submittedBatchCount == 20 && scheduler->submittedCopyCount == 20);
+    CHECK(fixture.fake.maxCopySize == 512);
+    CHECK(scheduler->stallCount > 0);
+
+    WaitForUploads(scheduler);
+    CHECK(destination == data);
+}
+
+// Uma espera do agendador por falta de espao conta como stall; com a GPU em dia, no h nenhuma.
+static void TestStalls()
+{
+    const std::vector<BYTE> data = MakeData(256, 4);
+
+    for (bool instant : { true, false })
+    {
+        UploadFixture fixture;
+        InitFixture(&fixture, 1024, instant);
+        UploadScheduler* scheduler = &fixture.scheduler;
+
+        std::vector<BYTE> destination(64 * 256, 0);
+        for (UINT i = 0; i < 64; i++)
+        {
+            QueueUpload(scheduler, &destination, (i * 7 % 64) * 256, data.data(), 256);
+        }
+
+        const UINT waitsBeforeFlush = fixture.fake.waitCount;
+        CHECK(scheduler->stallCount == waitsBeforeFlush);
+        if (instant)
+            CHECK(scheduler->stallCount == 0);
+        else
+            CHECK(scheduler->stallCount > 0);
+
+        // Cada lote enche meio anel: dois lotes de 256 bytes por volta.
+        CHECK(scheduler->submittedBatchCount == 32);
+
+        WaitForUploads(scheduler);
+        for (UINT i = 0; i < 64; i++)
+            CHECK(memcmp(destination.data() + i * 256, data.data(), 256) == 0);
+    }
+}
+
+// As cpias de textura entram no lote na ordem dos pedidos, sem ocupar o anel nem juntar com as vizinhas.
+static void TestTextureUploads()
+{
+    UploadFixture fixture;
+    InitFixture(&fixture, 4096, false);
+    UploadScheduler* scheduler = &fixture.scheduler;
+
+    std::vector<BYTE> buffer(256, 0);
+    std::vector<BYTE> texture(1, 0);
+    std::vector<BYTE> textureUpload(65536, 0);
+    const std::vector<BYTE> data = MakeData(256, 5);
+
+    UploadCopy copy = {};
+    copy.destination = &texture;
+    copy.source = &textureUpload;
+    copy.size = 65536;
+    copy.width = 128;
+    copy.height = 128;
+    copy.rowPitch = 512;
+
+    QueueUpload(scheduler, &buffer, 0, data.data(), 128);
+    for (UINT subresource = 0; subresource < 2; subresource++)
+    {
+        copy.subresource = subresource;
+        QueueTextureUpload(scheduler, &copy);
+    }
+    QueueUpload(scheduler, &buffer, 128, data.data() + 128, 128);
+
+    CHECK(scheduler->copies.size() == 4);
+    CHECK(scheduler->copies[1].subresource == 0 && scheduler->copies[2].subresource == 1);
+    CHECK(scheduler->head == 256);
+    CHECK(scheduler->uploadedBytes == 256 + 2 * 65536);
+
+    const UINT64 fenceValue = FlushUploads(scheduler);
+    CHECK(fenceValue == 1);
+
+    WaitForUploads(scheduler);
+    CHECK(buffer == data);
+    CHECK(fixture.fake.textureCopies.size() == 2);
+}
+
+int main()
+{
+    TestMerge();
+    TestRingWrap();
+    TestLargeUpload();
+    TestStalls();
+    TestTextureUploads();
+
+    return TestFailures();
+}
@@ -0,0 +1,307 @@
+#include "testing.h"
+#include "virtualtexture.h"
+
+#include <algorithm>
+#include <vector>
+
+// Textura de 1024x1024 texels: 8x8 pginas no nvel 0, depois 4x4, 2x2 e a pgina fixa do nvel 3.
+const UINT TextureSize = 1024;
+
+// -----------------------------------------------------------------------------------------------------
+
+// Feedback sinttico: count pixels para cada pgina, misturados com pixels sem textura e pginas fora dela, e
+// embaralhados.
+static void MakeFeedback(const UINT* pages, const UINT* counts, UINT pageCount, UINT64* random, std::vector<UINT>* feedback)
+{
+    feedback->clear();
+
+    for (UINT i = 0; i < pageCount; i++)
+    {
+        feedback->insert(feedback->end(), counts[i], pages[i]);
+    }
+
+    feedback->insert(feedback->end(), 50, VirtualPageNone);
+    feedback->push_back(MakeVirtualPage(0, 100, 0));
+    feedback->push_back(MakeVirtualPage(MaxVirtualLevels - 1, 0, 0));
+
+    for (size_t i = feedback->size() - 1; i > 0; i--)
+    {
+        std::swap((*feedback)[i], (*feedback)[NextRandom(random) % (i + 1)]);
+    }
+}
+
+static void Analyze(VirtualTexture* texture, const UINT* pages, UINT pageCount, UINT64* random)
+{
+    std::vector<UINT> counts(pageCount, 10);
+    std::vector<UINT> feedback;
+    MakeFeedback(pages, counts.data(), pageCount, random, &feedback);
+    AnalyzeVirtualFeedback(texture, feedback.data(), static_cast<UINT>(feedback.size()));
+}
+
+static bool IsRequested(const VirtualTexture* texture, UINT page)
+{
+    for (const VirtualPageRequest& request : texture->requests)
+    {
+        if (request.page == page)
+            return true;
+    }
+
+    return false;
+}
+
+static UINT FindSlot(const VirtualTexture* texture, UINT page)
+{
+    for (UINT slot = 0; slot < texture->slots.size(); slot++)
+    {
+        if (texture->slots[slot].page == page)
+            return slot;
+    }
+
+    return UINT_MAX;
+}
+
+// Cada entrada da tabela aponta para o slot do ancestral residente mais fino da pgina (ou dela mesma), e a
+// lista do LRU tem todos os slots ocupados menos o fixo, uma vez cada.
+static void CheckVirtualTable(const VirtualTexture* texture)
+{
+    for (UINT level = 0; level < texture->levelCount; level++)
+    {
+        for (UINT y = 0; y < texture->levelHeights[level]; y++)
+        {
+            for (UINT x = 0; x < texture->levelWidths[level]; x++)
+            {
+                UINT ancestor = MakeVirtualPage(level, x, y);
+                UINT slot = FindSlot(texture, ancestor);
+                while (slot == UINT_MAX)
+                {
+                    ancestor = MakeVirtualPage(GetVirtualPageLevel(ancestor) + 1, GetVirtualPageX(ancestor) >> 1, GetVirtualPageY(ancestor) >> 1);
+                    slot = FindSlot(texture, ancestor);
+                }
+
+                const VirtualPageEntry entry = GetVirtualPageEntry(texture, level, x, y);
+                CHECK(entry.level == GetVirtualPageLevel(ancestor));
+                CHECK(entry.slotY * texture->settings.cacheWidth + entry.slotX == slot);
+            }
+        }
+    }
+
+    UINT listedCount = 0;
+    UINT previous = UINT_MAX;
+    for (UINT slot = texture->lruHead; slot != UINT_MAX; slot = texture->slots[slot].next)
+    {
+        CHECK(slot != 0);
+        CHECK(texture->slots[slot].page != VirtualPageNone);
+        CHECK(texture->slots[slot].previous == previous);
+        previous = slot;
+        listedCount++;
+    }
+
+    CHECK(texture->lruTail == previous);
+    CHECK(listedCount + 1 == texture->residentCount);
+    CHECK(texture->residentCount + texture->freeSlots.size() == texture->slots.size());
+}
+
+// Completa todos os pedidos do ltimo AnalyzeVirtualFeedback.
+static void CompleteRequests(VirtualTexture* texture)
+{
+    const std::vector<VirtualPageRequest> requests = texture->requests;
+    for (const VirtualPageRequest& request : requests)
+    {
+        UINT slot;
+        CHECK(CompleteVirtualPage(texture, request.page, &slot));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Com o cache cheio, cada pgina nova despeja a usada h mais tempo. As pginas so do nvel 2, filhas diretas da
+// fixa, para que cada uma ocupe um slot s.
+static void TestLruEvictionOrder()
+{
+    const VirtualTextureSettings settings = { 4, 1, 16, 0 };
+
+    VirtualTexture texture;
+    CHECK(SUCCEEDED(InitVirtualTexture(&texture, TextureSize, TextureSize, &settings)));
+    CHECK(texture.levelCount == 4);
+
+    UINT64 random = 1;
+    const UINT a = MakeVirtualPage(2, 0, 0);
+    const UINT b = MakeVirtualPage(2, 1, 0);
+    const UINT c = MakeVirtualPage(2, 0, 1);
+    const UINT d = MakeVirtualPage(2, 1, 1);
+
+    const UINT first[3] = { a, b, c };
+    Analyze(&texture, first, 3, &random);
+    CHECK(texture.requests.size() == 3);
+    CompleteRequests(&texture);
+    CHECK(texture.freeSlots.empty());
+    CheckVirtualTable(&texture);
+
+    // Usadas na ordem B, C, A: B fica no fim do LRU e C logo antes.
+    Analyze(&texture, &b, 1, &random);
+    Analyze(&texture, &c, 1, &random);
+    Analyze(&texture, &a, 1, &random);
+    CHECK(texture.requests.empty());
+
+    const UINT slotB = FindSlot(&texture, b);
+    const UINT slotC = FindSlot(&texture, c);
+    CHECK(texture.lruTail == slotB);
+    CHECK(texture.lruHead == FindSlot(&texture, a));
+
+    Analyze(&texture, &d, 1, &random);
+    CHECK(texture.requests.size() == 1 && texture.requests[0].page == d);
+
+    UINT slot;
+    CHECK(CompleteVirtualPage(&texture, d, &slot));
+    CHECK(slot == slotB);
+    CHECK(FindSlot(&texture, b) == UINT_MAX);
+    CHECK(texture.evictedCount == 1);
+    CheckVirtualTable(&texture);
+
+    // A regio de B volta para a pgina fixa, inclusive no nvel 0.
+    const VirtualPageEntry entry = GetVirtualPageEntry(&texture, 0, 5, 1);
+    CHECK(entry.level == 3 && entry.slotX == 0 && entry.slotY == 0);
+
+    // B de novo: despeja C, a prxima do fim.
+    Analyze(&texture, &b, 1, &random);
+    CHECK(CompleteVirtualPage(&texture, b, &slot));
+    CHECK(slot == slotC);
+    CHECK(FindSlot(&texture, c) == UINT_MAX);
+    CheckVirtualTable(&texture);
+}
+
+// Uma pgina usada nos ltimos framesInFlight quadros no  despejada: a concluso falha, a pgina volta a faltar
+// e  pedida de novo, e entra quando o slot mais antigo sai da janela.
+static void TestInFlightEviction()
+{
+    const UINT framesInFlight = 2;
+    const VirtualTextureSettings settings = { 3, 1, 16, framesInFlight };
+
+    VirtualTexture texture;
+    CHECK(SUCCEEDED(InitVirtualTexture(&texture, TextureSize, TextureSize, &settings)));
+
+    UINT64 random = 1;
+    const UINT a = MakeVirtualPage(2, 0, 0);
+    const UINT b = MakeVirtualPage(2, 1, 0);
+    const UINT c = MakeVirtualPage(2, 0, 1);
+
+    const UINT first[2] = { a, b };
+    Analyze(&texture, first, 2, &random);
+    CompleteRequests(&texture);
+    CHECK(texture.freeSlots.empty());
+
+    // A e B usadas neste quadro: C no tem para onde ir.
+    const UINT all[3] = { a, b, c };
+    Analyze(&texture, all, 3, &random);
+    CHECK(texture.requests.size() == 1 && texture.requests[0].page == c);
+
+    UINT slot;
+    CHECK(!CompleteVirtualPage(&texture, c, &slot));
+    CHECK(texture.pendingCount == 0);
+    CHECK(texture.evictedCount == 0);
+    CheckVirtualTable(&texture);
+
+    // S C aparece daqui em diante. Enquanto A e B esto na janela, C  pedida de novo a cada quadro e falha.
+    const UINT lastUse = texture.frame;
+    for (UINT frame = 1; ; frame++)
+    {
+        Analyze(&texture, &c, 1, &random);
+        CHECK(IsRequested(&texture, c));
+
+        const bool completed = CompleteVirtualPage(&texture, c, &slot);
+        CHECK(completed == (lastUse + framesInFlight < texture.frame));
+
+        if (completed)
+        {
+            CHECK(frame == framesInFlight + 1);
+            break;
+        }
+
+        if (frame > 10)
+            break;
+    }
+
+    CHECK(texture.evictedCount == 1);
+    CHECK(FindSlot(&texture, c) != UINT_MAX);
+    CheckVirtualTable(&texture);
+
+    // Uma pgina cancelada tambm volta a faltar. D  filha de C, que est residente.
+    const UINT d = MakeVirtualPage(1, 0, 2);
+    Analyze(&texture, &d, 1, &random);
+    CHECK(IsRequested(&texture, d));
+    CancelVirtualPage(&texture, d);
+    CHECK(texture.pendingCount == 0);
+    Analyze(&texture, &d, 1, &random);
+    CHECK(IsRequested(&texture, d));
+}
+
+// Os pedidos dependem s do contedo do feedback: o mesmo feedback em outra ordem d os mesmos pedidos. A ordem 
+// do nvel mais grosso para o mais fino, depois dos mais pedidos para os menos (somando os pixels das
+// descendentes), depois pelo nmero da pgina; o limite de leituras corta o fim da lista.
+static void TestRequestOrder()
+{
+    const VirtualTextureSettings settings = { 16, 16, 6, 2 };
+
+    VirtualTexture first;
+    VirtualTexture second;
+    CHECK(SUCCEEDED(InitVirtualTexture(&first, TextureSize, TextureSize, &settings)));
+    CHECK(SUCCEEDED(InitVirtualTexture(&second, TextureSize, TextureSize, &settings)));
+
+    const UINT pages[5] = { MakeVirtualPage(0, 0, 0), MakeVirtualPage(0, 7, 7), MakeVirtualPage(0, 1, 1), MakeVirtualPage(1, 3, 0), MakeVirtualPage(0, 6, 1) };
+    const UINT counts[5] = { 40, 10, 20, 30, 25 };
+
+    UINT64 random = 1;
+    std::vector<UINT> feedback;
+    MakeFeedback(pages, counts, 5, &random, &feedback);
+    AnalyzeVirtualFeedback(&first, feedback.data(), static_cast<UINT>(feedback.size()));
+
+    std::reverse(feedback.begin(), feedback.end());
+    AnalyzeVirtualFeedback(&second, feedback.data(), static_cast<UINT>(feedback.size()));
+
+    // Nvel 2: (0, 0) com os pixels de (0, 0) e (1, 1) do nvel 0 = 60; (1, 0) com (1, 3, 0) e (0, 6, 1) = 55;
+    // (1, 1) com (0, 7, 7) = 10. Nvel 1: (0, 0) = 60, (3, 0) = 55, (3, 3) = 10, e s cabem mais 3.
+    const VirtualPageRequest expected[6] =
+    {
+        { MakeVirtualPage(2, 0, 0), 60 },
+        { MakeVirtualPage(2, 1, 0), 55 },
+        { MakeVirtualPage(2, 1, 1), 10 },
+        { MakeVirtualPage(1, 0, 0), 60 },
+        { MakeVirtualPage(1, 3, 0), 55 },
+        { MakeVirtualPage(1, 3, 3), 10 },
+    };
+
+    CHECK(first.requests.size() == 6);
+    CHECK(second.requests.size() == first.requests.size());
+
+    for (UINT i = 0; i < first.requests.size() && i < 6; i++)
+    {
+        CHECK(first.requests[i].page == expected[i].page);
+        CHECK(first.requests[i].count == expected[i].count);
+        CHECK(second.requests[i].page == first.requests[i].page);
+        CHECK(second.requests[i].count == first.requests[i].count);
+    }
+
+    CHECK(first.feedbackPageCount == 5);
+    CHECK(first.missingPageCount == 5);
+    CHECK(first.pendingCount == 6);
+
+    // Com as leituras no limite, o quadro seguinte no pede nada; as pginas em leitura no so pedidas de novo.
+    AnalyzeVirtualFeedback(&first, feedback.data(), static_cast<UINT>(feedback.size()));
+    CHECK(first.requests.empty());
+
+    CancelVirtualPage(&first, expected[5].page);
+    CancelVirtualPage(&first, expected[4].page);
+    AnalyzeVirtualFeedback(&first, feedback.data(), static_cast<UINT>(feedback.size()));
+    CHECK(first.requests.size() == 2 && first.requests[0].page == expected[4].page && first.requests[1].page == expected[5].page);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    TestLruEvictionOrder();
+    TestInFlightEviction();
+    TestRequestOrder();
+
+    return TestFailures();
+}
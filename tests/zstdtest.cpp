@@ -0,0 +1,163 @@
+#include "testing.h"
+#include "zstd.h"
+#include "lz4.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Ida e volta de CompressZstd por DecompressZstd com dados que passam por todos os caminhos do compressor: literais
+// crus, RLE e com Huffman (pesos de 4 bits e comprimidos com FSE), tabelas de sequncias predefinidas e descritas
+// no bloco, blocos crus e matches que voltam para blocos anteriores.
+
+static UINT64 CheckRoundTrip(const std::vector<BYTE>& data)
+{
+    std::vector<BYTE> compressed(static_cast<size_t>(GetZstdCompressBound(data.size())));
+    const UINT64 compressedSize = CompressZstd(compressed.data(), compressed.size(), data.data(), data.size());
+    CHECK(compressedSize > 0);
+    if (compressedSize == 0)
+        return 0;
+
+    std::vector<BYTE> decompressed(data.size() + 1, 0xCD);
+    CHECK(DecompressZstd(decompressed.data(), data.size(), compressed.data(), compressedSize));
+    CHECK(memcmp(decompressed.data(), data.data(), data.size()) == 0);
+    CHECK(decompressed[data.size()] == 0xCD);
+
+    // Sem espao para o ltimo byte, a compresso desiste em vez de escrever alm do fim.
+    CHECK(CompressZstd(compressed.data(), compressedSize - 1, data.data(), data.size()) == 0);
+
+    return compressedSize;
+}
+
+static UINT GetLz4Size(const std::vector<BYTE>& data)
+{
+    std::vector<BYTE> compressed(GetLz4CompressBound(static_cast<UINT>(data.size())));
+    return CompressLz4(compressed.data(), static_cast<UINT>(compressed.size()), data.data(), static_cast<UINT>(data.size()));
+}
+
+// Palavras de um vocabulrio pequeno com frequncias desiguais: poucos smbolos abaixo de 128.
+static std::vector<BYTE> MakeText(size_t size, UINT64 seed)
+{
+    static const char* const words[] = { "textura", "sombra", "luz", "malha", "bloco", "quadro", "de", "a", "o", "com", "um", "para", "cena" };
+
+    std::vector<BYTE> text;
+    UINT64 random = seed;
+    while (text.size() < size)
+    {
+        const float r = RandomFloat(&random);
+        const char* word = words[static_cast<UINT>(r * r * _countof(words))];
+        text.insert(text.end(), word, word + strlen(word));
+        text.push_back((NextRandom(&random) % 11 == 0) ? '\n' : ' ');
+    }
+
+    text.resize(size);
+    return text;
+}
+
+// Vrtices com posio, normal e UV em float: bytes altos frequentes, o que leva os pesos de Huffman para o FSE.
+static std::vector<BYTE> MakeVertices(UINT vertexCount, UINT64 seed)
+{
+    std::vector<float> floats;
+    UINT64 random = seed;
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        const float angle = i * 0.01f;
+        const float values[8] =
+        {
+            10.0f * cosf(angle), 0.25f * (i % 64), 10.0f * sinf(angle),
+            cosf(angle), 0.0f, sinf(angle),
+            (i % 64) / 64.0f, RandomFloat(&random) < 0.5f ? 0.0f : 1.0f
+        };
+
+        floats.insert(floats.end(), values, values + 8);
+    }
+
+    std::vector<BYTE> bytes(floats.size() * sizeof(float));
+    memcpy(bytes.data(), floats.data(), bytes.size());
+    return bytes;
+}
+
+static void TestSmallInputs()
+{
+    CHECK(CheckRoundTrip(std::vector<BYTE>()) > 0);
+
+    UINT64 random = 1;
+    for (UINT size = 1; size < 300; size += 7)
+    {
+        CheckRoundTrip(MakeText(size, NextRandom(&random)));
+    }
+
+    // Um smbolo s nos literais vira RLE.
+    std::vector<BYTE> repeated(100, 'x');
+    repeated[50] = 'y';
+    CheckRoundTrip(repeated);
+}
+
+static void TestRuns()
+{
+    // Trs blocos de zeros: um match por bloco, cada um voltando para o anterior.
+    const std::vector<BYTE> zeros(300 * 1024, 0);
+    const UINT64 size = CheckRoundTrip(zeros);
+    CHECK(size > 0 && size < 100);
+}
+
+static void TestIncompressible()
+{
+    UINT64 random = 2;
+    std::vector<BYTE> noise(200 * 1024);
+    for (BYTE& b : noise)
+        b = static_cast<BYTE>(NextRandom(&random) >> 32);
+
+    // Blocos crus: s os cabealhos a mais.
+    CHECK(CheckRoundTrip(noise) <= GetZstdCompressBound(noise.size()));
+}
+
+static void TestText()
+{
+    // Um fluxo de Huffman at 1.023 literais, quatro acima disso.
+    for (size_t size : { 900, 3000, 20000, 400 * 1024 })
+    {
+        const std::vector<BYTE> text = MakeText(size, size);
+        const UINT64 zstdSize = CheckRoundTrip(text);
+        const UINT lz4Size = GetLz4Size(text);
+
+        printf("texto %zu bytes: zstd %llu, lz4 %u\n", size, static_cast<unsigned long long>(zstdSize), lz4Size);
+        CHECK(zstdSize < lz4Size);
+    }
+}
+
+static void TestVertices()
+{
+    const std::vector<BYTE> vertices = MakeVertices(16384, 3);
+    const UINT64 zstdSize = CheckRoundTrip(vertices);
+    const UINT lz4Size = GetLz4Size(vertices);
+
+    printf("vertices %zu bytes: zstd %llu, lz4 %u\n", vertices.size(), static_cast<unsigned long long>(zstdSize), lz4Size);
+    CHECK(zstdSize < lz4Size);
+}
+
+static void TestDistantMatches()
+{
+    // O mesmo trecho de rudo a 200 KB de distncia: o segundo  um match que volta um bloco e meio.
+    UINT64 random = 4;
+    std::vector<BYTE> data = MakeText(400 * 1024, 5);
+    for (size_t i = 0; i < 4096; i++)
+    {
+        data[1000 + i] = static_cast<BYTE>(NextRandom(&random) >> 32);
+    }
+
+    memcpy(data.data() + 1000 + 200 * 1024, data.data() + 1000, 4096);
+    CheckRoundTrip(data);
+}
+
+int main()
+{
+    TestSmallInputs();
+    TestRuns();
+    TestIncompressible();
+    TestText();
+    TestVertices();
+    TestDistantMatches();
+
+    return TestFailures();
+}
@@ -0,0 +1,908 @@
+#include "texcompress.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------
+
+// Bloco de 4x4 pixels em SoA, canais de 0 a 255.
+struct PixelBlock
+{
+    float channels[4][16];
+};
+
+// Rodadas de mnimos quadrados por CompressionQuality. Uma rodada que no melhora o erro encerra o refinamento.
+static const UINT RefineIterations[] = { 0, 1, 3 };
+
+static const float OpaqueWeights[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+static XMVECTOR LoadPixels(const float* channel, UINT first)
+{
+    return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(channel + first));
+}
+
+static float SumLanes(FXMVECTOR v)
+{
+    return XMVectorGetX(v) + XMVectorGetY(v) + XMVectorGetZ(v) + XMVectorGetW(v);
+}
+
+static float ClampChannel(float value)
+{
+    return (std::min)((std::max)(value, 0.0f), 255.0f);
+}
+
+static void LoadPixelBlock(const BYTE* pixels, UINT width, UINT height, UINT rowPitch, UINT blockX, UINT blockY, PixelBlock* block)
+{
+    for (UINT y = 0; y < 4; y++)
+    {
+        const UINT row = (std::min)(blockY * 4 + y, height - 1);
+        for (UINT x = 0; x < 4; x++)
+        {
+            const UINT column = (std::min)(blockX * 4 + x, width - 1);
+            const BYTE* pixel = pixels + static_cast<size_t>(row) * rowPitch + column * 4;
+
+            for (UINT c = 0; c < 4; c++)
+            {
+                block->channels[c][y * 4 + x] = pixel[c];
+            }
+        }
+    }
+}
+
+// Mdia e eixo principal (iterao de potncia sobre a covarincia) dos pixels com peso 1. O eixo sai
+// normalizado, ou zero quando os pixels so todos iguais.
+static void ComputePrincipalAxis(const PixelBlock* block, UINT channelCount, const float weights[16], float mean[4], float axis[4])
+{
+    float total = 0.0f;
+    float minimum[4], maximum[4];
+    for (UINT c = 0; c < channelCount; c++)
+    {
+        mean[c] = 0.0f;
+        minimum[c] = 255.0f;
+        maximum[c] = 0.0f;
+    }
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        if (weights[i] == 0.0f)
+            continue;
+
+        total += 1.0f;
+        for (UINT c = 0; c < channelCount; c++)
+        {
+            const float value = block->channels[c][i];
+            mean[c] += value;
+            minimum[c] = (std::min)(minimum[c], value);
+            maximum[c] = (std::max)(maximum[c], value);
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (UINT c = 0; c < channelCount; c++)
+    {
+        mean[c] /= total;
+        axis[c] = maximum[c] - minimum[c];
+    }
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        if (weights[i] == 0.0f)
+            continue;
+
+        for (UINT a = 0; a < channelCount; a++)
+        {
+            for (UINT b = 0; b < channelCount; b++)
+            {
+                covariance[a][b] += (block->channels[a][i] - mean[a]) * (block->channels[b][i] - mean[b]);
+            }
+        }
+    }
+
+    for (UINT iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (UINT a = 0; a < channelCount; a++)
+        {
+            for (UINT b = 0; b < channelCount; b++)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+
+        if (length < 1e-12f)
+            break;
+
+        const float scale = 1.0f / sqrtf(length);
+        for (UINT c = 0; c < channelCount; c++)
+        {
+            axis[c] = next[c] * scale;
+        }
+    }
+
+    float length = 0.0f;
+    for (UINT c = 0; c < channelCount; c++)
+    {
+        length += axis[c] * axis[c];
+    }
+
+    const float scale = (length > 1e-12f) ? 1.0f / sqrtf(length) : 0.0f;
+    for (UINT c = 0; c < channelCount; c++)
+    {
+        axis[c] *= scale;
+    }
+}
+
+// Extremos do segmento que cobre as projees dos pixels no eixo principal.
+static void ComputeAxisEndpoints(const PixelBlock* block, UINT channelCount, const float weights[16], float e0[4], float e1[4])
+{
+    float mean[4], axis[4];
+    ComputePrincipalAxis(block, channelCount, weights, mean, axis);
+
+    float minimum = FLT_MAX;
+    float maximum = -FLT_MAX;
+    for (UINT i = 0; i < 16; i++)
+    {
+        if (weights[i] == 0.0f)
+            continue;
+
+        float projection = 0.0f;
+        for (UINT c = 0; c < channelCount; c++)
+        {
+            projection += (block->channels[c][i] - mean[c]) * axis[c];
+        }
+
+        minimum = (std::min)(minimum, projection);
+        maximum = (std::max)(maximum, projection);
+    }
+
+    for (UINT c = 0; c < channelCount; c++)
+    {
+        e0[c] = ClampChannel(mean[c] + axis[c] * minimum);
+        e1[c] = ClampChannel(mean[c] + axis[c] * maximum);
+    }
+}
+
+// Extremos que minimizam o erro quadrtico dada a posio t de cada pixel no segmento (0 em e0, 1 em e1).
+// Devolve false se as posies no determinarem os dois extremos.
+static bool FitEndpoints(const float (*channels)[16], UINT channelCount, const float weights[16], const float t[16], float e0[4], float e1[4])
+{
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (UINT i = 0; i < 16; i++)
+    {
+        if (weights[i] == 0.0f)
+            continue;
+
+        const float s = 1.0f - t[i];
+        aa += s * s;
+        bb += t[i] * t[i];
+        ab += s * t[i];
+
+        for (UINT c = 0; c < channelCount; c++)
+        {
+            ax[c] += s * channels[c][i];
+            bx[c] += t[i] * channels[c][i];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f)
+        return false;
+
+    const float inverse = 1.0f / determinant;
+    for (UINT c = 0; c < channelCount; c++)
+    {
+        e0[c] = ClampChannel((ax[c] * bb - bx[c] * ab) * inverse);
+        e1[c] = ClampChannel((bx[c] * aa - ax[c] * ab) * inverse);
+    }
+
+    return true;
+}
+
+// ndice da entrada da paleta mais prxima de cada pixel, 4 pixels por vez, e o erro quadrtico total. Pixels
+// com peso 0 no contam no erro.
+static float SelectPaletteIndices(const float (*channels)[16], UINT channelCount, const float weights[16],
+    const float (*palette)[4], UINT paletteCount, UINT indices[16])
+{
+    XMVECTOR total = XMVectorZero();
+    for (UINT i = 0; i < 16; i += 4)
+    {
+        XMVECTOR pixel[4];
+        for (UINT c = 0; c < channelCount; c++)
+        {
+            pixel[c] = LoadPixels(channels[c], i);
+        }
+
+        XMVECTOR bestError = XMVectorReplicate(FLT_MAX);
+        XMVECTOR bestIndex = XMVectorZero();
+        for (UINT k = 0; k < paletteCount; k++)
+        {
+            XMVECTOR error = XMVectorZero();
+            for (UINT c = 0; c < channelCount; c++)
+            {
+                const XMVECTOR difference = XMVectorSubtract(pixel[c], XMVectorReplicate(palette[k][c]));
+                error = XMVectorMultiplyAdd(difference, difference, error);
+            }
+
+            const XMVECTOR closer = XMVectorLess(error, bestError);
+            bestError = XMVectorSelect(bestError, error, closer);
+            bestIndex = XMVectorSelect(bestIndex, XMVectorReplicate(static_cast<float>(k)), closer);
+        }
+
+        total = XMVectorMultiplyAdd(bestError, LoadPixels(weights, i), total);
+
+        XMFLOAT4 index;
+        XMStoreFloat4(&index, bestIndex);
+        indices[i + 0] = static_cast<UINT>(index.x);
+        indices[i + 1] = static_cast<UINT>(index.y);
+        indices[i + 2] = static_cast<UINT>(index.z);
+        indices[i + 3] = static_cast<UINT>(index.w);
+    }
+
+    return SumLanes(total);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static UINT QuantizeColor565(const float color[3])
+{
+    const UINT r = static_cast<UINT>(color[0] * (31.0f / 255.0f) + 0.5f);
+    const UINT g = static_cast<UINT>(color[1] * (63.0f / 255.0f) + 0.5f);
+    const UINT b = static_cast<UINT>(color[2] * (31.0f / 255.0f) + 0.5f);
+
+    return (r << 11) | (g << 5) | b;
+}
+
+static void ExpandColor565(UINT packed, float color[4])
+{
+    const UINT r = (packed >> 11) & 31;
+    const UINT g = (packed >> 5) & 63;
+    const UINT b = packed & 31;
+
+    color[0] = static_cast<float>((r << 3) | (r >> 2));
+    color[1] = static_cast<float>((g << 2) | (g >> 4));
+    color[2] = static_cast<float>((b << 3) | (b >> 2));
+    color[3] = 255.0f;
+}
+
+// Paleta do bloco de cor: com threeColor (c0 <= c1 no BC1) a terceira cor  o ponto mdio e a quarta 
+// transparente. As cores interpoladas so arredondadas para 8 bits, como na decodificao.
+static void BuildBC1Palette(UINT c0, UINT c1, bool threeColor, float palette[4][4])
+{
+    ExpandColor565(c0, palette[0]);
+    ExpandColor565(c1, palette[1]);
+
+    for (UINT c = 0; c < 3; c++)
+    {
+        if (threeColor)
+        {
+            palette[2][c] = floorf((palette[0][c] + palette[1][c]) * 0.5f + 0.5f);
+            palette[3][c] = 0.0f;
+        }
+        else
+        {
+            palette[2][c] = floorf((2.0f * palette[0][c] + palette[1][c]) / 3.0f + 0.5f);
+            palette[3][c] = floorf((palette[0][c] + 2.0f * palette[1][c]) / 3.0f + 0.5f);
+        }
+    }
+
+    palette[2][3] = 255.0f;
+    palette[3][3] = threeColor ? 0.0f : 255.0f;
+}
+
+static float SelectBC1Indices(const PixelBlock* block, const float weights[16], UINT c0, UINT c1, bool threeColor, UINT indices[16])
+{
+    float palette[4][4];
+    BuildBC1Palette(c0, c1, threeColor, palette);
+
+    // No modo de trs cores a entrada transparente s serve aos pixels transparentes.
+    const float error = SelectPaletteIndices(block->channels, 3, weights, palette, threeColor ? 3 : 4, indices);
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        if (weights[i] == 0.0f)
+            indices[i] = 3;
+    }
+
+    return error;
+}
+
+// Bloco de cor de 8 bytes. Com transparent, pixels com alfa < 128 usam o ndice transparente do modo de trs
+// cores; sem ele (BC3) o bloco  sempre de quatro cores.
+static UINT64 EncodeBC1Color(const PixelBlock* block, bool transparent, CompressionQuality quality)
+{
+    float weights[16];
+    bool threeColor = false;
+    bool anyOpaque = false;
+    for (UINT i = 0; i < 16; i++)
+    {
+        weights[i] = (transparent && block->channels[3][i] < 128.0f) ? 0.0f : 1.0f;
+        threeColor = threeColor || weights[i] == 0.0f;
+        anyOpaque = anyOpaque || weights[i] != 0.0f;
+    }
+
+    // Tudo transparente: c0 = c1 = 0 e o quarto ndice em todos os pixels.
+    if (!anyOpaque)
+        return 0xFFFFFFFF00000000ull;
+
+    float e0[4], e1[4];
+    ComputeAxisEndpoints(block, 3, weights, e0, e1);
+
+    UINT c0 = QuantizeColor565(e0);
+    UINT c1 = QuantizeColor565(e1);
+    UINT indices[16];
+    float bestError = SelectBC1Indices(block, weights, c0, c1, threeColor, indices);
+
+    for (UINT iteration = 0; iteration < RefineIterations[quality]; iteration++)
+    {
+        const float positions[4] = { 0.0f, 1.0f, threeColor ? 0.5f : 1.0f / 3.0f, 2.0f / 3.0f };
+        float t[16];
+        for (UINT i = 0; i < 16; i++)
+        {
+            t[i] = positions[indices[i]];
+        }
+
+        if (!FitEndpoints(block->channels, 3, weights, t, e0, e1))
+            break;
+
+        const UINT n0 = QuantizeColor565(e0);
+        const UINT n1 = QuantizeColor565(e1);
+        if (n0 == c0 && n1 == c1)
+            break;
+
+        UINT candidate[16];
+        const float error = SelectBC1Indices(block, weights, n0, n1, threeColor, candidate);
+        if (error >= bestError)
+            break;
+
+        c0 = n0;
+        c1 = n1;
+        bestError = error;
+        memcpy(indices, candidate, sizeof(indices));
+    }
+
+    // O decodificador escolhe o modo pela ordem dos extremos: c0 > c1 para quatro cores, c0 <= c1 para trs.
+    // Trocar os extremos troca os ndices 0 e 1 (e 2 e 3 no modo de quatro cores).
+    if (threeColor ? c0 > c1 : c0 < c1)
+    {
+        std::swap(c0, c1);
+        for (UINT i = 0; i < 16; i++)
+        {
+            if (indices[i] < 2 || !threeColor)
+                indices[i] ^= 1;
+        }
+    }
+    else if (!threeColor && c0 == c1)
+    {
+        for (UINT i = 0; i < 16; i++)
+        {
+            indices[i] = 0;
+        }
+    }
+
+    UINT64 bits = c0 | (c1 << 16);
+    for (UINT i = 0; i < 16; i++)
+    {
+        bits |= static_cast<UINT64>(indices[i]) << (32 + i * 2);
+    }
+
+    return bits;
+}
+
+// Paleta BC4: com a0 > a1, seis valores interpolados; seno quatro, mais 0 e 255. Os valores so arredondados
+// como na decodificao para 8 bits.
+static void BuildBC4Palette(UINT a0, UINT a1, float palette[8][4])
+{
+    palette[0][0] = static_cast<float>(a0);
+    palette[1][0] = static_cast<float>(a1);
+
+    if (a0 > a1)
+    {
+        for (UINT k = 2; k < 8; k++)
+        {
+            palette[k][0] = floorf(((8 - k) * palette[0][0] + (k - 1) * palette[1][0]) / 7.0f + 0.5f);
+        }
+    }
+    else
+    {
+        for (UINT k = 2; k < 6; k++)
+        {
+            palette[k][0] = floorf(((6 - k) * palette[0][0] + (k - 1) * palette[1][0]) / 5.0f + 0.5f);
+        }
+        palette[6][0] = 0.0f;
+        palette[7][0] = 255.0f;
+    }
+}
+
+static float SelectBC4Indices(const PixelBlock* block, UINT channel, UINT a0, UINT a1, UINT indices[16])
+{
+    float palette[8][4];
+    BuildBC4Palette(a0, a1, palette);
+
+    return SelectPaletteIndices(&block->channels[channel], 1, OpaqueWeights, palette, 8, indices);
+}
+
+static UINT RoundChannel(float value)
+{
+    return static_cast<UINT>(ClampChannel(value) + 0.5f);
+}
+
+// Bloco de 8 bytes com um canal do bloco.
+static UINT64 EncodeBC4(const PixelBlock* block, UINT channel, CompressionQuality quality)
+{
+    const float* values = block->channels[channel];
+
+    float minimum = 255.0f, maximum = 0.0f;
+    for (UINT i = 0; i < 16; i++)
+    {
+        minimum = (std::min)(minimum, values[i]);
+        maximum = (std::max)(maximum, values[i]);
+    }
+
+    UINT a0 = RoundChannel(maximum);
+    UINT a1 = RoundChannel(minimum);
+    UINT indices[16] = {};
+    float bestError = 0.0f;
+
+    if (a0 != a1)
+    {
+        bestError = SelectBC4Indices(block, channel, a0, a1, indices);
+
+        for (UINT iteration = 0; iteration < RefineIterations[quality]; iteration++)
+        {
+            float t[16];
+            for (UINT i = 0; i < 16; i++)
+            {
+                t[i] = (indices[i] < 2) ? static_cast<float>(indices[i]) : (indices[i] - 1) / 7.0f;
+            }
+
+            float e0[4], e1[4];
+            if (!FitEndpoints(&block->channels[channel], 1, OpaqueWeights, t, e0, e1))
+                break;
+
+            const UINT n0 = RoundChannel(e0[0]);
+            const UINT n1 = RoundChannel(e1[0]);
+            if (n0 <= n1 || (n0 == a0 && n1 == a1))
+                break;
+
+            UINT candidate[16];
+            const float error = SelectBC4Indices(block, channel, n0, n1, candidate);
+            if (error >= bestError)
+                break;
+
+            a0 = n0;
+            a1 = n1;
+            bestError = error;
+            memcpy(indices, candidate, sizeof(indices));
+        }
+
+        // O modo de seis valores guarda 0 e 255 exatos e interpola s entre os valores do meio.
+        if (quality == CompressionHigh)
+        {
+            float low = 255.0f, high = 0.0f;
+            for (UINT i = 0; i < 16; i++)
+            {
+                if (values[i] > 0.0f && values[i] < 255.0f)
+                {
+                    low = (std::min)(low, values[i]);
+                    high = (std::max)(high, values[i]);
+                }
+            }
+
+            const UINT n0 = (low <= high) ? RoundChannel(low) : 0;
+            const UINT n1 = (low <= high) ? RoundChannel(high) : 0;
+
+            UINT candidate[16];
+            const float error = SelectBC4Indices(block, channel, n0, n1, candidate);
+            if (error < bestError)
+            {
+                a0 = n0;
+                a1 = n1;
+                bestError = error;
+                memcpy(indices, candidate, sizeof(indices));
+            }
+        }
+    }
+
+    UINT64 bits = a0 | (a1 << 8);
+    for (UINT i = 0; i < 16; i++)
+    {
+        bits |= static_cast<UINT64>(indices[i]) << (16 + i * 3);
+    }
+
+    return bits;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static const UINT BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Extremo do modo 6: 7 bits por canal e um p-bit, que  o bit baixo dos quatro canais.
+struct BC7Endpoint
+{
+    UINT color[4];
+    UINT pBit;
+};
+
+static float QuantizeBC7Endpoint(const float value[4], UINT pBit, BC7Endpoint* endpoint)
+{
+    float error = 0.0f;
+    for (UINT c = 0; c < 4; c++)
+    {
+        const float quantized = floorf((value[c] - pBit) * 0.5f + 0.5f);
+        endpoint->color[c] = static_cast<UINT>((std::min)((std::max)(quantized, 0.0f), 127.0f));
+
+        const float difference = static_cast<float>(endpoint->color[c] * 2 + pBit) - value[c];
+        error += difference * difference;
+    }
+
+    endpoint->pBit = pBit;
+    return error;
+}
+
+static void QuantizeBC7EndpointNearest(const float value[4], BC7Endpoint* endpoint)
+{
+    BC7Endpoint odd;
+    const float evenError = QuantizeBC7Endpoint(value, 0, endpoint);
+    const float oddError = QuantizeBC7Endpoint(value, 1, &odd);
+
+    if (oddError < evenError)
+        *endpoint = odd;
+}
+
+static void BuildBC7Palette(const BC7Endpoint* e0, const BC7Endpoint* e1, float palette[16][4])
+{
+    for (UINT c = 0; c < 4; c++)
+    {
+        const UINT a = e0->color[c] * 2 + e0->pBit;
+        const UINT b = e1->color[c] * 2 + e1->pBit;
+
+        for (UINT k = 0; k < 16; k++)
+        {
+            palette[k][c] = static_cast<float>(((64 - BC7Weights[k]) * a + BC7Weights[k] * b + 32) >> 6);
+        }
+    }
+}
+
+static float SelectBC7Indices(const PixelBlock* block, const BC7Endpoint* e0, const BC7Endpoint* e1, UINT indices[16])
+{
+    float palette[16][4];
+    BuildBC7Palette(e0, e1, palette);
+
+    return SelectPaletteIndices(block->channels, 4, OpaqueWeights, palette, 16, indices);
+}
+
+// Quantiza os dois extremos. Na qualidade alta as quatro combinaes de p-bits so avaliadas no bloco; nas
+// outras cada extremo fica com o p-bit mais prximo.
+static float QuantizeBC7Endpoints(const PixelBlock* block, const float v0[4], const float v1[4], CompressionQuality quality,
+    BC7Endpoint* e0, BC7Endpoint* e1, UINT indices[16])
+{
+    if (quality != CompressionHigh)
+    {
+        QuantizeBC7EndpointNearest(v0, e0);
+        QuantizeBC7EndpointNearest(v1, e1);
+        return SelectBC7Indices(block, e0, e1, indices);
+    }
+
+    float bestError = FLT_MAX;
+    for (UINT combination = 0; combination < 4; combination++)
+    {
+        BC7Endpoint c0, c1;
+        QuantizeBC7Endpoint(v0, combination & 1, &c0);
+        QuantizeBC7Endpoint(v1, combination >> 1, &c1);
+
+        UINT candidate[16];
+        const float error = SelectBC7Indices(block, &c0, &c1, candidate);
+        if (error < bestError)
+        {
+            *e0 = c0;
+            *e1 = c1;
+            bestError = error;
+            memcpy(indices, candidate, sizeof(candidate));
+        }
+    }
+
+    return bestError;
+}
+
+struct BlockWriter
+{
+    BYTE* bytes;
+    UINT position;
+};
+
+static void WriteBits(BlockWriter* writer, UINT value, UINT count)
+{
+    for (UINT i = 0; i < count; i++, writer->position++)
+    {
+        writer->bytes[writer->position >> 3] |= static_cast<BYTE>(((value >> i) & 1) << (writer->position & 7));
+    }
+}
+
+static UINT ReadBits(const BYTE* bytes, UINT* position, UINT count)
+{
+    UINT value = 0;
+    for (UINT i = 0; i < count; i++, (*position)++)
+    {
+        value |= ((bytes[*position >> 3] >> (*position & 7)) & 1u) << i;
+    }
+
+    return value;
+}
+
+static void EncodeBC7(const PixelBlock* block, CompressionQuality quality, BYTE* output)
+{
+    float v0[4], v1[4];
+    ComputeAxisEndpoints(block, 4, OpaqueWeights, v0, v1);
+
+    BC7Endpoint e0, e1;
+    UINT indices[16];
+    float bestError = QuantizeBC7Endpoints(block, v0, v1, quality, &e0, &e1, indices);
+
+    for (UINT iteration = 0; iteration < RefineIterations[quality]; iteration++)
+    {
+        float t[16];
+        for (UINT i = 0; i < 16; i++)
+        {
+            t[i] = BC7Weights[indices[i]] / 64.0f;
+        }
+
+        if (!FitEndpoints(block->channels, 4, OpaqueWeights, t, v0, v1))
+            break;
+
+        BC7Endpoint n0, n1;
+        UINT candidate[16];
+        const float error = QuantizeBC7Endpoints(block, v0, v1, quality, &n0, &n1, candidate);
+        if (error >= bestError)
+            break;
+
+        e0 = n0;
+        e1 = n1;
+        bestError = error;
+        memcpy(indices, candidate, sizeof(indices));
+    }
+
+    // O ndice do primeiro pixel  gravado com 3 bits: o bit alto precisa ser 0, seno os extremos trocam.
+    if (indices[0] >= 8)
+    {
+        std::swap(e0, e1);
+        for (UINT i = 0; i < 16; i++)
+        {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(output, 0, 16);
+    BlockWriter writer = { output, 0 };
+    WriteBits(&writer, 1 << 6, 7);
+
+    for (UINT c = 0; c < 4; c++)
+    {
+        WriteBits(&writer, e0.color[c], 7);
+        WriteBits(&writer, e1.color[c], 7);
+    }
+
+    WriteBits(&writer, e0.pBit, 1);
+    WriteBits(&writer, e1.pBit, 1);
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        WriteBits(&writer, indices[i], (i == 0) ? 3 : 4);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+struct CompressTextureContext
+{
+    const BYTE* pixels;
+    UINT width;
+    UINT height;
+    UINT rowPitch;
+    BlockFormat format;
+    CompressionQuality quality;
+    BYTE* blocks;
+};
+
+static void CompressBlockRowJob(void* context, UINT jobIndex)
+{
+    const CompressTextureContext* ctx = reinterpret_cast<const CompressTextureContext*>(context);
+    const UINT blockBytes = GetBlockBytes(ctx->format);
+    const UINT blocksWide = (ctx->width + 3) / 4;
+
+    BYTE* output = ctx->blocks + static_cast<size_t>(jobIndex) * blocksWide * blockBytes;
+    for (UINT blockX = 0; blockX < blocksWide; blockX++, output += blockBytes)
+    {
+        PixelBlock block;
+        LoadPixelBlock(ctx->pixels, ctx->width, ctx->height, ctx->rowPitch, blockX, jobIndex, &block);
+
+        UINT64 bits[2];
+        switch (ctx->format)
+        {
+        case BlockFormatBC1:
+            bits[0] = EncodeBC1Color(&block, true, ctx->quality);
+            memcpy(output, bits, 8);
+            break;
+
+        case BlockFormatBC3:
+            bits[0] = EncodeBC4(&block, 3, ctx->quality);
+            bits[1] = EncodeBC1Color(&block, false, ctx->quality);
+            memcpy(output, bits, 16);
+            break;
+
+        case BlockFormatBC5:
+            bits[0] = EncodeBC4(&block, 0, ctx->quality);
+            bits[1] = EncodeBC4(&block, 1, ctx->quality);
+            memcpy(output, bits, 16);
+            break;
+
+        case BlockFormatBC7:
+            EncodeBC7(&block, ctx->quality, output);
+            break;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static void DecodeBC1Color(const BYTE* input, bool forceFourColor, BYTE pixels[16][4])
+{
+    UINT64 bits;
+    memcpy(&bits, input, 8);
+
+    const UINT c0 = bits & 0xFFFF;
+    const UINT c1 = (bits >> 16) & 0xFFFF;
+
+    float palette[4][4];
+    BuildBC1Palette(c0, c1, !forceFourColor && c0 <= c1, palette);
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        const UINT index = (bits >> (32 + i * 2)) & 3;
+        for (UINT c = 0; c < 4; c++)
+        {
+            pixels[i][c] = static_cast<BYTE>(palette[index][c]);
+        }
+    }
+}
+
+static void DecodeBC4(const BYTE* input, UINT channel, BYTE pixels[16][4])
+{
+    UINT64 bits;
+    memcpy(&bits, input, 8);
+
+    float palette[8][4];
+    BuildBC4Palette(bits & 0xFF, (bits >> 8) & 0xFF, palette);
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        pixels[i][channel] = static_cast<BYTE>(palette[(bits >> (16 + i * 3)) & 7][0]);
+    }
+}
+
+static void DecodeBC7(const BYTE* input, BYTE pixels[16][4])
+{
+    memset(pixels, 0, 16 * 4);
+    if ((input[0] & 0x7F) != (1 << 6))
+        return;
+
+    UINT position = 7;
+    BC7Endpoint e0, e1;
+    for (UINT c = 0; c < 4; c++)
+    {
+        e0.color[c] = ReadBits(input, &position, 7);
+        e1.color[c] = ReadBits(input, &position, 7);
+    }
+    e0.pBit = ReadBits(input, &position, 1);
+    e1.pBit = ReadBits(input, &position, 1);
+
+    float palette[16][4];
+    BuildBC7Palette(&e0, &e1, palette);
+
+    for (UINT i = 0; i < 16; i++)
+    {
+        const UINT index = ReadBits(input, &position, (i == 0) ? 3 : 4);
+        for (UINT c = 0; c < 4; c++)
+        {
+            pixels[i][c] = static_cast<BYTE>(palette[index][c]);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+UINT GetBlockBytes(BlockFormat format)
+{
+    return (format == BlockFormatBC1) ? 8 : 16;
+}
+
+void CompressTexture(JobSystem* jobSystem, const BYTE* pixels, UINT width, UINT height, UINT rowPitch, BlockFormat format, CompressionQuality quality, BYTE* blocks)
+{
+    if (width == 0 || height == 0)
+        return;
+
+    CompressTextureContext context = { pixels, width, height, rowPitch, format, quality, blocks };
+    ParallelFor(jobSystem, (height + 3) / 4, CompressBlockRowJob, &context);
+}
+
+void DecompressTexture(const BYTE* blocks, UINT width, UINT height, BlockFormat format, BYTE* pixels, UINT rowPitch)
+{
+    const UINT blockBytes = GetBlockBytes(format);
+    const UINT blocksWide = (width + 3) / 4;
+    const UINT blocksHigh = (height + 3) / 4;
+
+    for (UINT blockY = 0; blockY < blocksHigh; blockY++)
+    {
+        for (UINT blockX = 0; blockX < blocksWide; blockX++)
+        {
+            const BYTE* input = blocks + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes;
+
+            BYTE decoded[16][4];
+            switch (format)
+            {
+            case BlockFormatBC1:
+                DecodeBC1Color(input, false, decoded);
+                break;
+
+            case BlockFormatBC3:
+                DecodeBC1Color(input + 8, true, decoded);
+                DecodeBC4(input, 3, decoded);
+                break;
+
+            case BlockFormatBC5:
+                memset(decoded, 0, sizeof(decoded));
+                DecodeBC4(input, 0, decoded);
+                DecodeBC4(input + 8, 1, decoded);
+                for (UINT i = 0; i < 16; i++)
+                {
+                    decoded[i][3] = 255;
+                }
+                break;
+
+            case BlockFormatBC7:
+                DecodeBC7(input, decoded);
+                break;
+            }
+
+            for (UINT y = 0; y < 4 && blockY * 4 + y < height; y++)
+            {
+                BYTE* row = pixels + static_cast<size_t>(blockY * 4 + y) * rowPitch;
+                for (UINT x = 0; x < 4 && blockX * 4 + x < width; x++)
+                {
+                    memcpy(row + (blockX * 4 + x) * 4, decoded[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+}
+
+double ComputeTexturePsnr(const BYTE* original, const BYTE* decoded, UINT width, UINT height, UINT rowPitch, BlockFormat format)
+{
+    const UINT channelCount = (format == BlockFormatBC5) ? 2 : (format == BlockFormatBC1) ? 3 : 4;
+
+    double squaredError = 0.0;
+    for (UINT y = 0; y < height; y++)
+    {
+        const BYTE* a = original + static_cast<size_t>(y) * rowPitch;
+        const BYTE* b = decoded + static_cast<size_t>(y) * rowPitch;
+        for (UINT x = 0; x < width; x++)
+        {
+            for (UINT c = 0; c < channelCount; c++)
+            {
+                const double difference = static_cast<double>(a[x * 4 + c]) - b[x * 4 + c];
+                squaredError += difference * difference;
+            }
+        }
+    }
+
+    const double meanSquaredError = squaredError / (static_cast<double>(width) * height * channelCount);
+    if (meanSquaredError == 0.0)
+        return HUGE_VAL;
+
+    return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+
+// Compresso de texturas RGBA8 em blocos BC, feita pelo Cooker. Cada bloco de 4x4 pixels  carregado em SoA
+// (um XMVECTOR por canal para cada 4 pixels) e os ndices so escolhidos 4 pixels por vez. Os extremos partem
+// do eixo principal das cores do bloco e so refinados por mnimos quadrados; a qualidade define quantas
+// rodadas de refinamento so feitas.
+//
+//   BC1  cor RGB 5:6:5 e alfa de 1 bit (pixels com alfa < 128 ficam transparentes), 8 bytes.
+//   BC3  cor como no BC1 e alfa em um bloco BC4, 16 bytes.
+//   BC5  dois blocos BC4 com R e G (mapas de normais), 16 bytes.
+//   BC7  s o modo 6: extremos RGBA 7.7.7.7 com p-bit e ndices de 4 bits, 16 bytes.
+
+enum BlockFormat
+{
+    BlockFormatBC1,
+    BlockFormatBC3,
+    BlockFormatBC5,
+    BlockFormatBC7
+};
+
+enum CompressionQuality
+{
+    CompressionFast,
+    CompressionNormal,
+    CompressionHigh
+};
+
+UINT GetBlockBytes(BlockFormat format);
+
+// Comprime uma imagem RGBA8 com rowPitch bytes por linha. Blocos que passam da borda repetem a ltima linha e
+// coluna. Os blocos saem em linhas contguas, (width + 3) / 4 por linha; cada linha de blocos  um job.
+void CompressTexture(JobSystem* jobSystem, const BYTE* pixels, UINT width, UINT height, UINT rowPitch, BlockFormat format, CompressionQuality quality, BYTE* blocks);
+
+// Volta os blocos para RGBA8, para medir a qualidade. No BC7 s o modo 6  decodificado; outros modos saem
+// zerados.
+void DecompressTexture(const BYTE* blocks, UINT width, UINT height, BlockFormat format, BYTE* pixels, UINT rowPitch);
+
+// PSNR em dB sobre os canais que o formato guarda de fato: RGB no BC1 (o alfa tem 1 bit), RG no BC5 e RGBA no
+// BC3 e no BC7. Imagens iguais do infinito.
+double ComputeTexturePsnr(const BYTE* original, const BYTE* decoded, UINT width, UINT height, UINT rowPitch, BlockFormat format);
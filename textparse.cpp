@@ -0,0 +1,163 @@
+#include "textparse.h"
+
+#include <math.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+// SWAR: testa e converte 8 dgitos ASCII de uma vez num registrador de 64 bits (little-endian).
+static inline bool IsEightDigits(UINT64 v)
+{
+    return (((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+static inline UINT ParseEightDigits(UINT64 v)
+{
+    v -= 0x3030303030303030ull;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) + (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return static_cast<UINT>(v);
+}
+
+static inline const char* ParseDigits(const char* p, const char* end, UINT64* mantissa, int* digitCount, int* droppedDigits)
+{
+    // Blocos de 8 dgitos enquanto couberem na mantissa de 19 dgitos.
+    while (end - p >= 8 && *digitCount + 8 <= 19)
+    {
+        UINT64 block;
+        memcpy(&block, p, sizeof(block));
+        if (!IsEightDigits(block))
+            break;
+
+        *mantissa = *mantissa * 100000000 + ParseEightDigits(block);
+        *digitCount += (*mantissa != 0) ? 8 : 0;
+        p += 8;
+    }
+
+    for (; p < end && IsDigit(*p); p++)
+    {
+        if (*digitCount < 19)
+        {
+            *mantissa = *mantissa * 10 + (*p - '0');
+            *digitCount += (*mantissa != 0) ? 1 : 0;
+        }
+        else
+        {
+            (*droppedDigits)++;
+        }
+    }
+
+    return p;
+}
+
+const char* ParseDouble(const char* p, const char* end, double* value)
+{
+    static const double powersOf10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    UINT64 mantissa = 0;
+    int digitCount = 0;
+    int droppedDigits = 0;
+
+    const char* integerStart = p;
+    p = ParseDigits(p, end, &mantissa, &digitCount, &droppedDigits);
+    bool anyDigits = (p != integerStart);
+    int exponent = droppedDigits;
+
+    if (p < end && *p == '.')
+    {
+        p++;
+        const char* fractionStart = p;
+        droppedDigits = 0;
+        p = ParseDigits(p, end, &mantissa, &digitCount, &droppedDigits);
+        exponent -= static_cast<int>(p - fractionStart) - droppedDigits;
+        anyDigits |= (p != fractionStart);
+    }
+
+    if (!anyDigits)
+        return start;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+        {
+            negativeExponent = (*q == '-');
+            q++;
+        }
+
+        if (q < end && IsDigit(*q))
+        {
+            int e = 0;
+            for (; q < end && IsDigit(*q); q++)
+            {
+                e = (e < 10000) ? e * 10 + (*q - '0') : e;
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    // Mantissa e potncia de 10 exatas em double: uma nica operao arredondada.
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0)
+    {
+        if (exponent >= 0 && exponent <= 22)
+            result *= powersOf10[exponent];
+        else if (exponent < 0 && exponent >= -22)
+            result /= powersOf10[-exponent];
+        else
+            result *= pow(10.0, exponent);
+    }
+
+    *value = negative ? -result : result;
+    return p;
+}
+
+const char* ParseFloat(const char* p, const char* end, float* value)
+{
+    double result;
+    const char* next = ParseDouble(p, end, &result);
+    if (next != p)
+        *value = static_cast<float>(result);
+
+    return next;
+}
+
+const char* ParseInt(const char* p, const char* end, INT64* value)
+{
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    const char* digits = p;
+    INT64 result = 0;
+    for (; p < end && IsDigit(*p); p++)
+    {
+        result = (result < (1ll << 40)) ? result * 10 + (*p - '0') : result;
+    }
+
+    if (p == digits)
+        return start;
+
+    *value = negative ? -result : result;
+    return p;
+}
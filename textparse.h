@@ -0,0 +1,15 @@
+#pragma once
+
+#include "infinity.h"
+
+// Leitura de nmeros em texto (OBJ, JSON...). Os buffers no precisam terminar em zero: a leitura para em end.
+// As funes devolvem o ponteiro aps o nmero, ou p quando no h nmero vlido em p.
+
+inline bool IsDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+const char* ParseDouble(const char* p, const char* end, double* value);
+const char* ParseFloat(const char* p, const char* end, float* value);
+const char* ParseInt(const char* p, const char* end, INT64* value);
@@ -0,0 +1,479 @@
+#include "textureformat.h"
+#include "zstd.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT DdsHeaderCaps = 0x1;
+const UINT DdsHeaderHeight = 0x2;
+const UINT DdsHeaderWidth = 0x4;
+const UINT DdsHeaderPitch = 0x8;
+const UINT DdsHeaderPixelFormat = 0x1000;
+const UINT DdsHeaderMipMapCount = 0x20000;
+const UINT DdsHeaderLinearSize = 0x80000;
+
+const UINT DdsPixelFormatFourCC = 0x4;
+const UINT DdsPixelFormatRgb = 0x40;
+
+const UINT DdsFourCCDxt1 = 0x31545844;      // "DXT1"
+const UINT DdsFourCCDxt3 = 0x33545844;      // "DXT3"
+const UINT DdsFourCCDxt5 = 0x35545844;      // "DXT5"
+const UINT DdsFourCCAti1 = 0x31495441;      // "ATI1"
+const UINT DdsFourCCBc4u = 0x55344342;      // "BC4U"
+const UINT DdsFourCCAti2 = 0x32495441;      // "ATI2"
+const UINT DdsFourCCBc5u = 0x55354342;      // "BC5U"
+
+const UINT DdsCapsComplex = 0x8;
+const UINT DdsCapsTexture = 0x1000;
+const UINT DdsCapsMipMap = 0x400000;
+
+const UINT DdsCaps2Cubemap = 0x200;
+const UINT DdsCaps2Volume = 0x200000;
+
+const UINT DdsDimensionTexture2D = 3;
+const UINT DdsMiscTextureCube = 0x4;
+
+// D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, sem depender do d3d12.h (o Cooker tambm usa este arquivo).
+const UINT MaxTextureDimension = 16384;
+
+// Jobs de cpia dos nveis sem compresso tm por volta deste tamanho: grandes o bastante para o memcpy dominar
+// e pequenos o bastante para espalhar as falhas de pgina do arquivo mapeado entre as threads.
+const UINT64 TextureReadJobBytes = 1 << 20;
+
+// -----------------------------------------------------------------------------------------------------
+
+UINT GetFormatBlockBytes(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 8;
+
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 16;
+
+    default:
+        return 0;
+    }
+}
+
+UINT GetFormatPixelBytes(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        return 4;
+
+    default:
+        return 0;
+    }
+}
+
+void GetFormatLevelLayout(DXGI_FORMAT format, UINT width, UINT height, UINT* rowBytes, UINT* rowCount)
+{
+    const UINT blockBytes = GetFormatBlockBytes(format);
+    if (blockBytes > 0)
+    {
+        *rowBytes = (std::max)(1u, (width + 3) / 4) * blockBytes;
+        *rowCount = (std::max)(1u, (height + 3) / 4);
+        return;
+    }
+
+    *rowBytes = width * GetFormatPixelBytes(format);
+    *rowCount = height;
+}
+
+HRESULT SaveDds(const wchar_t* path, DXGI_FORMAT format, UINT width, UINT height, UINT mipCount, const void* data, UINT64 size)
+{
+    const bool blockCompressed = GetFormatBlockBytes(format) > 0;
+    if (!blockCompressed && GetFormatPixelBytes(format) == 0)
+        return E_INVALIDARG;
+
+    UINT rowBytes, rowCount;
+    GetFormatLevelLayout(format, width, height, &rowBytes, &rowCount);
+
+    DdsHeader header = {};
+    header.size = sizeof(DdsHeader);
+    header.flags = DdsHeaderCaps | DdsHeaderHeight | DdsHeaderWidth | DdsHeaderPixelFormat | (blockCompressed ? DdsHeaderLinearSize : DdsHeaderPitch);
+    header.height = height;
+    header.width = width;
+    header.pitchOrLinearSize = blockCompressed ? rowBytes * rowCount : rowBytes;
+    header.mipMapCount = mipCount;
+    header.pixelFormat.size = sizeof(DdsPixelFormat);
+    header.pixelFormat.flags = DdsPixelFormatFourCC;
+    header.pixelFormat.fourCC = DdsFourCCDx10;
+    header.caps = DdsCapsTexture;
+
+    if (mipCount > 1)
+    {
+        header.flags |= DdsHeaderMipMapCount;
+        header.caps |= DdsCapsComplex | DdsCapsMipMap;
+    }
+
+    DdsHeaderDx10 dx10 = {};
+    dx10.dxgiFormat = format;
+    dx10.resourceDimension = DdsDimensionTexture2D;
+    dx10.arraySize = 1;
+
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    UINT64 position = 0;
+    const bool written =
+        WriteFileSection(file, &position, 0, &DdsMagic, sizeof(DdsMagic)) &&
+        WriteFileSection(file, &position, position, &header, sizeof(header)) &&
+        WriteFileSection(file, &position, position, &dx10, sizeof(dx10)) &&
+        WriteFileSection(file, &position, position, data, size);
+
+    const HRESULT hr = written ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    CloseHandle(file);
+
+    return hr;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+static DXGI_FORMAT GetDdsLegacyFormat(const DdsPixelFormat* pixelFormat)
+{
+    if (pixelFormat->flags & DdsPixelFormatFourCC)
+    {
+        switch (pixelFormat->fourCC)
+        {
+        case DdsFourCCDxt1: return DXGI_FORMAT_BC1_UNORM;
+        case DdsFourCCDxt3: return DXGI_FORMAT_BC2_UNORM;
+        case DdsFourCCDxt5: return DXGI_FORMAT_BC3_UNORM;
+        case DdsFourCCAti1: return DXGI_FORMAT_BC4_UNORM;
+        case DdsFourCCBc4u: return DXGI_FORMAT_BC4_UNORM;
+        case DdsFourCCAti2: return DXGI_FORMAT_BC5_UNORM;
+        case DdsFourCCBc5u: return DXGI_FORMAT_BC5_UNORM;
+        default: return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+
+    if ((pixelFormat->flags & DdsPixelFormatRgb) && pixelFormat->rgbBitCount == 32)
+    {
+        if (pixelFormat->rBitMask == 0x000000FF && pixelFormat->gBitMask == 0x0000FF00 && pixelFormat->bBitMask == 0x00FF0000)
+            return DXGI_FORMAT_R8G8B8A8_UNORM;
+
+        if (pixelFormat->rBitMask == 0x00FF0000 && pixelFormat->gBitMask == 0x0000FF00 && pixelFormat->bBitMask == 0x000000FF)
+            return DXGI_FORMAT_B8G8R8A8_UNORM;
+    }
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+static DXGI_FORMAT GetKtx2Format(UINT vkFormat)
+{
+    switch (vkFormat)
+    {
+    case 37: return DXGI_FORMAT_R8G8B8A8_UNORM;             // VK_FORMAT_R8G8B8A8_UNORM
+    case 43: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;        // VK_FORMAT_R8G8B8A8_SRGB
+    case 44: return DXGI_FORMAT_B8G8R8A8_UNORM;             // VK_FORMAT_B8G8R8A8_UNORM
+    case 50: return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;        // VK_FORMAT_B8G8R8A8_SRGB
+    case 131:                                               // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+    case 133: return DXGI_FORMAT_BC1_UNORM;                 // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+    case 132:                                               // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    case 134: return DXGI_FORMAT_BC1_UNORM_SRGB;            // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+    case 135: return DXGI_FORMAT_BC2_UNORM;                 // VK_FORMAT_BC2_UNORM_BLOCK
+    case 136: return DXGI_FORMAT_BC2_UNORM_SRGB;            // VK_FORMAT_BC2_SRGB_BLOCK
+    case 137: return DXGI_FORMAT_BC3_UNORM;                 // VK_FORMAT_BC3_UNORM_BLOCK
+    case 138: return DXGI_FORMAT_BC3_UNORM_SRGB;            // VK_FORMAT_BC3_SRGB_BLOCK
+    case 139: return DXGI_FORMAT_BC4_UNORM;                 // VK_FORMAT_BC4_UNORM_BLOCK
+    case 140: return DXGI_FORMAT_BC4_SNORM;                 // VK_FORMAT_BC4_SNORM_BLOCK
+    case 141: return DXGI_FORMAT_BC5_UNORM;                 // VK_FORMAT_BC5_UNORM_BLOCK
+    case 142: return DXGI_FORMAT_BC5_SNORM;                 // VK_FORMAT_BC5_SNORM_BLOCK
+    case 143: return DXGI_FORMAT_BC6H_UF16;                 // VK_FORMAT_BC6H_UFLOAT_BLOCK
+    case 144: return DXGI_FORMAT_BC6H_SF16;                 // VK_FORMAT_BC6H_SFLOAT_BLOCK
+    case 145: return DXGI_FORMAT_BC7_UNORM;                 // VK_FORMAT_BC7_UNORM_BLOCK
+    case 146: return DXGI_FORMAT_BC7_UNORM_SRGB;            // VK_FORMAT_BC7_SRGB_BLOCK
+    default: return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+// Preenche as dimenses e o layout dos nveis; os offsets ficam com quem l o cabealho.
+static bool SetTextureLevels(TextureFile* texture, DXGI_FORMAT format, UINT width, UINT height, UINT levelCount)
+{
+    if (GetFormatBlockBytes(format) == 0 && GetFormatPixelBytes(format) == 0)
+        return false;
+
+    if (width == 0 || height == 0 || width > MaxTextureDimension || height > MaxTextureDimension)
+        return false;
+
+    // A cadeia no pode passar de 1x1.
+    UINT fullLevelCount = 1;
+    while ((std::max)(width, height) >> fullLevelCount)
+        fullLevelCount++;
+
+    if (levelCount == 0 || levelCount > fullLevelCount || levelCount > MaxTextureLevels)
+        return false;
+
+    texture->format = format;
+    texture->width = width;
+    texture->height = height;
+    texture->levelCount = levelCount;
+
+    for (UINT level = 0; level < levelCount; level++)
+    {
+        TextureLevel* textureLevel = &texture->levels[level];
+        textureLevel->width = (std::max)(1u, width >> level);
+        textureLevel->height = (std::max)(1u, height >> level);
+        GetFormatLevelLayout(format, textureLevel->width, textureLevel->height, &textureLevel->rowBytes, &textureLevel->rowCount);
+        textureLevel->size = static_cast<UINT64>(textureLevel->rowBytes) * textureLevel->rowCount;
+    }
+
+    return true;
+}
+
+static bool ParseDds(TextureFile* texture)
+{
+    const BYTE* data = texture->file.data;
+    const UINT64 size = texture->file.size;
+
+    UINT64 offset = sizeof(DdsMagic) + sizeof(DdsHeader);
+    if (size < offset)
+        return false;
+
+    DdsHeader header;
+    memcpy(&header, data + sizeof(DdsMagic), sizeof(header));
+    if (header.size != sizeof(DdsHeader) || header.pixelFormat.size != sizeof(DdsPixelFormat))
+        return false;
+
+    if (header.caps2 & (DdsCaps2Cubemap | DdsCaps2Volume))
+        return false;
+
+    DXGI_FORMAT format;
+    if ((header.pixelFormat.flags & DdsPixelFormatFourCC) && header.pixelFormat.fourCC == DdsFourCCDx10)
+    {
+        if (size < offset + sizeof(DdsHeaderDx10))
+            return false;
+
+        DdsHeaderDx10 dx10;
+        memcpy(&dx10, data + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+
+        if (dx10.resourceDimension != DdsDimensionTexture2D || dx10.arraySize != 1 || (dx10.miscFlag & DdsMiscTextureCube))
+            return false;
+
+        format = dx10.dxgiFormat;
+    }
+    else
+    {
+        format = GetDdsLegacyFormat(&header.pixelFormat);
+    }
+
+    if (!SetTextureLevels(texture, format, header.width, header.height, (std::max)(1u, header.mipMapCount)))
+        return false;
+
+    // Os nveis vm em sequncia logo depois dos cabealhos.
+    for (UINT level = 0; level < texture->levelCount; level++)
+    {
+        TextureLevel* textureLevel = &texture->levels[level];
+        if (textureLevel->size > size - offset)
+            return false;
+
+        textureLevel->offset = offset;
+        offset += textureLevel->size;
+    }
+
+    texture->compression = TextureCompressionNone;
+    return true;
+}
+
+static bool ParseKtx2(TextureFile* texture)
+{
+    const BYTE* data = texture->file.data;
+    const UINT64 size = texture->file.size;
+
+    Ktx2Header header;
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, data, sizeof(header));
+
+    const bool supported =
+        header.pixelDepth == 0 &&
+        header.layerCount == 0 &&
+        header.faceCount == 1 &&
+        (header.supercompressionScheme == Ktx2SupercompressionNone || header.supercompressionScheme == Ktx2SupercompressionZstd);
+
+    if (!supported)
+        return false;
+
+    // levelCount 0 pede que a cadeia seja gerada em tempo de carga; aqui s existe o nvel 0.
+    if (!SetTextureLevels(texture, GetKtx2Format(header.vkFormat), header.pixelWidth, header.pixelHeight, (std::max)(1u, header.levelCount)))
+        return false;
+
+    if (static_cast<UINT64>(texture->levelCount) * sizeof(Ktx2LevelIndex) > size - sizeof(header))
+        return false;
+
+    texture->compression = header.supercompressionScheme == Ktx2SupercompressionZstd ? TextureCompressionZstd : TextureCompressionNone;
+
+    for (UINT level = 0; level < texture->levelCount; level++)
+    {
+        Ktx2LevelIndex index;
+        memcpy(&index, data + sizeof(header) + level * sizeof(index), sizeof(index));
+
+        TextureLevel* textureLevel = &texture->levels[level];
+        if (index.byteOffset > size || index.byteLength > size - index.byteOffset)
+            return false;
+
+        // Sem supercompresso o campo uncompressedByteLength tambm vale, e precisa bater com o formato.
+        if (index.uncompressedByteLength != textureLevel->size)
+            return false;
+
+        if (texture->compression == TextureCompressionNone && index.byteLength != textureLevel->size)
+            return false;
+
+        textureLevel->offset = index.byteOffset;
+        textureLevel->size = index.byteLength;
+    }
+
+    return true;
+}
+
+HRESULT OpenTextureFile(const wchar_t* path, TextureFile* texture)
+{
+    *texture = {};
+
+    HRESULT hr = OpenMappedFile(path, &texture->file);
+    if (FAILED(hr))
+        return hr;
+
+    const BYTE* data = texture->file.data;
+    const UINT64 size = texture->file.size;
+
+    bool valid = false;
+    if (size >= sizeof(DdsMagic) && memcmp(data, &DdsMagic, sizeof(DdsMagic)) == 0)
+        valid = ParseDds(texture);
+    else if (size >= sizeof(Ktx2Identifier) && memcmp(data, Ktx2Identifier, sizeof(Ktx2Identifier)) == 0)
+        valid = ParseKtx2(texture);
+
+    if (!valid)
+    {
+        CloseTextureFile(texture);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    return S_OK;
+}
+
+void CloseTextureFile(TextureFile* texture)
+{
+    CloseMappedFile(&texture->file);
+    *texture = {};
+}
+
+struct TextureReadJob
+{
+    UINT level;
+    UINT firstRow;
+    UINT rowCount;
+};
+
+struct TextureReadContext
+{
+    const TextureFile* texture;
+    BYTE* destination;
+    const TextureFootprint* footprints;
+    const TextureReadJob* jobs;
+    volatile LONG failed;
+};
+
+static void CopyTextureRows(BYTE* destination, UINT rowPitch, const BYTE* source, UINT rowBytes, UINT rowCount)
+{
+    if (rowPitch == rowBytes)
+    {
+        memcpy(destination, source, static_cast<size_t>(rowBytes) * rowCount);
+        return;
+    }
+
+    for (UINT row = 0; row < rowCount; row++)
+    {
+        memcpy(destination + static_cast<size_t>(row) * rowPitch, source + static_cast<size_t>(row) * rowBytes, rowBytes);
+    }
+}
+
+static void ReadTextureJob(void* data, UINT jobIndex)
+{
+    TextureReadContext* context = static_cast<TextureReadContext*>(data);
+    const TextureReadJob* job = &context->jobs[jobIndex];
+    const TextureLevel* level = &context->texture->levels[job->level];
+    const TextureFootprint* footprint = &context->footprints[job->level];
+
+    const BYTE* source = context->texture->file.data + level->offset;
+    BYTE* destination = context->destination + footprint->offset;
+
+    if (context->texture->compression == TextureCompressionNone)
+    {
+        source += static_cast<UINT64>(job->firstRow) * level->rowBytes;
+        destination += static_cast<UINT64>(job->firstRow) * footprint->rowPitch;
+        CopyTextureRows(destination, footprint->rowPitch, source, level->rowBytes, job->rowCount);
+        return;
+    }
+
+    // Um frame Zstd no pode ser dividido: o nvel inteiro  descomprimido por este job. Com pitch diferente as
+    // linhas passam por um buffer temporrio.
+    const UINT64 size = static_cast<UINT64>(level->rowBytes) * level->rowCount;
+    bool decompressed;
+
+    if (footprint->rowPitch == level->rowBytes)
+    {
+        decompressed = DecompressZstd(destination, size, source, level->size);
+    }
+    else
+    {
+        std::vector<BYTE> rows(size);
+        decompressed = DecompressZstd(rows.data(), size, source, level->size);
+        if (decompressed)
+            CopyTextureRows(destination, footprint->rowPitch, rows.data(), level->rowBytes, level->rowCount);
+    }
+
+    if (!decompressed)
+        InterlockedExchange(&context->failed, 1);
+}
+
+HRESULT ReadTextureLevels(JobSystem* jobSystem, const TextureFile* texture, BYTE* destination, const TextureFootprint* footprints)
+{
+    std::vector<TextureReadJob> jobs;
+
+    for (UINT level = 0; level < texture->levelCount; level++)
+    {
+        const TextureLevel* textureLevel = &texture->levels[level];
+        if (texture->compression == TextureCompressionZstd)
+        {
+            jobs.push_back({ level, 0, textureLevel->rowCount });
+            continue;
+        }
+
+        const UINT rowsPerJob = static_cast<UINT>((std::max)(static_cast<UINT64>(1), TextureReadJobBytes / textureLevel->rowBytes));
+        for (UINT row = 0; row < textureLevel->rowCount; row += rowsPerJob)
+        {
+            jobs.push_back({ level, row, (std::min)(rowsPerJob, textureLevel->rowCount - row) });
+        }
+    }
+
+    // Os jobs so distribudos em ordem: o nvel 0, o mais longo no Zstd, comea primeiro.
+    TextureReadContext context = { texture, destination, footprints, jobs.data(), 0 };
+    ParallelFor(jobSystem, static_cast<UINT>(jobs.size()), ReadTextureJob, &context);
+
+    return context.failed ? HRESULT_FROM_WIN32(ERROR_INVALID_DATA) : S_OK;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "infinity.h"
+#include "jobs.h"
+#include "mappedfile.h"
+
+#include <dxgiformat.h>
+
+// Texturas cozidas em DDS, sempre com o cabealho DX10 (o formato vem como DXGI_FORMAT). Depois dos cabealhos
+// vm os nveis de mip em sequncia, do maior para o menor, cada um com as linhas (de pixels ou de blocos 4x4)
+// contguas.
+//
+//   "DDS " | DdsHeader | DdsHeaderDx10 | nvel 0 | nvel 1 | ...
+
+const UINT DdsMagic = 0x20534444;           // "DDS "
+const UINT DdsFourCCDx10 = 0x30315844;      // "DX10"
+
+struct DdsPixelFormat
+{
+    UINT size;
+    UINT flags;
+    UINT fourCC;
+    UINT rgbBitCount;
+    UINT rBitMask;
+    UINT gBitMask;
+    UINT bBitMask;
+    UINT aBitMask;
+};
+
+struct DdsHeader
+{
+    UINT size;
+    UINT flags;
+    UINT height;
+    UINT width;
+    UINT pitchOrLinearSize;
+    UINT depth;
+    UINT mipMapCount;
+    UINT reserved1[11];
+    DdsPixelFormat pixelFormat;
+    UINT caps;
+    UINT caps2;
+    UINT caps3;
+    UINT caps4;
+    UINT reserved2;
+};
+
+struct DdsHeaderDx10
+{
+    DXGI_FORMAT dxgiFormat;
+    UINT resourceDimension;
+    UINT miscFlag;
+    UINT arraySize;
+    UINT miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124, "DdsHeader deve ter o layout do arquivo");
+static_assert(sizeof(DdsHeaderDx10) == 20, "DdsHeaderDx10 deve ter o layout do arquivo");
+
+// Texturas KTX2 de ferramentas externas. Depois do cabealho vem um Ktx2LevelIndex por nvel, do maior para o
+// menor; os dados de cada nvel podem estar em qualquer lugar do arquivo e, com supercompresso Zstd, cada nvel
+//  um frame independente.
+//
+//   identificador | Ktx2Header | Ktx2LevelIndex[levelCount] | DFD | KVD | SGD | nveis
+
+const BYTE Ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+const UINT Ktx2SupercompressionNone = 0;
+const UINT Ktx2SupercompressionZstd = 2;
+
+struct Ktx2Header
+{
+    BYTE identifier[12];
+    UINT vkFormat;
+    UINT typeSize;
+    UINT pixelWidth;
+    UINT pixelHeight;
+    UINT pixelDepth;
+    UINT layerCount;
+    UINT faceCount;
+    UINT levelCount;
+    UINT supercompressionScheme;
+    UINT dfdByteOffset;
+    UINT dfdByteLength;
+    UINT kvdByteOffset;
+    UINT kvdByteLength;
+    UINT64 sgdByteOffset;
+    UINT64 sgdByteLength;
+};
+
+struct Ktx2LevelIndex
+{
+    UINT64 byteOffset;
+    UINT64 byteLength;
+    UINT64 uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "Ktx2Header deve ter o layout do arquivo");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "Ktx2LevelIndex deve ter o layout do arquivo");
+
+// Bytes por bloco 4x4 nos formatos BC, 0 nos outros.
+UINT GetFormatBlockBytes(DXGI_FORMAT format);
+
+// Bytes por pixel nos formatos sem compresso aceitos (RGBA8 e variantes), 0 nos outros.
+UINT GetFormatPixelBytes(DXGI_FORMAT format);
+
+// Bytes de uma linha (de pixels, ou de blocos nos formatos BC) e nmero de linhas de um nvel.
+void GetFormatLevelLayout(DXGI_FORMAT format, UINT width, UINT height, UINT* rowBytes, UINT* rowCount);
+
+// data traz os mipCount nveis em sequncia, no layout de GetFormatLevelLayout.
+HRESULT SaveDds(const wchar_t* path, DXGI_FORMAT format, UINT width, UINT height, UINT mipCount, const void* data, UINT64 size);
+
+// -----------------------------------------------------------------------------------------------------
+
+// Leitura de texturas 2D (DDS ou KTX2) sem cpias intermedirias: o arquivo fica mapeado e cada nvel  copiado
+// (ou descomprimido) direto para o destino final, em geral um upload buffer j no layout de
+// GetCopyableFootprints.
+
+const UINT MaxTextureLevels = 16;
+
+enum TextureCompression
+{
+    TextureCompressionNone,
+    TextureCompressionZstd
+};
+
+struct TextureLevel
+{
+    UINT64 offset;      // Incio dos dados no arquivo.
+    UINT64 size;        // Bytes no arquivo; com Zstd, o tamanho do frame.
+    UINT width;
+    UINT height;
+    UINT rowBytes;      // Linhas contguas depois de descomprimidas, como em GetFormatLevelLayout.
+    UINT rowCount;
+};
+
+struct TextureFile
+{
+    MappedFile file;
+    DXGI_FORMAT format;
+    UINT width;
+    UINT height;
+    UINT levelCount;
+    TextureCompression compression;
+    TextureLevel levels[MaxTextureLevels];
+};
+
+// Onde cada nvel vai no destino: o offset e o RowPitch de D3D12_PLACED_SUBRESOURCE_FOOTPRINT.
+struct TextureFootprint
+{
+    UINT64 offset;
+    UINT rowPitch;
+};
+
+// Mapeia o arquivo e valida os cabealhos e os nveis contra o tamanho do arquivo. DDS: cabealho DX10 ou os
+// FourCC antigos de BC1 a BC5 e RGBA8; KTX2: formatos BC e RGBA8, sem supercompresso ou com Zstd. Cubemaps,
+// arrays e texturas 3D so recusados.
+HRESULT OpenTextureFile(const wchar_t* path, TextureFile* texture);
+void CloseTextureFile(TextureFile* texture);
+
+// Copia os nveis para destination + footprints[level].offset. Os nveis sem compresso so divididos em jobs
+// de linhas, com um memcpy por job quando o pitch coincide e um por linha quando no; cada nvel Zstd  um job
+// e  descomprimido direto no destino quando o pitch coincide.
+HRESULT ReadTextureLevels(JobSystem* jobSystem, const TextureFile* texture, BYTE* destination, const TextureFootprint* footprints);
@@ -0,0 +1,135 @@
+#include "tgaimport.h"
+#include "mappedfile.h"
+
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------
+
+struct TgaHeader
+{
+    BYTE idLength;
+    BYTE colorMapType;
+    BYTE imageType;
+    BYTE colorMapSpec[5];
+    WORD xOrigin;
+    WORD yOrigin;
+    WORD width;
+    WORD height;
+    BYTE bitsPerPixel;
+    BYTE descriptor;
+};
+
+static_assert(sizeof(TgaHeader) == 18, "TgaHeader deve ter o layout do arquivo");
+
+const BYTE TgaTrueColor = 2;
+const BYTE TgaGrayscale = 3;
+const BYTE TgaRle = 8;
+
+// Bits 4 e 5 do descritor: colunas da direita para a esquerda e linhas de cima para baixo.
+const BYTE TgaRightToLeft = 0x10;
+const BYTE TgaTopToBottom = 0x20;
+
+// Pixel do arquivo (BGR, BGRA ou cinza) para RGBA.
+static void ConvertTgaPixel(const BYTE* source, UINT bytesPerPixel, BYTE* destination)
+{
+    if (bytesPerPixel == 1)
+    {
+        destination[0] = destination[1] = destination[2] = source[0];
+        destination[3] = 255;
+        return;
+    }
+
+    destination[0] = source[2];
+    destination[1] = source[1];
+    destination[2] = source[0];
+    destination[3] = (bytesPerPixel == 4) ? source[3] : 255;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+HRESULT ImportTga(const wchar_t* path, std::vector<BYTE>* pixels, UINT* width, UINT* height)
+{
+    MappedFile file;
+    HRESULT hr = OpenMappedFile(path, &file);
+    if (FAILED(hr))
+        return hr;
+
+    hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    TgaHeader header = {};
+    if (file.size >= sizeof(header))
+        memcpy(&header, file.data, sizeof(header));
+
+    const BYTE baseType = header.imageType & ~TgaRle;
+    const UINT bytesPerPixel = header.bitsPerPixel / 8;
+    const bool valid =
+        file.size >= sizeof(header) &&
+        header.colorMapType == 0 &&
+        (baseType == TgaTrueColor || baseType == TgaGrayscale) &&
+        (baseType == TgaGrayscale ? header.bitsPerPixel == 8 : (header.bitsPerPixel == 24 || header.bitsPerPixel == 32)) &&
+        header.width > 0 && header.height > 0;
+
+    if (!valid)
+    {
+        CloseMappedFile(&file);
+        return hr;
+    }
+
+    const UINT pixelCount = static_cast<UINT>(header.width) * header.height;
+    const BYTE* p = file.data + sizeof(header) + header.idLength;
+    const BYTE* end = file.data + file.size;
+
+    // Pixels na ordem do arquivo; a orientao  corrigida depois.
+    std::vector<BYTE> decoded(static_cast<size_t>(pixelCount) * 4);
+    UINT pixel = 0;
+    if (header.imageType & TgaRle)
+    {
+        // Pacotes: o bit alto do cabealho indica repetio de um pixel, os 7 de baixo a contagem menos 1.
+        while (pixel < pixelCount && p < end)
+        {
+            const UINT count = (*p & 0x7F) + 1;
+            const bool run = (*p & 0x80) != 0;
+            p++;
+
+            const UINT literalBytes = run ? bytesPerPixel : count * bytesPerPixel;
+            if (static_cast<UINT64>(end - p) < literalBytes || pixel + count > pixelCount)
+                break;
+
+            for (UINT i = 0; i < count; i++, pixel++)
+            {
+                ConvertTgaPixel(run ? p : p + i * bytesPerPixel, bytesPerPixel, &decoded[pixel * 4]);
+            }
+            p += literalBytes;
+        }
+    }
+    else if (static_cast<UINT64>(end - p) >= static_cast<UINT64>(pixelCount) * bytesPerPixel)
+    {
+        for (; pixel < pixelCount; pixel++, p += bytesPerPixel)
+        {
+            ConvertTgaPixel(p, bytesPerPixel, &decoded[pixel * 4]);
+        }
+    }
+
+    CloseMappedFile(&file);
+
+    if (pixel < pixelCount)
+        return hr;
+
+    *width = header.width;
+    *height = header.height;
+    pixels->resize(decoded.size());
+
+    const bool topToBottom = (header.descriptor & TgaTopToBottom) != 0;
+    const bool rightToLeft = (header.descriptor & TgaRightToLeft) != 0;
+    for (UINT y = 0; y < *height; y++)
+    {
+        const UINT sourceRow = topToBottom ? y : *height - 1 - y;
+        for (UINT x = 0; x < *width; x++)
+        {
+            const UINT sourceColumn = rightToLeft ? *width - 1 - x : x;
+            memcpy(&(*pixels)[(static_cast<size_t>(y) * *width + x) * 4], &decoded[(static_cast<size_t>(sourceRow) * *width + sourceColumn) * 4], 4);
+        }
+    }
+
+    return S_OK;
+}
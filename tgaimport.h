@@ -0,0 +1,9 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+// Importa um TGA de cor verdadeira ou tons de cinza (tipos 2, 3, 10 e 11, com ou sem RLE) de 8, 24 ou 32 bits.
+// Os pixels saem em RGBA8 com a primeira linha no topo; sem canal alfa, o alfa  255.
+HRESULT ImportTga(const wchar_t* path, std::vector<BYTE>* pixels, UINT* width, UINT* height);
@@ -0,0 +1,260 @@
+#include "tlsf.h"
+
+// -----------------------------------------------------------------------------------------------------
+
+// Tamanhos abaixo de TlsfSecondLevelCount unidades ficam no primeiro nvel 0, uma lista por tamanho.
+static void MapTlsfSize(UINT64 units, UINT* firstLevel, UINT* secondLevel)
+{
+    if (units < TlsfSecondLevelCount)
+    {
+        *firstLevel = 0;
+        *secondLevel = static_cast<UINT>(units);
+        return;
+    }
+
+    const UINT log2 = FindLastSet(units);
+    *firstLevel = log2 - TlsfSecondLevelLog2 + 1;
+    *secondLevel = static_cast<UINT>(units >> (log2 - TlsfSecondLevelLog2)) - TlsfSecondLevelCount;
+}
+
+static UINT NewTlsfBlock(TlsfAllocator* allocator)
+{
+    if (!allocator->unusedBlocks.empty())
+    {
+        const UINT index = allocator->unusedBlocks.back();
+        allocator->unusedBlocks.pop_back();
+        return index;
+    }
+
+    allocator->blocks.push_back({});
+    return static_cast<UINT>(allocator->blocks.size() - 1);
+}
+
+static void InsertFreeBlock(TlsfAllocator* allocator, UINT index)
+{
+    TlsfBlock* block = &allocator->blocks[index];
+
+    UINT firstLevel, secondLevel;
+    MapTlsfSize(block->size / allocator->granularity, &firstLevel, &secondLevel);
+
+    block->free = true;
+    block->previousFree = TlsfNullBlock;
+    block->nextFree = allocator->freeLists[firstLevel][secondLevel];
+
+    if (block->nextFree != TlsfNullBlock)
+        allocator->blocks[block->nextFree].previousFree = index;
+
+    allocator->freeLists[firstLevel][secondLevel] = index;
+    allocator->firstLevelBitmap |= 1ull << firstLevel;
+    allocator->secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+static void RemoveFreeBlock(TlsfAllocator* allocator, UINT index)
+{
+    TlsfBlock* block = &allocator->blocks[index];
+
+    UINT firstLevel, secondLevel;
+    MapTlsfSize(block->size / allocator->granularity, &firstLevel, &secondLevel);
+
+    if (block->previousFree != TlsfNullBlock)
+        allocator->blocks[block->previousFree].nextFree = block->nextFree;
+    else
+        allocator->freeLists[firstLevel][secondLevel] = block->nextFree;
+
+    if (block->nextFree != TlsfNullBlock)
+        allocator->blocks[block->nextFree].previousFree = block->previousFree;
+
+    if (allocator->freeLists[firstLevel][secondLevel] == TlsfNullBlock)
+    {
+        allocator->secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (allocator->secondLevelBitmaps[firstLevel] == 0)
+            allocator->firstLevelBitmap &= ~(1ull << firstLevel);
+    }
+
+    block->free = false;
+}
+
+// Deixa size bytes no bloco (fora das listas) e devolve o resto s listas como um bloco novo logo depois.
+static void SplitTlsfBlock(TlsfAllocator* allocator, UINT index, UINT64 size)
+{
+    if (allocator->blocks[index].size == size)
+        return;
+
+    const UINT remainderIndex = NewTlsfBlock(allocator);
+    TlsfBlock* block = &allocator->blocks[index];
+    TlsfBlock* remainder = &allocator->blocks[remainderIndex];
+
+    remainder->offset = block->offset + size;
+    remainder->size = block->size - size;
+    remainder->previousPhysical = index;
+    remainder->nextPhysical = block->nextPhysical;
+
+    if (block->nextPhysical != TlsfNullBlock)
+        allocator->blocks[block->nextPhysical].previousPhysical = remainderIndex;
+
+    block->nextPhysical = remainderIndex;
+    block->size = size;
+
+    InsertFreeBlock(allocator, remainderIndex);
+}
+
+// Junta second, que vem logo depois de first na faixa, a first.
+static void MergeTlsfBlocks(TlsfAllocator* allocator, UINT first, UINT second)
+{
+    TlsfBlock* block = &allocator->blocks[first];
+    const TlsfBlock* next = &allocator->blocks[second];
+
+    block->size += next->size;
+    block->nextPhysical = next->nextPhysical;
+
+    if (block->nextPhysical != TlsfNullBlock)
+        allocator->blocks[block->nextPhysical].previousPhysical = first;
+
+    allocator->unusedBlocks.push_back(second);
+}
+
+// Primeiro bloco de uma lista em que qualquer bloco tem pelo menos units unidades: o pedido  arredondado para
+// cima at o incio da prxima classe, para no precisar percorrer a lista.
+static UINT FindFreeBlock(const TlsfAllocator* allocator, UINT64 units)
+{
+    if (units >= TlsfSecondLevelCount)
+        units += (1ull << (FindLastSet(units) - TlsfSecondLevelLog2)) - 1;
+
+    UINT firstLevel, secondLevel;
+    MapTlsfSize(units, &firstLevel, &secondLevel);
+
+    UINT secondLevelMap = allocator->secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0)
+    {
+        const UINT64 firstLevelMap = (firstLevel + 1 < TlsfFirstLevelCount) ? allocator->firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0)
+            return TlsfNullBlock;
+
+        firstLevel = FindFirstSet(firstLevelMap);
+        secondLevelMap = allocator->secondLevelBitmaps[firstLevel];
+    }
+
+    return allocator->freeLists[firstLevel][FindFirstSet(secondLevelMap)];
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitTlsfAllocator(TlsfAllocator* allocator, UINT64 size, UINT64 granularity)
+{
+    allocator->size = size - size % granularity;
+    allocator->granularity = granularity;
+
+    allocator->blocks.clear();
+    allocator->unusedBlocks.clear();
+
+    allocator->firstLevelBitmap = 0;
+    for (UINT i = 0; i < TlsfFirstLevelCount; i++)
+    {
+        allocator->secondLevelBitmaps[i] = 0;
+        for (UINT j = 0; j < TlsfSecondLevelCount; j++)
+        {
+            allocator->freeLists[i][j] = TlsfNullBlock;
+        }
+    }
+
+    allocator->allocatedBytes = 0;
+    allocator->allocationCount = 0;
+
+    if (allocator->size > 0)
+    {
+        const UINT index = NewTlsfBlock(allocator);
+        TlsfBlock* block = &allocator->blocks[index];
+        block->offset = 0;
+        block->size = allocator->size;
+        block->previousPhysical = TlsfNullBlock;
+        block->nextPhysical = TlsfNullBlock;
+
+        InsertFreeBlock(allocator, index);
+    }
+}
+
+bool AllocateTlsf(TlsfAllocator* allocator, UINT64 size, UINT64 alignment, TlsfAllocation* allocation)
+{
+    const UINT64 granularity = allocator->granularity;
+
+    size = (size > 0) ? (size + granularity - 1) / granularity * granularity : granularity;
+    if (alignment < granularity)
+        alignment = granularity;
+
+    if (size > allocator->size)
+        return false;
+
+    // Com alinhamento maior que a granularidade, o pior caso desperdia alignment - granularity no comeo.
+    const UINT64 searchSize = size + alignment - granularity;
+    UINT index = FindFreeBlock(allocator, searchSize / granularity);
+    if (index == TlsfNullBlock)
+        return false;
+
+    RemoveFreeBlock(allocator, index);
+
+    const UINT64 offset = allocator->blocks[index].offset;
+    const UINT64 alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+    if (alignedOffset > offset)
+    {
+        // O comeo volta para as listas como um bloco prprio.
+        SplitTlsfBlock(allocator, index, alignedOffset - offset);
+
+        const UINT alignedIndex = allocator->blocks[index].nextPhysical;
+        RemoveFreeBlock(allocator, alignedIndex);
+        InsertFreeBlock(allocator, index);
+        index = alignedIndex;
+    }
+
+    SplitTlsfBlock(allocator, index, size);
+
+    allocator->allocatedBytes += size;
+    allocator->allocationCount++;
+
+    allocation->offset = alignedOffset;
+    allocation->block = index;
+
+    return true;
+}
+
+void FreeTlsf(TlsfAllocator* allocator, const TlsfAllocation* allocation)
+{
+    UINT index = allocation->block;
+
+    allocator->allocatedBytes -= allocator->blocks[index].size;
+    allocator->allocationCount--;
+
+    const UINT previous = allocator->blocks[index].previousPhysical;
+    if (previous != TlsfNullBlock && allocator->blocks[previous].free)
+    {
+        RemoveFreeBlock(allocator, previous);
+        MergeTlsfBlocks(allocator, previous, index);
+        index = previous;
+    }
+
+    const UINT next = allocator->blocks[index].nextPhysical;
+    if (next != TlsfNullBlock && allocator->blocks[next].free)
+    {
+        RemoveFreeBlock(allocator, next);
+        MergeTlsfBlocks(allocator, index, next);
+    }
+
+    InsertFreeBlock(allocator, index);
+}
+
+UINT64 GetTlsfLargestFreeBlock(const TlsfAllocator* allocator)
+{
+    if (allocator->firstLevelBitmap == 0)
+        return 0;
+
+    const UINT firstLevel = FindLastSet(allocator->firstLevelBitmap);
+    const UINT secondLevel = FindLastSet(allocator->secondLevelBitmaps[firstLevel]);
+
+    UINT64 largest = 0;
+    for (UINT index = allocator->freeLists[firstLevel][secondLevel]; index != TlsfNullBlock; index = allocator->blocks[index].nextFree)
+    {
+        if (allocator->blocks[index].size > largest)
+            largest = allocator->blocks[index].size;
+    }
+
+    return largest;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <limits.h>
+#include <vector>
+
+// Alocador TLSF (two-level segregated fit) sobre uma faixa de offsets, sem memria prpria: serve para
+// subdividir heaps da GPU. Os blocos livres ficam em listas por classe de tamanho: o primeiro nvel  a potncia
+// de 2, o segundo divide cada potncia em TlsfSecondLevelCount partes. Um bitmap por nvel acha a menor lista no
+// vazia que serve, ento alocar e liberar custam O(1). Blocos vizinhos livres so fundidos na liberao.
+//
+// Tamanhos e offsets so mltiplos da granularidade (64 KB para recursos posicionados no D3D12).
+
+const UINT TlsfSecondLevelLog2 = 5;
+const UINT TlsfSecondLevelCount = 1 << TlsfSecondLevelLog2;
+const UINT TlsfFirstLevelCount = 64;
+
+const UINT TlsfNullBlock = UINT_MAX;
+
+struct TlsfBlock
+{
+    UINT64 offset;
+    UINT64 size;
+
+    // Vizinhos na faixa e, para blocos livres, na lista da classe.
+    UINT previousPhysical;
+    UINT nextPhysical;
+    UINT previousFree;
+    UINT nextFree;
+
+    bool free;
+};
+
+struct TlsfAllocation
+{
+    UINT64 offset;
+    UINT block;
+};
+
+struct TlsfAllocator
+{
+    UINT64 size;
+    UINT64 granularity;
+
+    std::vector<TlsfBlock> blocks;
+    std::vector<UINT> unusedBlocks;
+
+    UINT64 firstLevelBitmap;
+    UINT secondLevelBitmaps[TlsfFirstLevelCount];
+    UINT freeLists[TlsfFirstLevelCount][TlsfSecondLevelCount];
+
+    UINT64 allocatedBytes;
+    UINT allocationCount;
+};
+
+void InitTlsfAllocator(TlsfAllocator* allocator, UINT64 size, UINT64 granularity);
+
+// alignment precisa ser potncia de 2. Devolve false se nenhum bloco livre comportar o pedido.
+bool AllocateTlsf(TlsfAllocator* allocator, UINT64 size, UINT64 alignment, TlsfAllocation* allocation);
+void FreeTlsf(TlsfAllocator* allocator, const TlsfAllocation* allocation);
+
+// Maior bloco livre: com allocatedBytes d a fragmentao da faixa.
+UINT64 GetTlsfLargestFreeBlock(const TlsfAllocator* allocator);
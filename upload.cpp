@@ -0,0 +1,153 @@
+#include "upload.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------
+
+static void RetireUploadBatches(UploadScheduler* scheduler)
+{
+    if (scheduler->batches.empty())
+        return;
+
+    const UINT64 completedValue = scheduler->queue.getCompletedValue(scheduler->queue.context);
+
+    size_t retiredCount = 0;
+    while (retiredCount < scheduler->batches.size() && scheduler->batches[retiredCount].fenceValue <= completedValue)
+    {
+        scheduler->tail = scheduler->batches[retiredCount].stagingEnd;
+        retiredCount++;
+    }
+
+    scheduler->batches.erase(scheduler->batches.begin(), scheduler->batches.begin() + retiredCount);
+}
+
+static void SubmitUploadBatch(UploadScheduler* scheduler)
+{
+    if (scheduler->copies.empty())
+        return;
+
+    const UINT copyCount = static_cast<UINT>(scheduler->copies.size());
+    const UINT64 fenceValue = scheduler->queue.submit(scheduler->queue.context, scheduler->copies.data(), copyCount);
+
+    scheduler->batches.push_back({ fenceValue, scheduler->head });
+    scheduler->lastFenceValue = fenceValue;
+    scheduler->submittedBatchCount++;
+    scheduler->submittedCopyCount += copyCount;
+
+    scheduler->copies.clear();
+    scheduler->batchBegin = scheduler->head;
+}
+
+// Reserva size bytes a partir de head, que no pode atravessar o fim do anel.
+static UINT64 AllocateUploadStaging(UploadScheduler* scheduler, UINT64 size)
+{
+    RetireUploadBatches(scheduler);
+
+    while (scheduler->head + size - scheduler->tail > scheduler->stagingSize)
+    {
+        // O lote em preenchimento tambm ocupa o anel e s  liberado depois de enviado.
+        SubmitUploadBatch(scheduler);
+
+        scheduler->queue.wait(scheduler->queue.context, scheduler->batches.front().fenceValue);
+        scheduler->stallCount++;
+
+        RetireUploadBatches(scheduler);
+    }
+
+    const UINT64 offset = scheduler->head % scheduler->stagingSize;
+    scheduler->head += size;
+
+    return offset;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+void InitUploadScheduler(UploadScheduler* scheduler, const UploadQueue* queue, BYTE* staging, UINT64 stagingSize)
+{
+    scheduler->queue = *queue;
+    scheduler->staging = staging;
+    scheduler->stagingSize = stagingSize;
+
+    scheduler->head = 0;
+    scheduler->tail = 0;
+    scheduler->batchBegin = 0;
+
+    scheduler->copies.clear();
+    scheduler->batches.clear();
+    scheduler->lastFenceValue = 0;
+
+    scheduler->uploadedBytes = 0;
+    scheduler->submittedBatchCount = 0;
+    scheduler->submittedCopyCount = 0;
+    scheduler->stallCount = 0;
+}
+
+void QueueUpload(UploadScheduler* scheduler, void* destination, UINT64 destinationOffset, const void* data, UINT64 size)
+{
+    const UINT64 stagingSize = scheduler->stagingSize;
+    const UINT64 maxBatchSize = stagingSize / UploadBatchFraction;
+    const BYTE* source = reinterpret_cast<const BYTE*>(data);
+
+    while (size > 0)
+    {
+        // Os pedaos param no fim do anel e no tamanho de um lote.
+        const UINT64 position = scheduler->head % stagingSize;
+        const UINT64 chunkSize = (std::min)(size, (std::min)(stagingSize - position, maxBatchSize));
+        const UINT64 stagingOffset = AllocateUploadStaging(scheduler, chunkSize);
+
+        memcpy(scheduler->staging + stagingOffset, source, static_cast<size_t>(chunkSize));
+
+        UploadCopy* last = scheduler->copies.empty() ? nullptr : &scheduler->copies.back();
+        if (last && !last->source && last->destination == destination &&
+            last->destinationOffset + last->size == destinationOffset &&
+            last->stagingOffset + last->size == stagingOffset)
+        {
+            last->size += chunkSize;
+        }
+        else
+        {
+            UploadCopy copy = {};
+            copy.destination = destination;
+            copy.destinationOffset = destinationOffset;
+            copy.stagingOffset = stagingOffset;
+            copy.size = chunkSize;
+            scheduler->copies.push_back(copy);
+        }
+
+        scheduler->uploadedBytes += chunkSize;
+
+        source += chunkSize;
+        destinationOffset += chunkSize;
+        size -= chunkSize;
+
+        if (scheduler->head - scheduler->batchBegin >= maxBatchSize)
+            SubmitUploadBatch(scheduler);
+    }
+}
+
+void QueueTextureUpload(UploadScheduler* scheduler, const UploadCopy* copy)
+{
+    scheduler->copies.push_back(*copy);
+    scheduler->uploadedBytes += copy->size;
+}
+
+UINT64 FlushUploads(UploadScheduler* scheduler)
+{
+    SubmitUploadBatch(scheduler);
+    RetireUploadBatches(scheduler);
+
+    return scheduler->lastFenceValue;
+}
+
+void WaitForUploads(UploadScheduler* scheduler)
+{
+    FlushUploads(scheduler);
+
+    if (!scheduler->batches.empty())
+    {
+        scheduler->queue.wait(scheduler->queue.context, scheduler->lastFenceValue);
+        RetireUploadBatches(scheduler);
+    }
+}
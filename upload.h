@@ -0,0 +1,96 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+// Envio de dados para buffers na GPU por uma fila de cpia. Os pedidos so copiados para um anel de staging e
+// agrupados em lotes: pedidos vizinhos no destino e no anel viram uma cpia s. Cada lote termina com um sinal no
+// fence da fila de cpia, e a fila que desenha espera por esse valor antes de usar os dados. O anel  liberado
+// conforme o fence avana, ento a CPU s espera quando o anel inteiro ainda est em uso.
+//
+// A fila em si fica atrs de UploadQueue: o agendador no conhece o D3D12 e pode ser exercitado com uma fila
+// simulada.
+
+// Um lote  enviado sozinho quando passa desta frao do anel, para que o prximo possa ser preenchido enquanto
+// a GPU copia.
+const UINT UploadBatchFraction = 2;
+
+struct UploadCopy
+{
+    void* destination;
+    UINT64 destinationOffset;
+    UINT64 stagingOffset;
+    UINT64 size;
+
+    // Cpias para texturas (QueueTextureUpload) saem de um buffer do chamador, fora do anel: source  esse buffer
+    // e o subrecurso de destino  lido no footprint que comea em stagingOffset. Nas cpias do anel source  nulo.
+    void* source;
+    UINT subresource;
+    UINT format;
+    UINT width;
+    UINT height;
+    UINT rowPitch;
+};
+
+typedef UINT64(*LPUPLOADSUBMITFUNC) (void* context, const UploadCopy* copies, UINT copyCount);
+typedef UINT64(*LPUPLOADCOMPLETEDFUNC) (void* context);
+typedef void(*LPUPLOADWAITFUNC) (void* context, UINT64 fenceValue);
+
+struct UploadQueue
+{
+    void* context;
+
+    // Grava e executa as cpias de um lote e devolve o valor sinalizado no fence ao fim delas. Os valores crescem
+    // a cada lote.
+    LPUPLOADSUBMITFUNC submit;
+    LPUPLOADCOMPLETEDFUNC getCompletedValue;
+    LPUPLOADWAITFUNC wait;
+};
+
+struct UploadBatch
+{
+    UINT64 fenceValue;
+    UINT64 stagingEnd;
+};
+
+struct UploadScheduler
+{
+    UploadQueue queue;
+
+    BYTE* staging;
+    UINT64 stagingSize;
+
+    // Posies no anel contadas desde o incio (a posio real  o resto pelo tamanho). Entre tail e head ficam os
+    // lotes em voo e o lote em preenchimento, que comea em batchBegin.
+    UINT64 head;
+    UINT64 tail;
+    UINT64 batchBegin;
+
+    std::vector<UploadCopy> copies;
+    std::vector<UploadBatch> batches;
+    UINT64 lastFenceValue;
+
+    UINT64 uploadedBytes;
+    UINT submittedBatchCount;
+    UINT submittedCopyCount;
+    UINT stallCount;
+};
+
+void InitUploadScheduler(UploadScheduler* scheduler, const UploadQueue* queue, BYTE* staging, UINT64 stagingSize);
+
+// Copia os dados para o anel e agenda a cpia para destination. Pedidos maiores que o anel so divididos; se no
+// houver espao, o lote atual  enviado e a CPU espera o lote mais antigo.
+void QueueUpload(UploadScheduler* scheduler, void* destination, UINT64 destinationOffset, const void* data, UINT64 size);
+
+// Agenda a cpia de um subrecurso de textura a partir de um upload buffer que o chamador j preencheu (a
+// textura lida direto nele, sem passar pelo anel). Entra no lote atual, na ordem dos outros pedidos; o buffer
+// s pode ser liberado depois que o fence devolvido por FlushUploads for alcanado.
+void QueueTextureUpload(UploadScheduler* scheduler, const UploadCopy* copy);
+
+// Envia o lote em preenchimento, se houver, e libera o anel dos lotes concludos. Devolve o valor do fence que
+// cobre todos os pedidos feitos at aqui (0 se nenhum foi feito).
+UINT64 FlushUploads(UploadScheduler* scheduler);
+
+// Espera a GPU terminar todas as cpias enviadas.
+void WaitForUploads(UploadScheduler* scheduler);
@@ -0,0 +1,375 @@
+#include "virtualtexture.h"
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT VirtualSlotNone = UINT_MAX;
+
+static UINT GetPageIndex(const VirtualTexture* texture, UINT page)
+{
+    const UINT level = GetVirtualPageLevel(page);
+    return texture->levelOffsets[level] + GetVirtualPageY(page) * texture->levelWidths[level] + GetVirtualPageX(page);
+}
+
+static bool IsPageValid(const VirtualTexture* texture, UINT page)
+{
+    const UINT level = GetVirtualPageLevel(page);
+    return page != VirtualPageNone && level < texture->levelCount &&
+        GetVirtualPageX(page) < texture->levelWidths[level] && GetVirtualPageY(page) < texture->levelHeights[level];
+}
+
+static UINT GetParentPage(UINT page)
+{
+    return MakeVirtualPage(GetVirtualPageLevel(page) + 1, GetVirtualPageX(page) >> 1, GetVirtualPageY(page) >> 1);
+}
+
+static UINT GetPageSlot(const VirtualTexture* texture, UINT page)
+{
+    const VirtualPageEntry* entry = &texture->table[GetPageIndex(texture, page)];
+    return entry->slotY * texture->settings.cacheWidth + entry->slotX;
+}
+
+static void UnlinkSlot(VirtualTexture* texture, UINT slot)
+{
+    VirtualSlot* virtualSlot = &texture->slots[slot];
+
+    if (virtualSlot->previous != VirtualSlotNone)
+        texture->slots[virtualSlot->previous].next = virtualSlot->next;
+    else
+        texture->lruHead = virtualSlot->next;
+
+    if (virtualSlot->next != VirtualSlotNone)
+        texture->slots[virtualSlot->next].previous = virtualSlot->previous;
+    else
+        texture->lruTail = virtualSlot->previous;
+}
+
+static void PushSlotFront(VirtualTexture* texture, UINT slot)
+{
+    VirtualSlot* virtualSlot = &texture->slots[slot];
+    virtualSlot->previous = VirtualSlotNone;
+    virtualSlot->next = texture->lruHead;
+
+    if (texture->lruHead != VirtualSlotNone)
+        texture->slots[texture->lruHead].previous = slot;
+    else
+        texture->lruTail = slot;
+
+    texture->lruHead = slot;
+}
+
+// Marca o slot como usado neste quadro e o leva para o incio do LRU.
+static void TouchSlot(VirtualTexture* texture, UINT slot)
+{
+    texture->slots[slot].lastUsedFrame = texture->frame;
+
+    // O slot fixo no est na lista.
+    if (slot == 0 || texture->lruHead == slot)
+        return;
+
+    UnlinkSlot(texture, slot);
+    PushSlotFront(texture, slot);
+}
+
+static void MarkTableDirty(VirtualTexture* texture, UINT level, UINT left, UINT top, UINT right, UINT bottom)
+{
+    VirtualTableRect* rect = &texture->dirtyRects[level];
+    if (rect->left >= rect->right)
+    {
+        *rect = { level, left, top, right, bottom };
+        return;
+    }
+
+    rect->left = (std::min)(rect->left, left);
+    rect->top = (std::min)(rect->top, top);
+    rect->right = (std::max)(rect->right, right);
+    rect->bottom = (std::max)(rect->bottom, bottom);
+}
+
+// Reescreve a regio que page cobre em cada nvel at o 0, mas s as entradas que dependem dela: ao mapear, as
+// que caam num ancestral (nvel maior que o da pgina); ao despejar, as que caam na prpria pgina. As
+// descendentes residentes ficam como esto.
+static void UpdatePageRegion(VirtualTexture* texture, UINT page, VirtualPageEntry entry, bool mapping)
+{
+    const UINT pageLevel = GetVirtualPageLevel(page);
+    const UINT pageX = GetVirtualPageX(page);
+    const UINT pageY = GetVirtualPageY(page);
+
+    for (UINT level = 0; level <= pageLevel; level++)
+    {
+        const UINT shift = pageLevel - level;
+        const UINT left = pageX << shift;
+        const UINT top = pageY << shift;
+        const UINT right = (std::min)((pageX + 1) << shift, texture->levelWidths[level]);
+        const UINT bottom = (std::min)((pageY + 1) << shift, texture->levelHeights[level]);
+
+        bool changed = false;
+        for (UINT y = top; y < bottom; y++)
+        {
+            VirtualPageEntry* row = &texture->table[texture->levelOffsets[level] + y * texture->levelWidths[level]];
+            for (UINT x = left; x < right; x++)
+            {
+                const bool replace = mapping ? row[x].level > pageLevel : row[x].level == pageLevel;
+                if (replace)
+                {
+                    row[x] = entry;
+                    changed = true;
+                }
+            }
+        }
+
+        if (changed)
+            MarkTableDirty(texture, level, left, top, right, bottom);
+    }
+}
+
+static void MapPage(VirtualTexture* texture, UINT page, UINT slot)
+{
+    VirtualPageEntry entry = {};
+    entry.slotX = static_cast<BYTE>(slot % texture->settings.cacheWidth);
+    entry.slotY = static_cast<BYTE>(slot / texture->settings.cacheWidth);
+    entry.level = static_cast<BYTE>(GetVirtualPageLevel(page));
+
+    UpdatePageRegion(texture, page, entry, true);
+
+    texture->pageStates[GetPageIndex(texture, page)] = VirtualPageResident;
+    texture->slots[slot].page = page;
+    texture->residentCount++;
+}
+
+// A regio da pgina passa a cair no que cobre o pai, que est na entrada dele no nvel de cima. O ltimo nvel
+//  fixo, ento o pai sempre existe.
+static void EvictPage(VirtualTexture* texture, UINT slot)
+{
+    const UINT page = texture->slots[slot].page;
+    const VirtualPageEntry parentEntry = texture->table[GetPageIndex(texture, GetParentPage(page))];
+
+    UpdatePageRegion(texture, page, parentEntry, false);
+
+    texture->pageStates[GetPageIndex(texture, page)] = VirtualPageMissing;
+    texture->slots[slot].page = VirtualPageNone;
+    texture->residentCount--;
+    texture->evictedCount++;
+}
+
+static bool IsMoreUrgent(const VirtualPageRequest& a, const VirtualPageRequest& b)
+{
+    const UINT levelA = GetVirtualPageLevel(a.page);
+    const UINT levelB = GetVirtualPageLevel(b.page);
+    if (levelA != levelB)
+        return levelA > levelB;
+
+    if (a.count != b.count)
+        return a.count > b.count;
+
+    return a.page < b.page;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+HRESULT InitVirtualTexture(VirtualTexture* texture, UINT width, UINT height, const VirtualTextureSettings* settings)
+{
+    const UINT pagesX = (width + VirtualTileSize - 1) / VirtualTileSize;
+    const UINT pagesY = (height + VirtualTileSize - 1) / VirtualTileSize;
+    const UINT slotCount = settings->cacheWidth * settings->cacheHeight;
+
+    if (pagesX == 0 || pagesY == 0 || pagesX > MaxVirtualPages || pagesY > MaxVirtualPages ||
+        settings->cacheWidth == 0 || settings->cacheWidth > MaxVirtualCacheSize || settings->cacheHeight > MaxVirtualCacheSize ||
+        slotCount < 2 || settings->maxPendingPages == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    texture->settings = *settings;
+    texture->width = width;
+    texture->height = height;
+
+    // Os nveis param quando o nvel inteiro cabe numa pgina.
+    UINT pageCount = 0;
+    texture->levelCount = 0;
+    for (UINT x = pagesX, y = pagesY; ; x = (x + 1) / 2, y = (y + 1) / 2)
+    {
+        const UINT level = texture->levelCount++;
+        texture->levelWidths[level] = x;
+        texture->levelHeights[level] = y;
+        texture->levelOffsets[level] = pageCount;
+        pageCount += x * y;
+
+        if (x == 1 && y == 1)
+            break;
+    }
+
+    const UINT topLevel = texture->levelCount - 1;
+    const UINT topPage = MakeVirtualPage(topLevel, 0, 0);
+
+    texture->pageStates.assign(pageCount, VirtualPageMissing);
+
+    // Entradas comeam sem pgina (nvel acima de todos); o mapeamento da pgina do ltimo nvel preenche a tabela
+    // inteira e a marca para envio.
+    texture->table.assign(pageCount, { 0, 0, 0xFF, 0 });
+
+    for (UINT level = 0; level < MaxVirtualLevels; level++)
+    {
+        texture->dirtyRects[level] = { level, 0, 0, 0, 0 };
+    }
+
+    // O slot 0 fica com a pgina do ltimo nvel; os outros comeam livres, tirados em ordem crescente.
+    texture->slots.assign(slotCount, { VirtualPageNone, 0, VirtualSlotNone, VirtualSlotNone });
+    texture->freeSlots.clear();
+    for (UINT slot = slotCount - 1; slot > 0; slot--)
+    {
+        texture->freeSlots.push_back(slot);
+    }
+
+    texture->lruHead = VirtualSlotNone;
+    texture->lruTail = VirtualSlotNone;
+    texture->frame = 0;
+
+    texture->requests.clear();
+    texture->pendingCount = 0;
+    texture->residentCount = 0;
+    texture->evictedCount = 0;
+    texture->feedbackPageCount = 0;
+    texture->missingPageCount = 0;
+
+    MapPage(texture, topPage, 0);
+
+    return S_OK;
+}
+
+void AnalyzeVirtualFeedback(VirtualTexture* texture, const UINT* feedback, UINT count)
+{
+    texture->frame++;
+    texture->requests.clear();
+    texture->candidates.clear();
+
+    // Ordenar junta os pixels de cada pgina e torna o resultado independente da ordem do feedback.
+    texture->sortedFeedback.assign(feedback, feedback + count);
+    std::sort(texture->sortedFeedback.begin(), texture->sortedFeedback.end());
+
+    texture->feedbackPageCount = 0;
+    texture->missingPageCount = 0;
+
+    const UINT* sorted = texture->sortedFeedback.data();
+    for (UINT i = 0; i < count; )
+    {
+        const UINT page = sorted[i];
+        UINT run = 1;
+        while (i + run < count && sorted[i + run] == page)
+            run++;
+
+        i += run;
+
+        if (!IsPageValid(texture, page))
+            continue;
+
+        texture->feedbackPageCount++;
+        if (texture->pageStates[GetPageIndex(texture, page)] != VirtualPageResident)
+            texture->missingPageCount++;
+
+        // A cadeia at o ltimo nvel: os residentes continuam no cache para servir de reserva, e os que faltam
+        // so pedidos junto.
+        for (UINT ancestor = page; ; ancestor = GetParentPage(ancestor))
+        {
+            const BYTE state = texture->pageStates[GetPageIndex(texture, ancestor)];
+            if (state == VirtualPageResident)
+                TouchSlot(texture, GetPageSlot(texture, ancestor));
+            else if (state == VirtualPageMissing)
+                texture->candidates.push_back({ ancestor, run });
+
+            if (GetVirtualPageLevel(ancestor) + 1 == texture->levelCount)
+                break;
+        }
+    }
+
+    // Um ancestral pode vir de vrias pginas: os pedidos repetidos somam os pixels.
+    std::vector<VirtualPageRequest>& candidates = texture->candidates;
+    std::sort(candidates.begin(), candidates.end(), [](const VirtualPageRequest& a, const VirtualPageRequest& b) { return a.page < b.page; });
+
+    size_t mergedCount = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (mergedCount > 0 && candidates[mergedCount - 1].page == candidates[i].page)
+            candidates[mergedCount - 1].count += candidates[i].count;
+        else
+            candidates[mergedCount++] = candidates[i];
+    }
+
+    candidates.resize(mergedCount);
+
+    const UINT available = texture->settings.maxPendingPages - texture->pendingCount;
+    const size_t requestCount = (std::min)(candidates.size(), static_cast<size_t>(available));
+    std::partial_sort(candidates.begin(), candidates.begin() + requestCount, candidates.end(), IsMoreUrgent);
+
+    for (size_t i = 0; i < requestCount; i++)
+    {
+        texture->pageStates[GetPageIndex(texture, candidates[i].page)] = VirtualPageLoading;
+        texture->requests.push_back(candidates[i]);
+    }
+
+    texture->pendingCount += static_cast<UINT>(requestCount);
+}
+
+bool CompleteVirtualPage(VirtualTexture* texture, UINT page, UINT* slot)
+{
+    if (!IsPageValid(texture, page) || texture->pageStates[GetPageIndex(texture, page)] != VirtualPageLoading)
+        return false;
+
+    texture->pendingCount--;
+
+    if (!texture->freeSlots.empty())
+    {
+        *slot = texture->freeSlots.back();
+        texture->freeSlots.pop_back();
+    }
+    else
+    {
+        // O fim do LRU  o slot usado h mais tempo; se nem ele pode sair, nenhum pode.
+        const UINT victim = texture->lruTail;
+        if (victim == VirtualSlotNone || texture->slots[victim].lastUsedFrame + texture->settings.framesInFlight >= texture->frame)
+        {
+            texture->pageStates[GetPageIndex(texture, page)] = VirtualPageMissing;
+            return false;
+        }
+
+        UnlinkSlot(texture, victim);
+        EvictPage(texture, victim);
+        *slot = victim;
+    }
+
+    // Entra no incio do LRU, como usada neste quadro.
+    MapPage(texture, page, *slot);
+    texture->slots[*slot].lastUsedFrame = texture->frame;
+    PushSlotFront(texture, *slot);
+
+    return true;
+}
+
+void CancelVirtualPage(VirtualTexture* texture, UINT page)
+{
+    if (!IsPageValid(texture, page) || texture->pageStates[GetPageIndex(texture, page)] != VirtualPageLoading)
+        return;
+
+    texture->pageStates[GetPageIndex(texture, page)] = VirtualPageMissing;
+    texture->pendingCount--;
+}
+
+void GetVirtualTableUpdates(VirtualTexture* texture, std::vector<VirtualTableRect>* rects)
+{
+    rects->clear();
+
+    for (UINT level = 0; level < texture->levelCount; level++)
+    {
+        VirtualTableRect* rect = &texture->dirtyRects[level];
+        if (rect->left < rect->right)
+            rects->push_back(*rect);
+
+        *rect = { level, 0, 0, 0, 0 };
+    }
+}
+
+VirtualPageEntry GetVirtualPageEntry(const VirtualTexture* texture, UINT level, UINT x, UINT y)
+{
+    return texture->table[texture->levelOffsets[level] + y * texture->levelWidths[level] + x];
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "infinity.h"
+
+#include <vector>
+
+// Texturas virtuais: uma textura maior que a memria de vdeo  dividida em pginas de VirtualTileSize texels,
+// e s as pginas que a tela usa ficam num cache fsico de slots (uma textura com cacheWidth x cacheHeight
+// pginas). A tabela de indireo diz, para cada pgina de cada nvel, em que slot est a pgina residente mais
+// fina que a cobre: a prpria ou um ancestral. O shader l a tabela, escreve no buffer de feedback a pgina que
+// queria e amostra o slot indicado.
+//
+// Esta parte  s da CPU e no conhece o D3D12: analisa o feedback, decide o que pedir, mantm o LRU dos slots e
+// atualiza a tabela de forma incremental. Quem usa l as pginas, copia os texels para o slot devolvido por
+// CompleteVirtualPage e envia para a GPU os retngulos alterados da tabela.
+
+const UINT VirtualTileSize = 128;
+
+// Texels repetidos dos vizinhos em volta de cada pgina no cache fsico, para a filtragem no sair dela. Um slot
+// ocupa VirtualTileSize + 2 * VirtualTileBorder texels por eixo.
+const UINT VirtualTileBorder = 4;
+
+const UINT MaxVirtualLevels = 15;
+const UINT MaxVirtualPages = 1 << 14;       // Pginas por eixo no nvel 0.
+const UINT MaxVirtualCacheSize = 256;       // Slots por eixo; as coordenadas cabem em um byte.
+
+// Pginas so (nvel, x, y) em 32 bits, como o shader escreve no feedback. VirtualPageNone marca os pixels sem
+// textura virtual.
+const UINT VirtualPageNone = 0xFFFFFFFF;
+
+inline UINT MakeVirtualPage(UINT level, UINT x, UINT y)
+{
+    return x | (y << 14) | (level << 28);
+}
+
+inline UINT GetVirtualPageLevel(UINT page) { return page >> 28; }
+inline UINT GetVirtualPageX(UINT page) { return page & 0x3FFF; }
+inline UINT GetVirtualPageY(UINT page) { return (page >> 14) & 0x3FFF; }
+
+struct VirtualTextureSettings
+{
+    UINT cacheWidth;            // Slots do cache fsico por eixo.
+    UINT cacheHeight;
+    UINT maxPendingPages;       // Pginas sendo lidas ao mesmo tempo.
+    UINT framesInFlight;        // Pginas usadas nesses ltimos quadros no so despejadas: a GPU ainda pode l-las.
+};
+
+const VirtualTextureSettings DefaultVirtualTextureSettings = { 32, 32, 16, 3 };
+
+enum VirtualPageState
+{
+    VirtualPageMissing,
+    VirtualPageLoading,
+    VirtualPageResident
+};
+
+// Texel da tabela de indireo (RGBA8_UINT): o slot da pgina residente e o nvel dela.
+struct VirtualPageEntry
+{
+    BYTE slotX;
+    BYTE slotY;
+    BYTE level;
+    BYTE unused;
+};
+
+struct VirtualSlot
+{
+    UINT page;
+    UINT lastUsedFrame;
+
+    // Lista do LRU, da mais recente para a menos recente. O slot fixo (o ltimo nvel) no entra nela.
+    UINT previous;
+    UINT next;
+};
+
+// Retngulo [left, right) x [top, bottom) de um nvel da tabela, em pginas.
+struct VirtualTableRect
+{
+    UINT level;
+    UINT left;
+    UINT top;
+    UINT right;
+    UINT bottom;
+};
+
+struct VirtualPageRequest
+{
+    UINT page;
+    UINT count;                 // Pixels do feedback que pediram a pgina ou uma descendente.
+};
+
+struct VirtualTexture
+{
+    VirtualTextureSettings settings;
+    UINT width;
+    UINT height;
+
+    // Pginas por eixo em cada nvel e incio de cada nvel em table e pageStates. O ltimo nvel tem uma pgina
+    // s, que fica fixa no slot 0.
+    UINT levelCount;
+    UINT levelWidths[MaxVirtualLevels];
+    UINT levelHeights[MaxVirtualLevels];
+    UINT levelOffsets[MaxVirtualLevels];
+
+    std::vector<VirtualPageEntry> table;
+    std::vector<BYTE> pageStates;
+    VirtualTableRect dirtyRects[MaxVirtualLevels];
+
+    std::vector<VirtualSlot> slots;
+    std::vector<UINT> freeSlots;
+    UINT lruHead;
+    UINT lruTail;
+    UINT frame;
+
+    std::vector<UINT> sortedFeedback;
+    std::vector<VirtualPageRequest> candidates;
+
+    // Pginas pedidas no ltimo AnalyzeVirtualFeedback, da mais urgente para a menos. Ficam em VirtualPageLoading
+    // at CompleteVirtualPage ou CancelVirtualPage.
+    std::vector<VirtualPageRequest> requests;
+    UINT pendingCount;
+
+    UINT residentCount;
+    UINT evictedCount;
+    UINT feedbackPageCount;     // Pginas distintas no ltimo feedback.
+    UINT missingPageCount;      // Dessas, as que no estavam residentes.
+};
+
+// width e height em texels. A pgina do ltimo nvel ocupa o slot 0 desde o incio e nunca sai: quem usa precisa
+// carreg-la antes do primeiro quadro. Devolve E_INVALIDARG se a textura ou o cache passarem dos limites.
+HRESULT InitVirtualTexture(VirtualTexture* texture, UINT width, UINT height, const VirtualTextureSettings* settings);
+
+// Avana um quadro. feedback traz as pginas escritas pelo shader (VirtualPageNone e pginas fora da textura so
+// ignoradas). As pginas residentes e os ancestrais delas so marcados como usados; as que faltam, e os
+// ancestrais que tambm faltam, viram pedidos: primeiro os nveis mais grossos, depois os mais pedidos, at
+// maxPendingPages em leitura. O resultado  o mesmo para o mesmo feedback, em qualquer ordem.
+void AnalyzeVirtualFeedback(VirtualTexture* texture, const UINT* feedback, UINT count);
+
+// A pgina pedida chegou. Reserva um slot, despejando a pgina usada h mais tempo fora dos quadros em voo, e
+// atualiza a tabela. Devolve false se nenhum slot puder ser liberado agora: a pgina volta a faltar e ser pedida
+// de novo.
+bool CompleteVirtualPage(VirtualTexture* texture, UINT page, UINT* slot);
+
+// A leitura falhou ou foi abandonada: a pgina volta a faltar.
+void CancelVirtualPage(VirtualTexture* texture, UINT page);
+
+// Retngulos da tabela alterados desde a ltima chamada, um por nvel no mximo.
+void GetVirtualTableUpdates(VirtualTexture* texture, std::vector<VirtualTableRect>* rects);
+
+// Entrada da tabela para uma pgina, como o shader a l.
+VirtualPageEntry GetVirtualPageEntry(const VirtualTexture* texture, UINT level, UINT x, UINT y);
@@ -0,0 +1,1891 @@
+#include "zstd.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT ZstdMagic = 0xFD2FB528;
+const UINT ZstdSkippableMagic = 0x184D2A50;    // Os 4 bits baixos so livres.
+
+const UINT ZstdMaxBlockSize = 128 * 1024;
+
+const UINT ZstdMaxHuffmanBits = 11;
+const UINT ZstdMaxHuffmanWeightLog = 6;
+
+const UINT ZstdMaxLiteralLengthLog = 9;
+const UINT ZstdMaxMatchLengthLog = 9;
+const UINT ZstdMaxOffsetLog = 8;
+
+const UINT ZstdMaxLiteralLengthCode = 35;
+const UINT ZstdMaxMatchLengthCode = 52;
+const UINT ZstdMaxOffsetCode = 31;
+
+// Distribuies predefinidas das tabelas de sequncias (seo 3.1.1.3.2.2 da RFC).
+static const short LiteralLengthDefaults[ZstdMaxLiteralLengthCode + 1] =
+{
+    4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1
+};
+
+static const short MatchLengthDefaults[ZstdMaxMatchLengthCode + 1] =
+{
+    1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const short OffsetDefaults[29] =
+{
+    1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+
+// Valor base e bits extras de cada cdigo de comprimento.
+static const UINT LiteralLengthBase[ZstdMaxLiteralLengthCode + 1] =
+{
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024,
+    2048, 4096, 8192, 16384, 32768, 65536
+};
+
+static const BYTE LiteralLengthBits[ZstdMaxLiteralLengthCode + 1] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+};
+
+static const UINT MatchLengthBase[ZstdMaxMatchLengthCode + 1] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33,
+    34, 35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051, 4099, 8195, 16387, 32771, 65539
+};
+
+static const BYTE MatchLengthBits[ZstdMaxMatchLengthCode + 1] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3,
+    3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+};
+
+struct ZstdFseEntry
+{
+    USHORT baseline;
+    BYTE symbol;
+    BYTE bits;
+};
+
+struct ZstdFseTable
+{
+    UINT accuracyLog;
+    ZstdFseEntry entries[1 << ZstdMaxLiteralLengthLog];
+};
+
+struct ZstdHuffmanEntry
+{
+    BYTE symbol;
+    BYTE bits;
+};
+
+// Estado que passa de um bloco para o seguinte dentro do frame: tabelas reaproveitadas pelos modos "repeat" e
+// "treeless" e os trs ltimos offsets.
+struct ZstdDecoder
+{
+    ZstdFseTable literalLengths;
+    ZstdFseTable matchLengths;
+    ZstdFseTable offsets;
+    bool hasSequenceTables;
+
+    ZstdHuffmanEntry huffman[1 << ZstdMaxHuffmanBits];
+    UINT huffmanBits;
+    bool hasHuffman;
+
+    UINT repeatOffsets[3];
+
+    BYTE literals[ZstdMaxBlockSize];
+};
+
+// Fluxo de bits lido de trs para frente: o ltimo byte traz um bit 1 que marca o comeo, e os campos saem do
+// bit mais alto para o mais baixo. position conta os bits ainda no lidos e fica negativa quando a leitura passa
+// do comeo; os bits que faltam valem zero.
+struct ZstdBackwardBits
+{
+    const BYTE* data;
+    size_t size;
+    INT64 position;
+};
+
+static UINT FindHighestBit(UINT value)
+{
+    UINT bit = 0;
+    while (value >>= 1)
+        bit++;
+
+    return bit;
+}
+
+static UINT64 ReadLittleEndian(const BYTE* p, UINT byteCount)
+{
+    UINT64 value = 0;
+    for (UINT i = 0; i < byteCount; i++)
+    {
+        value |= static_cast<UINT64>(p[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+static bool InitBackwardBits(ZstdBackwardBits* bits, const BYTE* data, size_t size)
+{
+    if (size == 0 || data[size - 1] == 0)
+        return false;
+
+    bits->data = data;
+    bits->size = size;
+    bits->position = static_cast<INT64>(size - 1) * 8 + FindHighestBit(data[size - 1]);
+
+    return true;
+}
+
+// count bits a partir do bit start (contado do comeo dos dados), com at 56 bits.
+static UINT64 GetBitsAt(const ZstdBackwardBits* bits, INT64 start, UINT count)
+{
+    if (count == 0)
+        return 0;
+
+    const UINT64 mask = (1ull << count) - 1;
+    if (start >= 0 && static_cast<size_t>(start >> 3) + 8 <= bits->size)
+    {
+        UINT64 value;
+        memcpy(&value, bits->data + (start >> 3), sizeof(value));
+        return (value >> (start & 7)) & mask;
+    }
+
+    UINT64 value = 0;
+    for (UINT i = 0; i < count; i++)
+    {
+        const INT64 bit = start + i;
+        if (bit >= 0 && bit < static_cast<INT64>(bits->size) * 8)
+            value |= static_cast<UINT64>((bits->data[bit >> 3] >> (bit & 7)) & 1) << i;
+    }
+
+    return value;
+}
+
+static UINT ReadBackwardBits(ZstdBackwardBits* bits, UINT count)
+{
+    bits->position -= count;
+    return static_cast<UINT>(GetBitsAt(bits, bits->position, count));
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Monta a tabela de decodificao a partir das probabilidades normalizadas (-1  "menos que 1").
+static bool BuildFseTable(const short* counts, UINT symbolCount, UINT accuracyLog, ZstdFseTable* table)
+{
+    const UINT tableSize = 1u << accuracyLog;
+    UINT highThreshold = tableSize - 1;
+    USHORT nextState[256];
+
+    table->accuracyLog = accuracyLog;
+
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        if (counts[s] == -1)
+        {
+            table->entries[highThreshold--].symbol = static_cast<BYTE>(s);
+            nextState[s] = 1;
+        }
+        else
+        {
+            nextState[s] = static_cast<USHORT>(counts[s]);
+        }
+    }
+
+    const UINT step = (tableSize >> 1) + (tableSize >> 3) + 3;
+    const UINT mask = tableSize - 1;
+    UINT position = 0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        for (int i = 0; i < counts[s]; i++)
+        {
+            table->entries[position].symbol = static_cast<BYTE>(s);
+            do
+            {
+                position = (position + step) & mask;
+            } while (position > highThreshold);
+        }
+    }
+
+    // Com as contagens fechando o total, o passeio volta exatamente ao incio.
+    if (position != 0)
+        return false;
+
+    for (UINT u = 0; u < tableSize; u++)
+    {
+        ZstdFseEntry* entry = &table->entries[u];
+        const UINT state = nextState[entry->symbol]++;
+        const UINT bits = accuracyLog - FindHighestBit(state);
+        entry->bits = static_cast<BYTE>(bits);
+        entry->baseline = static_cast<USHORT>((state << bits) - tableSize);
+    }
+
+    return true;
+}
+
+// L a descrio de uma tabela FSE (seo 4.1.1 da RFC) e devolve os bytes consumidos, ou 0 se for invlida.
+static size_t ReadFseTable(const BYTE* source, size_t size, UINT maxSymbol, UINT maxAccuracyLog, ZstdFseTable* table)
+{
+    if (size < 1)
+        return 0;
+
+    size_t bitPosition = 0;
+    auto readBits = [&](UINT count) -> UINT
+    {
+        UINT value = 0;
+        for (UINT i = 0; i < count; i++, bitPosition++)
+        {
+            if ((bitPosition >> 3) < size)
+                value |= ((source[bitPosition >> 3] >> (bitPosition & 7)) & 1u) << i;
+        }
+        return value;
+    };
+
+    const UINT accuracyLog = readBits(4) + 5;
+    if (accuracyLog > maxAccuracyLog)
+        return 0;
+
+    short counts[256] = {};
+    int remaining = (1 << accuracyLog) + 1;
+    int threshold = 1 << accuracyLog;
+    UINT bitCount = accuracyLog + 1;
+    UINT symbol = 0;
+
+    while (remaining > 1 && symbol <= maxSymbol)
+    {
+        // Valores pequenos usam um bit a menos: os primeiros max valores cabem em bitCount - 1 bits.
+        const int max = (2 * threshold - 1) - remaining;
+        int count;
+        const UINT low = readBits(bitCount - 1);
+        if (static_cast<int>(low) < max)
+        {
+            count = low;
+        }
+        else
+        {
+            count = low | (readBits(1) << (bitCount - 1));
+            if (count >= threshold)
+                count -= max;
+        }
+
+        count--;
+        remaining -= (count < 0) ? -count : count;
+        counts[symbol++] = static_cast<short>(count);
+
+        // Depois de uma probabilidade zero vem quantos smbolos seguintes tambm so zero, 2 bits por vez.
+        if (count == 0)
+        {
+            UINT repeat;
+            do
+            {
+                repeat = readBits(2);
+                symbol += repeat;
+            } while (repeat == 3);
+        }
+
+        while (remaining < threshold)
+        {
+            bitCount--;
+            threshold >>= 1;
+        }
+    }
+
+    const size_t byteCount = (bitPosition + 7) >> 3;
+    if (remaining != 1 || symbol > maxSymbol + 1 || byteCount > size)
+        return 0;
+
+    return BuildFseTable(counts, symbol, accuracyLog, table) ? byteCount : 0;
+}
+
+static void BuildRleFseTable(BYTE symbol, ZstdFseTable* table)
+{
+    table->accuracyLog = 0;
+    table->entries[0] = { 0, symbol, 0 };
+}
+
+static UINT DecodeFseSymbol(const ZstdFseTable* table, UINT* state, ZstdBackwardBits* bits)
+{
+    const ZstdFseEntry* entry = &table->entries[*state];
+    *state = entry->baseline + ReadBackwardBits(bits, entry->bits);
+    return entry->symbol;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Os pesos vm comprimidos com FSE (headerByte < 128) ou 4 bits cada. O peso do ltimo smbolo  implcito: o
+// que falta para a soma de 2^(peso - 1) fechar uma potncia de 2.
+static size_t ReadHuffmanTable(ZstdDecoder* decoder, const BYTE* source, size_t size)
+{
+    if (size < 1)
+        return 0;
+
+    BYTE weights[256] = {};
+    UINT weightCount = 0;
+    const UINT headerByte = source[0];
+    size_t consumed;
+
+    if (headerByte >= 128)
+    {
+        weightCount = headerByte - 127;
+        consumed = 1 + (weightCount + 1) / 2;
+        if (consumed > size)
+            return 0;
+
+        for (UINT i = 0; i < weightCount; i++)
+        {
+            const BYTE packed = source[1 + i / 2];
+            weights[i] = (i & 1) ? (packed & 15) : (packed >> 4);
+        }
+    }
+    else
+    {
+        consumed = 1 + headerByte;
+        if (consumed > size)
+            return 0;
+
+        ZstdFseTable table;
+        const size_t tableBytes = ReadFseTable(source + 1, headerByte, 255, ZstdMaxHuffmanWeightLog, &table);
+        if (tableBytes == 0)
+            return 0;
+
+        ZstdBackwardBits bits;
+        if (!InitBackwardBits(&bits, source + 1 + tableBytes, headerByte - tableBytes))
+            return 0;
+
+        // Dois estados intercalados; quando os bits acabam, o outro estado ainda entrega um ltimo peso.
+        UINT states[2];
+        states[0] = ReadBackwardBits(&bits, table.accuracyLog);
+        states[1] = ReadBackwardBits(&bits, table.accuracyLog);
+
+        for (UINT turn = 0;; turn ^= 1)
+        {
+            if (weightCount >= 254)
+                return 0;
+
+            weights[weightCount++] = static_cast<BYTE>(DecodeFseSymbol(&table, &states[turn], &bits));
+            if (bits.position < 0)
+            {
+                weights[weightCount++] = table.entries[states[turn ^ 1]].symbol;
+                break;
+            }
+        }
+    }
+
+    UINT total = 0;
+    for (UINT i = 0; i < weightCount; i++)
+    {
+        if (weights[i] > ZstdMaxHuffmanBits)
+            return 0;
+
+        if (weights[i] > 0)
+            total += 1u << (weights[i] - 1);
+    }
+
+    if (total == 0 || weightCount > 255)
+        return 0;
+
+    const UINT maxBits = FindHighestBit(total) + 1;
+    const UINT left = (1u << maxBits) - total;
+    if (maxBits > ZstdMaxHuffmanBits || (left & (left - 1)) != 0)
+        return 0;
+
+    weights[weightCount++] = static_cast<BYTE>(FindHighestBit(left) + 1);
+
+    // Smbolos em ordem de peso crescente, e de valor dentro do mesmo peso; cada um ocupa 2^(peso - 1) entradas.
+    UINT rankStart[ZstdMaxHuffmanBits + 2] = {};
+    for (UINT i = 0; i < weightCount; i++)
+    {
+        if (weights[i] > 0)
+            rankStart[weights[i] + 1] += 1u << (weights[i] - 1);
+    }
+
+    for (UINT w = 1; w <= ZstdMaxHuffmanBits + 1; w++)
+    {
+        rankStart[w] += rankStart[w - 1];
+    }
+
+    for (UINT i = 0; i < weightCount; i++)
+    {
+        const UINT weight = weights[i];
+        if (weight == 0)
+            continue;
+
+        const UINT length = 1u << (weight - 1);
+        const ZstdHuffmanEntry entry = { static_cast<BYTE>(i), static_cast<BYTE>(maxBits + 1 - weight) };
+        for (UINT j = 0; j < length; j++)
+        {
+            decoder->huffman[rankStart[weight] + j] = entry;
+        }
+
+        rankStart[weight] += length;
+    }
+
+    decoder->huffmanBits = maxBits;
+    decoder->hasHuffman = true;
+
+    return consumed;
+}
+
+static BYTE DecodeHuffmanSymbol(const ZstdDecoder* decoder, ZstdBackwardBits* bits)
+{
+    const UINT maxBits = decoder->huffmanBits;
+    const ZstdHuffmanEntry entry = decoder->huffman[GetBitsAt(bits, bits->position - maxBits, maxBits)];
+    bits->position -= entry.bits;
+
+    return entry.symbol;
+}
+
+// Os fluxos so decodificados juntos, um smbolo de cada por vez, para que as buscas na tabela se sobreponham.
+static bool DecodeHuffmanStreams(const ZstdDecoder* decoder, const BYTE* const* sources, const size_t* sizes, BYTE* const* outputs,
+    const size_t* counts, UINT streamCount)
+{
+    ZstdBackwardBits bits[4];
+    size_t commonCount = counts[0];
+    for (UINT i = 0; i < streamCount; i++)
+    {
+        if (!InitBackwardBits(&bits[i], sources[i], sizes[i]))
+            return false;
+
+        commonCount = (std::min)(commonCount, counts[i]);
+    }
+
+    size_t n = 0;
+    if (streamCount == 4)
+    {
+        for (; n < commonCount; n++)
+        {
+            outputs[0][n] = DecodeHuffmanSymbol(decoder, &bits[0]);
+            outputs[1][n] = DecodeHuffmanSymbol(decoder, &bits[1]);
+            outputs[2][n] = DecodeHuffmanSymbol(decoder, &bits[2]);
+            outputs[3][n] = DecodeHuffmanSymbol(decoder, &bits[3]);
+        }
+    }
+
+    for (UINT i = 0; i < streamCount; i++)
+    {
+        for (size_t j = n; j < counts[i]; j++)
+        {
+            outputs[i][j] = DecodeHuffmanSymbol(decoder, &bits[i]);
+        }
+
+        if (bits[i].position != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Seo de literais do bloco (seo 3.1.1.3.1 da RFC). Literais crus so usados direto da origem.
+static size_t ReadLiterals(ZstdDecoder* decoder, const BYTE* source, size_t size, const BYTE** literals, size_t* literalCount)
+{
+    if (size < 1)
+        return 0;
+
+    const UINT type = source[0] & 3;
+    const UINT sizeFormat = (source[0] >> 2) & 3;
+
+    if (type < 2)
+    {
+        size_t headerSize;
+        size_t regeneratedSize;
+        switch (sizeFormat)
+        {
+        case 1:
+            headerSize = 2;
+            regeneratedSize = (size >= 2) ? (source[0] >> 4) + (source[1] << 4) : 0;
+            break;
+
+        case 3:
+            headerSize = 3;
+            regeneratedSize = (size >= 3) ? (source[0] >> 4) + (source[1] << 4) + (source[2] << 12) : 0;
+            break;
+
+        default:
+            headerSize = 1;
+            regeneratedSize = source[0] >> 3;
+            break;
+        }
+
+        if (headerSize > size || regeneratedSize > ZstdMaxBlockSize)
+            return 0;
+
+        *literalCount = regeneratedSize;
+        if (type == 0)
+        {
+            if (headerSize + regeneratedSize > size)
+                return 0;
+
+            *literals = source + headerSize;
+            return headerSize + regeneratedSize;
+        }
+
+        if (headerSize + 1 > size)
+            return 0;
+
+        memset(decoder->literals, source[headerSize], regeneratedSize);
+        *literals = decoder->literals;
+        return headerSize + 1;
+    }
+
+    const size_t headerSize = (sizeFormat < 2) ? 3 : sizeFormat + 2;
+    if (headerSize > size)
+        return 0;
+
+    const UINT64 header = ReadLittleEndian(source, static_cast<UINT>(headerSize));
+    const UINT sizeBits = (sizeFormat < 2) ? 10 : 4 * sizeFormat + 6;
+    const size_t regeneratedSize = static_cast<size_t>((header >> 4) & ((1ull << sizeBits) - 1));
+    const size_t compressedSize = static_cast<size_t>((header >> (4 + sizeBits)) & ((1ull << sizeBits) - 1));
+    const bool fourStreams = sizeFormat != 0;
+
+    if (regeneratedSize > ZstdMaxBlockSize || headerSize + compressedSize > size)
+        return 0;
+
+    const BYTE* p = source + headerSize;
+    size_t remaining = compressedSize;
+
+    if (type == 2)
+    {
+        const size_t tableSize = ReadHuffmanTable(decoder, p, remaining);
+        if (tableSize == 0)
+            return 0;
+
+        p += tableSize;
+        remaining -= tableSize;
+    }
+    else if (!decoder->hasHuffman)
+    {
+        return 0;
+    }
+
+    if (!fourStreams)
+    {
+        BYTE* output = decoder->literals;
+        if (!DecodeHuffmanStreams(decoder, &p, &remaining, &output, &regeneratedSize, 1))
+            return 0;
+    }
+    else
+    {
+        // Tabela de saltos com o tamanho dos trs primeiros fluxos; cada um regenera um quarto (arredondado para
+        // cima) e o ltimo fica com o resto.
+        if (remaining < 6)
+            return 0;
+
+        size_t sizes[4] = { ReadLittleEndian(p, 2), ReadLittleEndian(p + 2, 2), ReadLittleEndian(p + 4, 2), 0 };
+        p += 6;
+        remaining -= 6;
+
+        const size_t segment = (regeneratedSize + 3) / 4;
+        if (sizes[0] + sizes[1] + sizes[2] > remaining || 3 * segment > regeneratedSize)
+            return 0;
+
+        sizes[3] = remaining - sizes[0] - sizes[1] - sizes[2];
+
+        const BYTE* sources[4] = { p, p + sizes[0], p + sizes[0] + sizes[1], p + sizes[0] + sizes[1] + sizes[2] };
+        BYTE* outputs[4] = { decoder->literals, decoder->literals + segment, decoder->literals + 2 * segment, decoder->literals + 3 * segment };
+        const size_t counts[4] = { segment, segment, segment, regeneratedSize - 3 * segment };
+
+        if (!DecodeHuffmanStreams(decoder, sources, sizes, outputs, counts, 4))
+            return 0;
+    }
+
+    *literals = decoder->literals;
+    *literalCount = regeneratedSize;
+
+    return headerSize + compressedSize;
+}
+
+// Modo de uma das trs tabelas de sequncias: predefinida, RLE, descrita no bloco ou a do bloco anterior.
+static size_t ReadSequenceTable(UINT mode, const BYTE* source, size_t size, const short* defaults, UINT defaultCount, UINT defaultLog,
+    UINT maxSymbol, UINT maxAccuracyLog, ZstdFseTable* table, bool hasPrevious)
+{
+    switch (mode)
+    {
+    case 0:
+        BuildFseTable(defaults, defaultCount, defaultLog, table);
+        return 0;
+
+    case 1:
+        if (size < 1 || source[0] > maxSymbol)
+            return SIZE_MAX;
+
+        BuildRleFseTable(source[0], table);
+        return 1;
+
+    case 2:
+    {
+        const size_t consumed = ReadFseTable(source, size, maxSymbol, maxAccuracyLog, table);
+        return (consumed > 0) ? consumed : SIZE_MAX;
+    }
+
+    default:
+        return hasPrevious ? 0 : SIZE_MAX;
+    }
+}
+
+static bool DecodeCompressedBlock(ZstdDecoder* decoder, const BYTE* source, size_t size, BYTE* frameStart, BYTE** output, BYTE* outputEnd)
+{
+    const BYTE* literals;
+    size_t literalCount;
+    const size_t literalsSize = ReadLiterals(decoder, source, size, &literals, &literalCount);
+    if (literalsSize == 0)
+        return false;
+
+    const BYTE* p = source + literalsSize;
+    const BYTE* end = source + size;
+    if (p >= end)
+        return false;
+
+    size_t sequenceCount = *p++;
+    if (sequenceCount >= 128)
+    {
+        if (sequenceCount == 255)
+        {
+            if (end - p < 2)
+                return false;
+
+            sequenceCount = p[0] + (p[1] << 8) + 0x7F00;
+            p += 2;
+        }
+        else
+        {
+            if (end - p < 1)
+                return false;
+
+            sequenceCount = ((sequenceCount - 128) << 8) + *p++;
+        }
+    }
+
+    BYTE* out = *output;
+    const BYTE* literalEnd = literals + literalCount;
+
+    if (sequenceCount > 0)
+    {
+        if (p >= end)
+            return false;
+
+        const UINT modes = *p++;
+        if (modes & 3)
+            return false;
+
+        const size_t literalLengthSize = ReadSequenceTable(modes >> 6, p, end - p, LiteralLengthDefaults, _countof(LiteralLengthDefaults), 6,
+            ZstdMaxLiteralLengthCode, ZstdMaxLiteralLengthLog, &decoder->literalLengths, decoder->hasSequenceTables);
+        if (literalLengthSize == SIZE_MAX)
+            return false;
+        p += literalLengthSize;
+
+        const size_t offsetSize = ReadSequenceTable((modes >> 4) & 3, p, end - p, OffsetDefaults, _countof(OffsetDefaults), 5,
+            ZstdMaxOffsetCode, ZstdMaxOffsetLog, &decoder->offsets, decoder->hasSequenceTables);
+        if (offsetSize == SIZE_MAX)
+            return false;
+        p += offsetSize;
+
+        const size_t matchLengthSize = ReadSequenceTable((modes >> 2) & 3, p, end - p, MatchLengthDefaults, _countof(MatchLengthDefaults), 6,
+            ZstdMaxMatchLengthCode, ZstdMaxMatchLengthLog, &decoder->matchLengths, decoder->hasSequenceTables);
+        if (matchLengthSize == SIZE_MAX)
+            return false;
+        p += matchLengthSize;
+
+        decoder->hasSequenceTables = true;
+
+        ZstdBackwardBits bits;
+        if (!InitBackwardBits(&bits, p, end - p))
+            return false;
+
+        UINT literalLengthState = ReadBackwardBits(&bits, decoder->literalLengths.accuracyLog);
+        UINT offsetState = ReadBackwardBits(&bits, decoder->offsets.accuracyLog);
+        UINT matchLengthState = ReadBackwardBits(&bits, decoder->matchLengths.accuracyLog);
+
+        UINT* repeatOffsets = decoder->repeatOffsets;
+        for (size_t i = 0; i < sequenceCount; i++)
+        {
+            const UINT offsetCode = decoder->offsets.entries[offsetState].symbol;
+            const UINT matchLengthCode = decoder->matchLengths.entries[matchLengthState].symbol;
+            const UINT literalLengthCode = decoder->literalLengths.entries[literalLengthState].symbol;
+            if (offsetCode > ZstdMaxOffsetCode || matchLengthCode > ZstdMaxMatchLengthCode || literalLengthCode > ZstdMaxLiteralLengthCode)
+                return false;
+
+            // Os bits extras vm na ordem offset, match, literais.
+            const UINT offsetValue = (1u << offsetCode) + ReadBackwardBits(&bits, offsetCode);
+            const size_t matchLength = MatchLengthBase[matchLengthCode] + ReadBackwardBits(&bits, MatchLengthBits[matchLengthCode]);
+            const size_t literalLength = LiteralLengthBase[literalLengthCode] + ReadBackwardBits(&bits, LiteralLengthBits[literalLengthCode]);
+
+            // Valores 1 a 3 repetem offsets recentes; sem literais antes do match, a escolha anda uma posio.
+            size_t offset;
+            if (offsetValue > 3)
+            {
+                offset = offsetValue - 3;
+                repeatOffsets[2] = repeatOffsets[1];
+                repeatOffsets[1] = repeatOffsets[0];
+                repeatOffsets[0] = static_cast<UINT>(offset);
+            }
+            else
+            {
+                const UINT index = offsetValue - 1 + (literalLength == 0 ? 1 : 0);
+                offset = (index == 3) ? repeatOffsets[0] - 1 : repeatOffsets[index];
+                if (index > 0)
+                {
+                    if (index > 1)
+                        repeatOffsets[2] = repeatOffsets[1];
+
+                    repeatOffsets[1] = repeatOffsets[0];
+                    repeatOffsets[0] = static_cast<UINT>(offset);
+                }
+            }
+
+            if (i + 1 < sequenceCount)
+            {
+                literalLengthState = decoder->literalLengths.entries[literalLengthState].baseline +
+                    ReadBackwardBits(&bits, decoder->literalLengths.entries[literalLengthState].bits);
+                matchLengthState = decoder->matchLengths.entries[matchLengthState].baseline +
+                    ReadBackwardBits(&bits, decoder->matchLengths.entries[matchLengthState].bits);
+                offsetState = decoder->offsets.entries[offsetState].baseline +
+                    ReadBackwardBits(&bits, decoder->offsets.entries[offsetState].bits);
+            }
+
+            if (literalLength > static_cast<size_t>(literalEnd - literals) || literalLength + matchLength > static_cast<size_t>(outputEnd - out))
+                return false;
+
+            // Cpia em blocos de 16 bytes quando h folga nos dois buffers para passar do fim dos literais.
+            if (literalLength <= 16 && literalEnd - literals >= 16 && outputEnd - out >= 16)
+                memcpy(out, literals, 16);
+            else
+                memcpy(out, literals, literalLength);
+
+            out += literalLength;
+            literals += literalLength;
+
+            if (offset == 0 || offset > static_cast<size_t>(out - frameStart))
+                return false;
+
+            // Com distncia de pelo menos 8 bytes cada cpia de 8 bytes l s o que j foi escrito.
+            const BYTE* match = out - offset;
+            BYTE* matchEnd = out + matchLength;
+            if (offset >= 8 && static_cast<size_t>(outputEnd - out) >= matchLength + 8)
+            {
+                for (; out < matchEnd; out += 8, match += 8)
+                    memcpy(out, match, 8);
+
+                out = matchEnd;
+            }
+            else
+            {
+                while (out < matchEnd)
+                    *out++ = *match++;
+            }
+        }
+
+        if (bits.position != 0)
+            return false;
+    }
+
+    const size_t lastLiterals = literalEnd - literals;
+    if (lastLiterals > static_cast<size_t>(outputEnd - out))
+        return false;
+
+    memcpy(out, literals, lastLiterals);
+    *output = out + lastLiterals;
+
+    return true;
+}
+
+// Decodifica um frame a partir de *source e avana *source e *output at o fim dele.
+static bool DecodeFrame(ZstdDecoder* decoder, const BYTE** source, const BYTE* sourceEnd, BYTE** output, BYTE* outputEnd)
+{
+    const BYTE* p = *source;
+    if (sourceEnd - p < 5)
+        return false;
+
+    const UINT descriptor = p[4];
+    p += 5;
+
+    const UINT contentSizeFlag = descriptor >> 6;
+    const bool singleSegment = (descriptor & 0x20) != 0;
+    const bool hasChecksum = (descriptor & 0x04) != 0;
+    const UINT dictionaryIdFlag = descriptor & 3;
+
+    if (descriptor & 0x08)
+        return false;
+
+    const UINT dictionaryIdBytes[4] = { 0, 1, 2, 4 };
+    const UINT contentSizeBytes[4] = { singleSegment ? 1u : 0u, 2, 4, 8 };
+    const size_t headerSize = (singleSegment ? 0 : 1) + dictionaryIdBytes[dictionaryIdFlag] + contentSizeBytes[contentSizeFlag];
+    if (static_cast<size_t>(sourceEnd - p) < headerSize)
+        return false;
+
+    if (!singleSegment)
+        p++;
+
+    if (ReadLittleEndian(p, dictionaryIdBytes[dictionaryIdFlag]) != 0)
+        return false;
+    p += dictionaryIdBytes[dictionaryIdFlag];
+
+    const UINT contentBytes = contentSizeBytes[contentSizeFlag];
+    UINT64 contentSize = ReadLittleEndian(p, contentBytes);
+    if (contentBytes == 2)
+        contentSize += 256;
+    p += contentBytes;
+
+    decoder->hasSequenceTables = false;
+    decoder->hasHuffman = false;
+    decoder->repeatOffsets[0] = 1;
+    decoder->repeatOffsets[1] = 4;
+    decoder->repeatOffsets[2] = 8;
+
+    BYTE* frameStart = *output;
+    BYTE* out = *output;
+
+    for (bool lastBlock = false; !lastBlock;)
+    {
+        if (sourceEnd - p < 3)
+            return false;
+
+        const UINT header = static_cast<UINT>(ReadLittleEndian(p, 3));
+        p += 3;
+
+        lastBlock = (header & 1) != 0;
+        const UINT type = (header >> 1) & 3;
+        const size_t blockSize = header >> 3;
+
+        if (blockSize > ZstdMaxBlockSize)
+            return false;
+
+        switch (type)
+        {
+        case 0:
+            if (static_cast<size_t>(sourceEnd - p) < blockSize || static_cast<size_t>(outputEnd - out) < blockSize)
+                return false;
+
+            memcpy(out, p, blockSize);
+            out += blockSize;
+            p += blockSize;
+            break;
+
+        case 1:
+            if (p == sourceEnd || static_cast<size_t>(outputEnd - out) < blockSize)
+                return false;
+
+            memset(out, *p, blockSize);
+            out += blockSize;
+            p++;
+            break;
+
+        case 2:
+            if (static_cast<size_t>(sourceEnd - p) < blockSize || !DecodeCompressedBlock(decoder, p, blockSize, frameStart, &out, outputEnd))
+                return false;
+
+            p += blockSize;
+            break;
+
+        default:
+            return false;
+        }
+    }
+
+    if (contentBytes > 0 && contentSize != static_cast<UINT64>(out - frameStart))
+        return false;
+
+    if (hasChecksum)
+    {
+        if (sourceEnd - p < 4)
+            return false;
+
+        p += 4;
+    }
+
+    *source = p;
+    *output = out;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+bool DecompressZstd(BYTE* destination, UINT64 size, const BYTE* source, UINT64 sourceSize)
+{
+    std::unique_ptr<ZstdDecoder> decoder(new ZstdDecoder);
+
+    const BYTE* p = source;
+    const BYTE* end = source + sourceSize;
+    BYTE* out = destination;
+    BYTE* outEnd = destination + size;
+
+    while (p < end)
+    {
+        if (end - p < 4)
+            return false;
+
+        const UINT magic = static_cast<UINT>(ReadLittleEndian(p, 4));
+        if ((magic & 0xFFFFFFF0) == ZstdSkippableMagic)
+        {
+            if (end - p < 8)
+                return false;
+
+            const UINT64 skipSize = ReadLittleEndian(p + 4, 4);
+            if (skipSize > static_cast<UINT64>(end - p - 8))
+                return false;
+
+            p += 8 + skipSize;
+            continue;
+        }
+
+        if (magic != ZstdMagic || !DecodeFrame(decoder.get(), &p, end, &out, outEnd))
+            return false;
+    }
+
+    return out == outEnd;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+const UINT ZstdMinMatch = 4;
+const UINT ZstdHashBits = 16;
+const UINT ZstdSearchDepth = 16;
+const UINT ZstdWindowLog = 20;
+const size_t ZstdNoPosition = SIZE_MAX;
+
+// Com menos literais que isso a tabela de Huffman custa mais do que economiza.
+const UINT ZstdMinHuffmanLiterals = 64;
+
+struct ZstdSequence
+{
+    UINT literalLength;
+    UINT matchLength;
+    UINT offsetValue;
+
+    BYTE literalLengthCode;
+    BYTE matchLengthCode;
+    BYTE offsetCode;
+};
+
+// Estado do compressor: cadeias de hash sobre uma janela de 2^ZstdWindowLog bytes (a posio anterior com o
+// mesmo hash fica em chain[posio & mscara]) e os offsets recentes, que o decodificador tambm acompanha.
+struct ZstdEncoder
+{
+    std::vector<size_t> hashHeads;
+    std::vector<size_t> chain;
+    std::vector<ZstdSequence> sequences;
+    UINT repeatOffsets[3];
+
+    BYTE literals[ZstdMaxBlockSize];
+    BYTE block[ZstdMaxBlockSize];
+};
+
+// Escreve do bit mais baixo para o mais alto, na ordem em que ReadFseTable l. Nos fluxos lidos de trs para
+// frente o ltimo campo escrito  o primeiro lido. Passar de end s  acusado por FinishBits.
+struct ZstdBitWriter
+{
+    BYTE* begin;
+    BYTE* end;
+    BYTE* p;
+    UINT64 container;
+    UINT count;
+};
+
+// Tabela de codificao equivalente  ZstdFseTable montada com as mesmas probabilidades. Os estados vo de
+// 2^accuracyLog a 2^(accuracyLog + 1) - 1; tirando 2^accuracyLog, so os estados do decodificador.
+struct ZstdFseEncoder
+{
+    UINT accuracyLog;
+    USHORT states[1 << ZstdMaxLiteralLengthLog];
+    USHORT firstStates[ZstdMaxMatchLengthCode + 1];
+    UINT deltaBits[ZstdMaxMatchLengthCode + 1];
+    int deltaStates[ZstdMaxMatchLengthCode + 1];
+};
+
+// Distribuio de uma das trs tabelas de sequncias e o modo em que ela vai no bloco (0 ou 2).
+struct ZstdSequenceTable
+{
+    UINT mode;
+    UINT accuracyLog;
+    UINT symbolCount;
+    short counts[ZstdMaxMatchLengthCode + 1];
+};
+
+static void WriteLittleEndian(BYTE* p, UINT64 value, UINT byteCount)
+{
+    for (UINT i = 0; i < byteCount; i++)
+    {
+        p[i] = static_cast<BYTE>(value >> (8 * i));
+    }
+}
+
+static void InitBitWriter(ZstdBitWriter* writer, BYTE* begin, BYTE* end)
+{
+    writer->begin = begin;
+    writer->end = end;
+    writer->p = begin;
+    writer->container = 0;
+    writer->count = 0;
+}
+
+// At 32 bits por vez.
+static void WriteBits(ZstdBitWriter* writer, UINT value, UINT count)
+{
+    writer->container |= (value & ((1ull << count) - 1)) << writer->count;
+    writer->count += count;
+
+    for (; writer->count >= 8; writer->count -= 8)
+    {
+        if (writer->p < writer->end)
+            *writer->p = static_cast<BYTE>(writer->container);
+
+        writer->p++;
+        writer->container >>= 8;
+    }
+}
+
+// Completa o ltimo byte com zeros. Devolve os bytes escritos, ou 0 se no couberam.
+static size_t FinishBits(ZstdBitWriter* writer)
+{
+    if (writer->count > 0)
+        WriteBits(writer, 0, 8 - writer->count);
+
+    return (writer->p <= writer->end) ? writer->p - writer->begin : 0;
+}
+
+// Fecha um fluxo lido de trs para frente com o bit 1 que InitBackwardBits procura.
+static size_t FinishBackwardBits(ZstdBitWriter* writer)
+{
+    WriteBits(writer, 1, 1);
+    return FinishBits(writer);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Distribui 2^accuracyLog entre os smbolos na proporo do histograma, com pelo menos 1 para cada smbolo presente
+// e no mximo maxCount. Devolve false se a soma no fechar.
+static bool NormalizeFseCounts(const UINT* histogram, UINT symbolCount, UINT accuracyLog, int maxCount, short* counts)
+{
+    const int tableSize = 1 << accuracyLog;
+    UINT64 total = 0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        total += histogram[s];
+    }
+
+    int sum = 0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        const int count = static_cast<int>(histogram[s] * tableSize / total);
+        counts[s] = static_cast<short>(histogram[s] ? (std::min)((std::max)(count, 1), maxCount) : 0);
+        sum += counts[s];
+    }
+
+    // Cada ajuste vai para o smbolo em que uma unidade muda menos o tamanho: ao somar, o de maior histograma por
+    // unidade de probabilidade; ao tirar, o de menor.
+    while (sum != tableSize)
+    {
+        const bool add = sum < tableSize;
+        int best = -1;
+        for (UINT s = 0; s < symbolCount; s++)
+        {
+            if (histogram[s] == 0 || (add ? counts[s] >= maxCount : counts[s] <= 1))
+                continue;
+
+            const UINT64 current = static_cast<UINT64>(histogram[s]) * (best < 0 ? 1 : counts[best]);
+            const UINT64 other = (best < 0) ? 0 : static_cast<UINT64>(histogram[best]) * counts[s];
+            if (best < 0 || (add ? current > other : current < other))
+                best = static_cast<int>(s);
+        }
+
+        if (best < 0)
+            return false;
+
+        counts[best] += add ? 1 : -1;
+        sum += add ? 1 : -1;
+    }
+
+    return true;
+}
+
+// Bits gastos pelos smbolos do histograma com a distribuio counts, ou um valor enorme se faltar algum smbolo.
+static double GetFseCost(const UINT* histogram, UINT symbolCount, const short* counts, UINT countCount, UINT accuracyLog)
+{
+    double bits = 0.0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        if (histogram[s] == 0)
+            continue;
+
+        if (s >= countCount || counts[s] == 0)
+            return 1e30;
+
+        bits += histogram[s] * (accuracyLog - log2((counts[s] == -1) ? 1.0 : counts[s]));
+    }
+
+    return bits;
+}
+
+// O inverso de ReadFseTable.
+static void WriteFseTable(ZstdBitWriter* writer, const short* counts, UINT symbolCount, UINT accuracyLog)
+{
+    WriteBits(writer, accuracyLog - 5, 4);
+
+    int remaining = (1 << accuracyLog) + 1;
+    int threshold = 1 << accuracyLog;
+    UINT bitCount = accuracyLog + 1;
+    UINT symbol = 0;
+
+    while (remaining > 1)
+    {
+        const int count = counts[symbol++];
+        const int value = count + 1;
+        const int max = (2 * threshold - 1) - remaining;
+        if (value < max)
+            WriteBits(writer, value, bitCount - 1);
+        else if (value < threshold)
+            WriteBits(writer, value, bitCount);
+        else
+            WriteBits(writer, value + max, bitCount);
+
+        remaining -= (count < 0) ? -count : count;
+
+        if (count == 0)
+        {
+            UINT zeros = 0;
+            while (symbol + zeros < symbolCount && counts[symbol + zeros] == 0)
+                zeros++;
+
+            symbol += zeros;
+            for (; zeros >= 3; zeros -= 3)
+                WriteBits(writer, 3, 2);
+
+            WriteBits(writer, zeros, 2);
+        }
+
+        while (remaining < threshold)
+        {
+            bitCount--;
+            threshold >>= 1;
+        }
+    }
+}
+
+static void BuildFseEncoder(const short* counts, UINT symbolCount, UINT accuracyLog, ZstdFseEncoder* encoder)
+{
+    const UINT tableSize = 1u << accuracyLog;
+    UINT highThreshold = tableSize - 1;
+    BYTE symbols[1 << ZstdMaxLiteralLengthLog];
+    UINT cumulative[ZstdMaxMatchLengthCode + 2];
+
+    encoder->accuracyLog = accuracyLog;
+
+    // Mesmo espalhamento de BuildFseTable.
+    cumulative[0] = 0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        if (counts[s] == -1)
+        {
+            symbols[highThreshold--] = static_cast<BYTE>(s);
+            cumulative[s + 1] = cumulative[s] + 1;
+        }
+        else
+        {
+            cumulative[s + 1] = cumulative[s] + counts[s];
+        }
+    }
+
+    const UINT step = (tableSize >> 1) + (tableSize >> 3) + 3;
+    const UINT mask = tableSize - 1;
+    UINT position = 0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        for (int i = 0; i < counts[s]; i++)
+        {
+            symbols[position] = static_cast<BYTE>(s);
+            do
+            {
+                position = (position + step) & mask;
+            } while (position > highThreshold);
+        }
+    }
+
+    // Os estados de cada smbolo em ordem crescente, a mesma dos nextState do decodificador.
+    UINT next[ZstdMaxMatchLengthCode + 1];
+    memcpy(next, cumulative, symbolCount * sizeof(UINT));
+    for (UINT u = 0; u < tableSize; u++)
+    {
+        encoder->states[next[symbols[u]]++] = static_cast<USHORT>(tableSize + u);
+    }
+
+    // Um estado em [count << (bits - 1), count << bits) sai com bits bits; os outros, com um a menos.
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        const int count = counts[s];
+        if (count == 0)
+            continue;
+
+        encoder->firstStates[s] = encoder->states[cumulative[s]];
+        if (count == -1 || count == 1)
+        {
+            encoder->deltaBits[s] = (accuracyLog << 16) - tableSize;
+            encoder->deltaStates[s] = static_cast<int>(cumulative[s]) - 1;
+        }
+        else
+        {
+            const UINT maxBits = accuracyLog - FindHighestBit(count - 1);
+            encoder->deltaBits[s] = (maxBits << 16) - (static_cast<UINT>(count) << maxBits);
+            encoder->deltaStates[s] = static_cast<int>(cumulative[s]) - count;
+        }
+    }
+}
+
+// Escreve os bits que levam o decodificador do estado de symbol ao estado atual, que passa a ser o de symbol.
+static void EncodeFseSymbol(ZstdBitWriter* writer, const ZstdFseEncoder* encoder, UINT* state, UINT symbol)
+{
+    const UINT bits = (*state + encoder->deltaBits[symbol]) >> 16;
+    WriteBits(writer, *state, bits);
+    *state = encoder->states[static_cast<int>(*state >> bits) + encoder->deltaStates[symbol]];
+}
+
+static void FlushFseState(ZstdBitWriter* writer, const ZstdFseEncoder* encoder, UINT state)
+{
+    WriteBits(writer, state, encoder->accuracyLog);
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Comprimentos de Huffman dos smbolos presentes (pelo menos dois), limitados a ZstdMaxHuffmanBits e com a soma de
+// Kraft fechando exatamente, como os pesos exigem. Devolve o maior comprimento.
+static UINT BuildHuffmanLengths(const UINT* histogram, BYTE* lengths)
+{
+    UINT symbols[256];
+    UINT count = 0;
+    for (UINT s = 0; s < 256; s++)
+    {
+        lengths[s] = 0;
+        if (histogram[s] > 0)
+            symbols[count++] = s;
+    }
+
+    std::stable_sort(symbols, symbols + count, [histogram](UINT a, UINT b) { return histogram[a] < histogram[b]; });
+
+    // Os ns internos saem em ordem crescente de peso, ento duas filas bastam: folhas e ns internos.
+    UINT64 weights[511];
+    USHORT parents[511];
+    BYTE depths[511];
+    for (UINT i = 0; i < count; i++)
+    {
+        weights[i] = histogram[symbols[i]];
+    }
+
+    UINT leaf = 0, node = count;
+    for (UINT next = count; next < 2 * count - 1; next++)
+    {
+        UINT children[2];
+        for (UINT c = 0; c < 2; c++)
+        {
+            children[c] = (leaf < count && (node >= next || weights[leaf] <= weights[node])) ? leaf++ : node++;
+        }
+
+        weights[next] = weights[children[0]] + weights[children[1]];
+        parents[children[0]] = static_cast<USHORT>(next);
+        parents[children[1]] = static_cast<USHORT>(next);
+    }
+
+    depths[2 * count - 2] = 0;
+    for (int i = 2 * count - 3; i >= 0; i--)
+    {
+        depths[i] = depths[parents[i]] + 1;
+    }
+
+    // A soma de Kraft em unidades de 2^-limit.
+    const UINT limit = ZstdMaxHuffmanBits;
+    const UINT full = 1u << limit;
+    UINT kraft = 0;
+    for (UINT i = 0; i < count; i++)
+    {
+        lengths[symbols[i]] = static_cast<BYTE>((std::min)(static_cast<UINT>(depths[i]), limit));
+        kraft += 1u << (limit - lengths[symbols[i]]);
+    }
+
+    // Os cdigos cortados no limite estouram a soma: alonga os mais raros entre os mais longos que ainda podem crescer.
+    while (kraft > full)
+    {
+        UINT best = count;
+        for (UINT i = 0; i < count; i++)
+        {
+            if (lengths[symbols[i]] < limit && (best == count || lengths[symbols[i]] > lengths[symbols[best]]))
+                best = i;
+        }
+
+        lengths[symbols[best]]++;
+        kraft -= 1u << (limit - lengths[symbols[best]]);
+    }
+
+    // A sobra  mltipla da parcela do cdigo mais longo: encurta os mais frequentes que cabem nela.
+    while (kraft < full)
+    {
+        for (int i = count - 1; i >= 0; i--)
+        {
+            const UINT length = lengths[symbols[i]];
+            if (length > 1 && (1u << (limit - length)) <= full - kraft)
+            {
+                lengths[symbols[i]]--;
+                kraft += 1u << (limit - length);
+                break;
+            }
+        }
+    }
+
+    UINT maxBits = 0;
+    for (UINT i = 0; i < count; i++)
+    {
+        maxBits = (std::max)(maxBits, static_cast<UINT>(lengths[symbols[i]]));
+    }
+
+    return maxBits;
+}
+
+// Pesos de 4 bits at 128 smbolos; acima disso, comprimidos com FSE em dois estados intercalados.
+static size_t WriteHuffmanWeights(BYTE* destination, BYTE* end, const BYTE* weights, UINT weightCount)
+{
+    if (weightCount <= 128)
+    {
+        const size_t size = 1 + (weightCount + 1) / 2;
+        if (size > static_cast<size_t>(end - destination))
+            return 0;
+
+        memset(destination + 1, 0, size - 1);
+        destination[0] = static_cast<BYTE>(127 + weightCount);
+        for (UINT i = 0; i < weightCount; i++)
+        {
+            destination[1 + i / 2] |= (i & 1) ? weights[i] : weights[i] << 4;
+        }
+
+        return size;
+    }
+
+    UINT histogram[ZstdMaxHuffmanBits + 1] = {};
+    UINT symbolCount = 0;
+    for (UINT i = 0; i < weightCount; i++)
+    {
+        histogram[weights[i]]++;
+        symbolCount = (std::max)(symbolCount, weights[i] + 1u);
+    }
+
+    // O decodificador para quando a leitura do estado passa do comeo do fluxo, ento o penltimo peso precisa de
+    // um estado que leia algum bit: com no mximo metade da tabela, todos os estados de um smbolo leem.
+    const UINT accuracyLog = ZstdMaxHuffmanWeightLog;
+    short counts[ZstdMaxHuffmanBits + 1];
+    if (!NormalizeFseCounts(histogram, symbolCount, accuracyLog, 1 << (accuracyLog - 1), counts))
+        return 0;
+
+    ZstdBitWriter writer;
+    InitBitWriter(&writer, destination + 1, (std::min)(end, destination + 128));
+    WriteFseTable(&writer, counts, symbolCount, accuracyLog);
+    if (FinishBits(&writer) == 0)
+        return 0;
+
+    ZstdFseEncoder encoder;
+    BuildFseEncoder(counts, symbolCount, accuracyLog, &encoder);
+
+    // Os pesos pares vo no estado 0 e os mpares no 1; os dois ltimos s iniciam os estados.
+    UINT states[2];
+    states[(weightCount - 1) & 1] = encoder.firstStates[weights[weightCount - 1]];
+    states[(weightCount - 2) & 1] = encoder.firstStates[weights[weightCount - 2]];
+    for (int i = weightCount - 3; i >= 0; i--)
+    {
+        EncodeFseSymbol(&writer, &encoder, &states[i & 1], weights[i]);
+    }
+
+    FlushFseState(&writer, &encoder, states[1]);
+    FlushFseState(&writer, &encoder, states[0]);
+
+    const size_t size = FinishBackwardBits(&writer);
+    if (size == 0)
+        return 0;
+
+    destination[0] = static_cast<BYTE>(size);
+    return 1 + size;
+}
+
+// Os smbolos vo de trs para frente, para que o decodificador leia o primeiro antes.
+static size_t WriteHuffmanStream(BYTE* destination, BYTE* end, const BYTE* literals, size_t count, const USHORT* codes, const BYTE* lengths)
+{
+    ZstdBitWriter writer;
+    InitBitWriter(&writer, destination, end);
+    for (size_t i = count; i-- > 0;)
+    {
+        WriteBits(&writer, codes[literals[i]], lengths[literals[i]]);
+    }
+
+    return FinishBackwardBits(&writer);
+}
+
+// Literais com Huffman, num fluxo at 1.023 bytes e em quatro acima disso. Devolve 0 se no ficarem menores que crus.
+static size_t WriteHuffmanLiterals(BYTE* destination, BYTE* end, const BYTE* literals, size_t count, const UINT* histogram)
+{
+    BYTE lengths[256];
+    const UINT maxBits = BuildHuffmanLengths(histogram, lengths);
+
+    UINT maxSymbol = 0;
+    BYTE weights[256];
+    UINT rankStart[ZstdMaxHuffmanBits + 2] = {};
+    for (UINT s = 0; s < 256; s++)
+    {
+        weights[s] = lengths[s] ? static_cast<BYTE>(maxBits + 1 - lengths[s]) : 0;
+        if (weights[s] > 0)
+        {
+            rankStart[weights[s] + 1] += 1u << (weights[s] - 1);
+            maxSymbol = s;
+        }
+    }
+
+    // Cdigos cannicos na ordem da tabela de ReadHuffmanTable: pesos crescentes e, no mesmo peso, smbolos crescentes.
+    for (UINT w = 1; w <= ZstdMaxHuffmanBits + 1; w++)
+    {
+        rankStart[w] += rankStart[w - 1];
+    }
+
+    USHORT codes[256];
+    for (UINT s = 0; s <= maxSymbol; s++)
+    {
+        if (weights[s] > 0)
+        {
+            codes[s] = static_cast<USHORT>(rankStart[weights[s]] >> (weights[s] - 1));
+            rankStart[weights[s]] += 1u << (weights[s] - 1);
+        }
+    }
+
+    const bool fourStreams = count >= 1024;
+    const UINT headerSize = !fourStreams ? 3 : (count < 16384) ? 4 : 5;
+    if (headerSize > static_cast<size_t>(end - destination))
+        return 0;
+
+    BYTE* p = destination + headerSize;
+    const size_t tableSize = WriteHuffmanWeights(p, end, weights, maxSymbol);
+    if (tableSize == 0)
+        return 0;
+
+    p += tableSize;
+
+    if (!fourStreams)
+    {
+        const size_t streamSize = WriteHuffmanStream(p, end, literals, count, codes, lengths);
+        if (streamSize == 0)
+            return 0;
+
+        p += streamSize;
+    }
+    else
+    {
+        if (end - p < 6)
+            return 0;
+
+        BYTE* jumpTable = p;
+        p += 6;
+
+        const size_t segment = (count + 3) / 4;
+        for (UINT i = 0; i < 4; i++)
+        {
+            const size_t begin = i * segment;
+            const size_t streamSize = WriteHuffmanStream(p, end, literals + begin, (i < 3) ? segment : count - begin, codes, lengths);
+            if (streamSize == 0 || streamSize > 0xFFFF)
+                return 0;
+
+            if (i < 3)
+                WriteLittleEndian(jumpTable + 2 * i, streamSize, 2);
+
+            p += streamSize;
+        }
+    }
+
+    // Crus, os literais gastariam no mximo count + 3 bytes.
+    const size_t compressedSize = p - destination - headerSize;
+    if (headerSize + compressedSize >= count)
+        return 0;
+
+    const UINT sizeFormat = !fourStreams ? 0 : headerSize - 2;
+    const UINT sizeBits = !fourStreams ? 10 : 4 * sizeFormat + 6;
+    const UINT64 header = 2 | (sizeFormat << 2) | (static_cast<UINT64>(count) << 4) | (static_cast<UINT64>(compressedSize) << (4 + sizeBits));
+    WriteLittleEndian(destination, header, headerSize);
+
+    return p - destination;
+}
+
+static size_t WriteLiterals(BYTE* destination, BYTE* end, const BYTE* literals, size_t count)
+{
+    UINT histogram[256] = {};
+    UINT symbolCount = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (histogram[literals[i]]++ == 0)
+            symbolCount++;
+    }
+
+    if (count >= ZstdMinHuffmanLiterals && symbolCount > 1)
+    {
+        const size_t size = WriteHuffmanLiterals(destination, end, literals, count, histogram);
+        if (size > 0)
+            return size;
+    }
+
+    // Crus ou, com um smbolo s, RLE: o mesmo cabealho com o byte repetido uma vez.
+    const UINT type = (symbolCount == 1) ? 1 : 0;
+    const UINT headerSize = (count < 32) ? 1 : (count < 4096) ? 2 : 3;
+    const UINT sizeFormat = (headerSize == 1) ? 0 : (headerSize == 2) ? 1 : 3;
+    const size_t size = headerSize + (type ? 1 : count);
+    if (size > static_cast<size_t>(end - destination))
+        return 0;
+
+    WriteLittleEndian(destination, type | (sizeFormat << 2) | (static_cast<UINT64>(count) << ((headerSize == 1) ? 3 : 4)), headerSize);
+    memcpy(destination + headerSize, literals, type ? 1 : count);
+
+    return size;
+}
+
+// -----------------------------------------------------------------------------------------------------
+
+// Escolhe entre a distribuio predefinida e uma descrita no bloco, a que gastar menos bits contando a descrio.
+static void ChooseSequenceTable(const UINT* histogram, UINT symbolCount, size_t sequenceCount, const short* defaults, UINT defaultCount,
+    UINT defaultLog, UINT maxLog, ZstdSequenceTable* table)
+{
+    const double defaultCost = GetFseCost(histogram, symbolCount, defaults, defaultCount, defaultLog);
+
+    UINT distinctCount = 0;
+    for (UINT s = 0; s < symbolCount; s++)
+    {
+        if (histogram[s] > 0)
+            distinctCount++;
+    }
+
+    // Tabelas pequenas para poucas sequncias: a descrio cresce com a preciso.
+    UINT accuracyLog = (std::min)((std::max)(FindHighestBit(static_cast<UINT>(sequenceCount)), 7u) - 2, maxLog);
+    while ((1u << accuracyLog) < distinctCount)
+        accuracyLog++;
+
+    double customCost = 1e30;
+    short counts[ZstdMaxMatchLengthCode + 1];
+    if (NormalizeFseCounts(histogram, symbolCount, accuracyLog, 1 << accuracyLog, counts))
+    {
+        BYTE description[128];
+        ZstdBitWriter writer;
+        InitBitWriter(&writer, description, description + sizeof(description));
+        WriteFseTable(&writer, counts, symbolCount, accuracyLog);
+
+        const size_t descriptionSize = FinishBits(&writer);
+        if (descriptionSize > 0)
+            customCost = GetFseCost(histogram, symbolCount, counts, symbolCount, accuracyLog) + 8.0 * descriptionSize;
+    }
+
+    if (defaultCost <= customCost)
+    {
+        table->mode = 0;
+        table->accuracyLog = defaultLog;
+        table->symbolCount = defaultCount;
+        memcpy(table->counts, defaults, defaultCount * sizeof(short));
+    }
+    else
+    {
+        table->mode = 2;
+        table->accuracyLog = accuracyLog;
+        table->symbolCount = symbolCount;
+        memcpy(table->counts, counts, symbolCount * sizeof(short));
+    }
+}
+
+static size_t WriteSequences(BYTE* destination, BYTE* end, const std::vector<ZstdSequence>& sequences)
+{
+    const size_t sequenceCount = sequences.size();
+    if (end - destination < 4)
+        return 0;
+
+    BYTE* p = destination;
+    if (sequenceCount < 128)
+    {
+        *p++ = static_cast<BYTE>(sequenceCount);
+    }
+    else if (sequenceCount < 0x7F00)
+    {
+        *p++ = static_cast<BYTE>((sequenceCount >> 8) + 128);
+        *p++ = static_cast<BYTE>(sequenceCount);
+    }
+    else
+    {
+        *p++ = 255;
+        WriteLittleEndian(p, sequenceCount - 0x7F00, 2);
+        p += 2;
+    }
+
+    if (sequenceCount == 0)
+        return p - destination;
+
+    UINT literalLengthHistogram[ZstdMaxLiteralLengthCode + 1] = {};
+    UINT matchLengthHistogram[ZstdMaxMatchLengthCode + 1] = {};
+    UINT offsetHistogram[ZstdMaxOffsetCode + 1] = {};
+    UINT literalLengthSymbols = 0, matchLengthSymbols = 0, offsetSymbols = 0;
+    for (const ZstdSequence& sequence : sequences)
+    {
+        literalLengthHistogram[sequence.literalLengthCode]++;
+        matchLengthHistogram[sequence.matchLengthCode]++;
+        offsetHistogram[sequence.offsetCode]++;
+        literalLengthSymbols = (std::max)(literalLengthSymbols, sequence.literalLengthCode + 1u);
+        matchLengthSymbols = (std::max)(matchLengthSymbols, sequence.matchLengthCode + 1u);
+        offsetSymbols = (std::max)(offsetSymbols, sequence.offsetCode + 1u);
+    }
+
+    ZstdSequenceTable tables[3];
+    ChooseSequenceTable(literalLengthHistogram, literalLengthSymbols, sequenceCount, LiteralLengthDefaults, _countof(LiteralLengthDefaults), 6,
+        ZstdMaxLiteralLengthLog, &tables[0]);
+    ChooseSequenceTable(offsetHistogram, offsetSymbols, sequenceCount, OffsetDefaults, _countof(OffsetDefaults), 5, ZstdMaxOffsetLog, &tables[1]);
+    ChooseSequenceTable(matchLengthHistogram, matchLengthSymbols, sequenceCount, MatchLengthDefaults, _countof(MatchLengthDefaults), 6,
+        ZstdMaxMatchLengthLog, &tables[2]);
+
+    *p++ = static_cast<BYTE>((tables[0].mode << 6) | (tables[1].mode << 4) | (tables[2].mode << 2));
+
+    ZstdFseEncoder encoders[3];
+    for (UINT t = 0; t < 3; t++)
+    {
+        if (tables[t].mode == 2)
+        {
+            ZstdBitWriter writer;
+            InitBitWriter(&writer, p, end);
+            WriteFseTable(&writer, tables[t].counts, tables[t].symbolCount, tables[t].accuracyLog);
+
+            const size_t size = FinishBits(&writer);
+            if (size == 0)
+                return 0;
+
+            p += size;
+        }
+
+        BuildFseEncoder(tables[t].counts, tables[t].symbolCount, tables[t].accuracyLog, &encoders[t]);
+    }
+
+    const ZstdFseEncoder* literalLengths = &encoders[0];
+    const ZstdFseEncoder* offsets = &encoders[1];
+    const ZstdFseEncoder* matchLengths = &encoders[2];
+
+    // De trs para frente, na ordem inversa da leitura em DecodeCompressedBlock: por sequncia, as transies de
+    // estado (offset, match, literais) e depois os bits extras (literais, match, offset). A ltima s inicia os estados.
+    ZstdBitWriter writer;
+    InitBitWriter(&writer, p, end);
+
+    const ZstdSequence& last = sequences[sequenceCount - 1];
+    UINT literalLengthState = literalLengths->firstStates[last.literalLengthCode];
+    UINT offsetState = offsets->firstStates[last.offsetCode];
+    UINT matchLengthState = matchLengths->firstStates[last.matchLengthCode];
+
+    for (size_t i = sequenceCount; i-- > 0;)
+    {
+        const ZstdSequence& sequence = sequences[i];
+        if (i + 1 < sequenceCount)
+        {
+            EncodeFseSymbol(&writer, offsets, &offsetState, sequence.offsetCode);
+            EncodeFseSymbol(&writer, matchLengths, &matchLengthState, sequence.matchLengthCode);
+            EncodeFseSymbol(&writer, literalLengths, &literalLengthState, sequence.literalLengthCode);
+        }
+
+        WriteBits(&writer, sequence.literalLength - LiteralLengthBase[sequence.literalLengthCode], LiteralLengthBits[sequence.literalLengthCode]);
+        WriteBits(&writer, sequence.matchLength - MatchLengthBase[sequence.matchLengthCode], MatchLengthBits[sequence.matchLengthCode]);
+        WriteBits(&writer, sequence.offsetValue - (1u << sequence.offsetCode), sequence.offsetCode);
+    }
+
+    FlushFseState(&writer, matchLengths, matchLengthState);
+    FlushFseState(&writer, offsets, offsetState);
+    FlushFseState(&writer, literalLengths, literalLengthState);
+
+    const size_t streamSize = FinishBackwardBits(&writer);
+    if (streamSize == 0)
+        return 0;
+
+    return p + streamSize - destination;
+}
+
+static inline size_t CountMatch(const BYTE* a, const BYTE* b, size_t limit)
+{
+    size_t length = 0;
+    while (length + 8 <= limit)
+    {
+        UINT64 x, y;
+        memcpy(&x, a + length, sizeof(x));
+        memcpy(&y, b + length, sizeof(y));
+        if (x != y)
+            return length + FindFirstSet(x ^ y) / 8;
+
+        length += 8;
+    }
+
+    while (length < limit && a[length] == b[length])
+        length++;
+
+    return length;
+}
+
+static inline UINT HashZstd(const BYTE* p)
+{
+    UINT sequence;
+    memcpy(&sequence, p, sizeof(sequence));
+    return (sequence * 2654435761u) >> (32 - ZstdHashBits);
+}
+
+static inline void InsertZstdPosition(ZstdEncoder* encoder, const BYTE* source, size_t position)
+{
+    const UINT hash = HashZstd(source + position);
+    encoder->chain[position & (encoder->chain.size() - 1)] = encoder->hashHeads[hash];
+    encoder->hashHeads[hash] = position;
+}
+
+static UINT GetLengthCode(const UINT* bases, UINT codeCount, UINT length)
+{
+    return static_cast<UINT>(std::upper_bound(bases, bases + codeCount, length) - bases) - 1;
+}
+
+// Comprime [blockBegin, blockEnd) em encoder->block, com matches que podem voltar at o incio da janela. Devolve o
+// tamanho, ou 0 se o bloco no ficar menor que cru.
+static size_t CompressBlock(ZstdEncoder* encoder, const BYTE* source, size_t sourceSize, size_t blockBegin, size_t blockEnd)
+{
+    std::vector<ZstdSequence>& sequences = encoder->sequences;
+    sequences.clear();
+
+    const size_t windowMask = encoder->chain.size() - 1;
+    size_t literalCount = 0;
+    size_t anchor = blockBegin;
+    size_t position = blockBegin;
+
+    // Busca gulosa: o match mais longo entre os ZstdSearchDepth candidatos mais recentes com o mesmo hash.
+    while (position + ZstdMinMatch <= blockEnd)
+    {
+        size_t candidate = encoder->hashHeads[HashZstd(source + position)];
+        InsertZstdPosition(encoder, source, position);
+
+        size_t bestLength = 0, bestOffset = 0;
+        for (UINT depth = 0; depth < ZstdSearchDepth && candidate != ZstdNoPosition && position - candidate <= windowMask; depth++)
+        {
+            const size_t length = CountMatch(source + position, source + candidate, blockEnd - position);
+            if (length > bestLength)
+            {
+                bestLength = length;
+                bestOffset = position - candidate;
+            }
+
+            candidate = encoder->chain[candidate & windowMask];
+        }
+
+        // Longe do ltimo match o passo cresce, como no LZ4: dados que no comprimem passam rpido.
+        if (bestLength < ZstdMinMatch)
+        {
+            position += 1 + ((position - anchor) >> 8);
+            continue;
+        }
+
+        ZstdSequence sequence;
+        sequence.literalLength = static_cast<UINT>(position - anchor);
+        sequence.matchLength = static_cast<UINT>(bestLength);
+
+        // S o offset mais recente  repetido, e s depois de literais, quando o cdigo 1 no tem outro significado.
+        UINT* repeatOffsets = encoder->repeatOffsets;
+        if (sequence.literalLength > 0 && bestOffset == repeatOffsets[0])
+        {
+            sequence.offsetValue = 1;
+        }
+        else
+        {
+            sequence.offsetValue = static_cast<UINT>(bestOffset) + 3;
+            repeatOffsets[2] = repeatOffsets[1];
+            repeatOffsets[1] = repeatOffsets[0];
+            repeatOffsets[0] = static_cast<UINT>(bestOffset);
+        }
+
+        sequence.literalLengthCode = static_cast<BYTE>(GetLengthCode(LiteralLengthBase, _countof(LiteralLengthBase), sequence.literalLength));
+        sequence.matchLengthCode = static_cast<BYTE>(GetLengthCode(MatchLengthBase, _countof(MatchLengthBase), sequence.matchLength));
+        sequence.offsetCode = static_cast<BYTE>(FindHighestBit(sequence.offsetValue));
+        sequences.push_back(sequence);
+
+        memcpy(encoder->literals + literalCount, source + anchor, sequence.literalLength);
+        literalCount += sequence.literalLength;
+
+        for (size_t p = position + 1; p < position + bestLength && p + ZstdMinMatch <= sourceSize; p++)
+        {
+            InsertZstdPosition(encoder, source, p);
+        }
+
+        position += bestLength;
+        anchor = position;
+    }
+
+    memcpy(encoder->literals + literalCount, source + anchor, blockEnd - anchor);
+    literalCount += blockEnd - anchor;
+
+    BYTE* p = encoder->block;
+    BYTE* end = encoder->block + (blockEnd - blockBegin);
+
+    const size_t literalsSize = WriteLiterals(p, end, encoder->literals, literalCount);
+    if (literalsSize == 0)
+        return 0;
+
+    p += literalsSize;
+
+    const size_t sequencesSize = WriteSequences(p, end, sequences);
+    if (sequencesSize == 0 || p + sequencesSize >= end)
+        return 0;
+
+    return p + sequencesSize - encoder->block;
+}
+
+UINT64 CompressZstd(BYTE* destination, UINT64 capacity, const BYTE* source, UINT64 size)
+{
+    std::unique_ptr<ZstdEncoder> encoder(new ZstdEncoder);
+
+    size_t windowSize = 1;
+    while (windowSize < size && windowSize < (1u << ZstdWindowLog))
+        windowSize <<= 1;
+
+    encoder->hashHeads.assign(1 << ZstdHashBits, ZstdNoPosition);
+    encoder->chain.resize(windowSize);
+    encoder->repeatOffsets[0] = 1;
+    encoder->repeatOffsets[1] = 4;
+    encoder->repeatOffsets[2] = 8;
+
+    // Um frame de segmento nico: a janela  o contedo inteiro, cujo tamanho vai no cabealho.
+    const UINT contentSizeFlag = (size < 256) ? 0 : (size < 65536 + 256) ? 1 : (size <= 0xFFFFFFFF) ? 2 : 3;
+    const UINT contentSizeBytes[4] = { 1, 2, 4, 8 };
+    const UINT headerSize = 5 + contentSizeBytes[contentSizeFlag];
+    if (capacity < headerSize)
+        return 0;
+
+    WriteLittleEndian(destination, ZstdMagic, 4);
+    destination[4] = static_cast<BYTE>((contentSizeFlag << 6) | 0x20);
+    WriteLittleEndian(destination + 5, (contentSizeFlag == 1) ? size - 256 : size, contentSizeBytes[contentSizeFlag]);
+
+    UINT64 position = headerSize;
+    UINT64 blockBegin = 0;
+    bool lastBlock;
+    do
+    {
+        const UINT64 blockEnd = (std::min)(blockBegin + ZstdMaxBlockSize, size);
+        const size_t blockLength = static_cast<size_t>(blockEnd - blockBegin);
+        lastBlock = blockEnd == size;
+
+        // Um bloco que vai cru no passa pelas sequncias, e o decodificador no v os offsets que ele mudaria.
+        UINT repeatOffsets[3];
+        memcpy(repeatOffsets, encoder->repeatOffsets, sizeof(repeatOffsets));
+
+        const size_t compressedSize = CompressBlock(encoder.get(), source, static_cast<size_t>(size), static_cast<size_t>(blockBegin),
+            static_cast<size_t>(blockEnd));
+        if (compressedSize == 0)
+            memcpy(encoder->repeatOffsets, repeatOffsets, sizeof(repeatOffsets));
+
+        const UINT type = compressedSize ? 2 : 0;
+        const size_t blockSize = compressedSize ? compressedSize : blockLength;
+        if (capacity - position < 3 + blockSize)
+            return 0;
+
+        WriteLittleEndian(destination + position, (lastBlock ? 1 : 0) | (type << 1) | (static_cast<UINT>(blockSize) << 3), 3);
+        memcpy(destination + position + 3, compressedSize ? encoder->block : source + blockBegin, blockSize);
+
+        position += 3 + blockSize;
+        blockBegin = blockEnd;
+    } while (!lastBlock);
+
+    return position;
+}
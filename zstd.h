@@ -0,0 +1,21 @@
+#pragma once
+
+#include "infinity.h"
+
+// Frames Zstandard (RFC 8878). A descompresso atende as texturas KTX2 supercomprimidas, que vm de ferramentas
+// externas, e os blocos Zstd dos .pak. Frames sem dicionrio; o checksum do contedo, se houver,  ignorado.
+
+// Tamanho mximo da sada de CompressZstd para uma entrada de size bytes: blocos que no comprimem vo crus.
+inline UINT64 GetZstdCompressBound(UINT64 size)
+{
+    return size + (size / (128 * 1024) + 1) * 3 + 13;
+}
+
+// Um frame com o tamanho do contedo no cabealho, literais com Huffman e tabelas de sequncias prprias quando
+// compensam. A busca de matches  gulosa, sobre cadeias de hash: mais lenta que a do LZ4. Devolve o tamanho
+// comprimido, ou 0 se no couber em capacity.
+UINT64 CompressZstd(BYTE* destination, UINT64 capacity, const BYTE* source, UINT64 size);
+
+// Descomprime exatamente size bytes de um ou mais frames em sequncia (frames "skippable" so pulados). Devolve
+// false se os dados estiverem corrompidos ou usarem um dicionrio.
+bool DecompressZstd(BYTE* destination, UINT64 size, const BYTE* source, UINT64 sourceSize);